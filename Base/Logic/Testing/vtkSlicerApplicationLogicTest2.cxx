@@ -0,0 +1,227 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Slicer includes
+#include "vtkSlicerApplicationLogic.h"
+#include "vtkSlicerTask.h"
+#include "vtkMRMLCoreTestingMacros.h"
+
+// MRML includes
+#include <vtkMRMLAbstractLogic.h>
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+
+// ITK includes
+#include <itkMutexLock.h>
+#include <itksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <vector>
+
+//---------------------------------------------------------------------------
+/// vtkSlicerTaskTestLogic records the order in which the tasks are started
+/// and can hold the running tasks until they are released.
+class vtkSlicerTaskTestLogic : public vtkMRMLAbstractLogic
+{
+public:
+  vtkTypeMacro(vtkSlicerTaskTestLogic, vtkMRMLAbstractLogic);
+  static vtkSlicerTaskTestLogic *New();
+
+  void RunTask(void* clientdata);
+
+  int GetNumberOfRunningTasks();
+  std::vector<int> GetStartedTasks();
+  void SetHoldTasks(bool hold);
+  /// Let one of the held tasks finish
+  void ReleaseOneTask();
+
+protected:
+  vtkSlicerTaskTestLogic()
+    {
+    this->NumberOfRunningTasks = 0;
+    this->HoldTasks = false;
+    this->NumberOfReleasedTasks = 0;
+    }
+  virtual ~vtkSlicerTaskTestLogic(){}
+
+  itk::SimpleMutexLock Lock;
+  int NumberOfRunningTasks;
+  bool HoldTasks;
+  int NumberOfReleasedTasks;
+  std::vector<int> StartedTasks;
+};
+
+vtkStandardNewMacro(vtkSlicerTaskTestLogic);
+
+//---------------------------------------------------------------------------
+void vtkSlicerTaskTestLogic::RunTask(void* clientdata)
+{
+  this->Lock.Lock();
+  this->StartedTasks.push_back(static_cast<int>(reinterpret_cast<size_t>(clientdata)));
+  ++this->NumberOfRunningTasks;
+  this->Lock.Unlock();
+
+  // wait until the tasks are released (at most 10s)
+  for (int i = 0; i < 1000; ++i)
+    {
+    this->Lock.Lock();
+    bool hold = this->HoldTasks;
+    if (hold && this->NumberOfReleasedTasks > 0)
+      {
+      --this->NumberOfReleasedTasks;
+      hold = false;
+      }
+    this->Lock.Unlock();
+    if (!hold)
+      {
+      break;
+      }
+    itksys::SystemTools::Delay(10);
+    }
+
+  this->Lock.Lock();
+  --this->NumberOfRunningTasks;
+  this->Lock.Unlock();
+}
+
+//---------------------------------------------------------------------------
+int vtkSlicerTaskTestLogic::GetNumberOfRunningTasks()
+{
+  this->Lock.Lock();
+  int numberOfRunningTasks = this->NumberOfRunningTasks;
+  this->Lock.Unlock();
+  return numberOfRunningTasks;
+}
+
+//---------------------------------------------------------------------------
+std::vector<int> vtkSlicerTaskTestLogic::GetStartedTasks()
+{
+  this->Lock.Lock();
+  std::vector<int> startedTasks = this->StartedTasks;
+  this->Lock.Unlock();
+  return startedTasks;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerTaskTestLogic::SetHoldTasks(bool hold)
+{
+  this->Lock.Lock();
+  this->HoldTasks = hold;
+  this->Lock.Unlock();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerTaskTestLogic::ReleaseOneTask()
+{
+  this->Lock.Lock();
+  ++this->NumberOfReleasedTasks;
+  this->Lock.Unlock();
+}
+
+namespace
+{
+
+//---------------------------------------------------------------------------
+vtkSmartPointer<vtkSlicerTask> CreateTestTask(vtkSlicerTaskTestLogic* logic, int taskId, int priority = 0)
+{
+  vtkSmartPointer<vtkSlicerTask> task = vtkSmartPointer<vtkSlicerTask>::New();
+  task->SetTypeToProcessing();
+  task->SetPriority(priority);
+  task->SetTaskFunction(logic, (vtkSlicerTask::TaskFunctionPointer)
+                        &vtkSlicerTaskTestLogic::RunTask,
+                        reinterpret_cast<void*>(static_cast<size_t>(taskId)));
+  return task;
+}
+
+//---------------------------------------------------------------------------
+bool WaitForStartedTasks(vtkSlicerTaskTestLogic* logic, size_t numberOfStartedTasks, int numberOfRunningTasks)
+{
+  for (int i = 0; i < 1000; ++i)
+    {
+    if (logic->GetStartedTasks().size() >= numberOfStartedTasks
+      && logic->GetNumberOfRunningTasks() == numberOfRunningTasks)
+      {
+      return true;
+      }
+    itksys::SystemTools::Delay(10);
+    }
+  return false;
+}
+
+} // end of anonymous namespace
+
+//-----------------------------------------------------------------------------
+int vtkSlicerApplicationLogicTest2(int , char * [])
+{
+  vtkNew<vtkSlicerTaskTestLogic> logic;
+  vtkNew<vtkSlicerApplicationLogic> appLogic;
+
+  // Tasks are not accepted until the processing threads are created
+  vtkSmartPointer<vtkSlicerTask> task1 = CreateTestTask(logic.GetPointer(), 1);
+  CHECK_INT(appLogic->ScheduleTask(task1), false);
+
+  appLogic->SetNumberOfProcessingThreads(2);
+  CHECK_INT(appLogic->GetNumberOfProcessingThreads(), 2);
+  appLogic->CreateProcessingThread();
+
+  // Processing tasks run concurrently
+  logic->SetHoldTasks(true);
+  vtkSmartPointer<vtkSlicerTask> task2 = CreateTestTask(logic.GetPointer(), 2);
+  CHECK_INT(appLogic->ScheduleTask(task1), true);
+  CHECK_INT(appLogic->ScheduleTask(task2), true);
+  CHECK_BOOL(WaitForStartedTasks(logic.GetPointer(), 2, 2), true);
+
+  // Tasks wait in the queue while all threads are busy,
+  // higher priority tasks are started first
+  vtkSmartPointer<vtkSlicerTask> task3 = CreateTestTask(logic.GetPointer(), 3);
+  vtkSmartPointer<vtkSlicerTask> task4 = CreateTestTask(logic.GetPointer(), 4, 10);
+  vtkSmartPointer<vtkSlicerTask> task5 = CreateTestTask(logic.GetPointer(), 5);
+  CHECK_INT(appLogic->ScheduleTask(task3), true);
+  CHECK_INT(appLogic->ScheduleTask(task4), true);
+  CHECK_INT(appLogic->ScheduleTask(task5), true);
+  CHECK_INT(appLogic->GetNumberOfPendingTasks(), 3);
+
+  // Tasks that have not started yet can be cancelled
+  CHECK_BOOL(appLogic->CancelTask(task5), true);
+  CHECK_BOOL(appLogic->CancelTask(task1), false);
+  CHECK_INT(appLogic->GetNumberOfPendingTasks(), 2);
+
+  // Free one thread at a time so that the start order is the dequeue order
+  logic->ReleaseOneTask();
+  CHECK_BOOL(WaitForStartedTasks(logic.GetPointer(), 3, 2), true);
+  CHECK_INT(appLogic->GetNumberOfPendingTasks(), 1);
+  std::vector<int> startedTasks = logic->GetStartedTasks();
+  CHECK_INT(static_cast<int>(startedTasks.size()), 3);
+  CHECK_INT(startedTasks[2], 4);
+
+  logic->ReleaseOneTask();
+  CHECK_BOOL(WaitForStartedTasks(logic.GetPointer(), 4, 2), true);
+  CHECK_INT(appLogic->GetNumberOfPendingTasks(), 0);
+  startedTasks = logic->GetStartedTasks();
+  CHECK_INT(static_cast<int>(startedTasks.size()), 4);
+  CHECK_INT(startedTasks[3], 3);
+
+  logic->SetHoldTasks(false);
+  CHECK_BOOL(WaitForStartedTasks(logic.GetPointer(), 4, 0), true);
+
+  // Tasks are not accepted after the threads are terminated
+  appLogic->TerminateProcessingThread();
+  CHECK_INT(appLogic->ScheduleTask(task5), false);
+
+  return EXIT_SUCCESS;
+}
@@ -22,6 +22,7 @@
 
 // STD includes
 #include <cassert>
+#include <map>
 
 #ifdef linux
 #include "unistd.h"
@@ -55,6 +56,7 @@ typedef std::pair< vtkDataTransfer *, vtkMRMLNode * > TransferNodePair;
 vtkDataIOManagerLogic::vtkDataIOManagerLogic()
 {
   this->DataIOManager = NULL;
+  this->PendingDownloadsTaskScheduled = false;
 
   this->DataIOObserverManager = vtkObserverManager::New();
   this->DataIOObserverManager->GetCallbackCommand()->SetClientData(this);
@@ -409,14 +411,10 @@ int vtkDataIOManagerLogic::QueueRead ( vtkMRMLNode *node )
     //---
     //--- Schedule an ASYNCHRONOUS data transfer
     //---
-    vtkNew<vtkSlicerTask> task;
-    task->SetTypeToNetworking();
     transfer0->SetTransferStatus ( vtkDataTransfer::Pending );
-    task->SetTaskFunction(this, (vtkSlicerTask::TaskFunctionPointer)
-                          &vtkDataIOManagerLogic::ApplyTransfer, transfer0.GetPointer());
 
     // Schedule the transfer
-    if ( ! this->GetApplicationLogic()->ScheduleTask( task.GetPointer() ) )
+    if ( ! this->ScheduleDownload( transfer0.GetPointer() ) )
       {
       transfer0->SetTransferStatus( vtkDataTransfer::CompletedWithErrors);
       return 0;
@@ -463,14 +461,10 @@ int vtkDataIOManagerLogic::QueueRead ( vtkMRMLNode *node )
     if ( this->GetDataIOManager()->GetEnableAsynchronousIO() )
       {
       vtkDebugMacro("QueueRead: Schedule an ASYNCHRONOUS data transfer, n = " << n);
-      vtkNew<vtkSlicerTask> task;
-      task->SetTypeToNetworking();
       transfer1->SetTransferStatus ( vtkDataTransfer::Pending );
-      task->SetTaskFunction(this, (vtkSlicerTask::TaskFunctionPointer)
-                            &vtkDataIOManagerLogic::ApplyTransfer, transfer1.GetPointer());
 
       // Schedule the transfer
-      if ( ! this->GetApplicationLogic()->ScheduleTask( task.GetPointer() ) )
+      if ( ! this->ScheduleDownload( transfer1.GetPointer() ) )
         {
         transfer1->SetTransferStatus( vtkDataTransfer::CompletedWithErrors);
         return 0;
@@ -716,49 +710,22 @@ void vtkDataIOManagerLogic::ApplyTransfer( void *clientdata )
         {
         dt->SetTransferStatusNoModify ( vtkDataTransfer::Running );
         this->GetApplicationLogic()->RequestModified( dt );
-        handler->StageFileRead( source, dest);
-        dt->SetTransferStatusNoModify ( vtkDataTransfer::Completed );
-        this->GetApplicationLogic()->RequestModified( dt );
-
-        vtkMRMLStorableNode *storableNode = vtkMRMLStorableNode::SafeDownCast( node );
-        if ( !storableNode )
-          {
-          vtkErrorMacro( "ApplyTransfer: could not get storable node for scheduled data transfer" );
-          return;
-          }
-        // find the storage node that's been scheduled  and we're working on it
-        int storageNodeIndex = -1;
-        for (int i = 0; i < storableNode->GetNumberOfStorageNodes(); i++)
-          {
-          if (storableNode->GetNthStorageNode(i)->GetReadState() == vtkMRMLStorageNode::Transferring &&
-              strcmp(storableNode->GetNthStorageNode(i)->GetURI(),source) == 0)
-            {
-            vtkDebugMacro("ApplyTransfer: found a working storage node who's uri matches source " << source << " at " << i);
-            storageNodeIndex = i;
-            break;
-            }
-          }
-        if (storageNodeIndex == -1)
-          {
-          vtkErrorMacro("ApplyTransfer: unable to find a storage node in scheduled state.");
-          }
-        vtkMRMLStorageNode *storageNode = storableNode->GetNthStorageNode(storageNodeIndex);
-        if ( !storageNode )
-          {
-          vtkErrorMacro( "ApplyTransfer: no storage node for scheduled data transfer" );
-          return;
-          }
-        storageNode->SetDisableModifiedEvent( 1 );
-        // let the storage node know that the remote transfer is done
-        vtkDebugMacro("ApplyTransfer: setting storage node read state to transfer done for uri " << storageNode->GetURI());
-        storageNode->SetReadStateTransferDone();
-        storageNode->SetDisableModifiedEvent( 0 );
-        this->GetApplicationLogic()->RequestReadFile( node->GetID(), dest, 0, 0 );
+        std::vector<bool> downloaded = handler->StageFilesRead(
+          std::vector<std::string>( 1, source ), std::vector<std::string>( 1, dest ) );
+        dt->SetTransferStatusNoModify ( downloaded[0] ?
+          vtkDataTransfer::Completed : vtkDataTransfer::CompletedWithErrors );
+        this->FinishDownload( dt );
         }
       else
         {
         vtkDebugMacro("ApplyTransfer: stage file read on the handler..., source = " << source << ", dest = " << dest);
-        handler->StageFileRead( source, dest);
+        std::vector<bool> downloaded = handler->StageFilesRead(
+          std::vector<std::string>( 1, source ), std::vector<std::string>( 1, dest ) );
+        vtkCacheManager *cm = iom ? iom->GetCacheManager() : NULL;
+        if ( cm && downloaded[0] )
+          {
+          cm->AddCachedFile( source, dest );
+          }
         }
       }
     }
@@ -826,6 +793,153 @@ void vtkDataIOManagerLogic::ApplyTransfer( void *clientdata )
 
 
 
+//----------------------------------------------------------------------------
+bool vtkDataIOManagerLogic::ScheduleDownload( vtkDataTransfer *transfer )
+{
+  this->PendingDownloadsLock.Lock();
+  this->PendingDownloads.push_back( transfer );
+  bool taskScheduled = this->PendingDownloadsTaskScheduled;
+  this->PendingDownloadsTaskScheduled = true;
+  this->PendingDownloadsLock.Unlock();
+  if ( taskScheduled )
+    {
+    // the scheduled task picks up the download
+    return true;
+    }
+
+  vtkNew<vtkSlicerTask> task;
+  task->SetTypeToNetworking();
+  task->SetTaskFunction(this, (vtkSlicerTask::TaskFunctionPointer)
+                        &vtkDataIOManagerLogic::ApplyPendingDownloads, NULL);
+  if ( ! this->GetApplicationLogic()->ScheduleTask( task.GetPointer() ) )
+    {
+    this->PendingDownloadsLock.Lock();
+    this->PendingDownloads.clear();
+    this->PendingDownloadsTaskScheduled = false;
+    this->PendingDownloadsLock.Unlock();
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkDataIOManagerLogic::ApplyPendingDownloads( void * vtkNotUsed(clientdata) )
+{
+  // downloads that are queued while a batch is running are staged in the next batch
+  while ( true )
+    {
+    std::vector<vtkDataTransfer*> downloads;
+    this->PendingDownloadsLock.Lock();
+    downloads.swap( this->PendingDownloads );
+    if ( downloads.empty() )
+      {
+      this->PendingDownloadsTaskScheduled = false;
+      this->PendingDownloadsLock.Unlock();
+      return;
+      }
+    this->PendingDownloadsLock.Unlock();
+
+    std::map< vtkURIHandler*, std::vector<vtkDataTransfer*> > downloadsByHandler;
+    for ( std::vector<vtkDataTransfer*>::iterator it = downloads.begin(); it != downloads.end(); ++it )
+      {
+      vtkDataTransfer *dt = *it;
+      if ( dt->GetHandler() == NULL || dt->GetSourceURI() == NULL || dt->GetDestinationURI() == NULL )
+        {
+        vtkErrorMacro("ApplyPendingDownloads: either no handler, or source or dest are null.");
+        continue;
+        }
+      dt->SetTransferStatusNoModify ( vtkDataTransfer::Running );
+      this->GetApplicationLogic()->RequestModified( dt );
+      downloadsByHandler[dt->GetHandler()].push_back( dt );
+      }
+
+    for ( std::map< vtkURIHandler*, std::vector<vtkDataTransfer*> >::iterator handlerIt = downloadsByHandler.begin();
+          handlerIt != downloadsByHandler.end(); ++handlerIt )
+      {
+      std::vector<std::string> sources;
+      std::vector<std::string> destinations;
+      for ( std::vector<vtkDataTransfer*>::iterator it = handlerIt->second.begin(); it != handlerIt->second.end(); ++it )
+        {
+        sources.push_back( (*it)->GetSourceURI() );
+        destinations.push_back( (*it)->GetDestinationURI() );
+        }
+      vtkDebugMacro("ApplyPendingDownloads: stage " << sources.size() << " files on the handler");
+      std::vector<bool> downloaded = handlerIt->first->StageFilesRead( sources, destinations );
+      for ( size_t downloadIndex = 0; downloadIndex < handlerIt->second.size(); ++downloadIndex )
+        {
+        vtkDataTransfer *dt = handlerIt->second[downloadIndex];
+        dt->SetTransferStatusNoModify ( downloaded[downloadIndex] ?
+          vtkDataTransfer::Completed : vtkDataTransfer::CompletedWithErrors );
+        this->FinishDownload( dt );
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkDataIOManagerLogic::FinishDownload( vtkDataTransfer *dt )
+{
+  const char *source = dt->GetSourceURI();
+  const char *dest = dt->GetDestinationURI();
+
+  //--- the file in the destination may be a stale version from the cache,
+  //--- so the status set by the transfer tells whether it was downloaded
+  bool downloaded = ( dt->GetTransferStatus() == vtkDataTransfer::Completed );
+  vtkCacheManager *cm = this->GetDataIOManager() ? this->GetDataIOManager()->GetCacheManager() : NULL;
+  if ( downloaded && cm && !cm->AddCachedFile( source, dest ) )
+    {
+    downloaded = false;
+    dt->SetTransferStatusNoModify ( vtkDataTransfer::CompletedWithErrors );
+    }
+  if ( !downloaded )
+    {
+    vtkErrorMacro( "FinishDownload: " << source << " was not downloaded" );
+    }
+  this->GetApplicationLogic()->RequestModified( dt );
+
+  vtkMRMLNode *node = this->GetMRMLScene()->GetNodeByID ((dt->GetTransferNodeID() ));
+  vtkMRMLStorableNode *storableNode = vtkMRMLStorableNode::SafeDownCast( node );
+  if ( !storableNode )
+    {
+    vtkErrorMacro( "FinishDownload: could not get storable node for scheduled data transfer" );
+    return;
+    }
+  // find the storage node that's been scheduled  and we're working on it
+  int storageNodeIndex = -1;
+  for (int i = 0; i < storableNode->GetNumberOfStorageNodes(); i++)
+    {
+    if (storableNode->GetNthStorageNode(i)->GetReadState() == vtkMRMLStorageNode::Transferring &&
+        strcmp(storableNode->GetNthStorageNode(i)->GetURI(),source) == 0)
+      {
+      vtkDebugMacro("FinishDownload: found a working storage node who's uri matches source " << source << " at " << i);
+      storageNodeIndex = i;
+      break;
+      }
+    }
+  if (storageNodeIndex == -1)
+    {
+    vtkErrorMacro("FinishDownload: unable to find a storage node in scheduled state.");
+    }
+  vtkMRMLStorageNode *storageNode = storableNode->GetNthStorageNode(storageNodeIndex);
+  if ( !storageNode )
+    {
+    vtkErrorMacro( "FinishDownload: no storage node for scheduled data transfer" );
+    return;
+    }
+  storageNode->SetDisableModifiedEvent( 1 );
+  if ( !downloaded )
+    {
+    storageNode->SetReadStateCancelled();
+    storageNode->SetDisableModifiedEvent( 0 );
+    return;
+    }
+  // let the storage node know that the remote transfer is done
+  vtkDebugMacro("FinishDownload: setting storage node read state to transfer done for uri " << storageNode->GetURI());
+  storageNode->SetReadStateTransferDone();
+  storageNode->SetDisableModifiedEvent( 0 );
+  this->GetApplicationLogic()->RequestReadFile( node->GetID(), dest, 0, 0 );
+}
+
 //----------------------------------------------------------------------------
 void vtkDataIOManagerLogic::ProgressCallback ( void * vtkNotUsed(who) )
 {
@@ -15,6 +15,12 @@
 #include "vtkDataIOManager.h"
 #include "vtkMRMLNode.h"
 
+// ITK includes
+#include <itkMutexLock.h>
+
+// STD includes
+#include <vector>
+
 
 #ifndef vtkObjectPointer
 #define vtkObjectPointer(xx) (reinterpret_cast <vtkObject **>( (xx) ))
@@ -45,6 +51,12 @@ class VTK_SLICER_BASE_LOGIC_EXPORT vtkDataIOManagerLogic : public vtkSlicerModul
   /// The method that executes the data transfer in another thread
   virtual void ApplyTransfer(void *clientdata);
 
+  ///
+  /// The method that executes all pending downloads in another thread.
+  /// Downloads that use the same URI handler are staged together, so that
+  /// the handler can run them concurrently.
+  virtual void ApplyPendingDownloads(void *clientdata);
+
   /// Description
   /// Communicates progress back to the DataIOManager
   static void ProgressCallback ( void * );
@@ -70,6 +82,19 @@ class VTK_SLICER_BASE_LOGIC_EXPORT vtkDataIOManagerLogic : public vtkSlicerModul
   vtkObserverManager* DataIOObserverManager;
   static void DataIOManagerCallback(vtkObject *caller, unsigned long eid, void *clientData, void *callData);
   virtual void ProcessDataIOManagerEvents( vtkObject *caller, unsigned long event, void *calldata );
+
+  /// Add a download to the pending downloads and schedule a networking task
+  /// that runs them, unless one is already scheduled.
+  /// Returns false if the task cannot be scheduled.
+  bool ScheduleDownload(vtkDataTransfer *transfer);
+
+  /// Add the downloaded file to the cache, let the storage node know that
+  /// the transfer is done and request reading the file.
+  void FinishDownload(vtkDataTransfer *transfer);
+
+  itk::SimpleMutexLock PendingDownloadsLock;
+  std::vector<vtkDataTransfer*> PendingDownloads;
+  bool PendingDownloadsTaskScheduled;
 };
 
 #endif
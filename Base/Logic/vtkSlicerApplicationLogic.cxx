@@ -47,12 +47,51 @@
 # include <sys/resource.h>
 #endif
 
+#include <deque>
 #include <queue>
 
 #include "vtkSlicerApplicationLogicRequests.h"
 
 //----------------------------------------------------------------------------
-class ProcessingTaskQueue : public std::queue<vtkSmartPointer<vtkSlicerTask> > {};
+/// Scheduled tasks ordered by decreasing priority. Tasks with the same
+/// priority are kept in the order they were scheduled.
+class ProcessingTaskQueue : public std::deque<vtkSmartPointer<vtkSlicerTask> >
+{
+public:
+  void Push(vtkSlicerTask* task)
+    {
+    iterator it = this->begin();
+    while (it != this->end() && (*it)->GetPriority() >= task->GetPriority())
+      {
+      ++it;
+      }
+    this->insert(it, task);
+    }
+  /// Remove and return the first task of the given type, NULL if none
+  vtkSmartPointer<vtkSlicerTask> Pop(int taskType)
+    {
+    for (iterator it = this->begin(); it != this->end(); ++it)
+      {
+      if ((*it)->GetType() == taskType)
+        {
+        vtkSmartPointer<vtkSlicerTask> task = *it;
+        this->erase(it);
+        return task;
+        }
+      }
+    return NULL;
+    }
+  bool Remove(vtkSlicerTask* task)
+    {
+    iterator it = std::find(this->begin(), this->end(), task);
+    if (it == this->end())
+      {
+      return false;
+      }
+    this->erase(it);
+    return true;
+    }
+};
 class ModifiedQueue : public std::queue<vtkSmartPointer<vtkObject> > {};
 class ReadDataQueue : public std::queue<DataRequest*> {};
 class WriteDataQueue : public std::queue<DataRequest*> {};
@@ -64,21 +103,17 @@ vtkStandardNewMacro(vtkSlicerApplicationLogic);
 vtkSlicerApplicationLogic::vtkSlicerApplicationLogic()
 {
   this->ProcessingThreader = itk::MultiThreader::New();
-  this->ProcessingThreadId = -1;
+  this->NumberOfProcessingThreads = 4;
   this->ProcessingThreadActive = false;
-  this->ProcessingThreadActiveLock = itk::MutexLock::New();
-  this->ProcessingTaskQueueLock = itk::MutexLock::New();
+  this->ProcessingTaskQueueCondition = itk::ConditionVariable::New();
 
   this->ModifiedQueueActive = false;
-  this->ModifiedQueueActiveLock = itk::MutexLock::New();
   this->ModifiedQueueLock = itk::MutexLock::New();
 
   this->ReadDataQueueActive = false;
-  this->ReadDataQueueActiveLock = itk::MutexLock::New();
   this->ReadDataQueueLock = itk::MutexLock::New();
 
   this->WriteDataQueueActive = false;
-  this->WriteDataQueueActiveLock = itk::MutexLock::New();
   this->WriteDataQueueLock = itk::MutexLock::New();
 
   this->InternalTaskQueue = new ProcessingTaskQueue;
@@ -91,21 +126,8 @@ vtkSlicerApplicationLogic::vtkSlicerApplicationLogic()
 //----------------------------------------------------------------------------
 vtkSlicerApplicationLogic::~vtkSlicerApplicationLogic()
 {
-  // Note that TerminateThread does not kill a thread, it only waits
-  // for the thread to finish.  We need to signal the thread that we
-  // want to terminate
-  if (this->ProcessingThreadId != -1 && this->ProcessingThreader)
-    {
-    // Signal the processingThread that we are terminating.
-    this->ProcessingThreadActiveLock->Lock();
-    this->ProcessingThreadActive = false;
-    this->ProcessingThreadActiveLock->Unlock();
-
-    // Wait for the thread to finish and clean up the state of the threader
-    this->ProcessingThreader->TerminateThread( this->ProcessingThreadId );
-
-    this->ProcessingThreadId = -1;
-    }
+  // Wait for the running tasks to finish and clean up the state of the threader
+  this->TerminateProcessingThread();
 
   delete this->InternalTaskQueue;
 
@@ -125,7 +147,10 @@ vtkSlicerApplicationLogic::~vtkSlicerApplicationLogic()
 //----------------------------------------------------------------------------
 unsigned int vtkSlicerApplicationLogic::GetReadDataQueueSize()
 {
-  return static_cast<unsigned int>( (*this->InternalReadDataQueue).size() );
+  this->ReadDataQueueLock->Lock();
+  unsigned int size = static_cast<unsigned int>( (*this->InternalReadDataQueue).size() );
+  this->ReadDataQueueLock->Unlock();
+  return size;
 }
 
 //-----------------------------------------------------------------------------
@@ -181,23 +206,26 @@ void vtkSlicerApplicationLogic::PrintSelf(ostream& os, vtkIndent indent)
   this->vtkObject::PrintSelf(os, indent);
 
   os << indent << "SlicerApplicationLogic:             " << this->GetClassName() << "\n";
+  os << indent << "NumberOfProcessingThreads:          " << this->NumberOfProcessingThreads << "\n";
 }
 
 //----------------------------------------------------------------------------
 void vtkSlicerApplicationLogic::CreateProcessingThread()
 {
-  if (this->ProcessingThreadId == -1)
+  if (this->ProcessingThreadIDs.empty())
     {
-    this->ProcessingThreadActiveLock->Lock();
+    this->ProcessingTaskQueueLock.Lock();
     this->ProcessingThreadActive = true;
-    this->ProcessingThreadActiveLock->Unlock();
+    this->ProcessingTaskQueueLock.Unlock();
 
-    this->ProcessingThreadId
-      = this->ProcessingThreader
-      ->SpawnThread(vtkSlicerApplicationLogic::ProcessingThreaderCallback,
-                    this);
+    for (int i = 0; i < this->NumberOfProcessingThreads; ++i)
+      {
+      this->ProcessingThreadIDs.push_back( this->ProcessingThreader
+            ->SpawnThread(vtkSlicerApplicationLogic::ProcessingThreaderCallback,
+                      this) );
+      }
 
-    // Start four network threads (TODO: make the number of threads a setting)
+    // Start a single network thread
     this->NetworkingThreadIDs.push_back ( this->ProcessingThreader
           ->SpawnThread(vtkSlicerApplicationLogic::NetworkingThreaderCallback,
                     this) );
@@ -205,28 +233,19 @@ void vtkSlicerApplicationLogic::CreateProcessingThread()
      * TODO: it looks like curl is not thread safe by default
      * - maybe there's a setting that cmcurl can have
      *   similar to the --enable-threading of the standard curl build
-     *
-    this->NetworkingThreadIDs.push_back ( this->ProcessingThreader
-          ->SpawnThread(vtkSlicerApplicationLogic::NetworkingThreaderCallback,
-                    this) );
-    this->NetworkingThreadIDs.push_back ( this->ProcessingThreader
-          ->SpawnThread(vtkSlicerApplicationLogic::NetworkingThreaderCallback,
-                    this) );
-    this->NetworkingThreadIDs.push_back ( this->ProcessingThreader
-          ->SpawnThread(vtkSlicerApplicationLogic::NetworkingThreaderCallback,
-                    this) );
-    */
+     *   so that more networking threads can be started
+     */
 
     // Setup the communication channel back to the main thread
-    this->ModifiedQueueActiveLock->Lock();
+    this->ModifiedQueueLock->Lock();
     this->ModifiedQueueActive = true;
-    this->ModifiedQueueActiveLock->Unlock();
-    this->ReadDataQueueActiveLock->Lock();
+    this->ModifiedQueueLock->Unlock();
+    this->ReadDataQueueLock->Lock();
     this->ReadDataQueueActive = true;
-    this->ReadDataQueueActiveLock->Unlock();
-    this->WriteDataQueueActiveLock->Lock();
+    this->ReadDataQueueLock->Unlock();
+    this->WriteDataQueueLock->Lock();
     this->WriteDataQueueActive = true;
-    this->WriteDataQueueActiveLock->Unlock();
+    this->WriteDataQueueLock->Unlock();
 
     int delay = 1000;
     this->InvokeEvent(vtkSlicerApplicationLogic::RequestModifiedEvent, &delay);
@@ -238,36 +257,44 @@ void vtkSlicerApplicationLogic::CreateProcessingThread()
 //----------------------------------------------------------------------------
 void vtkSlicerApplicationLogic::TerminateProcessingThread()
 {
-  if (this->ProcessingThreadId != -1)
+  if (!this->ProcessingThreadIDs.empty())
     {
-    this->ModifiedQueueActiveLock->Lock();
+    this->ModifiedQueueLock->Lock();
     this->ModifiedQueueActive = false;
-    this->ModifiedQueueActiveLock->Unlock();
+    this->ModifiedQueueLock->Unlock();
 
-    this->ReadDataQueueActiveLock->Lock();
+    this->ReadDataQueueLock->Lock();
     this->ReadDataQueueActive = false;
-    this->ReadDataQueueActiveLock->Unlock();
+    this->ReadDataQueueLock->Unlock();
 
-    this->WriteDataQueueActiveLock->Lock();
+    this->WriteDataQueueLock->Lock();
     this->WriteDataQueueActive = false;
-    this->WriteDataQueueActiveLock->Unlock();
+    this->WriteDataQueueLock->Unlock();
 
-    this->ProcessingThreadActiveLock->Lock();
+    // Signal the threads that we are terminating and wake up the idle ones.
+    // Tasks that have not started yet are discarded.
+    this->ProcessingTaskQueueLock.Lock();
     this->ProcessingThreadActive = false;
-    this->ProcessingThreadActiveLock->Unlock();
-
-    this->ProcessingThreader->TerminateThread( this->ProcessingThreadId );
-    this->ProcessingThreadId = -1;
+    (*this->InternalTaskQueue).clear();
+    this->ProcessingTaskQueueCondition->Broadcast();
+    this->ProcessingTaskQueueLock.Unlock();
 
+    // Note that TerminateThread does not kill a thread, it only waits
+    // for the thread to finish.
     std::vector<int>::const_iterator idIterator;
-    idIterator = this->NetworkingThreadIDs.begin();
-    while (idIterator != this->NetworkingThreadIDs.end())
+    for (idIterator = this->ProcessingThreadIDs.begin();
+         idIterator != this->ProcessingThreadIDs.end(); ++idIterator)
       {
       this->ProcessingThreader->TerminateThread( *idIterator );
-      ++idIterator;
       }
-    this->NetworkingThreadIDs.clear();
+    this->ProcessingThreadIDs.clear();
 
+    for (idIterator = this->NetworkingThreadIDs.begin();
+         idIterator != this->NetworkingThreadIDs.end(); ++idIterator)
+      {
+      this->ProcessingThreader->TerminateThread( *idIterator );
+      }
+    this->NetworkingThreadIDs.clear();
     }
 }
 
@@ -310,50 +337,11 @@ vtkSlicerApplicationLogic
 //----------------------------------------------------------------------------
 void vtkSlicerApplicationLogic::ProcessProcessingTasks()
 {
-  int active = true;
-  vtkSmartPointer<vtkSlicerTask> task = 0;
-
-  while (active)
-    {
-    // Check to see if we should be shutting down
-    this->ProcessingThreadActiveLock->Lock();
-    active = this->ProcessingThreadActive;
-    this->ProcessingThreadActiveLock->Unlock();
-
-    if (active)
-      {
-      // pull a task off the queue
-      this->ProcessingTaskQueueLock->Lock();
-      if ((*this->InternalTaskQueue).size() > 0)
-        {
-        // std::cout << "Number of queued tasks: " << (*this->InternalTaskQueue).size() << std::endl;
-
-        // only handle processing tasks in this thread
-        task = (*this->InternalTaskQueue).front();
-        if ( task->GetType() == vtkSlicerTask::Processing )
-          {
-          (*this->InternalTaskQueue).pop();
-          }
-        else
-          {
-          task = NULL;
-          }
-        }
-      this->ProcessingTaskQueueLock->Unlock();
-
-      // process the task (should this be in a separate thread?)
-      if (task)
-        {
-        task->Execute();
-        task = 0;
-        }
-      }
-
-    // busy wait
-    itksys::SystemTools::Delay(100);
-    }
+  // only handle processing tasks in this thread
+  this->ProcessTasks(vtkSlicerTask::Processing);
 }
 
+//----------------------------------------------------------------------------
 ITK_THREAD_RETURN_TYPE
 vtkSlicerApplicationLogic
 ::NetworkingThreaderCallback( void *arg )
@@ -392,81 +380,87 @@ vtkSlicerApplicationLogic
 //----------------------------------------------------------------------------
 void vtkSlicerApplicationLogic::ProcessNetworkingTasks()
 {
-  int active = true;
-  vtkSmartPointer<vtkSlicerTask> task = 0;
+  // only handle networking tasks in this thread
+  this->ProcessTasks(vtkSlicerTask::Networking);
+}
 
-  while (active)
+//----------------------------------------------------------------------------
+void vtkSlicerApplicationLogic::ProcessTasks(int taskType)
+{
+  while (true)
     {
-    // Check to see if we should be shutting down
-    this->ProcessingThreadActiveLock->Lock();
-    active = this->ProcessingThreadActive;
-    this->ProcessingThreadActiveLock->Unlock();
-
-    if (active)
+    // pull a task off the queue, wait if there is none
+    vtkSmartPointer<vtkSlicerTask> task;
+    this->ProcessingTaskQueueLock.Lock();
+    while (this->ProcessingThreadActive)
       {
-      // pull a task off the queue
-      this->ProcessingTaskQueueLock->Lock();
-      if ((*this->InternalTaskQueue).size() > 0)
-        {
-        // std::cout << "Number of queued tasks: " << (*this->InternalTaskQueue).size() << std::endl;
-        task = (*this->InternalTaskQueue).front();
-        if ( task->GetType() == vtkSlicerTask::Networking )
-          {
-          (*this->InternalTaskQueue).pop();
-          }
-        else
-          {
-          task = NULL;
-          }
-        }
-      this->ProcessingTaskQueueLock->Unlock();
-
-      // process the task (should this be in a separate thread?)
+      task = (*this->InternalTaskQueue).Pop(taskType);
       if (task)
         {
-        task->Execute();
-        task = 0;
+        break;
         }
+      this->ProcessingTaskQueueCondition->Wait(&this->ProcessingTaskQueueLock);
       }
+    this->ProcessingTaskQueueLock.Unlock();
 
-    // busy wait
-    itksys::SystemTools::Delay(100);
+    if (!task)
+      {
+      // shutting down
+      return;
+      }
+    task->Execute();
     }
 }
 
 //----------------------------------------------------------------------------
 int vtkSlicerApplicationLogic::ScheduleTask( vtkSlicerTask *task )
 {
-  // only schedule a task if the processing task is up
-  this->ProcessingThreadActiveLock->Lock();
-  int active = this->ProcessingThreadActive;
-  this->ProcessingThreadActiveLock->Unlock();
-  if (!active)
+  this->ProcessingTaskQueueLock.Lock();
+  // only schedule a task if the processing threads are up
+  if (!this->ProcessingThreadActive)
     {
+    this->ProcessingTaskQueueLock.Unlock();
     return false;
     }
-
-  this->ProcessingTaskQueueLock->Lock();
-  (*this->InternalTaskQueue).push( task );
-  this->ProcessingTaskQueueLock->Unlock();
+  (*this->InternalTaskQueue).Push( task );
+  // wake up all threads, only the ones handling this type of task
+  // will find something to do
+  this->ProcessingTaskQueueCondition->Broadcast();
+  this->ProcessingTaskQueueLock.Unlock();
   return true;
 }
 
+//----------------------------------------------------------------------------
+bool vtkSlicerApplicationLogic::CancelTask( vtkSlicerTask *task )
+{
+  this->ProcessingTaskQueueLock.Lock();
+  bool removed = (*this->InternalTaskQueue).Remove( task );
+  this->ProcessingTaskQueueLock.Unlock();
+  return removed;
+}
+
+//----------------------------------------------------------------------------
+int vtkSlicerApplicationLogic::GetNumberOfPendingTasks()
+{
+  this->ProcessingTaskQueueLock.Lock();
+  int numberOfTasks = static_cast<int>( (*this->InternalTaskQueue).size() );
+  this->ProcessingTaskQueueLock.Unlock();
+  return numberOfTasks;
+}
+
 //----------------------------------------------------------------------------
 vtkMTimeType vtkSlicerApplicationLogic::RequestModified(vtkObject *obj)
 {
+  this->ModifiedQueueLock->Lock();
   // only request a Modified if the Modified queue is up
-  this->ModifiedQueueActiveLock->Lock();
-  int active = this->ModifiedQueueActive;
-  this->ModifiedQueueActiveLock->Unlock();
-  if (!active)
+  if (!this->ModifiedQueueActive)
     {
+    this->ModifiedQueueLock->Unlock();
     // could not request the Modified
     return 0;
     }
 
   obj->Register(this);
-  this->ModifiedQueueLock->Lock();
   this->RequestTimeStamp.Modified();
   vtkMTimeType uid = this->RequestTimeStamp.GetMTime();
   (*this->InternalModifiedQueue).push(obj);
@@ -477,19 +471,17 @@ vtkMTimeType vtkSlicerApplicationLogic::RequestModified(vtkObject *obj)
 //----------------------------------------------------------------------------
 vtkMTimeType vtkSlicerApplicationLogic::RequestReadFile(const char *refNode, const char *filename, int displayData, int deleteFile)
 {
+  this->ReadDataQueueLock->Lock();
   // only request to read a file if the ReadData queue is up
-  this->ReadDataQueueActiveLock->Lock();
-  int active = this->ReadDataQueueActive;
-  this->ReadDataQueueActiveLock->Unlock();
-  if (!active)
-  {
+  if (!this->ReadDataQueueActive)
+    {
+    this->ReadDataQueueLock->Unlock();
     // could not request the record be added to the queue
     return 0;
-  }
+    }
 
-  this->ReadDataQueueLock->Lock();
   this->RequestTimeStamp.Modified();
-  int uid = this->RequestTimeStamp.GetMTime();
+  vtkMTimeType uid = this->RequestTimeStamp.GetMTime();
   (*this->InternalReadDataQueue).push(
     new ReadDataRequestFile(refNode, filename, displayData, deleteFile, uid));
   this->ReadDataQueueLock->Unlock();
@@ -499,17 +491,15 @@ vtkMTimeType vtkSlicerApplicationLogic::RequestReadFile(const char *refNode, con
 //----------------------------------------------------------------------------
 vtkMTimeType vtkSlicerApplicationLogic::RequestUpdateParentTransform(const std::string &refNode, const std::string& parentTransformNode)
 {
+  this->ReadDataQueueLock->Lock();
   // only request to read a file if the ReadData queue is up
-  this->ReadDataQueueActiveLock->Lock();
-  int active = this->ReadDataQueueActive;
-  this->ReadDataQueueActiveLock->Unlock();
-  if (!active)
+  if (!this->ReadDataQueueActive)
     {
+    this->ReadDataQueueLock->Unlock();
     // could not request the record be added to the queue
     return 0;
     }
 
-  this->ReadDataQueueLock->Lock();
   this->RequestTimeStamp.Modified();
   vtkMTimeType uid = this->RequestTimeStamp.GetMTime();
   (*this->InternalReadDataQueue).push(new ReadDataRequestUpdateParentTransform(refNode, parentTransformNode, uid));
@@ -520,17 +510,15 @@ vtkMTimeType vtkSlicerApplicationLogic::RequestUpdateParentTransform(const std::
 //----------------------------------------------------------------------------
 vtkMTimeType vtkSlicerApplicationLogic::RequestUpdateSubjectHierarchyLocation(const std::string &updatedNode, const std::string& siblingNode)
 {
+  this->ReadDataQueueLock->Lock();
   // only request to read a file if the ReadData queue is up
-  this->ReadDataQueueActiveLock->Lock();
-  int active = this->ReadDataQueueActive;
-  this->ReadDataQueueActiveLock->Unlock();
-  if (!active)
+  if (!this->ReadDataQueueActive)
     {
+    this->ReadDataQueueLock->Unlock();
     // could not request the record be added to the queue
     return 0;
     }
 
-  this->ReadDataQueueLock->Lock();
   this->RequestTimeStamp.Modified();
   vtkMTimeType uid = this->RequestTimeStamp.GetMTime();
   (*this->InternalReadDataQueue).push(new ReadDataRequestUpdateSubjectHierarchyLocation(updatedNode, siblingNode, uid));
@@ -541,17 +529,15 @@ vtkMTimeType vtkSlicerApplicationLogic::RequestUpdateSubjectHierarchyLocation(co
 //----------------------------------------------------------------------------
 vtkMTimeType vtkSlicerApplicationLogic::RequestWriteData(const char *refNode, const char *filename)
 {
+  this->WriteDataQueueLock->Lock();
   // only request to write a file if the WriteData queue is up
-  this->WriteDataQueueActiveLock->Lock();
-  int active = this->WriteDataQueueActive;
-  this->WriteDataQueueActiveLock->Unlock();
-  if (!active)
+  if (!this->WriteDataQueueActive)
     {
+    this->WriteDataQueueLock->Unlock();
     // could not request the record be added to the queue
     return 0;
     }
 
-  this->WriteDataQueueLock->Lock();
   this->RequestTimeStamp.Modified();
   vtkMTimeType uid = this->RequestTimeStamp.GetMTime();
   (*this->InternalWriteDataQueue).push(
@@ -568,17 +554,15 @@ vtkMTimeType vtkSlicerApplicationLogic::RequestReadScene(
     std::vector<std::string> &sourceIDs,
     int displayData, int deleteFile)
 {
+  this->ReadDataQueueLock->Lock();
   // only request to read a file if the ReadData queue is up
-  this->ReadDataQueueActiveLock->Lock();
-  int active = this->ReadDataQueueActive;
-  this->ReadDataQueueActiveLock->Unlock();
-  if (!active)
+  if (!this->ReadDataQueueActive)
     {
+    this->ReadDataQueueLock->Unlock();
     // could not request the record be added to the queue
     return 0;
     }
 
-  this->ReadDataQueueLock->Lock();
   this->RequestTimeStamp.Modified();
   vtkMTimeType uid = this->RequestTimeStamp.GetMTime();
   (*this->InternalReadDataQueue).push(
@@ -590,18 +574,16 @@ vtkMTimeType vtkSlicerApplicationLogic::RequestReadScene(
 //----------------------------------------------------------------------------
 void vtkSlicerApplicationLogic::ProcessModified()
 {
+  vtkSmartPointer<vtkObject> obj = 0;
+  this->ModifiedQueueLock->Lock();
   // Check to see if we should be shutting down
-  this->ModifiedQueueActiveLock->Lock();
-  int active = this->ModifiedQueueActive;
-  this->ModifiedQueueActiveLock->Unlock();
-  if (!active)
+  if (!this->ModifiedQueueActive)
     {
+    this->ModifiedQueueLock->Unlock();
     return;
     }
 
-  vtkSmartPointer<vtkObject> obj = 0;
   // pull an object off the queue to modify
-  this->ModifiedQueueLock->Lock();
   if ((*this->InternalModifiedQueue).size() > 0)
     {
     obj = (*this->InternalModifiedQueue).front();
@@ -628,25 +610,24 @@ void vtkSlicerApplicationLogic::ProcessModified()
 
   // schedule the next timer sooner in case there is stuff in the queue
   // otherwise for a while later
+  this->ModifiedQueueLock->Lock();
   int delay = (*this->InternalModifiedQueue).size() > 0 ? 0: 200;
+  this->ModifiedQueueLock->Unlock();
   this->InvokeEvent(vtkSlicerApplicationLogic::RequestModifiedEvent, &delay);
 }
 
 //----------------------------------------------------------------------------
 void vtkSlicerApplicationLogic::ProcessReadData()
 {
+  // pull an object off the queue
+  DataRequest* req = NULL;
+  this->ReadDataQueueLock->Lock();
   // Check to see if we should be shutting down
-  this->ReadDataQueueActiveLock->Lock();
-  int active = this->ReadDataQueueActive;
-  this->ReadDataQueueActiveLock->Unlock();
-  if (!active)
+  if (!this->ReadDataQueueActive)
     {
+    this->ReadDataQueueLock->Unlock();
     return;
     }
-
-  // pull an object off the queue
-  DataRequest* req = NULL;
-  this->ReadDataQueueLock->Lock();
   if ((*this->InternalReadDataQueue).size() > 0)
     {
     req = (*this->InternalReadDataQueue).front();
@@ -662,7 +643,9 @@ void vtkSlicerApplicationLogic::ProcessReadData()
     delete req;
     }
 
+  this->ReadDataQueueLock->Lock();
   int delay = (*this->InternalReadDataQueue).size() > 0 ? 0: 200;
+  this->ReadDataQueueLock->Unlock();
   // schedule the next timer sooner in case there is stuff in the queue
   // otherwise for a while later
   this->InvokeEvent(vtkSlicerApplicationLogic::RequestReadDataEvent, &delay);
@@ -676,18 +659,15 @@ void vtkSlicerApplicationLogic::ProcessReadData()
 //----------------------------------------------------------------------------
 void vtkSlicerApplicationLogic::ProcessWriteData()
 {
+  // pull an object off the queue
+  DataRequest *req = NULL;
+  this->WriteDataQueueLock->Lock();
   // Check to see if we should be shutting down
-  this->WriteDataQueueActiveLock->Lock();
-  int active = this->WriteDataQueueActive;
-  this->WriteDataQueueActiveLock->Unlock();
-  if (!active)
+  if (!this->WriteDataQueueActive)
     {
+    this->WriteDataQueueLock->Unlock();
     return;
     }
-
-  // pull an object off the queue
-  DataRequest *req = NULL;
-  this->WriteDataQueueLock->Lock();
   if ((*this->InternalWriteDataQueue).size() > 0)
     {
     req = (*this->InternalWriteDataQueue).front();
@@ -703,7 +683,9 @@ void vtkSlicerApplicationLogic::ProcessWriteData()
 
     // schedule the next timer sooner in case there is stuff in the queue
     // otherwise for a while later
+    this->WriteDataQueueLock->Lock();
     int delay = (*this->InternalWriteDataQueue).size() > 0 ? 0 : 200;
+    this->WriteDataQueueLock->Unlock();
     this->InvokeEvent(vtkSlicerApplicationLogic::RequestWriteDataEvent, &delay);
     if (uid)
       {
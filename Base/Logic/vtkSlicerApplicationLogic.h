@@ -28,6 +28,7 @@
 #include <vtkCollection.h>
 
 // ITK includes
+#include <itkConditionVariable.h>
 #include <itkMultiThreader.h>
 #include <itkMutexLock.h>
 
@@ -69,11 +70,22 @@ class VTK_SLICER_BASE_LOGIC_EXPORT vtkSlicerApplicationLogic
   /// (display it in the Fiducials GUI)
   void PropagateFiducialListSelection();
 
-  /// Create a thread for processing
+  /// Create the threads for processing and networking tasks
+  /// \sa SetNumberOfProcessingThreads(), ScheduleTask()
   void CreateProcessingThread();
 
-  /// Shutdown the processing thread
+  /// Shutdown the processing and networking threads.
+  /// Waits for the running tasks to complete, tasks that have not
+  /// started yet are discarded.
   void TerminateProcessingThread();
+
+  /// Number of threads that execute processing tasks (e.g., CLI modules)
+  /// concurrently. Takes effect the next time the processing threads
+  /// are created. Default is 4.
+  /// \sa CreateProcessingThread()
+  vtkSetClampMacro(NumberOfProcessingThreads, int, 1, ITK_MAX_THREADS - 1);
+  vtkGetMacro(NumberOfProcessingThreads, int);
+
   /// List of events potentially fired by the application logic
   enum RequestEvents
     {
@@ -90,8 +102,19 @@ class VTK_SLICER_BASE_LOGIC_EXPORT vtkSlicerApplicationLogic
   /// Schedule a task to run in the processing thread. Returns true if
   /// task was successfully scheduled. ScheduleTask() is called from the
   /// main thread to run something in the processing thread.
+  /// Tasks with higher priority are started first, tasks with the same
+  /// priority are started in the order they were scheduled.
+  /// \sa vtkSlicerTask::SetPriority(), CancelTask()
   int ScheduleTask( vtkSlicerTask* );
 
+  /// Remove a scheduled task that has not started yet.
+  /// Returns true if the task was removed from the queue, false if
+  /// it is already running, completed or was never scheduled.
+  bool CancelTask( vtkSlicerTask* );
+
+  /// Return the number of scheduled tasks that have not started yet.
+  int GetNumberOfPendingTasks();
+
   /// Request a Modified call on an object.  This method allows a
   /// processing thread to request a Modified call on an object to be
   /// performed in the main thread.  This allows the call to Modified
@@ -223,6 +246,10 @@ protected:
   /// Networking Task processing loop that is run in a networking thread
   void ProcessNetworkingTasks();
 
+  /// Run the tasks of the given type until the threads are terminated.
+  /// Waits for new tasks when the queue is empty.
+  void ProcessTasks(int taskType);
+
   /// Process a request to read data into a scene.  This method is
   /// called by ProcessReadData() in the application main thread
   /// because calls to load data will cause a Modified() on a node
@@ -235,16 +262,17 @@ private:
   void operator=(const vtkSlicerApplicationLogic&);
 
   itk::MultiThreader::Pointer ProcessingThreader;
-  itk::MutexLock::Pointer ProcessingThreadActiveLock;
-  itk::MutexLock::Pointer ProcessingTaskQueueLock;
-  itk::MutexLock::Pointer ModifiedQueueActiveLock;
+  /// Guards the task queue and ProcessingThreadActive
+  itk::SimpleMutexLock ProcessingTaskQueueLock;
+  /// Signaled when a task is scheduled or the threads are terminated
+  itk::ConditionVariable::Pointer ProcessingTaskQueueCondition;
+  /// Each lock guards its queue and the corresponding *QueueActive flag
   itk::MutexLock::Pointer ModifiedQueueLock;
-  itk::MutexLock::Pointer ReadDataQueueActiveLock;
   itk::MutexLock::Pointer ReadDataQueueLock;
-  itk::MutexLock::Pointer WriteDataQueueActiveLock;
   itk::MutexLock::Pointer WriteDataQueueLock;
   vtkTimeStamp RequestTimeStamp;
-  int ProcessingThreadId;
+  int NumberOfProcessingThreads;
+  std::vector<int> ProcessingThreadIDs;
   std::vector<int> NetworkingThreadIDs;
   int ProcessingThreadActive;
   int ModifiedQueueActive;
@@ -48,6 +48,15 @@ public:
     return "Unknown";
   }
 
+  ///
+  /// Tasks with higher priority are started before the tasks with lower
+  /// priority that are waiting in the application logic queue.
+  /// The priority is taken into account when the task is scheduled.
+  /// Default is 0.
+  /// \sa vtkSlicerApplicationLogic::ScheduleTask()
+  vtkSetMacro(Priority, int);
+  vtkGetMacro(Priority, int);
+
 protected:
   vtkSlicerTask();
   virtual ~vtkSlicerTask();
@@ -60,6 +69,7 @@ private:
   void *TaskClientData;
 
   int Type;
+  int Priority;
 
 };
 #endif
@@ -0,0 +1,108 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRMLCLI includes
+#include <vtkSlicerCLIModuleLogic.h>
+
+// MRML includes
+#include <vtkMRMLCoreTestingMacros.h>
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// ITKSYS includes
+#include <itksys/SystemTools.hxx>
+
+// STD includes
+#include <climits>
+#include <sstream>
+#include <string>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//-----------------------------------------------------------------------------
+int vtkSlicerCLIModuleLogicTest1(int vtkNotUsed(argc), char * vtkNotUsed(argv)[])
+{
+  std::string sharedMemoryDirectory =
+    itksys::SystemTools::GetCurrentWorkingDirectory() + "/vtkSlicerCLIModuleLogicTest1";
+  itksys::SystemTools::RemoveADirectory(sharedMemoryDirectory.c_str());
+  CHECK_BOOL(itksys::SystemTools::MakeDirectory(sharedMemoryDirectory.c_str()), true);
+
+  vtkSmartPointer<vtkSlicerCLIModuleLogic> logic = vtkSmartPointer<vtkSlicerCLIModuleLogic>::New();
+
+  // No private directory without a shared memory directory
+  logic->SetSharedMemoryDirectory("");
+  CHECK_STD_STRING(logic->GetPrivateSharedMemoryDirectory(), "");
+
+  logic->SetSharedMemoryDirectory(sharedMemoryDirectory);
+  std::string privateDirectory = logic->GetPrivateSharedMemoryDirectory();
+#ifdef _WIN32
+  CHECK_STD_STRING(privateDirectory, "");
+#else
+  // Private directory is created in the shared memory directory with a random name
+  CHECK_BOOL(privateDirectory.empty(), false);
+  CHECK_STD_STRING(itksys::SystemTools::GetParentDirectory(privateDirectory.c_str()), sharedMemoryDirectory);
+  std::ostringstream prefix;
+  prefix << "Slicer-" << getuid() << "-" << getpid() << "-";
+  CHECK_STD_STRING(itksys::SystemTools::GetFilenameName(privateDirectory).substr(0, prefix.str().size()), prefix.str());
+  CHECK_BOOL(itksys::SystemTools::FileIsDirectory(privateDirectory.c_str()), true);
+
+  // Only the current user can access it
+  struct stat directoryStatus;
+  CHECK_INT(lstat(privateDirectory.c_str(), &directoryStatus), 0);
+  CHECK_BOOL(S_ISDIR(directoryStatus.st_mode), true);
+  CHECK_INT(static_cast<int>(directoryStatus.st_mode & 0777), 0700);
+  CHECK_INT(static_cast<int>(directoryStatus.st_uid), static_cast<int>(getuid()));
+
+  // The same directory is used by all executions of the logic
+  CHECK_STD_STRING(logic->GetPrivateSharedMemoryDirectory(), privateDirectory);
+
+  // Each logic has its own directory
+  vtkNew<vtkSlicerCLIModuleLogic> otherLogic;
+  otherLogic->SetSharedMemoryDirectory(sharedMemoryDirectory);
+  std::string otherPrivateDirectory = otherLogic->GetPrivateSharedMemoryDirectory();
+  CHECK_BOOL(otherPrivateDirectory.empty(), false);
+  CHECK_BOOL(otherPrivateDirectory != privateDirectory, true);
+
+  // Directory is removed with its content when the logic is deleted
+  std::string leftoverFile = privateDirectory + "/leftover.nrrd";
+  CHECK_BOOL(itksys::SystemTools::Touch(leftoverFile.c_str(), true), true);
+  logic = NULL;
+  CHECK_BOOL(itksys::SystemTools::FileExists(privateDirectory.c_str()), false);
+  CHECK_BOOL(itksys::SystemTools::FileIsDirectory(otherPrivateDirectory.c_str()), true);
+
+  // Directories of processes that no longer exist are removed,
+  // the directories of running processes and of other users are kept.
+  std::ostringstream staleDirectory;
+  staleDirectory << sharedMemoryDirectory << "/Slicer-" << getuid() << "-" << INT_MAX << "-abcdef";
+  std::ostringstream otherUserDirectory;
+  otherUserDirectory << sharedMemoryDirectory << "/Slicer-" << getuid() + 1 << "-" << INT_MAX << "-abcdef";
+  CHECK_BOOL(itksys::SystemTools::MakeDirectory(staleDirectory.str().c_str()), true);
+  CHECK_BOOL(itksys::SystemTools::Touch((staleDirectory.str() + "/leftover.nrrd").c_str(), true), true);
+  CHECK_BOOL(itksys::SystemTools::MakeDirectory(otherUserDirectory.str().c_str()), true);
+  vtkSlicerCLIModuleLogic::RemoveStaleSharedMemoryDirectories(sharedMemoryDirectory);
+  CHECK_BOOL(itksys::SystemTools::FileExists(staleDirectory.str().c_str()), false);
+  CHECK_BOOL(itksys::SystemTools::FileIsDirectory(otherUserDirectory.str().c_str()), true);
+  CHECK_BOOL(itksys::SystemTools::FileIsDirectory(otherPrivateDirectory.c_str()), true);
+#endif
+
+  logic = NULL;
+  itksys::SystemTools::RemoveADirectory(sharedMemoryDirectory.c_str());
+  return EXIT_SUCCESS;
+}
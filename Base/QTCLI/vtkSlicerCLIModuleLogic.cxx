@@ -30,17 +30,24 @@
 #include <vtkMRMLStorageNode.h>
 #include <vtkMRMLModelStorageNode.h>
 #include <vtkMRMLTransformNode.h>
+#include <vtkMRMLVolumeNode.h>
 
 // VTK includes
 #include <vtkCallbackCommand.h>
+#include <vtkImageData.h>
 #include <vtkIntArray.h>
 #include <vtkMultiThreader.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
+#include <vtkPointSet.h>
 #include <vtkStringArray.h>
 #include <vtksys/SystemTools.hxx>
 
+// ITK includes
+#include <itkSimpleFastMutexLock.h>
+
 // ITKSYS includes
+#include <itksys/Directory.hxx>
 #include <itksys/Process.h>
 #include <itksys/SystemTools.hxx>
 #include <itksys/RegularExpression.hxx>
@@ -55,15 +62,43 @@
 // STL includes
 #include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <cstdlib>
 #include <ctime>
+#include <iostream>
+#include <map>
 #include <set>
+#include <streambuf>
 
 #ifdef _WIN32
 #else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
 #include <sys/types.h>
 #include <unistd.h>
 #endif
 
+//----------------------------------------------------------------------------
+// Create an empty file that does not exist yet. Fails if a file or
+// a symbolic link already exists with that name.
+static bool CreateExclusiveFile(const std::string& fileName)
+{
+#ifdef _WIN32
+  (void)fileName;
+  return true;
+#else
+  int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+  if (fd < 0)
+    {
+    return false;
+    }
+  close(fd);
+  return true;
+#endif
+}
+
 //----------------------------------------------------------------------------
 struct DigitsToCharacters
 {
@@ -79,6 +114,133 @@ struct DigitsToCharacters
 };
 
 typedef std::pair<vtkSlicerCLIModuleLogic *, vtkMRMLCommandLineModuleNode *> LogicNodePair;
+
+namespace
+{
+
+/// Modules run in processing threads of the application logic. Executable
+/// modules are started with ITK_AUTOLOAD_PATH reset in the environment of
+/// the process, so the environment is changed by one thread at a time.
+/// Only the start of the executable is guarded, not its execution.
+itk::SimpleFastMutexLock ProcessStateLock;
+
+//----------------------------------------------------------------------------
+/// Stream buffer installed on a standard stream (std::cout or std::cerr)
+/// while shared object modules run, so that concurrent modules each capture
+/// their own output instead of swapping the buffer of the process.
+/// Characters written by a thread that redirected the stream go to the
+/// buffer of that thread, characters written by any other thread go to the
+/// original buffer of the stream. Output of threads started by a module
+/// (e.g., ITK filter threads) is therefore not captured.
+class vtkSlicerCLIThreadStreamBuffer : public std::streambuf
+{
+public:
+  vtkSlicerCLIThreadStreamBuffer(std::ostream& stream)
+    : Stream(stream)
+    , OriginalBuffer(0)
+  {
+  }
+
+  /// Send what the current thread writes into \a buffer until Restore()
+  /// is called from the same thread.
+  void Redirect(std::streambuf* buffer)
+  {
+    this->Lock.Lock();
+    if (this->ThreadBuffers.empty())
+      {
+      this->OriginalBuffer = this->Stream.rdbuf(this);
+      }
+    this->ThreadBuffers.push_back(
+      std::make_pair(vtkMultiThreader::GetCurrentThreadID(), buffer));
+    this->Lock.Unlock();
+  }
+
+  /// Stop the redirection of the current thread. The original buffer is
+  /// put back on the stream when no thread redirects it anymore.
+  void Restore()
+  {
+    this->Lock.Lock();
+    ThreadBufferType::iterator it = this->FindThreadBuffer();
+    if (it != this->ThreadBuffers.end())
+      {
+      this->ThreadBuffers.erase(it);
+      if (this->ThreadBuffers.empty())
+        {
+        this->Stream.rdbuf(this->OriginalBuffer);
+        this->OriginalBuffer = 0;
+        }
+      }
+    this->Lock.Unlock();
+  }
+
+protected:
+  virtual int_type overflow(int_type c)
+  {
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+      {
+      return traits_type::not_eof(c);
+      }
+    this->Lock.Lock();
+    std::streambuf* buffer = this->GetCurrentBuffer();
+    int_type res = buffer ? buffer->sputc(traits_type::to_char_type(c)) : traits_type::eof();
+    this->Lock.Unlock();
+    return res;
+  }
+
+  virtual std::streamsize xsputn(const char* s, std::streamsize n)
+  {
+    this->Lock.Lock();
+    std::streambuf* buffer = this->GetCurrentBuffer();
+    std::streamsize res = buffer ? buffer->sputn(s, n) : 0;
+    this->Lock.Unlock();
+    return res;
+  }
+
+  virtual int sync()
+  {
+    this->Lock.Lock();
+    std::streambuf* buffer = this->GetCurrentBuffer();
+    int res = buffer ? buffer->pubsync() : -1;
+    this->Lock.Unlock();
+    return res;
+  }
+
+private:
+  typedef std::vector<std::pair<vtkMultiThreaderIDType, std::streambuf*> > ThreadBufferType;
+
+  /// The caller must hold the lock.
+  ThreadBufferType::iterator FindThreadBuffer()
+  {
+    vtkMultiThreaderIDType threadID = vtkMultiThreader::GetCurrentThreadID();
+    for (ThreadBufferType::iterator it = this->ThreadBuffers.begin();
+         it != this->ThreadBuffers.end(); ++it)
+      {
+      if (vtkMultiThreader::ThreadsEqual(it->first, threadID))
+        {
+        return it;
+        }
+      }
+    return this->ThreadBuffers.end();
+  }
+
+  /// The caller must hold the lock.
+  std::streambuf* GetCurrentBuffer()
+  {
+    ThreadBufferType::iterator it = this->FindThreadBuffer();
+    return it != this->ThreadBuffers.end() ? it->second : this->OriginalBuffer;
+  }
+
+  std::ostream& Stream;
+  std::streambuf* OriginalBuffer;
+  ThreadBufferType ThreadBuffers;
+  itk::SimpleFastMutexLock Lock;
+};
+
+vtkSlicerCLIThreadStreamBuffer CoutThreadBuffer(std::cout);
+vtkSlicerCLIThreadStreamBuffer CerrThreadBuffer(std::cerr);
+
+}
+
 class MRMLIDMap : public std::map<std::string, std::string> {};
 
 //---------------------------------------------------------------------------
@@ -201,9 +363,24 @@ public:
 
   int RedirectModuleStreams;
 
+  std::string SharedMemoryDirectory;
+
+  /// Private directories created in the shared memory directories (key)
+  std::map<std::string, std::string> PrivateSharedMemoryDirectories;
+  /// Guards PrivateSharedMemoryDirectories, modules can run concurrently in processing threads
+  itk::SimpleFastMutexLock PrivateSharedMemoryDirectoriesLock;
+
   itk::MutexLock::Pointer ProcessesKillLock;
   std::vector<itksysProcess*> Processes;
 
+  /// Tasks scheduled by Apply() that may not have started yet, so that
+  /// they can be removed from the queue of the application logic when
+  /// their node is cancelled. An entry is removed when a task of the node
+  /// starts (the first one of the node) or when the node is cancelled.
+  typedef std::vector<std::pair<vtkMRMLCommandLineModuleNode*, vtkSmartPointer<vtkSlicerTask> > > ScheduledTaskType;
+  ScheduledTaskType ScheduledTasks;
+  itk::SimpleFastMutexLock ScheduledTasksLock;
+
   typedef std::vector<std::pair<vtkMTimeType, vtkMRMLCommandLineModuleNode*> > RequestType;
   struct FindRequest
   {
@@ -228,6 +405,7 @@ public:
 
   void SetLastRequest(vtkMRMLCommandLineModuleNode* node, vtkMTimeType requestUID)
   {
+    this->LastRequestsLock->Lock();
     RequestType::iterator it = std::find_if(
       this->LastRequests.begin(), this->LastRequests.end(), FindRequest(node));
     if (it == this->LastRequests.end())
@@ -239,12 +417,16 @@ public:
       assert( it->first < requestUID );
       it->first = requestUID;
       }
+    this->LastRequestsLock->Unlock();
   }
   vtkMTimeType GetLastRequest(vtkMRMLCommandLineModuleNode* node)
   {
+    this->LastRequestsLock->Lock();
     RequestType::iterator it = std::find_if(
       this->LastRequests.begin(), this->LastRequests.end(), FindRequest(node));
-    return (it != this->LastRequests.end())? it->first : 0;
+    vtkMTimeType requestUID = (it != this->LastRequests.end())? it->first : 0;
+    this->LastRequestsLock->Unlock();
+    return requestUID;
   }
 
   /// Install the reschedule callback on a node and its references
@@ -284,6 +466,8 @@ public:
   /// List of read data/scene requests of the CLI nodes
   /// being executed with their.
   RequestType LastRequests;
+  /// Guards LastRequests, modules can run concurrently in processing threads
+  itk::MutexLock::Pointer LastRequestsLock;
 
   vtkSmartPointer<vtkSlicerCLIRescheduleCallback> RescheduleCallback;
   vtkSmartPointer<vtkSlicerCLIOneShotCallbackCallback>OneShotCallbackCallback;
@@ -298,9 +482,24 @@ vtkSlicerCLIModuleLogic::vtkSlicerCLIModuleLogic()
   this->Internal = new vtkInternal();
 
   this->Internal->ProcessesKillLock = itk::MutexLock::New();
+  this->Internal->LastRequestsLock = itk::MutexLock::New();
   this->Internal->DeleteTemporaryFiles = 1;
   this->Internal->AllowInMemoryTransfer = 1;
   this->Internal->RedirectModuleStreams = 1;
+#ifdef __linux__
+  // memory-backed file system available on most Linux distributions
+  if (itksys::SystemTools::FileIsDirectory("/dev/shm"))
+    {
+    this->Internal->SharedMemoryDirectory = "/dev/shm";
+    // directories left by Slicer sessions that crashed are removed once at startup
+    static bool staleDirectoriesRemoved = false;
+    if (!staleDirectoriesRemoved)
+      {
+      staleDirectoriesRemoved = true;
+      vtkSlicerCLIModuleLogic::RemoveStaleSharedMemoryDirectories("/dev/shm");
+      }
+    }
+#endif
   this->Internal->RescheduleCallback =
     vtkSmartPointer<vtkSlicerCLIRescheduleCallback>::New();
   this->Internal->RescheduleCallback->SetCLIModuleLogic(this);
@@ -316,6 +515,16 @@ vtkSlicerCLIModuleLogic::~vtkSlicerCLIModuleLogic()
 {
   this->RemoveObserver(this->Internal->OneShotCallbackCallback);
 
+  std::map<std::string, std::string>::iterator dirIt;
+  for (dirIt = this->Internal->PrivateSharedMemoryDirectories.begin();
+       dirIt != this->Internal->PrivateSharedMemoryDirectories.end(); ++dirIt)
+    {
+    if (!dirIt->second.empty())
+      {
+      itksys::SystemTools::RemoveADirectory(dirIt->second.c_str());
+      }
+    }
+
   delete this->Internal;
 }
 
@@ -323,6 +532,7 @@ vtkSlicerCLIModuleLogic::~vtkSlicerCLIModuleLogic()
 void vtkSlicerCLIModuleLogic::PrintSelf(ostream& os, vtkIndent indent)
 {
   Superclass::PrintSelf(os, indent);
+  os << indent << "SharedMemoryDirectory: " << this->Internal->SharedMemoryDirectory << "\n";
 }
 
 //-----------------------------------------------------------------------------
@@ -403,6 +613,114 @@ int vtkSlicerCLIModuleLogic::GetAllowInMemoryTransfer() const
   return this->Internal->AllowInMemoryTransfer;
 }
 
+//----------------------------------------------------------------------------
+void vtkSlicerCLIModuleLogic::SetSharedMemoryDirectory(const std::string& directory)
+{
+  vtkDebugMacro(<< this->GetClassName() << " (" << this << "): setting SharedMemoryDirectory to " << directory);
+  if (this->Internal->SharedMemoryDirectory != directory)
+    {
+    this->Internal->SharedMemoryDirectory = directory;
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+std::string vtkSlicerCLIModuleLogic::GetSharedMemoryDirectory() const
+{
+  return this->Internal->SharedMemoryDirectory;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkSlicerCLIModuleLogic::GetPrivateSharedMemoryDirectory()
+{
+  std::string sharedMemoryDirectory = this->GetSharedMemoryDirectory();
+  if (sharedMemoryDirectory.empty())
+    {
+    return std::string();
+    }
+#ifdef _WIN32
+  return std::string();
+#else
+  this->Internal->PrivateSharedMemoryDirectoriesLock.Lock();
+  std::map<std::string, std::string>::iterator dirIt =
+    this->Internal->PrivateSharedMemoryDirectories.find(sharedMemoryDirectory);
+  if (dirIt != this->Internal->PrivateSharedMemoryDirectories.end())
+    {
+    std::string privateDirectory = dirIt->second;
+    this->Internal->PrivateSharedMemoryDirectoriesLock.Unlock();
+    return privateDirectory;
+    }
+
+  // mkdtemp creates the directory with a random name and mode 0700,
+  // it fails instead of reusing an existing file or directory.
+  std::ostringstream directoryTemplate;
+  // The process ID in the name tells which directories are stale after a crash
+  // (see RemoveStaleSharedMemoryDirectories()).
+  directoryTemplate << sharedMemoryDirectory << "/Slicer-" << getuid() << "-" << getpid() << "-XXXXXX";
+  std::string directoryTemplateString = directoryTemplate.str();
+  std::vector<char> directoryName(directoryTemplateString.begin(), directoryTemplateString.end());
+  directoryName.push_back('\0');
+  std::string privateDirectory;
+  if (mkdtemp(&directoryName[0]) != NULL)
+    {
+    privateDirectory = &directoryName[0];
+    }
+  else
+    {
+    vtkWarningMacro("Failed to create private directory in " << sharedMemoryDirectory);
+    }
+  // A failure is stored as well, so that it is not attempted for every execution
+  this->Internal->PrivateSharedMemoryDirectories[sharedMemoryDirectory] = privateDirectory;
+  this->Internal->PrivateSharedMemoryDirectoriesLock.Unlock();
+  return privateDirectory;
+#endif
+}
+
+//----------------------------------------------------------------------------
+void vtkSlicerCLIModuleLogic::RemoveStaleSharedMemoryDirectories(const std::string& sharedMemoryDirectory)
+{
+#ifndef _WIN32
+  itksys::Directory directory;
+  if (sharedMemoryDirectory.empty() || !directory.Load(sharedMemoryDirectory.c_str()))
+    {
+    return;
+    }
+  std::ostringstream prefixStream;
+  prefixStream << "Slicer-" << getuid() << "-";
+  std::string prefix = prefixStream.str();
+  for (unsigned long fileIndex = 0; fileIndex < directory.GetNumberOfFiles(); ++fileIndex)
+    {
+    // private directories are named Slicer-<uid>-<pid>-XXXXXX
+    std::string fileName = directory.GetFile(fileIndex);
+    if (fileName.compare(0, prefix.size(), prefix) != 0)
+      {
+      continue;
+      }
+    char* pidEnd = NULL;
+    long pid = strtol(fileName.c_str() + prefix.size(), &pidEnd, 10);
+    if (pid <= 0 || *pidEnd != '-')
+      {
+      continue;
+      }
+    // the process is still running if it can be signaled, or if it exists
+    // but belongs to another user (the process ID has been reused)
+    if (kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM)
+      {
+      continue;
+      }
+    std::string path = sharedMemoryDirectory + "/" + fileName;
+    struct stat status;
+    if (lstat(path.c_str(), &status) != 0 || !S_ISDIR(status.st_mode) || status.st_uid != getuid())
+      {
+      continue;
+      }
+    itksys::SystemTools::RemoveADirectory(path.c_str());
+    }
+#else
+  (void)sharedMemoryDirectory;
+#endif
+}
+
 //----------------------------------------------------------------------------
 void vtkSlicerCLIModuleLogic::RedirectModuleStreamsOn()
 {
@@ -465,18 +783,85 @@ vtkSlicerCLIModuleLogic
   pid = pidString.str();
   std::transform(pid.begin(), pid.end(), pid.begin(), DigitsToCharacters());
 
-  // By default, the filename is based on the temporary directory and
-  // the pid
-  // by default use the current directory
+  // By default, the filename is based on the data exchange directory
+  // of the execution (stored as root directory of the miniscene) and the pid
+  std::string temporaryDirectory = scene->GetRootDirectory();
+  fname = temporaryDirectory + "/" + pid + "_" + fname + ".mrml";
+
+  return fname;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkSlicerCLIModuleLogic
+::GetDataExchangeDirectory(vtkMRMLCommandLineModuleNode* node, CommandLineModuleType commandType)
+{
+  // by default use the current directory for storing files
   std::string temporaryDirectory = ".";
   vtkSlicerApplicationLogic* appLogic = this->GetApplicationLogic();
   if (appLogic)
     {
     temporaryDirectory = appLogic->GetTemporaryPath();
     }
-  fname = temporaryDirectory + "/" + pid + "_" + fname + ".mrml";
 
-  return fname;
+  // Only executables exchange data sets through files. Files that are kept
+  // for debugging would hold memory indefinitely.
+  std::string sharedMemoryDirectory = this->GetSharedMemoryDirectory();
+  if (commandType != CommandLineModule || sharedMemoryDirectory.empty()
+    || !this->GetDeleteTemporaryFiles()
+    || !itksys::SystemTools::FileIsDirectory(sharedMemoryDirectory.c_str()))
+    {
+    return temporaryDirectory;
+    }
+
+#ifndef _WIN32
+  // Estimate the size of the files: outputs are assumed to be about as
+  // large as the inputs
+  double requiredMemory = 0.0; // in bytes
+  std::vector<ModuleParameterGroup>::iterator pgit;
+  for (pgit = node->GetModuleDescription().GetParameterGroups().begin();
+       pgit != node->GetModuleDescription().GetParameterGroups().end(); ++pgit)
+    {
+    std::vector<ModuleParameter>::iterator pit;
+    for (pit = (*pgit).GetParameters().begin(); pit != (*pgit).GetParameters().end(); ++pit)
+      {
+      if ((*pit).GetChannel() != "input"
+        || ((*pit).GetTag() != "image" && (*pit).GetTag() != "geometry"))
+        {
+        continue;
+        }
+      vtkMRMLNode* inputNode = this->GetMRMLScene()->GetNodeByID((*pit).GetValue().c_str());
+      vtkMRMLVolumeNode* volumeNode = vtkMRMLVolumeNode::SafeDownCast(inputNode);
+      vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(inputNode);
+      if (volumeNode && volumeNode->GetImageData())
+        {
+        requiredMemory += 2048.0 * volumeNode->GetImageData()->GetActualMemorySize();
+        }
+      else if (modelNode && modelNode->GetMesh())
+        {
+        requiredMemory += 2048.0 * modelNode->GetMesh()->GetActualMemorySize();
+        }
+      }
+    }
+
+  // Leave at least half of the memory-backed file system to other processes
+  struct statvfs fileSystemStatistics;
+  if (statvfs(sharedMemoryDirectory.c_str(), &fileSystemStatistics) != 0
+    || requiredMemory > 0.5 * fileSystemStatistics.f_bavail * fileSystemStatistics.f_frsize)
+    {
+    vtkDebugMacro("Not enough space in " << sharedMemoryDirectory << ", using " << temporaryDirectory);
+    return temporaryDirectory;
+    }
+#else
+  (void)node;
+#endif
+
+  // Files are only written in a directory that other users cannot access
+  std::string privateDirectory = this->GetPrivateSharedMemoryDirectory();
+  if (privateDirectory.empty())
+    {
+    return temporaryDirectory;
+    }
+  return privateDirectory;
 }
 
 //----------------------------------------------------------------------------
@@ -486,7 +871,8 @@ vtkSlicerCLIModuleLogic
                              const std::string& type,
                              const std::string& name,
                              const std::vector<std::string>& extensions,
-                             CommandLineModuleType commandType)
+                             CommandLineModuleType commandType,
+                             vtkMRMLScene* miniscene)
 {
   std::string fname = name;
   std::string pid;
@@ -505,17 +891,13 @@ vtkSlicerCLIModuleLogic
   //
   // 3. If the consumer of the file cannot communicate directly with
   // the MRML scene, then a real temporary filename is constructed.
-  // The filename will point to the Temporary directory defined for
-  // Slicer. The filename will be unique to the process (multiple
+  // The filename will point to the data exchange directory of the
+  // execution (see GetDataExchangeDirectory()). The filename will be unique to the process (multiple
   // running instances of slicer will not collide).  The filename
-  // will be unique to the node in the process (the same node will be
-  // encoded to the same filename every time within that running
-  // instance of Slicer).  This last point is an optimization to
-  // minimize the number of times a file is written when running a
-  // module.  However, if we change the execution model such that more
-  // than one module can run at the same time within the same Slicer
-  // process, then this encoding will need to be changed to be unique
-  // per module execution.
+  // will be unique to the node and to the module execution, which is
+  // identified by its miniscene: modules running at the same time in
+  // the processing threads do not overwrite or delete each other's
+  // files.
   //
 
   // Encode process id into a string.  To avoid confusing the
@@ -540,15 +922,18 @@ vtkSlicerCLIModuleLogic
   std::transform(fname.begin(), fname.end(),
                  fname.begin(), DigitsToCharacters());
 
-  // By default, the filename is based on the temporary directory and
-  // the pid
-  std::string temporaryDirectory = ".";
-  vtkSlicerApplicationLogic* appLogic = this->GetApplicationLogic();
-  if (appLogic)
-    {
-    temporaryDirectory = appLogic->GetTemporaryPath();
-    }
-  fname = temporaryDirectory + "/" + pid + "_" + fname;
+  // By default, the filename is based on the data exchange directory
+  // of the execution (stored as root directory of the miniscene) and the pid
+  std::string temporaryDirectory = miniscene->GetRootDirectory();
+
+  // Encode the miniscene pointer of the execution. To avoid confusing the
+  // Archetype reader, convert the numbers to characters [0-9]->[A-J]
+  char sceneString[256];
+  sprintf(sceneString, "%p", miniscene);
+  std::string scene = sceneString;
+  std::transform(scene.begin(), scene.end(), scene.begin(), DigitsToCharacters());
+
+  fname = temporaryDirectory + "/" + pid + "_" + scene + "_" + fname;
 
   if (tag == "image")
     {
@@ -674,6 +1059,40 @@ void vtkSlicerCLIModuleLogic::ApplyAndWait ( vtkMRMLCommandLineModuleNode* node,
     }
 }
 
+//-----------------------------------------------------------------------------
+void vtkSlicerCLIModuleLogic::CancelScheduledTasks(vtkMRMLCommandLineModuleNode* node)
+{
+  int numberOfCancelledTasks = 0;
+  this->Internal->ScheduledTasksLock.Lock();
+  vtkInternal::ScheduledTaskType::iterator it = this->Internal->ScheduledTasks.begin();
+  while (it != this->Internal->ScheduledTasks.end())
+    {
+    if (it->first != node)
+      {
+      ++it;
+      continue;
+      }
+    // A task that already started sees the Cancelling status itself
+    if (this->GetApplicationLogic()->CancelTask(it->second))
+      {
+      ++numberOfCancelledTasks;
+      }
+    it = this->Internal->ScheduledTasks.erase(it);
+    }
+  this->Internal->ScheduledTasksLock.Unlock();
+
+  if (numberOfCancelledTasks == 0)
+    {
+    return;
+    }
+  // The tasks will never run, release the references they held on the node
+  for (int i = 0; i < numberOfCancelledTasks; ++i)
+    {
+    node->UnRegister(this);
+    }
+  node->SetStatus(vtkMRMLCommandLineModuleNode::Cancelled);
+}
+
 //-----------------------------------------------------------------------------
 void vtkSlicerCLIModuleLogic::KillProcesses()
 {
@@ -716,12 +1135,27 @@ void vtkSlicerCLIModuleLogic::Apply ( vtkMRMLCommandLineModuleNode* node, bool u
   node->Register(this);
   node->SetAttribute("UpdateDisplay", updateDisplay ? "true" : "false");
 
+  // Runs requested by AutoRun are started before the other waiting
+  // modules, the user is interacting with their inputs.
+  if (node->GetAutoRun())
+    {
+    task->SetPriority(1);
+    }
+
   // Schedule the task
+  this->Internal->ScheduledTasksLock.Lock();
   ret = this->GetApplicationLogic()->ScheduleTask( task.GetPointer() );
+  if (ret)
+    {
+    this->Internal->ScheduledTasks.push_back(
+      std::make_pair(node, vtkSmartPointer<vtkSlicerTask>(task.GetPointer())));
+    }
+  this->Internal->ScheduledTasksLock.Unlock();
 
   if (!ret)
     {
     vtkWarningMacro( << "Could not schedule task" );
+    node->UnRegister(this);
     }
   else
     {
@@ -833,6 +1267,19 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
   // release it when it goes out of scope
   node0.TakeReference(reinterpret_cast<vtkMRMLCommandLineModuleNode*>(clientdata));
 
+  // The task has started, it cannot be removed from the queue anymore
+  this->Internal->ScheduledTasksLock.Lock();
+  for (vtkInternal::ScheduledTaskType::iterator it = this->Internal->ScheduledTasks.begin();
+       it != this->Internal->ScheduledTasks.end(); ++it)
+    {
+    if (it->first == node0.GetPointer())
+      {
+      this->Internal->ScheduledTasks.erase(it);
+      break;
+      }
+    }
+  this->Internal->ScheduledTasksLock.Unlock();
+
   // Check to see if this node/task has been cancelled
   if (node0->GetStatus() == vtkMRMLCommandLineModuleNode::Cancelling ||
       node0->GetStatus() == vtkMRMLCommandLineModuleNode::Cancelled)
@@ -909,9 +1356,16 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
   // Additional handling is necessary because we use SmartPointers
   // (see http://slicer.spl.harvard.edu/slicerWiki/index.php/Slicer3:Memory_Management#SmartPointers)
   vtkNew<vtkMRMLScene> miniscene;
+  // All files exchanged with the module are placed in the root directory
+  // of the miniscene
+  std::string dataExchangeDirectory = this->GetDataExchangeDirectory(node0, commandType);
+  miniscene->SetRootDirectory(dataExchangeDirectory.c_str());
+  // Input files written to the shared memory directory are created exclusively,
+  // so that an existing file is never overwritten
+  bool createFilesExclusively = (!dataExchangeDirectory.empty()
+    && dataExchangeDirectory == this->GetPrivateSharedMemoryDirectory());
   std::string minisceneFilename
     = this->ConstructTemporarySceneFileName(miniscene.GetPointer());
-  miniscene->SetRootDirectory(vtksys::SystemTools::GetParentDirectory(minisceneFilename.c_str()).c_str());
 
   // vector of files to delete
   std::set<std::string> filesToDelete;
@@ -963,8 +1417,23 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
                                              (*pit).GetType(),
                                              id,
                                              (*pit).GetFileExtensions(),
-                                             commandType);
+                                             commandType,
+                                             miniscene.GetPointer());
 
+        if ((*pit).GetChannel() == "input" && createFilesExclusively
+          && filesToDelete.find(fname) == filesToDelete.end()
+          && !CreateExclusiveFile(fname))
+          {
+          vtkErrorMacro("Failed to create data exchange file " << fname << ", it already exists");
+          std::set<std::string>::iterator fit;
+          for (fit = filesToDelete.begin(); fit != filesToDelete.end(); ++fit)
+            {
+            itksys::SystemTools::RemoveFile((*fit).c_str());
+            }
+          node0->SetStatus(vtkMRMLCommandLineModuleNode::CompletedWithErrors, false);
+          this->GetApplicationLogic()->RequestModified( node0 );
+          return;
+          }
         filesToDelete.insert(fname);
         if ((*pit).GetChannel() == "input")
           {
@@ -1836,6 +2305,7 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
     // statically linked to the executable.
     // Historically, there was an nvidia driver bug that causes the module
     // to fail on exit with undefined symbol.
+     ProcessStateLock.Lock();
      std::string saveITKAutoLoadPath;
      itksys::SystemTools::GetEnv("ITK_AUTOLOAD_PATH", saveITKAutoLoadPath);
      std::string emptyString("ITK_AUTOLOAD_PATH=");
@@ -1850,7 +2320,10 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
     //
     itksysProcess *process = itksysProcess_New();
 
+    // other modules may be started concurrently by the application logic
+    this->Internal->ProcessesKillLock->Lock();
     this->Internal->Processes.push_back(process);
+    this->Internal->ProcessesKillLock->Unlock();
 
     // setup the command
     itksysProcess_SetCommand(process, command);
@@ -1872,6 +2345,7 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
       {
       vtkErrorMacro( "Unable to restore ITK_AUTOLOAD_PATH. ");
       }
+    ProcessStateLock.Unlock();
 
     // Wait for the command to finish
     char *tbuffer;
@@ -1897,9 +2371,12 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
       // Check to see if the plugin was cancelled
       if (node0->GetModuleDescription().GetProcessInformation()->Abort)
         {
+        this->Internal->ProcessesKillLock->Lock();
         itksysProcess_Kill(process);
         this->Internal->Processes.erase(
-              std::find(this->Internal->Processes.begin(), this->Internal->Processes.end(), process));
+              std::remove(this->Internal->Processes.begin(), this->Internal->Processes.end(), process),
+              this->Internal->Processes.end());
+        this->Internal->ProcessesKillLock->Unlock();
         node0->GetModuleDescription().GetProcessInformation()->Progress = 0;
         node0->GetModuleDescription().GetProcessInformation()->StageProgress =0;
         this->GetApplicationLogic()->RequestModified( node0 );
@@ -2144,8 +2621,10 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
 
       // clean up
       this->Internal->ProcessesKillLock->Lock();
+      // the process is already removed if it was cancelled
       this->Internal->Processes.erase(
-            std::find(this->Internal->Processes.begin(), this->Internal->Processes.end(), process));
+            std::remove(this->Internal->Processes.begin(), this->Internal->Processes.end(), process),
+            this->Internal->Processes.end());
       itksysProcess_Delete(process);
       this->Internal->ProcessesKillLock->Unlock();
       }
@@ -2158,48 +2637,22 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
 
     std::ostringstream coutstringstream;
     std::ostringstream cerrstringstream;
-    std::streambuf* origcoutrdbuf = std::cout.rdbuf();
-    std::streambuf* origcerrrdbuf = std::cerr.rdbuf();
+    if (this->Internal->RedirectModuleStreams)
+      {
+      // capture what the module writes from this thread only, other modules
+      // may run concurrently in the other processing threads
+      CoutThreadBuffer.Redirect(coutstringstream.rdbuf());
+      CerrThreadBuffer.Redirect(cerrstringstream.rdbuf());
+      }
     int returnValue = 0;
+    bool moduleCompleted = false;
     try
       {
-      if (this->Internal->RedirectModuleStreams)
-        {
-        // redirect the streams
-        std::cout.rdbuf( coutstringstream.rdbuf() );
-        std::cerr.rdbuf( cerrstringstream.rdbuf() );
-        }
-
       // run the module
       if ( entryPoint != NULL ) {
         returnValue = (*entryPoint)(commandLineAsString.size(), command);
       }
-
-      // report the output
-      if (coutstringstream.str().size() > 0)
-        {
-        std::string tmp(" standard output:\n\n");
-        tmp = node0->GetModuleDescription().GetTitle()+tmp;
-
-        // vtkSlicerApplication::GetInstance()->InformationMessage
-        qDebug() << (tmp + coutstringstream.str()).c_str();
-        }
-      node0->SetOutputText(coutstringstream.str(), false);
-      if (cerrstringstream.str().size() > 0)
-        {
-        std::string tmp(" standard error:\n\n");
-        tmp = node0->GetModuleDescription().GetTitle()+tmp;
-
-        vtkErrorMacro( << (tmp + cerrstringstream.str()).c_str() );
-        }
-      node0->SetErrorText(cerrstringstream.str(), false);
-
-      if (this->Internal->RedirectModuleStreams)
-        {
-        // reset the streams
-        std::cout.rdbuf( origcoutrdbuf );
-        std::cerr.rdbuf( origcerrrdbuf );
-        }
+      moduleCompleted = true;
       }
     catch (itk::ExceptionObject& exc)
       {
@@ -2219,9 +2672,6 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
         node0->SetStatus(vtkMRMLCommandLineModuleNode::CompletedWithErrors, false);
         this->GetApplicationLogic()->RequestModified( node0 );
         }
-
-      std::cout.rdbuf( origcoutrdbuf );
-      std::cerr.rdbuf( origcerrrdbuf );
       }
     catch (...)
       {
@@ -2231,10 +2681,37 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
       vtkErrorMacro( << information.str().c_str() );
       node0->SetStatus(vtkMRMLCommandLineModuleNode::CompletedWithErrors, false);
       this->GetApplicationLogic()->RequestModified( node0 );
+      }
 
-      std::cout.rdbuf( origcoutrdbuf );
-      std::cerr.rdbuf( origcerrrdbuf );
+    if (this->Internal->RedirectModuleStreams)
+      {
+      // reset the streams
+      CoutThreadBuffer.Restore();
+      CerrThreadBuffer.Restore();
       }
+
+    if (moduleCompleted)
+      {
+      // report the output
+      if (coutstringstream.str().size() > 0)
+        {
+        std::string tmp(" standard output:\n\n");
+        tmp = node0->GetModuleDescription().GetTitle()+tmp;
+
+        // vtkSlicerApplication::GetInstance()->InformationMessage
+        qDebug() << (tmp + coutstringstream.str()).c_str();
+        }
+      node0->SetOutputText(coutstringstream.str(), false);
+      if (cerrstringstream.str().size() > 0)
+        {
+        std::string tmp(" standard error:\n\n");
+        tmp = node0->GetModuleDescription().GetTitle()+tmp;
+
+        vtkErrorMacro( << (tmp + cerrstringstream.str()).c_str() );
+        }
+      node0->SetErrorText(cerrstringstream.str(), false);
+      }
+
     if (node0->GetStatus() == vtkMRMLCommandLineModuleNode::Cancelling)
       {
       node0->SetStatus(vtkMRMLCommandLineModuleNode::Cancelled, false);
@@ -2249,8 +2726,6 @@ void vtkSlicerCLIModuleLogic::ApplyTask(void *clientdata)
       vtkErrorMacro( << information.str().c_str() );
       node0->SetStatus(vtkMRMLCommandLineModuleNode::CompletedWithErrors, false);
       this->GetApplicationLogic()->RequestModified( node0 );
-      std::cout.rdbuf( origcoutrdbuf );
-      std::cerr.rdbuf( origcerrrdbuf );
       }
     }
   else if ( commandType == PythonModule )
@@ -2718,19 +3193,24 @@ void vtkSlicerCLIModuleLogic::ProcessMRMLLogicsEvents(vtkObject* caller,
       event == vtkSlicerApplicationLogic::RequestProcessedEvent)
     {
     unsigned long uid = reinterpret_cast<unsigned long>(callData);
+    vtkMRMLCommandLineModuleNode* node = 0;
+    this->Internal->LastRequestsLock->Lock();
     vtkInternal::RequestType::iterator it =
       std::find_if(this->Internal->LastRequests.begin(),
       this->Internal->LastRequests.end(), vtkInternal::FindRequest(uid));
     if (it != this->Internal->LastRequests.end())
       {
-      vtkMRMLCommandLineModuleNode* node = it->second;
+      node = it->second;
+      // we are not interested in any request anymore because the cli node is
+      // Completed.
+      this->Internal->LastRequests.erase(it);
+      }
+    this->Internal->LastRequestsLock->Unlock();
+    if (node)
+      {
       // If the status is not Completing, then there should be no request made
       // on the application logic.
       assert(node->GetStatus() == vtkMRMLCommandLineModuleNode::Completing);
-      this->Internal->LastRequests.erase(it);
-      // we are not interested in any request anymore because the cli node is
-      // Completed.
-
       node->SetStatus(vtkMRMLCommandLineModuleNode::Completed);
       }
     }
@@ -2743,9 +3223,14 @@ void vtkSlicerCLIModuleLogic
 {
   vtkMRMLNode* node = vtkMRMLNode::SafeDownCast(caller);
   assert(node);
-  // Observe only the CLI of the logic.
   vtkMRMLCommandLineModuleNode* cliNode =
     vtkMRMLCommandLineModuleNode::SafeDownCast(node);
+  if (cliNode && event == vtkCommand::ModifiedEvent &&
+      cliNode->GetStatus() == vtkMRMLCommandLineModuleNode::Cancelling)
+    {
+    this->CancelScheduledTasks(cliNode);
+    }
+  // Observe only the CLI of the logic.
   if (cliNode &&
       cliNode->GetModuleTitle() ==
         this->Internal->DefaultModuleDescription.GetTitle())
@@ -2929,7 +3414,7 @@ void vtkSlicerCLIModuleLogic::AddCompleteModelHierarchyToMiniScene(vtkMRMLScene
                 vtkMRMLModelStorageNode *s = vtkMRMLModelStorageNode::SafeDownCast(mscp);
                 std::string fname
                     = this->ConstructTemporaryFileName("geometry", "", tmcp->GetID(), std::vector<std::string>(),
-                                                                                  CommandLineModule);
+                                                                                  CommandLineModule, miniscene);
 
                 s->SetFileName(fname.c_str());
                 filesToDelete.insert(fname);
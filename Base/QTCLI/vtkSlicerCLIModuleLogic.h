@@ -80,6 +80,35 @@ public:
   void SetAllowInMemoryTransfer(int value);
   int GetAllowInMemoryTransfer() const;
 
+  /// Directory on a memory-backed file system (e.g., /dev/shm) where the
+  /// data sets exchanged with executable modules are written, so that they
+  /// are passed through memory instead of the disk.
+  /// The temporary directory of the application is used instead if the
+  /// directory is empty, does not exist or does not have enough free space.
+  /// Default is /dev/shm on Linux, empty on other platforms.
+  /// The files are not written directly in this directory but in a private
+  /// subdirectory of it.
+  /// \sa GetDataExchangeDirectory(), GetPrivateSharedMemoryDirectory()
+  void SetSharedMemoryDirectory(const std::string& directory);
+  std::string GetSharedMemoryDirectory() const;
+
+  /// Directory that is created in the shared memory directory with a unique
+  /// random name (Slicer-<uid>-<pid>-XXXXXX), only accessible by the current
+  /// user (mode 0700), so that other users cannot predict, read or replace
+  /// the exchanged files.
+  /// It is created at the first call and removed with all its content
+  /// when the logic is deleted.
+  /// Returns an empty string if the directory cannot be created (or the
+  /// shared memory directory is not set or not supported on this platform).
+  std::string GetPrivateSharedMemoryDirectory();
+
+  /// Remove the private directories of the current user that were left in
+  /// the shared memory directory by processes that no longer exist, e.g.
+  /// after a crash. It is called for the default directory when the first
+  /// logic is created.
+  /// \sa GetPrivateSharedMemoryDirectory()
+  static void RemoveStaleSharedMemoryDirectories(const std::string& sharedMemoryDirectory);
+
   /// For debugging, control redirection of cout and cerr
   virtual void RedirectModuleStreamsOn();
   virtual void RedirectModuleStreamsOff();
@@ -123,11 +152,21 @@ protected:
   void ProcessMRMLLogicsEvents(vtkObject*, long unsigned int, void*) VTK_OVERRIDE;
 
 
+  /// Return the directory where the files exchanged with the module
+  /// are written: the shared memory directory if applicable, the temporary
+  /// directory of the application otherwise.
+  /// \sa SetSharedMemoryDirectory()
+  std::string GetDataExchangeDirectory(vtkMRMLCommandLineModuleNode* node,
+                                       CommandLineModuleType commandType);
+
+  /// Construct the name of the file used to pass a node to the module.
+  /// \a miniscene identifies the module execution.
   std::string ConstructTemporaryFileName(const std::string& tag,
                                          const std::string& type,
                                          const std::string& name,
                                      const std::vector<std::string>& extensions,
-                                     CommandLineModuleType commandType);
+                                     CommandLineModuleType commandType,
+                                     vtkMRMLScene* miniscene);
   std::string ConstructTemporarySceneFileName(vtkMRMLScene *scene);
   std::string FindHiddenNodeID(const ModuleDescription& d,
                                const ModuleParameter& p);
@@ -146,6 +185,13 @@ protected:
   /// Call apply because the node requests it.
   void AutoRun(vtkMRMLCommandLineModuleNode* cliNode);
 
+  /// Remove the tasks of the node that are waiting in the queue of the
+  /// application logic. Called when the node is cancelled. If a task was
+  /// removed, the node is set to Cancelled, otherwise the running task
+  /// stops by itself.
+  /// \sa vtkSlicerApplicationLogic::CancelTask()
+  void CancelScheduledTasks(vtkMRMLCommandLineModuleNode* node);
+
     /// List of custom events fired by the class.
   enum Events{
     RequestHierarchyEditEvent = vtkCommand::UserEvent + 1
@@ -89,6 +89,9 @@
 // MRMLLogic includes
 #include <vtkMRMLRemoteIOLogic.h>
 
+// vtkITK includes
+#include <vtkITKArchetypeImageSeriesReader.h>
+
 // MRML includes
 #include <vtkCacheManager.h>
 #include <vtkMRMLCrosshairNode.h>
@@ -407,6 +410,28 @@ void qSlicerCoreApplicationPrivate::initDataIO()
   this->DataIOManagerLogic->SetMRMLApplicationLogic(this->AppLogic);
   this->DataIOManagerLogic->SetAndObserveDataIOManager(
     this->MRMLRemoteIOLogic->GetDataIOManager());
+
+  // DICOM headers analyzed by the archetype reader are saved in the user's
+  // cache directory, so that they are not read again in the next session.
+  // An empty "DICOM/HeaderCacheFilePath" setting keeps the cache in memory only.
+#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
+  QString cacheDirectory = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#else
+  QString cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#endif
+  QString defaultDicomHeaderCacheFilePath;
+  if (!cacheDirectory.isEmpty())
+    {
+    defaultDicomHeaderCacheFilePath = QFileInfo(cacheDirectory, "DicomHeaderCache.txt").absoluteFilePath();
+    }
+  QString dicomHeaderCacheFilePath = q->userSettings()->value(
+    "DICOM/HeaderCacheFilePath", defaultDicomHeaderCacheFilePath).toString();
+  if (!dicomHeaderCacheFilePath.isEmpty())
+    {
+    this->createDirectory(QFileInfo(dicomHeaderCacheFilePath).absolutePath(), "DICOM header cache");
+    }
+  vtkITKArchetypeImageSeriesReader::SetDicomHeaderCacheFileName(
+    dicomHeaderCacheFilePath.toLocal8Bit().constData());
 }
 
 //-----------------------------------------------------------------------------
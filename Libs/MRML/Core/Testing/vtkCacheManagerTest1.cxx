@@ -0,0 +1,152 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRML includes
+#include "vtkCacheManager.h"
+#include "vtkMRMLCoreTestingMacros.h"
+
+// VTK includes
+#include <vtkNew.h>
+
+// VTKsys includes
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <fstream>
+
+namespace
+{
+
+//---------------------------------------------------------------------------
+// Write a file of 1MB, as if it was downloaded from uri
+std::string DownloadFile(vtkCacheManager* cacheManager, const char* uri)
+{
+  std::string fileName = cacheManager->GetFilenameFromURI(uri);
+  vtksys::SystemTools::MakeDirectory(vtksys::SystemTools::GetFilenamePath(fileName).c_str());
+  std::ofstream file(fileName.c_str(), std::ios::binary);
+  std::string data(1000000, 'x');
+  file << data;
+  file.close();
+  cacheManager->AddCachedFile(uri, fileName.c_str());
+  return fileName;
+}
+
+} // end of anonymous namespace
+
+//---------------------------------------------------------------------------
+int vtkCacheManagerTest1(int argc, char * argv[])
+{
+  if (argc != 2)
+    {
+    std::cerr << "Line " << __LINE__
+              << " - Missing parameters !\n"
+              << "Usage: " << argv[0] << " /path/to/temp"
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::string cacheDirectory = std::string(argv[1]) + "/vtkCacheManagerTest1";
+  vtksys::SystemTools::RemoveADirectory(cacheDirectory.c_str());
+
+  std::string fileName1;
+  std::string fileName2;
+  std::string fileName3;
+  std::string fileName4;
+  {
+    vtkNew<vtkCacheManager> cacheManager;
+    EXERCISE_BASIC_OBJECT_METHODS(cacheManager.GetPointer());
+    cacheManager->SetRemoteCacheDirectory(cacheDirectory.c_str());
+    cacheManager->SetRemoteCacheLimit(3);
+    cacheManager->SetRemoteCacheFreeBufferSize(0);
+    CHECK_DOUBLE(cacheManager->GetCurrentCacheSize(), 0.0);
+
+    // Files with the same name from different locations don't overwrite each other
+    fileName1 = DownloadFile(cacheManager.GetPointer(), "http://host1/data/image.nrrd");
+    fileName2 = DownloadFile(cacheManager.GetPointer(), "http://host2/data/image.nrrd");
+    CHECK_BOOL(fileName1 != fileName2, true);
+    CHECK_STD_STRING(vtksys::SystemTools::GetFilenameName(fileName1), "image.nrrd");
+    CHECK_STD_STRING(vtksys::SystemTools::GetFilenameName(fileName2), "image.nrrd");
+
+    // Companion files from the same location are stored in the same directory
+    std::string headerFileName = cacheManager->GetFilenameFromURI("http://host1/data/image.nhdr");
+    std::string dataFileName = cacheManager->GetFilenameFromURI("http://host1/data/image.raw");
+    CHECK_STD_STRING(vtksys::SystemTools::GetFilenamePath(headerFileName),
+      vtksys::SystemTools::GetFilenamePath(fileName1));
+    CHECK_STD_STRING(vtksys::SystemTools::GetFilenamePath(dataFileName),
+      vtksys::SystemTools::GetFilenamePath(fileName1));
+
+    fileName3 = DownloadFile(cacheManager.GetPointer(), "http://host1/data/model.vtk");
+    CHECK_DOUBLE(cacheManager->GetCurrentCacheSize(), 3.0);
+    cacheManager->CacheSizeCheck();
+    CHECK_INT(static_cast<int>(cacheManager->GetCachedFiles().size()), 3);
+
+    // Using a file makes it the most recently used
+    CHECK_INT(cacheManager->CachedFileExists(fileName1.c_str()), 1);
+
+    // Least recently used file is removed when the cache is full
+    fileName4 = DownloadFile(cacheManager.GetPointer(), "http://host1/data/labels.nrrd");
+    CHECK_DOUBLE(cacheManager->GetCurrentCacheSize(), 4.0);
+    cacheManager->CacheSizeCheck();
+    CHECK_DOUBLE(cacheManager->GetCurrentCacheSize(), 3.0);
+    CHECK_BOOL(vtksys::SystemTools::FileExists(fileName2.c_str()), false);
+    CHECK_INT(cacheManager->CachedFileExists(fileName2.c_str()), 0);
+    CHECK_BOOL(vtksys::SystemTools::FileExists(fileName1.c_str()), true);
+    CHECK_BOOL(vtksys::SystemTools::FileExists(fileName3.c_str()), true);
+    CHECK_BOOL(vtksys::SystemTools::FileExists(fileName4.c_str()), true);
+  }
+
+  // Index is read back with the usage order of the files
+  {
+    vtkNew<vtkCacheManager> cacheManager;
+    cacheManager->SetRemoteCacheDirectory(cacheDirectory.c_str());
+    CHECK_DOUBLE(cacheManager->GetCurrentCacheSize(), 3.0);
+    CHECK_INT(static_cast<int>(cacheManager->GetCachedFiles().size()), 3);
+    cacheManager->SetRemoteCacheLimit(2);
+    cacheManager->SetRemoteCacheFreeBufferSize(0);
+    cacheManager->CacheSizeCheck();
+    CHECK_BOOL(vtksys::SystemTools::FileExists(fileName3.c_str()), false);
+    CHECK_BOOL(vtksys::SystemTools::FileExists(fileName1.c_str()), true);
+    CHECK_BOOL(vtksys::SystemTools::FileExists(fileName4.c_str()), true);
+
+    CHECK_INT(cacheManager->ClearCache(), 1);
+    CHECK_DOUBLE(cacheManager->GetCurrentCacheSize(), 0.0);
+    CHECK_INT(static_cast<int>(cacheManager->GetCachedFiles().size()), 0);
+  }
+
+  // Pinned files (queued or being read) are not removed to make room
+  {
+    vtkNew<vtkCacheManager> cacheManager;
+    cacheManager->SetRemoteCacheDirectory(cacheDirectory.c_str());
+    cacheManager->SetRemoteCacheLimit(2);
+    cacheManager->SetRemoteCacheFreeBufferSize(0);
+    std::string pinnedFileName = DownloadFile(cacheManager.GetPointer(), "http://host1/pinned/image.nrrd");
+    std::string otherFileName = DownloadFile(cacheManager.GetPointer(), "http://host1/other/image.nrrd");
+    std::string newestFileName = DownloadFile(cacheManager.GetPointer(), "http://host1/newest/image.nrrd");
+    cacheManager->PinFile(pinnedFileName.c_str());
+    CHECK_BOOL(cacheManager->IsFilePinned(pinnedFileName.c_str()), true);
+    cacheManager->CacheSizeCheck();
+    CHECK_BOOL(vtksys::SystemTools::FileExists(pinnedFileName.c_str()), true);
+    CHECK_BOOL(vtksys::SystemTools::FileExists(otherFileName.c_str()), false);
+    CHECK_BOOL(vtksys::SystemTools::FileExists(newestFileName.c_str()), true);
+
+    cacheManager->UnpinFile(pinnedFileName.c_str());
+    CHECK_BOOL(cacheManager->IsFilePinned(pinnedFileName.c_str()), false);
+    cacheManager->SetRemoteCacheLimit(1);
+    cacheManager->CacheSizeCheck();
+    CHECK_BOOL(vtksys::SystemTools::FileExists(pinnedFileName.c_str()), false);
+    CHECK_BOOL(vtksys::SystemTools::FileExists(newestFileName.c_str()), true);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,196 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRML includes
+#include "vtkEventBroker.h"
+#include "vtkMRMLCoreTestingMacros.h"
+#include "vtkMRMLModelNode.h"
+
+// VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+
+// STD includes
+#include <vector>
+
+namespace
+{
+
+//---------------------------------------------------------------------------
+int ModifiedCount = 0;
+void CountModified(vtkObject* vtkNotUsed(caller), unsigned long vtkNotUsed(eid),
+                   void* vtkNotUsed(clientData), void* vtkNotUsed(callData))
+{
+  ++ModifiedCount;
+}
+
+//---------------------------------------------------------------------------
+std::vector<size_t> InvokedCallData;
+void RecordCallData(vtkObject* vtkNotUsed(caller), unsigned long vtkNotUsed(eid),
+                    void* vtkNotUsed(clientData), void* callData)
+{
+  InvokedCallData.push_back(reinterpret_cast<size_t>(callData));
+}
+
+//---------------------------------------------------------------------------
+struct PostEventsData
+{
+  vtkObject* Subjects[4];
+};
+
+//---------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE PostEvents(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  PostEventsData* data = static_cast<PostEventsData*>(info->UserData);
+  for (int i = 0; i < 1000; ++i)
+    {
+    vtkEventBroker::GetInstance()->PostEvent(
+      data->Subjects[info->ThreadID % 4], vtkCommand::ModifiedEvent);
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//---------------------------------------------------------------------------
+int TestEventBatch()
+{
+  vtkEventBroker* broker = vtkEventBroker::GetInstance();
+
+  vtkNew<vtkMRMLModelNode> subject;
+  vtkNew<vtkMRMLModelNode> observer;
+  vtkNew<vtkCallbackCommand> callback;
+  callback->SetCallback(CountModified);
+  vtkObservation* observation = broker->AddObservation(
+    subject.GetPointer(), vtkCommand::ModifiedEvent, observer.GetPointer(), callback.GetPointer());
+  CHECK_NOT_NULL(observation);
+  CHECK_BOOL(broker->GetObservationExist(subject.GetPointer(), vtkCommand::ModifiedEvent,
+                                         observer.GetPointer()), true);
+
+  ModifiedCount = 0;
+  subject->Modified();
+  subject->Modified();
+  CHECK_INT(ModifiedCount, 2);
+
+  // Duplicate events are collapsed within a batch
+  ModifiedCount = 0;
+  broker->StartEventBatch();
+  broker->StartEventBatch();
+  for (int i = 0; i < 100; ++i)
+    {
+    subject->Modified();
+    }
+  broker->EndEventBatch();
+  CHECK_INT(ModifiedCount, 0);
+  CHECK_INT(broker->GetNumberOfQueuedObservations(), 1);
+  broker->EndEventBatch();
+  CHECK_INT(ModifiedCount, 1);
+  CHECK_INT(broker->GetNumberOfQueuedObservations(), 0);
+
+  // Removed observations are removed from the queue
+  broker->StartEventBatch();
+  subject->Modified();
+  broker->RemoveObservations(subject.GetPointer(), observer.GetPointer());
+  CHECK_INT(broker->GetNumberOfQueuedObservations(), 0);
+  broker->EndEventBatch();
+  CHECK_INT(ModifiedCount, 1);
+  CHECK_BOOL(broker->GetObservationExist(subject.GetPointer()), false);
+
+  return EXIT_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+int TestPostedEvents()
+{
+  vtkEventBroker* broker = vtkEventBroker::GetInstance();
+
+  vtkNew<vtkMRMLModelNode> observer;
+  vtkNew<vtkCallbackCommand> callback;
+  callback->SetCallback(CountModified);
+  vtkNew<vtkMRMLModelNode> subjects[4];
+  PostEventsData data;
+  for (int i = 0; i < 4; ++i)
+    {
+    data.Subjects[i] = subjects[i].GetPointer();
+    broker->AddObservation(
+      subjects[i].GetPointer(), vtkCommand::ModifiedEvent, observer.GetPointer(), callback.GetPointer());
+    }
+
+  // Post events from several threads
+  vtkNew<vtkMultiThreader> threader;
+  threader->SetNumberOfThreads(8);
+  threader->SetSingleMethod(PostEvents, &data);
+  threader->SingleMethodExecute();
+  CHECK_INT(broker->GetNumberOfPostedEvents(), 8000);
+
+  // All the events are invoked on the main thread, only once per subject
+  ModifiedCount = 0;
+  CHECK_INT(broker->ProcessPostedEvents(), 4);
+  CHECK_INT(ModifiedCount, 4);
+  CHECK_INT(broker->GetNumberOfPostedEvents(), 0);
+  CHECK_INT(broker->ProcessPostedEvents(), 0);
+
+  broker->RemoveObservations(observer.GetPointer());
+  return EXIT_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+int TestPostedEventsOrder()
+{
+  vtkEventBroker* broker = vtkEventBroker::GetInstance();
+
+  vtkNew<vtkMRMLModelNode> subject;
+  vtkNew<vtkCallbackCommand> callback;
+  callback->SetCallback(RecordCallData);
+  subject->AddObserver(vtkCommand::UserEvent, callback.GetPointer());
+
+  // More events than the ring buffer holds, the last ones overflow
+  InvokedCallData.clear();
+  const size_t numberOfEvents = 10000;
+  for (size_t i = 1; i <= numberOfEvents; ++i)
+    {
+    broker->PostEvent(subject.GetPointer(), vtkCommand::UserEvent, reinterpret_cast<void*>(i));
+    }
+  CHECK_INT(broker->GetNumberOfPostedEvents(), static_cast<int>(numberOfEvents));
+  CHECK_INT(broker->ProcessPostedEvents(), static_cast<int>(numberOfEvents));
+
+  // Events posted after the overflow was taken go to the ring buffer again
+  for (size_t i = numberOfEvents + 1; i <= numberOfEvents + 10; ++i)
+    {
+    broker->PostEvent(subject.GetPointer(), vtkCommand::UserEvent, reinterpret_cast<void*>(i));
+    }
+  CHECK_INT(broker->ProcessPostedEvents(), 10);
+
+  // Events are invoked in the order they were posted
+  CHECK_INT(static_cast<int>(InvokedCallData.size()), static_cast<int>(numberOfEvents + 10));
+  for (size_t i = 0; i < InvokedCallData.size(); ++i)
+    {
+    CHECK_INT(static_cast<int>(InvokedCallData[i]), static_cast<int>(i + 1));
+    }
+  return EXIT_SUCCESS;
+}
+
+}
+
+//---------------------------------------------------------------------------
+int vtkEventBrokerTest1(int vtkNotUsed(argc), char * vtkNotUsed(argv) [])
+{
+  CHECK_EXIT_SUCCESS(TestEventBatch());
+  CHECK_EXIT_SUCCESS(TestPostedEvents());
+  CHECK_EXIT_SUCCESS(TestPostedEventsOrder());
+  return EXIT_SUCCESS;
+}
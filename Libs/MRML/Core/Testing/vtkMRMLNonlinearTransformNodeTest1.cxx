@@ -30,6 +30,9 @@
 
 #include "vtkMRMLCoreTestingMacros.h"
 
+// STD includes
+#include <sstream>
+
 int TestBSplineTransform(const char *filename);
 int TestGridTransform(const char *filename);
 int TestThinPlateSplineTransform(const char *filename);
@@ -37,6 +40,7 @@ int TestCompositeTransformHardenSplit(const char *filename);
 int TestBSplineLinearCompositeTransformSplit(const char *filename);
 int TestRelativeTransforms(const char *filename);
 int TestGetTransform();
+int TestBakedTransform(const char *filename);
 
 int vtkMRMLNonlinearTransformNodeTest1(int argc, char * argv[] )
 {
@@ -55,6 +59,7 @@ int vtkMRMLNonlinearTransformNodeTest1(int argc, char * argv[] )
   CHECK_EXIT_SUCCESS(TestBSplineLinearCompositeTransformSplit(filename));
   CHECK_EXIT_SUCCESS(TestRelativeTransforms(filename));
   CHECK_EXIT_SUCCESS(TestGetTransform());
+  CHECK_EXIT_SUCCESS(TestBakedTransform(filename));
 
   std::cout << "Success" << std::endl;
   return EXIT_SUCCESS;
@@ -415,3 +420,116 @@ int TestGetTransform()
 
   return EXIT_SUCCESS;
 }
+
+//---------------------------------------------------------------------------
+int TestBakedTransform(const char *filename)
+{
+  vtkNew<vtkMRMLScene> scene;
+  scene->SetURL(filename);
+  scene->Import();
+
+  // WORLD
+  //  |-- gridTransformNode
+  //       |-- bsplineTransformNode
+  //              |-- compositeTransformNode
+  vtkMRMLTransformNode *gridTransformNode = vtkMRMLTransformNode::SafeDownCast(
+    scene->GetNodeByID("vtkMRMLGridTransformNode1"));
+  vtkMRMLTransformNode *bsplineTransformNode = vtkMRMLTransformNode::SafeDownCast(
+    scene->GetNodeByID("vtkMRMLBSplineTransformNode1"));
+  vtkMRMLTransformNode *compositeTransformNode = vtkMRMLTransformNode::SafeDownCast(
+    scene->GetNodeByID("vtkMRMLTransformNode2"));
+  bsplineTransformNode->SetAndObserveTransformNodeID(gridTransformNode->GetID());
+  compositeTransformNode->SetAndObserveTransformNodeID(bsplineTransformNode->GetID());
+
+  vtkNew<vtkPointSource> pointSource;
+  pointSource->SetCenter(0,0,0);
+  pointSource->SetNumberOfPoints(100);
+  pointSource->SetRadius(25.0);
+  pointSource->Update();
+  vtkPoints* testPoints = pointSource->GetOutput()->GetPoints();
+
+  // Baking is disabled by default
+  CHECK_NULL(compositeTransformNode->GetBakedTransformFromWorld());
+
+  // Baking requires a region
+  compositeTransformNode->SetBakeTransform(true);
+  CHECK_NULL(compositeTransformNode->GetBakedTransformFromWorld());
+
+  double bounds[6] = { -30.0, 30.0, -30.0, 30.0, -30.0, 30.0 };
+  double spacing[3] = { 1.0, 1.0, 1.0 };
+  compositeTransformNode->SetBakedTransformRegion(bounds, spacing);
+  CHECK_NOT_NULL(compositeTransformNode->GetBakedTransformToWorld());
+  CHECK_NOT_NULL(compositeTransformNode->GetBakedTransformFromWorld());
+
+  // Baked transform is reused until the chain is modified
+  vtkOrientedGridTransform* bakedTransformFromWorld = compositeTransformNode->GetBakedTransformFromWorld();
+  CHECK_POINTER(compositeTransformNode->GetBakedTransformFromWorld(), bakedTransformFromWorld);
+
+  // Baked transform gives the same result as the transform chain
+  vtkNew<vtkGeneralTransform> chainFromWorld;
+  vtkMRMLTransformNode::GetTransformBetweenNodes(NULL, compositeTransformNode, chainFromWorld.GetPointer());
+  vtkNew<vtkGeneralTransform> chainToWorld;
+  vtkMRMLTransformNode::GetTransformBetweenNodes(compositeTransformNode, NULL, chainToWorld.GetPointer());
+  vtkNew<vtkGeneralTransform> bakedFromWorld;
+  compositeTransformNode->GetDisplayTransformFromWorld(bakedFromWorld.GetPointer());
+  vtkNew<vtkGeneralTransform> bakedToWorld;
+  compositeTransformNode->GetDisplayTransformToWorld(bakedToWorld.GetPointer());
+
+  vtkNew<vtkPoints> chainPoints;
+  vtkNew<vtkPoints> bakedPoints;
+  CHECK_EXIT_SUCCESS(transformPoints(chainFromWorld.GetPointer(), testPoints, chainPoints.GetPointer()));
+  CHECK_EXIT_SUCCESS(transformPoints(bakedFromWorld.GetPointer(), testPoints, bakedPoints.GetPointer()));
+  CHECK_BOOL(isSamePointPositions(testPoints, bakedPoints.GetPointer()), false);
+  CHECK_BOOL(isSamePointPositions(chainPoints.GetPointer(), bakedPoints.GetPointer()), true);
+  CHECK_EXIT_SUCCESS(transformPoints(chainToWorld.GetPointer(), testPoints, chainPoints.GetPointer()));
+  CHECK_EXIT_SUCCESS(transformPoints(bakedToWorld.GetPointer(), testPoints, bakedPoints.GetPointer()));
+  CHECK_BOOL(isSamePointPositions(chainPoints.GetPointer(), bakedPoints.GetPointer()), true);
+
+  // Only the display transform is baked, the transform from world is the exact chain
+  vtkNew<vtkGeneralTransform> exactFromWorld;
+  compositeTransformNode->GetTransformFromWorld(exactFromWorld.GetPointer());
+  vtkNew<vtkCollection> exactTransformList;
+  vtkMRMLTransformNode::FlattenGeneralTransform(exactTransformList.GetPointer(), exactFromWorld.GetPointer());
+  CHECK_BOOL(exactTransformList->GetNumberOfItems() > 1, true);
+
+  // Modifying a parent transform invalidates the baked transform
+  gridTransformNode->Inverse();
+  vtkMRMLTransformNode::GetTransformBetweenNodes(NULL, compositeTransformNode, chainFromWorld.GetPointer());
+  compositeTransformNode->GetDisplayTransformFromWorld(bakedFromWorld.GetPointer());
+  CHECK_EXIT_SUCCESS(transformPoints(chainFromWorld.GetPointer(), testPoints, chainPoints.GetPointer()));
+  CHECK_EXIT_SUCCESS(transformPoints(bakedFromWorld.GetPointer(), testPoints, bakedPoints.GetPointer()));
+  CHECK_BOOL(isSamePointPositions(chainPoints.GetPointer(), bakedPoints.GetPointer()), true);
+
+  // Bake settings are saved in the scene
+  std::stringstream ss;
+  compositeTransformNode->WriteXML(ss, 0);
+  CHECK_BOOL(ss.str().find(" bakeTransform=\"true\"") != std::string::npos, true);
+  CHECK_BOOL(ss.str().find(" bakedTransformBounds=\"-30 30 -30 30 -30 30\"") != std::string::npos, true);
+  CHECK_BOOL(ss.str().find(" bakedTransformSpacing=\"1 1 1\"") != std::string::npos, true);
+
+  vtkNew<vtkMRMLTransformNode> readTransformNode;
+  const char* atts[] = {
+    "bakeTransform", "true",
+    "bakedTransformBounds", "-30 30 -20 20 -10 10",
+    "bakedTransformSpacing", "1 2 3",
+    NULL };
+  readTransformNode->ReadXMLAttributes(atts);
+  double readBounds[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+  double readSpacing[3] = { 0.0, 0.0, 0.0 };
+  readTransformNode->GetBakedTransformRegion(readBounds, readSpacing);
+  CHECK_BOOL(readTransformNode->GetBakeTransform(), true);
+  CHECK_DOUBLE(readBounds[2], -20.0);
+  CHECK_DOUBLE(readBounds[5], 10.0);
+  CHECK_DOUBLE(readSpacing[2], 3.0);
+
+  // Transform chain is used again when baking is disabled
+  compositeTransformNode->SetBakeTransform(false);
+  CHECK_NULL(compositeTransformNode->GetBakedTransformFromWorld());
+  compositeTransformNode->GetDisplayTransformFromWorld(bakedFromWorld.GetPointer());
+  vtkNew<vtkCollection> transformList;
+  vtkMRMLTransformNode::FlattenGeneralTransform(transformList.GetPointer(), bakedFromWorld.GetPointer());
+  CHECK_BOOL(transformList->GetNumberOfItems() > 1, true);
+
+  scene->Clear(1);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+#include "vtkMRMLFreeSurferModelStorageNode.h"
+#include "vtkMRMLModelNode.h"
+#include "vtkMRMLModelStorageNode.h"
+#include "vtkMRMLScalarVolumeNode.h"
+#include "vtkMRMLScene.h"
+#include "vtkMRMLStorageNode.h"
+#include "vtkMRMLVolumeArchetypeStorageNode.h"
+
+// VTK includes
+#include <vtkCylinderSource.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+
+// STD includes
+#include <sstream>
+#include <vector>
+
+//---------------------------------------------------------------------------
+int vtkMRMLSceneImportReadDataTest(int argc, char * argv[] )
+{
+  if (argc != 2)
+    {
+    std::cerr << "Usage: " << argv[0] << " /path/to/temp" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const char* tempDir = argv[1];
+
+  // Write models and volumes of different sizes
+  std::vector<std::string> modelNodeIDs;
+  std::vector<int> numberOfPoints;
+  std::vector<std::string> volumeNodeIDs;
+  std::string sceneXML;
+  {
+    vtkNew<vtkMRMLScene> scene;
+    scene->SetRootDirectory(tempDir);
+    for (int i = 0; i < 6; ++i)
+      {
+      vtkNew<vtkCylinderSource> cylinder;
+      cylinder->SetResolution(10 + i * 100);
+      cylinder->Update();
+
+      vtkNew<vtkMRMLModelNode> modelNode;
+      modelNode->SetAndObservePolyData(cylinder->GetOutput());
+      CHECK_NOT_NULL(scene->AddNode(modelNode.GetPointer()));
+      modelNode->AddDefaultStorageNode();
+      vtkMRMLStorageNode* storageNode = modelNode->GetStorageNode();
+      CHECK_NOT_NULL(storageNode);
+      std::stringstream fileName;
+      fileName << tempDir << "/vtkMRMLSceneImportReadDataTest" << i << ".vtk";
+      storageNode->SetFileName(fileName.str().c_str());
+      CHECK_BOOL(storageNode->WriteData(modelNode.GetPointer()), true);
+
+      modelNodeIDs.push_back(modelNode->GetID());
+      numberOfPoints.push_back(cylinder->GetOutput()->GetNumberOfPoints());
+      }
+
+    // Volumes of different sizes, the voxel value is the index of the volume
+    for (int i = 0; i < 4; ++i)
+      {
+      vtkNew<vtkImageData> image;
+      image->SetDimensions(10 + i * 20, 11, 12);
+      image->AllocateScalars(VTK_SHORT, 1);
+      short* voxels = static_cast<short*>(image->GetScalarPointer());
+      for (vtkIdType voxelIndex = 0; voxelIndex < image->GetNumberOfPoints(); ++voxelIndex)
+        {
+        voxels[voxelIndex] = static_cast<short>(i);
+        }
+
+      vtkNew<vtkMRMLScalarVolumeNode> volumeNode;
+      volumeNode->SetAndObserveImageData(image.GetPointer());
+      CHECK_NOT_NULL(scene->AddNode(volumeNode.GetPointer()));
+      volumeNode->AddDefaultStorageNode();
+      vtkMRMLStorageNode* storageNode = volumeNode->GetStorageNode();
+      CHECK_NOT_NULL(vtkMRMLVolumeArchetypeStorageNode::SafeDownCast(storageNode));
+      std::stringstream fileName;
+      fileName << tempDir << "/vtkMRMLSceneImportReadDataTest" << i << ".nrrd";
+      storageNode->SetFileName(fileName.str().c_str());
+      CHECK_BOOL(storageNode->WriteData(volumeNode.GetPointer()), true);
+
+      volumeNodeIDs.push_back(volumeNode->GetID());
+      }
+    scene->SetSaveToXMLString(1);
+    CHECK_INT(scene->Commit(), 1);
+    sceneXML = scene->GetSceneXMLString();
+  }
+
+  // Files are read the same way in the main thread and in parallel threads
+  int numberOfThreads[2] = {1, 4};
+  for (int n = 0; n < 2; ++n)
+    {
+    vtkNew<vtkMRMLScene> scene;
+    scene->SetRootDirectory(tempDir);
+    scene->SetNumberOfReadDataThreads(numberOfThreads[n]);
+    CHECK_INT(scene->GetNumberOfReadDataThreads(), numberOfThreads[n]);
+    scene->SetLoadFromXMLString(1);
+    scene->SetSceneXMLString(sceneXML);
+    CHECK_INT(scene->Import(), 1);
+    CHECK_INT(static_cast<int>(scene->GetErrorCode()), 0);
+
+    for (size_t i = 0; i < modelNodeIDs.size(); ++i)
+      {
+      vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(
+        scene->GetNodeByID(modelNodeIDs[i].c_str()));
+      CHECK_NOT_NULL(modelNode);
+      CHECK_NOT_NULL(modelNode->GetPolyData());
+      CHECK_INT(modelNode->GetPolyData()->GetNumberOfPoints(), numberOfPoints[i]);
+      CHECK_NOT_NULL(modelNode->GetStorageNode());
+      CHECK_INT(modelNode->GetStorageNode()->GetReadState(), vtkMRMLStorageNode::Idle);
+      }
+
+    for (size_t i = 0; i < volumeNodeIDs.size(); ++i)
+      {
+      vtkMRMLScalarVolumeNode* volumeNode = vtkMRMLScalarVolumeNode::SafeDownCast(
+        scene->GetNodeByID(volumeNodeIDs[i].c_str()));
+      CHECK_NOT_NULL(volumeNode);
+      vtkImageData* image = volumeNode->GetImageData();
+      CHECK_NOT_NULL(image);
+      int* dimensions = image->GetDimensions();
+      CHECK_INT(dimensions[0], 10 + static_cast<int>(i) * 20);
+      CHECK_INT(dimensions[1], 11);
+      CHECK_INT(dimensions[2], 12);
+      CHECK_INT(image->GetScalarType(), VTK_SHORT);
+      CHECK_INT(static_cast<int>(image->GetScalarComponentAsDouble(dimensions[0] - 1, 10, 11, 0)), static_cast<int>(i));
+      CHECK_NOT_NULL(volumeNode->GetStorageNode());
+      CHECK_INT(volumeNode->GetStorageNode()->GetReadState(), vtkMRMLStorageNode::Idle);
+      }
+    }
+
+  // Subclasses of storage nodes that read and write in threads do not inherit it
+  vtkNew<vtkMRMLModelNode> modelNode;
+  vtkNew<vtkMRMLModelStorageNode> modelStorageNode;
+  CHECK_BOOL(modelStorageNode->CanReadDataInThread(modelNode.GetPointer()), true);
+  CHECK_BOOL(modelStorageNode->CanWriteDataInThread(modelNode.GetPointer()), true);
+  vtkNew<vtkMRMLFreeSurferModelStorageNode> freeSurferStorageNode;
+  CHECK_BOOL(freeSurferStorageNode->CanReadDataInThread(modelNode.GetPointer()), false);
+  CHECK_BOOL(freeSurferStorageNode->CanWriteDataInThread(modelNode.GetPointer()), false);
+  vtkNew<vtkMRMLScalarVolumeNode> volumeNode;
+  vtkNew<vtkMRMLVolumeArchetypeStorageNode> volumeStorageNode;
+  CHECK_BOOL(volumeStorageNode->CanReadDataInThread(volumeNode.GetPointer()), true);
+
+  return EXIT_SUCCESS;
+}
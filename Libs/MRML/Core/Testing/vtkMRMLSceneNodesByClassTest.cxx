@@ -0,0 +1,198 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+#include "vtkMRMLLinearTransformNode.h"
+#include "vtkMRMLModelNode.h"
+#include "vtkMRMLScalarVolumeNode.h"
+#include "vtkMRMLScene.h"
+#include "vtkMRMLTableNode.h"
+
+// VTK includes
+#include <vtkCollection.h>
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkTimerLog.h>
+
+// STD includes
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+//---------------------------------------------------------------------------
+int TestNodesByClass()
+{
+  vtkNew<vtkMRMLScene> scene;
+
+  vtkNew<vtkMRMLModelNode> model1;
+  vtkNew<vtkMRMLScalarVolumeNode> volume1;
+  vtkNew<vtkMRMLModelNode> model2;
+  vtkNew<vtkMRMLLinearTransformNode> transform1;
+
+  // Lists are computed on first request
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLModelNode"), 0);
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLDisplayableNode"), 0);
+
+  // ... and kept up to date when nodes are added
+  scene->AddNode(model1.GetPointer());
+  scene->AddNode(volume1.GetPointer());
+  scene->AddNode(model2.GetPointer());
+  scene->AddNode(transform1.GetPointer());
+
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLModelNode"), 2);
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLDisplayableNode"), 3);
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLTransformableNode"), 4);
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLTableNode"), 0);
+
+  // Order of the nodes in the scene is preserved
+  CHECK_POINTER(scene->GetFirstNodeByClass("vtkMRMLDisplayableNode"), model1.GetPointer());
+  CHECK_POINTER(scene->GetNthNodeByClass(1, "vtkMRMLDisplayableNode"), volume1.GetPointer());
+  CHECK_POINTER(scene->GetNthNodeByClass(2, "vtkMRMLDisplayableNode"), model2.GetPointer());
+  CHECK_NULL(scene->GetNthNodeByClass(3, "vtkMRMLDisplayableNode"));
+
+  std::vector<vtkMRMLNode*> nodes;
+  CHECK_INT(scene->GetNodesByClass("vtkMRMLModelNode", nodes), 2);
+  CHECK_POINTER(nodes[0], model1.GetPointer());
+  CHECK_POINTER(nodes[1], model2.GetPointer());
+  // Previous content of the vector is replaced
+  CHECK_INT(scene->GetNodesByClass("vtkMRMLLinearTransformNode", nodes), 1);
+  CHECK_POINTER(nodes[0], transform1.GetPointer());
+
+  // Removed nodes are removed from the lists
+  scene->RemoveNode(volume1.GetPointer());
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLDisplayableNode"), 2);
+  CHECK_POINTER(scene->GetNthNodeByClass(1, "vtkMRMLDisplayableNode"), model2.GetPointer());
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLScalarVolumeNode"), 0);
+
+  // Inserting a node in the middle of the scene invalidates the lists
+  vtkNew<vtkMRMLModelNode> model3;
+  scene->InsertBeforeNode(model2.GetPointer(), model3.GetPointer());
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLModelNode"), 3);
+  CHECK_POINTER(scene->GetNthNodeByClass(1, "vtkMRMLModelNode"), model3.GetPointer());
+  CHECK_POINTER(scene->GetNthNodeByClass(2, "vtkMRMLModelNode"), model2.GetPointer());
+
+  vtkSmartPointer<vtkCollection> models =
+    vtkSmartPointer<vtkCollection>::Take(scene->GetNodesByClass("vtkMRMLModelNode"));
+  CHECK_INT(models->GetNumberOfItems(), 3);
+  CHECK_POINTER(models->GetItemAsObject(2), model2.GetPointer());
+
+  model3->SetName("Model3");
+  vtkSmartPointer<vtkCollection> namedModels =
+    vtkSmartPointer<vtkCollection>::Take(scene->GetNodesByClassByName("vtkMRMLModelNode", "Model3"));
+  CHECK_INT(namedModels->GetNumberOfItems(), 1);
+
+  scene->Clear(1);
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLModelNode"), 0);
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLTransformableNode"), 0);
+
+  return EXIT_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+std::vector<vtkMRMLNode*> GetNodesByClassLinearScan(vtkMRMLScene* scene, const char* className)
+{
+  std::vector<vtkMRMLNode*> nodes;
+  vtkMRMLNode* node = NULL;
+  vtkCollectionSimpleIterator it;
+  for (scene->GetNodes()->InitTraversal(it);
+       (node = vtkMRMLNode::SafeDownCast(scene->GetNodes()->GetNextItemAsObject(it))) ;)
+    {
+    if (node->IsA(className))
+      {
+      nodes.push_back(node);
+      }
+    }
+  return nodes;
+}
+
+//---------------------------------------------------------------------------
+int TestNodesByClassScaling()
+{
+  // A few nodes of the queried classes, lost among many other nodes
+  vtkNew<vtkMRMLScene> scene;
+  for (int i = 0; i < 16000; ++i)
+    {
+    vtkSmartPointer<vtkMRMLNode> node;
+    if (i % 1000 == 0)
+      {
+      node = vtkSmartPointer<vtkMRMLModelNode>::New();
+      }
+    else if (i % 1000 == 500)
+      {
+      node = vtkSmartPointer<vtkMRMLScalarVolumeNode>::New();
+      }
+    else
+      {
+      node = vtkSmartPointer<vtkMRMLTableNode>::New();
+      }
+    scene->AddNode(node);
+    }
+  // Remove some nodes after the lists are built
+  scene->GetNumberOfNodesByClass("vtkMRMLDisplayableNode");
+  scene->RemoveNode(scene->GetNthNodeByClass(3, "vtkMRMLModelNode"));
+  scene->RemoveNode(scene->GetNthNodeByClass(5, "vtkMRMLScalarVolumeNode"));
+
+  // Indexed lists must match the linear scan of the scene
+  const char* classNames[] = {"vtkMRMLModelNode", "vtkMRMLScalarVolumeNode", "vtkMRMLDisplayableNode", "vtkMRMLTableNode"};
+  for (int c = 0; c < 4; ++c)
+    {
+    std::vector<vtkMRMLNode*> expectedNodes = GetNodesByClassLinearScan(scene.GetPointer(), classNames[c]);
+    std::vector<vtkMRMLNode*> nodes;
+    CHECK_INT(scene->GetNodesByClass(classNames[c], nodes), static_cast<int>(expectedNodes.size()));
+    CHECK_BOOL(nodes == expectedNodes, true);
+    }
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLModelNode"), 15);
+  CHECK_INT(scene->GetNumberOfNodesByClass("vtkMRMLDisplayableNode"), 30);
+
+  // Indexed lookup must be faster than the linear scan it replaces
+  const int numberOfQueries = 200;
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  size_t numberOfScannedModels = 0;
+  for (int i = 0; i < numberOfQueries; ++i)
+    {
+    numberOfScannedModels += GetNodesByClassLinearScan(scene.GetPointer(), "vtkMRMLModelNode").size();
+    }
+  timer->StopTimer();
+  double linearScanTime = timer->GetElapsedTime();
+  timer->StartTimer();
+  size_t numberOfIndexedModels = 0;
+  for (int i = 0; i < numberOfQueries; ++i)
+    {
+    numberOfIndexedModels += scene->GetNumberOfNodesByClass("vtkMRMLModelNode");
+    }
+  timer->StopTimer();
+  double indexedTime = timer->GetElapsedTime();
+  std::cout << numberOfQueries << " queries in a scene of " << scene->GetNumberOfNodes() << " nodes: "
+            << linearScanTime << "s with linear scan, " << indexedTime << "s with index" << std::endl;
+  CHECK_INT(static_cast<int>(numberOfIndexedModels), static_cast<int>(numberOfScannedModels));
+  CHECK_BOOL(indexedTime < linearScanTime, true);
+  return EXIT_SUCCESS;
+}
+
+}
+
+//---------------------------------------------------------------------------
+int vtkMRMLSceneNodesByClassTest(int vtkNotUsed(argc), char * vtkNotUsed(argv) [])
+{
+  CHECK_EXIT_SUCCESS(TestNodesByClass());
+  CHECK_EXIT_SUCCESS(TestNodesByClassScaling());
+  return EXIT_SUCCESS;
+}
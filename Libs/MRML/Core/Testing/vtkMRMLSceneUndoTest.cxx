@@ -0,0 +1,171 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Copyright (c) Kitware Inc.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+#include "vtkMRMLModelNode.h"
+#include "vtkMRMLScalarVolumeNode.h"
+#include "vtkMRMLScene.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkNew.h>
+
+// STD includes
+#include <string>
+
+namespace
+{
+
+//---------------------------------------------------------------------------
+int TestUndoRedoNodeModification()
+{
+  vtkNew<vtkMRMLScene> scene;
+  scene->SetUndoOn();
+
+  vtkNew<vtkMRMLModelNode> model;
+  model->SetName("Original");
+  scene->AddNode(model.GetPointer());
+
+  scene->SaveStateForUndo(model.GetPointer());
+  model->SetName("Modified");
+  CHECK_INT(scene->GetNumberOfUndoLevels(), 1);
+
+  scene->Undo();
+  CHECK_STRING(model->GetName(), "Original");
+  CHECK_INT(scene->GetNumberOfUndoLevels(), 0);
+  CHECK_INT(scene->GetNumberOfRedoLevels(), 1);
+
+  scene->Redo();
+  CHECK_STRING(model->GetName(), "Modified");
+  CHECK_INT(scene->GetNumberOfUndoLevels(), 1);
+  CHECK_INT(scene->GetNumberOfRedoLevels(), 0);
+
+  return EXIT_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+int TestUndoRedoAddRemove()
+{
+  vtkNew<vtkMRMLScene> scene;
+  scene->SetUndoOn();
+
+  vtkNew<vtkMRMLModelNode> model1;
+  model1->SetName("Original");
+  scene->AddNode(model1.GetPointer());
+  std::string model1ID = model1->GetID();
+
+  // Saving the whole scene copies all its nodes. Nodes added afterward are
+  // only recorded by ID, nodes removed afterward are copied when removed.
+  scene->SaveStateForUndo();
+  vtkNew<vtkMRMLModelNode> model2;
+  scene->AddNode(model2.GetPointer());
+  std::string model2ID = model2->GetID();
+  scene->RemoveNode(model1.GetPointer());
+  CHECK_INT(scene->GetNumberOfNodes(), 1);
+
+  // Changes of the node after it is removed are not restored by undo
+  model1->SetName("ModifiedAfterRemove");
+
+  // Undo and redo add back copies of the removed nodes
+  scene->Undo();
+  CHECK_INT(scene->GetNumberOfNodes(), 1);
+  CHECK_NOT_NULL(scene->GetNodeByID(model1ID));
+  CHECK_STRING(scene->GetNodeByID(model1ID)->GetName(), "Original");
+  CHECK_NULL(scene->GetNodeByID(model2ID));
+
+  scene->Redo();
+  CHECK_INT(scene->GetNumberOfNodes(), 1);
+  CHECK_NULL(scene->GetNodeByID(model1ID));
+  CHECK_NOT_NULL(scene->GetNodeByID(model2ID));
+
+  // A node added then removed before undo is not restored
+  scene->SaveStateForUndo();
+  vtkNew<vtkMRMLModelNode> model3;
+  scene->AddNode(model3.GetPointer());
+  scene->RemoveNode(model3.GetPointer());
+  scene->Undo();
+  CHECK_INT(scene->GetNumberOfNodes(), 1);
+  CHECK_BOOL(scene->IsNodePresent(model3.GetPointer()) != 0, false);
+
+  return EXIT_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+int TestUndoMemoryLimit()
+{
+  vtkNew<vtkMRMLScene> scene;
+  scene->SetUndoOn();
+
+  vtkNew<vtkMRMLScalarVolumeNode> volume;
+  scene->AddNode(volume.GetPointer());
+
+  for (int i = 0; i < 5; ++i)
+    {
+    // about 1MB image data for each state
+    vtkNew<vtkImageData> imageData;
+    imageData->SetDimensions(64, 64, 64);
+    imageData->AllocateScalars(VTK_INT, 1);
+    volume->SetAndObserveImageData(imageData.GetPointer());
+    scene->SaveStateForUndo(volume.GetPointer());
+    }
+  CHECK_INT(scene->GetNumberOfUndoLevels(), 5);
+  // The image data of the current state is shared with the node in the scene
+  CHECK_BOOL(scene->GetUndoStackMemorySize() < 4 * 1024 + 100, true);
+
+  vtkNew<vtkImageData> imageData;
+  imageData->SetDimensions(64, 64, 64);
+  imageData->AllocateScalars(VTK_INT, 1);
+  volume->SetAndObserveImageData(imageData.GetPointer());
+  CHECK_BOOL(scene->GetUndoStackMemorySize() > 4 * 1024, true);
+
+  // Only the states that fit in the memory budget are kept
+  scene->SetMaximumUndoMemorySize(2 * 1024 + 100);
+  scene->SaveStateForUndo(volume.GetPointer());
+  CHECK_INT(scene->GetNumberOfUndoLevels(), 3);
+  CHECK_BOOL(scene->GetUndoStackMemorySize() <= scene->GetMaximumUndoMemorySize(), true);
+
+  scene->ClearUndoStack();
+  CHECK_INT(scene->GetUndoStackMemorySize(), 0);
+
+  // Image data of removed nodes is only retained by the undo stack
+  scene->SetMaximumUndoMemorySize(0);
+  scene->SaveStateForUndo(volume.GetPointer());
+  scene->RemoveNode(volume.GetPointer());
+  CHECK_BOOL(scene->GetUndoStackMemorySize() > 1000, true);
+
+  // and it is discarded with the state that retains it
+  scene->SetMaximumUndoMemorySize(100);
+  vtkNew<vtkMRMLModelNode> model;
+  scene->AddNode(model.GetPointer());
+  scene->SaveStateForUndo(model.GetPointer());
+  CHECK_INT(scene->GetNumberOfUndoLevels(), 1);
+  CHECK_INT(scene->GetUndoStackMemorySize(), 0);
+
+  return EXIT_SUCCESS;
+}
+
+}
+
+//---------------------------------------------------------------------------
+int vtkMRMLSceneUndoTest(int vtkNotUsed(argc), char * vtkNotUsed(argv) [])
+{
+  CHECK_EXIT_SUCCESS(TestUndoRedoNodeModification());
+  CHECK_EXIT_SUCCESS(TestUndoRedoAddRemove());
+  CHECK_EXIT_SUCCESS(TestUndoMemoryLimit());
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,167 @@
+/*=auto=========================================================================
+
+  Portions (c) Copyright 2005 Brigham and Women's Hospital (BWH)
+  All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Program:   3D Slicer
+
+=========================================================================auto=*/
+
+// MRML includes
+#include "vtkMRMLConfigure.h"
+#include "vtkMRMLCoreTestingMacros.h"
+#include "vtkMRMLScalarVolumeNode.h"
+#include "vtkMRMLScene.h"
+#include "vtkMRMLVolumeArchetypeStorageNode.h"
+#ifdef MRML_USE_vtkTeem
+#include "vtkNRRDReader.h"
+#endif
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+
+// VTKsys includes
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <string>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+void FillImage(vtkImageData* image)
+{
+  image->SetDimensions(10, 11, 12);
+  image->AllocateScalars(VTK_SHORT, 1);
+  short* voxels = static_cast<short*>(image->GetScalarPointer());
+  vtkIdType numberOfVoxels = image->GetNumberOfPoints();
+  for (vtkIdType i = 0; i < numberOfVoxels; ++i)
+    {
+    voxels[i] = static_cast<short>(i % 1000);
+    }
+}
+
+//----------------------------------------------------------------------------
+bool HasExpectedVoxels(vtkImageData* image)
+{
+  if (!image || image->GetScalarType() != VTK_SHORT
+    || image->GetNumberOfPoints() != 10 * 11 * 12)
+    {
+    std::cerr << "Unexpected image" << std::endl;
+    return false;
+    }
+  short* voxels = static_cast<short*>(image->GetScalarPointer());
+  for (vtkIdType i = 0; i < image->GetNumberOfPoints(); ++i)
+    {
+    if (voxels[i] != static_cast<short>(i % 1000))
+      {
+      std::cerr << "Unexpected voxel value at " << i << ": " << voxels[i] << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+#ifdef MRML_USE_vtkTeem
+//----------------------------------------------------------------------------
+bool IsMemoryMapped(vtkImageData* image)
+{
+  vtkDataArray* scalars = image ? image->GetPointData()->GetScalars() : NULL;
+  return scalars && scalars->GetInformation()->Has(vtkNRRDReader::MEMORY_MAPPED_FILE_NAME());
+}
+#endif
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkMRMLVolumeArchetypeStorageNodeMemoryMappingTest1(int argc, char* argv[])
+{
+  if (argc < 2)
+    {
+    std::cerr << "Usage: " << argv[0] << " /path/to/temp" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+#ifdef MRML_USE_vtkTeem
+  std::string fileName = std::string(argv[1]) + "/vtkMRMLVolumeArchetypeStorageNodeMemoryMappingTest1.nrrd";
+
+  vtkNew<vtkMRMLScene> scene;
+
+  // Write an uncompressed volume, memory mapping requires raw encoding
+  vtkNew<vtkImageData> image;
+  FillImage(image.GetPointer());
+  vtkNew<vtkMRMLScalarVolumeNode> volumeNode;
+  scene->AddNode(volumeNode.GetPointer());
+  volumeNode->SetAndObserveImageData(image.GetPointer());
+  vtkNew<vtkMRMLVolumeArchetypeStorageNode> storageNode;
+  scene->AddNode(storageNode.GetPointer());
+  storageNode->SetFileName(fileName.c_str());
+  storageNode->SetUseCompression(0);
+  CHECK_INT(storageNode->WriteData(volumeNode.GetPointer()), 1);
+  // Removing the file of a previous run of the test is reported as a warning
+  TESTING_OUTPUT_RESET();
+
+  // Load it with memory mapping
+  vtkNew<vtkMRMLScalarVolumeNode> mappedVolumeNode;
+  scene->AddNode(mappedVolumeNode.GetPointer());
+  vtkNew<vtkMRMLVolumeArchetypeStorageNode> mappedStorageNode;
+  scene->AddNode(mappedStorageNode.GetPointer());
+  mappedStorageNode->SetFileName(fileName.c_str());
+  mappedStorageNode->SetUseCompression(0);
+  mappedStorageNode->SetUseMemoryMapping(1);
+  CHECK_INT(mappedStorageNode->ReadData(mappedVolumeNode.GetPointer()), 1);
+  CHECK_BOOL(HasExpectedVoxels(mappedVolumeNode->GetImageData()), true);
+#ifndef _WIN32
+  CHECK_BOOL(IsMemoryMapped(mappedVolumeNode->GetImageData()), true);
+#endif
+
+  // Another image shares the mapped voxels
+  vtkNew<vtkImageData> sharedImage;
+  sharedImage->ShallowCopy(mappedVolumeNode->GetImageData());
+
+  // Save it to the file it is mapped from. The voxels must be detached from
+  // the file first, otherwise replacing the file corrupts them.
+  TESTING_OUTPUT_ASSERT_WARNINGS_BEGIN();
+  CHECK_INT(mappedStorageNode->WriteData(mappedVolumeNode.GetPointer()), 1);
+  TESTING_OUTPUT_ASSERT_WARNINGS_END(); // removing old version of file
+  CHECK_BOOL(IsMemoryMapped(mappedVolumeNode->GetImageData()), false);
+  CHECK_BOOL(HasExpectedVoxels(mappedVolumeNode->GetImageData()), true);
+  // Images that share the voxels are detached too
+  CHECK_BOOL(IsMemoryMapped(sharedImage.GetPointer()), false);
+  CHECK_BOOL(HasExpectedVoxels(sharedImage.GetPointer()), true);
+
+  // Reload the saved file
+  vtkNew<vtkMRMLScalarVolumeNode> reloadedVolumeNode;
+  scene->AddNode(reloadedVolumeNode.GetPointer());
+  vtkNew<vtkMRMLVolumeArchetypeStorageNode> reloadedStorageNode;
+  scene->AddNode(reloadedStorageNode.GetPointer());
+  reloadedStorageNode->SetFileName(fileName.c_str());
+  CHECK_INT(reloadedStorageNode->ReadData(reloadedVolumeNode.GetPointer()), 1);
+  CHECK_BOOL(HasExpectedVoxels(reloadedVolumeNode->GetImageData()), true);
+
+  // Write in the steps used for writing in a background thread: the file
+  // list is only updated at the end, in the main thread
+  std::string threadFileName = std::string(argv[1]) + "/vtkMRMLVolumeArchetypeStorageNodeMemoryMappingTest1-thread.nrrd";
+  reloadedStorageNode->SetFileName(threadFileName.c_str());
+  reloadedStorageNode->ResetFileNameList();
+  CHECK_BOOL(reloadedStorageNode->CanWriteDataInThread(reloadedVolumeNode.GetPointer()), true);
+  CHECK_BOOL(reloadedStorageNode->StartWriteData(reloadedVolumeNode.GetPointer()), true);
+  int writeResult = reloadedStorageNode->WriteDataInThread(reloadedVolumeNode.GetPointer());
+  TESTING_OUTPUT_RESET(); // removing the file of a previous run of the test
+  CHECK_INT(writeResult, 1);
+  CHECK_INT(reloadedStorageNode->GetNumberOfFileNames(), 0);
+  CHECK_INT(reloadedStorageNode->EndWriteData(reloadedVolumeNode.GetPointer(), writeResult), 1);
+  CHECK_INT(reloadedStorageNode->GetNumberOfFileNames(), 1);
+  CHECK_STD_STRING(vtksys::SystemTools::GetFilenameName(reloadedStorageNode->GetNthFileName(0)),
+    vtksys::SystemTools::GetFilenameName(threadFileName));
+#endif
+
+  return EXIT_SUCCESS;
+}
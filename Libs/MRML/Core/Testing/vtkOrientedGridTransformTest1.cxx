@@ -20,8 +20,10 @@
 
 // VTK includes
 #include "vtkImageData.h"
+#include "vtkMath.h"
 #include "vtkMatrix4x4.h"
 #include "vtkNew.h"
+#include "vtkPoints.h"
 
 typedef double itkVectorComponentType;
 typedef itk::Vector<itkVectorComponentType, 3> itkVectorPixelType;
@@ -286,6 +288,42 @@ double getInverseErrorVtk(const double inputPoint[3], vtkOrientedGridTransform*
   return errorOfInverseComputation;
 }
 
+//----------------------------------------------------------------------------
+// Compare transformation of a batch of points to transforming the points one by one
+int getNumberOfBatchTransformMismatchesVtk(vtkPoints* inputPoints, vtkOrientedGridTransform* gridVtk, double tolerance)
+{
+  vtkNew<vtkPoints> transformedPoints;
+  transformedPoints->SetDataTypeToDouble();
+  gridVtk->TransformPoints(inputPoints, transformedPoints.GetPointer());
+  if (transformedPoints->GetNumberOfPoints() != inputPoints->GetNumberOfPoints())
+    {
+    std::cout << "ERROR: Number of points transformed in batch: " << transformedPoints->GetNumberOfPoints()
+      << ", expected: " << inputPoints->GetNumberOfPoints() << std::endl;
+    return inputPoints->GetNumberOfPoints();
+    }
+
+  int numberOfMismatches = 0;
+  for (vtkIdType pointIndex = 0; pointIndex < inputPoints->GetNumberOfPoints(); pointIndex++)
+    {
+    double inputPoint[3] = { 0.0, 0.0, 0.0 };
+    inputPoints->GetPoint(pointIndex, inputPoint);
+    double outputPoint[3] = { 0.0, 0.0, 0.0 };
+    gridVtk->TransformPoint(inputPoint, outputPoint);
+    double batchOutputPoint[3] = { 0.0, 0.0, 0.0 };
+    transformedPoints->GetPoint(pointIndex, batchOutputPoint);
+    double difference = sqrt(vtkMath::Distance2BetweenPoints(outputPoint, batchOutputPoint));
+    if (difference > tolerance)
+      {
+      std::cout << "ERROR: Point transform result mismatch between batch and single point transformation" << std::endl;
+      std::cout << " Input point: " << inputPoint[0] << " " << inputPoint[1] << " " << inputPoint[2] << std::endl;
+      std::cout << " Output point (single point): " << outputPoint[0] << " " << outputPoint[1] << " " << outputPoint[2] << std::endl;
+      std::cout << " Output point (batch): " << batchOutputPoint[0] << " " << batchOutputPoint[1] << " " << batchOutputPoint[2] << std::endl;
+      numberOfMismatches++;
+      }
+    }
+  return numberOfMismatches;
+}
+
 //----------------------------------------------------------------------------
 int vtkOrientedGridTransformTest1(int , char * [] )
 {
@@ -324,6 +362,8 @@ int vtkOrientedGridTransformTest1(int , char * [] )
   int numberOfSingleDoubleVtkPointMismatches=0;
   int numberOfDerivativeMismatches=0;
   int numberOfInverseMismatches=0;
+  int numberOfBatchMismatches=0;
+  vtkNew<vtkPoints> samplePoints;
 
   // We take samples in the grid region (first node + 2 < node < last node - 1)
   // because the boundaries are handled differently in ITK and VTK (in ITK there is an
@@ -378,6 +418,7 @@ int vtkOrientedGridTransformTest1(int , char * [] )
         inputPoint[0] = origin[0]+direction[0][0]*spacing[0]*i+direction[0][1]*spacing[1]*j+direction[0][2]*spacing[2]*k;
         inputPoint[1] = origin[1]+direction[1][0]*spacing[0]*i+direction[1][1]*spacing[1]*j+direction[1][2]*spacing[2]*k;
         inputPoint[2] = origin[2]+direction[2][0]*spacing[0]*i+direction[2][1]*spacing[1]*j+direction[2][2]*spacing[2]*k;
+        samplePoints->InsertNextPoint(inputPoint);
         // Compare transformation results computed by ITK and VTK.
         double differenceItkVtk = getTransformedPointDifferenceItkVtk(inputPoint, gridItk, gridVtk.GetPointer(), false);
         // the larger the distance between the grid points, the larger difference is expected between ITK's linear and VTK's cubic
@@ -418,13 +459,24 @@ int vtkOrientedGridTransformTest1(int , char * [] )
       }
     }
 
+  // Verify that transforming all points at once gives the same result
+  numberOfBatchMismatches += getNumberOfBatchTransformMismatchesVtk(samplePoints.GetPointer(), gridVtk.GetPointer(), 1e-9);
+  gridVtk->Inverse();
+  // inverse computation stops within the inverse tolerance, and the batch computation
+  // may start the search from a different initial guess
+  numberOfBatchMismatches += getNumberOfBatchTransformMismatchesVtk(samplePoints.GetPointer(), gridVtk.GetPointer(),
+    gridVtk->GetInverseTolerance()*2.0);
+  gridVtk->Inverse();
+
   std::cout << "Number of points tested: " << numberOfPointsTested << std::endl;
   std::cout << "Number of ITK/VTK mismatches: " << numberOfItkVtkPointMismatches << std::endl;
   std::cout << "Number of single/double precision mismatches: " << numberOfSingleDoubleVtkPointMismatches << std::endl;
   std::cout << "Number of derivative mismatches: " << numberOfDerivativeMismatches << std::endl;
   std::cout << "Number of inverse mismatches: " << numberOfInverseMismatches << std::endl;
+  std::cout << "Number of batch transform mismatches: " << numberOfBatchMismatches << std::endl;
 
-  if (numberOfItkVtkPointMismatches==0 && numberOfDerivativeMismatches==0 && numberOfInverseMismatches==0)
+  if (numberOfItkVtkPointMismatches==0 && numberOfDerivativeMismatches==0 && numberOfInverseMismatches==0
+    && numberOfBatchMismatches==0)
     {
     std::cout << "Test result: PASSED" << std::endl;
     return EXIT_SUCCESS;
@@ -5,15 +5,23 @@
 #include "vtkMRMLStorageNode.h"
 
 #include <vtksys/Directory.hxx>
+#include <vtksys/MD5.h>
 #include <vtksys/SystemTools.hxx>
 
 #include <vtkCallbackCommand.h>
+#include <vtkMutexLock.h>
 #include <vtkObjectFactory.h>
 
+#include <fstream>
+#include <iomanip>
+
 vtkStandardNewMacro ( vtkCacheManager );
 
 #define MB 1000000.0
 
+/// Name of the file in the cache directory that lists the cached files
+static const char* CACHE_INDEX_FILE_NAME = "CacheIndex.txt";
+
 //----------------------------------------------------------------------------
 vtkCacheManager::vtkCacheManager()
 {
@@ -28,12 +36,17 @@ vtkCacheManager::vtkCacheManager()
   this->InsufficientFreeBufferNotificationFlag = 0;
   // this->EnableRemoteCacheOverwriting = 1;
   this->uriMap.clear();
+  this->CacheIndexSize = 0;
+  this->CacheIndexModified = false;
+  this->CacheIndexLock = vtkSimpleMutexLock::New();
 }
 
 
 //----------------------------------------------------------------------------
 vtkCacheManager::~vtkCacheManager()
 {
+  this->WriteCacheIndex();
+  this->CacheIndexLock->Delete();
 
   this->MRMLScene = NULL;
   this->uriMap.clear();
@@ -128,12 +141,15 @@ void vtkCacheManager::SetRemoteCacheDirectory (const char *dir )
     return;
     }
 
+  // save the index of the previous cache directory
+  this->WriteCacheIndex();
   this->RemoteCacheDirectory = dirstring;
   if (!vtksys::SystemTools::FileExists(this->RemoteCacheDirectory.c_str()))
     {
     vtksys::SystemTools::MakeDirectory(this->RemoteCacheDirectory.c_str());
     }
-  // scan files in cache, it calls Modified
+  this->ReadCacheIndex();
+  // update list of files in cache, it calls Modified
   this->UpdateCacheInformation();
 }
 
@@ -254,6 +270,7 @@ void vtkCacheManager::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "RemoteCacheFreeBufferSize: " << this->GetRemoteCacheFreeBufferSize() << "\n";
   //os << indent << "EnableRemoteCacheOverwriting: " << this->GetEnableRemoteCacheOverwriting() << "\n";
   os << indent << "EnableForceRedownload: " << this->GetEnableForceRedownload() << "\n";
+  os << indent << "NumberOfIndexedFiles: " << this->CacheIndex.size() << "\n";
 }
 
 
@@ -481,6 +498,24 @@ const char* vtkCacheManager::GetFilenameFromURI ( const char *uri )
     newFileName += extensionName.c_str();
     }
 
+  //--- Files from different locations may have the same name, so
+  //--- each file is stored in a directory named by the hash of the URI
+  //--- of its location. Companion files (e.g. .nhdr and .raw, or a DICOM
+  //--- series) share a location, so they end up in the same directory and
+  //--- relative references between them keep working.
+  std::string uriLocation(uri);
+  std::string::size_type lastSlash = uriLocation.find_last_of("/");
+  if (lastSlash != std::string::npos)
+    {
+    uriLocation = uriLocation.substr(0, lastSlash);
+    }
+  char uriHash[32];
+  vtksysMD5* md5 = vtksysMD5_New();
+  vtksysMD5_Initialize(md5);
+  vtksysMD5_Append(md5, reinterpret_cast<const unsigned char*>(uriLocation.c_str()), -1);
+  vtksysMD5_FinalizeHex(md5, uriHash);
+  vtksysMD5_Delete(md5);
+
   //--- Create absolute path
   if (this->GetRemoteCacheDirectory() == NULL ||
       strcmp(this->GetRemoteCacheDirectory(), "") == 0)
@@ -489,6 +524,7 @@ const char* vtkCacheManager::GetFilenameFromURI ( const char *uri )
     }
   std::vector<std::string> pathComponents;
   vtksys::SystemTools::SplitPath( this->GetRemoteCacheDirectory(), pathComponents);
+  pathComponents.push_back ( std::string(uriHash, 16) );
   pathComponents.push_back ( newFileName );
   fileName = vtksys::SystemTools::JoinPath ( pathComponents );
 
@@ -516,7 +552,13 @@ void vtkCacheManager::UpdateCacheInformation ( )
 
   //--- and refresh list of cached files.
   this->CachedFileList.clear();
-  this->GetCachedFileList ( this->GetRemoteCacheDirectory() );
+  this->CacheIndexLock->Lock();
+  for (CacheIndexListType::iterator it = this->CacheIndex.begin(); it != this->CacheIndex.end(); ++it)
+    {
+    this->CachedFileList.push_back(vtksys::SystemTools::GetFilenameName(it->FileName));
+    }
+  this->CacheIndexLock->Unlock();
+  this->WriteCacheIndex();
   this->Modified();
 }
 
@@ -570,6 +612,10 @@ void vtkCacheManager::DeleteFromCache( const char *target )
     {
     this->MarkNodesBeforeDeletingDataFromCache ( target );
 
+    this->CacheIndexLock->Lock();
+    this->RemoveCacheIndexEntries ( str );
+    this->CacheIndexLock->Unlock();
+
     //--- remove the file or directory in str....
     vtkDebugMacro ( "Removing " << str.c_str() << " from disk and from record of cached files." );
     if ( vtksys::SystemTools::FileIsDirectory ( str.c_str() ) )
@@ -648,6 +694,12 @@ int vtkCacheManager::ClearCache()
     vtkWarningMacro ( "Cache cleared: Error: unable to recreate cache directory after deleting its contents." );
     return 0;
     }
+  this->CacheIndexLock->Lock();
+  this->CacheIndex.clear();
+  this->CacheIndexByFileName.clear();
+  this->CacheIndexSize = 0;
+  this->CacheIndexModified = true;
+  this->CacheIndexLock->Unlock();
   this->UpdateCacheInformation();
   this->InvokeEvent ( vtkCacheManager::CacheClearEvent );
   return 1;
@@ -658,12 +710,10 @@ int vtkCacheManager::ClearCache()
 //----------------------------------------------------------------------------
 float vtkCacheManager::GetCurrentCacheSize ()
 {
-  if ( this->RemoteCacheDirectory.c_str() == NULL )
-    {
-    return (0.0);
-    }
-  float size = this->ComputeCacheSize ( this->RemoteCacheDirectory.c_str(), 0 );
-  this->SetCurrentCacheSize ( size );
+  //--- the index keeps the total size of the cached files
+  this->CacheIndexLock->Lock();
+  this->CurrentCacheSize = static_cast<float>(this->CacheIndexSize / MB);
+  this->CacheIndexLock->Unlock();
   return ( this->CurrentCacheSize );
 
 }
@@ -676,6 +726,10 @@ void vtkCacheManager::MarkNode ( std::string str )
   //--- If such a node exists, mark it as modified since read,
   //--- so that a user will be prompted to save the
   //--- data elsewhere (since it'll be deleted from cache.)
+  if ( this->MRMLScene == NULL )
+    {
+    return;
+    }
   int nnodes = this->MRMLScene->GetNumberOfNodesByClass ( "vtkMRMLStorableNode" );
   vtkMRMLStorableNode *node;
   std::string uri;
@@ -830,8 +884,10 @@ float vtkCacheManager::ComputeCacheSize( const char *dirName, unsigned long sz )
 void vtkCacheManager::CacheSizeCheck()
 {
 
+  //--- Make room for new downloads by removing the least recently used files
+  this->RemoveLeastRecentlyUsedFiles ( static_cast<float>(this->RemoteCacheLimit - this->RemoteCacheFreeBufferSize) );
   //--- Compute size of the current cache
-  this->ComputeCacheSize(this->RemoteCacheDirectory.c_str(), 0);
+  this->GetCurrentCacheSize();
   //--- Invoke an event if cache size is exceeded.
   if ( this->CurrentCacheSize > (float) (this->RemoteCacheLimit) )
     {
@@ -844,7 +900,7 @@ void vtkCacheManager::CacheSizeCheck()
 float vtkCacheManager::GetFreeCacheSpaceRemaining()
 {
 
-  float cachesize = this->ComputeCacheSize(this->RemoteCacheDirectory.c_str(), 0);
+  float cachesize = this->GetCurrentCacheSize();
   // cache limit - current cache size = total space left in cache.
   // total space in cache - free buffer size = amount that can be used.
   float diff = ( float (this->RemoteCacheLimit) - cachesize );
@@ -870,6 +926,27 @@ void vtkCacheManager::FreeCacheBufferCheck()
 //----------------------------------------------------------------------------
 int vtkCacheManager::CachedFileExists ( const char *filename )
 {
+  if ( filename == NULL )
+    {
+    return 0;
+    }
+  this->CacheIndexLock->Lock();
+  std::map<std::string, CacheIndexListType::iterator>::iterator indexIt = this->CacheIndexByFileName.find(filename);
+  if ( indexIt != this->CacheIndexByFileName.end() )
+    {
+    if ( vtksys::SystemTools::FileExists ( filename ) )
+      {
+      //--- move to the front as the most recently used file
+      this->CacheIndex.splice(this->CacheIndex.begin(), this->CacheIndex, indexIt->second);
+      this->CacheIndexModified = true;
+      this->CacheIndexLock->Unlock();
+      return 1;
+      }
+    //--- the file was removed from disk
+    this->RemoveCacheIndexEntries(filename);
+    }
+  this->CacheIndexLock->Unlock();
+
   if ( vtksys::SystemTools::FileExists ( filename ) )
     {
     return 1;
@@ -907,6 +984,20 @@ const char* vtkCacheManager::FindCachedFile ( const char * target, const char *d
     return ( NULL );
     }
 
+  //--- look up the target in the index before scanning the directory
+  this->CacheIndexLock->Lock();
+  bool indexed = (this->CacheIndexByFileName.find(target) != this->CacheIndexByFileName.end());
+  this->CacheIndexLock->Unlock();
+  if ( indexed && strncmp ( target, dirname, strlen(dirname) ) == 0 )
+    {
+    n = strlen(target) + 1;
+    cp1 = new char[n];
+    cp2 = (target);
+    returnString = cp1;
+    do { *cp1++ = *cp2++; } while ( --n );
+    return returnString;
+    }
+
   if ( vtksys::SystemTools::FileIsDirectory ( dirname ) )
     {
     vtkDebugMacro("FindCachedFile: dirname is a directory: " << dirname);
@@ -997,3 +1088,282 @@ const char* vtkCacheManager::FindCachedFile ( const char * target, const char *d
     }
 
 }
+
+//----------------------------------------------------------------------------
+int vtkCacheManager::AddCachedFile ( const char *uri, const char *filename )
+{
+  if ( filename == NULL || !vtksys::SystemTools::FileExists ( filename, true ) )
+    {
+    return 0;
+    }
+  double size = static_cast<double>(vtksys::SystemTools::FileLength ( filename ));
+  this->CacheIndexLock->Lock();
+  this->UpdateCacheIndexEntry ( uri ? uri : "", filename, size );
+  this->CacheIndexLock->Unlock();
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkCacheManager::RemoveLeastRecentlyUsedFiles ( float sizeLimit )
+{
+  int numberOfRemovedFiles = 0;
+  while ( true )
+    {
+    this->CacheIndexLock->Lock();
+    std::string fileName;
+    if ( this->CacheIndex.size() > 1 && this->CacheIndexSize > sizeLimit * MB )
+      {
+      //--- least recently used file that is not pinned, except the most recently used
+      CacheIndexListType::iterator mostRecentlyUsed = this->CacheIndex.begin();
+      CacheIndexListType::iterator candidate = this->CacheIndex.end();
+      while ( --candidate != mostRecentlyUsed )
+        {
+        std::string candidatePath = vtksys::SystemTools::CollapseFullPath ( candidate->FileName );
+        if ( this->PinnedFiles.find ( candidatePath ) == this->PinnedFiles.end() )
+          {
+          fileName = candidate->FileName;
+          break;
+          }
+        }
+      }
+    if ( fileName.empty() )
+      {
+      this->CacheIndexLock->Unlock();
+      break;
+      }
+    this->RemoveCacheIndexEntries ( fileName );
+    this->CacheIndexLock->Unlock();
+
+    vtkDebugMacro ( "RemoveLeastRecentlyUsedFiles: removing " << fileName );
+    this->MarkNode ( fileName );
+    if ( !vtksys::SystemTools::RemoveFile ( fileName.c_str() ) )
+      {
+      vtkWarningMacro ( "Unable to remove cached file " << fileName << " from disk." );
+      }
+    //--- remove the URI hash directory too if it is empty now
+    std::string directory = vtksys::SystemTools::GetFilenamePath ( fileName );
+    if ( !vtksys::SystemTools::ComparePath ( directory.c_str(), this->RemoteCacheDirectory.c_str() ) &&
+         vtksys::Directory::GetNumberOfFilesInDirectory ( directory.c_str() ) <= 2 )
+      {
+      vtksys::SystemTools::RemoveADirectory ( directory.c_str() );
+      }
+    numberOfRemovedFiles++;
+    }
+  if ( numberOfRemovedFiles > 0 )
+    {
+    this->UpdateCacheInformation ( );
+    this->InvokeEvent ( vtkCacheManager::CacheDeleteEvent );
+    }
+  return numberOfRemovedFiles;
+}
+
+//----------------------------------------------------------------------------
+void vtkCacheManager::PinFile ( const char *filename )
+{
+  if ( filename == NULL )
+    {
+    return;
+    }
+  std::string path = vtksys::SystemTools::CollapseFullPath ( filename );
+  this->CacheIndexLock->Lock();
+  this->PinnedFiles[path]++;
+  this->CacheIndexLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkCacheManager::UnpinFile ( const char *filename )
+{
+  if ( filename == NULL )
+    {
+    return;
+    }
+  std::string path = vtksys::SystemTools::CollapseFullPath ( filename );
+  this->CacheIndexLock->Lock();
+  std::map<std::string, int>::iterator pinnedIt = this->PinnedFiles.find ( path );
+  if ( pinnedIt != this->PinnedFiles.end() && --pinnedIt->second <= 0 )
+    {
+    this->PinnedFiles.erase ( pinnedIt );
+    }
+  this->CacheIndexLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCacheManager::IsFilePinned ( const char *filename )
+{
+  if ( filename == NULL )
+    {
+    return false;
+    }
+  std::string path = vtksys::SystemTools::CollapseFullPath ( filename );
+  this->CacheIndexLock->Lock();
+  bool pinned = ( this->PinnedFiles.find ( path ) != this->PinnedFiles.end() );
+  this->CacheIndexLock->Unlock();
+  return pinned;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkCacheManager::GetCacheIndexFileName()
+{
+  return this->RemoteCacheDirectory + "/" + CACHE_INDEX_FILE_NAME;
+}
+
+//----------------------------------------------------------------------------
+void vtkCacheManager::ReadCacheIndex()
+{
+  this->CacheIndexLock->Lock();
+  this->CacheIndex.clear();
+  this->CacheIndexByFileName.clear();
+  this->CacheIndexSize = 0;
+  this->CacheIndexModified = false;
+  if ( this->RemoteCacheDirectory.empty() )
+    {
+    this->CacheIndexLock->Unlock();
+    return;
+    }
+
+  std::ifstream indexFile ( this->GetCacheIndexFileName().c_str() );
+  if ( !indexFile.is_open() )
+    {
+    //--- cache directory written by an earlier version, index the files in it
+    vtkDebugMacro ( "ReadCacheIndex: no index found, scanning " << this->RemoteCacheDirectory );
+    this->AddFilesInDirectoryToCacheIndex ( this->RemoteCacheDirectory );
+    this->CacheIndexLock->Unlock();
+    return;
+    }
+
+  //--- each line is: size <tab> path relative to cache directory <tab> URI
+  std::string line;
+  while ( std::getline ( indexFile, line ) )
+    {
+    std::string::size_type sizeEnd = line.find ( '\t' );
+    std::string::size_type fileNameEnd = ( sizeEnd == std::string::npos ?
+      std::string::npos : line.find ( '\t', sizeEnd + 1 ) );
+    if ( fileNameEnd == std::string::npos )
+      {
+      continue;
+      }
+    CacheIndexEntry entry;
+    entry.FileName = vtksys::SystemTools::CollapseFullPath (
+      line.substr ( sizeEnd + 1, fileNameEnd - sizeEnd - 1 ), this->RemoteCacheDirectory.c_str() );
+    entry.URI = line.substr ( fileNameEnd + 1 );
+    if ( !vtksys::SystemTools::FileExists ( entry.FileName.c_str(), true ) ||
+         this->CacheIndexByFileName.find ( entry.FileName ) != this->CacheIndexByFileName.end() )
+      {
+      this->CacheIndexModified = true;
+      continue;
+      }
+    entry.Size = static_cast<double>(vtksys::SystemTools::FileLength ( entry.FileName.c_str() ));
+    //--- lines are ordered from most to least recently used
+    this->CacheIndex.push_back ( entry );
+    this->CacheIndexByFileName[entry.FileName] = --this->CacheIndex.end();
+    this->CacheIndexSize += entry.Size;
+    }
+  this->CacheIndexLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkCacheManager::AddFilesInDirectoryToCacheIndex ( const std::string& dirname )
+{
+  vtksys::Directory dir;
+  if ( !dir.Load ( dirname.c_str() ) )
+    {
+    return;
+    }
+  std::string indexFileName = this->GetCacheIndexFileName();
+  for ( unsigned long fileNum = 0; fileNum < dir.GetNumberOfFiles(); ++fileNum )
+    {
+    const char* name = dir.GetFile ( fileNum );
+    if ( !strcmp ( name, "." ) || !strcmp ( name, ".." ) )
+      {
+      continue;
+      }
+    std::string fullName = dirname + "/" + name;
+    if ( vtksys::SystemTools::FileIsDirectory ( fullName.c_str() ) )
+      {
+      this->AddFilesInDirectoryToCacheIndex ( fullName );
+      }
+    else if ( fullName != indexFileName )
+      {
+      this->UpdateCacheIndexEntry ( "", fullName,
+        static_cast<double>(vtksys::SystemTools::FileLength ( fullName.c_str() )) );
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCacheManager::UpdateCacheIndexEntry ( const std::string& uri, const std::string& filename, double size )
+{
+  std::map<std::string, CacheIndexListType::iterator>::iterator indexIt = this->CacheIndexByFileName.find ( filename );
+  if ( indexIt != this->CacheIndexByFileName.end() )
+    {
+    this->CacheIndexSize -= indexIt->second->Size;
+    this->CacheIndex.splice ( this->CacheIndex.begin(), this->CacheIndex, indexIt->second );
+    }
+  else
+    {
+    this->CacheIndex.push_front ( CacheIndexEntry() );
+    this->CacheIndexByFileName[filename] = this->CacheIndex.begin();
+    }
+  CacheIndexEntry& entry = this->CacheIndex.front();
+  entry.URI = uri;
+  entry.FileName = filename;
+  entry.Size = size;
+  this->CacheIndexSize += size;
+  this->CacheIndexModified = true;
+}
+
+//----------------------------------------------------------------------------
+void vtkCacheManager::RemoveCacheIndexEntries ( const std::string& filename )
+{
+  std::map<std::string, CacheIndexListType::iterator>::iterator indexIt = this->CacheIndexByFileName.find ( filename );
+  if ( indexIt != this->CacheIndexByFileName.end() )
+    {
+    this->CacheIndexSize -= indexIt->second->Size;
+    this->CacheIndex.erase ( indexIt->second );
+    this->CacheIndexByFileName.erase ( indexIt );
+    this->CacheIndexModified = true;
+    return;
+    }
+  //--- filename may be a directory, remove all the files in it
+  std::string prefix = filename + "/";
+  CacheIndexListType::iterator it = this->CacheIndex.begin();
+  while ( it != this->CacheIndex.end() )
+    {
+    if ( it->FileName.compare ( 0, prefix.size(), prefix ) != 0 )
+      {
+      ++it;
+      continue;
+      }
+    this->CacheIndexSize -= it->Size;
+    this->CacheIndexByFileName.erase ( it->FileName );
+    it = this->CacheIndex.erase ( it );
+    this->CacheIndexModified = true;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCacheManager::WriteCacheIndex ( )
+{
+  this->CacheIndexLock->Lock();
+  if ( !this->CacheIndexModified || this->RemoteCacheDirectory.empty() )
+    {
+    this->CacheIndexLock->Unlock();
+    return;
+    }
+  std::ofstream indexFile ( this->GetCacheIndexFileName().c_str() );
+  if ( !indexFile.is_open() )
+    {
+    this->CacheIndexLock->Unlock();
+    vtkWarningMacro ( "WriteCacheIndex: unable to write " << this->GetCacheIndexFileName() );
+    return;
+    }
+  indexFile << std::fixed << std::setprecision(0);
+  for ( CacheIndexListType::iterator it = this->CacheIndex.begin(); it != this->CacheIndex.end(); ++it )
+    {
+    indexFile << it->Size << "\t"
+      << vtksys::SystemTools::RelativePath ( this->RemoteCacheDirectory.c_str(), it->FileName.c_str() ) << "\t"
+      << it->URI << "\n";
+    }
+  this->CacheIndexModified = false;
+  this->CacheIndexLock->Unlock();
+}
@@ -5,11 +5,13 @@
 #include "vtkMRML.h"
 class vtkCallbackCommand;
 class vtkMRMLScene;
+class vtkSimpleMutexLock;
 
 // VTK includes
 #include <vtkObject.h>
 
 // STD includes
+#include <list>
 #include <string>
 #include <vector>
 #include <map>
@@ -18,6 +20,15 @@ class vtkMRMLScene;
 #define vtkObjectPointer(xx) (reinterpret_cast <vtkObject **>( (xx) ))
 #endif
 
+/// \brief Manages the local copies of remote files.
+///
+/// Each remote file is downloaded into a subdirectory of the cache directory
+/// named by a hash of its URI, so files that have the same name on different
+/// servers don't overwrite each other.
+/// The cached files are listed in an index file in the cache directory,
+/// ordered from the most recently to the least recently used, so looking up
+/// a file or the cache size does not require scanning the cache directory.
+/// When the cache is full the least recently used files are removed.
 class VTK_MRML_EXPORT vtkCacheManager : public vtkObject
 {
   public:
@@ -96,9 +107,37 @@ class VTK_MRML_EXPORT vtkCacheManager : public vtkObject
   /// If neither exists, returns 0. If one exists, returns 1.
   virtual int CachedFileExists ( const char *filename );
 
+  ///
+  /// Adds a file that was downloaded into the cache directory to the cache
+  /// index as the most recently used file. Returns 0 if the file does not exist.
+  /// Can be called from any thread.
+  int AddCachedFile ( const char *uri, const char *filename );
+
+  ///
+  /// Removes least recently used files until the cache size is not larger
+  /// than sizeLimit (in MB). The most recently used file and pinned files
+  /// are never removed. Returns the number of removed files.
+  int RemoveLeastRecentlyUsedFiles ( float sizeLimit );
+
+  ///
+  /// Pinned files are not removed to make room in the cache. Files are
+  /// pinned while they are queued for download or being read.
+  /// Each PinFile call must be matched by an UnpinFile call.
+  /// Can be called from any thread.
+  void PinFile ( const char *filename );
+  void UnpinFile ( const char *filename );
+  bool IsFilePinned ( const char *filename );
+
+  ///
+  /// Writes the cache index into the cache directory if it has changed.
+  void WriteCacheIndex ( );
+
   ///
   /// Extracts the filename from the URI and prepends the
-  /// Remote Cache Directory path to it. Returns the full path.
+  /// Remote Cache Directory path and a subdirectory named by the hash of
+  /// the URI location (the URI without the file name) to it, so that
+  /// companion files from the same location share the subdirectory.
+  /// Returns the full path.
   /// NOTE: this method looks at a filename's extension and
   /// if appended version numbers have been added, it attempts
   /// to strip them out of the extension and add them to the
@@ -108,6 +147,9 @@ class VTK_MRML_EXPORT vtkCacheManager : public vtkObject
   const char* AddCachePathToFilename ( const char *filename );
   const char* EncodeURI ( const char *uri );
 
+  /// Removes least recently used files if the cache size exceeds
+  /// RemoteCacheLimit minus RemoteCacheFreeBufferSize. Invokes
+  /// CacheLimitExceededEvent if the limit is still exceeded.
   void CacheSizeCheck();
   void FreeCacheBufferCheck();
   float ComputeCacheSize( const char *dirname, unsigned long size );
@@ -172,6 +214,36 @@ class VTK_MRML_EXPORT vtkCacheManager : public vtkObject
   /// with every download, remove from cache, and clearcache call.
   std::vector< std::string > CachedFileList;
 
+  struct CacheIndexEntry
+    {
+    std::string URI;
+    /// Absolute path of the cached file
+    std::string FileName;
+    /// File size in bytes
+    double Size;
+    };
+  /// Cached files, the most recently used first
+  typedef std::list<CacheIndexEntry> CacheIndexListType;
+  CacheIndexListType CacheIndex;
+  std::map<std::string, CacheIndexListType::iterator> CacheIndexByFileName;
+  /// Total size of the files in the index, in bytes
+  double CacheIndexSize;
+  /// Number of times each file is pinned, by absolute path
+  std::map<std::string, int> PinnedFiles;
+  bool CacheIndexModified;
+  vtkSimpleMutexLock* CacheIndexLock;
+
+  /// Read the index file of the cache directory. If there is no index file
+  /// then the files in the cache directory are added to the index.
+  void ReadCacheIndex();
+  void AddFilesInDirectoryToCacheIndex(const std::string& dirname);
+  /// Add or move an entry to the front of the index. CacheIndexLock must be locked.
+  void UpdateCacheIndexEntry(const std::string& uri, const std::string& filename, double size);
+  /// Remove the index entry of a file or of all the files in a directory.
+  /// CacheIndexLock must be locked.
+  void RemoveCacheIndexEntries(const std::string& filename);
+  std::string GetCacheIndexFileName();
+
  protected:
   vtkCacheManager();
   virtual ~vtkCacheManager();
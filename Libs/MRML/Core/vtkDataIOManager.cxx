@@ -38,6 +38,7 @@ vtkDataIOManager::vtkDataIOManager()
 //----------------------------------------------------------------------------
 vtkDataIOManager::~vtkDataIOManager()
 {
+  this->UnpinCachedFiles ( false );
 
   if ( this->TransferUpdateCommand )
     {
@@ -314,6 +315,63 @@ void vtkDataIOManager::SetEnableAsynchronousIO ( int val )
 }
 
 
+//----------------------------------------------------------------------------
+void vtkDataIOManager::PinCachedFiles ( vtkMRMLStorageNode *storageNode )
+{
+  if ( storageNode == NULL || this->CacheManager == NULL )
+    {
+    return;
+    }
+  PinnedCachedFiles pinnedFiles;
+  pinnedFiles.StorageNode = storageNode;
+  pinnedFiles.CacheManager = this->CacheManager;
+  std::vector<const char*> uris;
+  uris.push_back ( storageNode->GetURI() );
+  for ( int uriIndex = 0; uriIndex < storageNode->GetNumberOfURIs(); ++uriIndex )
+    {
+    uris.push_back ( storageNode->GetNthURI ( uriIndex ) );
+    }
+  for ( std::vector<const char*>::iterator uriIt = uris.begin(); uriIt != uris.end(); ++uriIt )
+    {
+    const char *fileName = ( *uriIt ? this->CacheManager->GetFilenameFromURI ( *uriIt ) : NULL );
+    if ( fileName == NULL )
+      {
+      continue;
+      }
+    this->CacheManager->PinFile ( fileName );
+    pinnedFiles.FileNames.push_back ( fileName );
+    }
+  this->PinnedReads.push_back ( pinnedFiles );
+}
+
+//----------------------------------------------------------------------------
+void vtkDataIOManager::UnpinCachedFiles ( bool readNodesOnly )
+{
+  std::vector<PinnedCachedFiles>::iterator pinnedIt = this->PinnedReads.begin();
+  while ( pinnedIt != this->PinnedReads.end() )
+    {
+    vtkMRMLStorageNode *storageNode = pinnedIt->StorageNode;
+    if ( readNodesOnly && storageNode != NULL &&
+         storageNode->GetReadState() != vtkMRMLStorageNode::Idle &&
+         storageNode->GetReadState() != vtkMRMLStorageNode::Cancelled )
+      {
+      //--- download or read in progress
+      ++pinnedIt;
+      continue;
+      }
+    vtkCacheManager *cacheManager = pinnedIt->CacheManager;
+    if ( cacheManager != NULL )
+      {
+      for ( std::vector<std::string>::iterator fileIt = pinnedIt->FileNames.begin();
+            fileIt != pinnedIt->FileNames.end(); ++fileIt )
+        {
+        cacheManager->UnpinFile ( fileIt->c_str() );
+        }
+      }
+    pinnedIt = this->PinnedReads.erase ( pinnedIt );
+    }
+}
+
 //----------------------------------------------------------------------------
 void vtkDataIOManager::QueueRead ( vtkMRMLNode *node )
 {
@@ -396,6 +454,11 @@ void vtkDataIOManager::QueueRead ( vtkMRMLNode *node )
     //--- a large scene that consists of multiple datasets.
     //--- ***The risk with this implementation  is that they may
     //--- forget to adjust the cache size, but aren't notified again...
+    //--- Least recently used files are removed first to make room,
+    //--- except the files that are queued or being read.
+    this->UnpinCachedFiles ( true );
+    this->PinCachedFiles ( dnode->GetNthStorageNode(storageNodeIndex) );
+    cm->CacheSizeCheck();
     float bufsize = (cm->GetRemoteCacheLimit() * 1000000.0) -  (cm->GetRemoteCacheFreeBufferSize() * 1000000.0);
     if ( (cm->GetCurrentCacheSize()*1000000.0) >= bufsize )
       {
@@ -7,12 +7,18 @@ class vtkCacheManager;
 class vtkDataFileFormatHelper;
 class vtkDataTransfer;
 class vtkMRMLNode;
+class vtkMRMLStorageNode;
 
 // VTK includes
 #include <vtkObject.h>
+#include <vtkWeakPointer.h>
 class vtkCallbackCommand;
 class vtkCollection;
 
+// STD includes
+#include <string>
+#include <vector>
+
 #ifndef vtkObjectPointer
 #define vtkObjectPointer(xx) (reinterpret_cast <vtkObject **>( (xx) ))
 #endif
@@ -115,6 +121,21 @@ class VTK_MRML_EXPORT vtkDataIOManager : public vtkObject
 
   vtkDataFileFormatHelper* FileFormatHelper;
 
+  /// Pin the cached files of a storage node that is queued for reading,
+  /// so that they are not removed from the cache before the node is read.
+  void PinCachedFiles ( vtkMRMLStorageNode *storageNode );
+  /// Unpin the cached files of the storage nodes that are not being read
+  /// anymore, or of all the storage nodes if readNodesOnly is false.
+  void UnpinCachedFiles ( bool readNodesOnly );
+
+  struct PinnedCachedFiles
+    {
+    vtkWeakPointer<vtkMRMLStorageNode> StorageNode;
+    vtkWeakPointer<vtkCacheManager> CacheManager;
+    std::vector<std::string> FileNames;
+    };
+  std::vector<PinnedCachedFiles> PinnedReads;
+
  protected:
   vtkDataIOManager();
   virtual ~vtkDataIOManager();
@@ -17,13 +17,158 @@
 #include "vtkObservation.h"
 
 // VTK includes
+#include <vtkAtomic.h>
 #include <vtkCallbackCommand.h>
 #include <vtkCollection.h>
 #include <vtkObjectFactory.h>
+#include <vtkSimpleCriticalSection.h>
 #include <vtkTimerLog.h>
 
 vtkCxxSetObjectMacro(vtkEventBroker, TimerLog, vtkTimerLog);
 
+//----------------------------------------------------------------------------
+/// \brief Multiple producers, single consumer queue of posted events.
+///
+/// Producers reserve a slot of a fixed size ring buffer in a short critical
+/// section shared by the producers, then write the event and publish it by
+/// updating the slot sequence number. The consumer reads the published slots
+/// without taking the lock. If the ring buffer is full, events are appended
+/// to an overflow list instead, so producers never wait for the consumer.
+/// To keep the events in the order they were posted, once the overflow list
+/// is used all the events go into it until the consumer has read the ring
+/// buffer and taken the overflow list (under the producers lock).
+class vtkEventBroker::vtkPostedEventQueue
+{
+public:
+  struct PostedEvent
+    {
+    PostedEvent() : Subject(0), Event(0), CallData(0) {}
+    PostedEvent(vtkObject* subject, unsigned long event, void* callData)
+      : Subject(subject), Event(event), CallData(callData) {}
+    bool operator<(const PostedEvent& other) const
+      {
+      if (this->Subject != other.Subject)
+        {
+        return this->Subject < other.Subject;
+        }
+      if (this->Event != other.Event)
+        {
+        return this->Event < other.Event;
+        }
+      return this->CallData < other.CallData;
+      }
+    vtkObject* Subject;
+    unsigned long Event;
+    void* CallData;
+    };
+
+  enum { Capacity = 4096 };
+
+  vtkPostedEventQueue()
+    {
+    this->WriteCount = 0;
+    this->ReadCount = 0;
+    this->Overflowing = 0;
+    for (vtkTypeInt64 i = 0; i < Capacity; ++i)
+      {
+      this->Slots[i].Sequence = i;
+      }
+    }
+
+  /// Can be called from any thread. Never waits for the consumer.
+  void Push(const PostedEvent& postedEvent)
+    {
+    // Reserve the next slot only if the consumer has already read the event
+    // of the previous round from it and no event is waiting in the overflow
+    // list. vtkAtomic has no compare-and-swap, so the check and the increment
+    // of the write position are made in a short critical section that is
+    // only shared by the producers (and the consumer when it takes the
+    // overflow list).
+    this->Lock.Lock();
+    vtkTypeInt64 position = this->WriteCount.load();
+    Slot& slot = this->Slots[position % Capacity];
+    bool reserved = (!this->Overflowing.load() && slot.Sequence.load() == position);
+    if (reserved)
+      {
+      this->WriteCount = position + 1;
+      }
+    else
+      {
+      // the ring buffer is full or older events are in the overflow list
+      this->Overflowing = 1;
+      this->Overflow.push_back(postedEvent);
+      }
+    this->Lock.Unlock();
+    if (!reserved)
+      {
+      return;
+      }
+    slot.Event = postedEvent;
+    // publish
+    slot.Sequence = position + 1;
+    }
+
+  /// Must be called from a single thread.
+  void PopAll(std::vector<PostedEvent>& postedEvents)
+    {
+    vtkTypeInt64 position = this->ReadCount.load();
+    for (;;)
+      {
+      Slot& slot = this->Slots[position % Capacity];
+      if (slot.Sequence.load() != position + 1)
+        {
+        // not published yet
+        break;
+        }
+      postedEvents.push_back(slot.Event);
+      slot.Sequence = position + Capacity;
+      ++position;
+      this->ReadCount = position;
+      }
+    if (!this->Overflowing.load())
+      {
+      return;
+      }
+    this->Lock.Lock();
+    // No slot is reserved while the overflow list is used. The events of the
+    // overflow list were posted after all the reserved slots, they are taken
+    // only if all the reserved slots are read. Otherwise a producer has not
+    // published its event yet and the overflow list is taken next time.
+    if (this->ReadCount.load() == this->WriteCount.load())
+      {
+      postedEvents.insert(postedEvents.end(), this->Overflow.begin(), this->Overflow.end());
+      this->Overflow.clear();
+      this->Overflowing = 0;
+      }
+    this->Lock.Unlock();
+    }
+
+  int GetNumberOfEvents()
+    {
+    this->Lock.Lock();
+    int numberOfEvents = static_cast<int>(this->Overflow.size());
+    this->Lock.Unlock();
+    return numberOfEvents
+      + static_cast<int>(this->WriteCount.load() - this->ReadCount.load());
+    }
+
+protected:
+  struct Slot
+    {
+    vtkAtomic<vtkTypeInt64> Sequence;
+    PostedEvent Event;
+    };
+  Slot Slots[Capacity];
+  vtkAtomic<vtkTypeInt64> WriteCount;
+  vtkAtomic<vtkTypeInt64> ReadCount;
+
+  /// Guards the reservation of slots and the overflow list
+  vtkSimpleCriticalSection Lock;
+  /// Set when events are in the overflow list, modified with Lock held
+  vtkAtomic<int> Overflowing;
+  std::vector<PostedEvent> Overflow;
+};
+
 //----------------------------------------------------------------------------
 // The IO manager singleton.
 // This MUST be default initialized to zero by the compiler and is
@@ -98,6 +243,8 @@ vtkEventBroker::vtkEventBroker()
   this->LogFileName = NULL;
   this->ScriptHandler = NULL;
   this->ScriptHandlerClientData = NULL;
+  this->EventBatchLevel = 0;
+  this->PostedEvents = new vtkPostedEventQueue;
 }
 
 //----------------------------------------------------------------------------
@@ -117,6 +264,17 @@ vtkEventBroker::~vtkEventBroker()
     {
     this->TimerLog->Delete();
     }
+
+  // release subjects of events that have never been processed
+  std::vector<vtkPostedEventQueue::PostedEvent> postedEvents;
+  this->PostedEvents->PopAll(postedEvents);
+  for (std::vector<vtkPostedEventQueue::PostedEvent>::iterator postedEventIt = postedEvents.begin();
+       postedEventIt != postedEvents.end(); ++postedEventIt)
+    {
+    postedEventIt->Subject->UnRegister(this);
+    }
+  delete this->PostedEvents;
+  this->PostedEvents = 0;
   //cout << "vtkEventBroker singleton Deleted" << endl;
 }
 
@@ -125,7 +283,7 @@ void vtkEventBroker::DetachObservations()
 {
   // for each subject, remove observations in its list
   ObjectToObservationVectorMap::iterator mapiter;
-  ObservationVector::iterator oiter;
+  ObservationList::iterator oiter;
 
   for (mapiter = this->SubjectMap.begin(); mapiter != this->SubjectMap.end(); mapiter++)
     {
@@ -142,6 +300,69 @@ void vtkEventBroker::DetachObservations()
   this->SubjectMap.clear();
 }
 
+//----------------------------------------------------------------------------
+void vtkEventBroker::AddSubjectObservation(vtkObservation *observation)
+{
+  ObservationList& subjectObservations = this->SubjectMap[observation->GetSubject()];
+  observation->SubjectObservationsIndex = subjectObservations.size();
+  subjectObservations.push_back(observation);
+}
+
+//----------------------------------------------------------------------------
+void vtkEventBroker::RemoveSubjectObservation(vtkObservation *observation)
+{
+  ObjectToObservationVectorMap::iterator mapIt = this->SubjectMap.find(observation->GetSubject());
+  if (mapIt == this->SubjectMap.end())
+    {
+    return;
+    }
+  ObservationList& subjectObservations = mapIt->second;
+  size_t index = observation->SubjectObservationsIndex;
+  if (index >= subjectObservations.size() || subjectObservations[index] != observation)
+    {
+    return;
+    }
+  // swap with the last element to remove in constant time
+  subjectObservations[index] = subjectObservations.back();
+  subjectObservations[index]->SubjectObservationsIndex = index;
+  subjectObservations.pop_back();
+  if (subjectObservations.empty())
+    {
+    this->SubjectMap.erase(mapIt);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkEventBroker::AddObserverObservation(vtkObservation *observation)
+{
+  ObservationList& observerObservations = this->ObserverMap[observation->GetObserver()];
+  observation->ObserverObservationsIndex = observerObservations.size();
+  observerObservations.push_back(observation);
+}
+
+//----------------------------------------------------------------------------
+void vtkEventBroker::RemoveObserverObservation(vtkObservation *observation)
+{
+  ObjectToObservationVectorMap::iterator mapIt = this->ObserverMap.find(observation->GetObserver());
+  if (mapIt == this->ObserverMap.end())
+    {
+    return;
+    }
+  ObservationList& observerObservations = mapIt->second;
+  size_t index = observation->ObserverObservationsIndex;
+  if (index >= observerObservations.size() || observerObservations[index] != observation)
+    {
+    return;
+    }
+  observerObservations[index] = observerObservations.back();
+  observerObservations[index]->ObserverObservationsIndex = index;
+  observerObservations.pop_back();
+  if (observerObservations.empty())
+    {
+    this->ObserverMap.erase(mapIt);
+    }
+}
+
 //----------------------------------------------------------------------------
 vtkObservation *vtkEventBroker::AddObservation (
   vtkObject *subject, unsigned long event, vtkObject *observer, vtkCallbackCommand *notify, float priority)
@@ -150,11 +371,11 @@ vtkObservation *vtkEventBroker::AddObservation (
 
   vtkObservation *observation = vtkObservation::New();
   observation->SetEventBroker( this );
-  this->SubjectMap[subject].insert( observation );
-  this->ObserverMap[observer].insert( observation );
   observation->AssignSubject( subject );
   observation->SetEvent( event );
   observation->AssignObserver( observer );
+  this->AddSubjectObservation( observation );
+  this->AddObserverObservation( observation );
   observation->SetCallbackCommand( notify );
   observation->SetPriority( priority );
 
@@ -181,8 +402,8 @@ vtkObservation *vtkEventBroker::AddObservation (
 {
   vtkObservation *observation = vtkObservation::New();
   observation->SetEventBroker( this );
-  this->SubjectMap[subject].insert( observation );
   observation->AssignSubject( subject );
+  this->AddSubjectObservation( observation );
 
   // figure out event either as a predefined string, or
   // as an ascii number
@@ -291,16 +512,8 @@ void vtkEventBroker::RemoveObservations (ObservationVector observations)
 
   for(inObsIter=observations.begin(); inObsIter != observations.end(); inObsIter++)
     {
-    vtkObservation *inObs = (*inObsIter);
-    ObservationVector& subjectObservations = this->SubjectMap[(*inObsIter)->GetSubject()];
-    subjectObservations.erase(subjectObservations.find(inObs));
-    }
-
-  for(inObsIter=observations.begin(); inObsIter != observations.end(); inObsIter++)
-    {
-    vtkObservation *inObs = (*inObsIter);
-    ObservationVector& observerObservations = this->ObserverMap[inObs->GetObserver()];
-    observerObservations.erase(observerObservations.find(inObs));
+    this->RemoveSubjectObservation(*inObsIter);
+    this->RemoveObserverObservation(*inObsIter);
     }
 
   // remove from event queue
@@ -363,8 +576,12 @@ vtkEventBroker::ObservationVector vtkEventBroker
 ::GetSubjectObservations (vtkObject *observer)
 {
   // find matching observations to remove
-  ObservationVector observationList = this->ObserverMap[observer];
-
+  ObservationVector observationList;
+  ObjectToObservationVectorMap::iterator mapIt = this->ObserverMap.find(observer);
+  if (mapIt != this->ObserverMap.end())
+    {
+    observationList.insert(mapIt->second.begin(), mapIt->second.end());
+    }
   return( observationList );
 }
 
@@ -381,9 +598,14 @@ vtkEventBroker::ObservationVector vtkEventBroker::GetObservations (
     return observationList;
     }
   // find matching observations to remove
-  ObservationVector& subjectList = this->SubjectMap[subject];
+  ObjectToObservationVectorMap::iterator mapIt = this->SubjectMap.find(subject);
+  if (mapIt == this->SubjectMap.end())
+    {
+    return observationList;
+    }
+  ObservationList& subjectList = mapIt->second;
 
-  for(ObservationVector::iterator obsIter = subjectList.begin();
+  for(ObservationList::iterator obsIter = subjectList.begin();
       obsIter != subjectList.end();
       ++obsIter)
     {
@@ -418,9 +640,14 @@ vtkEventBroker::ObservationVector vtkEventBroker::GetObservationsForSubjectByTag
 {
   // find matching observations to remove
   // - all tags match 0
-  ObservationVector& subjectList = this->SubjectMap[subject];
   ObservationVector observationList;
-  for (ObservationVector::iterator obsIter = subjectList.begin();
+  ObjectToObservationVectorMap::iterator mapIt = this->SubjectMap.find(subject);
+  if (mapIt == this->SubjectMap.end())
+    {
+    return observationList;
+    }
+  ObservationList& subjectList = mapIt->second;
+  for (ObservationList::iterator obsIter = subjectList.begin();
        obsIter != subjectList.end(); obsIter++)
     {
     vtkObservation *obs = *obsIter;
@@ -437,8 +664,13 @@ vtkEventBroker::ObservationVector vtkEventBroker::GetObservationsForSubjectByTag
 vtkCollection *vtkEventBroker::GetObservationsForSubject ( vtkObject *subject )
 {
   vtkCollection *collection = vtkCollection::New();
-  ObservationVector& subjectList = this->SubjectMap[subject];
-  for(ObservationVector::iterator iter=subjectList.begin();
+  ObjectToObservationVectorMap::iterator mapIt = this->SubjectMap.find(subject);
+  if (mapIt == this->SubjectMap.end())
+    {
+    return collection;
+    }
+  ObservationList& subjectList = mapIt->second;
+  for(ObservationList::iterator iter=subjectList.begin();
       iter != subjectList.end(); iter++)
     {
     if ( (*iter)->GetSubject() == subject )
@@ -453,8 +685,13 @@ vtkCollection *vtkEventBroker::GetObservationsForSubject ( vtkObject *subject )
 vtkCollection *vtkEventBroker::GetObservationsForObserver ( vtkObject *observer )
 {
   vtkCollection *collection = vtkCollection::New();
-  ObservationVector& observerList = this->ObserverMap[observer];
-  for (ObservationVector::iterator iter = observerList.begin();
+  ObjectToObservationVectorMap::iterator mapIt = this->ObserverMap.find(observer);
+  if (mapIt == this->ObserverMap.end())
+    {
+    return collection;
+    }
+  ObservationList& observerList = mapIt->second;
+  for (ObservationList::iterator iter = observerList.begin();
        iter != observerList.end(); iter++)
     {
     if ( (*iter)->GetObserver() == observer )
@@ -472,7 +709,7 @@ vtkCollection *vtkEventBroker::GetObservationsForCallback ( vtkCallbackCommand *
   ObjectToObservationVectorMap::iterator it;
   for (it = this->ObserverMap.begin(); it != this->ObserverMap.end(); ++it)
     {
-    ObservationVector::iterator iter;
+    ObservationList::iterator iter;
     for(iter=it->second.begin(); iter != it->second.end(); iter++)
       {
       if ( *iter && (*iter)->GetCallbackCommand() == callback )
@@ -510,9 +747,7 @@ vtkObservation *vtkEventBroker::GetNthObservation ( int n )
     {
     if ( static_cast<size_t>(n) < count + iter->second.size())
       {
-      ObservationVector::iterator it=iter->second.begin();
-      std::advance(it, n-count);
-      return (*it);
+      return iter->second[n-count];
       }
     else
       {
@@ -681,11 +916,13 @@ void vtkEventBroker::ProcessEvent ( vtkObservation *observation, vtkObject *call
   //
   if ( eid == observation->GetEvent() || observation->GetEvent() == vtkCommand::AnyEvent )
     {
-    if ( this->EventMode == vtkEventBroker::Synchronous || eid == vtkCommand::DeleteEvent )
+    if ( (this->EventMode == vtkEventBroker::Synchronous && this->EventBatchLevel == 0)
+      || eid == vtkCommand::DeleteEvent )
       {
       this->InvokeObservation( observation, eid, callData );
       }
-    else if ( this->EventMode == vtkEventBroker::Asynchronous )
+    else if ( this->EventMode == vtkEventBroker::Asynchronous
+      || this->EventMode == vtkEventBroker::Synchronous )
       {
       this->QueueObservation( observation, eid, callData );
       }
@@ -706,13 +943,18 @@ void vtkEventBroker::ProcessEvent ( vtkObservation *observation, vtkObject *call
   if ( eid == vtkCommand::DeleteEvent )
     {
     // iterate list of observations for the deleted object (caller) as subject
-    ObservationVector::iterator obsIter;
-    ObservationVector& subjectList = this->SubjectMap[caller];
-    for(obsIter=subjectList.begin(); obsIter != subjectList.end(); ++obsIter)
+    ObjectToObservationVectorMap::iterator mapIt = this->SubjectMap.find(caller);
+    if (mapIt != this->SubjectMap.end())
       {
-      if ( (*obsIter)->GetEvent() == vtkCommand::DeleteEvent )
+      ObservationList::iterator obsIter;
+      // copy, as observations may be removed while invoking them
+      ObservationList subjectList = mapIt->second;
+      for(obsIter=subjectList.begin(); obsIter != subjectList.end(); ++obsIter)
         {
-        this->InvokeObservation( observation, eid, callData );
+        if ( (*obsIter)->GetEvent() == vtkCommand::DeleteEvent )
+          {
+          this->InvokeObservation( observation, eid, callData );
+          }
         }
       }
     if ( caller == observation->GetSubject() )
@@ -882,6 +1124,80 @@ void vtkEventBroker::ProcessEventQueue ()
     }
 }
 
+//----------------------------------------------------------------------------
+void vtkEventBroker::StartEventBatch()
+{
+  ++this->EventBatchLevel;
+}
+
+//----------------------------------------------------------------------------
+void vtkEventBroker::EndEventBatch()
+{
+  if (this->EventBatchLevel <= 0)
+    {
+    vtkErrorMacro("EndEventBatch: no event batch was started");
+    return;
+    }
+  --this->EventBatchLevel;
+  if (this->EventBatchLevel == 0 && this->EventMode == vtkEventBroker::Synchronous)
+    {
+    this->ProcessEventQueue();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkEventBroker::PostEvent(vtkObject* subject, unsigned long event, void* callData)
+{
+  if (!subject)
+    {
+    return;
+    }
+  // released in ProcessPostedEvents()
+  subject->Register(this);
+  this->PostedEvents->Push(vtkPostedEventQueue::PostedEvent(subject, event, callData));
+}
+
+//----------------------------------------------------------------------------
+int vtkEventBroker::ProcessPostedEvents()
+{
+  std::vector<vtkPostedEventQueue::PostedEvent> postedEvents;
+  this->PostedEvents->PopAll(postedEvents);
+  if (postedEvents.empty())
+    {
+    return 0;
+    }
+
+  int numberOfInvokedEvents = 0;
+  this->StartEventBatch();
+  std::set<vtkPostedEventQueue::PostedEvent> invokedEvents;
+  for (std::vector<vtkPostedEventQueue::PostedEvent>::iterator postedEventIt = postedEvents.begin();
+       postedEventIt != postedEvents.end(); ++postedEventIt)
+    {
+    // collapse duplicate events, the observations are queued only once
+    // anyway but observers of the subject that don't use the broker would be
+    // notified multiple times.
+    if (invokedEvents.insert(*postedEventIt).second)
+      {
+      postedEventIt->Subject->InvokeEvent(postedEventIt->Event, postedEventIt->CallData);
+      ++numberOfInvokedEvents;
+      }
+    }
+  this->EndEventBatch();
+
+  for (std::vector<vtkPostedEventQueue::PostedEvent>::iterator postedEventIt = postedEvents.begin();
+       postedEventIt != postedEvents.end(); ++postedEventIt)
+    {
+    postedEventIt->Subject->UnRegister(this);
+    }
+  return numberOfInvokedEvents;
+}
+
+//----------------------------------------------------------------------------
+int vtkEventBroker::GetNumberOfPostedEvents()
+{
+  return this->PostedEvents->GetNumberOfEvents();
+}
+
 //----------------------------------------------------------------------------
 void vtkEventBroker::PrintSelf(ostream& os, vtkIndent indent)
 {
@@ -892,6 +1208,7 @@ void vtkEventBroker::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "EventMode: " << this->GetEventModeAsString() << "\n";
   os << indent << "EventLogging: " << this->EventLogging << "\n";
   os << indent << "EventNestingLevel: " << this->EventNestingLevel << "\n";
+  os << indent << "EventBatchLevel: " << this->EventBatchLevel << "\n";
   os << indent << "LogFileName: " <<
     (this->LogFileName ? this->LogFileName : "(none)") << "\n";
 }
@@ -189,7 +189,10 @@ public:
     if (eventMode != this->EventMode)
      {
      this->EventMode = eventMode;
-     this->ProcessEventQueue();
+     if (this->EventBatchLevel == 0)
+       {
+       this->ProcessEventQueue();
+       }
      this->Modified();
      }
   };
@@ -233,6 +236,45 @@ public:
   vtkGetMacro (CompressCallData, int);
   vtkSetMacro (CompressCallData, int);
 
+  /// Event batches
+  ///
+  /// Between StartEventBatch() and EndEventBatch(), observations are added
+  /// to the event queue (as in Asynchronous mode) instead of being invoked.
+  /// An observation is queued only once per batch and duplicate
+  /// (event, callData) pairs are collapsed (with CompressCallData on, only
+  /// the last callData is kept), so that an observer is notified once of
+  /// all the ModifiedEvents fired by a subject during the batch.
+  /// Batches can be nested: the queue is processed when the outermost batch
+  /// ends, unless the event mode is Asynchronous.
+  /// DeleteEvents are always invoked immediately.
+  void StartEventBatch();
+  void EndEventBatch();
+  vtkGetMacro(EventBatchLevel, int);
+
+  /// Posted events
+  ///
+  /// PostEvent() can be called from any thread: the event is stored in a
+  /// queue and is invoked on \a subject (with the same semantic as
+  /// subject->InvokeEvent(event, callData)) by the thread that calls
+  /// ProcessPostedEvents(), typically the main thread. Posting threads only
+  /// take a short lock shared with the other posting threads, they never
+  /// wait for ProcessPostedEvents(). Events are invoked in the order they
+  /// were posted.
+  /// The subject is registered until the event is processed.
+  /// \sa ProcessPostedEvents()
+  void PostEvent(vtkObject* subject, unsigned long event, void* callData = 0);
+
+  /// Invoke all the events posted with PostEvent() so far, within an event
+  /// batch. Duplicate (subject, event, callData) posted events are invoked
+  /// only once. Must be called from the thread that owns the subjects
+  /// (typically the main thread).
+  /// Returns the number of events that were invoked.
+  int ProcessPostedEvents();
+
+  /// Return the number of events posted but not processed yet.
+  /// The value is approximate if events are posted concurrently.
+  int GetNumberOfPostedEvents();
+
   ///
   /// Sets the method pointer to be used for processing script observations
   void SetScriptHandler ( void (*scriptHandler) (const char* script, void *clientData), void *clientData )
@@ -265,8 +307,13 @@ protected:
   typedef vtkEventBroker Self;
 
 
+  /// Observations of an object, stored in a flat vector for fast traversal.
+  /// The position of an observation in the vector is cached in the
+  /// observation so that it can be removed in constant time.
+  typedef std::vector< vtkObservation * > ObservationList;
+
   ///
-  typedef std::map< vtkObject*, ObservationVector > ObjectToObservationVectorMap;
+  typedef std::map< vtkObject*, ObservationList > ObjectToObservationVectorMap;
 
   /// maps to manage quick lookup by object
   ObjectToObservationVectorMap SubjectMap;
@@ -285,6 +332,10 @@ protected:
 
   int EventMode;
   int CompressCallData;
+  int EventBatchLevel;
+
+  class vtkPostedEventQueue;
+  vtkPostedEventQueue* PostedEvents;
 
   std::ofstream LogFile;
 private:
@@ -292,6 +343,12 @@ private:
   /// observations. It leaves the event broker in an inconsistent state:
   ///  - SubjectMap and ObserverMap are not being updated.
   void DetachObservations();
+
+  /// Add/remove observation to/from the SubjectMap and ObserverMap lists.
+  void AddSubjectObservation(vtkObservation *observation);
+  void RemoveSubjectObservation(vtkObservation *observation);
+  void AddObserverObservation(vtkObservation *observation);
+  void RemoveObserverObservation(vtkObservation *observation);
   /// vtkObservation can call these methods
   friend class vtkObservation;
 };
@@ -30,6 +30,7 @@
 #include <vtkPolyDataMapper.h>
 #include <vtkPLYReader.h>
 #include <vtkPLYWriter.h>
+#include <vtkPolyData.h>
 #include <vtkPolyDataReader.h>
 #include <vtkPolyDataWriter.h>
 #include <vtkProperty.h>
@@ -90,6 +91,7 @@ vtkMRMLNodeNewMacro(vtkMRMLModelStorageNode);
 vtkMRMLModelStorageNode::vtkMRMLModelStorageNode()
 {
   this->DefaultWriteFileExtension = "vtk";
+  this->ReadMeshIsUnstructuredGrid = false;
 }
 
 //----------------------------------------------------------------------------
@@ -123,7 +125,47 @@ bool vtkMRMLModelStorageNode::CanReadInReferenceNode(vtkMRMLNode *refNode)
 //----------------------------------------------------------------------------
 int vtkMRMLModelStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
 {
-  vtkMRMLModelNode *modelNode = dynamic_cast <vtkMRMLModelNode *> (refNode);
+  int result = this->ReadDataInThreadInternal(refNode);
+  if (!this->ApplyReadDataInternal(refNode))
+    {
+    result = 0;
+    }
+  return result;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLModelStorageNode::CanReadDataInThread(vtkMRMLNode *refNode)
+{
+  // subclasses may read files in ways that are not thread safe,
+  // they have to opt in explicitly
+  if (strcmp(this->GetClassName(), "vtkMRMLModelStorageNode") != 0)
+    {
+    return false;
+    }
+  return this->CanReadInReferenceNode(refNode);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLModelStorageNode::CanWriteDataInThread(vtkMRMLNode *refNode)
+{
+  // subclasses may write files in ways that are not thread safe,
+  // they have to opt in explicitly
+  if (strcmp(this->GetClassName(), "vtkMRMLModelStorageNode") != 0 ||
+      !this->CanWriteFromReferenceNode(refNode))
+    {
+    return false;
+    }
+  std::string extension = vtkMRMLStorageNode::GetLowercaseExtensionFromFileName(
+    this->GetFullNameFromFileName());
+  return extension != ".obj";
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLModelStorageNode::ReadDataInThreadInternal(vtkMRMLNode *vtkNotUsed(refNode))
+{
+  this->ReadMeshAlgorithm = NULL;
+  this->ReadMeshIsUnstructuredGrid = false;
+  this->ReadPolyData = NULL;
 
   std::string fullName = this->GetFullNameFromFileName();
   if (fullName.empty())
@@ -157,7 +199,7 @@ int vtkMRMLModelStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
       vtkNew<vtkBYUReader> reader;
       reader->SetGeometryFileName(fullName.c_str());
       reader->Update();
-      modelNode->SetPolyDataConnection(reader->GetOutputPort());
+      this->ReadMeshAlgorithm = reader.GetPointer();
       }
     else if (extension == std::string(".vtk"))
       {
@@ -176,7 +218,7 @@ int vtkMRMLModelStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
         reader->ReadAllColorScalarsOn();
         reader->ReadAllTCoordsOn();
         reader->ReadAllFieldsOn();
-        modelNode->SetPolyDataConnection(reader->GetOutputPort());
+        this->ReadMeshAlgorithm = reader.GetPointer();
         }
       else if (unstructuredGridReader->IsFileUnstructuredGrid())
         {
@@ -188,7 +230,8 @@ int vtkMRMLModelStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
         unstructuredGridReader->ReadAllTCoordsOn();
         unstructuredGridReader->ReadAllFieldsOn();
         unstructuredGridReader->Update();
-        modelNode->SetUnstructuredGridConnection(unstructuredGridReader->GetOutputPort());
+        this->ReadMeshAlgorithm = unstructuredGridReader.GetPointer();
+        this->ReadMeshIsUnstructuredGrid = true;
         }
       else
         {
@@ -201,35 +244,36 @@ int vtkMRMLModelStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
       vtkNew<vtkXMLPolyDataReader> reader;
       reader->SetFileName(fullName.c_str());
       reader->Update();
-      modelNode->SetPolyDataConnection(reader->GetOutputPort());
+      this->ReadMeshAlgorithm = reader.GetPointer();
       }
     else if (extension == std::string(".vtu"))
       {
       vtkNew<vtkXMLUnstructuredGridReader> reader;
       reader->SetFileName(fullName.c_str());
       reader->Update();
-      modelNode->SetUnstructuredGridConnection(reader->GetOutputPort());
+      this->ReadMeshAlgorithm = reader.GetPointer();
+      this->ReadMeshIsUnstructuredGrid = true;
       }
     else if (extension == std::string(".stl"))
       {
       vtkNew<vtkSTLReader> reader;
       reader->SetFileName(fullName.c_str());
       reader->Update();
-      modelNode->SetPolyDataConnection(reader->GetOutputPort());
+      this->ReadMeshAlgorithm = reader.GetPointer();
       }
     else if (extension == std::string(".ply"))
       {
       vtkNew<vtkPLYReader> reader;
       reader->SetFileName(fullName.c_str());
       reader->Update();
-      modelNode->SetPolyDataConnection(reader->GetOutputPort());
+      this->ReadMeshAlgorithm = reader.GetPointer();
       }
     else if (extension == std::string(".obj"))
       {
       vtkNew<vtkOBJReader> reader;
       reader->SetFileName(fullName.c_str());
       reader->Update();
-      modelNode->SetPolyDataConnection(reader->GetOutputPort());
+      this->ReadMeshAlgorithm = reader.GetPointer();
       }
     else if (extension == std::string(".meta"))  // model in meta format
       {
@@ -290,7 +334,7 @@ int vtkMRMLModelStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
 
         vtkMesh->SetPolys(cells.GetPointer());
 
-        modelNode->SetAndObservePolyData(vtkMesh.GetPointer());
+        this->ReadPolyData = vtkMesh.GetPointer();
       }
     else
     {
@@ -302,22 +346,49 @@ int vtkMRMLModelStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
     {
       result = 0;
     }
+    return result;
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLModelStorageNode::ApplyReadDataInternal(vtkMRMLNode *refNode)
+{
+  vtkMRMLModelNode *modelNode = vtkMRMLModelNode::SafeDownCast(refNode);
+  if (modelNode == NULL)
+    {
+    vtkErrorMacro("ApplyReadDataInternal: Reference node is not a model node");
+    return 0;
+    }
+  if (this->ReadMeshAlgorithm.GetPointer() == NULL && this->ReadPolyData.GetPointer() == NULL)
+    {
+    return 1;
+    }
 
-    if (modelNode->GetMesh() != NULL)
+  if (this->ReadPolyData)
     {
-      // is there an active scalar array?
-      if (modelNode->GetDisplayNode())
+    modelNode->SetAndObservePolyData(this->ReadPolyData);
+    }
+  else if (this->ReadMeshIsUnstructuredGrid)
+    {
+    modelNode->SetUnstructuredGridConnection(this->ReadMeshAlgorithm->GetOutputPort());
+    }
+  else
+    {
+    modelNode->SetPolyDataConnection(this->ReadMeshAlgorithm->GetOutputPort());
+    }
+  this->ReadMeshAlgorithm = NULL;
+  this->ReadPolyData = NULL;
+
+  // is there an active scalar array?
+  if (modelNode->GetMesh() != NULL && modelNode->GetDisplayNode())
+    {
+    double *scalarRange = modelNode->GetMesh()->GetScalarRange();
+    if (scalarRange)
       {
-        double *scalarRange = modelNode->GetMesh()->GetScalarRange();
-        if (scalarRange)
-        {
-          vtkDebugMacro("ReadDataInternal: setting scalar range " << scalarRange[0] << ", " << scalarRange[1]);
-          modelNode->GetDisplayNode()->SetScalarRange(scalarRange);
-        }
+      vtkDebugMacro("ApplyReadDataInternal: setting scalar range " << scalarRange[0] << ", " << scalarRange[1]);
+      modelNode->GetDisplayNode()->SetScalarRange(scalarRange);
       }
-      //modelNode->GetMesh()->Modified();
     }
-    return result;
+  return 1;
 }
 
 //----------------------------------------------------------------------------
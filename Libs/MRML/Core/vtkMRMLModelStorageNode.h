@@ -17,7 +17,12 @@
 
 #include "vtkMRMLStorageNode.h"
 
+// VTK includes
+#include <vtkSmartPointer.h>
+
+class vtkAlgorithm;
 class vtkMRMLModelNode;
+class vtkPolyData;
 
 /// \brief MRML node for model storage on disk.
 ///
@@ -41,6 +46,15 @@ public:
   /// Return true if the reference node can be read in
   virtual bool CanReadInReferenceNode(vtkMRMLNode *refNode) VTK_OVERRIDE;
 
+  /// Models can be read in a background thread.
+  /// Subclasses are read in the main thread unless they override this method.
+  virtual bool CanReadDataInThread(vtkMRMLNode *refNode) VTK_OVERRIDE;
+
+  /// Models can be written in a background thread, except in OBJ format
+  /// that is exported through a render window.
+  /// Subclasses are written in the main thread unless they override this method.
+  virtual bool CanWriteDataInThread(vtkMRMLNode *refNode) VTK_OVERRIDE;
+
 protected:
   vtkMRMLModelStorageNode();
   ~vtkMRMLModelStorageNode();
@@ -59,9 +73,20 @@ protected:
   /// Read data and set it in the referenced node
   virtual int ReadDataInternal(vtkMRMLNode *refNode) VTK_OVERRIDE;
 
+  /// Read the mesh without modifying the referenced node
+  virtual int ReadDataInThreadInternal(vtkMRMLNode *refNode) VTK_OVERRIDE;
+
+  /// Set the read mesh in the referenced node
+  virtual int ApplyReadDataInternal(vtkMRMLNode *refNode) VTK_OVERRIDE;
+
   /// Write data from a  referenced node
   virtual int WriteDataInternal(vtkMRMLNode *refNode) VTK_OVERRIDE;
 
+  /// Mesh read by ReadDataInThreadInternal(), until it is set in the model
+  /// node by ApplyReadDataInternal(): either the reader of the mesh or the mesh.
+  vtkSmartPointer<vtkAlgorithm> ReadMeshAlgorithm;
+  bool ReadMeshIsUnstructuredGrid;
+  vtkSmartPointer<vtkPolyData> ReadPolyData;
 };
 
 #endif
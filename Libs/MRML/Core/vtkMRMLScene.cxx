@@ -54,6 +54,7 @@ Version:   $Revision: 1.18 $
 #include "vtkMRMLSliceCompositeNode.h"
 #include "vtkMRMLSliceNode.h"
 #include "vtkMRMLSnapshotClipNode.h"
+#include "vtkMRMLStorageNode.h"
 #include "vtkMRMLSubjectHierarchyNode.h"
 #include "vtkMRMLTableNode.h"
 #include "vtkMRMLTableStorageNode.h"
@@ -63,6 +64,7 @@ Version:   $Revision: 1.18 $
 #include "vtkMRMLVectorVolumeDisplayNode.h"
 #include "vtkMRMLViewNode.h"
 #include "vtkMRMLVolumeArchetypeStorageNode.h"
+#include "vtkMRMLVolumeNode.h"
 #include "vtkURIHandler.h"
 #include "vtkMRMLLayoutNode.h"
 
@@ -82,8 +84,12 @@ Version:   $Revision: 1.18 $
 // VTK includes
 #include <vtkCallbackCommand.h>
 #include <vtkCollection.h>
+#include <vtkDataObject.h>
 #include <vtkDebugLeaks.h>
 #include <vtkErrorCode.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkSmartPointer.h>
 
@@ -101,6 +107,68 @@ Version:   $Revision: 1.18 $
 # include <vtkTimerLog.h>
 #endif
 
+namespace
+{
+
+//----------------------------------------------------------------------------
+/// File of a storage node that is read in a thread during Import()
+struct vtkMRMLSceneReadDataJob
+{
+  vtkMRMLStorageNode* StorageNode;
+  vtkMRMLNode* Node;
+  unsigned long FileSize;
+  bool Started;
+  int Result;
+};
+
+//----------------------------------------------------------------------------
+/// Jobs are taken by the threads in decreasing file size, so that
+/// the reading time is not much longer than the time of the largest file.
+struct vtkMRMLSceneReadDataQueue
+{
+  std::vector<vtkMRMLSceneReadDataJob> Jobs;
+  std::vector<size_t> Order;
+  size_t NextJob;
+  vtkSimpleMutexLock Lock;
+};
+
+//----------------------------------------------------------------------------
+struct vtkMRMLSceneLargerFile
+{
+  vtkMRMLSceneLargerFile(const std::vector<vtkMRMLSceneReadDataJob>& jobs)
+    : Jobs(jobs) {}
+  bool operator()(size_t a, size_t b) const
+    {
+    return this->Jobs[a].FileSize > this->Jobs[b].FileSize;
+    }
+  const std::vector<vtkMRMLSceneReadDataJob>& Jobs;
+};
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkMRMLScene_ReadDataThread(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  vtkMRMLSceneReadDataQueue* queue = static_cast<vtkMRMLSceneReadDataQueue*>(info->UserData);
+  while (true)
+    {
+    queue->Lock.Lock();
+    size_t next = queue->NextJob++;
+    queue->Lock.Unlock();
+    if (next >= queue->Order.size())
+      {
+      break;
+      }
+    vtkMRMLSceneReadDataJob& job = queue->Jobs[queue->Order[next]];
+    if (job.Started)
+      {
+      job.Result = job.StorageNode->ReadDataInThread(job.Node);
+      }
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+} // end of anonymous namespace
+
 vtkCxxSetObjectMacro(vtkMRMLScene, CacheManager, vtkCacheManager)
 vtkCxxSetObjectMacro(vtkMRMLScene, DataIOManager, vtkDataIOManager)
 vtkCxxSetObjectMacro(vtkMRMLScene, UserTagTable, vtkTagTable)
@@ -110,6 +178,7 @@ vtkCxxSetObjectMacro(vtkMRMLScene, URIHandlerCollection, vtkCollection)
 vtkMRMLScene::vtkMRMLScene()
 {
   this->NodeIDsMTime = 0;
+  this->NodesByClassMTime = 0;
   this->SceneModifiedTime = 0;
 
   this->RegisteredNodeClasses.clear();
@@ -118,6 +187,7 @@ vtkMRMLScene::vtkMRMLScene()
 
   this->Nodes =  vtkCollection::New();
   this->UndoStackSize = 100;
+  this->MaximumUndoMemorySize = 0;
   this->UndoFlag = false;
   this->InUndo = false;
 
@@ -137,6 +207,9 @@ vtkMRMLScene::vtkMRMLScene()
 
   this->ReadDataOnLoad = 1;
 
+  this->NumberOfReadDataThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  this->ReadDataScheduling = false;
+
   this->LastLoadedVersion = NULL;
   this->Version = NULL;
   this->SetVersion(CURRENT_MRML_VERSION);
@@ -800,7 +873,9 @@ int vtkMRMLScene::Import()
 
     // Notify the imported nodes about that all nodes are created
     // (so the observers can be attached to referenced nodes, etc.)
-    // by calling UpdateScene on each node
+    // by calling UpdateScene on each node.
+    // Files that can be read in a thread are read after all nodes are updated.
+    this->ReadDataScheduling = (this->NumberOfReadDataThreads > 1);
     for (addedNodes->InitTraversal(it);
          (node = (vtkMRMLNode*)addedNodes->GetNextItemAsObject(it)) ;)
       {
@@ -821,6 +896,8 @@ int vtkMRMLScene::Import()
         // this->SetErrorCode(0);
         }
       }
+    this->ReadDataScheduling = false;
+    this->ReadScheduledData();
 
     this->Modified();
     this->RemoveUnusedNodeReferences();
@@ -867,6 +944,64 @@ int vtkMRMLScene::Import()
   return returnCode;
 }
 
+//------------------------------------------------------------------------------
+bool vtkMRMLScene::ScheduleReadData(vtkMRMLStorageNode* storageNode, vtkMRMLNode* refNode)
+{
+  if (!this->ReadDataScheduling || storageNode == NULL || refNode == NULL
+    || storageNode->GetURI() != NULL || !storageNode->CanReadDataInThread(refNode))
+    {
+    return false;
+    }
+  this->ScheduledReadData.push_back(std::make_pair(
+    vtkSmartPointer<vtkMRMLStorageNode>(storageNode), vtkSmartPointer<vtkMRMLNode>(refNode)));
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLScene::ReadScheduledData()
+{
+  if (this->ScheduledReadData.empty())
+    {
+    return;
+    }
+
+  vtkMRMLSceneReadDataQueue queue;
+  queue.NextJob = 0;
+  for (size_t i = 0; i < this->ScheduledReadData.size(); ++i)
+    {
+    vtkMRMLSceneReadDataJob job;
+    job.StorageNode = this->ScheduledReadData[i].first;
+    job.Node = this->ScheduledReadData[i].second;
+    job.Started = job.StorageNode->StartReadData(job.Node);
+    job.FileSize = job.Started ?
+      vtksys::SystemTools::FileLength(job.StorageNode->GetFullNameFromFileName().c_str()) : 0;
+    job.Result = 0;
+    queue.Jobs.push_back(job);
+    queue.Order.push_back(i);
+    }
+  std::stable_sort(queue.Order.begin(), queue.Order.end(), vtkMRMLSceneLargerFile(queue.Jobs));
+
+  vtkNew<vtkMultiThreader> threader;
+  threader->SetNumberOfThreads(
+    std::min(this->NumberOfReadDataThreads, static_cast<int>(queue.Jobs.size())));
+  threader->SetSingleMethod(vtkMRMLScene_ReadDataThread, &queue);
+  threader->SingleMethodExecute();
+
+  // Set the data in the nodes in the order of the scene
+  for (size_t i = 0; i < queue.Jobs.size(); ++i)
+    {
+    vtkMRMLSceneReadDataJob& job = queue.Jobs[i];
+    if (job.StorageNode->EndReadData(job.Node, job.Result) == 0)
+      {
+      this->SetErrorCode(1);
+      std::string msg = std::string("Error reading file ")
+        + (job.StorageNode->GetFileName() ? job.StorageNode->GetFileName() : "(null)");
+      this->SetErrorMessage(msg);
+      }
+    }
+  this->ScheduledReadData.clear();
+}
+
 //------------------------------------------------------------------------------
 int vtkMRMLScene::LoadIntoScene(vtkCollection* nodeCollection)
 {
@@ -1179,10 +1314,18 @@ vtkMRMLNode* vtkMRMLScene::AddNodeNoNotify(vtkMRMLNode *n)
     n->SetName(this->GenerateUniqueName(n).c_str());
     }
   n->SetScene( this );
+  // The per-class lists can be appended to only if they were in sync with
+  // the collection before the node is added.
+  bool nodesByClassUpToDate = (this->NodesByClassMTime >= this->Nodes->GetMTime());
   this->Nodes->vtkCollection::AddItem((vtkObject *)n);
 
   // cache the node so the whole scene cache stays up-todate
   this->AddNodeID(n);
+  if (nodesByClassUpToDate)
+    {
+    this->AddNodeByClass(n);
+    }
+  this->SaveNodeAddedForUndo(n);
 
   //n->OnNodeAddedToScene();
 
@@ -1330,16 +1473,22 @@ void vtkMRMLScene::RemoveNode(vtkMRMLNode *n)
 #endif
 
   n->Register(this);
+  this->SaveNodeRemovedForUndo(n);
   this->InvokeEvent(vtkMRMLScene::NodeAboutToBeRemovedEvent, n);
 
   if (n->GetScene() == this) // extra precaution that might not be useful
     {
     n->SetScene(0);
     }
+  bool nodesByClassUpToDate = (this->NodesByClassMTime >= this->Nodes->GetMTime());
   this->Nodes->vtkCollection::RemoveItem((vtkObject *)n);
 
   std::string nid=n->GetID();
   this->RemoveNodeID(n->GetID());
+  if (nodesByClassUpToDate)
+    {
+    this->RemoveNodeByClass(n);
+    }
 
   this->InvokeEvent(vtkMRMLScene::NodeRemovedEvent, n);
 
@@ -1517,18 +1666,7 @@ int vtkMRMLScene::GetNumberOfNodesByClass(const char *className)
     vtkErrorMacro("GetNumberOfNodesByClass: class name is null.");
     return 0;
     }
-  int num=0;
-  vtkMRMLNode *node;
-  vtkCollectionSimpleIterator it;
-  for (this->Nodes->InitTraversal(it);
-       (node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject(it)) ;)
-    {
-    if (node->IsA(className))
-      {
-      num++;
-      }
-    }
-  return num;
+  return static_cast<int>(this->GetNodesByClassCached(className).size());
 }
 
 //------------------------------------------------------------------------------
@@ -1540,16 +1678,8 @@ int vtkMRMLScene::GetNodesByClass(const char *className, std::vector<vtkMRMLNode
     vtkErrorMacro("GetNodesByClass: class name is null.");
     return 0;
     }
-  vtkMRMLNode *node;
-  vtkCollectionSimpleIterator it;
-  for (this->Nodes->InitTraversal(it);
-       (node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject(it)) ;)
-    {
-    if (node->IsA(className))
-      {
-      nodes.push_back(node);
-      }
-    }
+  const std::vector<vtkMRMLNode*>& classNodes = this->GetNodesByClassCached(className);
+  nodes.insert(nodes.end(), classNodes.begin(), classNodes.end());
   return static_cast<int>(nodes.size());
 }
 
@@ -1562,15 +1692,11 @@ vtkCollection* vtkMRMLScene::GetNodesByClass(const char *className)
     return 0;
     }
   vtkCollection* nodes = vtkCollection::New();
-  vtkMRMLNode *node;
-  vtkCollectionSimpleIterator it;
-  for (this->Nodes->InitTraversal(it);
-       (node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject(it)) ;)
+  const std::vector<vtkMRMLNode*>& classNodes = this->GetNodesByClassCached(className);
+  for (std::vector<vtkMRMLNode*>::const_iterator nodeIt = classNodes.begin();
+       nodeIt != classNodes.end(); ++nodeIt)
     {
-    if (node->IsA(className))
-      {
-      nodes->AddItem(node);
-      }
+    nodes->AddItem(*nodeIt);
     }
   return nodes;
 }
@@ -1707,22 +1833,12 @@ vtkMRMLNode* vtkMRMLScene::GetNthNodeByClass(int n, const char *className)
     return NULL;
     }
 
-  int num=0;
-  vtkMRMLNode *node;
-  vtkCollectionSimpleIterator it;
-  for (this->Nodes->InitTraversal(it);
-       (node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject(it)) ;)
+  const std::vector<vtkMRMLNode*>& classNodes = this->GetNodesByClassCached(className);
+  if (n >= static_cast<int>(classNodes.size()))
     {
-    if (node->IsA(className))
-      {
-      if (num == n)
-        {
-        return node;
-        }
-      num++;
-      }
+    return NULL;
     }
-  return NULL;
+  return classNodes[n];
 }
 
 //------------------------------------------------------------------------------
@@ -1869,13 +1985,13 @@ vtkCollection* vtkMRMLScene::GetNodesByClassByName(const char* className, const
     return nodes;
     }
 
-  vtkMRMLNode *node;
-  for (int n=0; n < this->Nodes->GetNumberOfItems(); n++)
+  const std::vector<vtkMRMLNode*>& classNodes = this->GetNodesByClassCached(className);
+  for (std::vector<vtkMRMLNode*>::const_iterator nodeIt = classNodes.begin();
+       nodeIt != classNodes.end(); ++nodeIt)
     {
-    node = (vtkMRMLNode*)this->Nodes->GetItemAsObject(n);
-    if (!strcmp(node->GetName(), name) && node->IsA(className))
+    if ((*nodeIt)->GetName() && !strcmp((*nodeIt)->GetName(), name))
       {
-      nodes->AddItem(node);
+      nodes->AddItem(*nodeIt);
       }
     }
 
@@ -1955,6 +2071,7 @@ vtkMRMLNode* vtkMRMLScene::InsertAfterNode(vtkMRMLNode *item, vtkMRMLNode *n)
     }
   // cache the node so the whole scene cache stays up-to-date
   this->AddNodeID(n);
+  this->SaveNodeAddedForUndo(n);
 
   n->SetDisableModifiedEvent(modifyStatus);
 
@@ -2040,6 +2157,7 @@ vtkMRMLNode* vtkMRMLScene::InsertBeforeNode(vtkMRMLNode *item, vtkMRMLNode *n)
     }
   // cache the node so the whole scene cache stays up-todate
   this->AddNodeID(n);
+  this->SaveNodeAddedForUndo(n);
 
   n->SetDisableModifiedEvent(modifyStatus);
 
@@ -2293,7 +2411,138 @@ void vtkMRMLScene::RemoveReservedIDs()
 }
 
 //------------------------------------------------------------------------------
-// Pushes the current scene onto the undo stack, and makes a backup copy of the
+/// \brief State of the scene saved for undo or redo.
+///
+/// A state does not store the whole scene: it only keeps copies of the nodes
+/// that were explicitly saved and the nodes that were added or removed after
+/// the state was saved. Restoring a state therefore costs proportionally to
+/// the size of the change, not to the size of the scene.
+class vtkMRMLScene::vtkUndoState
+{
+public:
+  struct NodeCopy
+    {
+    /// Copy of the node, it is never modified once created so it can be
+    /// shared between states.
+    vtkSmartPointer<vtkMRMLNode> Node;
+    /// MTime of the original node when the copy was made
+    vtkMTimeType OriginalMTime;
+    };
+  /// Copies of the saved nodes, indexed by node ID
+  std::map< std::string, NodeCopy > SavedNodes;
+  /// IDs of the nodes added to the scene after the state was saved
+  std::vector< std::string > AddedNodeIDs;
+  /// Copies of the nodes removed from the scene after the state was saved,
+  /// taken when they were removed.
+  std::vector< NodeCopy > RemovedNodes;
+
+  /// Return a copy of \a node. Copy-on-write: if the node has not been
+  /// modified since the most recent copy of the node in \a stack (saved or
+  /// removed), that copy is shared instead of making a new one. States equal
+  /// to \a excludedState are not searched. \a stack can be NULL.
+  static NodeCopy CopyNode(vtkMRMLNode* node, std::list< vtkUndoState* >* stack,
+                           vtkUndoState* excludedState);
+
+  /// Return the memory size (in kiB) of the bulk data of the node copies
+  /// that is not in \a countedBulkData yet, and add it there.
+  unsigned long CountBulkDataMemorySize(std::set<vtkDataObject*>& countedBulkData);
+};
+
+namespace
+{
+//------------------------------------------------------------------------------
+vtkDataObject* GetNodeBulkData(vtkMRMLNode* node)
+{
+  if (vtkMRMLVolumeNode::SafeDownCast(node))
+    {
+    return vtkMRMLVolumeNode::SafeDownCast(node)->GetImageData();
+    }
+  if (vtkMRMLModelNode::SafeDownCast(node))
+    {
+    return vtkMRMLModelNode::SafeDownCast(node)->GetMesh();
+    }
+  if (vtkMRMLTableNode::SafeDownCast(node))
+    {
+    return vtkMRMLTableNode::SafeDownCast(node)->GetTable();
+    }
+  return NULL;
+}
+}
+
+//------------------------------------------------------------------------------
+vtkMRMLScene::vtkUndoState::NodeCopy vtkMRMLScene::vtkUndoState::CopyNode(
+  vtkMRMLNode* node, std::list< vtkUndoState* >* stack, vtkUndoState* excludedState)
+{
+  std::string nodeID = node->GetID();
+  NodeCopy nodeCopy;
+  nodeCopy.OriginalMTime = node->GetMTime();
+
+  NodeCopy* previousCopy = NULL;
+  if (stack)
+    {
+    for (std::list< vtkUndoState* >::reverse_iterator stateIt = stack->rbegin();
+         stateIt != stack->rend() && !previousCopy; ++stateIt)
+      {
+      if (*stateIt == excludedState)
+        {
+        continue;
+        }
+      std::map< std::string, NodeCopy >::iterator copyIt = (*stateIt)->SavedNodes.find(nodeID);
+      if (copyIt != (*stateIt)->SavedNodes.end())
+        {
+        previousCopy = &copyIt->second;
+        }
+      for (std::vector< NodeCopy >::iterator removedIt = (*stateIt)->RemovedNodes.begin();
+           removedIt != (*stateIt)->RemovedNodes.end() && !previousCopy; ++removedIt)
+        {
+        if (nodeID == removedIt->Node->GetID())
+          {
+          previousCopy = &(*removedIt);
+          }
+        }
+      }
+    }
+  if (previousCopy && previousCopy->OriginalMTime == nodeCopy.OriginalMTime
+    && previousCopy->Node->IsA(node->GetClassName()))
+    {
+    nodeCopy.Node = previousCopy->Node;
+    }
+  else
+    {
+    nodeCopy.Node = vtkSmartPointer<vtkMRMLNode>::Take(node->CreateNodeInstance());
+    nodeCopy.Node->CopyWithScene(node);
+    }
+  return nodeCopy;
+}
+
+//------------------------------------------------------------------------------
+unsigned long vtkMRMLScene::vtkUndoState::CountBulkDataMemorySize(
+  std::set<vtkDataObject*>& countedBulkData)
+{
+  unsigned long memorySize = 0;
+  for (std::map< std::string, NodeCopy >::iterator copyIt = this->SavedNodes.begin();
+       copyIt != this->SavedNodes.end(); ++copyIt)
+    {
+    vtkDataObject* data = GetNodeBulkData(copyIt->second.Node);
+    if (data && countedBulkData.insert(data).second)
+      {
+      memorySize += data->GetActualMemorySize();
+      }
+    }
+  for (std::vector< NodeCopy >::iterator removedIt = this->RemovedNodes.begin();
+       removedIt != this->RemovedNodes.end(); ++removedIt)
+    {
+    vtkDataObject* data = GetNodeBulkData(removedIt->Node);
+    if (data && countedBulkData.insert(data).second)
+      {
+      memorySize += data->GetActualMemorySize();
+      }
+    }
+  return memorySize;
+}
+
+//------------------------------------------------------------------------------
+// Pushes a new state onto the undo stack, and makes a backup copy of the
 // passed node so that changes to the node are undoable; several signatures to handle
 // individual nodes or a vtkCollection of nodes, or a vector of nodes
 //
@@ -2321,6 +2570,7 @@ void vtkMRMLScene::SaveStateForUndo (vtkMRMLNode *node)
     {
     this->CopyNodeInUndoStack(node);
     }
+  this->TrimUndoStack();
 }
 
 //------------------------------------------------------------------------------
@@ -2352,6 +2602,7 @@ void vtkMRMLScene::SaveStateForUndo (std::vector<vtkMRMLNode *> nodes)
       this->CopyNodeInUndoStack(node);
       }
     }
+  this->TrimUndoStack();
 }
 
 //------------------------------------------------------------------------------
@@ -2381,16 +2632,17 @@ void vtkMRMLScene::SaveStateForUndo (vtkCollection* nodes)
   //this->SetUndoOn();
   this->PushIntoUndoStack();
 
-  int nnodes = nodes->GetNumberOfItems();
-
-  for (int n=0; n<nnodes; n++)
+  vtkMRMLNode *node;
+  vtkCollectionSimpleIterator it;
+  for (nodes->InitTraversal(it);
+       (node = vtkMRMLNode::SafeDownCast(nodes->GetNextItemAsObject(it))) ;)
     {
-    vtkMRMLNode *node  = dynamic_cast < vtkMRMLNode *>(nodes->GetItemAsObject(n));
-    if (node && !node->IsA("vtkMRMLSceneViewNode"))
+    if (!node->IsA("vtkMRMLSceneViewNode"))
       {
       this->CopyNodeInUndoStack(node);
       }
     }
+  this->TrimUndoStack();
 }
 
 //------------------------------------------------------------------------------
@@ -2412,64 +2664,22 @@ void vtkMRMLScene::SaveStateForUndo ()
 }
 
 //------------------------------------------------------------------------------
-// Make a new collection that has pointers to all the nodes in the current scene
+// Push a new empty state on the undo stack
 void vtkMRMLScene::PushIntoUndoStack()
 {
-  if (this->Nodes == NULL)
-    {
-    return;
-    }
-
-  vtkCollection* newScene = vtkCollection::New();
-
-  vtkCollection* currentScene = this->Nodes;
-
-  int nnodes = currentScene->GetNumberOfItems();
-
-  for (int n=0; n<nnodes; n++)
-    {
-    vtkMRMLNode *node  = dynamic_cast < vtkMRMLNode *>(currentScene->GetItemAsObject(n));
-    if (node && !node->IsA("vtkMRMLSceneViewNode"))
-      {
-      newScene->AddItem(node);
-      }
-    }
-
-  //TODO check max stack size
-  this->UndoStack.push_back(newScene);
+  this->UndoStack.push_back(new vtkUndoState);
 }
 
 //------------------------------------------------------------------------------
-// Make a new collection that has pointers to the current scene nodes
+// Push a new empty state on the redo stack
 void vtkMRMLScene::PushIntoRedoStack()
 {
-  if (this->Nodes == NULL)
-    {
-    return;
-    }
-
-  vtkCollection* newScene = vtkCollection::New();
-
-  vtkCollection* currentScene = this->Nodes;
-
-  int nnodes = currentScene->GetNumberOfItems();
-
-  for (int n=0; n<nnodes; n++)
-    {
-    vtkMRMLNode *node  = dynamic_cast < vtkMRMLNode *>(currentScene->GetItemAsObject(n));
-    if (node && !node->IsA("vtkMRMLSceneViewNode"))
-      {
-      newScene->AddItem(node);
-      }
-    }
-
-  //TODO check max stack size
-  this->RedoStack.push_back(newScene);
+  this->RedoStack.push_back(new vtkUndoState);
 }
 
 //------------------------------------------------------------------------------
-// Put a replacement node into the undoable copy of the scene so that the node
-// can be edited
+// Save a copy of the node into the top state of the undo stack so that the
+// node can be edited
 void vtkMRMLScene::CopyNodeInUndoStack(vtkMRMLNode *copyNode)
 {
   if (!copyNode)
@@ -2477,29 +2687,17 @@ void vtkMRMLScene::CopyNodeInUndoStack(vtkMRMLNode *copyNode)
     vtkErrorMacro("CopyNodeInUndoStack: node is null");
     return;
     }
-
-  vtkMRMLNode *snode = copyNode->CreateNodeInstance();
-  if (snode != NULL)
-    {
-    snode->CopyWithScene(copyNode);
-    }
-  vtkCollection* undoScene = dynamic_cast < vtkCollection *>( this->UndoStack.back() );
-  int nnodes = undoScene->GetNumberOfItems();
-  for (int n=0; n<nnodes; n++)
+  if (this->UndoStack.empty())
     {
-    vtkMRMLNode *node  = dynamic_cast < vtkMRMLNode *>(undoScene->GetItemAsObject(n));
-    if (node == copyNode)
-      {
-      undoScene->ReplaceItem (n, snode);
-      break;
-      }
+    vtkErrorMacro("CopyNodeInUndoStack: undo stack is empty");
+    return;
     }
-  snode->Delete();
+  this->CopyNodeInState(copyNode, this->UndoStack.back(), this->UndoStack);
 }
 
 //------------------------------------------------------------------------------
-// Put a replacement node into the redoable copy of the scene so that the node
-// can be replaced by the Undo version
+// Save a copy of the node into the top state of the redo stack so that the
+// node can be replaced by the Undo version
 void vtkMRMLScene::CopyNodeInRedoStack(vtkMRMLNode *copyNode)
 {
   if (!copyNode)
@@ -2507,150 +2705,160 @@ void vtkMRMLScene::CopyNodeInRedoStack(vtkMRMLNode *copyNode)
     vtkErrorMacro("CopyNodeInRedoStack: node is null");
     return;
     }
-  vtkMRMLNode *snode = copyNode->CreateNodeInstance();
-  if (snode != NULL)
+  if (this->RedoStack.empty())
     {
-    snode->CopyWithSceneWithSingleModifiedEvent(copyNode);
+    vtkErrorMacro("CopyNodeInRedoStack: redo stack is empty");
+    return;
     }
-  vtkCollection* undoScene = dynamic_cast < vtkCollection *>( this->RedoStack.back() );
-  int nnodes = undoScene->GetNumberOfItems();
-  for (int n=0; n<nnodes; n++)
+  this->CopyNodeInState(copyNode, this->RedoStack.back(), this->RedoStack);
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLScene::CopyNodeInState(vtkMRMLNode *copyNode, vtkUndoState* state,
+                                   std::list< vtkUndoState* >& stack)
+{
+  if (!copyNode || !copyNode->GetID() || !state)
+    {
+    return;
+    }
+  state->SavedNodes[copyNode->GetID()] = vtkUndoState::CopyNode(copyNode, &stack, state);
+}
+
+//------------------------------------------------------------------------------
+void vtkMRMLScene::SaveNodeAddedForUndo(vtkMRMLNode *node)
+{
+  if (!this->UndoFlag || this->InUndo || this->UndoStack.empty()
+    || !node || !node->GetID() || node->IsA("vtkMRMLSceneViewNode"))
+    {
+    return;
+    }
+  vtkUndoState* state = this->UndoStack.back();
+  // The node may have been removed after the state was saved and added back.
+  // The copy made at removal is then used to restore the node content if it
+  // was modified meanwhile.
+  for (std::vector< vtkUndoState::NodeCopy >::iterator removedIt = state->RemovedNodes.begin();
+       removedIt != state->RemovedNodes.end(); ++removedIt)
     {
-    vtkMRMLNode *node  = dynamic_cast < vtkMRMLNode *>(undoScene->GetItemAsObject(n));
-    if (node == copyNode)
+    if (strcmp(removedIt->Node->GetID(), node->GetID()) == 0)
       {
-      undoScene->ReplaceItem (n, snode);
-      break;
+      if (removedIt->OriginalMTime != node->GetMTime()
+        && state->SavedNodes.find(node->GetID()) == state->SavedNodes.end())
+        {
+        state->SavedNodes[node->GetID()] = *removedIt;
+        }
+      state->RemovedNodes.erase(removedIt);
+      return;
       }
     }
-  snode->Delete();
+  state->AddedNodeIDs.push_back(node->GetID());
 }
 
 //------------------------------------------------------------------------------
-// Replace the current scene by the top of the undo stack
-// -- move the current scene on the redo stack
-void vtkMRMLScene::Undo()
+void vtkMRMLScene::SaveNodeRemovedForUndo(vtkMRMLNode *node)
 {
-  if (!this->UndoFlag)
+  if (!this->UndoFlag || this->InUndo || this->UndoStack.empty()
+    || !node || !node->GetID() || node->IsA("vtkMRMLSceneViewNode"))
     {
     return;
     }
-
-  if (this->UndoStack.size() == 0)
+  vtkUndoState* state = this->UndoStack.back();
+  // Nodes that were added after the state was saved don't need to be restored
+  std::vector<std::string>::iterator addedIt =
+    std::find(state->AddedNodeIDs.begin(), state->AddedNodeIDs.end(), std::string(node->GetID()));
+  if (addedIt != state->AddedNodeIDs.end())
     {
+    state->AddedNodeIDs.erase(addedIt);
     return;
     }
+  // Keep a copy instead of the node, so that later changes of the removed
+  // node are not restored by undo.
+  state->RemovedNodes.push_back(vtkUndoState::CopyNode(node, &this->UndoStack, NULL));
+}
 
-  this->RemoveUnusedNodeReferences();
-
-  this->InUndo = true;
-
-  int nnodes;
-  int n;
-  unsigned int nn;
-
-  PushIntoRedoStack();
-
-  vtkCollection* currentScene = this->Nodes;
-  // We use 2 vectors instead of a map in order to keep the ordering of the
-  // nodes.
-  std::vector<std::string> currentIDs;
-  std::vector<vtkMRMLNode*> currentNodes;
-  nnodes = currentScene->GetNumberOfItems();
-  for (n=0; n<nnodes; n++)
+//------------------------------------------------------------------------------
+void vtkMRMLScene::RestoreState(vtkUndoState* state, vtkUndoState* inverseState)
+{
+  // remove new nodes created after the state was saved
+  for (std::vector<std::string>::reverse_iterator addedIt = state->AddedNodeIDs.rbegin();
+       addedIt != state->AddedNodeIDs.rend(); ++addedIt)
     {
-    vtkMRMLNode *node  = dynamic_cast < vtkMRMLNode *>(currentScene->GetItemAsObject(n));
-    if (node && !node->IsA("vtkMRMLSceneViewNode"))
+    vtkMRMLNode* nodeToRemove = this->GetNodeByID(*addedIt);
+    // Maybe the node has been removed already by a side effect of a previous
+    // node removal.
+    if (nodeToRemove)
       {
-      currentIDs.push_back(node->GetID());
-      currentNodes.push_back(node);
+      inverseState->RemovedNodes.insert(inverseState->RemovedNodes.begin(),
+        vtkUndoState::CopyNode(nodeToRemove, NULL, NULL));
+      this->RemoveNode(nodeToRemove);
       }
     }
 
-  vtkCollection* undoScene = NULL;
-  std::vector<std::string> undoIDs;
-  std::vector<vtkMRMLNode*> undoNodes;
-
-  if (!this->UndoStack.empty())
+  // add back nodes deleted after the state was saved
+  for (std::vector< vtkUndoState::NodeCopy >::iterator removedIt = state->RemovedNodes.begin();
+       removedIt != state->RemovedNodes.end(); ++removedIt)
     {
-    undoScene = dynamic_cast < vtkCollection *>( this->UndoStack.back() );
-    nnodes = undoScene->GetNumberOfItems();
-    for (n=0; n<nnodes; n++)
+    // The copy may be shared with other states, it must not be added itself
+    vtkSmartPointer<vtkMRMLNode> nodeToAdd =
+      vtkSmartPointer<vtkMRMLNode>::Take(removedIt->Node->CreateNodeInstance());
+    nodeToAdd->CopyWithScene(removedIt->Node);
+    vtkMRMLNode* addedNode = this->AddNode(nodeToAdd);
+    if (addedNode && addedNode->GetID())
       {
-      vtkMRMLNode *node  = dynamic_cast < vtkMRMLNode *>(undoScene->GetItemAsObject(n));
-      if (node && !node->IsA("vtkMRMLSceneViewNode"))
-        {
-        undoIDs.push_back(node->GetID());
-        undoNodes.push_back(node);
-        }
+      inverseState->AddedNodeIDs.push_back(addedNode->GetID());
       }
     }
 
-  std::vector<std::string>::iterator iterID;
-  std::vector<vtkMRMLNode*>::iterator iterNode;
-  std::vector<std::string>::iterator curIterID;
-  std::vector<vtkMRMLNode*>::iterator curIterNode;
-
-  // copy back changes and add deleted nodes to the current scene
-  std::vector<vtkMRMLNode*> addNodes;
-
-  for(iterID=undoIDs.begin(), iterNode = undoNodes.begin(); iterID != undoIDs.end(); iterID++, iterNode++)
+  // copy back changes, but before create a copy in the inverse state
+  for (std::map< std::string, vtkUndoState::NodeCopy >::iterator copyIt = state->SavedNodes.begin();
+       copyIt != state->SavedNodes.end(); ++copyIt)
     {
-    curIterID = std::find(currentIDs.begin(), currentIDs.end(), *iterID);
-    curIterNode = currentNodes.begin() + std::distance(currentIDs.begin(), curIterID);
-    if ( curIterID == currentIDs.end() )
+    vtkMRMLNode* currentNode = this->GetNodeByID(copyIt->first);
+    if (!currentNode || currentNode == copyIt->second.Node)
       {
-      // the node was deleted, add Node back to the curreent scene
-      addNodes.push_back(*iterNode);
+      continue;
       }
-    else if (*iterNode != *curIterNode)
+    if (copyIt->second.OriginalMTime == currentNode->GetMTime())
       {
-      // nodes differ, copy from undo to current scene
-      // but before create a copy in redo stack from current
-      this->CopyNodeInRedoStack(*curIterNode);
-      (*curIterNode)->CopyWithSceneWithSingleModifiedEvent(*iterNode);
+      // the node has not been modified since it was saved
+      inverseState->SavedNodes[copyIt->first] = copyIt->second;
+      continue;
       }
+    vtkUndoState::NodeCopy inverseCopy;
+    inverseCopy.Node = vtkSmartPointer<vtkMRMLNode>::Take(currentNode->CreateNodeInstance());
+    inverseCopy.Node->CopyWithScene(currentNode);
+    inverseCopy.OriginalMTime = currentNode->GetMTime();
+    currentNode->CopyWithSceneWithSingleModifiedEvent(copyIt->second.Node);
+    inverseState->SavedNodes[copyIt->first] = inverseCopy;
     }
+}
 
-  // remove new nodes created before Undo
-  std::vector<vtkMRMLNode*> removeNodes;
-  for(curIterID=currentIDs.begin(), curIterNode = currentNodes.begin(); curIterID != currentIDs.end(); curIterID++, curIterNode++)
+//------------------------------------------------------------------------------
+// Replace the current scene by the top of the undo stack
+// -- move the current scene on the redo stack
+void vtkMRMLScene::Undo()
+{
+  if (!this->UndoFlag)
     {
-    iterID = std::find(undoIDs.begin(),undoIDs.end(), *curIterID);
-    // Remove only if the node is not present in the previous state.
-    if ( iterID == undoIDs.end() )
-      {
-      removeNodes.push_back(*curIterNode);
-      }
+    return;
     }
 
-  for (nn=0; nn<addNodes.size(); nn++)
-    {
-    this->AddNode(addNodes[nn]);
-    }
-  for (nn=0; nn<removeNodes.size(); nn++)
+  if (this->UndoStack.size() == 0)
     {
-    vtkMRMLNode* nodeToRemove = removeNodes[nn];
-    // Maybe the node has been removed already by a side effect of a previous
-    // node removal.
-    if (this->IsNodePresent(nodeToRemove))
-      {
-      this->RemoveNode(nodeToRemove);
-      }
+    return;
     }
 
-  if (undoScene)
-    {
-    undoScene->RemoveAllItems();
-    undoScene->Delete();
-    }
+  this->RemoveUnusedNodeReferences();
+
+  this->InUndo = true;
+
+  vtkUndoState* undoState = this->UndoStack.back();
+  this->UndoStack.pop_back();
+  this->PushIntoRedoStack();
+  this->RestoreState(undoState, this->RedoStack.back());
+  delete undoState;
 
   this->RemoveUnusedNodeReferences();
 
-  if (!this->UndoStack.empty())
-   {
-   UndoStack.pop_back();
-   }
   this->Modified();
 
   this->InUndo = false;
@@ -2669,124 +2877,126 @@ void vtkMRMLScene::Redo()
     return;
     }
 
-  int nnodes;
-  int n;
-  unsigned int nn;
-
   this->RemoveUnusedNodeReferences();
 
-  PushIntoUndoStack();
+  this->InUndo = true;
 
-  vtkCollection* currentScene = this->Nodes;
-  //std::hash_map<std::string, vtkMRMLNode*> currentMap;
-  std::map<std::string, vtkMRMLNode*> currentMap;
-  nnodes = currentScene->GetNumberOfItems();
-  for (n=0; n<nnodes; n++)
-    {
-    vtkMRMLNode *node  = dynamic_cast < vtkMRMLNode *>(currentScene->GetItemAsObject(n));
-    if (node && !node->IsA("vtkMRMLSceneViewNode"))
-      {
-      currentMap[node->GetID()] = node;
-      }
-    }
+  vtkUndoState* redoState = this->RedoStack.back();
+  this->RedoStack.pop_back();
+  this->PushIntoUndoStack();
+  this->RestoreState(redoState, this->UndoStack.back());
+  delete redoState;
 
-  //std::hash_map<std::string, vtkMRMLNode*> undoMap;
-  std::map<std::string, vtkMRMLNode*> undoMap;
+  this->Modified();
 
-  vtkCollection* undoScene = NULL;
+  this->InUndo = false;
+}
 
-  if (!this->RedoStack.empty())
+//------------------------------------------------------------------------------
+void vtkMRMLScene::ClearUndoStack()
+{
+  std::list< vtkUndoState* >::iterator iter;
+  for(iter=this->UndoStack.begin(); iter != this->UndoStack.end(); iter++)
     {
-    undoScene = dynamic_cast < vtkCollection *>( this->RedoStack.back() );;
-    nnodes = undoScene->GetNumberOfItems();
-    for (n=0; n<nnodes; n++)
-      {
-      vtkMRMLNode *node  = dynamic_cast < vtkMRMLNode *>(undoScene->GetItemAsObject(n));
-      if (node && !node->IsA("vtkMRMLSceneViewNode"))
-        {
-        undoMap[node->GetID()] = node;
-        }
-      }
+    delete *iter;
     }
+  this->UndoStack.clear();
+}
 
-  //std::hash_map<std::string, vtkMRMLNode*>::iterator iter;
-  //std::hash_map<std::string, vtkMRMLNode*>::iterator curIter;
-  std::map<std::string, vtkMRMLNode*>::iterator iter;
-  std::map<std::string, vtkMRMLNode*>::iterator curIter;
-
-  // copy back changes and add deleted nodes to the current scene
-  std::vector<vtkMRMLNode*> addNodes;
+//------------------------------------------------------------------------------
+void vtkMRMLScene::ClearRedoStack()
+{
+  std::list< vtkUndoState* >::iterator iter;
+  for(iter=this->RedoStack.begin(); iter != this->RedoStack.end(); iter++)
+    {
+    delete *iter;
+    }
+  this->RedoStack.clear();
+}
 
-  for(iter=undoMap.begin(); iter != undoMap.end(); iter++)
+//------------------------------------------------------------------------------
+unsigned long vtkMRMLScene::GetUndoStackMemorySize()
+{
+  // Bulk data still used by nodes of the scene is not retained by the stacks
+  std::set<vtkDataObject*> countedBulkData;
+  vtkMRMLNode *node;
+  vtkCollectionSimpleIterator it;
+  for (this->Nodes->InitTraversal(it);
+       (node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject(it)) ;)
     {
-    curIter = currentMap.find(iter->first);
-    if ( curIter == currentMap.end() )
-      {
-      // the node was deleted, add Node back to the curreent scene
-      addNodes.push_back(iter->second);
-      }
-    else if (iter->second != curIter->second)
+    vtkDataObject* data = GetNodeBulkData(node);
+    if (data)
       {
-      // nodes differ, copy from redo to current scene
-      // but before create a copy in undo stack from current
-      this->CopyNodeInUndoStack(curIter->second);
-      curIter->second->CopyWithSceneWithSingleModifiedEvent(iter->second);
+      countedBulkData.insert(data);
       }
     }
-
-  // remove new nodes created before Undo
-  std::vector<vtkMRMLNode*> removeNodes;
-  for(curIter=currentMap.begin(); curIter != currentMap.end(); curIter++)
+  unsigned long memorySize = 0;
+  std::list< vtkUndoState* >* stacks[2] = { &this->UndoStack, &this->RedoStack };
+  for (int stackIndex = 0; stackIndex < 2; ++stackIndex)
     {
-    iter = undoMap.find(curIter->first);
-    if ( iter == undoMap.end() )
+    for (std::list< vtkUndoState* >::iterator stateIt = stacks[stackIndex]->begin();
+         stateIt != stacks[stackIndex]->end(); ++stateIt)
       {
-      removeNodes.push_back(curIter->second);
+      memorySize += (*stateIt)->CountBulkDataMemorySize(countedBulkData);
       }
     }
+  return memorySize;
+}
 
-  for (nn=0; nn<addNodes.size(); nn++)
+//------------------------------------------------------------------------------
+void vtkMRMLScene::TrimUndoStack()
+{
+  if (this->MaximumUndoMemorySize == 0)
     {
-    this->AddNode(addNodes[nn]);
+    return;
     }
-  for (nn=0; nn<removeNodes.size(); nn++)
+  if (this->UndoStack.size() < 2)
     {
-    this->RemoveNode(removeNodes[nn]);
+    // Always keep the most recent state
+    return;
     }
 
-  if (undoScene)
+  // Bulk data that is retained anyway by the scene or by the redo stack.
+  // Only bulk data of the redo stack is counted in the memory size.
+  std::set<vtkDataObject*> countedBulkData;
+  vtkMRMLNode *node;
+  vtkCollectionSimpleIterator it;
+  for (this->Nodes->InitTraversal(it);
+       (node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject(it)) ;)
     {
-    undoScene->RemoveAllItems();
-    undoScene->Delete();
+    vtkDataObject* data = GetNodeBulkData(node);
+    if (data)
+      {
+      countedBulkData.insert(data);
+      }
+    }
+  unsigned long memorySize = 0;
+  std::list< vtkUndoState* >::iterator stateIt;
+  for (stateIt = this->RedoStack.begin(); stateIt != this->RedoStack.end(); ++stateIt)
+    {
+    memorySize += (*stateIt)->CountBulkDataMemorySize(countedBulkData);
     }
 
-  RedoStack.pop_back();
-
-  this->Modified();
-}
-
-//------------------------------------------------------------------------------
-void vtkMRMLScene::ClearUndoStack()
-{
-  std::list< vtkCollection* >::iterator iter;
-  for(iter=this->UndoStack.begin(); iter != this->UndoStack.end(); iter++)
+  // Add undo states from the most recent one and stop at the first state that
+  // does not fit, so the memory size is computed only once.
+  std::list< vtkUndoState* >::iterator firstKeptStateIt = this->UndoStack.end();
+  for (stateIt = this->UndoStack.end(); stateIt != this->UndoStack.begin(); )
     {
-    (*iter)->RemoveAllItems();
-    (*iter)->Delete();
+    --stateIt;
+    memorySize += (*stateIt)->CountBulkDataMemorySize(countedBulkData);
+    if (memorySize > this->MaximumUndoMemorySize && firstKeptStateIt != this->UndoStack.end())
+      {
+      break;
+      }
+    firstKeptStateIt = stateIt;
     }
-  this->UndoStack.clear();
-}
 
-//------------------------------------------------------------------------------
-void vtkMRMLScene::ClearRedoStack()
-{
-  std::list< vtkCollection* >::iterator iter;
-  for(iter=this->RedoStack.begin(); iter != this->RedoStack.end(); iter++)
+  // Remove all the older states at once
+  for (stateIt = this->UndoStack.begin(); stateIt != firstKeptStateIt; ++stateIt)
     {
-    (*iter)->RemoveAllItems();
-    (*iter)->Delete();
+    delete *stateIt;
     }
-  this->RedoStack.clear();
+  this->UndoStack.erase(this->UndoStack.begin(), firstKeptStateIt);
 }
 
 //------------------------------------------------------------------------------
@@ -3111,6 +3321,88 @@ void vtkMRMLScene::ClearNodeIDs()
   }
 }
 
+//-----------------------------------------------------------------------------
+const std::vector<vtkMRMLNode*>& vtkMRMLScene::GetNodesByClassCached(const char* className)
+{
+  if (this->Nodes->GetMTime() > this->NodesByClassMTime)
+    {
+    // The collection has been modified without going through AddNodeNoNotify()
+    // or RemoveNode() (e.g. InsertAfterNode()), the lists are rebuilt on demand.
+    this->ClearNodesByClass();
+    }
+  std::map< std::string, std::vector<vtkMRMLNode*> >::iterator classIt =
+    this->NodesByClass.find(className);
+  if (classIt != this->NodesByClass.end())
+    {
+    return classIt->second;
+    }
+  std::vector<vtkMRMLNode*>& classNodes = this->NodesByClass[className];
+  vtkMRMLNode *node;
+  vtkCollectionSimpleIterator it;
+  for (this->Nodes->InitTraversal(it);
+       (node = (vtkMRMLNode*)this->Nodes->GetNextItemAsObject(it)) ;)
+    {
+    if (node->IsA(className))
+      {
+      classNodes.push_back(node);
+      }
+    }
+  return classNodes;
+}
+
+//-----------------------------------------------------------------------------
+void vtkMRMLScene::AddNodeByClass(vtkMRMLNode *node)
+{
+  if (!this->Nodes || !node)
+    {
+    return;
+    }
+  for (std::map< std::string, std::vector<vtkMRMLNode*> >::iterator classIt =
+       this->NodesByClass.begin(); classIt != this->NodesByClass.end(); ++classIt)
+    {
+    if (node->IsA(classIt->first.c_str()))
+      {
+      classIt->second.push_back(node);
+      }
+    }
+  this->NodesByClassMTime = this->Nodes->GetMTime();
+}
+
+//-----------------------------------------------------------------------------
+void vtkMRMLScene::RemoveNodeByClass(vtkMRMLNode *node)
+{
+  if (!this->Nodes || !node)
+    {
+    return;
+    }
+  for (std::map< std::string, std::vector<vtkMRMLNode*> >::iterator classIt =
+       this->NodesByClass.begin(); classIt != this->NodesByClass.end(); ++classIt)
+    {
+    if (!node->IsA(classIt->first.c_str()))
+      {
+      continue;
+      }
+    std::vector<vtkMRMLNode*>& classNodes = classIt->second;
+    std::vector<vtkMRMLNode*>::iterator nodeIt =
+      std::find(classNodes.begin(), classNodes.end(), node);
+    if (nodeIt != classNodes.end())
+      {
+      classNodes.erase(nodeIt);
+      }
+    }
+  this->NodesByClassMTime = this->Nodes->GetMTime();
+}
+
+//-----------------------------------------------------------------------------
+void vtkMRMLScene::ClearNodesByClass()
+{
+  if (this->Nodes)
+    {
+    this->NodesByClass.clear();
+    this->NodesByClassMTime = this->Nodes->GetMTime();
+    }
+}
+
 //------------------------------------------------------------------------------
 void vtkMRMLScene::AddURIHandler(vtkURIHandler *handler)
 {
@@ -43,6 +43,7 @@ class vtkGeneralTransform;
 class vtkURIHandler;
 class vtkMRMLNode;
 class vtkMRMLSceneViewNode;
+class vtkMRMLStorageNode;
 
 /// \brief A set of MRML Nodes that supports serialization and undo/redo.
 ///
@@ -343,6 +344,27 @@ public:
   /// returns number of redo steps in the history buffer
   int GetNumberOfRedoLevels() { return (int)this->RedoStack.size();};
 
+  /// \brief Maximum amount of memory (in kiB) that the undo and redo stacks
+  /// can retain.
+  ///
+  /// Undo states only store copies of the nodes that were saved or removed
+  /// since the state was saved (node copies are shared between states until
+  /// the node is modified) and the list of nodes added since the state was
+  /// saved. Bulk data (image data, meshes, tables) is shared by reference
+  /// with the nodes in the scene: it only costs memory when no node in the
+  /// scene uses it anymore, e.g. when the node was removed. Bulk data must
+  /// be replaced, not modified in place, for undo to restore it. When the
+  /// retained bulk data exceeds this limit, oldest undo states are discarded
+  /// the next time a state is saved. 0 (default) means no limit.
+  /// \sa GetUndoStackMemorySize()
+  vtkSetMacro(MaximumUndoMemorySize, unsigned long);
+  vtkGetMacro(MaximumUndoMemorySize, unsigned long);
+
+  /// \brief Return the amount of memory (in kiB) of the bulk data that is
+  /// only retained by the undo and redo stacks.
+  /// \sa SetMaximumUndoMemorySize()
+  unsigned long GetUndoStackMemorySize();
+
   /// Save current state in the undo buffer
   void SaveStateForUndo();
 
@@ -457,6 +479,25 @@ public:
   vtkSetMacro(ReadDataOnLoad,int);
   vtkGetMacro(ReadDataOnLoad,int);
 
+  /// \brief Number of threads that read the files of the storable nodes in Import().
+  ///
+  /// The files of the storage nodes that can read data in a thread are read
+  /// in parallel after all the imported nodes are updated, then the data
+  /// is set in the nodes in the main thread.
+  /// If 1, the files are read one after the other in the main thread.
+  /// Default is the number of cores.
+  /// \sa vtkMRMLStorageNode::CanReadDataInThread(), ScheduleReadData()
+  vtkSetClampMacro(NumberOfReadDataThreads, int, 1, VTK_INT_MAX);
+  vtkGetMacro(NumberOfReadDataThreads, int);
+
+  /// \brief Read the data of \a refNode after all the imported nodes are updated.
+  ///
+  /// Called by the storable nodes in UpdateScene() during Import().
+  /// Returns false if the data cannot be read in a thread and must be read
+  /// immediately.
+  /// \sa SetNumberOfReadDataThreads()
+  bool ScheduleReadData(vtkMRMLStorageNode* storageNode, vtkMRMLNode* refNode);
+
   void SetErrorMessage(const std::string &error);
   std::string GetErrorMessage();
 
@@ -693,12 +734,34 @@ protected:
   vtkMRMLScene();
   virtual ~vtkMRMLScene();
 
+  class vtkUndoState;
+
   void PushIntoUndoStack();
   void PushIntoRedoStack();
 
   void CopyNodeInUndoStack(vtkMRMLNode *node);
   void CopyNodeInRedoStack(vtkMRMLNode *node);
 
+  /// \brief Make a copy of the node to be stored in \a state.
+  /// If the node has not been modified since it was last copied into
+  /// \a stack, the existing copy is shared instead of making a new one.
+  void CopyNodeInState(vtkMRMLNode *node, vtkUndoState* state,
+                       std::list< vtkUndoState* >& stack);
+
+  /// \brief Restore the scene to \a state.
+  /// Changes that are reverted are stored in \a inverseState so that they
+  /// can be reapplied.
+  void RestoreState(vtkUndoState* state, vtkUndoState* inverseState);
+
+  /// Record in the top undo state that a node has been added to the scene.
+  void SaveNodeAddedForUndo(vtkMRMLNode *node);
+  /// Record in the top undo state that a node has been removed from the scene.
+  void SaveNodeRemovedForUndo(vtkMRMLNode *node);
+
+  /// Discard the oldest undo states until the undo memory fits in
+  /// MaximumUndoMemorySize.
+  void TrimUndoStack();
+
   /// Add a node to the scene without invoking a vtkMRMLScene::NodeAddedEvent event.
   ///
   /// \warning Use with extreme caution as it might unsynchronize observer.
@@ -741,6 +804,27 @@ protected:
   /// Clear NodeIDs map used to speedup GetByID() method.
   void ClearNodeIDs();
 
+  /// \brief Return the nodes of the scene that are of class \a className
+  /// (or a subclass), in the order of the \a Nodes collection.
+  ///
+  /// The list of nodes of a given class is computed the first time it is
+  /// requested and is then kept up to date by AddNodeNoNotify() and
+  /// RemoveNode(), so that GetNodesByClass(), GetNumberOfNodesByClass() and
+  /// GetNthNodeByClass() cost proportionally to the number of matching nodes
+  /// instead of the number of nodes in the scene.
+  /// \sa NodesByClass, ClearNodesByClass()
+  const std::vector<vtkMRMLNode*>& GetNodesByClassCached(const char* className);
+
+  /// Append node to all the lists of \a NodesByClass it belongs to.
+  /// Must be called only when the node is added at the end of \a Nodes.
+  void AddNodeByClass(vtkMRMLNode *node);
+
+  /// Remove node from all the lists of \a NodesByClass it belongs to.
+  void RemoveNodeByClass(vtkMRMLNode *node);
+
+  /// Clear NodesByClass map used to speedup GetNodesByClass() methods.
+  void ClearNodesByClass();
+
   /// Get a NodeReferences iterator for a node reference.
   NodeReferencesType::iterator FindNodeReference(const char* referencedId, vtkMRMLNode* referencingNode);
 
@@ -759,8 +843,10 @@ protected:
   bool UndoFlag;
   bool InUndo;
 
-  std::list< vtkCollection* >  UndoStack;
-  std::list< vtkCollection* >  RedoStack;
+  unsigned long MaximumUndoMemorySize;
+
+  std::list< vtkUndoState* >  UndoStack;
+  std::list< vtkUndoState* >  RedoStack;
 
   std::string                 URL;
   std::string                 RootDirectory;
@@ -775,6 +861,10 @@ protected:
   NodeReferencesType NodeReferences; // ReferencedIDs (string), ReferencingNodes (node pointer)
   std::map< std::string, std::string > ReferencedIDChanges;
   std::map< std::string, vtkSmartPointer<vtkMRMLNode> > NodeIDs;
+  /// Nodes of the scene indexed by the class names that have been queried
+  /// so far. Each list contains the nodes that are of the class (or of a
+  /// subclass) in the same order as \a Nodes.
+  std::map< std::string, std::vector<vtkMRMLNode*> > NodesByClass;
 
   // Stores default nodes. If a class is created or reset (using CreateNodeByClass or Clear) and
   // a default node is defined for it then the content of the default node will be used to initialize
@@ -791,7 +881,20 @@ protected:
 
   int ReadDataOnLoad;
 
+  int NumberOfReadDataThreads;
+
+  /// Read the data scheduled by ScheduleReadData() in parallel threads,
+  /// then set it in the nodes.
+  void ReadScheduledData();
+
+  /// True while ScheduleReadData() accepts nodes
+  bool ReadDataScheduling;
+  /// Storage nodes and nodes that the storage nodes read into
+  std::vector< std::pair< vtkSmartPointer<vtkMRMLStorageNode>,
+                          vtkSmartPointer<vtkMRMLNode> > > ScheduledReadData;
+
   vtkMTimeType  NodeIDsMTime;
+  vtkMTimeType  NodesByClassMTime;
 
   void RemoveAllNodes(bool removeSingletons);
 
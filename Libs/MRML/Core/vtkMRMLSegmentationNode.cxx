@@ -581,8 +581,22 @@ bool vtkMRMLSegmentationNode::GenerateMergedLabelmap(
     return true;
     }
 
-  // Create merged labelmap
+  // Segments stored in the same shared labelmap are painted together, in a single pass over the shared labelmap
+  std::map<vtkOrientedImageData*, std::map<int, int> > sharedLabelmapColorIndices;
   short colorIndex = backgroundColorIndex + 1;
+  for (std::vector<std::string>::iterator segmentIdIt = mergedSegmentIDs.begin(); segmentIdIt != mergedSegmentIDs.end(); ++segmentIdIt, ++colorIndex)
+    {
+    vtkSegment* currentSegment = this->Segmentation->GetSegment(*segmentIdIt);
+    if (currentSegment && (currentSegment->GetLabelValue() != 1 || this->Segmentation->IsSharedBinaryLabelmap(*segmentIdIt)))
+      {
+      vtkOrientedImageData* sharedLabelmap = vtkOrientedImageData::SafeDownCast(
+        currentSegment->GetRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()) );
+      sharedLabelmapColorIndices[sharedLabelmap][currentSegment->GetLabelValue()] = colorIndex;
+      }
+    }
+
+  // Create merged labelmap
+  colorIndex = backgroundColorIndex + 1;
   for (std::vector<std::string>::iterator segmentIdIt = mergedSegmentIDs.begin(); segmentIdIt != mergedSegmentIDs.end(); ++segmentIdIt, ++colorIndex)
     {
     std::string currentSegmentId = *segmentIdIt;
@@ -602,6 +616,14 @@ bool vtkMRMLSegmentationNode::GenerateMergedLabelmap(
       continue;
       }
 
+    // Shared labelmap is painted when its first segment is found, other segments in it are skipped
+    bool sharedLabelmap = (sharedLabelmapColorIndices.find(representationBinaryLabelmap) != sharedLabelmapColorIndices.end());
+    bool sharedLabelmapAlreadyPainted = (sharedLabelmap && sharedLabelmapColorIndices[representationBinaryLabelmap].empty());
+    if (sharedLabelmapAlreadyPainted)
+      {
+      continue;
+      }
+
     // Set oriented image data used for merging to the representation (may change later if resampling is needed)
     vtkOrientedImageData* binaryLabelmap = representationBinaryLabelmap;
 
@@ -621,6 +643,14 @@ bool vtkMRMLSegmentationNode::GenerateMergedLabelmap(
       binaryLabelmap = resampledBinaryLabelmap;
       }
 
+    if (sharedLabelmap)
+      {
+      // Copy voxels of all the segments in the shared labelmap with their color index
+      vtkOrientedImageDataResample::PaintLabels(mergedImageData, binaryLabelmap, sharedLabelmapColorIndices[representationBinaryLabelmap]);
+      sharedLabelmapColorIndices[representationBinaryLabelmap].clear();
+      continue;
+      }
+
     // Copy image data voxels into merged labelmap with the proper color index
     vtkOrientedImageDataResample::ModifyImage(
           mergedImageData,
@@ -826,6 +856,12 @@ vtkOrientedImageData* vtkMRMLSegmentationNode::GetBinaryLabelmapRepresentation(c
     vtkErrorMacro("GetBinaryLabelmapRepresentation: Invalid segment");
     return NULL;
     }
+  // The returned labelmap may be modified, so it must contain only this segment
+  if (!this->Segmentation->SeparateSegmentLabelmap(segmentId))
+    {
+    vtkErrorMacro("GetBinaryLabelmapRepresentation: Failed to separate segment " << segmentId << " from its shared labelmap");
+    return NULL;
+    }
   return vtkOrientedImageData::SafeDownCast(segment->GetRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
 }
 
@@ -171,6 +171,8 @@ public:
   /// If representation does not exist yet then call CreateBinaryLabelmapRepresentation() before.
   /// If binary labelmap is the master representation then the returned object can be modified, and
   /// all other representations will be automatically updated.
+  /// If the segment is stored in a shared labelmap then it is given its own labelmap first
+  /// (\sa vtkSegmentation::SeparateSegmentLabelmap).
   virtual vtkOrientedImageData* GetBinaryLabelmapRepresentation(const std::string segmentId);
 
   /// Generate closed surface representation for all segments.
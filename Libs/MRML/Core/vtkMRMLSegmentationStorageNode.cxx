@@ -1055,6 +1055,16 @@ int vtkMRMLSegmentationStorageNode::WriteBinaryLabelmapRepresentation(vtkMRMLSeg
       vtkErrorMacro("WriteBinaryLabelmapRepresentation: Failed to retrieve master representation from segment " << currentSegmentID);
       continue;
       }
+    if (currentSegment->GetLabelValue() != 1 || segmentation->IsSharedBinaryLabelmap(currentSegmentID))
+      {
+      // Shared labelmap contains other segments as well, only write the voxels of this segment
+      currentBinaryLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+      if (!segmentation->GetSegmentBinaryLabelmap(currentSegmentID, currentBinaryLabelmap))
+        {
+        vtkErrorMacro("WriteBinaryLabelmapRepresentation: Failed to extract segment " << currentSegmentID << " from shared labelmap");
+        continue;
+        }
+      }
 
     int currentBinaryLabelmapExtent[6] = { 0, -1, 0, -1, 0, -1 };
     currentBinaryLabelmap->GetExtent(currentBinaryLabelmapExtent);
@@ -294,6 +294,11 @@ void vtkMRMLStorableNode::UpdateScene(vtkMRMLScene *scene)
         {
         fname = std::string(pnode->GetURI());
         }
+      if (scene->ScheduleReadData(pnode, this))
+        {
+        vtkDebugMacro("UpdateScene: scheduled reading in a thread, fname = " << fname.c_str());
+        continue;
+        }
       vtkDebugMacro("UpdateScene: calling ReadData, fname = " << fname.c_str());
       if (pnode->ReadData(this) == 0)
         {
@@ -48,6 +48,7 @@ vtkMRMLStorageNode::vtkMRMLStorageNode()
   this->UseCompression = 1;
   this->ReadState = this->Idle;
   this->WriteState = this->Idle;
+  this->ReadingInThread = false;
   this->URIHandler = NULL;
   this->FileNameList.clear();
   this->URIList.clear();
@@ -384,7 +385,7 @@ void vtkMRMLStorageNode::PrintSelf(ostream& os, vtkIndent indent)
 //----------------------------------------------------------------------------
 void vtkMRMLStorageNode::ProcessMRMLEvents ( vtkObject *vtkNotUsed(caller), unsigned long event, void *callData )
 {
-  if (event ==  vtkCommand::ProgressEvent)
+  if (event ==  vtkCommand::ProgressEvent && !this->ReadingInThread)
     {
     this->InvokeEvent ( vtkCommand::ProgressEvent,callData );
     }
@@ -1142,33 +1143,54 @@ bool vtkMRMLStorageNode::CanWriteFromReferenceNode(vtkMRMLNode *refNode)
 
 //------------------------------------------------------------------------------
 int vtkMRMLStorageNode::ReadData(vtkMRMLNode* refNode, bool temporary)
+{
+  if (!this->StartReadData(refNode))
+    {
+    return 0;
+    }
+  int res = this->ReadDataInternal(refNode);
+  if (res)
+    {
+    this->ReadDataFinished(refNode, temporary);
+    }
+  return res;
+}
+
+//------------------------------------------------------------------------------
+bool vtkMRMLStorageNode::CanReadDataInThread(vtkMRMLNode* vtkNotUsed(refNode))
+{
+  return false;
+}
+
+//------------------------------------------------------------------------------
+bool vtkMRMLStorageNode::StartReadData(vtkMRMLNode* refNode)
 {
   if (refNode == NULL)
     {
     vtkErrorMacro("ReadData: can't read into a null node");
-    return 0;
+    return false;
     }
 
   if ( !this->CanReadInReferenceNode(refNode) )
     {
-    return 0;
+    return false;
     }
 
   // do not read if if we are not in the scene (for example inside snapshot)
   if ( !refNode->GetAddToScene() )
     {
-    return 0;
+    return false;
     }
 
   if (this->GetScene() && this->GetScene()->GetReadDataOnLoad() == 0)
     {
-    return 0;
+    return false;
     }
 
   if (this->GetFileName() == NULL && this->GetURI() == NULL)
     {
     vtkErrorMacro("ReadData: both filename and uri are null.");
-    return 0;
+    return false;
     }
 
   this->StageReadData(refNode);
@@ -1176,52 +1198,103 @@ int vtkMRMLStorageNode::ReadData(vtkMRMLNode* refNode, bool temporary)
     {
     // remote file download hasn't finished
     vtkWarningMacro("ReadData: read state is pending, remote download hasn't finished yet");
-    return 0;
+    return false;
     }
   vtkDebugMacro("ReadData: read state is ready, "
     <<  "URI = " << (this->GetURI() == NULL ? "null" : this->GetURI()) << ", "
     << "filename = " << (this->GetFileName() == NULL ? "null" : this->GetFileName()));
-  int res = this->ReadDataInternal(refNode);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+int vtkMRMLStorageNode::ReadDataInThread(vtkMRMLNode* refNode)
+{
+  this->ReadingInThread = true;
+  int res = this->ReadDataInThreadInternal(refNode);
+  this->ReadingInThread = false;
+  return res;
+}
+
+//------------------------------------------------------------------------------
+int vtkMRMLStorageNode::EndReadData(vtkMRMLNode* refNode, int readResult, bool temporary)
+{
+  if (!readResult)
+    {
+    return 0;
+    }
+  int res = this->ApplyReadDataInternal(refNode);
   if (res)
     {
-    vtkMRMLStorableNode* storableNode = vtkMRMLStorableNode::SafeDownCast(refNode);
-    if (storableNode)
-      {
-      storableNode->SetAndObserveStorageNodeID(this->GetID());
-      }
-    this->SetReadStateIdle();
-    if (!temporary)
-      {
-      this->StoredTime->Modified();
-      }
+    this->ReadDataFinished(refNode, temporary);
     }
   return res;
 }
 
+//------------------------------------------------------------------------------
+void vtkMRMLStorageNode::ReadDataFinished(vtkMRMLNode* refNode, bool temporary)
+{
+  vtkMRMLStorableNode* storableNode = vtkMRMLStorableNode::SafeDownCast(refNode);
+  if (storableNode)
+    {
+    storableNode->SetAndObserveStorageNodeID(this->GetID());
+    }
+  this->SetReadStateIdle();
+  if (!temporary)
+    {
+    this->StoredTime->Modified();
+    }
+}
+
 //------------------------------------------------------------------------------
 int vtkMRMLStorageNode::WriteData(vtkMRMLNode* refNode)
+{
+  if (!this->StartWriteData(refNode))
+    {
+    return 0;
+    }
+  return this->EndWriteData(refNode, this->WriteDataInThread(refNode));
+}
+
+//------------------------------------------------------------------------------
+bool vtkMRMLStorageNode::CanWriteDataInThread(vtkMRMLNode* vtkNotUsed(refNode))
+{
+  return false;
+}
+
+//------------------------------------------------------------------------------
+bool vtkMRMLStorageNode::StartWriteData(vtkMRMLNode* refNode)
 {
   if (refNode == NULL)
     {
     vtkErrorMacro("WriteData: can't write, input node is null");
-    return 0;
+    return false;
     }
 
   // test whether refNode is a valid node to hold a volume
   if (!this->CanWriteFromReferenceNode(refNode) )
     {
-    return 0;
+    return false;
     }
 
-  int res = this->WriteDataInternal(refNode);
+  return this->PrepareWriteDataInternal(refNode) != 0;
+}
 
-  if (res)
+//------------------------------------------------------------------------------
+int vtkMRMLStorageNode::WriteDataInThread(vtkMRMLNode* refNode)
+{
+  return this->WriteDataInternal(refNode);
+}
+
+//------------------------------------------------------------------------------
+int vtkMRMLStorageNode::EndWriteData(vtkMRMLNode* refNode, int writeResult)
+{
+  writeResult = this->ApplyWriteDataInternal(refNode, writeResult);
+  if (writeResult)
     {
     this->StageWriteData(refNode);
     this->StoredTime->Modified();
     }
-
-  return res;
+  return writeResult;
 }
 
 //------------------------------------------------------------------------------
@@ -1230,12 +1303,36 @@ int vtkMRMLStorageNode::ReadDataInternal(vtkMRMLNode* vtkNotUsed(refNode))
   return 0;
 }
 
+//------------------------------------------------------------------------------
+int vtkMRMLStorageNode::ReadDataInThreadInternal(vtkMRMLNode* vtkNotUsed(refNode))
+{
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+int vtkMRMLStorageNode::ApplyReadDataInternal(vtkMRMLNode* vtkNotUsed(refNode))
+{
+  return 0;
+}
+
 //------------------------------------------------------------------------------
 int vtkMRMLStorageNode::WriteDataInternal(vtkMRMLNode* vtkNotUsed(refNode))
 {
   return 0;
 }
 
+//------------------------------------------------------------------------------
+int vtkMRMLStorageNode::PrepareWriteDataInternal(vtkMRMLNode* vtkNotUsed(refNode))
+{
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+int vtkMRMLStorageNode::ApplyWriteDataInternal(vtkMRMLNode* vtkNotUsed(refNode), int writeResult)
+{
+  return writeResult;
+}
+
 //------------------------------------------------------------------------------
 std::string vtkMRMLStorageNode::GetLowercaseExtensionFromFileName(const std::string& filename)
 {
@@ -51,12 +51,52 @@ public:
   /// \sa SetFileName(), ReadDataInternal(), GetStoredTime()
   virtual int ReadData(vtkMRMLNode *refNode, bool temporaryFile = false);
 
+  ///
+  /// Return true if the data of \a refNode can be read by ReadDataInThread().
+  /// Returns false by default.
+  /// \sa ReadDataInThread(), vtkMRMLScene::SetNumberOfReadDataThreads()
+  virtual bool CanReadDataInThread(vtkMRMLNode* refNode);
+
+  ///
+  /// Steps of ReadData() that allow reading the file in a background thread:
+  /// StartReadData() checks that the data can be read and must be called
+  /// from the main thread. It returns false if there is nothing to read.
+  /// ReadDataInThread() reads the file without modifying the reference node
+  /// or the scene, it can be called from any thread.
+  /// EndReadData() sets the read data in the reference node, it must be
+  /// called from the main thread. It returns 1 on success, 0 on failure.
+  /// \sa CanReadDataInThread(), ReadData()
+  bool StartReadData(vtkMRMLNode* refNode);
+  int ReadDataInThread(vtkMRMLNode* refNode);
+  int EndReadData(vtkMRMLNode* refNode, int readResult, bool temporaryFile = false);
+
   ///
   /// Write data from a  referenced node
   /// Return 1 on success, 0 on failure.
   /// NOTE: Subclasses should implement this method
   virtual int WriteData(vtkMRMLNode *refNode);
 
+  ///
+  /// Return true if the data of \a refNode can be written by WriteDataInThread().
+  /// Returns false by default.
+  /// \sa WriteDataInThread()
+  virtual bool CanWriteDataInThread(vtkMRMLNode* refNode);
+
+  ///
+  /// Steps of WriteData() that allow writing the file in a background thread:
+  /// StartWriteData() checks the node and gets what the writing needs from
+  /// the node and the scene, it must be called from the main thread. It
+  /// returns false if the data cannot be written.
+  /// WriteDataInThread() writes the file without modifying the reference node
+  /// or the scene, it can be called from any thread while the main thread
+  /// does not modify the node. EndWriteData() must be called from the main
+  /// thread with the result of WriteDataInThread(), it updates the storage
+  /// node (e.g. its file list) and returns 1 on success, 0 on failure.
+  /// \sa CanWriteDataInThread(), WriteData()
+  bool StartWriteData(vtkMRMLNode* refNode);
+  int WriteDataInThread(vtkMRMLNode* refNode);
+  int EndWriteData(vtkMRMLNode* refNode, int writeResult);
+
   ///
   /// Write this node's information to a MRML file in XML format.
   virtual void WriteXML(ostream& of, int indent) VTK_OVERRIDE;
@@ -313,11 +353,35 @@ protected:
   /// To be reimplemented in subclass.
   virtual int ReadDataInternal(vtkMRMLNode* refNode);
 
+  /// Reads the file into the storage node, without modifying \a refNode,
+  /// so that ApplyReadDataInternal() can set the data in \a refNode.
+  /// Returns 1 on success, 0 otherwise.
+  /// To be reimplemented in subclasses that can read data in a thread.
+  /// \sa CanReadDataInThread()
+  virtual int ReadDataInThreadInternal(vtkMRMLNode* refNode);
+
+  /// Sets the data read by ReadDataInThreadInternal() in \a refNode.
+  /// Returns 1 on success, 0 otherwise.
+  virtual int ApplyReadDataInternal(vtkMRMLNode* refNode);
+
+  /// Updates the storage node after the data is read into \a refNode
+  void ReadDataFinished(vtkMRMLNode* refNode, bool temporaryFile);
+
   /// Does the actual writing. Returns 1 on success, 0 otherwise.
   /// Returns 0 by default (write not supported).
   /// To be reimplemented in subclass.
+  /// It is called from a background thread if CanWriteDataInThread() is true.
   virtual int WriteDataInternal(vtkMRMLNode* refNode);
 
+  /// Gets what WriteDataInternal() needs from \a refNode and the scene.
+  /// Called from the main thread. Returns 1 on success, 0 otherwise.
+  /// Does nothing and returns 1 by default.
+  virtual int PrepareWriteDataInternal(vtkMRMLNode* refNode);
+
+  /// Updates the storage node after WriteDataInternal(), with its
+  /// result. Called from the main thread. Returns the write result by default.
+  virtual int ApplyWriteDataInternal(vtkMRMLNode* refNode, int writeResult);
+
   ///
   /// If the URI is not null, fetch it and save it to the node's FileName location or
   /// load directly into the reference node.
@@ -335,6 +399,8 @@ protected:
   int UseCompression;
   int ReadState;
   int WriteState;
+  /// Progress events are not propagated while reading in a thread
+  bool ReadingInThread;
 
   ///
   /// An array of file names, should contain the FileName but may not
@@ -35,10 +35,12 @@ Version:   $Revision: 1.14 $
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkPoints.h>
+#include <vtkSmartPointer.h>
 #include <vtkThinPlateSplineTransform.h>
 #include <vtkTransform.h>
 
 // STD includes
+#include <cmath>
 #include <sstream>
 #include <stack>
 
@@ -54,6 +56,18 @@ vtkMRMLTransformNode::vtkMRMLTransformNode()
 
   this->CachedMatrixTransformToParent=vtkMatrix4x4::New();
   this->CachedMatrixTransformFromParent=vtkMatrix4x4::New();
+
+  this->BakeTransform = false;
+  for (int i = 0; i < 3; ++i)
+    {
+    this->BakedTransformBounds[2 * i] = 0.0;
+    this->BakedTransformBounds[2 * i + 1] = -1.0;
+    this->BakedTransformSpacing[i] = 1.0;
+    }
+  this->BakedTransformToWorld = NULL;
+  this->BakedTransformFromWorld = NULL;
+  this->BakedTransformToWorldTime = 0;
+  this->BakedTransformFromWorldTime = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -66,12 +80,26 @@ vtkMRMLTransformNode::~vtkMRMLTransformNode()
   this->CachedMatrixTransformToParent=NULL;
   this->CachedMatrixTransformFromParent->Delete();
   this->CachedMatrixTransformFromParent=NULL;
+
+  this->InvalidateBakedTransforms();
 }
 
 //----------------------------------------------------------------------------
 void vtkMRMLTransformNode::WriteXML(ostream& of, int nIndent)
 {
   Superclass::WriteXML(of, nIndent);
+
+  of << " bakeTransform=\"" << (this->BakeTransform ? "true" : "false") << "\"";
+  of << " bakedTransformBounds=\"" << this->BakedTransformBounds[0];
+  for (int i = 1; i < 6; ++i)
+    {
+    of << " " << this->BakedTransformBounds[i];
+    }
+  of << "\"";
+  of << " bakedTransformSpacing=\"" <<
+        this->BakedTransformSpacing[0] << " " <<
+        this->BakedTransformSpacing[1] << " " <<
+        this->BakedTransformSpacing[2] << "\"";
 }
 
 //----------------------------------------------------------------------------
@@ -100,9 +128,32 @@ void vtkMRMLTransformNode::ReadXMLAttributes(const char** atts)
         this->ReadAsTransformToParent = 0;
         }
       }
-
+    else if (!strcmp(attName, "bakeTransform"))
+      {
+      this->BakeTransform = (strcmp(attValue, "true") == 0);
+      }
+    else if (!strcmp(attName, "bakedTransformBounds"))
+      {
+      std::stringstream ss;
+      ss << attValue;
+      for (int i = 0; i < 6; ++i)
+        {
+        ss >> this->BakedTransformBounds[i];
+        }
+      }
+    else if (!strcmp(attName, "bakedTransformSpacing"))
+      {
+      std::stringstream ss;
+      ss << attValue;
+      for (int i = 0; i < 3; ++i)
+        {
+        ss >> this->BakedTransformSpacing[i];
+        }
+      }
     }
 
+  this->InvalidateBakedTransforms();
+
   this->EndModify(disabledModify);
 }
 
@@ -149,6 +200,30 @@ void vtkMRMLTransformNode::FlattenGeneralTransform(vtkCollection* outputTransfor
     }
 }
 
+//---------------------------------------------------------------------------
+void vtkMRMLTransformNode::TransformPointsByComponents(vtkAbstractTransform* transform,
+  vtkPoints* inputPoints, vtkPoints* outputPoints)
+{
+  vtkNew<vtkCollection> transformList;
+  vtkMRMLTransformNode::FlattenGeneralTransform(transformList.GetPointer(), transform);
+  vtkSmartPointer<vtkPoints> points = inputPoints;
+  // Components are listed in the order they are concatenated (in PreMultiply mode),
+  // therefore the last component is applied first.
+  for (int transformIndex = transformList->GetNumberOfItems() - 1; transformIndex >= 0; --transformIndex)
+    {
+    vtkAbstractTransform* component = vtkAbstractTransform::SafeDownCast(transformList->GetItemAsObject(transformIndex));
+    if (!component)
+      {
+      continue;
+      }
+    vtkSmartPointer<vtkPoints> transformedPoints = vtkSmartPointer<vtkPoints>::New();
+    transformedPoints->SetDataTypeToDouble();
+    component->TransformPoints(points, transformedPoints);
+    points = transformedPoints;
+    }
+  outputPoints->DeepCopy(points);
+}
+
 //----------------------------------------------------------------------------
 int vtkMRMLTransformNode::DeepCopyTransform(vtkAbstractTransform* dst, vtkAbstractTransform* src)
 {
@@ -269,6 +344,16 @@ void vtkMRMLTransformNode::Copy(vtkMRMLNode *anode)
   Superclass::Copy(anode);
 
   this->SetReadAsTransformToParent(node->GetReadAsTransformToParent());
+  this->BakeTransform = node->BakeTransform;
+  for (int i = 0; i < 6; ++i)
+    {
+    this->BakedTransformBounds[i] = node->BakedTransformBounds[i];
+    }
+  for (int i = 0; i < 3; ++i)
+    {
+    this->BakedTransformSpacing[i] = node->BakedTransformSpacing[i];
+    }
+  this->InvalidateBakedTransforms();
 
   // Unfortunately VTK transform DeepCopy actually performs a shallow copy (only data object
   // pointers are copied, but not the contents itself), so we have to apply our custom DeepCopy
@@ -299,6 +384,15 @@ void vtkMRMLTransformNode::PrintSelf(ostream& os, vtkIndent indent)
 {
   Superclass::PrintSelf(os,indent);
   os << indent << "ReadAsTransformToParent: " << this->ReadAsTransformToParent << "\n";
+  os << indent << "BakeTransform: " << this->BakeTransform << "\n";
+  os << indent << "BakedTransformBounds: " << this->BakedTransformBounds[0];
+  for (int i = 1; i < 6; ++i)
+    {
+    os << " " << this->BakedTransformBounds[i];
+    }
+  os << "\n";
+  os << indent << "BakedTransformSpacing: " << this->BakedTransformSpacing[0]
+     << " " << this->BakedTransformSpacing[1] << " " << this->BakedTransformSpacing[2] << "\n";
 
   // Flatten the transform list to make the copying simpler
   if (this->TransformToParent)
@@ -401,6 +495,228 @@ void vtkMRMLTransformNode::GetTransformFromWorld(vtkGeneralTransform* transformF
   vtkMRMLTransformNode::GetTransformBetweenNodes(NULL, this, transformFromWorld);
 }
 
+//----------------------------------------------------------------------------
+void vtkMRMLTransformNode::GetDisplayTransformToWorld(vtkGeneralTransform* transformToWorld)
+{
+  if (transformToWorld == NULL)
+    {
+    vtkErrorMacro("vtkMRMLTransformNode::GetDisplayTransformToWorld failed: transformToWorld is invalid");
+    return;
+    }
+  vtkOrientedGridTransform* bakedTransform = this->GetBakedTransformToWorld();
+  if (!bakedTransform)
+    {
+    this->GetTransformToWorld(transformToWorld);
+    return;
+    }
+  transformToWorld->Identity();
+  transformToWorld->PostMultiply();
+  transformToWorld->Concatenate(bakedTransform);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLTransformNode::GetDisplayTransformFromWorld(vtkGeneralTransform* transformFromWorld)
+{
+  if (transformFromWorld == NULL)
+    {
+    vtkErrorMacro("vtkMRMLTransformNode::GetDisplayTransformFromWorld failed: transformFromWorld is invalid");
+    return;
+    }
+  vtkOrientedGridTransform* bakedTransform = this->GetBakedTransformFromWorld();
+  if (!bakedTransform)
+    {
+    this->GetTransformFromWorld(transformFromWorld);
+    return;
+    }
+  transformFromWorld->Identity();
+  transformFromWorld->PostMultiply();
+  transformFromWorld->Concatenate(bakedTransform);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLTransformNode::SetBakeTransform(bool bake)
+{
+  if (this->BakeTransform == bake)
+    {
+    return;
+    }
+  this->BakeTransform = bake;
+  this->Modified();
+  // transform to/from world is computed differently
+  this->TransformModified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLTransformNode::SetBakedTransformRegion(const double bounds[6], const double spacing[3])
+{
+  bool modified = false;
+  for (int i = 0; i < 6; ++i)
+    {
+    if (this->BakedTransformBounds[i] != bounds[i])
+      {
+      this->BakedTransformBounds[i] = bounds[i];
+      modified = true;
+      }
+    }
+  for (int i = 0; i < 3; ++i)
+    {
+    if (this->BakedTransformSpacing[i] != spacing[i])
+      {
+      this->BakedTransformSpacing[i] = spacing[i];
+      modified = true;
+      }
+    }
+  if (!modified)
+    {
+    return;
+    }
+  this->Modified();
+  if (this->BakeTransform)
+    {
+    this->TransformModified();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLTransformNode::GetBakedTransformRegion(double bounds[6], double spacing[3])
+{
+  for (int i = 0; i < 6; ++i)
+    {
+    bounds[i] = this->BakedTransformBounds[i];
+    }
+  for (int i = 0; i < 3; ++i)
+    {
+    spacing[i] = this->BakedTransformSpacing[i];
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkOrientedGridTransform* vtkMRMLTransformNode::GetBakedTransformToWorld()
+{
+  if (!this->BakeTransform || this->IsTransformToWorldLinear())
+    {
+    return NULL;
+    }
+  // Modification time is checked as well because modified events may be disabled
+  // while the transforms in the chain are changed.
+  vtkMTimeType transformToWorldMTime = this->GetTransformToWorldMTime();
+  if (this->BakedTransformToWorld && this->BakedTransformToWorldTime >= transformToWorldMTime)
+    {
+    return this->BakedTransformToWorld;
+    }
+  if (this->BakedTransformToWorld)
+    {
+    this->BakedTransformToWorld->Delete();
+    this->BakedTransformToWorld = NULL;
+    }
+  vtkNew<vtkGeneralTransform> transformToWorld;
+  vtkMRMLTransformNode::GetTransformBetweenNodes(this, NULL, transformToWorld.GetPointer());
+  this->BakedTransformToWorld = vtkMRMLTransformNode::CreateBakedTransform(transformToWorld.GetPointer(),
+    this->BakedTransformBounds, this->BakedTransformSpacing);
+  this->BakedTransformToWorldTime = transformToWorldMTime;
+  return this->BakedTransformToWorld;
+}
+
+//----------------------------------------------------------------------------
+vtkOrientedGridTransform* vtkMRMLTransformNode::GetBakedTransformFromWorld()
+{
+  if (!this->BakeTransform || this->IsTransformToWorldLinear())
+    {
+    return NULL;
+    }
+  vtkMTimeType transformToWorldMTime = this->GetTransformToWorldMTime();
+  if (this->BakedTransformFromWorld && this->BakedTransformFromWorldTime >= transformToWorldMTime)
+    {
+    return this->BakedTransformFromWorld;
+    }
+  if (this->BakedTransformFromWorld)
+    {
+    this->BakedTransformFromWorld->Delete();
+    this->BakedTransformFromWorld = NULL;
+    }
+  vtkNew<vtkGeneralTransform> transformFromWorld;
+  vtkMRMLTransformNode::GetTransformBetweenNodes(NULL, this, transformFromWorld.GetPointer());
+  this->BakedTransformFromWorld = vtkMRMLTransformNode::CreateBakedTransform(transformFromWorld.GetPointer(),
+    this->BakedTransformBounds, this->BakedTransformSpacing);
+  this->BakedTransformFromWorldTime = transformToWorldMTime;
+  return this->BakedTransformFromWorld;
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLTransformNode::InvalidateBakedTransforms()
+{
+  if (this->BakedTransformToWorld)
+    {
+    this->BakedTransformToWorld->Delete();
+    this->BakedTransformToWorld = NULL;
+    }
+  if (this->BakedTransformFromWorld)
+    {
+    this->BakedTransformFromWorld->Delete();
+    this->BakedTransformFromWorld = NULL;
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkOrientedGridTransform* vtkMRMLTransformNode::CreateBakedTransform(vtkAbstractTransform* transform,
+  const double bounds[6], const double spacing[3])
+{
+  int dimensions[3] = { 0, 0, 0 };
+  for (int i = 0; i < 3; ++i)
+    {
+    if (spacing[i] <= 0 || bounds[2 * i + 1] < bounds[2 * i])
+      {
+      // empty region
+      return NULL;
+      }
+    dimensions[i] = static_cast<int>(floor((bounds[2 * i + 1] - bounds[2 * i]) / spacing[i])) + 1;
+    }
+
+  vtkNew<vtkImageData> displacementGrid;
+  displacementGrid->SetDimensions(dimensions);
+  displacementGrid->SetOrigin(bounds[0], bounds[2], bounds[4]);
+  displacementGrid->SetSpacing(spacing[0], spacing[1], spacing[2]);
+  displacementGrid->AllocateScalars(VTK_DOUBLE, 3);
+  double* displacements = static_cast<double*>(displacementGrid->GetScalarPointer());
+
+  // The whole chain is applied to a slice of grid points at a time.
+  vtkIdType numberOfPointsInSlice = static_cast<vtkIdType>(dimensions[0]) * dimensions[1];
+  vtkNew<vtkPoints> gridPoints;
+  gridPoints->SetDataTypeToDouble();
+  gridPoints->SetNumberOfPoints(numberOfPointsInSlice);
+  vtkNew<vtkPoints> transformedPoints;
+  double gridPoint[3] = { 0.0, 0.0, 0.0 };
+  double transformedPoint[3] = { 0.0, 0.0, 0.0 };
+  for (int k = 0; k < dimensions[2]; ++k)
+    {
+    gridPoint[2] = bounds[4] + k * spacing[2];
+    vtkIdType pointId = 0;
+    for (int j = 0; j < dimensions[1]; ++j)
+      {
+      gridPoint[1] = bounds[2] + j * spacing[1];
+      for (int i = 0; i < dimensions[0]; ++i)
+        {
+        gridPoint[0] = bounds[0] + i * spacing[0];
+        gridPoints->SetPoint(pointId++, gridPoint);
+        }
+      }
+    vtkMRMLTransformNode::TransformPointsByComponents(transform, gridPoints.GetPointer(), transformedPoints.GetPointer());
+    double* sliceDisplacements = displacements + 3 * numberOfPointsInSlice * k;
+    for (pointId = 0; pointId < numberOfPointsInSlice; ++pointId)
+      {
+      gridPoints->GetPoint(pointId, gridPoint);
+      transformedPoints->GetPoint(pointId, transformedPoint);
+      sliceDisplacements[3 * pointId] = transformedPoint[0] - gridPoint[0];
+      sliceDisplacements[3 * pointId + 1] = transformedPoint[1] - gridPoint[1];
+      sliceDisplacements[3 * pointId + 2] = transformedPoint[2] - gridPoint[2];
+      }
+    }
+
+  vtkOrientedGridTransform* bakedTransform = vtkOrientedGridTransform::New();
+  bakedTransform->SetDisplacementGridData(displacementGrid.GetPointer());
+  return bakedTransform;
+}
+
 //----------------------------------------------------------------------------
 int  vtkMRMLTransformNode::IsTransformToNodeLinear(vtkMRMLTransformNode* targetNode)
 {
@@ -1108,6 +1424,12 @@ void vtkMRMLTransformNode::ProcessMRMLEvents ( vtkObject *caller,
 {
   Superclass::ProcessMRMLEvents ( caller, event, callData );
 
+  if (event == vtkMRMLTransformableNode::TransformModifiedEvent
+    && caller != NULL && caller == this->GetParentTransformNode())
+    {
+    this->InvalidateBakedTransforms();
+    }
+
   if (event ==  vtkCommand::ModifiedEvent && caller!=NULL)
     {
     if (caller == this->TransformToParent)
@@ -1123,6 +1445,36 @@ void vtkMRMLTransformNode::ProcessMRMLEvents ( vtkObject *caller,
     }
 }
 
+//----------------------------------------------------------------------------
+void vtkMRMLTransformNode::OnNodeReferenceAdded(vtkMRMLNodeReference *reference)
+{
+  if (std::string(reference->GetReferenceRole()) == this->TransformNodeReferenceRole)
+    {
+    this->InvalidateBakedTransforms();
+    }
+  Superclass::OnNodeReferenceAdded(reference);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLTransformNode::OnNodeReferenceModified(vtkMRMLNodeReference *reference)
+{
+  if (std::string(reference->GetReferenceRole()) == this->TransformNodeReferenceRole)
+    {
+    this->InvalidateBakedTransforms();
+    }
+  Superclass::OnNodeReferenceModified(reference);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLTransformNode::OnNodeReferenceRemoved(vtkMRMLNodeReference *reference)
+{
+  if (std::string(reference->GetReferenceRole()) == this->TransformNodeReferenceRole)
+    {
+    this->InvalidateBakedTransforms();
+    }
+  Superclass::OnNodeReferenceRemoved(reference);
+}
+
 //----------------------------------------------------------------------------
 void vtkMRMLTransformNode::Inverse()
 {
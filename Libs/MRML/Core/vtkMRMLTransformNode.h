@@ -21,6 +21,8 @@ class vtkCollection;
 class vtkAbstractTransform;
 class vtkGeneralTransform;
 class vtkMatrix4x4;
+class vtkOrientedGridTransform;
+class vtkPoints;
 class vtkTransform;
 
 /// \brief MRML node for representing a transformation
@@ -128,6 +130,55 @@ public:
   /// \sa GetTransformBetweenNodes
   void GetTransformFromWorld(vtkGeneralTransform* transformToWorld);
 
+  ///
+  /// Get the transform to world that is used for displaying nodes (reslicing volumes,
+  /// transforming models in views). It is the baked transform if baking is enabled
+  /// and the chain is non-linear, otherwise the same as GetTransformToWorld.
+  /// The baked transform is only an approximation, therefore it must not be used
+  /// for modifying data (such as hardening the transform).
+  /// \sa SetBakeTransform, GetTransformToWorld
+  void GetDisplayTransformToWorld(vtkGeneralTransform* transformToWorld);
+
+  ///
+  /// Get the transform from world that is used for displaying nodes.
+  /// \sa GetDisplayTransformToWorld, GetTransformFromWorld
+  void GetDisplayTransformFromWorld(vtkGeneralTransform* transformFromWorld);
+
+  ///
+  /// If enabled and the transform to world is non-linear then GetDisplayTransformToWorld
+  /// and GetDisplayTransformFromWorld return a single grid transform that is sampled
+  /// from the whole transform chain over the baked transform region, instead
+  /// of the chain itself. This makes displaying nodes through a long chain of non-linear
+  /// transforms (such as reslicing a volume through several registration results) as fast as
+  /// evaluating a single grid transform. GetTransformToWorld and GetTransformFromWorld
+  /// always return the exact transform chain.
+  /// The grid is computed when it is first requested and recomputed after
+  /// the chain is modified (when TransformModifiedEvent is invoked).
+  /// Disabled by default.
+  /// \sa SetBakedTransformRegion
+  void SetBakeTransform(bool bake);
+  vtkGetMacro(BakeTransform, bool);
+  vtkBooleanMacro(BakeTransform, bool);
+
+  ///
+  /// Region where the baked transform is sampled, as bounds in world coordinates
+  /// (for the transform from world) and in the coordinate system of this node
+  /// (for the transform to world), and the distance between grid points along each axis.
+  /// Outside the region the displacement at the region boundary is used, therefore
+  /// the region has to include all points that are transformed (for example
+  /// the field of view of the slice views).
+  /// The transform is not baked if the region is empty (default).
+  void SetBakedTransformRegion(const double bounds[6], const double spacing[3]);
+  void GetBakedTransformRegion(double bounds[6], double spacing[3]);
+
+  ///
+  /// Get the baked transform to/from world. The grid is computed if it is
+  /// not available or out of date.
+  /// Returns NULL if baking is disabled, the transform to world is linear
+  /// or the baked transform region is empty.
+  vtkOrientedGridTransform* GetBakedTransformToWorld();
+  vtkOrientedGridTransform* GetBakedTransformFromWorld();
+
   ///
   /// Get concatenated transforms to the specified node.
   /// \sa GetTransformBetweenNodes
@@ -271,6 +322,7 @@ public:
   /// and then re-enable transform modified events to invoke any pending notifications.
   virtual void TransformModified()
     {
+    this->InvalidateBakedTransforms();
     this->InvokeCustomModifiedEvent(vtkMRMLTransformableNode::TransformModifiedEvent);
     }
 
@@ -314,6 +366,14 @@ public:
   /// into a flat list of transforms. This is useful for simplifying serialization for copying and writing to file.
   static void FlattenGeneralTransform(vtkCollection* outputTransformList, vtkAbstractTransform* inputTransform);
 
+  ///
+  /// Transform points by each component of a general transform in turn,
+  /// so that each component transforms all the points in one call
+  /// (vtkOrientedGridTransform and vtkOrientedBSplineTransform transform
+  /// the points in parallel in that case).
+  static void TransformPointsByComponents(vtkAbstractTransform* transform,
+    vtkPoints* inputPoints, vtkPoints* outputPoints);
+
   ///
   /// Utility function that determines if a transform is linear. It looks into composite transforms and only returns
   /// with true if all the transform components are linear.
@@ -360,6 +420,21 @@ protected:
   /// transform type then it returns NULL.
   virtual vtkAbstractTransform* GetAbstractTransformAs(vtkAbstractTransform* inputTransform, const char* transformClassName, bool logErrorIfFails);
 
+  ///
+  /// Reimplemented to invalidate the baked transforms when the parent transform node changes.
+  virtual void OnNodeReferenceAdded(vtkMRMLNodeReference *reference) VTK_OVERRIDE;
+  virtual void OnNodeReferenceModified(vtkMRMLNodeReference *reference) VTK_OVERRIDE;
+  virtual void OnNodeReferenceRemoved(vtkMRMLNodeReference *reference) VTK_OVERRIDE;
+
+  ///
+  /// Delete the baked transforms, they are computed again when they are requested next time.
+  void InvalidateBakedTransforms();
+
+  ///
+  /// Sample a transform at the points of a grid into a new grid transform.
+  static vtkOrientedGridTransform* CreateBakedTransform(vtkAbstractTransform* transform,
+    const double bounds[6], const double spacing[3]);
+
   ///
   /// Sets and observes a transform and deletes the inverse (so that the inverse will be computed automatically)
   virtual void SetAndObserveTransform(vtkAbstractTransform** originalTransformPtr, vtkAbstractTransform** inverseTransformPtr, vtkAbstractTransform *transform);
@@ -383,6 +458,17 @@ protected:
   /// GetMatrixTransformToParent and GetMatrixFromParent methods
   vtkMatrix4x4* CachedMatrixTransformToParent;
   vtkMatrix4x4* CachedMatrixTransformFromParent;
+
+  bool BakeTransform;
+  double BakedTransformBounds[6];
+  double BakedTransformSpacing[3];
+
+  /// Grid transforms sampled from the transform chain and the
+  /// modification time of the chain when they were sampled.
+  vtkOrientedGridTransform* BakedTransformToWorld;
+  vtkOrientedGridTransform* BakedTransformFromWorld;
+  vtkMTimeType BakedTransformToWorldTime;
+  vtkMTimeType BakedTransformFromWorldTime;
 };
 
 #endif
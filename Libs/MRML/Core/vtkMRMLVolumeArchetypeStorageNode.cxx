@@ -22,6 +22,11 @@ Version:   $Revision: 1.6 $
 #endif
 #include "vtkMRMLVolumeArchetypeStorageNode.h"
 
+#ifdef MRML_USE_vtkTeem
+// vtkTeem includes
+#include "vtkNRRDReader.h"
+#endif
+
 // VTK ITK includes
 #include "vtkITKArchetypeImageSeriesScalarReader.h"
 #include "vtkITKArchetypeDiffusionTensorImageReaderFile.h"
@@ -37,6 +42,10 @@ Version:   $Revision: 1.6 $
 #include <vtkDataArray.h>
 #include <vtkErrorCode.h>
 #include <vtkImageChangeInformation.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkInformationStringKey.h>
+#include <vtkMatrix4x4.h>
 #include <vtkNew.h>
 #include <vtkPointData.h>
 #include <vtkSmartPointer.h>
@@ -56,6 +65,7 @@ vtkMRMLVolumeArchetypeStorageNode::vtkMRMLVolumeArchetypeStorageNode()
   this->CenterImage = 0;
   this->SingleFile  = 0;
   this->UseOrientationFromFile = 1;
+  this->UseMemoryMapping = 0;
   this->DefaultWriteFileExtension = "nrrd";
 }
 
@@ -78,6 +88,11 @@ void vtkMRMLVolumeArchetypeStorageNode::WriteXML(ostream& of, int nIndent)
   ss << this->UseOrientationFromFile;
   of << " UseOrientationFromFile=\"" << ss.str() << "\"";
   }
+  {
+  std::stringstream ss;
+  ss << this->UseMemoryMapping;
+  of << " useMemoryMapping=\"" << ss.str() << "\"";
+  }
   // SingleFile attribute is not written to file. GetNumberOfFileNames()
   // is used to determine if reader should read from single/multiple files.
 }
@@ -107,6 +122,12 @@ void vtkMRMLVolumeArchetypeStorageNode::ReadXMLAttributes(const char** atts)
       ss << attValue;
       ss >> this->UseOrientationFromFile;
       }
+    if (!strcmp(attName, "useMemoryMapping"))
+      {
+      std::stringstream ss;
+      ss << attValue;
+      ss >> this->UseMemoryMapping;
+      }
     }
 
   // SingleFile attribute used to be read from the scene, but often
@@ -131,6 +152,7 @@ void vtkMRMLVolumeArchetypeStorageNode::Copy(vtkMRMLNode *anode)
   this->SetCenterImage(node->CenterImage);
   this->SetSingleFile(node->SingleFile);
   this->SetUseOrientationFromFile(node->UseOrientationFromFile);
+  this->SetUseMemoryMapping(node->UseMemoryMapping);
 
   this->EndModify(disabledModify);
 }
@@ -142,6 +164,7 @@ void vtkMRMLVolumeArchetypeStorageNode::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "CenterImage:   " << this->CenterImage << "\n";
   os << indent << "SingleFile:   " << this->SingleFile << "\n";
   os << indent << "UseOrientationFromFile:   " << this->UseOrientationFromFile << "\n";
+  os << indent << "UseMemoryMapping:   " << this->UseMemoryMapping << "\n";
 }
 
 //----------------------------------------------------------------------------
@@ -259,6 +282,50 @@ void ApplyImageSeriesReaderWorkaround(vtkMRMLVolumeArchetypeStorageNode * storag
 //----------------------------------------------------------------------------
 int vtkMRMLVolumeArchetypeStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
 {
+  // release the current image before reading the new one
+  vtkMRMLVolumeNode* volNode = vtkMRMLVolumeNode::SafeDownCast(refNode);
+  if (volNode && volNode->GetImageData())
+    {
+    volNode->SetAndObserveImageData(NULL);
+    }
+  if (!this->ReadDataInThreadInternal(refNode))
+    {
+    return 0;
+    }
+  return this->ApplyReadDataInternal(refNode);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLVolumeArchetypeStorageNode::CanReadDataInThread(vtkMRMLNode *refNode)
+{
+  // subclasses may read files in ways that are not thread safe,
+  // they have to opt in explicitly
+  if (strcmp(this->GetClassName(), "vtkMRMLVolumeArchetypeStorageNode") != 0)
+    {
+    return false;
+    }
+  return this->CanReadInReferenceNode(refNode);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLVolumeArchetypeStorageNode::CanWriteDataInThread(vtkMRMLNode *refNode)
+{
+  // subclasses may write files in ways that are not thread safe,
+  // they have to opt in explicitly
+  if (strcmp(this->GetClassName(), "vtkMRMLVolumeArchetypeStorageNode") != 0)
+    {
+    return false;
+    }
+  return this->CanWriteFromReferenceNode(refNode);
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLVolumeArchetypeStorageNode::ReadDataInThreadInternal(vtkMRMLNode *refNode)
+{
+  this->ReadImage = NULL;
+  this->ReadRASToIJKMatrix = NULL;
+  this->ReadImageReader = NULL;
+
   std::string fullName = this->GetFullNameFromFileName();
   vtkDebugMacro("ReadData: got full archetype name " << fullName);
 
@@ -291,6 +358,17 @@ int vtkMRMLVolumeArchetypeStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
     return 0;
     }
 
+  if (this->UseMemoryMapping
+    && !refNode->IsA("vtkMRMLVectorVolumeNode")
+    && !refNode->IsA("vtkMRMLDiffusionTensorVolumeNode"))
+    {
+    int result = this->ReadMemoryMappedDataInternal(fullName);
+    if (result >= 0)
+      {
+      return result;
+      }
+    }
+
   vtkSmartPointer<vtkITKArchetypeImageSeriesReader> reader;
 
   if (refNode->IsA("vtkMRMLVectorVolumeNode"))
@@ -318,11 +396,6 @@ int vtkMRMLVolumeArchetypeStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
 
   reader->AddObserver( vtkCommand::ProgressEvent,  this->MRMLCallbackCommand);
 
-  if (volNode->GetImageData())
-    {
-    volNode->SetAndObserveImageData(NULL);
-    }
-
   // Set the list of file names on the reader
   reader->ResetFileNames();
   reader->SetArchetype(fullName.c_str());
@@ -412,9 +485,6 @@ int vtkMRMLVolumeArchetypeStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
     return 0;
     }
 
-  // Set volume attributes
-  vtkMRMLVolumeArchetypeStorageNode::SetMetaDataDictionaryFromReader(volNode, reader);
-
   // Get all the file names from the reader
   if (reader->GetNumberOfFileNames() > 1)
     {
@@ -456,7 +526,8 @@ int vtkMRMLVolumeArchetypeStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
 
   vtkNew<vtkImageData> iciOutputCopy;
   iciOutputCopy->ShallowCopy(ici->GetOutput());
-  volNode->SetAndObserveImageData(iciOutputCopy.GetPointer());
+  this->ReadImage = iciOutputCopy.GetPointer();
+  this->ReadImageReader = reader;
 
   // Log volume size to the application log. It helps to identify potential out-of-memory issues.
   vtkInfoMacro(<<"Loaded volume from file: "<<fullName \
@@ -469,33 +540,162 @@ int vtkMRMLVolumeArchetypeStorageNode::ReadDataInternal(vtkMRMLNode *refNode)
     {
     vtkErrorMacro ("Reader returned NULL RasToIjkMatrix");
     }
-  volNode->SetRASToIJKMatrix(mat);
-
-  if (volNode->IsA("vtkMRMLDiffusionTensorVolumeNode"))
+  else
     {
-    vtkMRMLDiffusionTensorVolumeNode* dtvn = vtkMRMLDiffusionTensorVolumeNode::SafeDownCast(volNode);
-    dtvn->SetMeasurementFrameMatrix(reader->GetMeasurementFrameMatrix());
+    this->ReadRASToIJKMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    this->ReadRASToIJKMatrix->DeepCopy(mat);
     }
 
   return 1;
 }
 
 //----------------------------------------------------------------------------
-int vtkMRMLVolumeArchetypeStorageNode::WriteDataInternal(vtkMRMLNode *refNode)
+int vtkMRMLVolumeArchetypeStorageNode::ApplyReadDataInternal(vtkMRMLNode *refNode)
 {
-  int result = 1;
+  vtkMRMLScalarVolumeNode * volNode = vtkMRMLScalarVolumeNode::SafeDownCast(refNode);
+  if (volNode == NULL || this->ReadImage.GetPointer() == NULL)
+    {
+    vtkErrorMacro("ApplyReadDataInternal: No image was read for the reference node");
+    return 0;
+    }
 
-  vtkMRMLVolumeNode *volNode = vtkMRMLScalarVolumeNode::SafeDownCast(refNode);
+  // Set volume attributes
+  if (this->ReadImageReader)
+    {
+    vtkMRMLVolumeArchetypeStorageNode::SetMetaDataDictionaryFromReader(volNode, this->ReadImageReader);
+    }
 
-  if (volNode->GetImageData() == NULL)
+  volNode->SetAndObserveImageData(this->ReadImage);
+  if (this->ReadRASToIJKMatrix)
     {
-    vtkErrorMacro("cannot write ImageData, it's NULL");
+    volNode->SetRASToIJKMatrix(this->ReadRASToIJKMatrix);
+    }
+
+  vtkMRMLDiffusionTensorVolumeNode* dtvn = vtkMRMLDiffusionTensorVolumeNode::SafeDownCast(volNode);
+  if (dtvn && this->ReadImageReader)
+    {
+    dtvn->SetMeasurementFrameMatrix(this->ReadImageReader->GetMeasurementFrameMatrix());
+    }
+
+  this->ReadImage = NULL;
+  this->ReadRASToIJKMatrix = NULL;
+  this->ReadImageReader = NULL;
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLVolumeArchetypeStorageNode::ReadMemoryMappedDataInternal(const std::string& fullName)
+{
+#ifdef MRML_USE_vtkTeem
+  if (this->GetNumberOfFileNames() > 1)
+    {
+    return -1;
+    }
+  vtkNew<vtkNRRDReader> reader;
+  if (!reader->CanReadFile(fullName.c_str()))
+    {
+    return -1;
+    }
+  reader->SetFileName(fullName.c_str());
+  if (!reader->CanMemoryMapData() || reader->GetNumberOfComponents() != 1)
+    {
+    return -1;
+    }
+
+  reader->SetUseMemoryMapping(true);
+  if (this->CenterImage)
+    {
+    reader->SetUseNativeOriginOff();
+    }
+  else
+    {
+    reader->SetUseNativeOriginOn();
+    }
+  reader->Update();
+  if (reader->GetReadStatus() != 0
+    || reader->GetOutput() == NULL
+    || reader->GetOutput()->GetPointData()->GetScalars() == NULL)
+    {
+    vtkErrorMacro("ReadData: Unable to read ScalarVolume data from file: " << fullName);
     return 0;
     }
 
-  // update the file list
-  std::string moveFromDir = this->UpdateFileList(refNode, 1);
+  vtkNew<vtkImageChangeInformation> ici;
+  ici->SetInputConnection(reader->GetOutputPort());
+  ici->SetOutputSpacing( 1, 1, 1 );
+  ici->SetOutputOrigin( 0, 0, 0 );
+  ici->Update();
+
+  vtkNew<vtkImageData> iciOutputCopy;
+  iciOutputCopy->ShallowCopy(ici->GetOutput());
+  this->ReadImage = iciOutputCopy.GetPointer();
+
+  vtkInfoMacro(<<"Loaded volume from file: "<<fullName \
+    <<" (memory mapped: "<<(reader->GetDataMemoryMapped() ? "yes" : "no")<<")" \
+    <<". Dimensions: "<<iciOutputCopy->GetDimensions()[0]<<"x"<<iciOutputCopy->GetDimensions()[1]<<"x"<<iciOutputCopy->GetDimensions()[2] \
+    <<". Number of components: "<<iciOutputCopy->GetNumberOfScalarComponents() \
+    <<". Pixel type: "<<vtkImageScalarTypeNameMacro(iciOutputCopy->GetScalarType())<<".");
+
+  this->ReadRASToIJKMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  this->ReadRASToIJKMatrix->DeepCopy(reader->GetRasToIjkMatrix());
+  return 1;
+#else
+  (void)fullName;
+  return -1;
+#endif
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLVolumeArchetypeStorageNode::DetachMemoryMappedScalars(vtkImageData* imageData, const std::string& fullName)
+{
+#ifdef MRML_USE_vtkTeem
+  vtkDataArray* scalars = (imageData ? imageData->GetPointData()->GetScalars() : NULL);
+  if (!scalars || fullName.empty()
+    || !scalars->GetInformation()->Has(vtkNRRDReader::MEMORY_MAPPED_FILE_NAME()))
+    {
+    return;
+    }
+  std::string mappedFileName = scalars->GetInformation()->Get(vtkNRRDReader::MEMORY_MAPPED_FILE_NAME());
+  std::string writtenFileName = vtksys::SystemTools::CollapseFullPath(fullName);
+  // the data file of a detached header has the same name with a different extension
+  if (mappedFileName != writtenFileName
+    && (vtksys::SystemTools::GetFilenamePath(mappedFileName) != vtksys::SystemTools::GetFilenamePath(writtenFileName)
+      || vtksys::SystemTools::GetFilenameWithoutLastExtension(mappedFileName)
+        != vtksys::SystemTools::GetFilenameWithoutLastExtension(writtenFileName)))
+    {
+    return;
+    }
+  // Other images (shallow copies, filter outputs, other nodes) may hold the same
+  // array, so the voxels are copied into a new buffer of the array itself
+  // instead of replacing the array in this image only.
+  // The file is unmapped when the array is deleted, it is not accessed anymore.
+  vtkSmartPointer<vtkDataArray> scalarsCopy = vtkSmartPointer<vtkDataArray>::Take(scalars->NewInstance());
+  scalarsCopy->DeepCopy(scalars);
+  scalarsCopy->GetInformation()->Remove(vtkNRRDReader::MEMORY_MAPPED_FILE_NAME());
+  scalars->ShallowCopy(scalarsCopy);
+  scalars->GetInformation()->Remove(vtkNRRDReader::MEMORY_MAPPED_FILE_NAME());
+  scalars->Modified();
+#else
+  (void)imageData;
+  (void)fullName;
+#endif
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLVolumeArchetypeStorageNode::PrepareWriteDataInternal(vtkMRMLNode *refNode)
+{
+  this->WriteImage = NULL;
+  this->WriteRASToIJKMatrix = NULL;
+  this->WriteImageIOClassName.clear();
+  this->WriteFullName.clear();
+  this->WrittenFileNames.clear();
 
+  vtkMRMLVolumeNode *volNode = vtkMRMLScalarVolumeNode::SafeDownCast(refNode);
+  if (volNode == NULL || volNode->GetImageData() == NULL)
+    {
+    vtkErrorMacro("cannot write ImageData, it's NULL");
+    return 0;
+    }
 
   std::string fullName = this->GetFullNameFromFileName();
   if (fullName.empty())
@@ -504,106 +704,178 @@ int vtkMRMLVolumeArchetypeStorageNode::WriteDataInternal(vtkMRMLNode *refNode)
     return 0;
     }
 
-  bool moveSucceeded = true;
-  if (!moveFromDir.empty())
+  // voxels loaded by memory mapping may come from the file that is overwritten
+  DetachMemoryMappedScalars(volNode->GetImageData(), fullName);
+
+  // the writer does not update the pipeline of the volume node
+  this->WriteImage = vtkSmartPointer<vtkImageData>::New();
+  this->WriteImage->ShallowCopy(volNode->GetImageData());
+  this->WriteRASToIJKMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  volNode->GetRASToIJKMatrix(this->WriteRASToIJKMatrix);
+  if (this->WriteFileFormat &&
+      this->GetScene() &&
+      this->GetScene()->GetDataIOManager() &&
+      this->GetScene()->GetDataIOManager()->GetFileFormatHelper())
     {
-    // the temp writing went okay, just move the files from there to where
-    // they're supposed to go. It will fail if the temp dir is on a different
-    // device, so fall back to a second write in that case.
-    std::string targetDir = vtksys::SystemTools::GetParentDirectory(fullName.c_str());
-    vtkDebugMacro("WriteData: moving files from temp dir " << moveFromDir << " to target dir " << targetDir);
+    const char* imageIOClassName = this->GetScene()->GetDataIOManager()->
+      GetFileFormatHelper()->GetClassNameFromFormatString(this->WriteFileFormat);
+    if (imageIOClassName)
+      {
+      this->WriteImageIOClassName = imageIOClassName;
+      }
+    }
+  this->WriteFullName = fullName;
+  return 1;
+}
 
+//----------------------------------------------------------------------------
+int vtkMRMLVolumeArchetypeStorageNode::WriteDataInternal(vtkMRMLNode *vtkNotUsed(refNode))
+{
+  if (this->WriteImage == NULL)
+    {
+    vtkErrorMacro("WriteData: no image to write, StartWriteData() was not called");
+    return 0;
+    }
+  const std::string& fullName = this->WriteFullName;
+  std::string archetype = vtksys::SystemTools::GetFilenameName(fullName);
+  this->WrittenFileNames.clear();
+
+  // Write in a temp dir first to know which files are written, then move
+  // the files from there to where they're supposed to go. It will fail if
+  // the temp dir is on a different device, so fall back to a second write
+  // in that case.
+  std::string targetDir = vtksys::SystemTools::GetParentDirectory(fullName.c_str());
+  std::vector<std::string> targetPathComponents;
+  vtksys::SystemTools::SplitPath(targetDir.c_str(), targetPathComponents);
+  std::vector<std::string> sourcePathComponents = targetPathComponents;
+  sourcePathComponents.push_back(std::string("TempWrite") +
+    vtksys::SystemTools::GetFilenameWithoutExtension(fullName));
+  std::string tempDir = vtksys::SystemTools::JoinPath(sourcePathComponents);
+  vtkDebugMacro("WriteData: deleting and then re-creating temp dir " << tempDir);
+
+  bool moveSucceeded = false;
+  if ((!vtksys::SystemTools::FileExists(tempDir.c_str()) ||
+       vtksys::SystemTools::RemoveADirectory(tempDir.c_str())) &&
+      vtksys::SystemTools::MakeDirectory(tempDir.c_str()))
+    {
+    sourcePathComponents.push_back(archetype);
+    std::string tempName = vtksys::SystemTools::JoinPath(sourcePathComponents);
+    sourcePathComponents.pop_back();
     vtksys::Directory dir;
-    dir.Load(moveFromDir.c_str());
-    vtkDebugMacro("WriteData: tempdir " << moveFromDir.c_str() << " has " << dir.GetNumberOfFiles() << " in it");
-    size_t fileNum;
-    std::vector<std::string> targetPathComponents;
-    vtksys::SystemTools::SplitPath(targetDir.c_str(), targetPathComponents);
-    std::vector<std::string> sourcePathComponents;
-    vtksys::SystemTools::SplitPath(moveFromDir.c_str(), sourcePathComponents);
-    for (fileNum = 0; fileNum <  dir.GetNumberOfFiles(); ++fileNum)
+    if (this->WriteImageFile(tempName) && dir.Load(tempDir.c_str()))
       {
-      const char *thisFile = dir.GetFile(static_cast<unsigned long>(fileNum));
-      // skip the dirs
-      if (strcmp(thisFile,".") &&
-          strcmp(thisFile,".."))
+      vtkDebugMacro("WriteData: tempdir " << tempDir << " has " << dir.GetNumberOfFiles() << " in it");
+      for (unsigned long fileNum = 0; fileNum < dir.GetNumberOfFiles(); ++fileNum)
         {
-        targetPathComponents.push_back(thisFile);
-        sourcePathComponents.push_back(thisFile);
-        std::string targetFile = vtksys::SystemTools::JoinPath(targetPathComponents);
-        // does the target file already exist?
-        if (vtksys::SystemTools::FileExists(targetFile.c_str(), true))
+        const char *thisFile = dir.GetFile(fileNum);
+        // skip the dirs
+        if (strcmp(thisFile,".") &&
+            strcmp(thisFile,".."))
           {
-          // remove it
-          vtkWarningMacro("WriteData: removing old version of file " << targetFile);
-          if (!vtksys::SystemTools::RemoveFile(targetFile.c_str()))
-            {
-            vtkErrorMacro("WriteData: unable to remove old version of file " << targetFile);
-            }
+          this->WrittenFileNames.push_back(thisFile);
           }
-        std::string sourceFile = vtksys::SystemTools::JoinPath(sourcePathComponents);
-        vtkDebugMacro("WriteData: moving file number " << fileNum << ", " << sourceFile << " to " << targetFile);
-        // thisFile needs a full path it's bare
-        int renameReturn = std::rename(sourceFile.c_str(), targetFile.c_str());
-        if (renameReturn != 0 )
+        }
+      moveSucceeded = (std::find(this->WrittenFileNames.begin(),
+        this->WrittenFileNames.end(), archetype) != this->WrittenFileNames.end());
+      if (!moveSucceeded)
+        {
+        vtkErrorMacro("WriteData: the archetype file '" << archetype
+          << "' wasn't written out when writing '" << tempName << "'.");
+        }
+      }
+    for (size_t fileNum = 0; moveSucceeded && fileNum < this->WrittenFileNames.size(); ++fileNum)
+      {
+      const std::string& thisFile = this->WrittenFileNames[fileNum];
+      targetPathComponents.push_back(thisFile);
+      sourcePathComponents.push_back(thisFile);
+      std::string targetFile = vtksys::SystemTools::JoinPath(targetPathComponents);
+      std::string sourceFile = vtksys::SystemTools::JoinPath(sourcePathComponents);
+      targetPathComponents.pop_back();
+      sourcePathComponents.pop_back();
+      // does the target file already exist?
+      if (vtksys::SystemTools::FileExists(targetFile.c_str(), true))
+        {
+        // remove it
+        vtkWarningMacro("WriteData: removing old version of file " << targetFile);
+        if (!vtksys::SystemTools::RemoveFile(targetFile.c_str()))
           {
-          perror( "Error renaming file" );
-          vtkErrorMacro( "WriteData: Error renaming file to " << targetFile << ", renameReturn = " << renameReturn );
-          // fall back to doing a second write
-          moveSucceeded = false;
-          break;
+          vtkErrorMacro("WriteData: unable to remove old version of file " << targetFile);
           }
-        targetPathComponents.pop_back();
-        sourcePathComponents.pop_back();
+        }
+      vtkDebugMacro("WriteData: moving file number " << fileNum << ", " << sourceFile << " to " << targetFile);
+      int renameReturn = std::rename(sourceFile.c_str(), targetFile.c_str());
+      if (renameReturn != 0 )
+        {
+        perror( "Error renaming file" );
+        vtkErrorMacro( "WriteData: Error renaming file to " << targetFile << ", renameReturn = " << renameReturn );
+        // fall back to doing a second write
+        moveSucceeded = false;
         }
       }
     // delete the temporary dir and all remaining contents
-    bool dirRemoved = vtksys::SystemTools::RemoveADirectory(moveFromDir.c_str());
-    if (!dirRemoved)
+    if (!vtksys::SystemTools::RemoveADirectory(tempDir.c_str()))
       {
-      vtkWarningMacro("Failed to remove temporary write directory " << moveFromDir);
+      vtkWarningMacro("Failed to remove temporary write directory " << tempDir);
       }
-
     }
   else
     {
-    // didn't move it
-    moveSucceeded = false;
+    vtkErrorMacro("WriteData: Failed to create directory '" << tempDir << "'.");
     }
 
-  if (!moveSucceeded)
+  if (moveSucceeded)
     {
-    vtkDebugMacro("WriteData: writing out file with archetype " << fullName);
-
-    vtkNew<vtkITKImageWriter> writer;
-    writer->SetFileName(fullName.c_str());
-
-    writer->SetInputConnection( volNode->GetImageDataConnection() );
-    writer->SetUseCompression(this->GetUseCompression());
-    if(this->WriteFileFormat)
-      {
-      writer->SetImageIOClassName(
-                                  this->GetScene()->GetDataIOManager()->GetFileFormatHelper()->
-                                  GetClassNameFromFormatString(this->WriteFileFormat));
-      }
-
-    // set volume attributes
-    vtkNew<vtkMatrix4x4> mat;
-    volNode->GetRASToIJKMatrix(mat.GetPointer());
-    writer->SetRasToIJKMatrix(mat.GetPointer());
+    return 1;
+    }
 
-    try
-      {
-      writer->Write();
-      }
-    catch (...)
-      {
-      result = 0;
-      }
+  vtkDebugMacro("WriteData: writing out file with archetype " << fullName);
+  if (std::find(this->WrittenFileNames.begin(), this->WrittenFileNames.end(),
+                archetype) == this->WrittenFileNames.end())
+    {
+    this->WrittenFileNames.clear();
+    this->WrittenFileNames.push_back(archetype);
     }
+  return this->WriteImageFile(fullName);
+}
 
-  return result;
+//----------------------------------------------------------------------------
+int vtkMRMLVolumeArchetypeStorageNode::ApplyWriteDataInternal(vtkMRMLNode *refNode, int writeResult)
+{
+  if (writeResult)
+    {
+    this->ResetFileNameList();
+    this->AddWrittenFileNames(refNode, this->WrittenFileNames);
+    }
+  this->WriteImage = NULL;
+  this->WriteRASToIJKMatrix = NULL;
+  this->WriteImageIOClassName.clear();
+  this->WriteFullName.clear();
+  this->WrittenFileNames.clear();
+  return writeResult;
+}
 
+//----------------------------------------------------------------------------
+int vtkMRMLVolumeArchetypeStorageNode::WriteImageFile(const std::string& fileName)
+{
+  vtkNew<vtkITKImageWriter> writer;
+  writer->SetFileName(fileName.c_str());
+  writer->SetInputData(this->WriteImage);
+  writer->SetUseCompression(this->GetUseCompression());
+  if (!this->WriteImageIOClassName.empty())
+    {
+    writer->SetImageIOClassName(this->WriteImageIOClassName.c_str());
+    }
+  writer->SetRasToIJKMatrix(this->WriteRASToIJKMatrix);
+  try
+    {
+    writer->Write();
+    }
+  catch (...)
+    {
+    vtkErrorMacro("WriteData: Failed to write '" << fileName << "'.");
+    return 0;
+    }
+  return 1;
 }
 
 //----------------------------------------------------------------------------
@@ -748,38 +1020,100 @@ std::string vtkMRMLVolumeArchetypeStorageNode::UpdateFileList(vtkMRMLNode *refNo
     return returnString;
     }
 
-  // take the archetype and temp dir off of the path
-  pathComponents.pop_back();
-  pathComponents.pop_back();
+  std::vector<std::string> writtenFileNames;
+  for (unsigned long fileNum = 0; fileNum < dir.GetNumberOfFiles(); ++fileNum)
+    {
+    // skip the dirs
+    const char *thisFile = dir.GetFile(fileNum);
+    if (strcmp(thisFile,".") &&
+        strcmp(thisFile,".."))
+      {
+      writtenFileNames.push_back(thisFile);
+      }
+    }
+  if (!this->AddWrittenFileNames(refNode, writtenFileNames))
+    {
+    std::stringstream addedFiles;
+    std::copy(writtenFileNames.begin(), writtenFileNames.end(),
+              std::ostream_iterator<std::string>(addedFiles,", "));
+    vtkErrorMacro("UpdateFileList: the archetype file '"
+      << vtksys::SystemTools::GetFilenameName(oldName) << "' wasn't written out when writting '"
+      << tempName.c_str() << "' in '" << tempDir.c_str() << "'. "
+      << "Only those " << writtenFileNames.size()
+      << " file(s) have been written: " << addedFiles.str().c_str() <<". "
+      << "Old name is '" << oldName.c_str() << "'."
+      );
+    return returnString;
+    }
+  // restore the old file name
+  vtkDebugMacro("UpdateFileList: resetting file name to " << oldName.c_str());
+  this->SetFileName(oldName.c_str());
+
+  if (move != 1)
+    {
+    // clean up temp directory
+    vtkDebugMacro("UpdateFileList: removing temp dir " << tempDir);
+    result = vtksys::SystemTools::RemoveADirectory(tempDir.c_str());
+    if (!result)
+      {
+      vtkErrorMacro("UpdateFileList: failed to remove temp dir '"
+                    << tempDir.c_str() << "'." );
+      return returnString;
+      }
+    return std::string("");
+    }
+  else
+    {
+    vtkDebugMacro("UpdateFileList: returning temp dir " << tempDir);
+    return tempDir;
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLVolumeArchetypeStorageNode::AddWrittenFileNames(
+  vtkMRMLNode *refNode, const std::vector<std::string>& writtenFileNames)
+{
+  const char* fileNameChars = this->GetFileName();
+  std::string fileName = (fileNameChars ? fileNameChars : "");
+  if (fileName.empty())
+    {
+    vtkErrorMacro("AddWrittenFileNames: File name not specified");
+    return false;
+    }
+  std::string originalDir = vtksys::SystemTools::GetParentDirectory(fileName.c_str());
+
+  // the written files are next to the archetype
+  std::vector<std::string> pathComponents;
+  vtksys::SystemTools::SplitPath(originalDir.c_str(), pathComponents);
   std::string localDirectory = vtksys::SystemTools::JoinPath(pathComponents);
   std::string relativePath;
 
   if (this->IsFilePathRelative(localDirectory.c_str()))
     {
-    vtkDebugMacro("UpdateFileList: the local directory is already relative, use it " << localDirectory);
+    vtkDebugMacro("AddWrittenFileNames: the local directory is already relative, use it " << localDirectory);
     relativePath = localDirectory;
     }
   else
     {
-    if (volNode->GetScene() != NULL &&
-        strlen(volNode->GetScene()->GetRootDirectory()) )
+    if (refNode && refNode->GetScene() != NULL &&
+        strlen(refNode->GetScene()->GetRootDirectory()) )
       {
       // use the scene's root dir, all the files in the list will be
       // relative to it (the relative path is how you go from the root dir to
       // the dir in which the volume is saved)
-      std::string rootDir = volNode->GetScene()->GetRootDirectory();
+      std::string rootDir = refNode->GetScene()->GetRootDirectory();
       if (rootDir.length() != 0 &&
           rootDir.find_last_of("/") == rootDir.length() - 1)
         {
-        vtkDebugMacro("UpdateFileList: found trailing slash in : " << rootDir);
+        vtkDebugMacro("AddWrittenFileNames: found trailing slash in : " << rootDir);
         rootDir = rootDir.substr(0, rootDir.length()-1);
         }
-      vtkDebugMacro("UpdateFileList: got the scene root dir " << rootDir << ", local dir = " << localDirectory.c_str());
+      vtkDebugMacro("AddWrittenFileNames: got the scene root dir " << rootDir << ", local dir = " << localDirectory.c_str());
       // RelativePath requires two absolute paths, otherwise returns empty
       // string
       if (this->IsFilePathRelative(rootDir.c_str()))
         {
-        vtkDebugMacro("UpdateFileList: have a relative directory in root dir (" << rootDir << "), using the local dir as a relative path.");
+        vtkDebugMacro("AddWrittenFileNames: have a relative directory in root dir (" << rootDir << "), using the local dir as a relative path.");
         // assume the relative local directory is relative to the root
         // directory
         relativePath = localDirectory;
@@ -802,7 +1136,7 @@ std::string vtkMRMLVolumeArchetypeStorageNode::UpdateFileList(vtkMRMLNode *refNo
         // the RelativePath method needs two absolute paths
         relativePath = vtksys::SystemTools::RelativePath(originalDir.c_str(), localDirectory.c_str());
         }
-      vtkDebugMacro("UpdateFileList: no scene root dir, using original dir = " << originalDir.c_str() << " and local dir " << localDirectory.c_str());
+      vtkDebugMacro("AddWrittenFileNames: no scene root dir, using original dir = " << originalDir.c_str() << " and local dir " << localDirectory.c_str());
       }
     }
   // strip off any trailing slashes
@@ -810,17 +1144,17 @@ std::string vtkMRMLVolumeArchetypeStorageNode::UpdateFileList(vtkMRMLNode *refNo
       relativePath.find_last_of("/")  != std::string::npos &&
       relativePath.find_last_of("/") == relativePath.length() - 1)
     {
-    vtkDebugMacro("UpdateFileList: stripping off a trailing slash from relativePath '"<< relativePath.c_str() << "'");
+    vtkDebugMacro("AddWrittenFileNames: stripping off a trailing slash from relativePath '"<< relativePath.c_str() << "'");
     relativePath = relativePath.substr(0, relativePath.length() - 1);
     }
-  vtkDebugMacro("UpdateFileList: using prefix of relative path '" << relativePath.c_str() << "'");
+  vtkDebugMacro("AddWrittenFileNames: using prefix of relative path '" << relativePath.c_str() << "'");
   // now get ready to join the relative path to thisFile
   std::vector<std::string> relativePathComponents;
   vtksys::SystemTools::SplitPath(relativePath.c_str(), relativePathComponents);
 
   // make sure that the archetype is added first! AddFile when it gets to it
   // in the dir will not add a duplicate
-  std::string newArchetype = vtksys::SystemTools::GetFilenameName(tempName.c_str());
+  std::string newArchetype = vtksys::SystemTools::GetFilenameName(fileName);
   vtkDebugMacro("Stripped archetype = " << newArchetype.c_str());
   relativePathComponents.push_back(newArchetype);
   std::string relativeArchetypeFile =  vtksys::SystemTools::JoinPath(relativePathComponents);
@@ -829,65 +1163,24 @@ std::string vtkMRMLVolumeArchetypeStorageNode::UpdateFileList(vtkMRMLNode *refNo
   this->AddFileName(relativeArchetypeFile.c_str());
 
   bool addedArchetype = false;
-  // now iterate through the directory files
-  for (size_t fileNum = 0; fileNum < dir.GetNumberOfFiles(); ++fileNum)
-    {
-    // skip the dirs
-    const char *thisFile = dir.GetFile(static_cast<unsigned long>(fileNum));
-    if (strcmp(thisFile,".") &&
-        strcmp(thisFile,".."))
-      {
-      vtkDebugMacro("UpdateFileList: adding file number " << fileNum << ", " << thisFile);
-      if (newArchetype.compare(thisFile) == 0)
-        {
-        addedArchetype = true;
-        }
-      // at this point, the file name is bare of a directory, turn it into a
-      // relative path from the original archetype
-      relativePathComponents.push_back(thisFile);
-      std::string relativeFile =  vtksys::SystemTools::JoinPath(relativePathComponents);
-      relativePathComponents.pop_back();
-      vtkDebugMacro("UpdateFileList: " << fileNum << ", using relative file name " << relativeFile.c_str());
-      this->AddFileName(relativeFile.c_str());
-      }
-    }
-  result = addedArchetype;
-  if (!result)
+  // now iterate through the written files
+  for (size_t fileNum = 0; fileNum < writtenFileNames.size(); ++fileNum)
     {
-    std::stringstream addedFiles;
-    std::copy(++this->FileNameList.begin(), this->FileNameList.end(),
-              std::ostream_iterator<std::string>(addedFiles,", "));
-    vtkErrorMacro("UpdateFileList: the archetype file '"
-      << newArchetype.c_str() << "' wasn't written out when writting '"
-      << tempName.c_str() << "' in '" << tempDir.c_str() << "'. "
-      << "Only those " << dir.GetNumberOfFiles() - 2
-      << " file(s) have been written: " << addedFiles.str().c_str() <<". "
-      << "Old name is '" << oldName.c_str() << "'."
-      );
-    return returnString;
-    }
-  // restore the old file name
-  vtkDebugMacro("UpdateFileList: resetting file name to " << oldName.c_str());
-  this->SetFileName(oldName.c_str());
-
-  if (move != 1)
-    {
-    // clean up temp directory
-    vtkDebugMacro("UpdateFileList: removing temp dir " << tempDir);
-    result = vtksys::SystemTools::RemoveADirectory(tempDir.c_str());
-    if (!result)
+    const std::string& thisFile = writtenFileNames[fileNum];
+    vtkDebugMacro("AddWrittenFileNames: adding file number " << fileNum << ", " << thisFile);
+    if (newArchetype == thisFile)
       {
-      vtkErrorMacro("UpdateFileList: failed to remove temp dir '"
-                    << tempDir.c_str() << "'." );
-      return returnString;
+      addedArchetype = true;
       }
-    return std::string("");
-    }
-  else
-    {
-    vtkDebugMacro("UpdateFileList: returning temp dir " << tempDir);
-    return tempDir;
+    // at this point, the file name is bare of a directory, turn it into a
+    // relative path from the original archetype
+    relativePathComponents.push_back(thisFile);
+    std::string relativeFile =  vtksys::SystemTools::JoinPath(relativePathComponents);
+    relativePathComponents.pop_back();
+    vtkDebugMacro("AddWrittenFileNames: " << fileNum << ", using relative file name " << relativeFile.c_str());
+    this->AddFileName(relativeFile.c_str());
     }
+  return addedArchetype;
 }
 
 //----------------------------------------------------------------------------
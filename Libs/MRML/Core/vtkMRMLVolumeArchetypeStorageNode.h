@@ -17,8 +17,12 @@
 
 #include "vtkMRMLStorageNode.h"
 
+// VTK includes
+#include <vtkSmartPointer.h>
+
 class vtkImageData;
 class vtkITKArchetypeImageSeriesReader;
+class vtkMatrix4x4;
 class vtkMRMLVolumeNode;
 
 /// \brief MRML node for representing a volume storage.
@@ -73,10 +77,26 @@ public:
   vtkSetMacro(UseOrientationFromFile, int);
   vtkGetMacro(UseOrientationFromFile, int);
 
+  ///
+  /// Map uncompressed NRRD files into memory instead of reading them.
+  /// Voxels are loaded from the file when they are accessed, which makes
+  /// loading of very large scalar volumes fast. Modified voxels are not
+  /// written back to the file. Disabled by default.
+  /// Files that cannot be mapped are read as usual.
+  vtkSetMacro(UseMemoryMapping, int);
+  vtkGetMacro(UseMemoryMapping, int);
+  vtkBooleanMacro(UseMemoryMapping, int);
+
   /// Return true if the reference node is supported by the storage node
   virtual bool CanReadInReferenceNode(vtkMRMLNode* refNode) VTK_OVERRIDE;
   virtual bool CanWriteFromReferenceNode(vtkMRMLNode* refNode) VTK_OVERRIDE;
 
+  /// Volumes can be read and written in a background thread.
+  /// Subclasses are read and written in the main thread unless they override
+  /// these methods.
+  virtual bool CanReadDataInThread(vtkMRMLNode* refNode) VTK_OVERRIDE;
+  virtual bool CanWriteDataInThread(vtkMRMLNode* refNode) VTK_OVERRIDE;
+
   ///
   /// Configure the storage node for data exchange. This is an
   /// opportunity to optimize the storage node's settings, for
@@ -104,12 +124,59 @@ protected:
   /// Read data and set it in the referenced node
   virtual int ReadDataInternal(vtkMRMLNode *refNode) VTK_OVERRIDE;
 
-  /// Write data from a referenced node
+  /// Get the image to write and its properties from the referenced node
+  virtual int PrepareWriteDataInternal(vtkMRMLNode *refNode) VTK_OVERRIDE;
+
+  /// Write WriteImage without accessing the referenced node or the scene
   virtual int WriteDataInternal(vtkMRMLNode *refNode) VTK_OVERRIDE;
 
+  /// Update the file list with the written files
+  virtual int ApplyWriteDataInternal(vtkMRMLNode *refNode, int writeResult) VTK_OVERRIDE;
+
+  /// Write WriteImage into \a fileName. Returns 1 on success, 0 otherwise.
+  int WriteImageFile(const std::string& fileName);
+
+  /// Add the archetype and the files written next to it (names without
+  /// directory) to the file list, relative to the scene root directory.
+  /// Returns false if the archetype is not one of the written files.
+  bool AddWrittenFileNames(vtkMRMLNode *refNode, const std::vector<std::string>& writtenFileNames);
+
+  /// Read the image into ReadImage without modifying the referenced node
+  virtual int ReadDataInThreadInternal(vtkMRMLNode *refNode) VTK_OVERRIDE;
+
+  /// Set ReadImage in the referenced node
+  virtual int ApplyReadDataInternal(vtkMRMLNode *refNode) VTK_OVERRIDE;
+
+  /// Read a scalar volume from a NRRD file by mapping the file into memory.
+  /// Returns -1 if the file cannot be mapped, 0 on error, and 1 on success.
+  int ReadMemoryMappedDataInternal(const std::string& fullName);
+
+  /// Copy the scalars of the image into memory if they are memory mapped from
+  /// the file that is written (or from the data file of its detached header).
+  /// The buffer of the scalar array is replaced, so all the images that share
+  /// the array are detached. Writing a file truncates it, which is not allowed
+  /// while it is mapped.
+  static void DetachMemoryMappedScalars(vtkImageData* imageData, const std::string& fullName);
+
+  /// Image read by ReadDataInThreadInternal() and its properties,
+  /// until they are set in the volume node by ApplyReadDataInternal()
+  vtkSmartPointer<vtkImageData> ReadImage;
+  vtkSmartPointer<vtkMatrix4x4> ReadRASToIJKMatrix;
+  /// Reader of ReadImage, NULL if the file was memory mapped
+  vtkSmartPointer<vtkITKArchetypeImageSeriesReader> ReadImageReader;
+
+  /// Image to write and its properties, set by PrepareWriteDataInternal()
+  vtkSmartPointer<vtkImageData> WriteImage;
+  vtkSmartPointer<vtkMatrix4x4> WriteRASToIJKMatrix;
+  std::string WriteImageIOClassName;
+  std::string WriteFullName;
+  /// Files written by WriteDataInternal(), without directory
+  std::vector<std::string> WrittenFileNames;
+
   int CenterImage;
   int SingleFile;
   int UseOrientationFromFile;
+  int UseMemoryMapping;
 
 };
 
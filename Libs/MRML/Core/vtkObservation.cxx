@@ -46,6 +46,9 @@ vtkObservation::vtkObservation()
 
   this->LastElapsedTime = 0.0;
   this->TotalElapsedTime = 0.0;
+
+  this->SubjectObservationsIndex = 0;
+  this->ObserverObservationsIndex = 0;
 }
 
 //----------------------------------------------------------------------------
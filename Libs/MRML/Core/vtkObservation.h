@@ -160,6 +160,14 @@ protected:
   double LastElapsedTime;
   double TotalElapsedTime;
 
+  ///
+  /// Position of the observation in the broker's flat lists of observations
+  /// of the subject and of the observer. They allow the broker to remove the
+  /// observation in constant time.
+  size_t SubjectObservationsIndex;
+  size_t ObserverObservationsIndex;
+
+  friend class vtkEventBroker;
 };
 
 //----------------------------------------------------------------------------
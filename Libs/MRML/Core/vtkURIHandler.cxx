@@ -5,6 +5,12 @@
 // VTK includes
 #include <vtkObjectFactory.h>
 
+// VTKsys includes
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <cstdio>
+
 vtkStandardNewMacro ( vtkURIHandler );
 vtkCxxSetObjectMacro( vtkURIHandler, PermissionPrompter, vtkPermissionPrompter );
 //----------------------------------------------------------------------------
@@ -111,6 +117,43 @@ void vtkURIHandler::StageFileWrite ( const char * vtkNotUsed( source ), const ch
 {
 }
 
+//----------------------------------------------------------------------------
+std::vector<bool> vtkURIHandler::StageFilesRead(const std::vector<std::string>& sources,
+                                                const std::vector<std::string>& destinations)
+{
+  std::vector<bool> downloaded(sources.size(), false);
+  if (sources.size() != destinations.size())
+    {
+    vtkErrorMacro("StageFilesRead: number of sources and destinations differ");
+    return downloaded;
+    }
+  for (size_t fileIndex = 0; fileIndex < sources.size(); ++fileIndex)
+    {
+    // StageFileRead does not report errors: move the file that is in the
+    // destination aside, so that a failed transfer can be detected and the
+    // previous file restored
+    const std::string& destination = destinations[fileIndex];
+    std::string previousFileName = destination + ".previous";
+    bool previousFileExists = vtksys::SystemTools::FileExists(destination.c_str(), true)
+      && rename(destination.c_str(), previousFileName.c_str()) == 0;
+    this->StageFileRead(sources[fileIndex].c_str(), destination.c_str());
+    downloaded[fileIndex] = vtksys::SystemTools::FileExists(destination.c_str(), true);
+    if (!previousFileExists)
+      {
+      continue;
+      }
+    if (downloaded[fileIndex])
+      {
+      vtksys::SystemTools::RemoveFile(previousFileName.c_str());
+      }
+    else
+      {
+      rename(previousFileName.c_str(), destination.c_str());
+      }
+    }
+  return downloaded;
+}
+
 //----------------------------------------------------------------------------
 void vtkURIHandler::StageFileRead(const char * vtkNotUsed( source ),
                              const char * vtkNotUsed( destination ),
@@ -8,6 +8,10 @@ class vtkPermissionPrompter;
 // VTK includes
 #include <vtkObject.h>
 
+// STD includes
+#include <string>
+#include <vector>
+
 class VTK_MRML_EXPORT vtkURIHandler : public vtkObject
 {
 public:
@@ -40,6 +44,15 @@ public:
                               const char *hostname,
                               const char *sessionID );
 
+  ///
+  /// Download several files. The default implementation calls StageFileRead
+  /// for each file, handlers that can run transfers concurrently should
+  /// override it. sources and destinations must have the same size.
+  /// Returns for each file whether it was downloaded. A file that was in the
+  /// destination before is not reported as downloaded if the transfer failed.
+  virtual std::vector<bool> StageFilesRead(const std::vector<std::string>& sources,
+                                           const std::vector<std::string>& destinations);
+
   /// need something that goes the other way too...
 
   ///
@@ -938,7 +938,7 @@ void vtkMRMLModelDisplayableManager
   if (tnode != 0 && !tnode->IsTransformToWorldLinear())
     {
     hasNonLinearTransform = true;
-    tnode->GetTransformToWorld(worldTransform);
+    tnode->GetDisplayTransformToWorld(worldTransform);
     }
 
   for (i=0; i<ndnodes; i++)
@@ -43,6 +43,7 @@
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkPlane.h>
+#include <vtkPolyData.h>
 #include <vtkPolyDataMapper2D.h>
 #include <vtkProperty2D.h>
 #include <vtkRenderer.h>
@@ -59,6 +60,9 @@
 #include <vtkCutter.h>
 #include <vtkSampleImplicitFunctionFilter.h>
 
+// vtkAddon includes
+#include <vtkIndexedPlaneCutter.h>
+
 // STD includes
 #include <algorithm>
 #include <cassert>
@@ -81,6 +85,11 @@ public:
     vtkSmartPointer<vtkTransformFilter> ModelWarper;
     vtkSmartPointer<vtkPlane> Plane;
     vtkSmartPointer<vtkCutter> Cutter;
+    /// Used instead of Cutter when the model transform is linear:
+    /// the mesh is cut in its own coordinate system with a cell index
+    /// that is shared by all the slice views.
+    vtkSmartPointer<vtkIndexedPlaneCutter> IndexedCutter;
+    vtkSmartPointer<vtkPlane> NodePlane;
     vtkSmartPointer<vtkSampleImplicitFunctionFilter> SliceDistance;
     vtkSmartPointer<vtkProp> Actor;
     };
@@ -271,7 +280,7 @@ void vtkMRMLModelSliceDisplayableManager::vtkInternal
   transformToWorld->Identity();
   if (tnode)
     {
-    tnode->GetTransformToWorld(transformToWorld);
+    tnode->GetDisplayTransformToWorld(transformToWorld);
     }
 }
 
@@ -339,6 +348,8 @@ void vtkMRMLModelSliceDisplayableManager::vtkInternal
   Pipeline* pipeline = new Pipeline();
   pipeline->Actor = actor.GetPointer();
   pipeline->Cutter = vtkSmartPointer<vtkCutter>::New();
+  pipeline->IndexedCutter = vtkSmartPointer<vtkIndexedPlaneCutter>::New();
+  pipeline->NodePlane = vtkSmartPointer<vtkPlane>::New();
   pipeline->SliceDistance = vtkSmartPointer<vtkSampleImplicitFunctionFilter>::New();
   pipeline->TransformToSlice = vtkSmartPointer<vtkTransform>::New();
   pipeline->NodeToWorld = vtkSmartPointer<vtkGeneralTransform>::New();
@@ -353,6 +364,7 @@ void vtkMRMLModelSliceDisplayableManager::vtkInternal
   pipeline->Cutter->SetCutFunction(pipeline->Plane);
   pipeline->Cutter->SetGenerateCutScalars(0);
   pipeline->Cutter->SetInputConnection(pipeline->ModelWarper->GetOutputPort());
+  pipeline->IndexedCutter->SetPlane(pipeline->NodePlane);
   // Projection is created from outer surface of volumetric meshes (for polydata surface
   // extraction is just shallow-copy)
   pipeline->SurfaceExtractor->SetInputConnection(pipeline->ModelWarper->GetOutputPort());
@@ -472,15 +484,56 @@ void vtkMRMLModelSliceDisplayableManager::vtkInternal
     }
   else
     {
-    // show intersection in the slice view
-    // include clipper in the pipeline
-    pipeline->Transformer->SetInputConnection(pipeline->Cutter->GetOutputPort());
-    pipeline->Cutter->SetInputConnection(pipeline->ModelWarper->GetOutputPort());
-
-    //  Set Poly Data Transform
     vtkNew<vtkMatrix4x4> rasToSliceXY;
     vtkMatrix4x4::Invert(this->SliceXYToRAS, rasToSliceXY.GetPointer());
-    pipeline->TransformToSlice->SetMatrix(rasToSliceXY.GetPointer());
+
+    vtkPolyData* polyData = vtkPolyData::SafeDownCast(pointSet);
+    vtkNew<vtkTransform> nodeToWorld;
+    if (polyData && vtkMRMLTransformNode::IsGeneralTransformLinear(pipeline->NodeToWorld, nodeToWorld.GetPointer()))
+      {
+      // show intersection in the slice view
+      // the mesh is cut in its own coordinate system, so that its cell index
+      // does not depend on the transform and can be shared between views
+      pipeline->IndexedCutter->SetInputData(polyData);
+      pipeline->Transformer->SetInputConnection(pipeline->IndexedCutter->GetOutputPort());
+
+      // Transform the slice plane to the model coordinate system
+      // (plane normal is transformed by the transpose of the node to world matrix)
+      vtkMatrix4x4* nodeToWorldMatrix = nodeToWorld->GetMatrix();
+      double worldNormal[3] = { 0.0, 0.0, 1.0 };
+      double worldOrigin[4] = { 0.0, 0.0, 0.0, 1.0 };
+      pipeline->Plane->GetNormal(worldNormal);
+      pipeline->Plane->GetOrigin(worldOrigin);
+      double nodeNormal[3] = { 0.0, 0.0, 0.0 };
+      for (int i = 0; i < 3; i++)
+        {
+        for (int j = 0; j < 3; j++)
+          {
+          nodeNormal[i] += nodeToWorldMatrix->GetElement(j, i) * worldNormal[j];
+          }
+        }
+      vtkNew<vtkMatrix4x4> worldToNodeMatrix;
+      vtkMatrix4x4::Invert(nodeToWorldMatrix, worldToNodeMatrix.GetPointer());
+      double nodeOrigin[4] = { 0.0, 0.0, 0.0, 1.0 };
+      worldToNodeMatrix->MultiplyPoint(worldOrigin, nodeOrigin);
+      pipeline->NodePlane->SetNormal(nodeNormal);
+      pipeline->NodePlane->SetOrigin(nodeOrigin);
+
+      //  Set Poly Data Transform
+      vtkNew<vtkMatrix4x4> nodeToSliceXY;
+      vtkMatrix4x4::Multiply4x4(rasToSliceXY.GetPointer(), nodeToWorldMatrix, nodeToSliceXY.GetPointer());
+      pipeline->TransformToSlice->SetMatrix(nodeToSliceXY.GetPointer());
+      }
+    else
+      {
+      // show intersection in the slice view
+      // include clipper in the pipeline
+      pipeline->Transformer->SetInputConnection(pipeline->Cutter->GetOutputPort());
+      pipeline->Cutter->SetInputConnection(pipeline->ModelWarper->GetOutputPort());
+
+      //  Set Poly Data Transform
+      pipeline->TransformToSlice->SetMatrix(rasToSliceXY.GetPointer());
+      }
 
     // optimization for slice to slice intersections which are 1 quad polydatas
     // no need for 50^3 default locator divisons
@@ -0,0 +1,110 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRMLLogic includes
+#include "vtkImageCachedReslice.h"
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkTransform.h>
+
+//----------------------------------------------------------------------------
+int vtkImageCachedResliceTest1(int , char * [] )
+{
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(20, 20, 20);
+  image->AllocateScalars(VTK_SHORT, 1);
+  short* voxels = static_cast<short*>(image->GetScalarPointer());
+  for (int i = 0; i < 20 * 20 * 20; ++i)
+    {
+    voxels[i] = static_cast<short>(i / 400); // voxel value is the slice index
+    }
+
+  vtkNew<vtkTransform> transform;
+  vtkNew<vtkImageCachedReslice> reslice;
+  EXERCISE_BASIC_OBJECT_METHODS(reslice.GetPointer());
+  reslice->SetInputData(image.GetPointer());
+  reslice->SetResliceTransform(transform.GetPointer());
+  reslice->SetOutputExtent(0, 19, 0, 19, 0, 0);
+  reslice->SetInterpolationModeToNearestNeighbor();
+  reslice->SetCacheSize(2);
+
+  // Each new slice is resliced
+  transform->Translate(0, 0, 5);
+  reslice->Update();
+  CHECK_DOUBLE(reslice->GetOutput()->GetScalarComponentAsDouble(3, 3, 0, 0), 5.0);
+  transform->Translate(0, 0, 5);
+  reslice->Update();
+  CHECK_DOUBLE(reslice->GetOutput()->GetScalarComponentAsDouble(3, 3, 0, 0), 10.0);
+  CHECK_INT(reslice->GetNumberOfCacheHits(), 0);
+  CHECK_INT(reslice->GetNumberOfCachedOutputs(), 2);
+
+  // Going back to a previous slice uses the cache
+  transform->Translate(0, 0, -5);
+  reslice->Update();
+  CHECK_DOUBLE(reslice->GetOutput()->GetScalarComponentAsDouble(3, 3, 0, 0), 5.0);
+  CHECK_INT(reslice->GetNumberOfCacheHits(), 1);
+
+  // Least recently used slice is removed from the cache
+  transform->Translate(0, 0, 10);
+  reslice->Update();
+  CHECK_DOUBLE(reslice->GetOutput()->GetScalarComponentAsDouble(3, 3, 0, 0), 15.0);
+  transform->Translate(0, 0, -5);
+  reslice->Update();
+  CHECK_DOUBLE(reslice->GetOutput()->GetScalarComponentAsDouble(3, 3, 0, 0), 10.0);
+  CHECK_INT(reslice->GetNumberOfCacheHits(), 1);
+  CHECK_INT(reslice->GetNumberOfCachedOutputs(), 2);
+
+  // Modified input invalidates the cache
+  voxels[3 + 3 * 20 + 15 * 400] = 100;
+  image->Modified();
+  transform->Translate(0, 0, 5);
+  reslice->Update();
+  CHECK_DOUBLE(reslice->GetOutput()->GetScalarComponentAsDouble(3, 3, 0, 0), 100.0);
+  CHECK_INT(reslice->GetNumberOfCacheHits(), 1);
+  CHECK_INT(reslice->GetNumberOfCachedOutputs(), 1);
+
+  // Outputs computed with other slab settings are not reused
+  reslice->SetSlabModeToMean();
+  reslice->SetSlabNumberOfSlices(3);
+  reslice->Update();
+  CHECK_DOUBLE_TOLERANCE(reslice->GetOutput()->GetScalarComponentAsDouble(3, 3, 0, 0), (14.0 + 100.0 + 16.0) / 3.0, 1.0);
+  CHECK_INT(reslice->GetNumberOfCacheHits(), 1);
+  reslice->SetSlabNumberOfSlices(1);
+  reslice->Update();
+  CHECK_DOUBLE(reslice->GetOutput()->GetScalarComponentAsDouble(3, 3, 0, 0), 100.0);
+  CHECK_INT(reslice->GetNumberOfCacheHits(), 2);
+
+  // Outputs of another output scalar type are not reused
+  reslice->SetOutputScalarType(VTK_FLOAT);
+  reslice->Update();
+  CHECK_INT(reslice->GetOutput()->GetScalarType(), VTK_FLOAT);
+  CHECK_INT(reslice->GetNumberOfCacheHits(), 2);
+  reslice->SetOutputScalarType(-1);
+
+  // Cache can be disabled
+  reslice->SetCacheSize(0);
+  CHECK_INT(reslice->GetNumberOfCachedOutputs(), 0);
+  transform->Translate(0, 0, -5);
+  reslice->Update();
+  CHECK_DOUBLE(reslice->GetOutput()->GetScalarComponentAsDouble(3, 3, 0, 0), 10.0);
+  CHECK_INT(reslice->GetNumberOfCacheHits(), 2);
+
+  return EXIT_SUCCESS;
+}
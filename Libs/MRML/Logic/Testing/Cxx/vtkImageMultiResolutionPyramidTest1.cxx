@@ -0,0 +1,163 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRMLLogic includes
+#include "vtkImageMultiResolutionPyramid.h"
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+
+// VTKsys includes
+#include <vtksys/SystemTools.hxx>
+
+
+//----------------------------------------------------------------------------
+int vtkImageMultiResolutionPyramidTest1(int argc, char * argv[] )
+{
+  if (argc < 2)
+    {
+    std::cerr << "Usage: " << argv[0] << " /path/to/temp" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(64, 64, 64);
+  image->AllocateScalars(VTK_SHORT, 1);
+  short* voxels = static_cast<short*>(image->GetScalarPointer());
+  for (int i = 0; i < 64 * 64 * 64; ++i)
+    {
+    voxels[i] = static_cast<short>(2 * (i % 64)); // voxel value is twice the column index
+    }
+
+  vtkNew<vtkImageMultiResolutionPyramid> pyramid;
+  EXERCISE_BASIC_OBJECT_METHODS(pyramid.GetPointer());
+  pyramid->SetMinimumLevelSize(16);
+  pyramid->SetInputData(image.GetPointer());
+  pyramid->Update();
+
+  // Levels are created until the level size is not larger than the minimum
+  CHECK_INT(pyramid->GetNumberOfLevels(), 3);
+  CHECK_POINTER(pyramid->GetLevelImage(0), image.GetPointer());
+  CHECK_INT(pyramid->GetLevelImage(2)->GetDimensions()[0], 16);
+  CHECK_INT(pyramid->GetLevelImage(2)->GetDimensions()[2], 16);
+  CHECK_NULL(pyramid->GetLevelImage(3));
+  int factors[3] = { 0, 0, 0 };
+  pyramid->GetLevelShrinkFactors(2, factors);
+  CHECK_INT(factors[0], 4);
+  CHECK_INT(factors[2], 4);
+
+  // Voxels are averaged
+  CHECK_DOUBLE(pyramid->GetLevelImage(1)->GetScalarComponentAsDouble(5, 3, 3, 0), 21.0);
+  CHECK_DOUBLE(pyramid->GetLevelImage(2)->GetScalarComponentAsDouble(5, 3, 3, 0), 43.0);
+
+  // Averaged voxel is at the center of the full resolution voxels
+  vtkNew<vtkMatrix4x4> fullResolutionToLevel;
+  pyramid->GetFullResolutionToLevelMatrix(2, fullResolutionToLevel.GetPointer());
+  double fullResolutionPoint[4] = { 21.5, 0.0, 0.0, 1.0 };
+  double levelPoint[4] = { 0.0, 0.0, 0.0, 1.0 };
+  fullResolutionToLevel->MultiplyPoint(fullResolutionPoint, levelPoint);
+  CHECK_DOUBLE_TOLERANCE(levelPoint[0], 5.0, 1e-6);
+
+  // Coarsest level that has a voxel for each sample is selected
+  CHECK_INT(pyramid->GetLevelForSampleSpacing(0.5), 0);
+  CHECK_INT(pyramid->GetLevelForSampleSpacing(1.0), 0);
+  CHECK_INT(pyramid->GetLevelForSampleSpacing(3.0), 1);
+  CHECK_INT(pyramid->GetLevelForSampleSpacing(10.0), 2);
+
+  // Voxels are subsampled if averaging is disabled
+  pyramid->SetAveraging(false);
+  pyramid->Update();
+  CHECK_DOUBLE(pyramid->GetLevelImage(2)->GetScalarComponentAsDouble(5, 3, 3, 0), 40.0);
+  pyramid->GetFullResolutionToLevelMatrix(2, fullResolutionToLevel.GetPointer());
+  CHECK_DOUBLE(fullResolutionToLevel->GetElement(0, 0), 0.25);
+  CHECK_DOUBLE(fullResolutionToLevel->GetElement(0, 3), 0.0);
+
+  // Modified input updates the levels
+  voxels[20 + 12 * 64 + 12 * 64 * 64] = 1000;
+  image->Modified();
+  pyramid->Update();
+  CHECK_DOUBLE(pyramid->GetLevelImage(2)->GetScalarComponentAsDouble(5, 3, 3, 0), 1000.0);
+  pyramid->SetAveraging(true);
+
+  // Levels are stored in the cache directory and reused by the next pyramid
+  std::string tempDir = argv[1];
+  std::string cacheDirectory = tempDir + "/vtkImageMultiResolutionPyramidTest1.pyramid";
+  vtksys::SystemTools::RemoveADirectory(cacheDirectory.c_str());
+
+  pyramid->SetCacheDirectory(cacheDirectory);
+  pyramid->Update();
+  CHECK_INT(pyramid->GetNumberOfLevels(), 3);
+  std::string level2FileName = pyramid->GetLevelFileName(2);
+  CHECK_BOOL(vtksys::SystemTools::FileExists(level2FileName.c_str(), true), true);
+  CHECK_DOUBLE(pyramid->GetLevelImage(2)->GetScalarComponentAsDouble(5, 3, 3, 0), 43.0 + (1000.0 - 40.0) / 64.0);
+
+  vtkNew<vtkImageMultiResolutionPyramid> cachedPyramid;
+  cachedPyramid->SetMinimumLevelSize(16);
+  cachedPyramid->SetCacheDirectory(cacheDirectory);
+  cachedPyramid->SetInputData(image.GetPointer());
+  cachedPyramid->Update();
+  CHECK_INT(cachedPyramid->GetNumberOfLevels(), 3);
+  CHECK_STD_STRING(cachedPyramid->GetLevelFileName(2), level2FileName);
+  CHECK_DOUBLE(cachedPyramid->GetLevelImage(1)->GetScalarComponentAsDouble(5, 3, 3, 0), 21.0);
+  CHECK_DOUBLE(cachedPyramid->GetLevelImage(2)->GetScalarComponentAsDouble(5, 3, 3, 0),
+    pyramid->GetLevelImage(2)->GetScalarComponentAsDouble(5, 3, 3, 0));
+
+  // Cached levels are not reused for different voxel content of the same size
+  voxels[20 + 12 * 64 + 12 * 64 * 64] = 40;
+  image->Modified();
+  cachedPyramid->Update();
+  CHECK_STD_STRING_DIFFERENT(cachedPyramid->GetLevelFileName(2), level2FileName);
+  CHECK_DOUBLE(cachedPyramid->GetLevelImage(2)->GetScalarComponentAsDouble(5, 3, 3, 0), 43.0);
+  // Levels of the previous content are removed from the cache
+  CHECK_BOOL(vtksys::SystemTools::FileExists(level2FileName.c_str(), true), false);
+
+  // Levels are built in the background
+  vtkNew<vtkImageMultiResolutionPyramid> backgroundPyramid;
+  backgroundPyramid->SetMinimumLevelSize(16);
+  backgroundPyramid->SetUpdateInBackground(true);
+  backgroundPyramid->SetInputData(image.GetPointer());
+  backgroundPyramid->Update();
+  backgroundPyramid->WaitForBackgroundUpdate();
+  CHECK_INT(backgroundPyramid->GetNumberOfLevels(), 3);
+  CHECK_DOUBLE(backgroundPyramid->GetLevelImage(2)->GetScalarComponentAsDouble(5, 3, 3, 0), 43.0);
+
+  // Levels of the previous content are not used while the new ones are built
+  voxels[20 + 12 * 64 + 12 * 64 * 64] = 1000;
+  image->Modified();
+  backgroundPyramid->Update();
+  if (backgroundPyramid->GetNumberOfLevels() == 3)
+    {
+    // completed already
+    CHECK_DOUBLE(backgroundPyramid->GetLevelImage(2)->GetScalarComponentAsDouble(5, 3, 3, 0), 43.0 + (1000.0 - 40.0) / 64.0);
+    }
+  backgroundPyramid->WaitForBackgroundUpdate();
+  CHECK_INT(backgroundPyramid->GetNumberOfLevels(), 3);
+  CHECK_DOUBLE(backgroundPyramid->GetLevelImage(2)->GetScalarComponentAsDouble(5, 3, 3, 0), 43.0 + (1000.0 - 40.0) / 64.0);
+
+  // A pyramid that is deleted while it builds levels waits for the thread
+  vtkImageMultiResolutionPyramid* deletedPyramid = vtkImageMultiResolutionPyramid::New();
+  deletedPyramid->SetUpdateInBackground(true);
+  deletedPyramid->SetMinimumLevelSize(16);
+  deletedPyramid->SetInputData(image.GetPointer());
+  deletedPyramid->Update();
+  deletedPyramid->Delete();
+
+  return EXIT_SUCCESS;
+}
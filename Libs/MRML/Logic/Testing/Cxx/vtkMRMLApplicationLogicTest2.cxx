@@ -0,0 +1,112 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// MRML includes
+#include "vtkMRMLApplicationLogic.h"
+#include "vtkMRMLCoreTestingMacros.h"
+#include <vtkMRMLModelNode.h>
+#include <vtkMRMLScene.h>
+
+// VTK includes
+#include <vtkCollection.h>
+#include <vtkCylinderSource.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+
+// VTKsys includes
+#include <vtksys/Glob.hxx>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <set>
+#include <sstream>
+
+//-----------------------------------------------------------------------------
+int vtkMRMLApplicationLogicTest2(int argc, char * argv[])
+{
+  if (argc != 2)
+    {
+    std::cerr << "Usage: " << argv[0] << " /path/to/temp" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::string tempDir = std::string(argv[1]) + "/vtkMRMLApplicationLogicTest2";
+  vtksys::SystemTools::RemoveADirectory(tempDir.c_str());
+  CHECK_BOOL(vtksys::SystemTools::MakeDirectory(tempDir.c_str()), true);
+
+  // Data bundles are the same whether nodes are written in the main thread
+  // or in parallel threads
+  int numberOfThreads[2] = {1, 4};
+  for (int n = 0; n < 2; ++n)
+    {
+    std::stringstream bundleName;
+    bundleName << "Bundle" << numberOfThreads[n];
+    std::string bundleDir = tempDir + "/" + bundleName.str();
+    std::string bundleFile = bundleDir + ".mrb";
+    vtksys::SystemTools::MakeDirectory(bundleDir.c_str());
+
+    std::set<int> numberOfPoints;
+    {
+      vtkNew<vtkMRMLScene> scene;
+      vtkNew<vtkMRMLApplicationLogic> appLogic;
+      appLogic->SetMRMLScene(scene.GetPointer());
+      appLogic->SetNumberOfDataBundleThreads(numberOfThreads[n]);
+      CHECK_INT(appLogic->GetNumberOfDataBundleThreads(), numberOfThreads[n]);
+
+      // All the models have the same name, their files must not overwrite each other
+      for (int i = 0; i < 5; ++i)
+        {
+        vtkNew<vtkCylinderSource> cylinder;
+        cylinder->SetResolution(10 + i * 10);
+        cylinder->Update();
+        vtkNew<vtkMRMLModelNode> modelNode;
+        modelNode->SetName("Model");
+        modelNode->SetAndObservePolyData(cylinder->GetOutput());
+        CHECK_NOT_NULL(scene->AddNode(modelNode.GetPointer()));
+        numberOfPoints.insert(cylinder->GetOutput()->GetNumberOfPoints());
+        }
+
+      CHECK_BOOL(appLogic->SaveSceneToSlicerDataBundleDirectory(bundleDir.c_str()), true);
+      vtksys::Glob glob;
+      CHECK_BOOL(glob.FindFiles(bundleDir + "/Data/*.vtk"), true);
+      CHECK_INT(static_cast<int>(glob.GetFiles().size()), 5);
+
+      CHECK_BOOL(appLogic->Zip(bundleFile.c_str(), bundleDir.c_str()), true);
+      appLogic->SetMRMLScene(NULL);
+    }
+
+    // Open the bundle in a new scene
+    std::string extractDir = bundleDir + "Extracted";
+    vtksys::SystemTools::MakeDirectory(extractDir.c_str());
+    vtkNew<vtkMRMLScene> scene;
+    vtkNew<vtkMRMLApplicationLogic> appLogic;
+    appLogic->SetMRMLScene(scene.GetPointer());
+    CHECK_BOOL(appLogic->OpenSlicerDataBundle(bundleFile.c_str(), extractDir.c_str()), true);
+
+    vtkSmartPointer<vtkCollection> modelNodes =
+      vtkSmartPointer<vtkCollection>::Take(scene->GetNodesByClass("vtkMRMLModelNode"));
+    CHECK_INT(modelNodes->GetNumberOfItems(), 5);
+    std::set<int> readNumberOfPoints;
+    for (int i = 0; i < modelNodes->GetNumberOfItems(); ++i)
+      {
+      vtkMRMLModelNode* modelNode = vtkMRMLModelNode::SafeDownCast(modelNodes->GetItemAsObject(i));
+      CHECK_NOT_NULL(modelNode->GetPolyData());
+      readNumberOfPoints.insert(modelNode->GetPolyData()->GetNumberOfPoints());
+      }
+    CHECK_BOOL(readNumberOfPoints == numberOfPoints, true);
+    appLogic->SetMRMLScene(NULL);
+    }
+
+  return EXIT_SUCCESS;
+}
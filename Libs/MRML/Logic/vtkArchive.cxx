@@ -22,6 +22,7 @@
 // STD includes
 #include <cstring>
 #include <iostream>
+#include <vector>
 
 namespace
 {
@@ -215,6 +216,11 @@ long copy_data(struct archive *ar, struct archive *aw)
   return r;
 }
 
+// --------------------------------------------------------------------------
+// Size of the blocks that are read from the files and from the archives,
+// large blocks make writing and extracting big volumes I/O bound.
+const size_t vtkArchiveBlockSize = 1024 * 1024;
+
 } // end of anonymous namespace
 
 //-----------------------------------------------------------------------------
@@ -388,7 +394,7 @@ bool zip(const char* zipFileName, const char* directoryToZip)
   // now zip it up using LibArchive
   struct archive *zipArchive;
   struct archive_entry *entry, *dirEntry;
-  char buff[BUFSIZ];
+  std::vector<char> buff(vtkArchiveBlockSize);
   size_t len;
   // have to read the contents of the files to add them to the archive
   FILE *fd;
@@ -424,7 +430,6 @@ bool zip(const char* zipFileName, const char* directoryToZip)
     {
     vtkArchiveTools::Message("Zip: adding:", (*sit).c_str());
     const char *fileName = (*sit).c_str();
-    ++sit;
 
     //
     // add an entry for this file
@@ -451,19 +456,20 @@ bool zip(const char* zipFileName, const char* directoryToZip)
     fd = fopen(fileName, "rb");
     if (!fd)
       {
-      vtkArchiveTools::Error("Zip: cannot open:", (*sit).c_str());
+      vtkArchiveTools::Error("Zip: cannot open:", fileName);
       }
     else
       {
-      len = fread(buff, sizeof(char), sizeof(buff), fd);
+      len = fread(&buff[0], sizeof(char), buff.size(), fd);
       while ( len > 0 )
         {
-        archive_write_data(zipArchive, buff, len);
-        len = fread(buff, sizeof(char), sizeof(buff), fd);
+        archive_write_data(zipArchive, &buff[0], len);
+        len = fread(&buff[0], sizeof(char), buff.size(), fd);
         }
       fclose(fd);
       }
     archive_entry_free(entry);
+    ++sit;
     }
 
   archive_write_close(zipArchive);
@@ -483,12 +489,12 @@ bool unzip(const char* zipFileName, const char* destinationDirectory)
   //
   // Unziping the archive
   // - check that files and directories exist
-  // - cd to destination
   // - create an extracter from the file
   // - create a writer to disk
-  // - read all headers and data into disk
+  // - read all headers and data into disk, prefixing the entry paths
+  //   with the destination (the current directory is not changed so that
+  //   other threads are not affected)
   // - close up the archives
-  // - cd back to original directory
   //
 
   if ( !zipFileName || !destinationDirectory )
@@ -509,13 +515,8 @@ bool unzip(const char* zipFileName, const char* destinationDirectory)
     return false;
     }
 
-  std::string cwd = vtksys::SystemTools::GetCurrentWorkingDirectory(true);
-
-  if ( vtksys::SystemTools::ChangeDirectory(destinationDirectory) )
-    {
-    vtkArchiveTools::Error("Unzip:", "could not change to destination directory");
-    return false;
-    }
+  std::string destination =
+    vtksys::SystemTools::CollapseFullPath(destinationDirectory) + "/";
 
   struct archive *zipArchive;
   struct archive *diskDestination;
@@ -526,16 +527,18 @@ bool unzip(const char* zipFileName, const char* destinationDirectory)
   // we will typically have zip files, but support all archive types (why not?)
   archive_read_support_filter_all(zipArchive);
   archive_read_support_format_all(zipArchive);
-  // Note: the 10240 is just a suggested block size
-  result = archive_read_open_filename(zipArchive, zipFileName, 10240);
+  result = archive_read_open_filename(zipArchive, zipFileName, vtkArchiveBlockSize);
   if (result != ARCHIVE_OK)
     {
     vtkArchiveTools::Error("Unzip:", "Cannot open archive file");
+    archive_read_free(zipArchive);
     return false;
     }
 
   diskDestination = archive_write_disk_new();
   archive_write_disk_set_standard_lookup(diskDestination);
+  // entries must not escape the destination directory
+  archive_write_disk_set_options(diskDestination, ARCHIVE_EXTRACT_SECURE_NODOTDOT);
 
   for (;;)
     {
@@ -553,6 +556,13 @@ bool unzip(const char* zipFileName, const char* destinationDirectory)
         break;
         }
       }
+    std::string entryPath = destination + archive_entry_pathname(entry);
+    archive_entry_copy_pathname(entry, entryPath.c_str());
+    if (archive_entry_hardlink(entry))
+      {
+      std::string linkPath = destination + archive_entry_hardlink(entry);
+      archive_entry_copy_hardlink(entry, linkPath.c_str());
+      }
     result = archive_write_header(diskDestination, entry);
     if (result != ARCHIVE_OK)
       {
@@ -620,12 +630,5 @@ bool unzip(const char* zipFileName, const char* destinationDirectory)
     return false;
     }
 
-
-  if ( vtksys::SystemTools::ChangeDirectory(cwd.c_str()) )
-    {
-    vtkArchiveTools::Error("Unzip:", "could not change back to working directory");
-    return false;
-    }
-
   return (result == ARCHIVE_OK);
 }
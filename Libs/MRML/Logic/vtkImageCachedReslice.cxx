@@ -0,0 +1,269 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#include "vtkImageCachedReslice.h"
+
+// VTK includes
+#include <vtkAbstractImageInterpolator.h>
+#include <vtkAddonMathUtilities.h>
+#include <vtkHomogeneousTransform.h>
+#include <vtkImageData.h>
+#include <vtkImageStencilData.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkStreamingDemandDrivenPipeline.h>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkImageCachedReslice);
+
+//----------------------------------------------------------------------------
+vtkImageCachedReslice::vtkImageCachedReslice()
+{
+  this->CacheSize = 0;
+  this->NumberOfCacheHits = 0;
+  this->CachedInput = NULL;
+  this->CachedInputTime = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkImageCachedReslice::~vtkImageCachedReslice()
+{
+  this->ClearCache();
+}
+
+//----------------------------------------------------------------------------
+void vtkImageCachedReslice::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "CacheSize: " << this->CacheSize << "\n";
+  os << indent << "NumberOfCachedOutputs: " << this->CachedOutputs.size() << "\n";
+  os << indent << "NumberOfCacheHits: " << this->NumberOfCacheHits << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkImageCachedReslice::SetCacheSize(int cacheSize)
+{
+  if (cacheSize < 0)
+    {
+    cacheSize = 0;
+    }
+  if (this->CacheSize == cacheSize)
+    {
+    return;
+    }
+  this->CacheSize = cacheSize;
+  while (this->CachedOutputs.size() > static_cast<size_t>(this->CacheSize))
+    {
+    this->CachedOutputs.pop_back();
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkImageCachedReslice::ClearCache()
+{
+  this->CachedOutputs.clear();
+  this->CachedInput = NULL;
+  this->CachedInputTime = 0;
+}
+
+//----------------------------------------------------------------------------
+int vtkImageCachedReslice::GetNumberOfCachedOutputs()
+{
+  return static_cast<int>(this->CachedOutputs.size());
+}
+
+//----------------------------------------------------------------------------
+bool vtkImageCachedReslice::GetLinearResliceMatrix(vtkMatrix4x4* resliceMatrix)
+{
+  resliceMatrix->Identity();
+  if (this->ResliceAxes)
+    {
+    resliceMatrix->DeepCopy(this->ResliceAxes);
+    }
+  if (this->ResliceTransform)
+    {
+    vtkHomogeneousTransform* linearTransform = vtkHomogeneousTransform::SafeDownCast(this->ResliceTransform);
+    if (!linearTransform)
+      {
+      // non-linear transforms are not cached
+      return false;
+      }
+    linearTransform->Update();
+    vtkMatrix4x4::Multiply4x4(linearTransform->GetMatrix(), resliceMatrix, resliceMatrix);
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkImageCachedReslice::GetResliceSettings(CachedOutput& settings)
+{
+  double* outputSpacing = this->GetOutputSpacing();
+  double* outputOrigin = this->GetOutputOrigin();
+  double* backgroundColor = this->GetBackgroundColor();
+  for (int i = 0; i < 3; ++i)
+    {
+    settings.OutputSpacing[i] = outputSpacing[i];
+    settings.OutputOrigin[i] = outputOrigin[i];
+    }
+  for (int i = 0; i < 4; ++i)
+    {
+    settings.BackgroundColor[i] = backgroundColor[i];
+    }
+  settings.InterpolationMode = this->GetInterpolationMode();
+  settings.SlabMode = this->SlabMode;
+  settings.SlabNumberOfSlices = this->SlabNumberOfSlices;
+  settings.SlabTrapezoidIntegration = this->SlabTrapezoidIntegration;
+  settings.SlabSliceSpacingFraction = this->SlabSliceSpacingFraction;
+  settings.Wrap = this->Wrap;
+  settings.Mirror = this->Mirror;
+  settings.Border = this->Border;
+  settings.OutputScalarType = this->OutputScalarType;
+  settings.ScalarShift = this->ScalarShift;
+  settings.ScalarScale = this->ScalarScale;
+  settings.Interpolator = this->Interpolator;
+  settings.InterpolatorTime = (this->Interpolator ? this->Interpolator->GetMTime() : 0);
+  vtkImageStencilData* stencil = this->GetStencil();
+  settings.Stencil = stencil;
+  settings.StencilTime = (stencil ? stencil->GetMTime() : 0);
+}
+
+//----------------------------------------------------------------------------
+bool vtkImageCachedReslice::IsSameResliceSettings(const CachedOutput& cachedOutput, const CachedOutput& settings)
+{
+  for (int i = 0; i < 3; ++i)
+    {
+    if (cachedOutput.OutputSpacing[i] != settings.OutputSpacing[i]
+      || cachedOutput.OutputOrigin[i] != settings.OutputOrigin[i])
+      {
+      return false;
+      }
+    }
+  for (int i = 0; i < 4; ++i)
+    {
+    if (cachedOutput.BackgroundColor[i] != settings.BackgroundColor[i])
+      {
+      return false;
+      }
+    }
+  return cachedOutput.InterpolationMode == settings.InterpolationMode
+    && cachedOutput.SlabMode == settings.SlabMode
+    && cachedOutput.SlabNumberOfSlices == settings.SlabNumberOfSlices
+    && cachedOutput.SlabTrapezoidIntegration == settings.SlabTrapezoidIntegration
+    && cachedOutput.SlabSliceSpacingFraction == settings.SlabSliceSpacingFraction
+    && cachedOutput.Wrap == settings.Wrap
+    && cachedOutput.Mirror == settings.Mirror
+    && cachedOutput.Border == settings.Border
+    && cachedOutput.OutputScalarType == settings.OutputScalarType
+    && cachedOutput.ScalarShift == settings.ScalarShift
+    && cachedOutput.ScalarScale == settings.ScalarScale
+    && cachedOutput.Interpolator == settings.Interpolator
+    && cachedOutput.InterpolatorTime == settings.InterpolatorTime
+    && cachedOutput.Stencil == settings.Stencil
+    && cachedOutput.StencilTime == settings.StencilTime;
+}
+
+//----------------------------------------------------------------------------
+int vtkImageCachedReslice::RequestData(vtkInformation *request,
+                                       vtkInformationVector **inputVector,
+                                       vtkInformationVector *outputVector)
+{
+  vtkInformation* inInfo = inputVector[0]->GetInformationObject(0);
+  vtkInformation* outInfo = outputVector->GetInformationObject(0);
+  vtkDataObject* input = inInfo ? inInfo->Get(vtkDataObject::DATA_OBJECT()) : NULL;
+  vtkImageData* output = vtkImageData::SafeDownCast(outInfo->Get(vtkDataObject::DATA_OBJECT()));
+  vtkNew<vtkMatrix4x4> resliceMatrix;
+  if (this->CacheSize <= 0 || !input || !output || !this->GetLinearResliceMatrix(resliceMatrix.GetPointer()))
+    {
+    return this->Superclass::RequestData(request, inputVector, outputVector);
+    }
+
+  // Cached outputs are only valid for the same input content
+  if (input != this->CachedInput || input->GetMTime() != this->CachedInputTime)
+    {
+    this->ClearCache();
+    this->CachedInput = input;
+    this->CachedInputTime = input->GetMTime();
+    }
+
+  int outputExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  outInfo->Get(vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(), outputExtent);
+  CachedOutput settings;
+  this->GetResliceSettings(settings);
+
+  vtkImageStencilData* stencilOutput = NULL;
+  if (this->GenerateStencilOutput && outputVector->GetNumberOfInformationObjects() > 1)
+    {
+    stencilOutput = vtkImageStencilData::SafeDownCast(
+      outputVector->GetInformationObject(1)->Get(vtkDataObject::DATA_OBJECT()));
+    }
+
+  for (std::deque<CachedOutput>::iterator cachedIt = this->CachedOutputs.begin(); cachedIt != this->CachedOutputs.end(); ++cachedIt)
+    {
+    bool match = vtkImageCachedReslice::IsSameResliceSettings(*cachedIt, settings)
+      && vtkAddonMathUtilities::MatrixAreEqual(cachedIt->ResliceMatrix, resliceMatrix.GetPointer(), 1e-6);
+    for (int i = 0; match && i < 6; ++i)
+      {
+      match = (cachedIt->OutputExtent[i] == outputExtent[i]);
+      }
+    if (!match)
+      {
+      continue;
+      }
+    // Output shares the voxel array with the cache. The array is not overwritten by
+    // later executions because the superclass only reuses arrays that are not referenced elsewhere.
+    output->ShallowCopy(cachedIt->Output);
+    if (stencilOutput && cachedIt->StencilOutput)
+      {
+      stencilOutput->DeepCopy(cachedIt->StencilOutput);
+      }
+    // Move to the front, as most recently used
+    CachedOutput cachedOutput = *cachedIt;
+    this->CachedOutputs.erase(cachedIt);
+    this->CachedOutputs.push_front(cachedOutput);
+    this->NumberOfCacheHits++;
+    return 1;
+    }
+
+  int result = this->Superclass::RequestData(request, inputVector, outputVector);
+  if (!result)
+    {
+    return result;
+    }
+
+  CachedOutput cachedOutput = settings;
+  cachedOutput.ResliceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  cachedOutput.ResliceMatrix->DeepCopy(resliceMatrix.GetPointer());
+  for (int i = 0; i < 6; ++i)
+    {
+    cachedOutput.OutputExtent[i] = outputExtent[i];
+    }
+  cachedOutput.Output = vtkSmartPointer<vtkImageData>::New();
+  cachedOutput.Output->ShallowCopy(output);
+  if (stencilOutput)
+    {
+    cachedOutput.StencilOutput = vtkSmartPointer<vtkImageStencilData>::New();
+    cachedOutput.StencilOutput->DeepCopy(stencilOutput);
+    }
+  this->CachedOutputs.push_front(cachedOutput);
+  while (this->CachedOutputs.size() > static_cast<size_t>(this->CacheSize))
+    {
+    this->CachedOutputs.pop_back();
+    }
+  return result;
+}
@@ -0,0 +1,124 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#ifndef __vtkImageCachedReslice_h
+#define __vtkImageCachedReslice_h
+
+#include "vtkMRMLLogicExport.h"
+
+// VTK includes
+#include <vtkImageReslice.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <deque>
+
+class vtkImageStencilData;
+class vtkMatrix4x4;
+
+/// \brief Image reslice filter that keeps the most recently resliced planes.
+///
+/// When the reslice transform or output extent changes back to a value that was
+/// used recently (e.g., when scrolling back and forth between slices, or multiple
+/// linked views show the same planes), the output is taken from the cache instead
+/// of resampling the input again.
+/// Cached outputs are discarded when the input image is modified.
+/// Only linear reslice transforms are cached. Outputs are only reused if all
+/// other reslice settings (interpolation, slab, wrap/mirror, output scalar type,
+/// interpolator and stencil) are the same as when they were computed.
+class VTK_MRML_LOGIC_EXPORT vtkImageCachedReslice : public vtkImageReslice
+{
+public:
+  static vtkImageCachedReslice *New();
+  vtkTypeMacro(vtkImageCachedReslice, vtkImageReslice);
+  void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  ///
+  /// Maximum number of resliced planes that are kept.
+  /// 0 (default) disables caching.
+  void SetCacheSize(int cacheSize);
+  vtkGetMacro(CacheSize, int);
+
+  ///
+  /// Remove all resliced planes from the cache
+  void ClearCache();
+
+  ///
+  /// Get the number of resliced planes that are currently in the cache
+  int GetNumberOfCachedOutputs();
+
+  ///
+  /// Get the number of times the output was taken from the cache
+  vtkGetMacro(NumberOfCacheHits, int);
+
+protected:
+  vtkImageCachedReslice();
+  ~vtkImageCachedReslice();
+
+  int RequestData(vtkInformation *request, vtkInformationVector **inputVector,
+                  vtkInformationVector *outputVector) VTK_OVERRIDE;
+
+  /// Get the input to output voxel transform matrix if it is linear
+  bool GetLinearResliceMatrix(vtkMatrix4x4* resliceMatrix);
+
+  struct CachedOutput
+    {
+    vtkSmartPointer<vtkMatrix4x4> ResliceMatrix;
+    int OutputExtent[6];
+    double OutputSpacing[3];
+    double OutputOrigin[3];
+    int InterpolationMode;
+    double BackgroundColor[4];
+    int SlabMode;
+    int SlabNumberOfSlices;
+    int SlabTrapezoidIntegration;
+    double SlabSliceSpacingFraction;
+    int Wrap;
+    int Mirror;
+    int Border;
+    int OutputScalarType;
+    double ScalarShift;
+    double ScalarScale;
+    /// Interpolator and stencil are identified by their pointer and modified time
+    vtkObject* Interpolator;
+    vtkMTimeType InterpolatorTime;
+    vtkObject* Stencil;
+    vtkMTimeType StencilTime;
+    vtkSmartPointer<vtkImageData> Output;
+    vtkSmartPointer<vtkImageStencilData> StencilOutput;
+    };
+
+  /// Get the reslice settings that an output depends on (all except the reslice matrix and output extent)
+  void GetResliceSettings(CachedOutput& settings);
+
+  /// Check if an output was computed with the given reslice settings
+  static bool IsSameResliceSettings(const CachedOutput& cachedOutput, const CachedOutput& settings);
+
+  int CacheSize;
+  int NumberOfCacheHits;
+
+  /// Most recently used outputs are at the front
+  std::deque<CachedOutput> CachedOutputs;
+
+  /// Input that the cached outputs were computed from
+  vtkDataObject* CachedInput;
+  vtkMTimeType CachedInputTime;
+
+private:
+  vtkImageCachedReslice(const vtkImageCachedReslice&);  // Not implemented.
+  void operator=(const vtkImageCachedReslice&);  // Not implemented.
+};
+
+#endif
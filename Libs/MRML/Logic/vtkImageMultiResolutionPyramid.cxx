@@ -0,0 +1,615 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#include "vtkImageMultiResolutionPyramid.h"
+
+// vtkTeem includes
+#include <vtkNRRDReader.h>
+#include <vtkNRRDWriter.h>
+
+// VTK includes
+#include <vtkAtomic.h>
+#include <vtkImageData.h>
+#include <vtkImageShrink3D.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+
+// VTKsys includes
+#include <vtksys/Directory.hxx>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+/// Read an image from a NRRD file, mapping the voxels into memory if possible
+vtkSmartPointer<vtkImageData> ReadMemoryMappedImage(const std::string& fileName)
+{
+  vtkNew<vtkNRRDReader> reader;
+  reader->SetFileName(fileName.c_str());
+  reader->SetUseMemoryMapping(true);
+  reader->Update();
+  if (reader->GetReadStatus() != 0 || reader->GetOutput() == NULL)
+    {
+    return NULL;
+    }
+  vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+  image->ShallowCopy(reader->GetOutput());
+  image->SetSpacing(1.0, 1.0, 1.0);
+  image->SetOrigin(0.0, 0.0, 0.0);
+  return image;
+}
+
+//----------------------------------------------------------------------------
+/// 64-bit FNV-1a hash, computed on 8-byte words for speed
+void HashBytes(const void* data, size_t size, vtkTypeUInt64& hash)
+{
+  const vtkTypeUInt64 prime = 1099511628211ULL;
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  size_t numberOfWords = size / sizeof(vtkTypeUInt64);
+  for (size_t i = 0; i < numberOfWords; ++i, bytes += sizeof(vtkTypeUInt64))
+    {
+    vtkTypeUInt64 word = 0;
+    memcpy(&word, bytes, sizeof(vtkTypeUInt64));
+    hash = (hash ^ word) * prime;
+    }
+  for (size_t i = numberOfWords * sizeof(vtkTypeUInt64); i < size; ++i, ++bytes)
+    {
+    hash = (hash ^ *bytes) * prime;
+    }
+}
+
+//----------------------------------------------------------------------------
+/// Key that identifies the levels of an image in the cache directory:
+/// dimensions, spacing, scalar type and a checksum of the voxels
+std::string GetImageCacheKey(vtkImageData* image)
+{
+  vtkTypeUInt64 hash = 14695981039346656037ULL;
+  int dimensions[3] = { 0, 0, 0 };
+  image->GetDimensions(dimensions);
+  double spacing[3] = { 1.0, 1.0, 1.0 };
+  image->GetSpacing(spacing);
+  int scalarType = image->GetScalarType();
+  int numberOfComponents = image->GetNumberOfScalarComponents();
+  HashBytes(dimensions, sizeof(dimensions), hash);
+  HashBytes(spacing, sizeof(spacing), hash);
+  HashBytes(&scalarType, sizeof(scalarType), hash);
+  HashBytes(&numberOfComponents, sizeof(numberOfComponents), hash);
+  vtkDataArray* scalars = image->GetPointData() ? image->GetPointData()->GetScalars() : NULL;
+  if (scalars && scalars->GetVoidPointer(0))
+    {
+    HashBytes(scalars->GetVoidPointer(0),
+      static_cast<size_t>(scalars->GetNumberOfTuples()) * scalars->GetNumberOfComponents() * scalars->GetDataTypeSize(), hash);
+    }
+  std::stringstream key;
+  key << dimensions[0] << "x" << dimensions[1] << "x" << dimensions[2]
+    << "-" << std::hex << std::setw(16) << std::setfill('0') << hash;
+  return key.str();
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+struct vtkImageMultiResolutionPyramid::BuildJob
+{
+  vtkSmartPointer<vtkImageData> InputData;
+  vtkMTimeType InputTime;
+  unsigned long Generation;
+  bool Averaging;
+  int MinimumLevelSize;
+  std::string CacheDirectory;
+  std::string CacheKey;
+  std::vector<Level> Levels;
+  /// Set by the thread that builds the levels when it is completed
+  vtkAtomic<int> Completed;
+  /// Set to stop building the levels
+  vtkAtomic<int> Aborted;
+};
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkImageMultiResolutionPyramid);
+
+//----------------------------------------------------------------------------
+vtkImageMultiResolutionPyramid::vtkImageMultiResolutionPyramid()
+{
+  this->LevelsInputTime = 0;
+  this->LevelsGeneration = 0;
+  this->Averaging = true;
+  this->MinimumLevelSize = 256;
+  this->UpdateInBackground = false;
+  this->Threader = vtkMultiThreader::New();
+  this->BackgroundJob = NULL;
+  this->BackgroundJobThreadId = -1;
+}
+
+//----------------------------------------------------------------------------
+vtkImageMultiResolutionPyramid::~vtkImageMultiResolutionPyramid()
+{
+  if (this->BackgroundJob)
+    {
+    this->BackgroundJob->Aborted = 1;
+    }
+  this->ClearLevels();
+  this->CollectBackgroundJob(true);
+  this->Threader->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkImageMultiResolutionPyramid::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Averaging: " << this->Averaging << "\n";
+  os << indent << "MinimumLevelSize: " << this->MinimumLevelSize << "\n";
+  os << indent << "CacheDirectory: " << this->CacheDirectory << "\n";
+  os << indent << "UpdateInBackground: " << this->UpdateInBackground << "\n";
+  os << indent << "NumberOfLevels: " << this->GetNumberOfLevels() << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkImageMultiResolutionPyramid::SetInputData(vtkImageData* image)
+{
+  if (this->InputData == image)
+    {
+    return;
+    }
+  this->InputData = image;
+  this->ClearLevels();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkImageData* vtkImageMultiResolutionPyramid::GetInputData()
+{
+  return this->InputData;
+}
+
+//----------------------------------------------------------------------------
+void vtkImageMultiResolutionPyramid::SetAveraging(bool averaging)
+{
+  if (this->Averaging == averaging)
+    {
+    return;
+    }
+  this->Averaging = averaging;
+  this->ClearLevels();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkImageMultiResolutionPyramid::SetMinimumLevelSize(int size)
+{
+  size = std::max(size, 1);
+  if (this->MinimumLevelSize == size)
+    {
+    return;
+    }
+  this->MinimumLevelSize = size;
+  this->ClearLevels();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkImageMultiResolutionPyramid::SetCacheDirectory(const std::string& directory)
+{
+  if (this->CacheDirectory == directory)
+    {
+    return;
+    }
+  this->CacheDirectory = directory;
+  this->ClearLevels();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkImageMultiResolutionPyramid::GetCacheDirectory()
+{
+  return this->CacheDirectory;
+}
+
+//----------------------------------------------------------------------------
+void vtkImageMultiResolutionPyramid::ClearLevels()
+{
+  this->Levels.clear();
+  this->LevelsInputTime = 0;
+  this->LevelsCacheKey.clear();
+  ++this->LevelsGeneration;
+}
+
+//----------------------------------------------------------------------------
+void vtkImageMultiResolutionPyramid::Update()
+{
+  this->CollectBackgroundJob(false);
+  if (!this->InputData)
+    {
+    this->ClearLevels();
+    return;
+    }
+  if (this->LevelsInputTime == this->InputData->GetMTime())
+    {
+    // levels are up-to-date
+    return;
+    }
+  // Levels of the previous content are not used while the new ones are built
+  this->Levels.clear();
+  if (this->BackgroundJob)
+    {
+    // Levels are built for the current content after the running job is completed
+    return;
+    }
+
+  BuildJob* job = new BuildJob;
+  job->InputData = this->InputData;
+  job->InputTime = this->InputData->GetMTime();
+  job->Generation = this->LevelsGeneration;
+  job->Averaging = this->Averaging;
+  job->MinimumLevelSize = this->MinimumLevelSize;
+  job->CacheDirectory = this->CacheDirectory;
+  job->Completed = 0;
+  job->Aborted = 0;
+  this->BackgroundJob = job;
+  if (this->UpdateInBackground)
+    {
+    this->BackgroundJobThreadId = this->Threader->SpawnThread(
+      vtkImageMultiResolutionPyramid::BuildLevelsThreaderCallback, job);
+    }
+  else
+    {
+    vtkImageMultiResolutionPyramid::BuildLevels(job);
+    this->CollectBackgroundJob(true);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkImageMultiResolutionPyramid::WaitForBackgroundUpdate()
+{
+  this->CollectBackgroundJob(true);
+  // The input may have been modified while the levels were built
+  this->Update();
+  this->CollectBackgroundJob(true);
+}
+
+//----------------------------------------------------------------------------
+void vtkImageMultiResolutionPyramid::CollectBackgroundJob(bool wait)
+{
+  BuildJob* job = this->BackgroundJob;
+  if (!job || (!wait && !job->Completed))
+    {
+    return;
+    }
+  if (this->BackgroundJobThreadId >= 0)
+    {
+    // Waits for the thread to finish, it is not killed
+    this->Threader->TerminateThread(this->BackgroundJobThreadId);
+    this->BackgroundJobThreadId = -1;
+    }
+  if (!job->Aborted && job->Generation == this->LevelsGeneration
+    && job->InputData == this->InputData && job->InputTime == this->InputData->GetMTime())
+    {
+    this->Levels.swap(job->Levels);
+    this->LevelsInputTime = job->InputTime;
+    this->LevelsCacheKey = job->CacheKey;
+    }
+  this->BackgroundJob = NULL;
+  delete job;
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkImageMultiResolutionPyramid::BuildLevelsThreaderCallback(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  BuildJob* job = static_cast<BuildJob*>(info->UserData);
+  vtkImageMultiResolutionPyramid::BuildLevels(job);
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+void vtkImageMultiResolutionPyramid::BuildLevels(BuildJob* job)
+{
+  if (!job->CacheDirectory.empty())
+    {
+    job->CacheKey = GetImageCacheKey(job->InputData);
+    }
+  int dimensions[3] = { 0, 0, 0 };
+  job->InputData->GetDimensions(dimensions);
+  int shrinkFactors[3] = { 1, 1, 1 };
+  vtkImageData* previousLevelImage = job->InputData;
+  for (int level = 1; std::max(dimensions[0], std::max(dimensions[1], dimensions[2])) > job->MinimumLevelSize; ++level)
+    {
+    if (job->Aborted)
+      {
+      break;
+      }
+    int levelShrinkFactors[3] = { 1, 1, 1 };
+    for (int i = 0; i < 3; ++i)
+      {
+      if (dimensions[i] > 1)
+        {
+        levelShrinkFactors[i] = 2;
+        dimensions[i] /= 2;
+        shrinkFactors[i] *= 2;
+        }
+      }
+    Level newLevel;
+    newLevel.Image = vtkImageMultiResolutionPyramid::CreateLevel(job, level, previousLevelImage, levelShrinkFactors);
+    if (!newLevel.Image)
+      {
+      break;
+      }
+    std::copy(shrinkFactors, shrinkFactors + 3, newLevel.ShrinkFactors);
+    job->Levels.push_back(newLevel);
+    previousLevelImage = newLevel.Image;
+    }
+  job->Completed = 1;
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkImageData> vtkImageMultiResolutionPyramid::CreateLevel(
+  BuildJob* job, int level, vtkImageData* previousLevelImage, const int shrinkFactors[3])
+{
+  int dimensions[3] = { 0, 0, 0 };
+  previousLevelImage->GetDimensions(dimensions);
+  for (int i = 0; i < 3; ++i)
+    {
+    dimensions[i] /= shrinkFactors[i];
+    }
+
+  std::string fileName = vtkImageMultiResolutionPyramid::GetJobLevelFileName(job, level);
+  if (!fileName.empty())
+    {
+    vtkSmartPointer<vtkImageData> cachedImage = vtkImageMultiResolutionPyramid::ReadCachedLevel(
+      fileName, dimensions, previousLevelImage->GetScalarType(), previousLevelImage->GetNumberOfScalarComponents());
+    if (cachedImage)
+      {
+      return cachedImage;
+      }
+    }
+
+  vtkNew<vtkImageShrink3D> shrink;
+  shrink->SetInputData(previousLevelImage);
+  shrink->SetShrinkFactors(shrinkFactors[0], shrinkFactors[1], shrinkFactors[2]);
+  shrink->SetAveraging(job->Averaging ? 1 : 0);
+  shrink->Update();
+  vtkSmartPointer<vtkImageData> levelImage = vtkSmartPointer<vtkImageData>::New();
+  levelImage->ShallowCopy(shrink->GetOutput());
+  levelImage->SetSpacing(1.0, 1.0, 1.0);
+  levelImage->SetOrigin(0.0, 0.0, 0.0);
+
+  if (!fileName.empty())
+    {
+    // Replace the level by the memory mapped file content so that
+    // the memory used by the level can be released
+    vtkSmartPointer<vtkImageData> cachedImage = vtkImageMultiResolutionPyramid::WriteCachedLevel(job, level, levelImage);
+    if (cachedImage)
+      {
+      return cachedImage;
+      }
+    }
+  return levelImage;
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkImageData> vtkImageMultiResolutionPyramid::ReadCachedLevel(
+  const std::string& fileName, const int dimensions[3], int scalarType, int numberOfComponents)
+{
+  // The file name contains the cache key of the input image, so the file
+  // is only found if it was created from the same image content
+  if (!vtksys::SystemTools::FileExists(fileName.c_str(), true))
+    {
+    return NULL;
+    }
+  vtkSmartPointer<vtkImageData> image = ReadMemoryMappedImage(fileName);
+  if (!image || image->GetScalarType() != scalarType
+    || image->GetNumberOfScalarComponents() != numberOfComponents)
+    {
+    return NULL;
+    }
+  int cachedDimensions[3] = { 0, 0, 0 };
+  image->GetDimensions(cachedDimensions);
+  if (!std::equal(dimensions, dimensions + 3, cachedDimensions))
+    {
+    return NULL;
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkImageData> vtkImageMultiResolutionPyramid::WriteCachedLevel(
+  BuildJob* job, int level, vtkImageData* image)
+{
+  if (!vtksys::SystemTools::MakeDirectory(job->CacheDirectory.c_str()))
+    {
+    return NULL;
+    }
+  std::string fileName = vtkImageMultiResolutionPyramid::GetJobLevelFileName(job, level);
+  // Other pyramids may have the level file mapped into memory, so the file is
+  // never rewritten in place: the level is written to a file name that is
+  // unique to this job and then renamed over the level file.
+  std::stringstream tempFileName;
+  tempFileName << vtksys::SystemTools::GetFilenamePath(fileName) << "/"
+    << vtksys::SystemTools::GetFilenameWithoutLastExtension(fileName) << "-";
+#ifdef _WIN32
+  tempFileName << _getpid();
+#else
+  tempFileName << getpid();
+#endif
+  tempFileName << "-" << job << ".tmp.nrrd";
+
+  vtkNew<vtkNRRDWriter> writer;
+  writer->SetFileName(tempFileName.str().c_str());
+  writer->SetInputData(image);
+  // raw encoding, so that the file can be mapped into memory
+  writer->SetUseCompression(0);
+  writer->Write();
+  if (writer->GetWriteError())
+    {
+    vtksys::SystemTools::RemoveFile(tempFileName.str().c_str());
+    return NULL;
+    }
+#ifdef _WIN32
+  // rename does not replace existing files on Windows
+  vtksys::SystemTools::RemoveFile(fileName.c_str());
+#endif
+  if (std::rename(tempFileName.str().c_str(), fileName.c_str()) != 0)
+    {
+    vtksys::SystemTools::RemoveFile(tempFileName.str().c_str());
+    return NULL;
+    }
+
+  // Remove the files of this level that were created from other image content
+  std::string levelPrefix = vtksys::SystemTools::GetFilenameName(
+    vtkImageMultiResolutionPyramid::GetJobLevelFileName(job, level, false));
+  std::string levelFileName = vtksys::SystemTools::GetFilenameName(fileName);
+  vtksys::Directory directory;
+  if (directory.Load(job->CacheDirectory))
+    {
+    for (unsigned long i = 0; i < directory.GetNumberOfFiles(); ++i)
+      {
+      std::string otherFileName = directory.GetFile(i);
+      if (otherFileName == levelFileName
+        || otherFileName.compare(0, levelPrefix.size(), levelPrefix) != 0
+        || !vtksys::SystemTools::StringEndsWith(otherFileName, ".nrrd")
+        || otherFileName.find(".tmp.") != std::string::npos
+        || otherFileName.compare(levelPrefix.size(), 10, "subsampled") == 0)
+        {
+        // not a level file, other level, temporary file, or subsampled level of an averaged pyramid
+        continue;
+        }
+      vtksys::SystemTools::RemoveFile((job->CacheDirectory + "/" + otherFileName).c_str());
+      }
+    }
+
+  return ReadMemoryMappedImage(fileName);
+}
+
+//----------------------------------------------------------------------------
+std::string vtkImageMultiResolutionPyramid::GetJobLevelFileName(BuildJob* job, int level, bool withCacheKey/*=true*/)
+{
+  if (job->CacheDirectory.empty())
+    {
+    return std::string();
+    }
+  std::stringstream fileName;
+  fileName << job->CacheDirectory << "/level" << level;
+  if (!job->Averaging)
+    {
+    fileName << "-subsampled";
+    }
+  fileName << "-";
+  if (withCacheKey)
+    {
+    fileName << job->CacheKey << ".nrrd";
+    }
+  return fileName.str();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkImageMultiResolutionPyramid::GetLevelFileName(int level)
+{
+  if (this->CacheDirectory.empty() || this->LevelsCacheKey.empty()
+    || level < 1 || level > static_cast<int>(this->Levels.size()))
+    {
+    return std::string();
+    }
+  BuildJob job;
+  job.Averaging = this->Averaging;
+  job.CacheDirectory = this->CacheDirectory;
+  job.CacheKey = this->LevelsCacheKey;
+  return vtkImageMultiResolutionPyramid::GetJobLevelFileName(&job, level);
+}
+
+//----------------------------------------------------------------------------
+int vtkImageMultiResolutionPyramid::GetNumberOfLevels()
+{
+  if (!this->InputData)
+    {
+    return 0;
+    }
+  return static_cast<int>(this->Levels.size()) + 1;
+}
+
+//----------------------------------------------------------------------------
+vtkImageData* vtkImageMultiResolutionPyramid::GetLevelImage(int level)
+{
+  if (level == 0)
+    {
+    return this->InputData;
+    }
+  if (level < 0 || level > static_cast<int>(this->Levels.size()))
+    {
+    return NULL;
+    }
+  return this->Levels[level - 1].Image;
+}
+
+//----------------------------------------------------------------------------
+void vtkImageMultiResolutionPyramid::GetLevelShrinkFactors(int level, int factors[3])
+{
+  for (int i = 0; i < 3; ++i)
+    {
+    factors[i] = 1;
+    }
+  if (level < 1 || level > static_cast<int>(this->Levels.size()))
+    {
+    return;
+    }
+  std::copy(this->Levels[level - 1].ShrinkFactors, this->Levels[level - 1].ShrinkFactors + 3, factors);
+}
+
+//----------------------------------------------------------------------------
+void vtkImageMultiResolutionPyramid::GetFullResolutionToLevelMatrix(int level, vtkMatrix4x4* matrix)
+{
+  matrix->Identity();
+  int factors[3] = { 1, 1, 1 };
+  this->GetLevelShrinkFactors(level, factors);
+  for (int i = 0; i < 3; ++i)
+    {
+    matrix->SetElement(i, i, 1.0 / factors[i]);
+    if (this->Averaging)
+      {
+      // an averaged voxel is located at the center of the voxels it was computed from
+      matrix->SetElement(i, 3, -(factors[i] - 1) / (2.0 * factors[i]));
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+int vtkImageMultiResolutionPyramid::GetLevelForSampleSpacing(double sampleSpacing)
+{
+  int level = 0;
+  for (int levelIndex = 1; levelIndex <= static_cast<int>(this->Levels.size()); ++levelIndex)
+    {
+    const int* factors = this->Levels[levelIndex - 1].ShrinkFactors;
+    if (std::max(factors[0], std::max(factors[1], factors[2])) > sampleSpacing)
+      {
+      break;
+      }
+    level = levelIndex;
+    }
+  return level;
+}
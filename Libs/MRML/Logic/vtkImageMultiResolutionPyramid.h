@@ -0,0 +1,194 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+#ifndef __vtkImageMultiResolutionPyramid_h
+#define __vtkImageMultiResolutionPyramid_h
+
+#include "vtkMRMLLogicExport.h"
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <string>
+#include <vector>
+
+class vtkImageData;
+class vtkMatrix4x4;
+
+/// \brief Series of downsampled copies of an image.
+///
+/// Level 0 is the input image, each following level halves the number of voxels
+/// along every axis that has more than one voxel, until the largest dimension
+/// is not larger than MinimumLevelSize.
+/// Levels are defined in IJK space: the spacing and origin of the level images
+/// are always 1 and 0, and GetFullResolutionToLevelMatrix() gives the mapping
+/// from the voxel coordinates of the input image to the voxel coordinates of a level.
+///
+/// If a cache directory is set then the levels are written into it as
+/// uncompressed NRRD files and read back by mapping the files into memory,
+/// so that only the parts of the levels that are accessed are loaded.
+/// Cached level files are named after the dimensions, spacing, scalar type
+/// and a checksum of the voxels of the input image, so they are only reused
+/// for the same image content.
+///
+/// If UpdateInBackground is enabled then Update() builds the levels in a
+/// background thread and returns immediately. Until the levels are built
+/// only the input image (level 0) is available, the built levels are picked
+/// up by the first Update() call after they are completed.
+class VTK_MRML_LOGIC_EXPORT vtkImageMultiResolutionPyramid : public vtkObject
+{
+public:
+  static vtkImageMultiResolutionPyramid *New();
+  vtkTypeMacro(vtkImageMultiResolutionPyramid, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  ///
+  /// Full resolution image (level 0).
+  void SetInputData(vtkImageData* image);
+  vtkImageData* GetInputData();
+
+  ///
+  /// If enabled (default), voxels of a level are the average of the voxels of
+  /// the previous level. If disabled, voxels are subsampled, which must be used
+  /// for label maps.
+  void SetAveraging(bool averaging);
+  vtkGetMacro(Averaging, bool);
+  vtkBooleanMacro(Averaging, bool);
+
+  ///
+  /// No more levels are created once the largest dimension of a level is not
+  /// larger than this value. Default is 256.
+  void SetMinimumLevelSize(int size);
+  vtkGetMacro(MinimumLevelSize, int);
+
+  ///
+  /// Directory where the levels are stored. If empty (default) then the levels
+  /// are kept in memory.
+  void SetCacheDirectory(const std::string& directory);
+  std::string GetCacheDirectory();
+
+  ///
+  /// If enabled, levels are built in a background thread. Disabled by default.
+  vtkSetMacro(UpdateInBackground, bool);
+  vtkGetMacro(UpdateInBackground, bool);
+  vtkBooleanMacro(UpdateInBackground, bool);
+
+  ///
+  /// Create the levels if the input image has changed since they were created.
+  void Update();
+
+  ///
+  /// Wait until the levels that are built in the background are completed
+  /// and make them available.
+  void WaitForBackgroundUpdate();
+
+  ///
+  /// Name of the file that stores a level in the cache directory.
+  /// Empty if there is no cache directory or the levels are not created yet.
+  std::string GetLevelFileName(int level);
+
+  ///
+  /// Number of levels, including the input image.
+  int GetNumberOfLevels();
+
+  ///
+  /// Get the image of a level. Level 0 is the input image.
+  vtkImageData* GetLevelImage(int level);
+
+  ///
+  /// Get how many input voxels are combined into a voxel of a level, along each axis.
+  void GetLevelShrinkFactors(int level, int factors[3]);
+
+  ///
+  /// Get the matrix that maps input image voxel coordinates to level voxel coordinates.
+  void GetFullResolutionToLevelMatrix(int level, vtkMatrix4x4* matrix);
+
+  ///
+  /// Get the coarsest level whose voxels are not larger than the given distance
+  /// between samples (in input image voxels).
+  int GetLevelForSampleSpacing(double sampleSpacing);
+
+protected:
+  vtkImageMultiResolutionPyramid();
+  ~vtkImageMultiResolutionPyramid();
+
+  /// Remove all levels except the input image.
+  /// Levels that are being built in the background are discarded when completed.
+  void ClearLevels();
+
+  /// Settings and results of building the levels
+  struct BuildJob;
+
+  /// Create all levels of the job. Only uses the job, so it can run in any thread.
+  static void BuildLevels(BuildJob* job);
+  static VTK_THREAD_RETURN_TYPE BuildLevelsThreaderCallback(void* arg);
+
+  /// Create a level by shrinking the previous level, or read it from the cache
+  static vtkSmartPointer<vtkImageData> CreateLevel(BuildJob* job, int level,
+    vtkImageData* previousLevelImage, const int shrinkFactors[3]);
+
+  /// Read a level from the cache directory. Returns NULL if it is not available.
+  static vtkSmartPointer<vtkImageData> ReadCachedLevel(const std::string& fileName,
+    const int dimensions[3], int scalarType, int numberOfComponents);
+
+  /// Write a level to the cache directory and read it back memory mapped.
+  /// Levels of other images are removed from the cache directory.
+  /// Returns NULL if the level cannot be cached.
+  static vtkSmartPointer<vtkImageData> WriteCachedLevel(BuildJob* job, int level, vtkImageData* image);
+
+  /// Name of the cache file of a level. Without the cache key, it is the common
+  /// prefix of the files that store the level for any image.
+  static std::string GetJobLevelFileName(BuildJob* job, int level, bool withCacheKey=true);
+
+  /// Take the levels of a completed background job, if they are still valid.
+  /// If wait is false then nothing is done while the job is running.
+  void CollectBackgroundJob(bool wait);
+
+  struct Level
+    {
+    vtkSmartPointer<vtkImageData> Image;
+    int ShrinkFactors[3];
+    };
+
+  /// Levels after the input image
+  std::vector<Level> Levels;
+
+  vtkSmartPointer<vtkImageData> InputData;
+  /// Modified time of the input image when the levels were created
+  vtkMTimeType LevelsInputTime;
+  /// Cache file name suffix of the levels
+  std::string LevelsCacheKey;
+  /// Incremented when the levels are cleared, so that the results of
+  /// jobs that were started before are discarded
+  unsigned long LevelsGeneration;
+
+  bool Averaging;
+  int MinimumLevelSize;
+  std::string CacheDirectory;
+  bool UpdateInBackground;
+
+  vtkMultiThreader* Threader;
+  BuildJob* BackgroundJob;
+  int BackgroundJobThreadId;
+
+private:
+  vtkImageMultiResolutionPyramid(const vtkImageMultiResolutionPyramid&);  // Not implemented.
+  void operator=(const vtkImageMultiResolutionPyramid&);  // Not implemented.
+};
+
+#endif
@@ -43,6 +43,8 @@
 // VTK includes
 #include <vtkCollection.h>
 #include <vtkImageData.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkSmartPointer.h>
@@ -52,7 +54,9 @@
 #include <vtksys/Glob.hxx>
 
 // STD includes
+#include <algorithm>
 #include <cassert>
+#include <set>
 #include <sstream>
 
 // For LoadDefaultParameterSets
@@ -66,6 +70,50 @@
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkMRMLApplicationLogic);
 
+namespace
+{
+
+//----------------------------------------------------------------------------
+/// File of a storable node that is written in a thread when saving
+/// a data bundle
+struct vtkMRMLApplicationLogicWriteDataJob
+{
+  vtkMRMLStorageNode* StorageNode;
+  vtkMRMLStorableNode* Node;
+  int Result;
+};
+
+//----------------------------------------------------------------------------
+struct vtkMRMLApplicationLogicWriteDataQueue
+{
+  std::vector<vtkMRMLApplicationLogicWriteDataJob> Jobs;
+  size_t NextJob;
+  vtkSimpleMutexLock Lock;
+};
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkMRMLApplicationLogic_WriteDataThread(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  vtkMRMLApplicationLogicWriteDataQueue* queue =
+    static_cast<vtkMRMLApplicationLogicWriteDataQueue*>(info->UserData);
+  while (true)
+    {
+    queue->Lock.Lock();
+    size_t next = queue->NextJob++;
+    queue->Lock.Unlock();
+    if (next >= queue->Jobs.size())
+      {
+      break;
+      }
+    vtkMRMLApplicationLogicWriteDataJob& job = queue->Jobs[next];
+    job.Result = job.StorageNode->WriteDataInThread(job.Node);
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+} // end of anonymous namespace
+
 //----------------------------------------------------------------------------
 class vtkMRMLApplicationLogic::vtkInternal
 {
@@ -83,6 +131,11 @@ public:
   vtkSmartPointer<vtkMRMLColorLogic> ColorLogic;
   std::string TemporaryPath;
 
+  /// Storable nodes that are written in threads by WriteScheduledDataBundleData()
+  std::vector<vtkMRMLApplicationLogicWriteDataJob> ScheduledWriteData;
+  bool WriteDataScheduling;
+  /// Files of the data bundle being saved, including the ones not written yet
+  std::set<std::string> DataBundleFileNames;
 };
 
 //----------------------------------------------------------------------------
@@ -95,6 +148,7 @@ vtkMRMLApplicationLogic::vtkInternal::vtkInternal(vtkMRMLApplicationLogic * exte
   this->SliceLinkLogic = vtkSmartPointer<vtkMRMLSliceLinkLogic>::New();
   this->ModelHierarchyLogic = vtkSmartPointer<vtkMRMLModelHierarchyLogic>::New();
   this->ColorLogic = vtkSmartPointer<vtkMRMLColorLogic>::New();
+  this->WriteDataScheduling = false;
 }
 
 //----------------------------------------------------------------------------
@@ -153,6 +207,7 @@ vtkMRMLApplicationLogic::vtkMRMLApplicationLogic()
   this->Internal->SliceLinkLogic->SetMRMLApplicationLogic(this);
   this->Internal->ModelHierarchyLogic->SetMRMLApplicationLogic(this);
   this->Internal->ColorLogic->SetMRMLApplicationLogic(this);
+  this->NumberOfDataBundleThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
 }
 
 //----------------------------------------------------------------------------
@@ -165,6 +220,7 @@ vtkMRMLApplicationLogic::~vtkMRMLApplicationLogic()
 void vtkMRMLApplicationLogic::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfDataBundleThreads: " << this->NumberOfDataBundleThreads << "\n";
 }
 
 //----------------------------------------------------------------------------
@@ -662,6 +718,10 @@ bool vtkMRMLApplicationLogic::SaveSceneToSlicerDataBundleDirectory(const char *s
   // write the new data as we go; save old values
   this->OriginalStorageNodeDirs.clear();
   this->OriginalStorageNodeFileNames.clear();
+  this->Internal->DataBundleFileNames.clear();
+  // nodes that can be written in a thread are written after all the file
+  // names are set, see WriteScheduledDataBundleData()
+  this->Internal->WriteDataScheduling = (this->NumberOfDataBundleThreads > 1);
 
   std::map<std::string, vtkMRMLNode *> storableNodes;
 
@@ -723,6 +783,9 @@ bool vtkMRMLApplicationLogic::SaveSceneToSlicerDataBundleDirectory(const char *s
         }
       }
   }
+  this->Internal->WriteDataScheduling = false;
+  this->WriteScheduledDataBundleData();
+
   //
   // create a scene view, using the snapshot passed in if any
   //
@@ -920,44 +983,76 @@ void vtkMRMLApplicationLogic::SaveStorableNodeToSlicerDataBundleDirectory(vtkMRM
   vtkDebugMacro("set data directory to "
     << dataDir.c_str() << ", storable node " << storableNode->GetID()
     << " file name is now: " << storageNode->GetFileName());
-  // deal with existing files by creating a numeric suffix
-  if (vtksys::SystemTools::FileExists(storageNode->GetFileName(), true))
+  // deal with existing files by creating a numeric suffix,
+  // files that are not written yet are taken into account
+  std::string fullName(storageNode->GetFileName() ? storageNode->GetFileName() : "");
+  if (vtksys::SystemTools::FileExists(fullName.c_str(), true)
+    || this->Internal->DataBundleFileNames.count(fullName))
     {
-    vtkWarningMacro("file " << storageNode->GetFileName() << " already exists, renaming!");
+    vtkWarningMacro("file " << fullName << " already exists, renaming!");
 
-    std::string uniqueFileName = this->CreateUniqueFileName(fileName);
+    std::string baseName = storageNode->GetFileNameWithoutExtension(fullName.c_str());
+    std::string extension = storageNode->GetSupportedFileExtension(fullName.c_str());
+    for (int v = 1; vtksys::SystemTools::FileExists(fullName.c_str(), true)
+           || this->Internal->DataBundleFileNames.count(fullName); ++v)
+      {
+      std::stringstream ss;
+      ss << dataDir << "/" << baseName << v << extension;
+      fullName = ss.str();
+      }
 
-    vtkDebugMacro("found unique file name " << uniqueFileName.c_str());
-    storageNode->SetFileName(uniqueFileName.c_str());
+    vtkDebugMacro("found unique file name " << fullName.c_str());
+    storageNode->SetFileName(fullName.c_str());
     }
+  this->Internal->DataBundleFileNames.insert(fullName);
 
+  if (this->Internal->WriteDataScheduling && storageNode->CanWriteDataInThread(storableNode))
+    {
+    // the storage node gets what it writes from the scene in the main thread
+    if (!storageNode->StartWriteData(storableNode))
+      {
+      vtkErrorMacro("SaveStorableNodeToSlicerDataBundleDirectory: failed to write " << fullName);
+      return;
+      }
+    vtkMRMLApplicationLogicWriteDataJob job;
+    job.StorageNode = storageNode;
+    job.Node = storableNode;
+    job.Result = 0;
+    this->Internal->ScheduledWriteData.push_back(job);
+    return;
+    }
   storageNode->WriteData(storableNode);
  }
 
 //----------------------------------------------------------------------------
-std::string vtkMRMLApplicationLogic::CreateUniqueFileName(std::string &filename)
+void vtkMRMLApplicationLogic::WriteScheduledDataBundleData()
 {
-  std::string uniqueFileName;
-  std::string baseName = vtksys::SystemTools::GetFilenameWithoutExtension(filename);
-  std::string extension = vtksys::SystemTools::GetFilenameLastExtension(filename);
+  if (this->Internal->ScheduledWriteData.empty())
+    {
+    return;
+    }
+
+  vtkMRMLApplicationLogicWriteDataQueue queue;
+  queue.Jobs.swap(this->Internal->ScheduledWriteData);
+  queue.NextJob = 0;
 
-  bool uniqueName = false;
-  int v = 1;
-  while (!uniqueName)
+  // each thread writes a node at a time, the compression done by the
+  // writers runs concurrently
+  vtkNew<vtkMultiThreader> threader;
+  threader->SetNumberOfThreads(
+    std::min(this->NumberOfDataBundleThreads, static_cast<int>(queue.Jobs.size())));
+  threader->SetSingleMethod(vtkMRMLApplicationLogic_WriteDataThread, &queue);
+  threader->SingleMethodExecute();
+
+  for (size_t i = 0; i < queue.Jobs.size(); ++i)
     {
-    std::stringstream ss;
-    ss << v;
-    uniqueFileName = baseName + ss.str() + extension;
-    if (vtksys::SystemTools::FileExists(uniqueFileName.c_str()) == 0)
-      {
-      uniqueName = true;
-      }
-    else
+    vtkMRMLApplicationLogicWriteDataJob& job = queue.Jobs[i];
+    if (job.StorageNode->EndWriteData(job.Node, job.Result) == 0)
       {
-      ++v;
+      vtkErrorMacro("WriteScheduledDataBundleData: failed to write "
+        << (job.StorageNode->GetFileName() ? job.StorageNode->GetFileName() : "(null)"));
       }
     }
-  return uniqueFileName;
 }
 
 //----------------------------------------------------------------------------
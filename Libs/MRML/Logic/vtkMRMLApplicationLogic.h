@@ -135,7 +135,7 @@ public:
   /// Returns success or failure.
   bool Zip(const char *zipFileName, const char *directoryToZip);
 
-  /// unzip the zip file to the current working directory
+  /// unzip the zip file into the destination directory
   /// Returns success or failure.
   bool Unzip(const char *zipFileName, const char *destinationDirectory);
 
@@ -157,6 +157,14 @@ public:
   /// Returns false if the save failed
   bool SaveSceneToSlicerDataBundleDirectory(const char *sdbDir, vtkImageData *screenShot = NULL);
 
+  /// Number of threads that write the data of the storable nodes
+  /// in SaveSceneToSlicerDataBundleDirectory(). Nodes whose storage node
+  /// cannot write in a thread are always written in the main thread.
+  /// The default is the global default number of threads of vtkMultiThreader.
+  /// \sa vtkMRMLStorageNode::CanWriteDataInThread()
+  vtkSetClampMacro(NumberOfDataBundleThreads, int, 1, VTK_INT_MAX);
+  vtkGetMacro(NumberOfDataBundleThreads, int);
+
   /// Open the file into a temp directory and load the scene file
   /// inside.  Note that the first mrml file found in the extracted
   /// directory will be used.
@@ -172,9 +180,6 @@ public:
   static int LoadDefaultParameterSets(vtkMRMLScene * scene,
                                       const std::vector<std::string>& directories);
 
-  /// Creates a unique non-existant file name by adding an index after base file name.
-  static std::string CreateUniqueFileName(std::string &filename);
-
   /// List of custom events fired by the class.
   enum Events{
     RequestInvokeEvent = vtkCommand::UserEvent + 1
@@ -216,6 +221,11 @@ protected:
   void SaveStorableNodeToSlicerDataBundleDirectory(vtkMRMLStorableNode *storableNode,
                                                  std::string &dataDir);
 
+  /// Write the data of the storable nodes that were scheduled by
+  /// SaveStorableNodeToSlicerDataBundleDirectory() in parallel threads.
+  void WriteScheduledDataBundleData();
+
+  int NumberOfDataBundleThreads;
 
 
 private:
@@ -23,6 +23,7 @@
 #include "vtkMRMLDiffusionTensorVolumeDisplayNode.h"
 #include "vtkMRMLDiffusionTensorVolumeSliceDisplayNode.h"
 #include "vtkMRMLScene.h"
+#include "vtkMRMLStorageNode.h"
 #include "vtkMRMLTransformNode.h"
 
 // VTK includes
@@ -36,19 +37,72 @@
 #include <vtkImageReslice.h>
 #include <vtkInformation.h>
 #include <vtkInformationVector.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkPointData.h>
 #include <vtkTrivialProducer.h>
 #include <vtkTransform.h>
 #include <vtkVersion.h>
+#include <vtkWeakPointer.h>
 #include <vtkAddonMathUtilities.h>
 
 //
+#include "vtkImageCachedReslice.h"
+#include "vtkImageMultiResolutionPyramid.h"
 #include "vtkImageLabelOutline.h"
 
 // STD includes
 #include <algorithm>
+#include <map>
+
+namespace
+{
+typedef std::map<std::pair<vtkImageData*, bool>, vtkWeakPointer<vtkImageMultiResolutionPyramid> > SharedPyramidMapType;
+
+//----------------------------------------------------------------------------
+/// Pyramids of the volumes that are shown in slice views, by image data and averaging.
+/// A pyramid is deleted when no slice layer uses it anymore.
+SharedPyramidMapType& GetSharedPyramids()
+{
+  static SharedPyramidMapType sharedPyramids;
+  return sharedPyramids;
+}
+
+//----------------------------------------------------------------------------
+/// Get the pyramid of an image, so that all slice views that show the same
+/// volume use the same downsampled copies
+vtkSmartPointer<vtkImageMultiResolutionPyramid> GetSharedPyramid(vtkImageData* imageData, bool averaging)
+{
+  SharedPyramidMapType& sharedPyramids = GetSharedPyramids();
+  for (SharedPyramidMapType::iterator it = sharedPyramids.begin(); it != sharedPyramids.end();)
+    {
+    if (it->second.GetPointer() == NULL)
+      {
+      sharedPyramids.erase(it++);
+      }
+    else
+      {
+      ++it;
+      }
+    }
+  std::pair<vtkImageData*, bool> key(imageData, averaging);
+  SharedPyramidMapType::iterator it = sharedPyramids.find(key);
+  if (it != sharedPyramids.end())
+    {
+    return it->second.GetPointer();
+    }
+  vtkSmartPointer<vtkImageMultiResolutionPyramid> pyramid = vtkSmartPointer<vtkImageMultiResolutionPyramid>::New();
+  pyramid->SetAveraging(averaging);
+  pyramid->SetInputData(imageData);
+  // Levels are built without blocking the slice views, the full resolution
+  // volume is resliced until they are available
+  pyramid->SetUpdateInBackground(true);
+  sharedPyramids[key] = pyramid.GetPointer();
+  return pyramid;
+}
+} // end of anonymous namespace
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkMRMLSliceLayerLogic);
@@ -113,6 +167,9 @@ vtkMRMLSliceLayerLogic::vtkMRMLSliceLayerLogic()
 
   this->IsLabelLayer = 0;
 
+  this->Pyramid = 0;
+  this->PyramidLevel = 0;
+
   this->AssignAttributeTensorsToScalars= vtkAssignAttribute::New();
   this->AssignAttributeScalarsToTensors= vtkAssignAttribute::New();
   this->AssignAttributeScalarsToTensorsUVW= vtkAssignAttribute::New();
@@ -121,7 +178,11 @@ vtkMRMLSliceLayerLogic::vtkMRMLSliceLayerLogic()
   this->AssignAttributeScalarsToTensorsUVW->Assign(vtkDataSetAttributes::SCALARS, vtkDataSetAttributes::TENSORS, vtkAssignAttribute::POINT_DATA);
 
   // Create the parts for the scalar layer pipeline
-  this->Reslice = vtkImageReslice::New();
+  // Keep the last few resliced planes, so that scrolling back to a previous
+  // slice offset does not require reslicing the volume again
+  vtkImageCachedReslice* cachedReslice = vtkImageCachedReslice::New();
+  cachedReslice->SetCacheSize(4);
+  this->Reslice = cachedReslice;
   this->ResliceUVW = vtkImageReslice::New();
   this->LabelOutline = vtkImageLabelOutline::New();
   this->LabelOutlineUVW = vtkImageLabelOutline::New();
@@ -176,6 +237,7 @@ vtkMRMLSliceLayerLogic::~vtkMRMLSliceLayerLogic()
 
   this->Reslice->Delete();
   this->ResliceUVW->Delete();
+  this->Pyramid = NULL;
 
   this->LabelOutline->Delete();
   this->LabelOutlineUVW->Delete();
@@ -519,7 +581,7 @@ void vtkMRMLSliceLayerLogic::UpdateTransforms()
       {
       vtkNew<vtkGeneralTransform> worldTransform;
       worldTransform->Identity();
-      transformNode->GetTransformFromWorld(worldTransform.GetPointer());
+      transformNode->GetDisplayTransformFromWorld(worldTransform.GetPointer());
       //worldTransform->Inverse();
 
       this->XYToIJKTransform->Concatenate(worldTransform.GetPointer());
@@ -532,6 +594,9 @@ void vtkMRMLSliceLayerLogic::UpdateTransforms()
     this->XYToIJKTransform->Concatenate(rasToIJK.GetPointer());
     this->UVWToIJKTransform->Concatenate(rasToIJK.GetPointer());
 
+    bool usePyramid = this->UpdateMultiResolutionPyramid();
+    this->PyramidLevel = 0;
+
     // vtkImageReslice works faster if the input is a linear transform, so try to convert it
     // to a linear transform.
     // Also attempt to make it a permute transform, as it makes reslicing even faster.
@@ -539,12 +604,36 @@ void vtkMRMLSliceLayerLogic::UpdateTransforms()
     if (vtkMRMLTransformNode::IsGeneralTransformLinear(this->XYToIJKTransform, linearXYToIJKTransform))
       {
       SnapToPermuteMatrix(linearXYToIJKTransform);
+      if (usePyramid)
+        {
+        // Reslice the coarsest downsampled volume that still has at least
+        // one voxel per slice view pixel
+        vtkMatrix4x4* xyToIJKMatrix = linearXYToIJKTransform->GetMatrix();
+        double pixelSize[2] = { 0.0, 0.0 };
+        for (int c = 0; c < 2; ++c)
+          {
+          double column[3] = { xyToIJKMatrix->GetElement(0, c), xyToIJKMatrix->GetElement(1, c), xyToIJKMatrix->GetElement(2, c) };
+          pixelSize[c] = vtkMath::Norm(column);
+          }
+        this->PyramidLevel = this->Pyramid->GetLevelForSampleSpacing(std::min(pixelSize[0], pixelSize[1]));
+        if (this->PyramidLevel > 0)
+          {
+          vtkNew<vtkMatrix4x4> fullResolutionToLevel;
+          this->Pyramid->GetFullResolutionToLevelMatrix(this->PyramidLevel, fullResolutionToLevel.GetPointer());
+          linearXYToIJKTransform->PostMultiply();
+          linearXYToIJKTransform->Concatenate(fullResolutionToLevel.GetPointer());
+          }
+        }
       this->Reslice->SetResliceTransform(linearXYToIJKTransform);
       }
     else
       {
       this->Reslice->SetResliceTransform(this->XYToIJKTransform);
       }
+    if (usePyramid)
+      {
+      this->Reslice->SetInputData(this->GetResliceInputData());
+      }
     vtkSmartPointer<vtkTransform> linearUVWToIJKTransform = vtkSmartPointer<vtkTransform>::New();
     if (vtkMRMLTransformNode::IsGeneralTransformLinear(this->UVWToIJKTransform, linearUVWToIJKTransform))
       {
@@ -592,6 +681,58 @@ void vtkMRMLSliceLayerLogic::UpdateTransforms()
     }
 }
 
+//----------------------------------------------------------------------------
+const char* vtkMRMLSliceLayerLogic::GetMultiResolutionPyramidAttributeName()
+{
+  return "MultiResolutionPyramid";
+}
+
+//----------------------------------------------------------------------------
+bool vtkMRMLSliceLayerLogic::UpdateMultiResolutionPyramid()
+{
+  const char* usePyramid = this->VolumeNode ?
+    this->VolumeNode->GetAttribute(vtkMRMLSliceLayerLogic::GetMultiResolutionPyramidAttributeName()) : 0;
+  if (!usePyramid || strcmp(usePyramid, "1") != 0
+    || !this->VolumeNode->GetImageData()
+    || this->VolumeNode->IsA("vtkMRMLDiffusionTensorVolumeNode"))
+    {
+    this->Pyramid = NULL;
+    return false;
+    }
+
+  // label values must not be averaged
+  bool averaging = (vtkMRMLLabelMapVolumeNode::SafeDownCast(this->VolumeNode) == 0);
+  vtkImageData* imageData = this->VolumeNode->GetImageData();
+  if (!this->Pyramid || this->Pyramid->GetInputData() != imageData || this->Pyramid->GetAveraging() != averaging)
+    {
+    this->Pyramid = GetSharedPyramid(imageData, averaging);
+    }
+
+  // Downsampled volumes are cached next to the file, as long as the
+  // volume is not modified since it was read. Cached files are only
+  // reused for the same voxel content.
+  std::string cacheDirectory;
+  vtkMRMLStorageNode* storageNode = this->VolumeNode->GetStorageNode();
+  if (storageNode && storageNode->GetFileName() && !this->VolumeNode->GetModifiedSinceRead())
+    {
+    cacheDirectory = std::string(storageNode->GetFullNameFromFileName()) + ".pyramid";
+    }
+  this->Pyramid->SetCacheDirectory(cacheDirectory);
+  this->Pyramid->Update();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+vtkImageData* vtkMRMLSliceLayerLogic::GetResliceInputData()
+{
+  if (this->Pyramid && this->PyramidLevel > 0
+    && this->PyramidLevel < this->Pyramid->GetNumberOfLevels())
+    {
+    return this->Pyramid->GetLevelImage(this->PyramidLevel);
+    }
+  return this->VolumeNode ? this->VolumeNode->GetImageData() : 0;
+}
+
 //----------------------------------------------------------------------------
 vtkImageData* vtkMRMLSliceLayerLogic::GetImageData()
 {
@@ -736,7 +877,7 @@ void vtkMRMLSliceLayerLogic::UpdateImageDisplay()
 //      {
 //      volumeNode->GetImageData()->Print(std::cout);
 //      }
-    this->Reslice->SetInputData(volumeNode->GetImageData());
+    this->Reslice->SetInputData(this->GetResliceInputData());
     this->ResliceUVW->SetInputData(volumeNode->GetImageData());
     // use the label outline if we have a label map volume, this is the label
     // layer (turned on in slice logic when the label layer is instantiated)
@@ -973,6 +1114,7 @@ void vtkMRMLSliceLayerLogic::PrintSelf(ostream& os, vtkIndent indent)
     }
 
   os << indent << "IsLabelLayer: " << this->GetIsLabelLayer() << "\n";
+  os << indent << "PyramidLevel: " << this->PyramidLevel << "\n";
   os << indent << "LabelOutline:\n";
   if (this->LabelOutline)
     {
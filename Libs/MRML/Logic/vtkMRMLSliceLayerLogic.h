@@ -45,6 +45,7 @@
 // VTK includes
 #include <vtkImageLogic.h>
 #include <vtkImageExtractComponents.h>
+#include <vtkSmartPointer.h>
 #include <vtkVersion.h>
 
 class vtkAssignAttribute;
@@ -55,6 +56,7 @@ class vtkGeneralTransform;
 //#include <cstdlib>
 
 class vtkImageLabelOutline;
+class vtkImageMultiResolutionPyramid;
 class vtkTransform;
 
 class VTK_MRML_LOGIC_EXPORT vtkMRMLSliceLayerLogic
@@ -129,6 +131,20 @@ public:
   /// The current reslice transform XYToIJK
   vtkGetObjectMacro (XYToIJKTransform, vtkGeneralTransform);
 
+  ///
+  /// Name of the volume node attribute that enables reslicing of downsampled
+  /// copies of the volume when the slice view shows a large area.
+  /// Set the attribute to "1" to enable it. Downsampled copies are shared by all
+  /// slice views that show the volume, built in a background thread (the full
+  /// resolution volume is shown until they are available), and stored next to
+  /// the volume file, in a directory with ".pyramid" suffix.
+  static const char* GetMultiResolutionPyramidAttributeName();
+
+  ///
+  /// Resolution level of the volume that is currently resliced.
+  /// 0 is full resolution, higher levels are downsampled by a factor of 2 at each level.
+  vtkGetMacro (PyramidLevel, int);
+
 
 protected:
   vtkMRMLSliceLayerLogic();
@@ -156,6 +172,14 @@ protected:
   // Copy VolumeDisplayNodeObserved into VolumeDisplayNode
   void UpdateVolumeDisplayNode();
 
+  /// Update the downsampled copies of the volume if the volume node requests it.
+  /// Returns false if the multiresolution pyramid is not used.
+  bool UpdateMultiResolutionPyramid();
+
+  /// Image that the 2D reslice pipeline reslices: the volume or a
+  /// downsampled copy of it
+  vtkImageData* GetResliceInputData();
+
   ///
   /// the MRML Nodes that define this Logic's parameters
   vtkMRMLVolumeNode *VolumeNode;
@@ -182,6 +206,10 @@ protected:
   int IsLabelLayer;
 
   int UpdatingTransforms;
+
+  /// Downsampled copies of the volume, shared with the other slice layers that show the same image
+  vtkSmartPointer<vtkImageMultiResolutionPyramid> Pyramid;
+  int PyramidLevel;
 };
 
 #endif
@@ -0,0 +1,139 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// RemoteIO includes
+#include "vtkHTTPHandler.h"
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+
+// VTK includes
+#include <vtkNew.h>
+
+// VTKsys includes
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+
+//---------------------------------------------------------------------------
+void WriteFile(const std::string& fileName, const std::string& content)
+{
+  std::ofstream file(fileName.c_str(), std::ios::binary);
+  file << content;
+}
+
+//---------------------------------------------------------------------------
+std::string ReadFile(const std::string& fileName)
+{
+  std::ifstream file(fileName.c_str(), std::ios::binary);
+  std::stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+//---------------------------------------------------------------------------
+std::string FileURI(const std::string& fileName)
+{
+  std::string fullPath = vtksys::SystemTools::CollapseFullPath(fileName);
+  return std::string(fullPath[0] == '/' ? "file://" : "file:///") + fullPath;
+}
+
+} // end of anonymous namespace
+
+//---------------------------------------------------------------------------
+int vtkHTTPHandlerTest1(int argc, char * argv[])
+{
+  if (argc != 2)
+    {
+    std::cerr << "Line " << __LINE__
+              << " - Missing parameters !\n"
+              << "Usage: " << argv[0] << " /path/to/temp"
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::string directory = std::string(argv[1]) + "/vtkHTTPHandlerTest1";
+  vtksys::SystemTools::RemoveADirectory(directory.c_str());
+  vtksys::SystemTools::MakeDirectory(directory.c_str());
+
+  vtkNew<vtkHTTPHandler> handler;
+  EXERCISE_BASIC_OBJECT_METHODS(handler.GetPointer());
+
+  // Source file, local files are downloaded the same way as remote files
+  std::string content;
+  for (int i = 0; i < 100000; ++i)
+    {
+    content += static_cast<char>('a' + i % 26);
+    }
+  std::string sourceFileName = directory + "/source.txt";
+  WriteFile(sourceFileName, content);
+  std::string destinationFileName = directory + "/destination.txt";
+  std::string partialFileName = destinationFileName + ".part";
+
+  // Complete download
+  handler->StageFileRead(FileURI(sourceFileName).c_str(), destinationFileName.c_str());
+  CHECK_BOOL(ReadFile(destinationFileName) == content, true);
+  CHECK_BOOL(vtksys::SystemTools::FileExists(partialFileName.c_str()), false);
+  vtksys::SystemTools::RemoveFile(destinationFileName.c_str());
+
+  // Interrupted download is resumed from the end of the partial file:
+  // the content of the partial file is kept.
+  std::string partialContent(40000, 'x');
+  WriteFile(partialFileName, partialContent);
+  handler->StageFileRead(FileURI(sourceFileName).c_str(), destinationFileName.c_str());
+  CHECK_BOOL(ReadFile(destinationFileName) == partialContent + content.substr(partialContent.size()), true);
+  CHECK_BOOL(vtksys::SystemTools::FileExists(partialFileName.c_str()), false);
+  vtksys::SystemTools::RemoveFile(destinationFileName.c_str());
+
+  // Partial file that cannot be part of the source is downloaded again
+  WriteFile(partialFileName, content + content);
+  handler->StageFileRead(FileURI(sourceFileName).c_str(), destinationFileName.c_str());
+  CHECK_BOOL(ReadFile(destinationFileName) == content, true);
+  CHECK_BOOL(vtksys::SystemTools::FileExists(partialFileName.c_str()), false);
+
+  // Several files at the same time
+  std::vector<std::string> sources;
+  std::vector<std::string> destinations;
+  for (int i = 0; i < 5; ++i)
+    {
+    sources.push_back(FileURI(sourceFileName));
+    std::stringstream destination;
+    destination << directory << "/destination" << i << ".txt";
+    destinations.push_back(destination.str());
+    }
+  // a file that is not found does not replace the file in the destination
+  sources.push_back(FileURI(directory + "/missing.txt"));
+  destinations.push_back(directory + "/stale.txt");
+  WriteFile(destinations.back(), "stale");
+  handler->SetMaximumNumberOfConcurrentTransfers(2);
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  std::vector<bool> downloaded = handler->StageFilesRead(sources, destinations);
+  TESTING_OUTPUT_ASSERT_ERRORS_END();
+  CHECK_INT(static_cast<int>(downloaded.size()), 6);
+  for (size_t i = 0; i < 5; ++i)
+    {
+    CHECK_BOOL(downloaded[i], true);
+    CHECK_BOOL(ReadFile(destinations[i]) == content, true);
+    }
+  CHECK_BOOL(downloaded[5], false);
+  CHECK_STD_STRING(ReadFile(destinations[5]), "stale");
+
+  vtksys::SystemTools::RemoveADirectory(directory.c_str());
+  return EXIT_SUCCESS;
+}
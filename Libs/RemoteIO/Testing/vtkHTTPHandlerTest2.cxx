@@ -0,0 +1,410 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// RemoteIO includes
+#include "vtkHTTPHandler.h"
+
+// MRML includes
+#include "vtkMRMLCoreTestingMacros.h"
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkNew.h>
+#include <vtkTimerLog.h>
+
+// VTKsys includes
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+// POSIX includes
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+
+//---------------------------------------------------------------------------
+/// Minimal web server that answers one request per connection.
+/// - /missing.txt is not found (404)
+/// - /flaky.txt closes the first connection without a response
+/// - any other path returns Content, with range requests and If-Range support
+struct TestServer
+{
+  TestServer()
+    {
+    this->Socket = -1;
+    this->Port = 0;
+    this->Stop = false;
+    }
+
+  /// Listen on a free port of the loopback interface
+  bool Listen()
+    {
+    this->Socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (this->Socket < 0)
+      {
+      return false;
+      }
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t addressLength = sizeof(address);
+    if (bind(this->Socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+      || listen(this->Socket, 16) != 0
+      || getsockname(this->Socket, reinterpret_cast<sockaddr*>(&address), &addressLength) != 0)
+      {
+      close(this->Socket);
+      this->Socket = -1;
+      return false;
+      }
+    this->Port = ntohs(address.sin_port);
+    return true;
+    }
+
+  std::string URL(const std::string& path)
+    {
+    std::stringstream url;
+    url << "http://127.0.0.1:" << this->Port << path;
+    return url.str();
+    }
+
+  int GetNumberOfRequests(const std::string& path)
+    {
+    this->Lock.Lock();
+    int numberOfRequests = this->NumberOfRequests[path];
+    this->Lock.Unlock();
+    return numberOfRequests;
+    }
+
+  std::string GetLastHeader(const std::string& name)
+    {
+    this->Lock.Lock();
+    std::string value = this->LastHeaders[name];
+    this->Lock.Unlock();
+    return value;
+    }
+
+  bool IsStopped()
+    {
+    this->Lock.Lock();
+    bool stop = this->Stop;
+    this->Lock.Unlock();
+    return stop;
+    }
+
+  void Serve(int connection);
+
+  int Socket;
+  int Port;
+  std::string Content;
+  std::string ETag;
+  vtkSimpleMutexLock Lock;
+  bool Stop;
+  std::map<std::string, int> NumberOfRequests;
+  /// Headers of the last request, with lowercase names
+  std::map<std::string, std::string> LastHeaders;
+};
+
+//---------------------------------------------------------------------------
+void SendAll(int connection, const std::string& data)
+{
+  size_t sent = 0;
+  while (sent < data.size())
+    {
+    ssize_t length = send(connection, data.c_str() + sent, data.size() - sent, 0);
+    if (length <= 0)
+      {
+      return;
+      }
+    sent += static_cast<size_t>(length);
+    }
+}
+
+//---------------------------------------------------------------------------
+void TestServer::Serve(int connection)
+{
+  std::string request;
+  char buffer[4096];
+  while (request.find("\r\n\r\n") == std::string::npos)
+    {
+    ssize_t length = recv(connection, buffer, sizeof(buffer), 0);
+    if (length <= 0)
+      {
+      return;
+      }
+    request.append(buffer, static_cast<size_t>(length));
+    }
+
+  std::istringstream lines(request.substr(0, request.find("\r\n\r\n")));
+  std::string line;
+  std::getline(lines, line);
+  std::string path = line.substr(line.find(' ') + 1);
+  path = path.substr(0, path.find_first_of(" ?"));
+  std::map<std::string, std::string> headers;
+  while (std::getline(lines, line))
+    {
+    std::string::size_type colon = line.find(':');
+    if (colon == std::string::npos)
+      {
+      continue;
+      }
+    std::string value = line.substr(colon + 1);
+    value.erase(0, value.find_first_not_of(" \t"));
+    value.erase(value.find_last_not_of("\r") + 1);
+    headers[vtksys::SystemTools::LowerCase(line.substr(0, colon))] = value;
+    }
+
+  this->Lock.Lock();
+  int numberOfRequests = ++this->NumberOfRequests[path];
+  this->LastHeaders = headers;
+  this->Lock.Unlock();
+
+  if (path == "/missing.txt")
+    {
+    SendAll(connection, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    return;
+    }
+  if (path == "/flaky.txt" && numberOfRequests == 1)
+    {
+    // connection is closed without a response
+    return;
+    }
+
+  // the range is only sent if the partial file of the client is a part of the current file
+  size_t offset = 0;
+  bool rangeRequested = false;
+  if (headers.count("range")
+    && (!headers.count("if-range") || headers["if-range"] == this->ETag))
+    {
+    rangeRequested = true;
+    offset = static_cast<size_t>(atol(headers["range"].substr(headers["range"].find('=') + 1).c_str()));
+    }
+  std::stringstream response;
+  if (rangeRequested && offset >= this->Content.size())
+    {
+    response << "HTTP/1.1 416 Range Not Satisfiable\r\n"
+      << "Content-Range: bytes */" << this->Content.size() << "\r\n"
+      << "Content-Length: 0\r\nConnection: close\r\n\r\n";
+    }
+  else if (rangeRequested)
+    {
+    response << "HTTP/1.1 206 Partial Content\r\n"
+      << "ETag: " << this->ETag << "\r\n"
+      << "Content-Range: bytes " << offset << "-" << this->Content.size() - 1 << "/" << this->Content.size() << "\r\n"
+      << "Content-Length: " << this->Content.size() - offset << "\r\nConnection: close\r\n\r\n"
+      << this->Content.substr(offset);
+    }
+  else
+    {
+    response << "HTTP/1.1 200 OK\r\n"
+      << "ETag: " << this->ETag << "\r\n"
+      << "Content-Length: " << this->Content.size() << "\r\nConnection: close\r\n\r\n"
+      << this->Content;
+    }
+  SendAll(connection, response.str());
+}
+
+//---------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE ServeRequests(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  TestServer* server = static_cast<TestServer*>(info->UserData);
+  while (!server->IsStopped())
+    {
+    fd_set sockets;
+    FD_ZERO(&sockets);
+    FD_SET(server->Socket, &sockets);
+    timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 100000;
+    if (select(server->Socket + 1, &sockets, NULL, NULL, &timeout) <= 0)
+      {
+      continue;
+      }
+    int connection = accept(server->Socket, NULL, NULL);
+    if (connection < 0)
+      {
+      continue;
+      }
+    server->Serve(connection);
+    close(connection);
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//---------------------------------------------------------------------------
+void WriteFile(const std::string& fileName, const std::string& content)
+{
+  std::ofstream file(fileName.c_str(), std::ios::binary);
+  file << content;
+}
+
+//---------------------------------------------------------------------------
+std::string ReadFile(const std::string& fileName)
+{
+  std::ifstream file(fileName.c_str(), std::ios::binary);
+  std::stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+//---------------------------------------------------------------------------
+int TestDownloads(TestServer& server, const std::string& directory)
+{
+  vtkNew<vtkHTTPHandler> handler;
+  std::string destinationFileName = directory + "/destination.txt";
+  std::string partialFileName = destinationFileName + ".part";
+  std::string validatorFileName = destinationFileName + ".part.validator";
+
+  // Complete download
+  handler->StageFileRead(server.URL("/file.txt").c_str(), destinationFileName.c_str());
+  CHECK_BOOL(ReadFile(destinationFileName) == server.Content, true);
+  CHECK_BOOL(vtksys::SystemTools::FileExists(partialFileName.c_str()), false);
+  CHECK_BOOL(vtksys::SystemTools::FileExists(validatorFileName.c_str()), false);
+  CHECK_BOOL(server.GetLastHeader("range").empty(), true);
+  vtksys::SystemTools::RemoveFile(destinationFileName.c_str());
+
+  // Interrupted download of the same version of the file is resumed
+  std::string partialContent(40000, 'x');
+  WriteFile(partialFileName, partialContent);
+  WriteFile(validatorFileName, server.ETag + "\n");
+  handler->StageFileRead(server.URL("/file.txt").c_str(), destinationFileName.c_str());
+  CHECK_STD_STRING(server.GetLastHeader("range"), "bytes=40000-");
+  CHECK_STD_STRING(server.GetLastHeader("if-range"), server.ETag);
+  CHECK_BOOL(ReadFile(destinationFileName) == partialContent + server.Content.substr(partialContent.size()), true);
+  CHECK_BOOL(vtksys::SystemTools::FileExists(partialFileName.c_str()), false);
+  CHECK_BOOL(vtksys::SystemTools::FileExists(validatorFileName.c_str()), false);
+  vtksys::SystemTools::RemoveFile(destinationFileName.c_str());
+
+  // Partial file of another version of the file is downloaded again
+  WriteFile(partialFileName, partialContent);
+  WriteFile(validatorFileName, "\"previous-version\"\n");
+  handler->StageFileRead(server.URL("/file.txt").c_str(), destinationFileName.c_str());
+  CHECK_STD_STRING(server.GetLastHeader("if-range"), "\"previous-version\"");
+  CHECK_BOOL(ReadFile(destinationFileName) == server.Content, true);
+  vtksys::SystemTools::RemoveFile(destinationFileName.c_str());
+
+  // Partial file without a validator is not resumed
+  WriteFile(partialFileName, partialContent);
+  handler->StageFileRead(server.URL("/file.txt").c_str(), destinationFileName.c_str());
+  CHECK_BOOL(server.GetLastHeader("range").empty(), true);
+  CHECK_BOOL(ReadFile(destinationFileName) == server.Content, true);
+  vtksys::SystemTools::RemoveFile(destinationFileName.c_str());
+
+  // Partial file that is larger than the file (416) is downloaded again
+  int numberOfRequests = server.GetNumberOfRequests("/file.txt");
+  WriteFile(partialFileName, server.Content + server.Content);
+  WriteFile(validatorFileName, server.ETag + "\n");
+  handler->StageFileRead(server.URL("/file.txt").c_str(), destinationFileName.c_str());
+  CHECK_BOOL(ReadFile(destinationFileName) == server.Content, true);
+  CHECK_INT(server.GetNumberOfRequests("/file.txt"), numberOfRequests + 2);
+  vtksys::SystemTools::RemoveFile(destinationFileName.c_str());
+
+  // Transient error is retried after a delay
+  double startTime = vtkTimerLog::GetUniversalTime();
+  handler->StageFileRead(server.URL("/flaky.txt").c_str(), destinationFileName.c_str());
+  CHECK_BOOL(vtkTimerLog::GetUniversalTime() - startTime >= 0.9, true);
+  CHECK_INT(server.GetNumberOfRequests("/flaky.txt"), 2);
+  CHECK_BOOL(ReadFile(destinationFileName) == server.Content, true);
+
+  // Several files at the same time.
+  // A file that is not found is not retried and does not replace the file in the destination.
+  std::vector<std::string> sources;
+  std::vector<std::string> destinations;
+  for (int i = 0; i < 6; ++i)
+    {
+    std::stringstream source;
+    source << "/file.txt?index=" << i;
+    sources.push_back(server.URL(source.str()));
+    std::stringstream destination;
+    destination << directory << "/destination" << i << ".txt";
+    destinations.push_back(destination.str());
+    }
+  sources.push_back(server.URL("/missing.txt"));
+  destinations.push_back(directory + "/stale.txt");
+  WriteFile(destinations.back(), "stale");
+  numberOfRequests = server.GetNumberOfRequests("/file.txt");
+  handler->SetMaximumNumberOfConcurrentTransfers(3);
+  TESTING_OUTPUT_ASSERT_ERRORS_BEGIN();
+  std::vector<bool> downloaded = handler->StageFilesRead(sources, destinations);
+  TESTING_OUTPUT_ASSERT_ERRORS_END();
+  CHECK_INT(static_cast<int>(downloaded.size()), 7);
+  for (size_t i = 0; i < 6; ++i)
+    {
+    CHECK_BOOL(downloaded[i], true);
+    CHECK_BOOL(ReadFile(destinations[i]) == server.Content, true);
+    }
+  CHECK_INT(server.GetNumberOfRequests("/file.txt"), numberOfRequests + 6);
+  CHECK_BOOL(downloaded[6], false);
+  CHECK_INT(server.GetNumberOfRequests("/missing.txt"), 1);
+  CHECK_STD_STRING(ReadFile(destinations[6]), "stale");
+
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
+
+//---------------------------------------------------------------------------
+int vtkHTTPHandlerTest2(int argc, char * argv[])
+{
+  if (argc != 2)
+    {
+    std::cerr << "Line " << __LINE__
+              << " - Missing parameters !\n"
+              << "Usage: " << argv[0] << " /path/to/temp"
+              << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::string directory = std::string(argv[1]) + "/vtkHTTPHandlerTest2";
+  vtksys::SystemTools::RemoveADirectory(directory.c_str());
+  vtksys::SystemTools::MakeDirectory(directory.c_str());
+
+  // the server does not fail when the client closes the connection early
+  signal(SIGPIPE, SIG_IGN);
+
+  TestServer server;
+  for (int i = 0; i < 100000; ++i)
+    {
+    server.Content += static_cast<char>('a' + i % 26);
+    }
+  server.ETag = "\"version-1\"";
+  CHECK_BOOL(server.Listen(), true);
+  vtkNew<vtkMultiThreader> threader;
+  int threadId = threader->SpawnThread(ServeRequests, &server);
+
+  int result = TestDownloads(server, directory);
+
+  server.Lock.Lock();
+  server.Stop = true;
+  server.Lock.Unlock();
+  threader->TerminateThread(threadId);
+  close(server.Socket);
+
+  vtksys::SystemTools::RemoveADirectory(directory.c_str());
+  return result;
+}
@@ -5,13 +5,207 @@
 // MRML includes
 #include <vtkPermissionPrompter.h>
 
+// VTK includes
+#include <vtkTimerLog.h>
+
+// VTKsys includes
+#include <vtksys/SystemTools.hxx>
+
 // CURL includes
 #include <curl/curl.h>
 
+// STD includes
+#include <cstdio>
+#include <algorithm>
+#include <deque>
+#include <fstream>
+
 #if defined(_MSC_VER)
 #pragma warning ( disable : 4786 )
 #endif
 
+namespace
+{
+
+/// Number of times StageFilesRead tries to download a file
+const int MAXIMUM_NUMBER_OF_DOWNLOAD_ATTEMPTS = 3;
+
+/// Delay before a failed download is tried again, in seconds.
+/// It is doubled for each following attempt.
+const double DOWNLOAD_RETRY_DELAY = 1.0;
+
+//----------------------------------------------------------------------------
+/// Initializes curl once when the library is loaded.
+/// curl_global_init is not thread safe, it must not be called per transfer.
+class CurlGlobalInitializer
+{
+public:
+  CurlGlobalInitializer() { curl_global_init(CURL_GLOBAL_ALL); }
+  ~CurlGlobalInitializer() { curl_global_cleanup(); }
+};
+CurlGlobalInitializer CurlGlobalInitializerInstance;
+
+//----------------------------------------------------------------------------
+struct FileDownload
+{
+  FileDownload()
+    {
+    this->File = NULL;
+    this->CurlHandle = NULL;
+    this->Headers = NULL;
+    this->ResumeOffset = 0;
+    this->NumberOfAttempts = 0;
+    this->RetryTime = 0.0;
+    }
+  std::string Source;
+  std::string Destination;
+  /// Data is written into this file, which is renamed to Destination when complete
+  std::string PartialFileName;
+  /// ETag or Last-Modified date of the file on the server that the partial
+  /// file is a part of. It is sent as If-Range when the download is resumed.
+  std::string ValidatorFileName;
+  FILE* File;
+  CURL* CurlHandle;
+  curl_slist* Headers;
+  /// Size of the partial file when the transfer was started
+  curl_off_t ResumeOffset;
+  /// Validators of the response whose headers are being received
+  std::string ETag;
+  std::string LastModified;
+  int NumberOfAttempts;
+  /// The download is not started again before this time (see vtkTimerLog::GetUniversalTime)
+  double RetryTime;
+};
+
+//----------------------------------------------------------------------------
+bool IsHTTPSource(const std::string& source)
+{
+  std::string scheme = vtksys::SystemTools::LowerCase(source.substr(0, source.find("://")));
+  return scheme == "http" || scheme == "https";
+}
+
+//----------------------------------------------------------------------------
+/// Returns true if the download may succeed when it is tried again later:
+/// connection problems, interrupted transfers, temporary server errors and
+/// partial files that do not match the file on the server.
+/// Errors such as a missing file (404) or a denied access are not retried.
+bool IsTransientDownloadError(CURLcode retval, long responseCode)
+{
+  switch (retval)
+    {
+    case CURLE_COULDNT_RESOLVE_HOST:
+    case CURLE_COULDNT_CONNECT:
+    case CURLE_OPERATION_TIMEDOUT:
+    case CURLE_PARTIAL_FILE:
+    case CURLE_GOT_NOTHING:
+    case CURLE_SEND_ERROR:
+    case CURLE_RECV_ERROR:
+    case CURLE_RANGE_ERROR:
+    case CURLE_BAD_DOWNLOAD_RESUME:
+      return true;
+    case CURLE_HTTP_RETURNED_ERROR:
+      // request timeout, range not satisfiable, too many requests and server errors
+      return responseCode == 408 || responseCode == 416 || responseCode == 429 || responseCode >= 500;
+    default:
+      return false;
+    }
+}
+
+//----------------------------------------------------------------------------
+void ReadValidator(const FileDownload& download, std::string& validator)
+{
+  validator.clear();
+  std::ifstream validatorFile(download.ValidatorFileName.c_str());
+  if (validatorFile)
+    {
+    std::getline(validatorFile, validator);
+    }
+}
+
+//----------------------------------------------------------------------------
+size_t download_header_callback(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+  FileDownload* download = static_cast<FileDownload*>(userdata);
+  size_t length = size * nitems;
+  std::string line(buffer, length);
+  while (!line.empty() && (line[line.size() - 1] == '\n' || line[line.size() - 1] == '\r'))
+    {
+    line.erase(line.size() - 1);
+    }
+  if (line.compare(0, 5, "HTTP/") == 0)
+    {
+    // status line of a new response (there is one per redirection)
+    download->ETag.clear();
+    download->LastModified.clear();
+    return length;
+    }
+  if (!line.empty())
+    {
+    std::string::size_type colon = line.find(':');
+    if (colon != std::string::npos)
+      {
+      std::string name = vtksys::SystemTools::LowerCase(line.substr(0, colon));
+      std::string value = line.substr(colon + 1);
+      value.erase(0, value.find_first_not_of(" \t"));
+      if (name == "etag")
+        {
+        download->ETag = value;
+        }
+      else if (name == "last-modified")
+        {
+        download->LastModified = value;
+        }
+      }
+    return length;
+    }
+
+  // end of the headers, the body of the response follows
+  long responseCode = 0;
+  curl_easy_getinfo(download->CurlHandle, CURLINFO_RESPONSE_CODE, &responseCode);
+  if (responseCode != 200)
+    {
+    // informational, redirection, partial content (206) or error responses
+    return length;
+    }
+  if (download->ResumeOffset > 0)
+    {
+    // the server ignored the range request or the file has changed since the
+    // partial file was downloaded (If-Range did not match): the whole file is sent
+    download->File = freopen(download->PartialFileName.c_str(), "wb", download->File);
+    download->ResumeOffset = 0;
+    }
+  // remember the version of the file the partial file is made of.
+  // Weak entity tags cannot be used in If-Range.
+  std::string validator = download->ETag;
+  if (validator.empty() || validator.compare(0, 2, "W/") == 0)
+    {
+    validator = download->LastModified;
+    }
+  if (validator.empty())
+    {
+    vtksys::SystemTools::RemoveFile(download->ValidatorFileName.c_str());
+    }
+  else
+    {
+    std::ofstream validatorFile(download->ValidatorFileName.c_str());
+    validatorFile << validator << std::endl;
+    }
+  return length;
+}
+
+//----------------------------------------------------------------------------
+size_t download_write_callback(void *ptr, size_t size, size_t nmemb, void *userdata)
+{
+  FileDownload* download = static_cast<FileDownload*>(userdata);
+  if (download->File == NULL)
+    {
+    return 0;
+    }
+  return fwrite(ptr, size, nmemb, download->File);
+}
+
+} // end of anonymous namespace
+
 //----------------------------------------------------------------------------
 class vtkHTTPHandler::vtkInternal
 {
@@ -19,9 +213,14 @@ public:
   vtkInternal(vtkHTTPHandler* external);
   ~vtkInternal();
 
+  /// Open the partial file and create the curl handle of a download.
+  /// Returns false if the download cannot be started.
+  bool StartDownload(FileDownload& download);
+
   vtkHTTPHandler* External;
   CURL* CurlHandle;
   int ForbidReuse;
+  int MaximumNumberOfConcurrentTransfers;
 };
 
 //----------------------------------------------------------------------------
@@ -32,6 +231,7 @@ vtkHTTPHandler::vtkInternal::vtkInternal(vtkHTTPHandler* external):External(exte
 {
   this->CurlHandle = NULL;
   this->ForbidReuse = 0;
+  this->MaximumNumberOfConcurrentTransfers = 8;
 }
 
 //-----------------------------------------------------------------------------
@@ -40,6 +240,86 @@ vtkHTTPHandler::vtkInternal::~vtkInternal()
   this->CurlHandle = NULL;
 }
 
+//-----------------------------------------------------------------------------
+bool vtkHTTPHandler::vtkInternal::StartDownload(FileDownload& download)
+{
+  download.NumberOfAttempts++;
+  download.ETag.clear();
+  download.LastModified.clear();
+
+  std::string directory = vtksys::SystemTools::GetFilenamePath(download.Destination);
+  if (!directory.empty() && !vtksys::SystemTools::FileIsDirectory(directory.c_str()))
+    {
+    vtksys::SystemTools::MakeDirectory(directory.c_str());
+    }
+
+  // continue from the end of the data that was downloaded earlier.
+  // A partial file from a web server is only resumed if the version of the
+  // file it was downloaded from is known, so that the server can check that
+  // the file has not changed since.
+  download.ResumeOffset = 0;
+  std::string validator;
+  if (vtksys::SystemTools::FileExists(download.PartialFileName.c_str(), true))
+    {
+    ReadValidator(download, validator);
+    if (validator.empty() && IsHTTPSource(download.Source))
+      {
+      vtksys::SystemTools::RemoveFile(download.PartialFileName.c_str());
+      }
+    else
+      {
+      download.ResumeOffset = static_cast<curl_off_t>(
+        vtksys::SystemTools::FileLength(download.PartialFileName.c_str()));
+      }
+    }
+  download.File = fopen(download.PartialFileName.c_str(), download.ResumeOffset > 0 ? "ab" : "wb");
+  if (download.File == NULL)
+    {
+    vtkErrorWithObjectMacro(this->External, "StageFilesRead: unable to open "
+      << download.PartialFileName << " for writing");
+    return false;
+    }
+
+  CURL* curlHandle = curl_easy_init();
+  if (curlHandle == NULL)
+    {
+    vtkErrorWithObjectMacro(this->External, "StageFilesRead: unable to initialise curl");
+    fclose(download.File);
+    download.File = NULL;
+    return false;
+    }
+  if (this->ForbidReuse)
+    {
+    curl_easy_setopt(curlHandle, CURLOPT_FORBID_REUSE, 1);
+    }
+  curl_easy_setopt(curlHandle, CURLOPT_HTTPGET, 1);
+  curl_easy_setopt(curlHandle, CURLOPT_URL, download.Source.c_str());
+  curl_easy_setopt(curlHandle, CURLOPT_FOLLOWLOCATION, true);
+  // error responses are not written into the file
+  curl_easy_setopt(curlHandle, CURLOPT_FAILONERROR, 1);
+  curl_easy_setopt(curlHandle, CURLOPT_RESUME_FROM_LARGE, download.ResumeOffset);
+  if (download.ResumeOffset > 0 && !validator.empty())
+    {
+    // the server sends the whole file (200) instead of the range (206)
+    // if the file has changed
+    std::string ifRange = "If-Range: " + validator;
+    download.Headers = curl_slist_append(NULL, ifRange.c_str());
+    curl_easy_setopt(curlHandle, CURLOPT_HTTPHEADER, download.Headers);
+    }
+  curl_easy_setopt(curlHandle, CURLOPT_HEADERFUNCTION, download_header_callback);
+  curl_easy_setopt(curlHandle, CURLOPT_HEADERDATA, &download);
+  curl_easy_setopt(curlHandle, CURLOPT_WRITEFUNCTION, download_write_callback);
+  curl_easy_setopt(curlHandle, CURLOPT_WRITEDATA, &download);
+  curl_easy_setopt(curlHandle, CURLOPT_PRIVATE, &download);
+  // quick timeout during connection phase if URL is not accessible (e.g. blocked by a firewall)
+  curl_easy_setopt(curlHandle, CURLOPT_CONNECTTIMEOUT, 3); // in seconds (type long)
+  // abort stalled transfers, they are resumed by the next attempt
+  curl_easy_setopt(curlHandle, CURLOPT_LOW_SPEED_LIMIT, 1L); // in bytes per second
+  curl_easy_setopt(curlHandle, CURLOPT_LOW_SPEED_TIME, 30L); // in seconds
+  download.CurlHandle = curlHandle;
+  return true;
+}
+
 //----------------------------------------------------------------------------
 // vtkHTTPHandler methods
 
@@ -107,6 +387,8 @@ vtkHTTPHandler::~vtkHTTPHandler()
 void vtkHTTPHandler::PrintSelf(ostream& os, vtkIndent indent)
 {
   Superclass::PrintSelf ( os, indent );
+  os << indent << "ForbidReuse: " << this->Internal->ForbidReuse << "\n";
+  os << indent << "MaximumNumberOfConcurrentTransfers: " << this->Internal->MaximumNumberOfConcurrentTransfers << "\n";
 }
 
 //----------------------------------------------------------------------------
@@ -162,10 +444,30 @@ int vtkHTTPHandler::GetForbidReuse()
   return this->Internal->ForbidReuse;
 }
 
+//----------------------------------------------------------------------------
+void vtkHTTPHandler::SetMaximumNumberOfConcurrentTransfers(int value)
+{
+  if (value < 1)
+    {
+    value = 1;
+    }
+  if (this->Internal->MaximumNumberOfConcurrentTransfers == value)
+    {
+    return;
+    }
+  this->Internal->MaximumNumberOfConcurrentTransfers = value;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkHTTPHandler::GetMaximumNumberOfConcurrentTransfers()
+{
+  return this->Internal->MaximumNumberOfConcurrentTransfers;
+}
+
 //----------------------------------------------------------------------------
 void vtkHTTPHandler::InitTransfer( )
 {
-  curl_global_init(CURL_GLOBAL_ALL);
   vtkDebugMacro("vtkHTTPHandler: InitTransfer: initialising CurlHandle");
   this->Internal->CurlHandle = curl_easy_init();
   if (this->Internal->CurlHandle == NULL)
@@ -190,79 +492,177 @@ void vtkHTTPHandler::StageFileRead(const char * source, const char * destination
     vtkErrorMacro("StageFileRead: source or dest is null!");
     return;
     }
-  /*
-  if (this->LocalFile)
+  std::vector<std::string> sources(1, source);
+  std::vector<std::string> destinations(1, destination);
+  this->StageFilesRead(sources, destinations);
+}
+
+//----------------------------------------------------------------------------
+std::vector<bool> vtkHTTPHandler::StageFilesRead(const std::vector<std::string>& sources,
+                                                 const std::vector<std::string>& destinations)
+{
+  std::vector<bool> downloaded(sources.size(), false);
+  if (sources.size() != destinations.size())
     {
-    this->LocalFile->close();
-    delete this->LocalFile;
-    this->LocalFile = NULL;
+    vtkErrorMacro("StageFilesRead: number of sources and destinations differ");
+    return downloaded;
     }
-  this->LocalFile = new std::ofstream(destination, std::ios::binary);
-  */
-  this->InitTransfer( );
-
-
-  if ( this->Internal->ForbidReuse )
+  if (sources.empty())
     {
-    curl_easy_setopt(this->Internal->CurlHandle, CURLOPT_FORBID_REUSE, 1);
+    return downloaded;
     }
-  curl_easy_setopt(this->Internal->CurlHandle, CURLOPT_HTTPGET, 1);
-  curl_easy_setopt(this->Internal->CurlHandle, CURLOPT_URL, source);
-//  curl_easy_setopt(this->Internal->CurlHandle, CURLOPT_NOPROGRESS, false);
-  curl_easy_setopt(this->Internal->CurlHandle, CURLOPT_FOLLOWLOCATION, true);
-  // use the default curl write call back
-  curl_easy_setopt(this->Internal->CurlHandle, CURLOPT_WRITEFUNCTION, NULL); // write_callback);
-  this->LocalFile = fopen(destination, "wb");
-  // output goes into LocalFile, must be  FILE*
-  curl_easy_setopt(this->Internal->CurlHandle, CURLOPT_WRITEDATA, this->LocalFile);
-//  curl_easy_setopt(this->Internal->CurlHandle, CURLOPT_PROGRESSDATA, NULL);
-//  curl_easy_setopt(this->Internal->CurlHandle, CURLOPT_PROGRESSFUNCTION, ProgressCallback);
-
-  // quick timeout during connection phase if URL is not accessible (e.g. blocked by a firewall)
-  curl_easy_setopt(this->Internal->CurlHandle, CURLOPT_CONNECTTIMEOUT, 3); // in seconds (type long)
 
-  vtkDebugMacro("StageFileRead: about to do the curl download... source = " << source << ", dest = " << destination);
-  CURLcode retval = curl_easy_perform(this->Internal->CurlHandle);
-
-  if (retval == CURLE_OK)
+  CURLM* multiHandle = curl_multi_init();
+  if (multiHandle == NULL)
     {
-    vtkDebugMacro("StageFileRead: successful return from curl");
+    vtkErrorMacro("StageFilesRead: unable to initialise");
+    return downloaded;
     }
-  else if (retval == CURLE_BAD_FUNCTION_ARGUMENT)
+  // connections are kept open and reused by the following transfers
+  curl_multi_setopt(multiHandle, CURLMOPT_MAXCONNECTS,
+    static_cast<long>(this->Internal->MaximumNumberOfConcurrentTransfers));
+
+  std::vector<FileDownload> downloads(sources.size());
+  std::deque<size_t> waitingDownloads;
+  for (size_t downloadIndex = 0; downloadIndex < sources.size(); ++downloadIndex)
     {
-    vtkErrorMacro("StageFileRead: bad function argument to curl, did you init CurlHandle?");
+    downloads[downloadIndex].Source = sources[downloadIndex];
+    downloads[downloadIndex].Destination = destinations[downloadIndex];
+    downloads[downloadIndex].PartialFileName = destinations[downloadIndex] + ".part";
+    downloads[downloadIndex].ValidatorFileName = destinations[downloadIndex] + ".part.validator";
+    waitingDownloads.push_back(downloadIndex);
     }
-  else if (retval == CURLE_OUT_OF_MEMORY)
+
+  int numberOfRunningDownloads = 0;
+  bool errorOccurred = false;
+  while (!waitingDownloads.empty() || numberOfRunningDownloads > 0)
     {
-    vtkErrorMacro("StageFileRead: curl ran out of memory!");
+    // start the downloads whose retry delay has elapsed
+    double currentTime = vtkTimerLog::GetUniversalTime();
+    double nextRetryTime = -1.0;
+    std::deque<size_t>::iterator waitingIt = waitingDownloads.begin();
+    while (waitingIt != waitingDownloads.end()
+      && numberOfRunningDownloads < this->Internal->MaximumNumberOfConcurrentTransfers)
+      {
+      FileDownload& download = downloads[*waitingIt];
+      if (download.RetryTime > currentTime)
+        {
+        if (nextRetryTime < 0.0 || download.RetryTime < nextRetryTime)
+          {
+          nextRetryTime = download.RetryTime;
+          }
+        ++waitingIt;
+        continue;
+        }
+      waitingIt = waitingDownloads.erase(waitingIt);
+      vtkDebugMacro("StageFilesRead: start download, source = " << download.Source
+        << ", dest = " << download.Destination << ", attempt " << download.NumberOfAttempts + 1);
+      if (!this->Internal->StartDownload(download))
+        {
+        errorOccurred = true;
+        continue;
+        }
+      curl_multi_add_handle(multiHandle, download.CurlHandle);
+      numberOfRunningDownloads++;
+      }
+
+    int numberOfTransfers = 0;
+    curl_multi_perform(multiHandle, &numberOfTransfers);
+
+    int numberOfMessages = 0;
+    CURLMsg* message = NULL;
+    while ((message = curl_multi_info_read(multiHandle, &numberOfMessages)) != NULL)
+      {
+      if (message->msg != CURLMSG_DONE)
+        {
+        continue;
+        }
+      CURL* curlHandle = message->easy_handle;
+      CURLcode retval = message->data.result;
+      char* privateData = NULL;
+      curl_easy_getinfo(curlHandle, CURLINFO_PRIVATE, &privateData);
+      FileDownload* download = reinterpret_cast<FileDownload*>(privateData);
+      long responseCode = 0;
+      curl_easy_getinfo(curlHandle, CURLINFO_RESPONSE_CODE, &responseCode);
+      curl_multi_remove_handle(multiHandle, curlHandle);
+      curl_easy_cleanup(curlHandle);
+      download->CurlHandle = NULL;
+      curl_slist_free_all(download->Headers);
+      download->Headers = NULL;
+      numberOfRunningDownloads--;
+      if (download->File)
+        {
+        fclose(download->File);
+        download->File = NULL;
+        }
+
+      if (retval == CURLE_OK)
+        {
+        vtkDebugMacro("StageFilesRead: successful return from curl, dest = " << download->Destination);
+        vtksys::SystemTools::RemoveFile(download->Destination.c_str());
+        if (rename(download->PartialFileName.c_str(), download->Destination.c_str()) != 0)
+          {
+          vtkErrorMacro("StageFilesRead: unable to rename " << download->PartialFileName
+            << " to " << download->Destination);
+          errorOccurred = true;
+          }
+        else
+          {
+          downloaded[download - &downloads[0]] = true;
+          }
+        vtksys::SystemTools::RemoveFile(download->ValidatorFileName.c_str());
+        continue;
+        }
+      if (retval == CURLE_RANGE_ERROR || retval == CURLE_BAD_DOWNLOAD_RESUME || responseCode == 416)
+        {
+        // the partial file does not match the file on the server, start from scratch
+        vtksys::SystemTools::RemoveFile(download->PartialFileName.c_str());
+        vtksys::SystemTools::RemoveFile(download->ValidatorFileName.c_str());
+        }
+      if (IsTransientDownloadError(retval, responseCode)
+        && download->NumberOfAttempts < MAXIMUM_NUMBER_OF_DOWNLOAD_ATTEMPTS)
+        {
+        double delay = DOWNLOAD_RETRY_DELAY * (1 << (download->NumberOfAttempts - 1));
+        vtkDebugMacro("StageFilesRead: retry download of " << download->Source
+          << " in " << delay << "s after error: " << curl_easy_strerror(retval));
+        download->RetryTime = vtkTimerLog::GetUniversalTime() + delay;
+        waitingDownloads.push_back(static_cast<size_t>(download - &downloads[0]));
+        continue;
+        }
+      vtkErrorMacro("StageFilesRead: error running curl for " << download->Source
+        << ": " << curl_easy_strerror(retval));
+      errorOccurred = true;
+      }
+
+    // wake up when a transfer makes progress or a download is to be retried
+    int timeout = 1000; // in milliseconds
+    if (nextRetryTime >= 0.0)
+      {
+      timeout = std::min(timeout, std::max(0, static_cast<int>((nextRetryTime - currentTime) * 1000.0) + 1));
+      }
+    if (numberOfRunningDownloads > 0)
+      {
+      int numberOfFileDescriptors = 0;
+      curl_multi_wait(multiHandle, NULL, 0, timeout, &numberOfFileDescriptors);
+      }
+    else if (!waitingDownloads.empty())
+      {
+      vtksys::SystemTools::Delay(static_cast<unsigned int>(timeout));
+      }
     }
-  else
+  curl_multi_cleanup(multiHandle);
+
+  if (errorOccurred && this->GetPermissionPrompter() != NULL)
     {
-    const char *stringError = curl_easy_strerror(retval);
-    vtkErrorMacro("StageFileRead: error running curl: " << stringError);
     //--- in case the permissions were not correct and that's
     //--- the reason the read command failed,
     //--- reset the 'remember check' in the permissions
     //--- prompter so that new login info  will be prompted.
-    if ( this->GetPermissionPrompter() != NULL )
-      {
-      this->GetPermissionPrompter()->SetRemember ( 0 );
-      }
-    }
-  this->CloseTransfer();
-
-  /*
-  this->LocalFile->close();
-  delete this->LocalFile;
-  this->LocalFile = NULL;
-  */
-  if (this->LocalFile)
-    {
-    fclose(this->LocalFile);
+    this->GetPermissionPrompter()->SetRemember ( 0 );
     }
+  return downloaded;
 }
 
-
 //----------------------------------------------------------------------------
 void vtkHTTPHandler::StageFileWrite(const char * source, const char * destination)
 {
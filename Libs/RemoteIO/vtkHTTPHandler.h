@@ -32,9 +32,27 @@ public:
   void SetForbidReuse(int value);
   int GetForbidReuse();
 
+  /// Maximum number of files that StageFilesRead downloads at the same time.
+  /// Default is 8.
+  void SetMaximumNumberOfConcurrentTransfers(int value);
+  int GetMaximumNumberOfConcurrentTransfers();
+
   /// This function wraps curl functionality to download a specified URL to a specified dir
   virtual void StageFileRead(const char * source, const char * destination) VTK_OVERRIDE;
   using vtkURIHandler::StageFileRead;
+
+  /// Download several files concurrently.
+  /// Data is downloaded into a ".part" file next to the destination, which is
+  /// renamed when the transfer is complete. If a partial file is found then
+  /// the download is resumed from its end. Interrupted transfers and temporary
+  /// errors are retried a few times after an increasing delay, other errors
+  /// (e.g., a missing file) are reported without retrying.
+  /// The ETag or Last-Modified date of the file on a web server is stored in a
+  /// ".part.validator" file and sent as If-Range when resuming, so that the
+  /// download restarts from the beginning if the file has changed since.
+  virtual std::vector<bool> StageFilesRead(const std::vector<std::string>& sources,
+                                           const std::vector<std::string>& destinations) VTK_OVERRIDE;
+
   virtual void StageFileWrite(const char * source, const char * destination) VTK_OVERRIDE;
   using vtkURIHandler::StageFileWrite;
   virtual void InitTransfer () VTK_OVERRIDE;
@@ -0,0 +1,224 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// vtkAddon includes
+#include "vtkAddonTestingMacros.h"
+#include "vtkIndexedPlaneCutter.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkCutter.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkPlane.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Total length of the line segments of the cut
+double GetLinesLength(vtkPolyData* polyData)
+{
+  double length = 0.0;
+  vtkCellArray* lines = polyData->GetLines();
+  vtkSmartPointer<vtkIdList> pointIds = vtkSmartPointer<vtkIdList>::New();
+  lines->InitTraversal();
+  while (lines->GetNextCell(pointIds))
+    {
+    for (vtkIdType i = 0; i + 1 < pointIds->GetNumberOfIds(); ++i)
+      {
+      double point1[3] = { 0.0, 0.0, 0.0 };
+      double point2[3] = { 0.0, 0.0, 0.0 };
+      polyData->GetPoint(pointIds->GetId(i), point1);
+      polyData->GetPoint(pointIds->GetId(i + 1), point2);
+      length += sqrt(vtkMath::Distance2BetweenPoints(point1, point2));
+      }
+    }
+  return length;
+}
+
+//----------------------------------------------------------------------------
+double GetReferenceLinesLength(vtkPolyData* polyData, vtkPlane* plane)
+{
+  vtkNew<vtkCutter> cutter;
+  cutter->SetInputData(polyData);
+  cutter->SetCutFunction(plane);
+  cutter->SetGenerateCutScalars(0);
+  cutter->Update();
+  return GetLinesLength(cutter->GetOutput());
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkIndexedPlaneCutterTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkIndexedPlaneCutter::ClearIndexCache();
+
+  vtkNew<vtkSphereSource> sphere;
+  sphere->SetRadius(50.0);
+  sphere->SetThetaResolution(4000);
+  sphere->SetPhiResolution(40);
+  sphere->Update();
+  vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+  mesh->DeepCopy(sphere->GetOutput());
+
+  vtkNew<vtkPlane> plane;
+  vtkNew<vtkIndexedPlaneCutter> cutter;
+  cutter->SetInputData(mesh);
+  cutter->SetPlane(plane.GetPointer());
+  CHECK_POINTER(cutter->GetPlane(), plane.GetPointer());
+
+  // Cuts are the same as vtkCutter's, with one or more threads,
+  // for planes in different orientations and positions
+  double normals[3][3] = { { 0.0, 0.0, 1.0 }, { 1.0, 0.0, 0.0 }, { 0.0, 0.6, -0.8 } };
+  double offsets[4] = { -42.17, -3.31, 0.13, 27.9 };
+  int numberOfThreads[2] = { 1, 4 };
+  for (int normalIndex = 0; normalIndex < 3; ++normalIndex)
+    {
+    for (int offsetIndex = 0; offsetIndex < 4; ++offsetIndex)
+      {
+      plane->SetNormal(normals[normalIndex]);
+      plane->SetOrigin(normals[normalIndex][0] * offsets[offsetIndex],
+        normals[normalIndex][1] * offsets[offsetIndex], normals[normalIndex][2] * offsets[offsetIndex]);
+      double referenceLength = GetReferenceLinesLength(mesh, plane.GetPointer());
+      for (int threadIndex = 0; threadIndex < 2; ++threadIndex)
+        {
+        cutter->SetNumberOfThreads(numberOfThreads[threadIndex]);
+        cutter->Update();
+        CHECK_BOOL(cutter->GetOutput()->GetNumberOfLines() > 0, true);
+        CHECK_DOUBLE_TOLERANCE(GetLinesLength(cutter->GetOutput()), referenceLength, 1e-6 * referenceLength);
+        // Point data is interpolated
+        CHECK_NOT_NULL(cutter->GetOutput()->GetPointData()->GetNormals());
+        CHECK_INT(cutter->GetOutput()->GetPointData()->GetNormals()->GetNumberOfTuples(),
+          cutter->GetOutput()->GetNumberOfPoints());
+        }
+      }
+    }
+
+  CHECK_INT(vtkIndexedPlaneCutter::GetNumberOfIndexedNormals(mesh), 3);
+
+  // Normals that are used only once are cut without an index
+  // and do not evict the indices of other normals
+  cutter->SetNumberOfThreads(4);
+  for (int i = 0; i < 10; ++i)
+    {
+    double angle = 0.1 * (i + 1);
+    plane->SetNormal(sin(angle), 0.0, cos(angle));
+    plane->SetOrigin(0.0, 0.0, 11.1);
+    cutter->Update();
+    CHECK_DOUBLE_TOLERANCE(GetLinesLength(cutter->GetOutput()),
+      GetReferenceLinesLength(mesh, plane.GetPointer()), 1e-6 * GetLinesLength(cutter->GetOutput()));
+    CHECK_INT(vtkIndexedPlaneCutter::GetNumberOfIndexedNormals(mesh), 3);
+    }
+
+  // Index is built when a normal is used again
+  plane->SetOrigin(0.0, 0.0, -7.7);
+  cutter->Update();
+  CHECK_INT(vtkIndexedPlaneCutter::GetNumberOfIndexedNormals(mesh), 4);
+  CHECK_DOUBLE_TOLERANCE(GetLinesLength(cutter->GetOutput()),
+    GetReferenceLinesLength(mesh, plane.GetPointer()), 1e-6 * GetLinesLength(cutter->GetOutput()));
+
+  // Index is shared between filters
+  vtkNew<vtkIndexedPlaneCutter> otherCutter;
+  otherCutter->SetInputData(mesh);
+  otherCutter->SetPlane(plane.GetPointer());
+  otherCutter->Update();
+  CHECK_INT(vtkIndexedPlaneCutter::GetNumberOfIndexedMeshes(), 1);
+  CHECK_INT(otherCutter->GetOutput()->GetNumberOfLines(), cutter->GetOutput()->GetNumberOfLines());
+
+  // Plane outside of the mesh
+  plane->SetNormal(0.0, 0.0, 1.0);
+  plane->SetOrigin(0.0, 0.0, 60.0);
+  cutter->Update();
+  CHECK_INT(cutter->GetOutput()->GetNumberOfCells(), 0);
+
+  // Index is updated when the mesh is modified
+  sphere->SetRadius(20.0);
+  sphere->SetThetaResolution(30);
+  sphere->SetPhiResolution(30);
+  sphere->Update();
+  mesh->DeepCopy(sphere->GetOutput());
+  plane->SetOrigin(0.0, 0.0, 10.3);
+  cutter->Update();
+  CHECK_DOUBLE_TOLERANCE(GetLinesLength(cutter->GetOutput()),
+    GetReferenceLinesLength(mesh, plane.GetPointer()), 1e-6);
+  CHECK_INT(vtkIndexedPlaneCutter::GetNumberOfIndexedMeshes(), 1);
+
+  // Normals that are used in turn (e.g., axial, sagittal and coronal slice views) are indexed
+  mesh->Modified();
+  double sliceNormals[3][3] = { { 0.0, 0.0, 1.0 }, { 1.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0 } };
+  for (int round = 0; round < 2; ++round)
+    {
+    for (int normalIndex = 0; normalIndex < 3; ++normalIndex)
+      {
+      plane->SetNormal(sliceNormals[normalIndex]);
+      plane->SetOrigin(0.0, 0.0, 0.0);
+      cutter->Update();
+      CHECK_DOUBLE_TOLERANCE(GetLinesLength(cutter->GetOutput()),
+        GetReferenceLinesLength(mesh, plane.GetPointer()), 1e-6);
+      }
+    CHECK_INT(vtkIndexedPlaneCutter::GetNumberOfIndexedNormals(mesh), round == 0 ? 0 : 3);
+    }
+
+  // Least recently used indices are removed when the cache size is limited
+  CHECK_BOOL(vtkIndexedPlaneCutter::GetIndexCacheSize() > 0, true);
+  unsigned long maximumIndexCacheSize = vtkIndexedPlaneCutter::GetMaximumIndexCacheSize();
+  vtkIndexedPlaneCutter::SetMaximumIndexCacheSize(1);
+  CHECK_INT(vtkIndexedPlaneCutter::GetNumberOfIndexedNormals(mesh), 0);
+  for (int normalIndex = 0; normalIndex < 2; ++normalIndex)
+    {
+    plane->SetNormal(sliceNormals[normalIndex]);
+    for (int i = 0; i < 2; ++i)
+      {
+      cutter->Update();
+      CHECK_DOUBLE_TOLERANCE(GetLinesLength(cutter->GetOutput()),
+        GetReferenceLinesLength(mesh, plane.GetPointer()), 1e-6);
+      }
+    // The most recently built index is kept even if it exceeds the limit
+    CHECK_INT(vtkIndexedPlaneCutter::GetNumberOfIndexedNormals(mesh), 1);
+    }
+  vtkIndexedPlaneCutter::SetMaximumIndexCacheSize(maximumIndexCacheSize);
+  CHECK_INT(static_cast<int>(vtkIndexedPlaneCutter::GetMaximumIndexCacheSize()), static_cast<int>(maximumIndexCacheSize));
+
+  // Index of a mesh is removed when no filter cuts it anymore
+  vtkNew<vtkPolyData> otherMesh;
+  otherMesh->DeepCopy(sphere->GetOutput());
+  otherCutter->SetInputData(otherMesh.GetPointer());
+  otherCutter->Update();
+  CHECK_INT(vtkIndexedPlaneCutter::GetNumberOfIndexedMeshes(), 2);
+  otherCutter->SetInputData(mesh);
+  otherCutter->Update();
+  CHECK_INT(vtkIndexedPlaneCutter::GetNumberOfIndexedMeshes(), 1);
+  vtkSmartPointer<vtkIndexedPlaneCutter> temporaryCutter = vtkSmartPointer<vtkIndexedPlaneCutter>::New();
+  temporaryCutter->SetInputData(otherMesh.GetPointer());
+  temporaryCutter->SetPlane(plane.GetPointer());
+  temporaryCutter->Update();
+  CHECK_INT(vtkIndexedPlaneCutter::GetNumberOfIndexedMeshes(), 2);
+  temporaryCutter = NULL;
+  CHECK_INT(vtkIndexedPlaneCutter::GetNumberOfIndexedMeshes(), 1);
+
+  // Index of a deleted mesh is removed
+  cutter->SetInputData(NULL);
+  otherCutter->SetInputData(NULL);
+  mesh = NULL;
+  CHECK_INT(vtkIndexedPlaneCutter::GetNumberOfIndexedMeshes(), 0);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,950 @@
+/*=auto==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+===============================================================================auto=*/
+
+#include "vtkIndexedPlaneCutter.h"
+
+#include "vtkCellArray.h"
+#include "vtkCellData.h"
+#include "vtkInformation.h"
+#include "vtkInformationVector.h"
+#include "vtkMath.h"
+#include "vtkMultiThreader.h"
+#include "vtkNew.h"
+#include "vtkObjectFactory.h"
+#include "vtkPlane.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+#include "vtkWeakPointer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <map>
+#include <vector>
+
+namespace
+{
+// Smallest number of cells that is worth cutting in a separate thread
+const vtkIdType CutCellsMinimumRangeSize = 5000;
+// Number of plane orientations that are indexed for a mesh (e.g., axial, sagittal, coronal and one oblique)
+const size_t MaximumNumberOfIndexedNormals = 4;
+// Largest number of bins of a cell index
+const vtkIdType MaximumNumberOfBins = 1 << 22;
+// Default limit of the memory used by all mesh indices (in kiB)
+const unsigned long DefaultMaximumIndexCacheSize = 256 * 1024;
+
+//----------------------------------------------------------------------------
+/// Cells of a mesh, sorted into bins by the interval that they cover along a direction.
+/// If there are no bins then the cells are not indexed, only the point distances are computed.
+struct NormalIndex
+{
+  double Normal[3];
+  /// Signed distance of each point from the origin along the normal
+  std::vector<double> PointDistances;
+  double MinimumDistance;
+  double MaximumDistance;
+  double BinWidth;
+  /// Cells of bin i are BinCellIds[BinOffsets[i]] ... BinCellIds[BinOffsets[i+1]-1]
+  std::vector<vtkIdType> BinOffsets;
+  std::vector<vtkIdType> BinCellIds;
+  /// Value of the cache clock when the index was last used
+  unsigned long LastUsedTime;
+
+  NormalIndex() : MinimumDistance(0.0), MaximumDistance(0.0), BinWidth(0.0), LastUsedTime(0)
+    {
+    this->Normal[0] = this->Normal[1] = this->Normal[2] = 0.0;
+    }
+
+  size_t GetMemorySize() const
+    {
+    return this->PointDistances.capacity() * sizeof(double)
+      + (this->BinOffsets.capacity() + this->BinCellIds.capacity()) * sizeof(vtkIdType);
+    }
+};
+
+//----------------------------------------------------------------------------
+/// Normal that is not indexed yet and the number of times it has been used
+struct CandidateNormal
+{
+  double Normal[3];
+  int UseCount;
+};
+
+//----------------------------------------------------------------------------
+struct MeshIndex
+{
+  vtkWeakPointer<vtkPolyData> PolyData;
+  vtkMTimeType MeshTime;
+  vtkIdType NumberOfVerts;
+  vtkIdType NumberOfLines;
+  vtkIdType NumberOfPolys;
+  /// Location of each cell in its cell array
+  std::vector<vtkIdType> CellOffsets;
+  /// Most recently used first
+  std::list<NormalIndex> NormalIndices;
+  /// Recently used normals that are not indexed yet, most recently used first. The index of
+  /// a normal is only built when it is used again while it is in this list, so that planes
+  /// that are seen once (e.g., while an oblique slice is rotated) do not build indices and
+  /// do not evict the indices of other normals.
+  std::list<CandidateNormal> CandidateNormals;
+  /// Number of filter instances that last cut this mesh
+  int NumberOfFilters;
+
+  MeshIndex() : MeshTime(0), NumberOfVerts(0), NumberOfLines(0), NumberOfPolys(0), NumberOfFilters(0) {}
+
+  size_t GetMemorySize() const
+    {
+    size_t memorySize = this->CellOffsets.capacity() * sizeof(vtkIdType);
+    for (std::list<NormalIndex>::const_iterator it = this->NormalIndices.begin(); it != this->NormalIndices.end(); ++it)
+      {
+      memorySize += it->GetMemorySize();
+      }
+    return memorySize;
+    }
+};
+
+typedef std::map<vtkPolyData*, MeshIndex> MeshIndexMapType;
+
+//----------------------------------------------------------------------------
+MeshIndexMapType& GetMeshIndices()
+{
+  static MeshIndexMapType meshIndices;
+  return meshIndices;
+}
+
+//----------------------------------------------------------------------------
+/// Point distances of the normal that is currently cut but not indexed.
+/// Shared by all meshes, as all instances are updated from the same thread.
+NormalIndex& GetUnindexedNormal()
+{
+  static NormalIndex unindexedNormal;
+  return unindexedNormal;
+}
+
+//----------------------------------------------------------------------------
+unsigned long& GetMaximumIndexCacheSizeReference()
+{
+  static unsigned long maximumIndexCacheSize = DefaultMaximumIndexCacheSize;
+  return maximumIndexCacheSize;
+}
+
+//----------------------------------------------------------------------------
+/// Clock that is advanced each time an index is looked up, for least recently used eviction
+unsigned long AdvanceCacheTime()
+{
+  static unsigned long cacheTime = 0;
+  return ++cacheTime;
+}
+
+//----------------------------------------------------------------------------
+size_t GetIndexCacheMemorySize()
+{
+  size_t memorySize = 0;
+  MeshIndexMapType& meshIndices = GetMeshIndices();
+  for (MeshIndexMapType::const_iterator it = meshIndices.begin(); it != meshIndices.end(); ++it)
+    {
+    memorySize += it->second.GetMemorySize();
+    }
+  return memorySize;
+}
+
+//----------------------------------------------------------------------------
+/// Release the cell offsets of a mesh without normal indices. They are computed again
+/// when the mesh is cut next time.
+void ReleaseCellOffsets(MeshIndex& meshIndex)
+{
+  std::vector<vtkIdType>().swap(meshIndex.CellOffsets);
+  meshIndex.CandidateNormals.clear();
+  meshIndex.MeshTime = 0;
+}
+
+//----------------------------------------------------------------------------
+/// Remove least recently used normal indices of all meshes until the cache fits in its
+/// maximum size. The index that is kept is not removed, even if it alone exceeds the limit.
+void TrimIndexCache(const NormalIndex* keptIndex)
+{
+  MeshIndexMapType& meshIndices = GetMeshIndices();
+  const size_t maximumMemorySize = static_cast<size_t>(GetMaximumIndexCacheSizeReference()) * 1024;
+  size_t memorySize = GetIndexCacheMemorySize();
+  while (memorySize > maximumMemorySize)
+    {
+    MeshIndex* oldestMeshIndex = NULL;
+    std::list<NormalIndex>::iterator oldestIndexIt;
+    for (MeshIndexMapType::iterator meshIt = meshIndices.begin(); meshIt != meshIndices.end(); ++meshIt)
+      {
+      std::list<NormalIndex>& normalIndices = meshIt->second.NormalIndices;
+      for (std::list<NormalIndex>::iterator it = normalIndices.begin(); it != normalIndices.end(); ++it)
+        {
+        if (&(*it) != keptIndex && (!oldestMeshIndex || it->LastUsedTime < oldestIndexIt->LastUsedTime))
+          {
+          oldestMeshIndex = &meshIt->second;
+          oldestIndexIt = it;
+          }
+        }
+      }
+    if (!oldestMeshIndex)
+      {
+      break;
+      }
+    memorySize -= oldestIndexIt->GetMemorySize();
+    oldestMeshIndex->NormalIndices.erase(oldestIndexIt);
+    if (oldestMeshIndex->NormalIndices.empty())
+      {
+      memorySize -= oldestMeshIndex->CellOffsets.capacity() * sizeof(vtkIdType);
+      ReleaseCellOffsets(*oldestMeshIndex);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+/// Record that a filter instance no longer cuts the mesh. The index of the mesh is removed
+/// when no filter instance cuts it anymore.
+void ReleaseMeshIndex(vtkWeakPointer<vtkPolyData>& polyData)
+{
+  if (polyData.GetPointer() == NULL)
+    {
+    // Not set, or the mesh is deleted and its index is removed already
+    return;
+    }
+  MeshIndexMapType& meshIndices = GetMeshIndices();
+  MeshIndexMapType::iterator it = meshIndices.find(polyData.GetPointer());
+  polyData = NULL;
+  if (it == meshIndices.end())
+    {
+    return;
+    }
+  if (--it->second.NumberOfFilters <= 0)
+    {
+    meshIndices.erase(it);
+    }
+}
+
+//----------------------------------------------------------------------------
+void RemoveDeletedMeshIndices()
+{
+  MeshIndexMapType& meshIndices = GetMeshIndices();
+  for (MeshIndexMapType::iterator it = meshIndices.begin(); it != meshIndices.end();)
+    {
+    if (it->second.PolyData.GetPointer() == NULL)
+      {
+      meshIndices.erase(it++);
+      }
+    else
+      {
+      ++it;
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void InitializeMeshIndex(vtkPolyData* polyData, MeshIndex& meshIndex)
+{
+  meshIndex.PolyData = polyData;
+  meshIndex.MeshTime = polyData->GetMTime();
+  meshIndex.NumberOfVerts = polyData->GetNumberOfVerts();
+  meshIndex.NumberOfLines = polyData->GetNumberOfLines();
+  meshIndex.NumberOfPolys = polyData->GetNumberOfPolys();
+  meshIndex.NormalIndices.clear();
+  meshIndex.CandidateNormals.clear();
+  meshIndex.CellOffsets.clear();
+  meshIndex.CellOffsets.reserve(polyData->GetNumberOfCells());
+  vtkCellArray* cellArrays[4] = { polyData->GetVerts(), polyData->GetLines(), polyData->GetPolys(), polyData->GetStrips() };
+  for (int arrayIndex = 0; arrayIndex < 4; ++arrayIndex)
+    {
+    vtkCellArray* cells = cellArrays[arrayIndex];
+    if (!cells || cells->GetNumberOfCells() == 0)
+      {
+      continue;
+      }
+    const vtkIdType* cellData = cells->GetPointer();
+    const vtkIdType size = cells->GetNumberOfConnectivityEntries();
+    for (vtkIdType offset = 0; offset < size; offset += cellData[offset] + 1)
+      {
+      meshIndex.CellOffsets.push_back(offset);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+inline vtkIdType GetBin(const NormalIndex& index, double distance)
+{
+  vtkIdType numberOfBins = static_cast<vtkIdType>(index.BinOffsets.size()) - 1;
+  vtkIdType bin = static_cast<vtkIdType>((distance - index.MinimumDistance) / index.BinWidth);
+  return std::max(vtkIdType(0), std::min(numberOfBins - 1, bin));
+}
+
+//----------------------------------------------------------------------------
+void ComputePointDistances(vtkPolyData* polyData, const double normal[3], NormalIndex& index)
+{
+  index.Normal[0] = normal[0];
+  index.Normal[1] = normal[1];
+  index.Normal[2] = normal[2];
+  index.BinWidth = 0.0;
+  index.BinOffsets.clear();
+  index.BinCellIds.clear();
+
+  vtkPoints* points = polyData->GetPoints();
+  vtkIdType numberOfPoints = points->GetNumberOfPoints();
+  index.PointDistances.resize(numberOfPoints);
+  index.MinimumDistance = VTK_DOUBLE_MAX;
+  index.MaximumDistance = VTK_DOUBLE_MIN;
+  double point[3] = { 0.0, 0.0, 0.0 };
+  for (vtkIdType pointId = 0; pointId < numberOfPoints; ++pointId)
+    {
+    points->GetPoint(pointId, point);
+    double distance = vtkMath::Dot(normal, point);
+    index.PointDistances[pointId] = distance;
+    index.MinimumDistance = std::min(index.MinimumDistance, distance);
+    index.MaximumDistance = std::max(index.MaximumDistance, distance);
+    }
+}
+
+//----------------------------------------------------------------------------
+/// Sort the cells into bins. Point distances must be computed already.
+void BuildNormalIndex(vtkPolyData* polyData, const MeshIndex& meshIndex, NormalIndex& index)
+{
+  // Interval of each cell that can be cut (vertices never are)
+  vtkCellArray* cellArrays[3] = { polyData->GetLines(), polyData->GetPolys(), polyData->GetStrips() };
+  vtkIdType firstCellId = meshIndex.NumberOfVerts;
+  vtkIdType numberOfCells = static_cast<vtkIdType>(meshIndex.CellOffsets.size()) - firstCellId;
+  std::vector<double> cellMinimum(numberOfCells);
+  std::vector<double> cellMaximum(numberOfCells);
+  double sumOfCellSizes = 0.0;
+  vtkIdType cellIndex = 0;
+  for (int arrayIndex = 0; arrayIndex < 3; ++arrayIndex)
+    {
+    vtkCellArray* cells = cellArrays[arrayIndex];
+    if (!cells || cells->GetNumberOfCells() == 0)
+      {
+      continue;
+      }
+    const vtkIdType* cellData = cells->GetPointer();
+    const vtkIdType size = cells->GetNumberOfConnectivityEntries();
+    for (vtkIdType offset = 0; offset < size; offset += cellData[offset] + 1, ++cellIndex)
+      {
+      double minimum = VTK_DOUBLE_MAX;
+      double maximum = VTK_DOUBLE_MIN;
+      for (vtkIdType i = 1; i <= cellData[offset]; ++i)
+        {
+        double distance = index.PointDistances[cellData[offset + i]];
+        minimum = std::min(minimum, distance);
+        maximum = std::max(maximum, distance);
+        }
+      cellMinimum[cellIndex] = minimum;
+      cellMaximum[cellIndex] = maximum;
+      if (minimum <= maximum)
+        {
+        sumOfCellSizes += maximum - minimum;
+        }
+      }
+    }
+
+  // Bins are about as wide as the average cell, so that most cells are in one or two bins
+  double range = index.MaximumDistance - index.MinimumDistance;
+  double binWidth = (numberOfCells > 0 ? sumOfCellSizes / numberOfCells : range);
+  binWidth = std::max(binWidth, range / MaximumNumberOfBins);
+  if (binWidth <= 0.0)
+    {
+    binWidth = 1.0;
+    }
+  vtkIdType numberOfBins = static_cast<vtkIdType>(range / binWidth) + 1;
+  numberOfBins = std::min(numberOfBins, std::max(vtkIdType(1), numberOfCells));
+  index.BinWidth = std::max(binWidth, range / numberOfBins);
+  if (index.BinWidth <= 0.0)
+    {
+    index.BinWidth = 1.0;
+    }
+
+  index.BinOffsets.assign(numberOfBins + 1, 0);
+  for (cellIndex = 0; cellIndex < numberOfCells; ++cellIndex)
+    {
+    if (cellMinimum[cellIndex] > cellMaximum[cellIndex])
+      {
+      // empty cell
+      continue;
+      }
+    vtkIdType lastBin = GetBin(index, cellMaximum[cellIndex]);
+    for (vtkIdType bin = GetBin(index, cellMinimum[cellIndex]); bin <= lastBin; ++bin)
+      {
+      ++index.BinOffsets[bin + 1];
+      }
+    }
+  for (vtkIdType bin = 0; bin < numberOfBins; ++bin)
+    {
+    index.BinOffsets[bin + 1] += index.BinOffsets[bin];
+    }
+  index.BinCellIds.resize(index.BinOffsets[numberOfBins]);
+  std::vector<vtkIdType> binSizes(numberOfBins, 0);
+  for (cellIndex = 0; cellIndex < numberOfCells; ++cellIndex)
+    {
+    if (cellMinimum[cellIndex] > cellMaximum[cellIndex])
+      {
+      continue;
+      }
+    vtkIdType lastBin = GetBin(index, cellMaximum[cellIndex]);
+    for (vtkIdType bin = GetBin(index, cellMinimum[cellIndex]); bin <= lastBin; ++bin)
+      {
+      index.BinCellIds[index.BinOffsets[bin] + binSizes[bin]] = firstCellId + cellIndex;
+      ++binSizes[bin];
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+/// Get the index of the mesh for the plane normal.
+/// The index is built when the normal is used the second time while it is among the
+/// most recently used candidate normals, until then only the point distances are computed
+/// (the returned index has no bins).
+/// sign is set to -1 if the index is for the opposite normal.
+const NormalIndex& GetNormalIndex(vtkPolyData* polyData, const double normal[3], double& sign)
+{
+  RemoveDeletedMeshIndices();
+  MeshIndex& meshIndex = GetMeshIndices()[polyData];
+  if (meshIndex.PolyData.GetPointer() != polyData || meshIndex.MeshTime != polyData->GetMTime())
+    {
+    InitializeMeshIndex(polyData, meshIndex);
+    }
+  unsigned long cacheTime = AdvanceCacheTime();
+
+  const double tolerance = 1e-9;
+  for (std::list<NormalIndex>::iterator it = meshIndex.NormalIndices.begin(); it != meshIndex.NormalIndices.end(); ++it)
+    {
+    double dot = vtkMath::Dot(it->Normal, normal);
+    if (fabs(fabs(dot) - 1.0) < tolerance)
+      {
+      sign = (dot > 0 ? 1.0 : -1.0);
+      it->LastUsedTime = cacheTime;
+      // Move to the front of the list as most recently used
+      meshIndex.NormalIndices.splice(meshIndex.NormalIndices.begin(), meshIndex.NormalIndices, it);
+      return meshIndex.NormalIndices.front();
+      }
+    }
+
+  std::list<CandidateNormal>::iterator candidateIt = meshIndex.CandidateNormals.begin();
+  for (; candidateIt != meshIndex.CandidateNormals.end(); ++candidateIt)
+    {
+    if (fabs(fabs(vtkMath::Dot(candidateIt->Normal, normal)) - 1.0) < tolerance)
+      {
+      break;
+      }
+    }
+  if (candidateIt != meshIndex.CandidateNormals.end())
+    {
+    ++candidateIt->UseCount;
+    meshIndex.CandidateNormals.splice(meshIndex.CandidateNormals.begin(), meshIndex.CandidateNormals, candidateIt);
+    }
+  else
+    {
+    // Seen for the first time, replace the least recently used candidate
+    CandidateNormal candidate;
+    candidate.Normal[0] = normal[0];
+    candidate.Normal[1] = normal[1];
+    candidate.Normal[2] = normal[2];
+    candidate.UseCount = 1;
+    meshIndex.CandidateNormals.push_front(candidate);
+    if (meshIndex.CandidateNormals.size() > MaximumNumberOfIndexedNormals)
+      {
+      meshIndex.CandidateNormals.pop_back();
+      }
+    }
+
+  // Point distances are computed for the current normal, so the sign is always positive
+  sign = 1.0;
+  NormalIndex& unindexedNormal = GetUnindexedNormal();
+  ComputePointDistances(polyData, normal, unindexedNormal);
+  if (meshIndex.CandidateNormals.front().UseCount < 2)
+    {
+    return unindexedNormal;
+    }
+
+  // Seen for the second time, index it
+  meshIndex.CandidateNormals.pop_front();
+  if (meshIndex.NormalIndices.size() >= MaximumNumberOfIndexedNormals)
+    {
+    meshIndex.NormalIndices.pop_back();
+    }
+  meshIndex.NormalIndices.push_front(NormalIndex());
+  NormalIndex& index = meshIndex.NormalIndices.front();
+  std::swap(index, unindexedNormal);
+  index.LastUsedTime = cacheTime;
+  BuildNormalIndex(polyData, meshIndex, index);
+  TrimIndexCache(&index);
+  return index;
+}
+
+//----------------------------------------------------------------------------
+/// Intersection of an edge and the plane. PointId1 < PointId2.
+struct EdgePoint
+{
+  vtkIdType PointId1;
+  vtkIdType PointId2;
+  double T;
+};
+
+//----------------------------------------------------------------------------
+/// Cut result of a range of cells. Cells refer to indices in Points.
+struct CutPiece
+{
+  std::vector<EdgePoint> Points;
+  std::vector<vtkIdType> Verts;
+  std::vector<vtkIdType> VertCellIds;
+  std::vector<vtkIdType> Lines;
+  std::vector<vtkIdType> LineCellIds;
+};
+
+//----------------------------------------------------------------------------
+struct CutJob
+{
+  vtkPoints* Points;
+  const MeshIndex* Mesh;
+  const NormalIndex* Index;
+  double PlaneDistance;
+  const vtkIdType* CellArrays[3];
+  /// Cells to cut. If NULL then the cells from FirstCellId are cut.
+  const vtkIdType* CellIds;
+  vtkIdType FirstCellId;
+  vtkIdType NumberOfCells;
+  std::vector<CutPiece> Pieces;
+};
+
+//----------------------------------------------------------------------------
+inline bool IsAbovePlane(const CutJob* job, vtkIdType pointId)
+{
+  return job->Index->PointDistances[pointId] >= job->PlaneDistance;
+}
+
+//----------------------------------------------------------------------------
+inline EdgePoint GetEdgePoint(const CutJob* job, vtkIdType pointId1, vtkIdType pointId2)
+{
+  EdgePoint edgePoint;
+  edgePoint.PointId1 = std::min(pointId1, pointId2);
+  edgePoint.PointId2 = std::max(pointId1, pointId2);
+  double distance1 = job->Index->PointDistances[edgePoint.PointId1];
+  double distance2 = job->Index->PointDistances[edgePoint.PointId2];
+  edgePoint.T = (job->PlaneDistance - distance1) / (distance2 - distance1);
+  return edgePoint;
+}
+
+//----------------------------------------------------------------------------
+inline void GetEdgePointPosition(const CutJob* job, const EdgePoint& edgePoint, double position[3])
+{
+  double point1[3] = { 0.0, 0.0, 0.0 };
+  double point2[3] = { 0.0, 0.0, 0.0 };
+  job->Points->GetPoint(edgePoint.PointId1, point1);
+  job->Points->GetPoint(edgePoint.PointId2, point2);
+  for (int i = 0; i < 3; ++i)
+    {
+    position[i] = point1[i] + edgePoint.T * (point2[i] - point1[i]);
+    }
+}
+
+//----------------------------------------------------------------------------
+/// Cut a closed polygon into line segments
+void CutPolygon(const CutJob* job, const vtkIdType* pointIds, vtkIdType numberOfPoints, vtkIdType cellId, CutPiece& piece)
+{
+  std::vector<EdgePoint> crossings;
+  for (vtkIdType i = 0; i < numberOfPoints; ++i)
+    {
+    vtkIdType pointId1 = pointIds[i];
+    vtkIdType pointId2 = pointIds[(i + 1) % numberOfPoints];
+    if (IsAbovePlane(job, pointId1) != IsAbovePlane(job, pointId2))
+      {
+      crossings.push_back(GetEdgePoint(job, pointId1, pointId2));
+      }
+    }
+  if (crossings.size() < 2)
+    {
+    return;
+    }
+  if (crossings.size() > 2)
+    {
+    // Non-convex polygon: the crossings are on the same line, pair them in their order along the line
+    std::vector<std::pair<double, size_t> > crossingOrder;
+    double start[3] = { 0.0, 0.0, 0.0 };
+    GetEdgePointPosition(job, crossings[0], start);
+    std::vector<double> positions(3 * crossings.size());
+    double direction[3] = { 0.0, 0.0, 0.0 };
+    double maximumLength = -1.0;
+    for (size_t i = 0; i < crossings.size(); ++i)
+      {
+      GetEdgePointPosition(job, crossings[i], &positions[3 * i]);
+      double offset[3] = { positions[3 * i] - start[0], positions[3 * i + 1] - start[1], positions[3 * i + 2] - start[2] };
+      double length = vtkMath::Norm(offset);
+      if (length > maximumLength)
+        {
+        maximumLength = length;
+        direction[0] = offset[0];
+        direction[1] = offset[1];
+        direction[2] = offset[2];
+        }
+      }
+    for (size_t i = 0; i < crossings.size(); ++i)
+      {
+      double offset[3] = { positions[3 * i] - start[0], positions[3 * i + 1] - start[1], positions[3 * i + 2] - start[2] };
+      crossingOrder.push_back(std::make_pair(vtkMath::Dot(offset, direction), i));
+      }
+    std::sort(crossingOrder.begin(), crossingOrder.end());
+    std::vector<EdgePoint> sortedCrossings;
+    for (size_t i = 0; i < crossingOrder.size(); ++i)
+      {
+      sortedCrossings.push_back(crossings[crossingOrder[i].second]);
+      }
+    crossings.swap(sortedCrossings);
+    }
+  for (size_t i = 0; i + 1 < crossings.size(); i += 2)
+    {
+    piece.Lines.push_back(static_cast<vtkIdType>(piece.Points.size()));
+    piece.Points.push_back(crossings[i]);
+    piece.Lines.push_back(static_cast<vtkIdType>(piece.Points.size()));
+    piece.Points.push_back(crossings[i + 1]);
+    piece.LineCellIds.push_back(cellId);
+    }
+}
+
+//----------------------------------------------------------------------------
+void CutCell(const CutJob* job, vtkIdType cellId, CutPiece& piece)
+{
+  const MeshIndex* mesh = job->Mesh;
+  const vtkIdType* cellData = NULL;
+  int cellType = 0; // 0: line, 1: polygon, 2: triangle strip
+  vtkIdType cellIndex = cellId - mesh->NumberOfVerts;
+  if (cellIndex < mesh->NumberOfLines)
+    {
+    cellType = 0;
+    }
+  else if (cellIndex < mesh->NumberOfLines + mesh->NumberOfPolys)
+    {
+    cellType = 1;
+    }
+  else
+    {
+    cellType = 2;
+    }
+  cellData = job->CellArrays[cellType] + mesh->CellOffsets[cellId];
+  vtkIdType numberOfPoints = cellData[0];
+  const vtkIdType* pointIds = cellData + 1;
+
+  if (cellType == 0)
+    {
+    // Polyline: each crossing segment gives a vertex
+    for (vtkIdType i = 0; i + 1 < numberOfPoints; ++i)
+      {
+      if (IsAbovePlane(job, pointIds[i]) != IsAbovePlane(job, pointIds[i + 1]))
+        {
+        piece.Verts.push_back(static_cast<vtkIdType>(piece.Points.size()));
+        piece.Points.push_back(GetEdgePoint(job, pointIds[i], pointIds[i + 1]));
+        piece.VertCellIds.push_back(cellId);
+        }
+      }
+    }
+  else if (cellType == 1)
+    {
+    CutPolygon(job, pointIds, numberOfPoints, cellId, piece);
+    }
+  else
+    {
+    for (vtkIdType i = 0; i + 2 < numberOfPoints; ++i)
+      {
+      CutPolygon(job, pointIds + i, 3, cellId, piece);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE CutCellsThreaderCallback(void *arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  CutJob* job = static_cast<CutJob*>(info->UserData);
+  vtkIdType startIndex = job->NumberOfCells * info->ThreadID / info->NumberOfThreads;
+  vtkIdType endIndex = job->NumberOfCells * (info->ThreadID + 1) / info->NumberOfThreads;
+  CutPiece& piece = job->Pieces[info->ThreadID];
+  for (vtkIdType i = startIndex; i < endIndex; ++i)
+    {
+    CutCell(job, job->CellIds ? job->CellIds[i] : job->FirstCellId + i, piece);
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+} // end of anonymous namespace
+
+vtkStandardNewMacro(vtkIndexedPlaneCutter);
+vtkCxxSetObjectMacro(vtkIndexedPlaneCutter, Plane, vtkPlane);
+
+//----------------------------------------------------------------------------
+vtkIndexedPlaneCutter::vtkIndexedPlaneCutter()
+{
+  this->Plane = NULL;
+  this->NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+}
+
+//----------------------------------------------------------------------------
+vtkIndexedPlaneCutter::~vtkIndexedPlaneCutter()
+{
+  this->SetPlane(NULL);
+  ReleaseMeshIndex(this->IndexedMesh);
+}
+
+//----------------------------------------------------------------------------
+void vtkIndexedPlaneCutter::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os,indent);
+
+  os << indent << "Plane: " << this->Plane << "\n";
+  if (this->Plane)
+    {
+    this->Plane->PrintSelf(os,indent.GetNextIndent());
+    }
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << "\n";
+}
+
+//----------------------------------------------------------------------------
+vtkMTimeType vtkIndexedPlaneCutter::GetMTime()
+{
+  vtkMTimeType mTime = this->Superclass::GetMTime();
+  if (this->Plane)
+    {
+    mTime = std::max(mTime, this->Plane->GetMTime());
+    }
+  return mTime;
+}
+
+//----------------------------------------------------------------------------
+void vtkIndexedPlaneCutter::ClearIndexCache()
+{
+  GetMeshIndices().clear();
+}
+
+//----------------------------------------------------------------------------
+int vtkIndexedPlaneCutter::GetNumberOfIndexedMeshes()
+{
+  RemoveDeletedMeshIndices();
+  return static_cast<int>(GetMeshIndices().size());
+}
+
+//----------------------------------------------------------------------------
+int vtkIndexedPlaneCutter::GetNumberOfIndexedNormals(vtkPolyData* polyData)
+{
+  RemoveDeletedMeshIndices();
+  MeshIndexMapType::iterator it = GetMeshIndices().find(polyData);
+  if (it == GetMeshIndices().end() || it->second.MeshTime != polyData->GetMTime())
+    {
+    return 0;
+    }
+  return static_cast<int>(it->second.NormalIndices.size());
+}
+
+//----------------------------------------------------------------------------
+void vtkIndexedPlaneCutter::SetMaximumIndexCacheSize(unsigned long kiB)
+{
+  GetMaximumIndexCacheSizeReference() = kiB;
+  TrimIndexCache(NULL);
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkIndexedPlaneCutter::GetMaximumIndexCacheSize()
+{
+  return GetMaximumIndexCacheSizeReference();
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkIndexedPlaneCutter::GetIndexCacheSize()
+{
+  RemoveDeletedMeshIndices();
+  return static_cast<unsigned long>((GetIndexCacheMemorySize() + 1023) / 1024);
+}
+
+//----------------------------------------------------------------------------
+int vtkIndexedPlaneCutter::FillInputPortInformation(int vtkNotUsed(port), vtkInformation *info)
+{
+  info->Set(vtkAlgorithm::INPUT_REQUIRED_DATA_TYPE(), "vtkPolyData");
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkIndexedPlaneCutter::RequestData(vtkInformation *vtkNotUsed(request),
+                                       vtkInformationVector **inputVector,
+                                       vtkInformationVector *outputVector)
+{
+  vtkPolyData* input = vtkPolyData::GetData(inputVector[0]);
+  vtkPolyData* output = vtkPolyData::GetData(outputVector);
+  if (!input || !output)
+    {
+    return 0;
+    }
+  if (!this->Plane)
+    {
+    vtkErrorMacro("vtkIndexedPlaneCutter::RequestData failed: plane is not set");
+    return 0;
+    }
+  if (!input->GetPoints() || input->GetNumberOfPoints() == 0 || input->GetNumberOfCells() == 0)
+    {
+    return 1;
+    }
+
+  double normal[3] = { 0.0, 0.0, 1.0 };
+  this->Plane->GetNormal(normal);
+  if (vtkMath::Normalize(normal) == 0.0)
+    {
+    vtkErrorMacro("vtkIndexedPlaneCutter::RequestData failed: invalid plane normal");
+    return 0;
+    }
+  double origin[3] = { 0.0, 0.0, 0.0 };
+  this->Plane->GetOrigin(origin);
+
+  double sign = 1.0;
+  const NormalIndex& index = GetNormalIndex(input, normal, sign);
+  MeshIndex& mesh = GetMeshIndices()[input];
+  if (this->IndexedMesh.GetPointer() != input)
+    {
+    ReleaseMeshIndex(this->IndexedMesh);
+    this->IndexedMesh = input;
+    ++mesh.NumberOfFilters;
+    }
+
+  CutJob job;
+  job.Points = input->GetPoints();
+  job.Mesh = &mesh;
+  job.Index = &index;
+  job.PlaneDistance = sign * vtkMath::Dot(normal, origin);
+  job.CellArrays[0] = input->GetLines()->GetPointer();
+  job.CellArrays[1] = input->GetPolys()->GetPointer();
+  job.CellArrays[2] = input->GetStrips()->GetPointer();
+  job.CellIds = NULL;
+  job.FirstCellId = mesh.NumberOfVerts;
+  job.NumberOfCells = 0;
+  if (index.BinOffsets.empty())
+    {
+    // Not indexed: all cells that can be cut (vertices never are) are tested
+    if (job.PlaneDistance >= index.MinimumDistance && job.PlaneDistance <= index.MaximumDistance)
+      {
+      job.NumberOfCells = static_cast<vtkIdType>(mesh.CellOffsets.size()) - mesh.NumberOfVerts;
+      }
+    }
+  else if (job.PlaneDistance >= index.MinimumDistance && job.PlaneDistance <= index.MaximumDistance)
+    {
+    vtkIdType bin = GetBin(index, job.PlaneDistance);
+    job.NumberOfCells = index.BinOffsets[bin + 1] - index.BinOffsets[bin];
+    if (job.NumberOfCells > 0)
+      {
+      job.CellIds = &index.BinCellIds[index.BinOffsets[bin]];
+      }
+    }
+
+  int numberOfThreads = static_cast<int>(std::min(
+    static_cast<vtkIdType>(this->NumberOfThreads), job.NumberOfCells / CutCellsMinimumRangeSize + 1));
+  job.Pieces.resize(numberOfThreads);
+  if (numberOfThreads > 1)
+    {
+    vtkNew<vtkMultiThreader> threader;
+    threader->SetNumberOfThreads(numberOfThreads);
+    threader->SetSingleMethod(CutCellsThreaderCallback, &job);
+    threader->SingleMethodExecute();
+    }
+  else if (job.NumberOfCells > 0)
+    {
+    vtkMultiThreader::ThreadInfo info;
+    info.ThreadID = 0;
+    info.NumberOfThreads = 1;
+    info.UserData = &job;
+    CutCellsThreaderCallback(&info);
+    }
+
+  // Merge the pieces. Points on the same edge are merged into one point.
+  vtkIdType numberOfOutputPoints = 0;
+  vtkIdType numberOfOutputVerts = 0;
+  vtkIdType numberOfOutputLines = 0;
+  for (std::vector<CutPiece>::iterator pieceIt = job.Pieces.begin(); pieceIt != job.Pieces.end(); ++pieceIt)
+    {
+    numberOfOutputPoints += static_cast<vtkIdType>(pieceIt->Points.size());
+    numberOfOutputVerts += static_cast<vtkIdType>(pieceIt->VertCellIds.size());
+    numberOfOutputLines += static_cast<vtkIdType>(pieceIt->LineCellIds.size());
+    }
+
+  vtkNew<vtkPoints> outputPoints;
+  outputPoints->SetDataType(input->GetPoints()->GetDataType());
+  outputPoints->Allocate(numberOfOutputPoints);
+  vtkPointData* inputPointData = input->GetPointData();
+  vtkPointData* outputPointData = output->GetPointData();
+  outputPointData->InterpolateAllocate(inputPointData, numberOfOutputPoints);
+  vtkCellData* inputCellData = input->GetCellData();
+  vtkCellData* outputCellData = output->GetCellData();
+  outputCellData->CopyAllocate(inputCellData, numberOfOutputVerts + numberOfOutputLines);
+
+  std::map<std::pair<vtkIdType, vtkIdType>, vtkIdType> edgePointIds;
+  std::vector<std::vector<vtkIdType> > piecePointIds(job.Pieces.size());
+  for (size_t pieceIndex = 0; pieceIndex < job.Pieces.size(); ++pieceIndex)
+    {
+    const CutPiece& piece = job.Pieces[pieceIndex];
+    std::vector<vtkIdType>& pointIds = piecePointIds[pieceIndex];
+    pointIds.resize(piece.Points.size());
+    for (size_t i = 0; i < piece.Points.size(); ++i)
+      {
+      const EdgePoint& edgePoint = piece.Points[i];
+      std::pair<vtkIdType, vtkIdType> edge(edgePoint.PointId1, edgePoint.PointId2);
+      std::map<std::pair<vtkIdType, vtkIdType>, vtkIdType>::iterator edgeIt = edgePointIds.find(edge);
+      if (edgeIt != edgePointIds.end())
+        {
+        pointIds[i] = edgeIt->second;
+        continue;
+        }
+      double position[3] = { 0.0, 0.0, 0.0 };
+      GetEdgePointPosition(&job, edgePoint, position);
+      vtkIdType pointId = outputPoints->InsertNextPoint(position);
+      outputPointData->InterpolateEdge(inputPointData, pointId, edgePoint.PointId1, edgePoint.PointId2, edgePoint.T);
+      edgePointIds[edge] = pointId;
+      pointIds[i] = pointId;
+      }
+    }
+
+  // Vertices come before lines in polydata cell order
+  vtkNew<vtkCellArray> outputVerts;
+  vtkNew<vtkCellArray> outputLines;
+  vtkIdType outputCellId = 0;
+  for (size_t pieceIndex = 0; pieceIndex < job.Pieces.size(); ++pieceIndex)
+    {
+    const CutPiece& piece = job.Pieces[pieceIndex];
+    const std::vector<vtkIdType>& pointIds = piecePointIds[pieceIndex];
+    for (size_t i = 0; i < piece.VertCellIds.size(); ++i)
+      {
+      vtkIdType pointId = pointIds[piece.Verts[i]];
+      outputVerts->InsertNextCell(1, &pointId);
+      outputCellData->CopyData(inputCellData, piece.VertCellIds[i], outputCellId++);
+      }
+    }
+  for (size_t pieceIndex = 0; pieceIndex < job.Pieces.size(); ++pieceIndex)
+    {
+    const CutPiece& piece = job.Pieces[pieceIndex];
+    const std::vector<vtkIdType>& pointIds = piecePointIds[pieceIndex];
+    for (size_t i = 0; i < piece.LineCellIds.size(); ++i)
+      {
+      vtkIdType linePointIds[2] = { pointIds[piece.Lines[2 * i]], pointIds[piece.Lines[2 * i + 1]] };
+      outputLines->InsertNextCell(2, linePointIds);
+      outputCellData->CopyData(inputCellData, piece.LineCellIds[i], outputCellId++);
+      }
+    }
+
+  output->SetPoints(outputPoints.GetPointer());
+  if (numberOfOutputVerts > 0)
+    {
+    output->SetVerts(outputVerts.GetPointer());
+    }
+  if (numberOfOutputLines > 0)
+    {
+    output->SetLines(outputLines.GetPointer());
+    }
+  output->Squeeze();
+  return 1;
+}
@@ -0,0 +1,112 @@
+/*=auto==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+===============================================================================auto=*/
+
+/// \brief vtkIndexedPlaneCutter - cut polydata with a plane using a cell index.
+///
+/// Computes the intersection of the input polydata with a plane, the same way
+/// as vtkCutter: polygons and triangle strips are cut into line segments and
+/// lines are cut into vertices. Point data is interpolated and cell data is copied.
+///
+/// Instead of visiting every cell of the input, cells are indexed by the interval
+/// that they cover along the plane normal. The index is built the second time
+/// that a mesh is cut with a plane of a given normal among the few most recently
+/// used normals (a plane that is only used once, such as an oblique slice while
+/// it is rotated, is cut without an index, the same way as vtkCutter does), and
+/// reused as long as the mesh is not modified. Indices are shared by all instances
+/// of the filter, so multiple views that show the same mesh need only one index
+/// per plane orientation. Only the cells whose interval contains the plane are
+/// tested, and these are split between multiple threads.
+///
+/// The memory used by all indices is limited by MaximumIndexCacheSize, least
+/// recently used indices are removed first. The indices of a mesh are removed
+/// when no instance of the filter cuts it anymore.
+///
+/// The shared index is not thread safe: all instances of the filter must be
+/// updated from the same thread.
+///
+
+#ifndef __vtkIndexedPlaneCutter_h
+#define __vtkIndexedPlaneCutter_h
+
+#include "vtkAddon.h"
+
+#include <vtkPolyDataAlgorithm.h>
+#include <vtkWeakPointer.h>
+
+class vtkPlane;
+
+class VTK_ADDON_EXPORT vtkIndexedPlaneCutter : public vtkPolyDataAlgorithm
+{
+public:
+  static vtkIndexedPlaneCutter *New();
+  vtkTypeMacro(vtkIndexedPlaneCutter,vtkPolyDataAlgorithm);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  // Description:
+  // Plane that the input is cut with.
+  virtual void SetPlane(vtkPlane*);
+  vtkGetObjectMacro(Plane,vtkPlane);
+
+  // Description:
+  // Maximum number of threads that cut the cells.
+  // Default is the global default number of threads of vtkMultiThreader.
+  vtkSetClampMacro(NumberOfThreads,int,1,VTK_INT_MAX);
+  vtkGetMacro(NumberOfThreads,int);
+
+  // Description:
+  // Include the modified time of the plane.
+  virtual vtkMTimeType GetMTime() VTK_OVERRIDE;
+
+  // Description:
+  // Remove all the cell indices that are shared by the instances of the filter.
+  static void ClearIndexCache();
+
+  // Description:
+  // Number of meshes that have a cell index in the shared cache.
+  static int GetNumberOfIndexedMeshes();
+
+  // Description:
+  // Number of plane normals that the mesh has a cell index for in the shared cache.
+  static int GetNumberOfIndexedNormals(vtkPolyData* polyData);
+
+  // Description:
+  // Limit of the memory used by all the cell indices in the shared cache (in kiB).
+  // Least recently used indices are removed when it is exceeded. Default is 256MiB.
+  static void SetMaximumIndexCacheSize(unsigned long kiB);
+  static unsigned long GetMaximumIndexCacheSize();
+
+  // Description:
+  // Memory used by all the cell indices in the shared cache (in kiB).
+  static unsigned long GetIndexCacheSize();
+
+protected:
+  vtkIndexedPlaneCutter();
+  ~vtkIndexedPlaneCutter();
+
+  virtual int RequestData(vtkInformation *, vtkInformationVector **, vtkInformationVector *) VTK_OVERRIDE;
+  virtual int FillInputPortInformation(int port, vtkInformation *info) VTK_OVERRIDE;
+
+  vtkPlane* Plane;
+  int NumberOfThreads;
+
+  // Mesh that was cut last, its index is kept in the shared cache for this instance
+  vtkWeakPointer<vtkPolyData> IndexedMesh;
+
+private:
+  vtkIndexedPlaneCutter(const vtkIndexedPlaneCutter&);  // Not implemented.
+  void operator=(const vtkIndexedPlaneCutter&);  // Not implemented.
+};
+
+#endif
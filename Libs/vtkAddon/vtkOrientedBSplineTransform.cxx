@@ -12,10 +12,34 @@
 #include "vtkImageData.h"
 #include "vtkMath.h"
 #include "vtkMatrix4x4.h"
+#include "vtkNew.h"
 #include "vtkObjectFactory.h"
+#include "vtkPoints.h"
 
 #include <math.h>
 
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+// Smallest number of points that is worth transforming in a separate thread
+const vtkIdType TransformPointsMinimumRangeSize = 1000;
+
+//----------------------------------------------------------------------------
+struct TransformPointsJob
+{
+  vtkOrientedBSplineTransform* Transform;
+  vtkPoints* InputPoints;
+  vtkPoints* OutputPoints;
+  vtkIdType OutputOffset;
+  // Inverse convergence failures in each thread
+  std::vector<int> NumberOfConvergenceFailures;
+  std::vector<double> FailedPoints;
+  std::vector<double> FailedErrors;
+};
+} // end of anonymous namespace
+
 vtkStandardNewMacro(vtkOrientedBSplineTransform);
 
 vtkCxxSetObjectMacro(vtkOrientedBSplineTransform,GridDirectionMatrix,vtkMatrix4x4);
@@ -263,6 +287,26 @@ void vtkOrientedBSplineTransform::InverseTransformDerivative(const double inPoin
     return;
     }
 
+  double error = 0.0;
+  int numberOfIterations = 0;
+  if (!this->IterativeInverseTransformDerivative(inPoint, outPoint, derivative,
+    NULL, error, numberOfIterations))
+    {
+    vtkWarningMacro("InverseTransformPoint: no convergence (" <<
+                    inPoint[0] << ", " << inPoint[1] << ", " << inPoint[2] <<
+                    ") error = " << error << " after " <<
+                    numberOfIterations << " iterations.");
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkOrientedBSplineTransform::IterativeInverseTransformDerivative(const double inPoint[3],
+                                                                     double outPoint[3],
+                                                                     double derivative[3][3],
+                                                                     const double* initialGuess,
+                                                                     double& error,
+                                                                     int& numberOfIterations)
+{
   void *gridPtr = this->GridPointer;
   int *extent = this->GridExtent;
   vtkIdType *increments = this->GridIncrements;
@@ -282,22 +326,31 @@ void vtkOrientedBSplineTransform::InverseTransformDerivative(const double inPoin
   double f = 1.0;
   double a;
 
-  double inPoint_IJK[3];
-  // Convert the inPoint to i,j,k indices into the deformation grid
-  // plus fractions
-  vtkLinearTransformPoint(this->OutputToGridIndexTransformMatrixCached->Element, inPoint, inPoint_IJK);
-
-  // first guess at inverse_IJK point, just subtract displacement
-  // (the inverse point is given in i,j,k indices plus fractions)
-  this->CalculateSpline(inPoint_IJK, deltaP, 0,
-                        gridPtr, extent, increments, this->BorderMode);
+  if (initialGuess)
+    {
+    inverse[0] = initialGuess[0];
+    inverse[1] = initialGuess[1];
+    inverse[2] = initialGuess[2];
+    }
+  else
+    {
+    double inPoint_IJK[3];
+    // Convert the inPoint to i,j,k indices into the deformation grid
+    // plus fractions
+    vtkLinearTransformPoint(this->OutputToGridIndexTransformMatrixCached->Element, inPoint, inPoint_IJK);
+
+    // first guess at inverse_IJK point, just subtract displacement
+    // (the inverse point is given in i,j,k indices plus fractions)
+    this->CalculateSpline(inPoint_IJK, deltaP, 0,
+                          gridPtr, extent, increments, this->BorderMode);
 
-  double inverseBulkTransformedInPoint[3];
-  vtkLinearTransformPoint(this->InverseBulkTransformMatrixCached->Element,inPoint,inverseBulkTransformedInPoint);
+    double inverseBulkTransformedInPoint[3];
+    vtkLinearTransformPoint(this->InverseBulkTransformMatrixCached->Element,inPoint,inverseBulkTransformedInPoint);
 
-  inverse[0] = inverseBulkTransformedInPoint[0] - deltaP[0]*scale;
-  inverse[1] = inverseBulkTransformedInPoint[1] - deltaP[1]*scale;
-  inverse[2] = inverseBulkTransformedInPoint[2] - deltaP[2]*scale;
+    inverse[0] = inverseBulkTransformedInPoint[0] - deltaP[0]*scale;
+    inverse[1] = inverseBulkTransformedInPoint[1] - deltaP[1]*scale;
+    inverse[2] = inverseBulkTransformedInPoint[2] - deltaP[2]*scale;
+    }
   lastInverse[0] = inverse[0];
   lastInverse[1] = inverse[1];
   lastInverse[2] = inverse[2];
@@ -418,17 +471,16 @@ void vtkOrientedBSplineTransform::InverseTransformDerivative(const double inPoin
     inverse[2] = lastInverse[2] - f*deltaI[2];
     }
 
-  if (iteration >= maxNumberOfIterations)
+  numberOfIterations = iteration;
+  error = sqrt(errorSquared);
+
+  bool converged = (iteration < maxNumberOfIterations);
+  if (!converged)
     {
     // didn't converge: back up to last good result
     inverse[0] = lastInverse[0];
     inverse[1] = lastInverse[1];
     inverse[2] = lastInverse[2];
-
-    vtkWarningMacro("InverseTransformPoint: no convergence (" <<
-                    inPoint[0] << ", " << inPoint[1] << ", " << inPoint[2] <<
-                    ") error = " << sqrt(errorSquared) << " after " <<
-                    iteration << " iterations.");
     }
 
   // Convert the inPoint to i,j,k indices into the deformation grid
@@ -436,6 +488,177 @@ void vtkOrientedBSplineTransform::InverseTransformDerivative(const double inPoin
   outPoint[0] = inverse[0];
   outPoint[1] = inverse[1];
   outPoint[2] = inverse[2];
+
+  return converged;
+}
+
+//----------------------------------------------------------------------------
+void vtkOrientedBSplineTransform::TransformPoints(vtkPoints *inPts, vtkPoints *outPts)
+{
+  this->Update();
+  if (!this->GridPointer || !this->CalculateSpline)
+    {
+    this->Superclass::TransformPoints(inPts, outPts);
+    return;
+    }
+
+  // Transformed points are appended to the output
+  vtkIdType numberOfPoints = inPts->GetNumberOfPoints();
+  vtkIdType outOffset = outPts->GetNumberOfPoints();
+  outPts->SetNumberOfPoints(outOffset + numberOfPoints);
+
+  int numberOfThreads = static_cast<int>(std::min(
+    static_cast<vtkIdType>(vtkMultiThreader::GetGlobalDefaultNumberOfThreads()),
+    numberOfPoints / TransformPointsMinimumRangeSize));
+  numberOfThreads = std::max(numberOfThreads, 1);
+
+  TransformPointsJob job;
+  job.Transform = this;
+  job.InputPoints = inPts;
+  job.OutputPoints = outPts;
+  job.OutputOffset = outOffset;
+  job.NumberOfConvergenceFailures.resize(numberOfThreads, 0);
+  job.FailedPoints.resize(3 * numberOfThreads, 0.0);
+  job.FailedErrors.resize(numberOfThreads, 0.0);
+  if (numberOfThreads == 1)
+    {
+    job.NumberOfConvergenceFailures[0] = this->TransformPointsInRange(inPts, outPts, outOffset,
+      0, numberOfPoints, &job.FailedPoints[0], job.FailedErrors[0]);
+    }
+  else
+    {
+    vtkNew<vtkMultiThreader> threader;
+    threader->SetNumberOfThreads(numberOfThreads);
+    threader->SetSingleMethod(vtkOrientedBSplineTransform::TransformPointsThreaderCallback, &job);
+    threader->SingleMethodExecute();
+    }
+  outPts->Modified();
+
+  // Warnings can only be logged from the main thread
+  int numberOfFailures = 0;
+  for (int threadId = 0; threadId < numberOfThreads; ++threadId)
+    {
+    numberOfFailures += job.NumberOfConvergenceFailures[threadId];
+    }
+  for (int threadId = 0; threadId < numberOfThreads; ++threadId)
+    {
+    if (job.NumberOfConvergenceFailures[threadId] > 0)
+      {
+      double* failedPoint = &job.FailedPoints[3 * threadId];
+      vtkWarningMacro("InverseTransformPoint: no convergence (" <<
+                      failedPoint[0] << ", " << failedPoint[1] << ", " << failedPoint[2] <<
+                      ") error = " << job.FailedErrors[threadId] << " after " <<
+                      this->InverseIterations << " iterations"
+                      " (total number of points without convergence: " << numberOfFailures << ").");
+      break;
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkOrientedBSplineTransform::TransformPointsThreaderCallback(void *arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  TransformPointsJob* job = static_cast<TransformPointsJob*>(info->UserData);
+  vtkIdType numberOfPoints = job->InputPoints->GetNumberOfPoints();
+  vtkIdType startId = numberOfPoints * info->ThreadID / info->NumberOfThreads;
+  vtkIdType endId = numberOfPoints * (info->ThreadID + 1) / info->NumberOfThreads;
+  job->NumberOfConvergenceFailures[info->ThreadID] = job->Transform->TransformPointsInRange(
+    job->InputPoints, job->OutputPoints, job->OutputOffset, startId, endId,
+    &job->FailedPoints[3 * info->ThreadID], job->FailedErrors[info->ThreadID]);
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+int vtkOrientedBSplineTransform::TransformPointsInRange(vtkPoints *inPts, vtkPoints *outPts, vtkIdType outOffset,
+  vtkIdType startId, vtkIdType endId, double failedPoint[3], double& failedError)
+{
+  double inPoint[3] = { 0.0, 0.0, 0.0 };
+  double outPoint[3] = { 0.0, 0.0, 0.0 };
+  if (!this->InverseFlag)
+    {
+    for (vtkIdType pointId = startId; pointId < endId; ++pointId)
+      {
+      inPts->GetPoint(pointId, inPoint);
+      this->ForwardTransformPoint(inPoint, outPoint);
+      outPts->SetPoint(outOffset + pointId, outPoint);
+      }
+    return 0;
+    }
+
+  // The inverse of the previous point is a good initial guess if the
+  // points are closer to each other than the grid spacing
+  double minimumSpacing = std::min(fabs(this->GridSpacing[0]),
+    std::min(fabs(this->GridSpacing[1]), fabs(this->GridSpacing[2])));
+  double maximumDistance2 = minimumSpacing * minimumSpacing;
+
+  int numberOfFailures = 0;
+  double derivative[3][3];
+  double previousInPoint[3] = { 0.0, 0.0, 0.0 };
+  double previousOutPoint[3] = { 0.0, 0.0, 0.0 };
+  bool previousConverged = false;
+  for (vtkIdType pointId = startId; pointId < endId; ++pointId)
+    {
+    inPts->GetPoint(pointId, inPoint);
+
+    double initialGuess[3] = { 0.0, 0.0, 0.0 };
+    bool useInitialGuess = previousConverged
+      && vtkMath::Distance2BetweenPoints(inPoint, previousInPoint) < maximumDistance2;
+    if (useInitialGuess)
+      {
+      double inPointDisplacement[3] = { inPoint[0] - previousInPoint[0],
+        inPoint[1] - previousInPoint[1], inPoint[2] - previousInPoint[2] };
+      if (this->BulkTransformMatrix)
+        {
+        // the inverse bulk transform is linear, so the displacement of the
+        // input point is mapped through it
+        const double (*inverseBulk)[4] = this->InverseBulkTransformMatrixCached->Element;
+        for (int i = 0; i < 3; i++)
+          {
+          initialGuess[i] = previousOutPoint[i] + inverseBulk[i][0]*inPointDisplacement[0]
+            + inverseBulk[i][1]*inPointDisplacement[1] + inverseBulk[i][2]*inPointDisplacement[2];
+          }
+        }
+      else
+        {
+        initialGuess[0] = previousOutPoint[0] + inPointDisplacement[0];
+        initialGuess[1] = previousOutPoint[1] + inPointDisplacement[1];
+        initialGuess[2] = previousOutPoint[2] + inPointDisplacement[2];
+        }
+      }
+
+    double error = 0.0;
+    int numberOfIterations = 0;
+    bool converged = this->IterativeInverseTransformDerivative(inPoint, outPoint, derivative,
+      useInitialGuess ? initialGuess : NULL, error, numberOfIterations);
+    if (!converged && useInitialGuess)
+      {
+      // try again from the default initial guess
+      converged = this->IterativeInverseTransformDerivative(inPoint, outPoint, derivative,
+        NULL, error, numberOfIterations);
+      }
+    if (!converged)
+      {
+      if (numberOfFailures == 0)
+        {
+        failedPoint[0] = inPoint[0];
+        failedPoint[1] = inPoint[1];
+        failedPoint[2] = inPoint[2];
+        failedError = error;
+        }
+      numberOfFailures++;
+      }
+    outPts->SetPoint(outOffset + pointId, outPoint);
+
+    previousInPoint[0] = inPoint[0];
+    previousInPoint[1] = inPoint[1];
+    previousInPoint[2] = inPoint[2];
+    previousOutPoint[0] = outPoint[0];
+    previousOutPoint[1] = outPoint[1];
+    previousOutPoint[2] = outPoint[2];
+    previousConverged = converged;
+    }
+  return numberOfFailures;
 }
 
 //----------------------------------------------------------------------------
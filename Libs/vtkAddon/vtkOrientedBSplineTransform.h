@@ -30,6 +30,7 @@
 #include "vtkAddon.h"
 
 #include "vtkBSplineTransform.h"
+#include "vtkMultiThreader.h"
 
 class VTK_ADDON_EXPORT vtkOrientedBSplineTransform : public vtkBSplineTransform
 {
@@ -56,6 +57,13 @@ public:
   virtual void SetBulkTransformMatrix(vtkMatrix4x4*);
   vtkGetObjectMacro(BulkTransformMatrix,vtkMatrix4x4);
 
+  // Description:
+  // Transform a series of points. The points are split between multiple
+  // threads. When the inverse is computed, the iterative search of each point
+  // starts from the inverse of the previous point if the points are close
+  // to each other (e.g., consecutive mesh or grid points).
+  void TransformPoints(vtkPoints *inPts, vtkPoints *outPts) VTK_OVERRIDE;
+
 protected:
   vtkOrientedBSplineTransform();
   ~vtkOrientedBSplineTransform();
@@ -81,6 +89,23 @@ protected:
                                   double derivative[3][3]) VTK_OVERRIDE;
   using Superclass::InverseTransformDerivative; // Inherit the float version from parent
 
+  // Description:
+  // Compute the inverse transform of a point using Newton's method.
+  // If initialGuess is not NULL then the search starts from that point.
+  // Returns false if the iteration did not converge. It does not log any
+  // messages, therefore it can be called from multiple threads.
+  bool IterativeInverseTransformDerivative(const double in[3], double out[3],
+                                           double derivative[3][3], const double* initialGuess,
+                                           double& error, int& numberOfIterations);
+
+  // Description:
+  // Transform the points in the [startId, endId) range, used by TransformPoints().
+  // Returns the number of points where the inverse computation did not converge.
+  int TransformPointsInRange(vtkPoints *inPts, vtkPoints *outPts, vtkIdType outOffset,
+                             vtkIdType startId, vtkIdType endId, double failedPoint[3], double& failedError);
+
+  static VTK_THREAD_RETURN_TYPE TransformPointsThreaderCallback(void *arg);
+
   // Description:
   // Grid axis direction vectors (i, j, k) in the output space
   vtkMatrix4x4* GridDirectionMatrix;
@@ -13,6 +13,29 @@
 #include "vtkMatrix4x4.h"
 #include "vtkNew.h"
 #include "vtkObjectFactory.h"
+#include "vtkPoints.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+// Smallest number of points that is worth transforming in a separate thread
+const vtkIdType TransformPointsMinimumRangeSize = 1000;
+
+//----------------------------------------------------------------------------
+struct TransformPointsJob
+{
+  vtkOrientedGridTransform* Transform;
+  vtkPoints* InputPoints;
+  vtkPoints* OutputPoints;
+  vtkIdType OutputOffset;
+  // Inverse convergence failures in each thread
+  std::vector<int> NumberOfConvergenceFailures;
+  std::vector<double> FailedPoints;
+  std::vector<double> FailedErrors;
+};
+} // end of anonymous namespace
 
 vtkStandardNewMacro(vtkOrientedGridTransform);
 
@@ -175,16 +198,13 @@ void vtkOrientedGridTransform::ForwardTransformDerivative(const double inPoint[3
 }
 
 //----------------------------------------------------------------------------
-void vtkOrientedGridTransform::InverseTransformDerivative(const double inPoint[3],
-                                                  double outPoint[3],
-                                                  double derivative[3][3])
+bool vtkOrientedGridTransform::IterativeInverseTransformDerivative(const double inPoint[3],
+                                                                  double outPoint[3],
+                                                                  double derivative[3][3],
+                                                                  const double* initialGuess,
+                                                                  double& error,
+                                                                  int& numberOfIterations)
 {
-  if (this->GridDirectionMatrix == NULL || this->GridPointer == NULL)
-    {
-    this->Superclass::InverseTransformDerivative(inPoint,outPoint,derivative);
-    return;
-    }
-
   void *gridPtr = this->GridPointer;
   int gridType = this->GridScalarType;
 
@@ -208,17 +228,26 @@ void vtkOrientedGridTransform::InverseTransformDerivative(const double inPoint[3
   double f = 1.0;
   double a;
 
-  // convert the inPoint to i,j,k indices plus fractions
-  vtkLinearTransformPoint(this->OutputToGridIndexTransformMatrixCached->Element, inPoint, point);
+  if (initialGuess)
+    {
+    inverse[0] = initialGuess[0];
+    inverse[1] = initialGuess[1];
+    inverse[2] = initialGuess[2];
+    }
+  else
+    {
+    // convert the inPoint to i,j,k indices plus fractions
+    vtkLinearTransformPoint(this->OutputToGridIndexTransformMatrixCached->Element, inPoint, point);
 
-  // first guess at inverse point, just subtract displacement
-  // (the inverse point is given in i,j,k indices plus fractions)
-  this->InterpolationFunction(point, deltaP, NULL,
-                              gridPtr, gridType, extent, increments);
+    // first guess at inverse point, just subtract displacement
+    // (the inverse point is given in i,j,k indices plus fractions)
+    this->InterpolationFunction(point, deltaP, NULL,
+                                gridPtr, gridType, extent, increments);
 
-  inverse[0] = inPoint[0] - (deltaP[0]*scale + shift);
-  inverse[1] = inPoint[1] - (deltaP[1]*scale + shift);
-  inverse[2] = inPoint[2] - (deltaP[2]*scale + shift);
+    inverse[0] = inPoint[0] - (deltaP[0]*scale + shift);
+    inverse[1] = inPoint[1] - (deltaP[1]*scale + shift);
+    inverse[2] = inPoint[2] - (deltaP[2]*scale + shift);
+    }
   lastInverse[0] = inverse[0];
   lastInverse[1] = inverse[1];
   lastInverse[2] = inverse[2];
@@ -315,31 +344,209 @@ void vtkOrientedGridTransform::InverseTransformDerivative(const double inPoint[3
     inverse[2] = lastInverse[2] - f*deltaI[2];
     }
 
-  vtkDebugMacro("Inverse Iterations: " << (i+1));
+  numberOfIterations = i+1;
+  error = sqrt(errorSquared);
 
-  if (i >= n)
+  bool converged = (i < n);
+  if (!converged)
     {
     // didn't converge: back up to last good result
     inverse[0] = lastInverse[0];
     inverse[1] = lastInverse[1];
     inverse[2] = lastInverse[2];
-
-    if (this->MTime > this->LastWarningMTime)
-      {
-      vtkWarningMacro("InverseTransformPoint: no convergence (" <<
-                      inPoint[0] << ", " << inPoint[1] << ", " << inPoint[2] <<
-                      ") error = " << sqrt(errorSquared) << " after " <<
-                      i << " iterations."
-                      "  Further convergence warnings suppressed until transform is modified.");
-      this->LastWarningMTime = this->MTime;
-      }
-    this->InvokeEvent(vtkOrientedGridTransform::ConvergenceFailureEvent);
+    numberOfIterations = i;
     }
 
   // convert point
   outPoint[0] = inverse[0];
   outPoint[1] = inverse[1];
   outPoint[2] = inverse[2];
+
+  return converged;
+}
+
+//----------------------------------------------------------------------------
+void vtkOrientedGridTransform::InverseTransformDerivative(const double inPoint[3],
+                                                  double outPoint[3],
+                                                  double derivative[3][3])
+{
+  if (this->GridDirectionMatrix == NULL || this->GridPointer == NULL)
+    {
+    this->Superclass::InverseTransformDerivative(inPoint,outPoint,derivative);
+    return;
+    }
+
+  double error = 0.0;
+  int numberOfIterations = 0;
+  bool converged = this->IterativeInverseTransformDerivative(inPoint, outPoint, derivative,
+    NULL, error, numberOfIterations);
+
+  vtkDebugMacro("Inverse Iterations: " << numberOfIterations);
+
+  if (!converged)
+    {
+    this->ReportConvergenceFailure(inPoint, error, numberOfIterations);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkOrientedGridTransform::ReportConvergenceFailure(const double inPoint[3],
+                                                        double error, int numberOfIterations)
+{
+  if (this->MTime > this->LastWarningMTime)
+    {
+    vtkWarningMacro("InverseTransformPoint: no convergence (" <<
+                    inPoint[0] << ", " << inPoint[1] << ", " << inPoint[2] <<
+                    ") error = " << error << " after " <<
+                    numberOfIterations << " iterations."
+                    "  Further convergence warnings suppressed until transform is modified.");
+    this->LastWarningMTime = this->MTime;
+    }
+  this->InvokeEvent(vtkOrientedGridTransform::ConvergenceFailureEvent);
+}
+
+//----------------------------------------------------------------------------
+void vtkOrientedGridTransform::TransformPoints(vtkPoints *inPts, vtkPoints *outPts)
+{
+  this->Update();
+  if (this->GridDirectionMatrix == NULL || this->GridPointer == NULL)
+    {
+    this->Superclass::TransformPoints(inPts, outPts);
+    return;
+    }
+
+  // Transformed points are appended to the output
+  vtkIdType numberOfPoints = inPts->GetNumberOfPoints();
+  vtkIdType outOffset = outPts->GetNumberOfPoints();
+  outPts->SetNumberOfPoints(outOffset + numberOfPoints);
+
+  int numberOfThreads = static_cast<int>(std::min(
+    static_cast<vtkIdType>(vtkMultiThreader::GetGlobalDefaultNumberOfThreads()),
+    numberOfPoints / TransformPointsMinimumRangeSize));
+  numberOfThreads = std::max(numberOfThreads, 1);
+
+  TransformPointsJob job;
+  job.Transform = this;
+  job.InputPoints = inPts;
+  job.OutputPoints = outPts;
+  job.OutputOffset = outOffset;
+  job.NumberOfConvergenceFailures.resize(numberOfThreads, 0);
+  job.FailedPoints.resize(3 * numberOfThreads, 0.0);
+  job.FailedErrors.resize(numberOfThreads, 0.0);
+  if (numberOfThreads == 1)
+    {
+    job.NumberOfConvergenceFailures[0] = this->TransformPointsInRange(inPts, outPts, outOffset,
+      0, numberOfPoints, &job.FailedPoints[0], job.FailedErrors[0]);
+    }
+  else
+    {
+    vtkNew<vtkMultiThreader> threader;
+    threader->SetNumberOfThreads(numberOfThreads);
+    threader->SetSingleMethod(vtkOrientedGridTransform::TransformPointsThreaderCallback, &job);
+    threader->SingleMethodExecute();
+    }
+  outPts->Modified();
+
+  // Warnings and events can only be issued from the main thread
+  for (int threadId = 0; threadId < numberOfThreads; ++threadId)
+    {
+    if (job.NumberOfConvergenceFailures[threadId] > 0)
+      {
+      this->ReportConvergenceFailure(&job.FailedPoints[3 * threadId],
+        job.FailedErrors[threadId], this->InverseIterations);
+      break;
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkOrientedGridTransform::TransformPointsThreaderCallback(void *arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  TransformPointsJob* job = static_cast<TransformPointsJob*>(info->UserData);
+  vtkIdType numberOfPoints = job->InputPoints->GetNumberOfPoints();
+  vtkIdType startId = numberOfPoints * info->ThreadID / info->NumberOfThreads;
+  vtkIdType endId = numberOfPoints * (info->ThreadID + 1) / info->NumberOfThreads;
+  job->NumberOfConvergenceFailures[info->ThreadID] = job->Transform->TransformPointsInRange(
+    job->InputPoints, job->OutputPoints, job->OutputOffset, startId, endId,
+    &job->FailedPoints[3 * info->ThreadID], job->FailedErrors[info->ThreadID]);
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+int vtkOrientedGridTransform::TransformPointsInRange(vtkPoints *inPts, vtkPoints *outPts, vtkIdType outOffset,
+  vtkIdType startId, vtkIdType endId, double failedPoint[3], double& failedError)
+{
+  double inPoint[3] = { 0.0, 0.0, 0.0 };
+  double outPoint[3] = { 0.0, 0.0, 0.0 };
+  if (!this->InverseFlag)
+    {
+    for (vtkIdType pointId = startId; pointId < endId; ++pointId)
+      {
+      inPts->GetPoint(pointId, inPoint);
+      this->ForwardTransformPoint(inPoint, outPoint);
+      outPts->SetPoint(outOffset + pointId, outPoint);
+      }
+    return 0;
+    }
+
+  // The inverse of the previous point is a good initial guess if the
+  // points are closer to each other than the grid spacing
+  double minimumSpacing = std::min(fabs(this->GridSpacing[0]),
+    std::min(fabs(this->GridSpacing[1]), fabs(this->GridSpacing[2])));
+  double maximumDistance2 = minimumSpacing * minimumSpacing;
+
+  int numberOfFailures = 0;
+  double derivative[3][3];
+  double previousInPoint[3] = { 0.0, 0.0, 0.0 };
+  double previousOutPoint[3] = { 0.0, 0.0, 0.0 };
+  bool previousConverged = false;
+  for (vtkIdType pointId = startId; pointId < endId; ++pointId)
+    {
+    inPts->GetPoint(pointId, inPoint);
+
+    double initialGuess[3] = { 0.0, 0.0, 0.0 };
+    bool useInitialGuess = previousConverged
+      && vtkMath::Distance2BetweenPoints(inPoint, previousInPoint) < maximumDistance2;
+    if (useInitialGuess)
+      {
+      initialGuess[0] = previousOutPoint[0] + (inPoint[0] - previousInPoint[0]);
+      initialGuess[1] = previousOutPoint[1] + (inPoint[1] - previousInPoint[1]);
+      initialGuess[2] = previousOutPoint[2] + (inPoint[2] - previousInPoint[2]);
+      }
+
+    double error = 0.0;
+    int numberOfIterations = 0;
+    bool converged = this->IterativeInverseTransformDerivative(inPoint, outPoint, derivative,
+      useInitialGuess ? initialGuess : NULL, error, numberOfIterations);
+    if (!converged && useInitialGuess)
+      {
+      // try again from the default initial guess
+      converged = this->IterativeInverseTransformDerivative(inPoint, outPoint, derivative,
+        NULL, error, numberOfIterations);
+      }
+    if (!converged)
+      {
+      if (numberOfFailures == 0)
+        {
+        failedPoint[0] = inPoint[0];
+        failedPoint[1] = inPoint[1];
+        failedPoint[2] = inPoint[2];
+        failedError = error;
+        }
+      numberOfFailures++;
+      }
+    outPts->SetPoint(outOffset + pointId, outPoint);
+
+    previousInPoint[0] = inPoint[0];
+    previousInPoint[1] = inPoint[1];
+    previousInPoint[2] = inPoint[2];
+    previousOutPoint[0] = outPoint[0];
+    previousOutPoint[1] = outPoint[1];
+    previousOutPoint[2] = outPoint[2];
+    previousConverged = converged;
+    }
+  return numberOfFailures;
 }
 
 //----------------------------------------------------------------------------
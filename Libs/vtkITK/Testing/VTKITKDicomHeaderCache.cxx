@@ -0,0 +1,129 @@
+
+#include <vtkITKArchetypeImageSeriesReader.h>
+
+// ITK includes
+#include <itkConfigure.h>
+#include <itkFactoryRegistration.h>
+
+// ITKSYS includes
+#include <itksys/SystemTools.hxx>
+
+// STD includes
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// Analyze the headers of the files and return how many headers were not found in the cache
+int ReadDicomHeaders(const std::vector<std::string>& fileNames)
+{
+  vtkITKArchetypeImageSeriesReader* reader = vtkITKArchetypeImageSeriesReader::New();
+  reader->SetArchetype(fileNames[0].c_str());
+  for (unsigned int f = 0; f < fileNames.size(); f++)
+    {
+    reader->AddFileName(fileNames[f].c_str());
+    }
+  reader->SetOutputScalarTypeToNative();
+  reader->SetDesiredCoordinateOrientationToNative();
+  reader->UpdateInformation();
+  int numberOfDicomHeadersRead = reader->GetNumberOfDicomHeadersRead();
+  reader->Delete();
+  return numberOfDicomHeadersRead;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  itk::itkFactoryRegistration();
+
+  if (argc < 3)
+    {
+    std::cout << "ERROR: need to specify the DICOM directory and a temporary directory on the command line." << std::endl;
+    return 1;
+    }
+
+  // Copy a few slices, so that they can be modified
+  std::string dicomDirectory = argv[1];
+  std::string temporaryDirectory = std::string(argv[2]) + "/VTKITKDicomHeaderCache";
+  itksys::SystemTools::RemoveADirectory(temporaryDirectory.c_str());
+  itksys::SystemTools::MakeDirectory(temporaryDirectory.c_str());
+  const char* sliceNames[3] = { "CTHead15.dcm", "CTHead17.dcm", "CTHead19.dcm" };
+  std::vector<std::string> fileNames;
+  for (int i = 0; i < 3; i++)
+    {
+    std::string fileName = temporaryDirectory + "/" + sliceNames[i];
+    itksys::SystemTools::CopyFileAlways((dicomDirectory + "/" + sliceNames[i]).c_str(), fileName.c_str());
+    fileNames.push_back(fileName);
+    }
+
+  std::string cacheFileName = temporaryDirectory + "/DicomHeaderCache.txt";
+  vtkITKArchetypeImageSeriesReader::SetDicomHeaderCacheFileName(cacheFileName);
+  vtkITKArchetypeImageSeriesReader::ClearDicomHeaderCache();
+
+  // All headers are read the first time
+  int numberOfDicomHeadersRead = ReadDicomHeaders(fileNames);
+  if (numberOfDicomHeadersRead != 3
+    || vtkITKArchetypeImageSeriesReader::GetDicomHeaderCacheNumberOfFiles() != 3)
+    {
+    std::cout << "ERROR: headers are not stored in the cache, read " << numberOfDicomHeadersRead << " headers" << std::endl;
+    return 1;
+    }
+
+  // Unchanged files are found in the cache
+  numberOfDicomHeadersRead = ReadDicomHeaders(fileNames);
+  if (numberOfDicomHeadersRead != 0)
+    {
+    std::cout << "ERROR: cached headers are not used, read " << numberOfDicomHeadersRead << " headers" << std::endl;
+    return 1;
+    }
+
+  // Replacing a slice by one of different file size invalidates its header only
+  itksys::SystemTools::CopyFileAlways((dicomDirectory + "/CTHead10.dcm").c_str(), fileNames[0].c_str());
+  numberOfDicomHeadersRead = ReadDicomHeaders(fileNames);
+  if (numberOfDicomHeadersRead != 1)
+    {
+    std::cout << "ERROR: modified file is not read again, read " << numberOfDicomHeadersRead << " headers" << std::endl;
+    return 1;
+    }
+
+  // Headers are loaded from the cache file after the cache in memory is released
+  if (!itksys::SystemTools::FileExists(cacheFileName.c_str(), true))
+    {
+    std::cout << "ERROR: cache file is not written" << std::endl;
+    return 1;
+    }
+  vtkITKArchetypeImageSeriesReader::SetDicomHeaderCacheFileName("");
+  vtkITKArchetypeImageSeriesReader::ClearDicomHeaderCache();
+  vtkITKArchetypeImageSeriesReader::SetDicomHeaderCacheFileName(cacheFileName);
+  numberOfDicomHeadersRead = ReadDicomHeaders(fileNames);
+  if (numberOfDicomHeadersRead != 0)
+    {
+    std::cout << "ERROR: headers are not loaded from the cache file, read " << numberOfDicomHeadersRead << " headers" << std::endl;
+    return 1;
+    }
+
+  // Least recently used headers are removed when the cache size is limited
+  vtkITKArchetypeImageSeriesReader::SetDicomHeaderCacheMaximumNumberOfFiles(2);
+  if (vtkITKArchetypeImageSeriesReader::GetDicomHeaderCacheNumberOfFiles() != 2)
+    {
+    std::cout << "ERROR: cache size is not limited" << std::endl;
+    return 1;
+    }
+  std::vector<std::string> lastFileNames(fileNames.begin() + 1, fileNames.end());
+  numberOfDicomHeadersRead = ReadDicomHeaders(lastFileNames);
+  if (numberOfDicomHeadersRead != 0)
+    {
+    std::cout << "ERROR: most recently used headers are removed from the cache" << std::endl;
+    return 1;
+    }
+
+  vtkITKArchetypeImageSeriesReader::ClearDicomHeaderCache();
+  if (vtkITKArchetypeImageSeriesReader::GetDicomHeaderCacheNumberOfFiles() != 0
+    || itksys::SystemTools::FileExists(cacheFileName.c_str(), true))
+    {
+    std::cout << "ERROR: cache is not cleared" << std::endl;
+    return 1;
+    }
+
+  std::cout << "DICOM header cache test passed" << std::endl;
+  return 0;
+}
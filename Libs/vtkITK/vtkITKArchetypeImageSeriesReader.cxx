@@ -35,10 +35,21 @@
 #include <itkMetaDataObjectBase.h>
 #include <itkMetaDataObject.h>
 #include <itkMetaImageIO.h>
+#include <itkMultiThreader.h>
+#include <itkSimpleFastMutexLock.h>
 #include <itkTimeProbe.h>
 
+// ITKSYS includes
+#include <itksys/SystemTools.hxx>
+
 // STD includes
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <list>
+#include <map>
+#include <set>
 #include <vector>
 
 #include "itkArchetypeSeriesFileNames.h"
@@ -48,10 +59,306 @@
 #include "itkDCMTKImageIO.h"
 #include "itkGDCMSeriesFileNames.h"
 #include "itkGDCMImageIO.h"
+#include "gdcmReader.h"
+#include "gdcmStringFilter.h"
 #endif
 
 vtkStandardNewMacro(vtkITKArchetypeImageSeriesReader);
 
+#ifdef VTKITK_BUILD_DICOM_SUPPORT
+namespace
+{
+
+/// DICOM tags that are used for grouping and sorting the files
+enum DicomHeaderTagIndex
+{
+  SeriesInstanceUIDTag = 0,
+  ContentTimeTag,
+  TriggerTimeTag,
+  EchoNumbersTag,
+  DiffusionGradientOrientationTag,
+  SliceLocationTag,
+  ImageOrientationPatientTag,
+  ImagePositionPatientTag,
+  NumberOfDicomHeaderTags
+};
+
+const char* const DicomHeaderTags[NumberOfDicomHeaderTags] =
+{
+  "0020|000e", "0008|0033", "0018|1060", "0018|0086",
+  "0010|9089", "0020|1041", "0020|0037", "0020|0032"
+};
+
+/// Tag values of a file, without spaces
+struct DicomHeader
+{
+  DicomHeader() : ModifiedTime(0), FileSize(0) {}
+  long ModifiedTime;
+  unsigned long FileSize;
+  std::string TagValues[NumberOfDicomHeaderTags];
+};
+
+/// Header of a file in the cache and its position in the least recently used list
+struct DicomHeaderCacheEntry
+{
+  DicomHeader Header;
+  std::list<std::string>::iterator RecentlyUsedIt;
+};
+
+/// Headers of the files that have already been analyzed.
+/// An entry is only used if the file has not changed since it was read.
+std::map<std::string, DicomHeaderCacheEntry> DicomHeaderCache;
+/// File names in the cache, least recently used first
+std::list<std::string> DicomHeaderCacheRecentlyUsed;
+unsigned int DicomHeaderCacheMaximumNumberOfFiles = 100000;
+/// File that the cache is loaded from and saved to. Empty means the cache is in memory only.
+std::string DicomHeaderCacheFileName;
+bool DicomHeaderCacheFileLoaded = false;
+itk::SimpleFastMutexLock DicomHeaderCacheLock;
+
+const char* const DicomHeaderCacheFileSignature = "vtkITKDicomHeaderCache 1";
+
+//----------------------------------------------------------------------------
+/// Remove the least recently used headers so that the cache does not exceed its maximum size.
+/// The cache must be locked by the caller.
+void RemoveObsoleteDicomHeaders()
+{
+  while (DicomHeaderCache.size() > DicomHeaderCacheMaximumNumberOfFiles)
+    {
+    DicomHeaderCache.erase(DicomHeaderCacheRecentlyUsed.front());
+    DicomHeaderCacheRecentlyUsed.pop_front();
+    }
+}
+
+//----------------------------------------------------------------------------
+/// Add or update the header of a file and make it the most recently used one.
+/// The cache must be locked by the caller.
+void StoreDicomHeader(const std::string& fileName, const DicomHeader& header)
+{
+  std::map<std::string, DicomHeaderCacheEntry>::iterator cachedIt = DicomHeaderCache.find(fileName);
+  if (cachedIt != DicomHeaderCache.end())
+    {
+    DicomHeaderCacheRecentlyUsed.splice(DicomHeaderCacheRecentlyUsed.end(),
+      DicomHeaderCacheRecentlyUsed, cachedIt->second.RecentlyUsedIt);
+    cachedIt->second.Header = header;
+    return;
+    }
+  DicomHeaderCacheEntry& entry = DicomHeaderCache[fileName];
+  entry.Header = header;
+  entry.RecentlyUsedIt = DicomHeaderCacheRecentlyUsed.insert(DicomHeaderCacheRecentlyUsed.end(), fileName);
+  RemoveObsoleteDicomHeaders();
+}
+
+//----------------------------------------------------------------------------
+/// Read the headers that were saved to the cache file into the cache.
+/// The cache must be locked by the caller.
+void LoadDicomHeaderCache()
+{
+  if (DicomHeaderCacheFileLoaded || DicomHeaderCacheFileName.empty())
+    {
+    return;
+    }
+  DicomHeaderCacheFileLoaded = true;
+  std::ifstream cacheFile(DicomHeaderCacheFileName.c_str());
+  std::string line;
+  if (!cacheFile.is_open() || !std::getline(cacheFile, line) || line != DicomHeaderCacheFileSignature)
+    {
+    // no cache file yet, or it is written in a different format
+    return;
+    }
+  // Each line contains tab separated file name, modification time, file size, and tag values
+  while (std::getline(cacheFile, line))
+    {
+    std::vector<std::string> fields;
+    std::string::size_type fieldStart = 0;
+    std::string::size_type fieldEnd = line.find('\t');
+    while (fieldEnd != std::string::npos)
+      {
+      fields.push_back(line.substr(fieldStart, fieldEnd - fieldStart));
+      fieldStart = fieldEnd + 1;
+      fieldEnd = line.find('\t', fieldStart);
+      }
+    fields.push_back(line.substr(fieldStart));
+    if (fields.size() != 3 + NumberOfDicomHeaderTags || fields[0].empty())
+      {
+      continue;
+      }
+    DicomHeader header;
+    header.ModifiedTime = atol(fields[1].c_str());
+    header.FileSize = strtoul(fields[2].c_str(), NULL, 10);
+    for (int t = 0; t < NumberOfDicomHeaderTags; t++)
+      {
+      header.TagValues[t] = fields[3 + t];
+      }
+    StoreDicomHeader(fields[0], header);
+    }
+}
+
+//----------------------------------------------------------------------------
+/// Write all headers of the cache into the cache file.
+/// The cache must be locked by the caller.
+void SaveDicomHeaderCache()
+{
+  if (DicomHeaderCacheFileName.empty())
+    {
+    return;
+    }
+  // Write into a temporary file first so that an interrupted write does not corrupt the cache file
+  std::string temporaryFileName = DicomHeaderCacheFileName + ".tmp";
+  std::ofstream cacheFile(temporaryFileName.c_str(), std::ios::out | std::ios::trunc);
+  if (!cacheFile.is_open())
+    {
+    return;
+    }
+  cacheFile << DicomHeaderCacheFileSignature << "\n";
+  // Least recently used first, so that loading the file restores the order
+  for (std::list<std::string>::iterator fileNameIt = DicomHeaderCacheRecentlyUsed.begin();
+    fileNameIt != DicomHeaderCacheRecentlyUsed.end(); ++fileNameIt)
+    {
+    if (fileNameIt->find_first_of("\t\r\n") != std::string::npos)
+      {
+      // file name cannot be stored in the tab separated format
+      continue;
+      }
+    const DicomHeader& header = DicomHeaderCache[*fileNameIt].Header;
+    cacheFile << *fileNameIt << "\t" << header.ModifiedTime << "\t" << header.FileSize;
+    for (int t = 0; t < NumberOfDicomHeaderTags; t++)
+      {
+      // tag values do not contain whitespace
+      cacheFile << "\t" << header.TagValues[t];
+      }
+    cacheFile << "\n";
+    }
+  cacheFile.close();
+  if (cacheFile.fail())
+    {
+    itksys::SystemTools::RemoveFile(temporaryFileName.c_str());
+    return;
+    }
+  if (std::rename(temporaryFileName.c_str(), DicomHeaderCacheFileName.c_str()) != 0)
+    {
+    // renaming does not replace an existing file on all platforms
+    itksys::SystemTools::RemoveFile(DicomHeaderCacheFileName.c_str());
+    std::rename(temporaryFileName.c_str(), DicomHeaderCacheFileName.c_str());
+    }
+}
+
+struct DicomHeaderReadInfo
+{
+  const std::vector<std::string>* FileNames;
+  std::vector<int> FileIndices;
+  std::vector<DicomHeader>* Headers;
+};
+
+//----------------------------------------------------------------------------
+void ReadDicomHeader(const std::string& fileName, DicomHeader& header)
+{
+  std::set<gdcm::Tag> selectedTags;
+  for (int t = 0; t < NumberOfDicomHeaderTags; t++)
+    {
+    gdcm::Tag tag;
+    tag.ReadFromPipeSeparatedString(DicomHeaderTags[t]);
+    selectedTags.insert(tag);
+    }
+
+  // Only parse the data elements up to the last needed tag
+  gdcm::Reader reader;
+  reader.SetFileName(fileName.c_str());
+  if (!reader.ReadSelectedTags(selectedTags))
+    {
+    return;
+    }
+  gdcm::StringFilter stringFilter;
+  stringFilter.SetFile(reader.GetFile());
+  for (int t = 0; t < NumberOfDicomHeaderTags; t++)
+    {
+    gdcm::Tag tag;
+    tag.ReadFromPipeSeparatedString(DicomHeaderTags[t]);
+    if (!reader.GetFile().GetDataSet().FindDataElement(tag))
+      {
+      continue;
+      }
+    // Remove extra spaces, because extra spaces were found in some DICOM
+    // file before/after the multi-value separator backslashes.
+    std::string tagValue = stringFilter.ToString(tag);
+    tagValue.erase(std::remove_if(tagValue.begin(), tagValue.end(), isspace), tagValue.end());
+    header.TagValues[t] = tagValue;
+    }
+}
+
+//----------------------------------------------------------------------------
+ITK_THREAD_RETURN_TYPE ReadDicomHeadersThreaderCallback(void* arg)
+{
+  itk::MultiThreader::ThreadInfoStruct* threadInfo =
+    static_cast<itk::MultiThreader::ThreadInfoStruct*>(arg);
+  DicomHeaderReadInfo* readInfo = static_cast<DicomHeaderReadInfo*>(threadInfo->UserData);
+  // Each thread reads every NumberOfThreads-th file
+  for (size_t i = threadInfo->ThreadID; i < readInfo->FileIndices.size(); i += threadInfo->NumberOfThreads)
+    {
+    int f = readInfo->FileIndices[i];
+    ReadDicomHeader((*readInfo->FileNames)[f], (*readInfo->Headers)[f]);
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+/// Get the header of each file, from the cache or by reading the files concurrently.
+/// \return Number of headers that were read from the files
+int ReadDicomHeaders(const std::vector<std::string>& fileNames, std::vector<DicomHeader>& headers)
+{
+  headers.clear();
+  headers.resize(fileNames.size());
+
+  DicomHeaderReadInfo readInfo;
+  readInfo.FileNames = &fileNames;
+  readInfo.Headers = &headers;
+  DicomHeaderCacheLock.Lock();
+  LoadDicomHeaderCache();
+  for (size_t f = 0; f < fileNames.size(); f++)
+    {
+    headers[f].ModifiedTime = itksys::SystemTools::ModifiedTime(fileNames[f].c_str());
+    headers[f].FileSize = itksys::SystemTools::FileLength(fileNames[f].c_str());
+    std::map<std::string, DicomHeaderCacheEntry>::iterator cachedIt = DicomHeaderCache.find(fileNames[f]);
+    if (cachedIt != DicomHeaderCache.end()
+      && cachedIt->second.Header.ModifiedTime == headers[f].ModifiedTime
+      && cachedIt->second.Header.FileSize == headers[f].FileSize)
+      {
+      headers[f] = cachedIt->second.Header;
+      DicomHeaderCacheRecentlyUsed.splice(DicomHeaderCacheRecentlyUsed.end(),
+        DicomHeaderCacheRecentlyUsed, cachedIt->second.RecentlyUsedIt);
+      }
+    else
+      {
+      readInfo.FileIndices.push_back(static_cast<int>(f));
+      }
+    }
+  DicomHeaderCacheLock.Unlock();
+
+  if (readInfo.FileIndices.empty())
+    {
+    return 0;
+    }
+
+  int numberOfThreads = std::min(itk::MultiThreader::GetGlobalDefaultNumberOfThreads(),
+    static_cast<int>(readInfo.FileIndices.size()));
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads(numberOfThreads);
+  threader->SetSingleMethod(ReadDicomHeadersThreaderCallback, &readInfo);
+  threader->SingleMethodExecute();
+
+  DicomHeaderCacheLock.Lock();
+  for (std::vector<int>::iterator it = readInfo.FileIndices.begin(); it != readInfo.FileIndices.end(); ++it)
+    {
+    StoreDicomHeader(fileNames[*it], headers[*it]);
+    }
+  SaveDicomHeaderCache();
+  DicomHeaderCacheLock.Unlock();
+  return static_cast<int>(readInfo.FileIndices.size());
+}
+
+} // end of anonymous namespace
+#endif
+
 //----------------------------------------------------------------------------
 vtkITKArchetypeImageSeriesReader::vtkITKArchetypeImageSeriesReader()
 {
@@ -91,6 +398,7 @@ vtkITKArchetypeImageSeriesReader::vtkITKArchetypeImageSeriesReader()
   this->ImageOrientationPatient.resize( 0 );
 
   this->AnalyzeHeader = true;
+  this->NumberOfDicomHeadersRead = 0;
 
   this->GroupingByTags = false;
   this->IsOnlyFile = false;
@@ -1100,12 +1408,97 @@ std::string vtkITKArchetypeImageSeriesReader::GetMetaDataWithoutSpaces(const itk
   return tagValue;
 }
 
+//----------------------------------------------------------------------------
+void vtkITKArchetypeImageSeriesReader::ClearDicomHeaderCache()
+{
+#ifdef VTKITK_BUILD_DICOM_SUPPORT
+  DicomHeaderCacheLock.Lock();
+  DicomHeaderCache.clear();
+  DicomHeaderCacheRecentlyUsed.clear();
+  if (!DicomHeaderCacheFileName.empty())
+    {
+    itksys::SystemTools::RemoveFile(DicomHeaderCacheFileName.c_str());
+    }
+  DicomHeaderCacheLock.Unlock();
+#endif
+}
+
+//----------------------------------------------------------------------------
+void vtkITKArchetypeImageSeriesReader::SetDicomHeaderCacheFileName(const std::string& fileName)
+{
+#ifdef VTKITK_BUILD_DICOM_SUPPORT
+  DicomHeaderCacheLock.Lock();
+  if (fileName != DicomHeaderCacheFileName)
+    {
+    DicomHeaderCacheFileName = fileName;
+    // headers of the new file are merged into the cache when it is used next time
+    DicomHeaderCacheFileLoaded = false;
+    }
+  DicomHeaderCacheLock.Unlock();
+#else
+  (void)fileName;
+#endif
+}
+
+//----------------------------------------------------------------------------
+std::string vtkITKArchetypeImageSeriesReader::GetDicomHeaderCacheFileName()
+{
+#ifdef VTKITK_BUILD_DICOM_SUPPORT
+  DicomHeaderCacheLock.Lock();
+  std::string fileName = DicomHeaderCacheFileName;
+  DicomHeaderCacheLock.Unlock();
+  return fileName;
+#else
+  return std::string();
+#endif
+}
+
+//----------------------------------------------------------------------------
+void vtkITKArchetypeImageSeriesReader::SetDicomHeaderCacheMaximumNumberOfFiles(unsigned int maximumNumberOfFiles)
+{
+#ifdef VTKITK_BUILD_DICOM_SUPPORT
+  DicomHeaderCacheLock.Lock();
+  DicomHeaderCacheMaximumNumberOfFiles = maximumNumberOfFiles;
+  RemoveObsoleteDicomHeaders();
+  DicomHeaderCacheLock.Unlock();
+#else
+  (void)maximumNumberOfFiles;
+#endif
+}
+
+//----------------------------------------------------------------------------
+unsigned int vtkITKArchetypeImageSeriesReader::GetDicomHeaderCacheMaximumNumberOfFiles()
+{
+#ifdef VTKITK_BUILD_DICOM_SUPPORT
+  DicomHeaderCacheLock.Lock();
+  unsigned int maximumNumberOfFiles = DicomHeaderCacheMaximumNumberOfFiles;
+  DicomHeaderCacheLock.Unlock();
+  return maximumNumberOfFiles;
+#else
+  return 0;
+#endif
+}
+
+//----------------------------------------------------------------------------
+unsigned int vtkITKArchetypeImageSeriesReader::GetDicomHeaderCacheNumberOfFiles()
+{
+#ifdef VTKITK_BUILD_DICOM_SUPPORT
+  DicomHeaderCacheLock.Lock();
+  unsigned int numberOfFiles = static_cast<unsigned int>(DicomHeaderCache.size());
+  DicomHeaderCacheLock.Unlock();
+  return numberOfFiles;
+#else
+  return 0;
+#endif
+}
+
 //----------------------------------------------------------------------------
 void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
 {
 #ifdef VTKITK_BUILD_DICOM_SUPPORT
   itk::TimeProbe AnalyzeTime;
   AnalyzeTime.Start();
+  this->NumberOfDicomHeadersRead = 0;
 
   int nFiles = this->AllFileNames.size();
   typedef itk::Image<float,3> ImageType;
@@ -1207,20 +1600,17 @@ void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
     }
 
   // if Archetype is a Dicom File
-  gdcmIO->SetFileName( this->Archetype );
+  // Only the tags needed for sorting the files are read (without extra spaces),
+  // files are read concurrently and headers of unchanged files are reused.
+  std::vector<DicomHeader> headers;
+  this->NumberOfDicomHeadersRead = ReadDicomHeaders(this->AllFileNames, headers);
   for (int f = 0; f < nFiles; f++)
   {
-    gdcmIO->SetFileName( this->AllFileNames[f] );
-    gdcmIO->ReadImageInformation();
-    itk::MetaDataDictionary &dict = gdcmIO->GetMetaDataDictionary();
+    const DicomHeader& header = headers[f];
     std::string tagValue;
 
-    // Use vtkITKArchetypeImageSeriesReader::GetMetaDataWithoutSpaces to remove extra spaces
-    // from the DICOM tag, because extra spaces were found in some DICOM file before/after the
-    // multi-value separator backslashes.
-
     // series instance UID
-    tagValue = vtkITKArchetypeImageSeriesReader::GetMetaDataWithoutSpaces(dict, "0020|000e");
+    tagValue = header.TagValues[SeriesInstanceUIDTag];
     if (!tagValue.empty())
     {
       int idx = InsertSeriesInstanceUIDs( tagValue.c_str() );
@@ -1232,7 +1622,7 @@ void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
     }
 
     // content time
-    tagValue = vtkITKArchetypeImageSeriesReader::GetMetaDataWithoutSpaces(dict, "0008|0033");
+    tagValue = header.TagValues[ContentTimeTag];
     if (!tagValue.empty())
     {
       int idx = InsertContentTime( tagValue.c_str() );
@@ -1244,7 +1634,7 @@ void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
     }
 
     // trigger time
-    tagValue = vtkITKArchetypeImageSeriesReader::GetMetaDataWithoutSpaces(dict, "0018|1060");
+    tagValue = header.TagValues[TriggerTimeTag];
     if (!tagValue.empty())
     {
       int idx = InsertTriggerTime( tagValue.c_str() );
@@ -1256,7 +1646,7 @@ void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
     }
 
     // echo numbers
-    tagValue = vtkITKArchetypeImageSeriesReader::GetMetaDataWithoutSpaces(dict, "0018|0086");
+    tagValue = header.TagValues[EchoNumbersTag];
     if (!tagValue.empty())
     {
       int idx = InsertEchoNumbers( tagValue.c_str() );
@@ -1268,7 +1658,7 @@ void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
     }
 
     // diffision gradient orientation
-    tagValue = vtkITKArchetypeImageSeriesReader::GetMetaDataWithoutSpaces(dict, "0010|9089");
+    tagValue = header.TagValues[DiffusionGradientOrientationTag];
     if (!tagValue.empty())
     {
       float a[3] = { -1 };
@@ -1282,7 +1672,7 @@ void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
     }
 
     // slice location
-    tagValue = vtkITKArchetypeImageSeriesReader::GetMetaDataWithoutSpaces(dict, "0020|1041");
+    tagValue = header.TagValues[SliceLocationTag];
     if (!tagValue.empty())
     {
       float a = -1;
@@ -1296,7 +1686,7 @@ void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
     }
 
     // image orientation patient
-    tagValue = vtkITKArchetypeImageSeriesReader::GetMetaDataWithoutSpaces(dict, "0020|0037");
+    tagValue = header.TagValues[ImageOrientationPatientTag];
     if (!tagValue.empty())
     {
       float a[6] = { -1 };
@@ -1309,7 +1699,7 @@ void vtkITKArchetypeImageSeriesReader::AnalyzeDicomHeaders()
       this->IndexImageOrientationPatient[f] = -1;
     }
     // image position patient
-    tagValue = vtkITKArchetypeImageSeriesReader::GetMetaDataWithoutSpaces(dict, "0020|0032");
+    tagValue = header.TagValues[ImagePositionPatientTag];
     if (!tagValue.empty())
     {
       float a[3] = { -1 };
@@ -246,6 +246,35 @@ public:
   vtkSetMacro(AnalyzeHeader, bool);
   vtkGetMacro(AnalyzeHeader, bool);
 
+  ///
+  /// DICOM tags that are needed for analyzing the headers are kept in
+  /// memory for each file, and reused as long as the file is not modified.
+  /// Remove all the stored values, including the cache file.
+  static void ClearDicomHeaderCache();
+
+  ///
+  /// File that the DICOM header cache is saved to, so that headers are
+  /// reused across sessions. The file is read when headers are analyzed next
+  /// time and written after new headers are read.
+  /// Empty (default) means the cache is kept in memory only.
+  static void SetDicomHeaderCacheFileName(const std::string& fileName);
+  static std::string GetDicomHeaderCacheFileName();
+
+  ///
+  /// Maximum number of files that the DICOM header cache stores.
+  /// Least recently used headers are removed if the limit is exceeded.
+  static void SetDicomHeaderCacheMaximumNumberOfFiles(unsigned int maximumNumberOfFiles);
+  static unsigned int GetDicomHeaderCacheMaximumNumberOfFiles();
+
+  ///
+  /// Number of files that the DICOM header cache currently stores.
+  static unsigned int GetDicomHeaderCacheNumberOfFiles();
+
+  ///
+  /// Number of DICOM headers that had to be read from file during the last
+  /// header analysis. Headers of the other files were found in the cache.
+  vtkGetMacro(NumberOfDicomHeadersRead, int);
+
   ///
   /// Whether to use orientation from file
   vtkSetMacro(UseOrientationFromFile, int);
@@ -872,6 +901,7 @@ protected:
 
   std::vector<std::string> AllFileNames;
   bool AnalyzeHeader;
+  int NumberOfDicomHeadersRead;
   bool IsOnlyFile;
   bool ArchetypeIsDICOM;
 
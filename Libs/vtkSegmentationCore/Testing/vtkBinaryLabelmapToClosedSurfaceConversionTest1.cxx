@@ -0,0 +1,145 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+
+// SegmentationCore includes
+#include "vtkBinaryLabelmapToClosedSurfaceConversionRule.h"
+#include "vtkOrientedImageData.h"
+
+// STD includes
+#include <cmath>
+
+void FillCube(vtkOrientedImageData* labelmap, int start, int end, unsigned char value);
+bool AreSurfacesEqual(vtkPolyData* surface1, vtkPolyData* surface2);
+
+//----------------------------------------------------------------------------
+int vtkBinaryLabelmapToClosedSurfaceConversionTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkNew<vtkOrientedImageData> labelmap;
+  labelmap->SetExtent(0, 59, 0, 59, 0, 59);
+  labelmap->SetSpacing(0.5, 0.5, 2.0);
+  labelmap->SetOrigin(10.0, -20.0, 30.0);
+  labelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  FillCube(labelmap.GetPointer(), 0, 59, 0);
+  FillCube(labelmap.GetPointer(), 5, 20, 1);
+
+  vtkNew<vtkBinaryLabelmapToClosedSurfaceConversionRule> rule;
+  rule->SetConversionParameter(vtkBinaryLabelmapToClosedSurfaceConversionRule::GetSurfaceBrickSizeParameterName(), "8");
+
+  vtkNew<vtkPolyData> surface;
+  if (!rule->Convert(labelmap.GetPointer(), surface.GetPointer()) || surface->GetNumberOfPolys() == 0)
+    {
+    std::cerr << __LINE__ << ": Failed to convert labelmap to closed surface in bricks!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  vtkNew<vtkPolyData> originalSurface;
+  originalSurface->DeepCopy(surface.GetPointer());
+
+  //////////////////////////////////////////////////////////////////////////
+  // Updating the modified bricks gives the same result as full conversion
+
+  FillCube(labelmap.GetPointer(), 30, 40, 1);
+  int modifiedExtent[6] = { 30, 40, 30, 40, 30, 40 };
+  if (!rule->ConvertModifiedExtent(labelmap.GetPointer(), surface.GetPointer(), modifiedExtent))
+    {
+    std::cerr << __LINE__ << ": Failed to update modified bricks of closed surface!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  vtkNew<vtkPolyData> referenceSurface;
+  rule->Convert(labelmap.GetPointer(), referenceSurface.GetPointer());
+  if (!AreSurfacesEqual(surface.GetPointer(), referenceSurface.GetPointer())
+    || surface->GetNumberOfPolys() <= originalSurface->GetNumberOfPolys())
+    {
+    std::cerr << __LINE__ << ": Updated closed surface differs from fully converted closed surface!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Removing the added region restores the original surface
+  FillCube(labelmap.GetPointer(), 30, 40, 0);
+  rule->ConvertModifiedExtent(labelmap.GetPointer(), surface.GetPointer(), modifiedExtent);
+  if (!AreSurfacesEqual(surface.GetPointer(), originalSurface.GetPointer()))
+    {
+    std::cerr << __LINE__ << ": Failed to remove bricks from closed surface!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // All non-background voxels are part of the surface, whatever their value is
+  FillCube(labelmap.GetPointer(), 30, 40, 2);
+  rule->ConvertModifiedExtent(labelmap.GetPointer(), surface.GetPointer(), modifiedExtent);
+  if (!AreSurfacesEqual(surface.GetPointer(), referenceSurface.GetPointer()))
+    {
+    std::cerr << __LINE__ << ": Voxels with a different value are not included in the closed surface!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  FillCube(labelmap.GetPointer(), 30, 40, 0);
+  rule->ConvertModifiedExtent(labelmap.GetPointer(), surface.GetPointer(), modifiedExtent);
+
+  // Surface generated with different parameters is fully converted
+  rule->SetConversionParameter(vtkBinaryLabelmapToClosedSurfaceConversionRule::GetSurfaceBrickSizeParameterName(), "16");
+  FillCube(labelmap.GetPointer(), 30, 40, 1);
+  rule->ConvertModifiedExtent(labelmap.GetPointer(), surface.GetPointer(), modifiedExtent);
+  rule->Convert(labelmap.GetPointer(), referenceSurface.GetPointer());
+  if (!AreSurfacesEqual(surface.GetPointer(), referenceSurface.GetPointer()))
+    {
+    std::cerr << __LINE__ << ": Closed surface is not regenerated after brick size change!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "Binary labelmap to closed surface conversion test passed." << std::endl;
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void FillCube(vtkOrientedImageData* labelmap, int start, int end, unsigned char value)
+{
+  for (int k = start; k <= end; ++k)
+    {
+    for (int j = start; j <= end; ++j)
+      {
+      for (int i = start; i <= end; ++i)
+        {
+        *static_cast<unsigned char*>(labelmap->GetScalarPointer(i, j, k)) = value;
+        }
+      }
+    }
+  labelmap->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool AreSurfacesEqual(vtkPolyData* surface1, vtkPolyData* surface2)
+{
+  if (surface1->GetNumberOfPolys() != surface2->GetNumberOfPolys())
+    {
+    std::cerr << "Number of polygons mismatch: " << surface1->GetNumberOfPolys() << " != " << surface2->GetNumberOfPolys() << std::endl;
+    return false;
+    }
+  double bounds1[6] = { 0, -1, 0, -1, 0, -1 };
+  double bounds2[6] = { 0, -1, 0, -1, 0, -1 };
+  surface1->GetBounds(bounds1);
+  surface2->GetBounds(bounds2);
+  for (int i = 0; i < 6; ++i)
+    {
+    if (fabs(bounds1[i] - bounds2[i]) > 1e-3)
+      {
+      std::cerr << "Bounds mismatch" << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
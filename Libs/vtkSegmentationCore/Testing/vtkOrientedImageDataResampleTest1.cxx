@@ -0,0 +1,201 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VTK includes
+#include <vtkNew.h>
+
+// SegmentationCore includes
+#include "vtkOrientedImageData.h"
+#include "vtkOrientedImageDataResample.h"
+
+// STD includes
+#include <map>
+#include <vector>
+
+void CreateResampleTestImage(vtkOrientedImageData* image, int extentStart, int extentEnd);
+void FillResampleTestImage(vtkOrientedImageData* image, int start, int end, unsigned char value);
+bool IsExtentEqual(const int* extent, int x0, int x1, int y0, int y1, int z0, int z1);
+
+//----------------------------------------------------------------------------
+int vtkOrientedImageDataResampleTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkNew<vtkOrientedImageData> inputImage;
+  CreateResampleTestImage(inputImage.GetPointer(), 0, 19);
+  FillResampleTestImage(inputImage.GetPointer(), 5, 9, 1);
+
+  //////////////////////////////////////////////////////////////////////////
+  // Effective extent is stored in the image until the image is modified
+
+  int effectiveExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  if (!vtkOrientedImageDataResample::CalculateEffectiveExtent(inputImage.GetPointer(), effectiveExtent)
+    || !IsExtentEqual(effectiveExtent, 5, 9, 5, 9, 5, 9))
+    {
+    std::cerr << __LINE__ << ": Failed to calculate effective extent!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  int cachedExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  if (!inputImage->GetCachedEffectiveExtent(cachedExtent, 0.0) || !IsExtentEqual(cachedExtent, 5, 9, 5, 9, 5, 9))
+    {
+    std::cerr << __LINE__ << ": Effective extent is not stored in the image!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (inputImage->GetCachedEffectiveExtent(cachedExtent, 1.0))
+    {
+    std::cerr << __LINE__ << ": Stored effective extent is returned for a different threshold!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  FillResampleTestImage(inputImage.GetPointer(), 3, 4, 1);
+  if (inputImage->GetCachedEffectiveExtent(cachedExtent, 0.0))
+    {
+    std::cerr << __LINE__ << ": Stored effective extent is not discarded after the image is modified!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!vtkOrientedImageDataResample::CalculateEffectiveExtent(inputImage.GetPointer(), effectiveExtent)
+    || !IsExtentEqual(effectiveExtent, 3, 9, 3, 9, 3, 9))
+    {
+    std::cerr << __LINE__ << ": Failed to recalculate effective extent!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Merging only grows the output to the non-empty region of the appended image
+
+  vtkNew<vtkOrientedImageData> imageToAppend;
+  CreateResampleTestImage(imageToAppend.GetPointer(), 0, 49);
+  FillResampleTestImage(imageToAppend.GetPointer(), 25, 29, 1);
+  vtkNew<vtkOrientedImageData> outputImage;
+  bool outputModified = false;
+  if (!vtkOrientedImageDataResample::MergeImage(inputImage.GetPointer(), imageToAppend.GetPointer(), outputImage.GetPointer(),
+    vtkOrientedImageDataResample::OPERATION_MAXIMUM, NULL, 0, 1, &outputModified) || !outputModified)
+    {
+    std::cerr << __LINE__ << ": Failed to merge images!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!IsExtentEqual(outputImage->GetExtent(), 0, 29, 0, 29, 0, 29)
+    || outputImage->GetScalarComponentAsDouble(27, 27, 27, 0) != 1.0
+    || outputImage->GetScalarComponentAsDouble(7, 7, 7, 0) != 1.0
+    || outputImage->GetScalarComponentAsDouble(15, 15, 15, 0) != 0.0)
+    {
+    std::cerr << __LINE__ << ": Unexpected merged image!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Empty appended image leaves the input unchanged
+  FillResampleTestImage(imageToAppend.GetPointer(), 0, 49, 0);
+  if (!vtkOrientedImageDataResample::MergeImage(inputImage.GetPointer(), imageToAppend.GetPointer(), outputImage.GetPointer(),
+    vtkOrientedImageDataResample::OPERATION_MAXIMUM, NULL, 0, 1, &outputModified) || outputModified
+    || !IsExtentEqual(outputImage->GetExtent(), 0, 19, 0, 19, 0, 19))
+    {
+    std::cerr << __LINE__ << ": Merging empty image changed the input!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Masking only modifies the region of the mask
+
+  vtkNew<vtkOrientedImageData> maskImage;
+  CreateResampleTestImage(maskImage.GetPointer(), 0, 19);
+  vtkMTimeType inputImageMTime = inputImage->GetMTime();
+  if (!vtkOrientedImageDataResample::ModifyImage(inputImage.GetPointer(), maskImage.GetPointer(),
+    vtkOrientedImageDataResample::OPERATION_MASKING, NULL, 0, 0)
+    || inputImage->GetMTime() != inputImageMTime)
+    {
+    std::cerr << __LINE__ << ": Empty mask modified the image!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  vtkNew<vtkOrientedImageData> unallocatedMaskImage;
+  unallocatedMaskImage->SetExtent(0, 19, 0, 19, 0, 19);
+  if (!vtkOrientedImageDataResample::ModifyImage(inputImage.GetPointer(), unallocatedMaskImage.GetPointer(),
+    vtkOrientedImageDataResample::OPERATION_MASKING, NULL, 0, 0)
+    || inputImage->GetMTime() != inputImageMTime)
+    {
+    std::cerr << __LINE__ << ": Mask without scalars modified the image!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  FillResampleTestImage(maskImage.GetPointer(), 8, 12, 1);
+  if (!vtkOrientedImageDataResample::ModifyImage(inputImage.GetPointer(), maskImage.GetPointer(),
+    vtkOrientedImageDataResample::OPERATION_MASKING, NULL, 0, 0)
+    || inputImage->GetScalarComponentAsDouble(8, 8, 8, 0) != 0.0
+    || inputImage->GetScalarComponentAsDouble(7, 7, 7, 0) != 1.0)
+    {
+    std::cerr << __LINE__ << ": Failed to mask image!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!vtkOrientedImageDataResample::CalculateEffectiveExtent(inputImage.GetPointer(), effectiveExtent)
+    || !IsExtentEqual(effectiveExtent, 3, 9, 3, 9, 3, 9))
+    {
+    std::cerr << __LINE__ << ": Effective extent is not updated after masking!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Extents of all labels are found in one pass and can be used for extracting the labels
+
+  vtkNew<vtkOrientedImageData> labelImage;
+  CreateResampleTestImage(labelImage.GetPointer(), 0, 19);
+  FillResampleTestImage(labelImage.GetPointer(), 2, 4, 1);
+  FillResampleTestImage(labelImage.GetPointer(), 10, 15, 3);
+  std::map<int, std::vector<int> > labelExtents;
+  if (!vtkOrientedImageDataResample::CalculateLabelExtents(labelImage.GetPointer(), labelExtents)
+    || labelExtents.size() != 2 || labelExtents.count(1) != 1 || labelExtents.count(3) != 1
+    || !IsExtentEqual(&labelExtents[1][0], 2, 4, 2, 4, 2, 4)
+    || !IsExtentEqual(&labelExtents[3][0], 10, 15, 10, 15, 10, 15))
+    {
+    std::cerr << __LINE__ << ": Failed to calculate label extents!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  vtkNew<vtkOrientedImageData> extractedLabel;
+  if (!vtkOrientedImageDataResample::ExtractLabel(labelImage.GetPointer(), 3, extractedLabel.GetPointer(), &labelExtents[3][0])
+    || !IsExtentEqual(extractedLabel->GetExtent(), 10, 15, 10, 15, 10, 15)
+    || extractedLabel->GetScalarComponentAsDouble(12, 12, 12, 0) != 1.0)
+    {
+    std::cerr << __LINE__ << ": Failed to extract label within its extent!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "Oriented image data resample test passed." << std::endl;
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void CreateResampleTestImage(vtkOrientedImageData* image, int extentStart, int extentEnd)
+{
+  image->SetExtent(extentStart, extentEnd, extentStart, extentEnd, extentStart, extentEnd);
+  image->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  FillResampleTestImage(image, extentStart, extentEnd, 0);
+}
+
+//----------------------------------------------------------------------------
+void FillResampleTestImage(vtkOrientedImageData* image, int start, int end, unsigned char value)
+{
+  for (int k = start; k <= end; ++k)
+    {
+    for (int j = start; j <= end; ++j)
+      {
+      for (int i = start; i <= end; ++i)
+        {
+        *static_cast<unsigned char*>(image->GetScalarPointer(i, j, k)) = value;
+        }
+      }
+    }
+  image->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool IsExtentEqual(const int* extent, int x0, int x1, int y0, int y1, int z0, int z1)
+{
+  return extent[0] == x0 && extent[1] == x1 && extent[2] == y0 && extent[3] == y1 && extent[4] == z0 && extent[5] == z1;
+}
@@ -0,0 +1,200 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+
+// SegmentationCore includes
+#include "vtkSegmentation.h"
+#include "vtkSegment.h"
+#include "vtkSegmentationConverter.h"
+#include "vtkOrientedImageData.h"
+#include "vtkSegmentationConverterFactory.h"
+#include "vtkBinaryLabelmapToClosedSurfaceConversionRule.h"
+#include "vtkClosedSurfaceToBinaryLabelmapConversionRule.h"
+
+// STD includes
+#include <sstream>
+#include <string>
+#include <vector>
+
+void AddConcurrentConversionTestSegment(vtkSegmentation* segmentation, const std::string& segmentId, int start, int end);
+void OnConcurrentConversionProgress(vtkObject* caller, unsigned long eid, void* clientData, void* callData);
+bool CompareConcurrentlyConvertedSurfaces(vtkSegmentation* segmentation1, vtkSegmentation* segmentation2);
+
+//----------------------------------------------------------------------------
+struct ConversionProgress
+{
+  int NumberOfEvents;
+  double LastProgress;
+};
+
+//----------------------------------------------------------------------------
+int vtkSegmentationConcurrentConversionTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkSegmentationConverterFactory::GetInstance()->RegisterConverterRule(
+    vtkSmartPointer<vtkBinaryLabelmapToClosedSurfaceConversionRule>::New() );
+
+  const int numberOfSegments = 12;
+  vtkNew<vtkSegmentation> segmentation;
+  segmentation->SetMasterRepresentationName(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+  for (int segmentIndex = 0; segmentIndex < numberOfSegments; ++segmentIndex)
+    {
+    std::stringstream segmentId;
+    segmentId << "Segment_" << segmentIndex;
+    AddConcurrentConversionTestSegment(segmentation.GetPointer(), segmentId.str(), segmentIndex * 3, segmentIndex * 3 + 2 + segmentIndex % 4);
+    }
+
+  ConversionProgress progress = { 0, 0.0 };
+  vtkNew<vtkCallbackCommand> progressCallback;
+  progressCallback->SetCallback(OnConcurrentConversionProgress);
+  progressCallback->SetClientData(&progress);
+
+  // Reference: segments converted one by one
+  vtkNew<vtkSegmentation> sequentialSegmentation;
+  sequentialSegmentation->DeepCopy(segmentation.GetPointer());
+  sequentialSegmentation->AddObserver(vtkCommand::ProgressEvent, progressCallback.GetPointer());
+  if (!sequentialSegmentation->CreateRepresentation(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName()))
+    {
+    std::cerr << __LINE__ << ": Sequential conversion failed!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (progress.NumberOfEvents != numberOfSegments || progress.LastProgress != 1.0)
+    {
+    std::cerr << __LINE__ << ": Unexpected progress events in sequential conversion: " << progress.NumberOfEvents << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Concurrent conversion gives the same result
+
+  segmentation->SetNumberOfConversionThreads(4);
+  segmentation->AddObserver(vtkCommand::ProgressEvent, progressCallback.GetPointer());
+  progress.NumberOfEvents = 0;
+  progress.LastProgress = 0.0;
+  if (!segmentation->CreateRepresentation(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName()))
+    {
+    std::cerr << __LINE__ << ": Concurrent conversion failed!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (progress.NumberOfEvents < 1 || progress.NumberOfEvents > numberOfSegments || progress.LastProgress != 1.0)
+    {
+    std::cerr << __LINE__ << ": Unexpected progress events in concurrent conversion: " << progress.NumberOfEvents << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!CompareConcurrentlyConvertedSurfaces(segmentation.GetPointer(), sequentialSegmentation.GetPointer()))
+    {
+    return EXIT_FAILURE;
+    }
+
+  // Memory limit smaller than a single conversion still converts all segments
+  segmentation->SetNumberOfConversionThreads(0);
+  segmentation->SetMaximumConversionMemorySize(1);
+  if (!segmentation->CreateRepresentation(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName(), true)
+    || !CompareConcurrentlyConvertedSurfaces(segmentation.GetPointer(), sequentialSegmentation.GetPointer()))
+    {
+    std::cerr << __LINE__ << ": Concurrent conversion with memory limit failed!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Segments in shared labelmaps are extracted before concurrent conversion
+  segmentation->CollapseBinaryLabelmaps();
+  if (segmentation->GetNumberOfLayers() >= numberOfSegments
+    || !segmentation->CreateRepresentation(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName(), true)
+    || !CompareConcurrentlyConvertedSurfaces(segmentation.GetPointer(), sequentialSegmentation.GetPointer()))
+    {
+    std::cerr << __LINE__ << ": Concurrent conversion of shared labelmaps failed!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Surfaces are only converted concurrently to labelmaps with a reference geometry,
+  // otherwise the default geometry of the first segment is stored in the rule
+  vtkNew<vtkClosedSurfaceToBinaryLabelmapConversionRule> surfaceToLabelmapRule;
+  if (surfaceToLabelmapRule->IsThreadSafe())
+    {
+    std::cerr << __LINE__ << ": Conversion without reference geometry is not thread safe!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  vtkNew<vtkOrientedImageData> referenceGeometry;
+  referenceGeometry->SetExtent(0, 49, 0, 49, 0, 49);
+  surfaceToLabelmapRule->SetConversionParameter(vtkSegmentationConverter::GetReferenceImageGeometryParameterName(),
+    vtkSegmentationConverter::SerializeImageGeometry(referenceGeometry.GetPointer()));
+  if (!surfaceToLabelmapRule->IsThreadSafe())
+    {
+    std::cerr << __LINE__ << ": Conversion with reference geometry is thread safe!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "Segmentation concurrent conversion test passed." << std::endl;
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void AddConcurrentConversionTestSegment(vtkSegmentation* segmentation, const std::string& segmentId, int start, int end)
+{
+  vtkNew<vtkOrientedImageData> labelmap;
+  labelmap->SetExtent(0, 49, 0, 49, 0, 49);
+  labelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  for (int k = 0; k < 50; ++k)
+    {
+    for (int j = 0; j < 50; ++j)
+      {
+      for (int i = 0; i < 50; ++i)
+        {
+        bool inside = (i >= start && i <= end && j >= start && j <= end && k >= start && k <= end);
+        *static_cast<unsigned char*>(labelmap->GetScalarPointer(i, j, k)) = (inside ? 1 : 0);
+        }
+      }
+    }
+
+  vtkNew<vtkSegment> segment;
+  segment->SetName(segmentId.c_str());
+  segment->AddRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName(), labelmap.GetPointer());
+  segmentation->AddSegment(segment.GetPointer(), segmentId);
+}
+
+//----------------------------------------------------------------------------
+void OnConcurrentConversionProgress(vtkObject* vtkNotUsed(caller), unsigned long vtkNotUsed(eid), void* clientData, void* callData)
+{
+  ConversionProgress* progress = reinterpret_cast<ConversionProgress*>(clientData);
+  progress->NumberOfEvents++;
+  progress->LastProgress = *reinterpret_cast<double*>(callData);
+}
+
+//----------------------------------------------------------------------------
+bool CompareConcurrentlyConvertedSurfaces(vtkSegmentation* segmentation1, vtkSegmentation* segmentation2)
+{
+  std::vector<std::string> segmentIds;
+  segmentation1->GetSegmentIDs(segmentIds);
+  for (std::vector<std::string>::iterator segmentIdIt = segmentIds.begin(); segmentIdIt != segmentIds.end(); ++segmentIdIt)
+    {
+    vtkPolyData* surface1 = vtkPolyData::SafeDownCast(segmentation1->GetSegmentRepresentation(
+      *segmentIdIt, vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName()));
+    vtkPolyData* surface2 = vtkPolyData::SafeDownCast(segmentation2->GetSegmentRepresentation(
+      *segmentIdIt, vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName()));
+    if (!surface1 || !surface2
+      || surface1->GetNumberOfPoints() == 0
+      || surface1->GetNumberOfPoints() != surface2->GetNumberOfPoints()
+      || surface1->GetNumberOfPolys() != surface2->GetNumberOfPolys())
+      {
+      std::cerr << "Closed surface of segment " << (*segmentIdIt) << " differs from the sequentially converted one!" << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
@@ -0,0 +1,205 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VTK includes
+#include <vtkNew.h>
+
+// SegmentationCore includes
+#include "vtkSegmentation.h"
+#include "vtkSegmentationHistory.h"
+#include "vtkSegment.h"
+#include "vtkSegmentationConverter.h"
+#include "vtkOrientedImageData.h"
+#include "vtkSegmentationConverterFactory.h"
+#include "vtkBinaryLabelmapToClosedSurfaceConversionRule.h"
+
+// STD includes
+#include <cstring>
+
+void PaintHistoryTestCube(vtkSegmentation* segmentation, int start, int end);
+int GetNumberOfHistoryTestVoxels(vtkSegmentation* segmentation);
+
+//----------------------------------------------------------------------------
+int vtkSegmentationHistoryTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkSegmentationConverterFactory::GetInstance()->RegisterConverterRule(
+    vtkSmartPointer<vtkBinaryLabelmapToClosedSurfaceConversionRule>::New() );
+
+  vtkNew<vtkOrientedImageData> labelmap;
+  labelmap->SetExtent(0, 99, 0, 99, 0, 99);
+  labelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  memset(labelmap->GetScalarPointer(), 0, 100 * 100 * 100);
+  vtkNew<vtkSegment> segment;
+  segment->AddRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName(), labelmap.GetPointer());
+  vtkNew<vtkSegmentation> segmentation;
+  segmentation->SetMasterRepresentationName(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+  segmentation->AddSegment(segment.GetPointer(), "Segment");
+  PaintHistoryTestCube(segmentation.GetPointer(), 10, 19);
+  // one byte per voxel
+  vtkTypeUInt64 labelmapMemorySizeInBytes = static_cast<vtkTypeUInt64>(labelmap->GetNumberOfPoints());
+
+  vtkNew<vtkSegmentationHistory> history;
+  history->SetSegmentation(segmentation.GetPointer());
+  history->SetMaximumNumberOfStates(10);
+
+  //////////////////////////////////////////////////////////////////////////
+  // Older states only store the modified region
+
+  // State is saved before each modification
+  history->SaveState();
+  PaintHistoryTestCube(segmentation.GetPointer(), 30, 34);
+  history->SaveState();
+  PaintHistoryTestCube(segmentation.GetPointer(), 50, 54);
+  if (history->GetMemorySizeInBytes() > labelmapMemorySizeInBytes * 3 / 2)
+    {
+    std::cerr << __LINE__ << ": History states use too much memory: " << history->GetMemorySizeInBytes() << " bytes" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Undo and redo restore the full content of the labelmap
+
+  if (!history->RestorePreviousState() || GetNumberOfHistoryTestVoxels(segmentation.GetPointer()) != 1125)
+    {
+    std::cerr << __LINE__ << ": Failed to restore previous state!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!history->RestorePreviousState() || GetNumberOfHistoryTestVoxels(segmentation.GetPointer()) != 1000)
+    {
+    std::cerr << __LINE__ << ": Failed to restore first state!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!history->RestoreNextState() || GetNumberOfHistoryTestVoxels(segmentation.GetPointer()) != 1125
+    || !history->RestoreNextState() || GetNumberOfHistoryTestVoxels(segmentation.GetPointer()) != 1250)
+    {
+    std::cerr << __LINE__ << ": Failed to restore next states!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Saving state after undo removes the next states, but earlier states are still available
+  history->RestorePreviousState();
+  history->SaveState();
+  PaintHistoryTestCube(segmentation.GetPointer(), 70, 74);
+  if (history->IsRestoreNextStateAvailable())
+    {
+    std::cerr << __LINE__ << ": Next states are not removed after modification!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!history->RestorePreviousState() || GetNumberOfHistoryTestVoxels(segmentation.GetPointer()) != 1125)
+    {
+    std::cerr << __LINE__ << ": Failed to undo modification!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  while (history->IsRestorePreviousStateAvailable())
+    {
+    history->RestorePreviousState();
+    }
+  if (GetNumberOfHistoryTestVoxels(segmentation.GetPointer()) != 1000)
+    {
+    std::cerr << __LINE__ << ": Failed to restore first state after removing next states!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Memory limit removes the oldest states
+
+  while (history->IsRestoreNextStateAvailable())
+    {
+    history->RestoreNextState();
+    }
+  history->SetMaximumMemorySizeInBytes(labelmapMemorySizeInBytes / 2);
+  if (history->IsRestorePreviousStateAvailable() || GetNumberOfHistoryTestVoxels(segmentation.GetPointer()) != 1250)
+    {
+    std::cerr << __LINE__ << ": Old states are not removed when memory limit is exceeded!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Differences are applied across states of different extent
+
+  history->SetMaximumMemorySizeInBytes(0);
+  history->SaveState();
+  vtkOrientedImageData* resizedLabelmap = vtkOrientedImageData::SafeDownCast(segmentation->GetSegmentRepresentation(
+    "Segment", vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
+  resizedLabelmap->SetExtent(0, 119, 0, 119, 0, 119);
+  resizedLabelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  memset(resizedLabelmap->GetScalarPointer(), 0, 120 * 120 * 120);
+  PaintHistoryTestCube(segmentation.GetPointer(), 100, 109);
+  history->SaveState();
+  PaintHistoryTestCube(segmentation.GetPointer(), 10, 14);
+  if (!history->RestorePreviousState() || GetNumberOfHistoryTestVoxels(segmentation.GetPointer()) != 1000)
+    {
+    std::cerr << __LINE__ << ": Failed to restore resized state!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!history->RestorePreviousState() || GetNumberOfHistoryTestVoxels(segmentation.GetPointer()) != 1250)
+    {
+    std::cerr << __LINE__ << ": Failed to restore state before resize!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  vtkOrientedImageData* restoredLabelmap = vtkOrientedImageData::SafeDownCast(segmentation->GetSegmentRepresentation(
+    "Segment", vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
+  int* restoredExtent = restoredLabelmap->GetExtent();
+  if (restoredExtent[1] != 99 || restoredExtent[3] != 99 || restoredExtent[5] != 99)
+    {
+    std::cerr << __LINE__ << ": Extent of state before resize is not restored!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "Segmentation history test passed." << std::endl;
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PaintHistoryTestCube(vtkSegmentation* segmentation, int start, int end)
+{
+  vtkOrientedImageData* labelmap = vtkOrientedImageData::SafeDownCast(segmentation->GetSegmentRepresentation(
+    "Segment", vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
+  for (int k = start; k <= end; ++k)
+    {
+    for (int j = start; j <= end; ++j)
+      {
+      for (int i = start; i <= end; ++i)
+        {
+        *static_cast<unsigned char*>(labelmap->GetScalarPointer(i, j, k)) = 1;
+        }
+      }
+    }
+  labelmap->Modified();
+}
+
+//----------------------------------------------------------------------------
+int GetNumberOfHistoryTestVoxels(vtkSegmentation* segmentation)
+{
+  vtkOrientedImageData* labelmap = vtkOrientedImageData::SafeDownCast(segmentation->GetSegmentRepresentation(
+    "Segment", vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
+  int* extent = labelmap->GetExtent();
+  int numberOfVoxels = 0;
+  for (int k = extent[4]; k <= extent[5]; ++k)
+    {
+    for (int j = extent[2]; j <= extent[3]; ++j)
+      {
+      for (int i = extent[0]; i <= extent[1]; ++i)
+        {
+        if (labelmap->GetScalarComponentAsDouble(i, j, k, 0) > 0)
+          {
+          ++numberOfVoxels;
+          }
+        }
+      }
+    }
+  return numberOfVoxels;
+}
@@ -0,0 +1,218 @@
+/*==============================================================================
+
+  Copyright (c) Laboratory for Percutaneous Surgery (PerkLab)
+  Queen's University, Kingston, ON, Canada. All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+
+// SegmentationCore includes
+#include "vtkSegmentation.h"
+#include "vtkSegment.h"
+#include "vtkSegmentationConverter.h"
+#include "vtkOrientedImageData.h"
+#include "vtkSegmentationConverterFactory.h"
+#include "vtkBinaryLabelmapToClosedSurfaceConversionRule.h"
+
+// STD includes
+#include <string>
+#include <vector>
+
+void AddCubeSegment(vtkSegmentation* segmentation, const std::string& segmentId, int start, int end);
+int GetNumberOfSegmentVoxels(vtkSegmentation* segmentation, const std::string& segmentId);
+
+//----------------------------------------------------------------------------
+int vtkSegmentationSharedLabelmapTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkSegmentationConverterFactory::GetInstance()->RegisterConverterRule(
+    vtkSmartPointer<vtkBinaryLabelmapToClosedSurfaceConversionRule>::New() );
+
+  // Cube A and B do not overlap, C overlaps with A in 5x5x5 voxels
+  vtkNew<vtkSegmentation> segmentation;
+  segmentation->SetMasterRepresentationName(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+  AddCubeSegment(segmentation.GetPointer(), "A", 0, 9);
+  AddCubeSegment(segmentation.GetPointer(), "B", 20, 29);
+  AddCubeSegment(segmentation.GetPointer(), "C", 5, 14);
+  if (segmentation->GetNumberOfLayers() != 3 || segmentation->IsSharedBinaryLabelmap("A"))
+    {
+    std::cerr << __LINE__ << ": Segments are expected to have their own labelmap!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Non-overlapping segments are packed in the same layer
+
+  if (!segmentation->CollapseBinaryLabelmaps())
+    {
+    std::cerr << __LINE__ << ": Failed to collapse binary labelmaps!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (segmentation->GetNumberOfLayers() != 2
+    || segmentation->GetLayerIndex("A") != 0 || segmentation->GetLayerIndex("B") != 0 || segmentation->GetLayerIndex("C") != 1)
+    {
+    std::cerr << __LINE__ << ": Unexpected layers after collapsing binary labelmaps: " << segmentation->GetNumberOfLayers() << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::vector<std::string> layerSegmentIds;
+  segmentation->GetSegmentIDsForLayer(0, layerSegmentIds);
+  if (layerSegmentIds.size() != 2 || !segmentation->IsSharedBinaryLabelmap("A") || segmentation->IsSharedBinaryLabelmap("C")
+    || segmentation->GetSegment("A")->GetLabelValue() == segmentation->GetSegment("B")->GetLabelValue())
+    {
+    std::cerr << __LINE__ << ": Segments A and B are expected to share a labelmap with different label values!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (GetNumberOfSegmentVoxels(segmentation.GetPointer(), "A") != 1000
+    || GetNumberOfSegmentVoxels(segmentation.GetPointer(), "B") != 1000
+    || GetNumberOfSegmentVoxels(segmentation.GetPointer(), "C") != 1000)
+    {
+    std::cerr << __LINE__ << ": Segment content changed by collapsing binary labelmaps!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Conversion only uses the voxels of each segment
+  if (!segmentation->CreateRepresentation(vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName()))
+    {
+    std::cerr << __LINE__ << ": Failed to convert shared labelmap to closed surface!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  double boundsA[6] = { 0, -1, 0, -1, 0, -1 };
+  vtkPolyData::SafeDownCast(segmentation->GetSegmentRepresentation("A",
+    vtkSegmentationConverter::GetSegmentationClosedSurfaceRepresentationName()))->GetBounds(boundsA);
+  if (boundsA[1] > 15.0)
+    {
+    std::cerr << __LINE__ << ": Closed surface of segment A contains segment B!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Deep copy keeps the labelmap shared
+  vtkNew<vtkSegmentation> segmentationCopy;
+  segmentationCopy->DeepCopy(segmentation.GetPointer());
+  if (segmentationCopy->GetNumberOfLayers() != 2 || segmentationCopy->GetLayerDataObject(0) == segmentation->GetLayerDataObject(0))
+    {
+    std::cerr << __LINE__ << ": Deep copy of shared labelmaps failed!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Copied segment only contains its own voxels
+  vtkNew<vtkSegmentation> singleSegmentSegmentation;
+  singleSegmentSegmentation->SetMasterRepresentationName(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+  singleSegmentSegmentation->CopySegmentFromSegmentation(segmentation.GetPointer(), "B");
+  if (singleSegmentSegmentation->GetSegment("B")->GetLabelValue() != 1
+    || GetNumberOfSegmentVoxels(singleSegmentSegmentation.GetPointer(), "B") != 1000)
+    {
+    std::cerr << __LINE__ << ": Failed to copy segment from shared labelmap!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Label value is read from XML attributes
+  const char* segmentAttributes[] = { "LabelValue", "3", NULL };
+  vtkNew<vtkSegment> readSegment;
+  readSegment->ReadXMLAttributes(segmentAttributes);
+  if (readSegment->GetLabelValue() != 3)
+    {
+    std::cerr << __LINE__ << ": Failed to read label value of segment!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // All segments in one layer, later segments overwrite earlier ones
+
+  if (!segmentation->CollapseBinaryLabelmaps(true) || segmentation->GetNumberOfLayers() != 1)
+    {
+    std::cerr << __LINE__ << ": Failed to collapse binary labelmaps into a single layer!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (GetNumberOfSegmentVoxels(segmentation.GetPointer(), "A") != 875
+    || GetNumberOfSegmentVoxels(segmentation.GetPointer(), "C") != 1000)
+    {
+    std::cerr << __LINE__ << ": Unexpected segment content in single layer!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Separate and remove segments
+
+  if (!segmentation->SeparateSegmentLabelmap("B")
+    || segmentation->GetNumberOfLayers() != 2
+    || segmentation->IsSharedBinaryLabelmap("B")
+    || segmentation->GetSegment("B")->GetLabelValue() != 1
+    || GetNumberOfSegmentVoxels(segmentation.GetPointer(), "B") != 1000)
+    {
+    std::cerr << __LINE__ << ": Failed to separate segment from shared labelmap!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkSmartPointer<vtkSegment> segmentA = segmentation->GetSegment("A");
+  segmentation->RemoveSegment("A");
+  if (segmentA->GetLabelValue() != 1 || segmentation->IsSharedBinaryLabelmap("C")
+    || GetNumberOfSegmentVoxels(segmentation.GetPointer(), "C") != 1000)
+    {
+    std::cerr << __LINE__ << ": Failed to remove segment from shared labelmap!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "Segmentation shared labelmap test passed." << std::endl;
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void AddCubeSegment(vtkSegmentation* segmentation, const std::string& segmentId, int start, int end)
+{
+  vtkNew<vtkOrientedImageData> labelmap;
+  labelmap->SetExtent(0, 39, 0, 39, 0, 39);
+  labelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  for (int k = 0; k < 40; ++k)
+    {
+    for (int j = 0; j < 40; ++j)
+      {
+      for (int i = 0; i < 40; ++i)
+        {
+        bool inside = (i >= start && i <= end && j >= start && j <= end && k >= start && k <= end);
+        *static_cast<unsigned char*>(labelmap->GetScalarPointer(i, j, k)) = (inside ? 1 : 0);
+        }
+      }
+    }
+
+  vtkNew<vtkSegment> segment;
+  segment->SetName(segmentId.c_str());
+  segment->AddRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName(), labelmap.GetPointer());
+  segmentation->AddSegment(segment.GetPointer(), segmentId);
+}
+
+//----------------------------------------------------------------------------
+int GetNumberOfSegmentVoxels(vtkSegmentation* segmentation, const std::string& segmentId)
+{
+  vtkNew<vtkOrientedImageData> binaryLabelmap;
+  if (!segmentation->GetSegmentBinaryLabelmap(segmentId, binaryLabelmap.GetPointer()) || binaryLabelmap->IsEmpty())
+    {
+    return 0;
+    }
+  int* extent = binaryLabelmap->GetExtent();
+  int numberOfVoxels = 0;
+  for (int k = extent[4]; k <= extent[5]; ++k)
+    {
+    for (int j = extent[2]; j <= extent[3]; ++j)
+      {
+      for (int i = extent[0]; i <= extent[1]; ++i)
+        {
+        if (binaryLabelmap->GetScalarComponentAsDouble(i, j, k, 0) > 0)
+          {
+          ++numberOfVoxels;
+          }
+        }
+      }
+    }
+  return numberOfVoxels;
+}
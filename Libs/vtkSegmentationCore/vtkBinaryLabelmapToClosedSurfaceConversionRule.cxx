@@ -24,20 +24,102 @@
 #include "vtkOrientedImageData.h"
 
 // VTK includes
+#include <vtkAppendPolyData.h>
+#include <vtkCellData.h>
 #include <vtkDecimatePro.h>
 #include <vtkDiscreteMarchingCubes.h>
+#include <vtkFieldData.h>
+#include <vtkIdList.h>
 #include <vtkImageChangeInformation.h>
 #include <vtkImageConstantPad.h>
 #include <vtkImageThreshold.h>
+#include <vtkIntArray.h>
+#include <vtkMatrix4x4.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
 #include <vtkPolyData.h>
 #include <vtkPolyDataNormals.h>
+#include <vtkStringArray.h>
 #include <vtkTransform.h>
 #include <vtkTransformPolyDataFilter.h>
 #include <vtkVersion.h>
 #include <vtkWindowedSincPolyDataFilter.h>
 
+// STD includes
+#include <algorithm>
+#include <sstream>
+
+static const char* BRICK_INDEX_ARRAY_NAME = "BrickIndex";
+static const char* BRICK_SURFACE_SIGNATURE_ARRAY_NAME = "BrickSurfaceSignature";
+
+//----------------------------------------------------------------------------
+/// Integer division rounding towards negative infinity (extents may be negative)
+static int FloorDivide(int dividend, int divisor)
+{
+  return (dividend >= 0 ? dividend / divisor : -((divisor - 1 - dividend) / divisor));
+}
+
+//----------------------------------------------------------------------------
+/// Get range of bricks that contain marching cubes cells touching the voxels in the extent.
+/// Brick b contains cells between voxels [b*brickSize, (b+1)*brickSize].
+static void GetBrickRangeForExtent(const int extent[6], int brickSize, int brickRange[6])
+{
+  for (int axis = 0; axis < 3; ++axis)
+    {
+    brickRange[axis * 2] = FloorDivide(extent[axis * 2] - 1, brickSize);
+    brickRange[axis * 2 + 1] = FloorDivide(extent[axis * 2 + 1], brickSize);
+    }
+}
+
+//----------------------------------------------------------------------------
+template<class ImageScalarType>
+void IsExtentEmptyGeneric(vtkImageData* image, const int extent[6], bool &empty)
+{
+  empty = true;
+  for (int k = extent[4]; k <= extent[5]; ++k)
+    {
+    for (int j = extent[2]; j <= extent[3]; ++j)
+      {
+      ImageScalarType* imagePtr = static_cast<ImageScalarType*>(image->GetScalarPointer(extent[0], j, k));
+      for (int i = extent[0]; i <= extent[1]; ++i, ++imagePtr)
+        {
+        if (*imagePtr != 0)
+          {
+          empty = false;
+          return;
+          }
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+/// Determine if all voxels of the image are zero within the extent (intersected with the image extent)
+static bool IsExtentEmpty(vtkImageData* image, const int extent[6])
+{
+  int* imageExtent = image->GetExtent();
+  int intersectionExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  for (int axis = 0; axis < 3; ++axis)
+    {
+    intersectionExtent[axis * 2] = std::max(extent[axis * 2], imageExtent[axis * 2]);
+    intersectionExtent[axis * 2 + 1] = std::min(extent[axis * 2 + 1], imageExtent[axis * 2 + 1]);
+    if (intersectionExtent[axis * 2] > intersectionExtent[axis * 2 + 1])
+      {
+      return true;
+      }
+    }
+  bool empty = true;
+  switch (image->GetScalarType())
+    {
+    vtkTemplateMacro(IsExtentEmptyGeneric<VTK_TT>(image, intersectionExtent, empty));
+    default:
+      vtkGenericWarningMacro("IsExtentEmpty: Unknown image scalar type!");
+    }
+  return empty;
+}
+
 //----------------------------------------------------------------------------
 vtkSegmentationConverterRuleNewMacro(vtkBinaryLabelmapToClosedSurfaceConversionRule);
 
@@ -52,6 +134,10 @@ vtkBinaryLabelmapToClosedSurfaceConversionRule::vtkBinaryLabelmapToClosedSurface
   this->ConversionParameters[GetComputeSurfaceNormalsParameterName()] = std::make_pair("1",
     "Compute surface normals. 1 (default) = surface normals are computed. "
     "0 = surface normals are not computed (slightly faster but produces less smooth surface display).");
+  this->ConversionParameters[GetSurfaceBrickSizeParameterName()] = std::make_pair("0",
+    "Size of surface bricks in voxels. 0 (default) = surface is generated from the whole labelmap at once. "
+    "Values > 0 (e.g., 32) = surface is generated in bricks and only the modified bricks are updated after editing "
+    "(faster update of large segments, but vertices at brick boundaries are not smoothed).");
 }
 
 //----------------------------------------------------------------------------
@@ -137,6 +223,17 @@ bool vtkBinaryLabelmapToClosedSurfaceConversionRule::Convert(vtkDataObject* sour
     return true;
     }
 
+  int surfaceBrickSize = vtkVariant(this->ConversionParameters[GetSurfaceBrickSizeParameterName()].first).ToInt();
+  if (surfaceBrickSize > 0)
+    {
+    int brickRange[6] = { 0, -1, 0, -1, 0, -1 };
+    GetBrickRangeForExtent(binaryLabelMapExtent, surfaceBrickSize, brickRange);
+    vtkNew<vtkAppendPolyData> appendFilter;
+    this->AppendBrickSurfaces(orientedBinaryLabelMap, brickRange, appendFilter.GetPointer());
+    this->SetBrickSurface(appendFilter.GetPointer(), orientedBinaryLabelMap, closedSurfacePolyData);
+    return true;
+    }
+
   /// If input labelmap has non-background border voxels, then those regions remain open in the output closed surface.
   /// This function adds a 1 voxel padding to the labelmap in these cases.
   bool paddingNecessary = this->IsLabelmapPaddingNecessary(binaryLabelMap);
@@ -240,6 +337,251 @@ bool vtkBinaryLabelmapToClosedSurfaceConversionRule::Convert(vtkDataObject* sour
   return true;
 }
 
+//----------------------------------------------------------------------------
+bool vtkBinaryLabelmapToClosedSurfaceConversionRule::ConvertModifiedExtent(
+  vtkDataObject* sourceRepresentation, vtkDataObject* targetRepresentation, const int modifiedExtent[6])
+{
+  vtkOrientedImageData* orientedBinaryLabelMap = vtkOrientedImageData::SafeDownCast(sourceRepresentation);
+  vtkPolyData* closedSurfacePolyData = vtkPolyData::SafeDownCast(targetRepresentation);
+  int surfaceBrickSize = vtkVariant(this->ConversionParameters[GetSurfaceBrickSizeParameterName()].first).ToInt();
+  if (!orientedBinaryLabelMap || !closedSurfacePolyData || !modifiedExtent || surfaceBrickSize <= 0)
+    {
+    return this->Convert(sourceRepresentation, targetRepresentation);
+    }
+
+  // Bricks can only be replaced if the existing surface was generated in bricks with the same settings
+  vtkIntArray* brickIndexArray = vtkIntArray::SafeDownCast(closedSurfacePolyData->GetCellData()->GetArray(BRICK_INDEX_ARRAY_NAME));
+  vtkStringArray* signatureArray = vtkStringArray::SafeDownCast(
+    closedSurfacePolyData->GetFieldData()->GetAbstractArray(BRICK_SURFACE_SIGNATURE_ARRAY_NAME));
+  if (!brickIndexArray || !signatureArray || signatureArray->GetNumberOfValues() < 1
+    || signatureArray->GetValue(0) != this->GetBrickSurfaceSignature(orientedBinaryLabelMap))
+    {
+    return this->Convert(sourceRepresentation, targetRepresentation);
+    }
+
+  int modifiedBrickRange[6] = { 0, -1, 0, -1, 0, -1 };
+  GetBrickRangeForExtent(modifiedExtent, surfaceBrickSize, modifiedBrickRange);
+
+  // Keep cells of bricks that are not modified
+  vtkNew<vtkIdList> keptCellIds;
+  vtkIdType numberOfCells = closedSurfacePolyData->GetNumberOfCells();
+  for (vtkIdType cellId = 0; cellId < numberOfCells; ++cellId)
+    {
+    bool modified = true;
+    for (int axis = 0; axis < 3; ++axis)
+      {
+      int brickIndex = static_cast<int>(brickIndexArray->GetComponent(cellId, axis));
+      if (brickIndex < modifiedBrickRange[axis * 2] || brickIndex > modifiedBrickRange[axis * 2 + 1])
+        {
+        modified = false;
+        break;
+        }
+      }
+    if (!modified)
+      {
+      keptCellIds->InsertNextId(cellId);
+      }
+    }
+  vtkNew<vtkAppendPolyData> appendFilter;
+  if (keptCellIds->GetNumberOfIds() > 0)
+    {
+    vtkNew<vtkPolyData> keptSurface;
+    vtkNew<vtkPoints> keptPoints;
+    keptSurface->SetPoints(keptPoints.GetPointer());
+    keptSurface->Allocate(closedSurfacePolyData, keptCellIds->GetNumberOfIds());
+    keptSurface->GetPointData()->CopyAllocate(closedSurfacePolyData->GetPointData());
+    keptSurface->GetCellData()->CopyAllocate(closedSurfacePolyData->GetCellData());
+    keptSurface->CopyCells(closedSurfacePolyData, keptCellIds.GetPointer());
+    appendFilter->AddInputData(keptSurface.GetPointer());
+    }
+
+  // Regenerate modified bricks that are within the labelmap
+  int* binaryLabelMapExtent = orientedBinaryLabelMap->GetExtent();
+  if (binaryLabelMapExtent[0] <= binaryLabelMapExtent[1]
+    && binaryLabelMapExtent[2] <= binaryLabelMapExtent[3]
+    && binaryLabelMapExtent[4] <= binaryLabelMapExtent[5])
+    {
+    int labelmapBrickRange[6] = { 0, -1, 0, -1, 0, -1 };
+    GetBrickRangeForExtent(binaryLabelMapExtent, surfaceBrickSize, labelmapBrickRange);
+    for (int axis = 0; axis < 3; ++axis)
+      {
+      modifiedBrickRange[axis * 2] = std::max(modifiedBrickRange[axis * 2], labelmapBrickRange[axis * 2]);
+      modifiedBrickRange[axis * 2 + 1] = std::min(modifiedBrickRange[axis * 2 + 1], labelmapBrickRange[axis * 2 + 1]);
+      }
+    this->AppendBrickSurfaces(orientedBinaryLabelMap, modifiedBrickRange, appendFilter.GetPointer());
+    }
+
+  this->SetBrickSurface(appendFilter.GetPointer(), orientedBinaryLabelMap, closedSurfacePolyData);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkBinaryLabelmapToClosedSurfaceConversionRule::AppendBrickSurfaces(
+  vtkOrientedImageData* binaryLabelMap, const int brickRange[6], vtkAppendPolyData* appendFilter)
+{
+  int surfaceBrickSize = vtkVariant(this->ConversionParameters[GetSurfaceBrickSizeParameterName()].first).ToInt();
+  double decimationFactor = vtkVariant(this->ConversionParameters[GetDecimationFactorParameterName()].first).ToDouble();
+  double smoothingFactor = vtkVariant(this->ConversionParameters[GetSmoothingFactorParameterName()].first).ToDouble();
+  int computeSurfaceNormals = vtkVariant(this->ConversionParameters[GetComputeSurfaceNormalsParameterName()].first).ToInt();
+
+  // Bricks are processed in IJK space and then transformed to the world coordinate system (see Convert)
+  vtkSmartPointer<vtkImageData> binaryLabelmapWithIdentityGeometry = vtkSmartPointer<vtkImageData>::New();
+  binaryLabelmapWithIdentityGeometry->ShallowCopy(binaryLabelMap);
+  binaryLabelmapWithIdentityGeometry->SetOrigin(0, 0, 0);
+  binaryLabelmapWithIdentityGeometry->SetSpacing(1.0, 1.0, 1.0);
+
+  vtkSmartPointer<vtkTransform> labelmapGeometryTransform = vtkSmartPointer<vtkTransform>::New();
+  vtkSmartPointer<vtkMatrix4x4> labelmapImageToWorldMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  binaryLabelMap->GetImageToWorldMatrix(labelmapImageToWorldMatrix);
+  labelmapGeometryTransform->SetMatrix(labelmapImageToWorldMatrix);
+
+  for (int brickK = brickRange[4]; brickK <= brickRange[5]; ++brickK)
+    {
+    for (int brickJ = brickRange[2]; brickJ <= brickRange[3]; ++brickJ)
+      {
+      for (int brickI = brickRange[0]; brickI <= brickRange[1]; ++brickI)
+        {
+        // Neighbor bricks share the voxels at their boundary, so that their surfaces are connected
+        int brickExtent[6] =
+          {
+          brickI * surfaceBrickSize, (brickI + 1) * surfaceBrickSize,
+          brickJ * surfaceBrickSize, (brickJ + 1) * surfaceBrickSize,
+          brickK * surfaceBrickSize, (brickK + 1) * surfaceBrickSize
+          };
+        if (IsExtentEmpty(binaryLabelmapWithIdentityGeometry, brickExtent))
+          {
+          continue;
+          }
+
+        // Crop the labelmap to the brick (voxels outside the labelmap are background)
+        vtkSmartPointer<vtkImageConstantPad> padder = vtkSmartPointer<vtkImageConstantPad>::New();
+        padder->SetInputData(binaryLabelmapWithIdentityGeometry);
+        padder->SetOutputWholeExtent(brickExtent);
+        padder->SetConstant(0);
+
+        // All voxels of the segment are set to the fill value. The maximum of the scalar range would
+        // differ between full and partial updates and would leave out voxels of other non-zero values.
+        vtkSmartPointer<vtkImageThreshold> threshold = vtkSmartPointer<vtkImageThreshold>::New();
+        threshold->SetInputConnection(padder->GetOutputPort());
+        threshold->ThresholdByLower(0);
+        threshold->SetInValue(0);
+        threshold->SetOutValue(1);
+        threshold->ReplaceInOn();
+        threshold->ReplaceOutOn();
+        threshold->SetOutputScalarTypeToUnsignedChar();
+
+        vtkSmartPointer<vtkDiscreteMarchingCubes> marchingCubes = vtkSmartPointer<vtkDiscreteMarchingCubes>::New();
+        marchingCubes->SetInputConnection(threshold->GetOutputPort());
+        marchingCubes->GenerateValues(1, 1, 1);
+        marchingCubes->ComputeGradientsOff();
+        marchingCubes->ComputeNormalsOff();
+        marchingCubes->ComputeScalarsOff();
+        marchingCubes->Update();
+        vtkSmartPointer<vtkPolyData> processingResult = marchingCubes->GetOutput();
+        if (processingResult->GetNumberOfPolys() == 0)
+          {
+          continue;
+          }
+
+        // Vertices at the brick boundary are kept in place by decimation and smoothing,
+        // so that they remain connected to the neighbor bricks
+        if (decimationFactor > 0.0)
+          {
+          vtkSmartPointer<vtkDecimatePro> decimator = vtkSmartPointer<vtkDecimatePro>::New();
+          decimator->SetInputData(processingResult);
+          decimator->SetFeatureAngle(60);
+          decimator->SplittingOff();
+          decimator->PreserveTopologyOn();
+          decimator->BoundaryVertexDeletionOff();
+          decimator->SetMaximumError(1);
+          decimator->SetTargetReduction(decimationFactor);
+          decimator->Update();
+          processingResult = decimator->GetOutput();
+          }
+        if (smoothingFactor > 0)
+          {
+          vtkSmartPointer<vtkWindowedSincPolyDataFilter> smoother = vtkSmartPointer<vtkWindowedSincPolyDataFilter>::New();
+          smoother->SetInputData(processingResult);
+          smoother->SetNumberOfIterations(20);
+          smoother->SetPassBand(pow(10.0, -4.0*smoothingFactor));
+          smoother->BoundarySmoothingOff();
+          smoother->FeatureEdgeSmoothingOff();
+          smoother->NonManifoldSmoothingOn();
+          smoother->NormalizeCoordinatesOn();
+          smoother->Update();
+          processingResult = smoother->GetOutput();
+          }
+
+        vtkSmartPointer<vtkTransformPolyDataFilter> transformPolyDataFilter = vtkSmartPointer<vtkTransformPolyDataFilter>::New();
+        transformPolyDataFilter->SetInputData(processingResult);
+        transformPolyDataFilter->SetTransform(labelmapGeometryTransform);
+        transformPolyDataFilter->Update();
+        processingResult = transformPolyDataFilter->GetOutput();
+        if (computeSurfaceNormals > 0)
+          {
+          vtkSmartPointer<vtkPolyDataNormals> polyDataNormals = vtkSmartPointer<vtkPolyDataNormals>::New();
+          polyDataNormals->SetInputData(processingResult);
+          polyDataNormals->ConsistencyOn();
+          polyDataNormals->SplittingOff();
+          polyDataNormals->Update();
+          processingResult = polyDataNormals->GetOutput();
+          }
+
+        // Store brick index of each cell so that the brick can be replaced later
+        vtkSmartPointer<vtkIntArray> brickIndexArray = vtkSmartPointer<vtkIntArray>::New();
+        brickIndexArray->SetName(BRICK_INDEX_ARRAY_NAME);
+        brickIndexArray->SetNumberOfComponents(3);
+        brickIndexArray->SetNumberOfTuples(processingResult->GetNumberOfCells());
+        brickIndexArray->FillComponent(0, brickI);
+        brickIndexArray->FillComponent(1, brickJ);
+        brickIndexArray->FillComponent(2, brickK);
+        processingResult->GetCellData()->AddArray(brickIndexArray);
+        appendFilter->AddInputData(processingResult);
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+std::string vtkBinaryLabelmapToClosedSurfaceConversionRule::GetBrickSurfaceSignature(vtkOrientedImageData* binaryLabelMap)
+{
+  std::stringstream signature;
+  signature << this->ConversionParameters[GetSurfaceBrickSizeParameterName()].first << ";"
+    << this->ConversionParameters[GetDecimationFactorParameterName()].first << ";"
+    << this->ConversionParameters[GetSmoothingFactorParameterName()].first << ";"
+    << this->ConversionParameters[GetComputeSurfaceNormalsParameterName()].first;
+  vtkSmartPointer<vtkMatrix4x4> labelmapImageToWorldMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  binaryLabelMap->GetImageToWorldMatrix(labelmapImageToWorldMatrix);
+  for (int row = 0; row < 3; ++row)
+    {
+    for (int column = 0; column < 4; ++column)
+      {
+      signature << ";" << labelmapImageToWorldMatrix->GetElement(row, column);
+      }
+    }
+  return signature.str();
+}
+
+//----------------------------------------------------------------------------
+void vtkBinaryLabelmapToClosedSurfaceConversionRule::SetBrickSurface(
+  vtkAppendPolyData* appendFilter, vtkOrientedImageData* binaryLabelMap, vtkPolyData* closedSurfacePolyData)
+{
+  if (appendFilter->GetNumberOfInputConnections(0) > 0)
+    {
+    appendFilter->Update();
+    closedSurfacePolyData->ShallowCopy(appendFilter->GetOutput());
+    }
+  else
+    {
+    closedSurfacePolyData->Reset();
+    }
+
+  vtkSmartPointer<vtkStringArray> signatureArray = vtkSmartPointer<vtkStringArray>::New();
+  signatureArray->SetName(BRICK_SURFACE_SIGNATURE_ARRAY_NAME);
+  signatureArray->InsertNextValue(this->GetBrickSurfaceSignature(binaryLabelMap));
+  closedSurfacePolyData->GetFieldData()->AddArray(signatureArray);
+}
+
 //----------------------------------------------------------------------------
 template<class ImageScalarType>
 void IsLabelmapPaddingNecessaryGeneric(vtkImageData* binaryLabelMap, bool &paddingNecessary)
@@ -27,11 +27,19 @@
 
 #include "vtkSegmentationCoreConfigure.h"
 
+class vtkAppendPolyData;
+class vtkImageData;
+class vtkOrientedImageData;
+class vtkPolyData;
+
 /// \ingroup SegmentationCore
 /// \brief Convert binary labelmap representation (vtkOrientedImageData type) to
 ///   closed surface representation (vtkPolyData type). The conversion algorithm
 ///   performs a marching cubes operation on the image data followed by an optional
 ///   decimation step.
+///   If surface brick size is set then the surface is generated in bricks (blocks of voxels) and
+///   after editing only the bricks that overlap with the modified extent are regenerated
+///   (\sa ConvertModifiedExtent). Smoothing does not move vertices at brick boundaries.
 class vtkSegmentationCore_EXPORT vtkBinaryLabelmapToClosedSurfaceConversionRule
   : public vtkSegmentationConverterRule
 {
@@ -42,6 +50,8 @@ public:
   static const std::string GetSmoothingFactorParameterName() { return "Smoothing factor"; };
   /// Conversion parameter: compute surface normals
   static const std::string GetComputeSurfaceNormalsParameterName() { return "Compute surface normals"; };
+  /// Conversion parameter: surface brick size
+  static const std::string GetSurfaceBrickSizeParameterName() { return "Surface brick size"; };
 
 public:
   static vtkBinaryLabelmapToClosedSurfaceConversionRule* New();
@@ -61,9 +71,17 @@ public:
   /// Update the target representation based on the source representation
   virtual bool Convert(vtkDataObject* sourceRepresentation, vtkDataObject* targetRepresentation) VTK_OVERRIDE;
 
+  /// Regenerate only the surface bricks that overlap with the modified extent of the labelmap.
+  /// Full conversion is performed if the surface was not generated in bricks with the current
+  /// conversion parameters and labelmap geometry.
+  virtual bool ConvertModifiedExtent(vtkDataObject* sourceRepresentation, vtkDataObject* targetRepresentation, const int modifiedExtent[6]) VTK_OVERRIDE;
+
   /// Get the cost of the conversion.
   virtual unsigned int GetConversionCost(vtkDataObject* sourceRepresentation=NULL, vtkDataObject* targetRepresentation=NULL) VTK_OVERRIDE;
 
+  /// Conversion only uses local filters, so segments can be converted concurrently
+  virtual bool IsThreadSafe() VTK_OVERRIDE { return true; };
+
   /// Human-readable name of the converter rule
   virtual const char* GetName()  VTK_OVERRIDE { return "Binary labelmap to closed surface"; };
 
@@ -78,6 +96,18 @@ protected:
   /// This function checks whether this is the case.
   bool IsLabelmapPaddingNecessary(vtkImageData* binaryLabelMap);
 
+  /// Generate closed surface of the labelmap in bricks.
+  /// \param brickRange Range of brick indices to generate, in the form of an extent
+  /// \param appendFilter The surface of each non-empty brick is added as input to this filter
+  void AppendBrickSurfaces(vtkOrientedImageData* binaryLabelMap, const int brickRange[6], vtkAppendPolyData* appendFilter);
+
+  /// Get string that identifies the conversion parameters and labelmap geometry that a brick surface is generated with.
+  /// Bricks of a surface can only be regenerated if the surface has the same signature.
+  std::string GetBrickSurfaceSignature(vtkOrientedImageData* binaryLabelMap);
+
+  /// Set output surface from the appended brick surfaces and store the signature in its field data
+  void SetBrickSurface(vtkAppendPolyData* appendFilter, vtkOrientedImageData* binaryLabelMap, vtkPolyData* closedSurfacePolyData);
+
 protected:
   vtkBinaryLabelmapToClosedSurfaceConversionRule();
   ~vtkBinaryLabelmapToClosedSurfaceConversionRule();
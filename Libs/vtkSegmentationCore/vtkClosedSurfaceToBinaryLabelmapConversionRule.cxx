@@ -229,6 +229,16 @@ bool vtkClosedSurfaceToBinaryLabelmapConversionRule::Convert(vtkDataObject* sour
   return true;
 }
 
+//----------------------------------------------------------------------------
+bool vtkClosedSurfaceToBinaryLabelmapConversionRule::IsThreadSafe()
+{
+  std::string geometryString = this->ConversionParameters[vtkSegmentationConverter::GetReferenceImageGeometryParameterName()].first;
+  vtkNew<vtkMatrix4x4> geometryMatrix;
+  int extent[6] = { 0, -1, 0, -1, 0, -1 };
+  return !geometryString.empty()
+    && vtkSegmentationConverter::DeserializeImageGeometry(geometryString, geometryMatrix.GetPointer(), extent);
+}
+
 //----------------------------------------------------------------------------
 bool vtkClosedSurfaceToBinaryLabelmapConversionRule::CalculateOutputGeometry(vtkPolyData* closedSurfacePolyData, vtkOrientedImageData* geometryImageData)
 {
@@ -65,6 +65,11 @@ public:
   /// Get the cost of the conversion.
   virtual unsigned int GetConversionCost(vtkDataObject* sourceRepresentation=NULL, vtkDataObject* targetRepresentation=NULL) VTK_OVERRIDE;
 
+  /// Conversion only uses local filters, so segments can be converted concurrently
+  /// if the reference image geometry is specified. Otherwise the default geometry,
+  /// computed from the first converted segment, is stored in the conversion parameters.
+  virtual bool IsThreadSafe() VTK_OVERRIDE;
+
   /// Human-readable name of the converter rule
   virtual const char* GetName() VTK_OVERRIDE { return "Closed surface to binary labelmap (simple image stencil)"; };
 
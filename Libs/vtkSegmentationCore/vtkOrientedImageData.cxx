@@ -27,6 +27,7 @@
 #include <vtkMatrix4x4.h>
 #include <vtkMath.h>
 #include <vtkMathUtilities.h>
+#include <vtkMutexLock.h>
 
 // STD includes
 #include <algorithm>
@@ -44,11 +45,21 @@ vtkOrientedImageData::vtkOrientedImageData()
       this->Directions[i][j] = (i == j) ? 1.0 : 0.0;
       }
     }
+
+  for (i=0; i<6; i++)
+    {
+    this->CachedEffectiveExtent[i] = (i % 2 == 0 ? 0 : -1);
+    }
+  this->CachedEffectiveExtentThreshold = 0.0;
+  this->CachedEffectiveExtentTime = 0;
+  this->CachedEffectiveExtentLock = vtkSimpleMutexLock::New();
 }
 
 //----------------------------------------------------------------------------
 vtkOrientedImageData::~vtkOrientedImageData()
 {
+  this->CachedEffectiveExtentLock->Delete();
+  this->CachedEffectiveExtentLock = NULL;
 }
 
 //----------------------------------------------------------------------------
@@ -376,3 +387,39 @@ bool vtkOrientedImageData::IsEmpty()
     }
   return false;
 }
+
+//---------------------------------------------------------------------------
+void vtkOrientedImageData::SetCachedEffectiveExtent(const int effectiveExtent[6], double threshold)
+{
+  // Not a content change, so Modified() is not called
+  vtkMTimeType mTime = this->GetMTime();
+  this->CachedEffectiveExtentLock->Lock();
+  for (int i=0; i<6; i++)
+    {
+    this->CachedEffectiveExtent[i] = effectiveExtent[i];
+    }
+  this->CachedEffectiveExtentThreshold = threshold;
+  this->CachedEffectiveExtentTime = mTime;
+  this->CachedEffectiveExtentLock->Unlock();
+}
+
+//---------------------------------------------------------------------------
+bool vtkOrientedImageData::GetCachedEffectiveExtent(int effectiveExtent[6], double threshold)
+{
+  // MTime of the image includes the MTime of the point data arrays
+  vtkMTimeType mTime = this->GetMTime();
+  this->CachedEffectiveExtentLock->Lock();
+  if (this->CachedEffectiveExtentTime == 0
+    || this->CachedEffectiveExtentTime != mTime
+    || this->CachedEffectiveExtentThreshold != threshold)
+    {
+    this->CachedEffectiveExtentLock->Unlock();
+    return false;
+    }
+  for (int i=0; i<6; i++)
+    {
+    effectiveExtent[i] = this->CachedEffectiveExtent[i];
+    }
+  this->CachedEffectiveExtentLock->Unlock();
+  return true;
+}
@@ -27,6 +27,7 @@
 #include "vtkImageData.h"
 
 class vtkMatrix4x4;
+class vtkSimpleMutexLock;
 
 /// \ingroup SegmentationCore
 /// \brief Image data containing orientation information
@@ -84,6 +85,18 @@ public:
   /// Determines whether the image data is empty (if the extent has 0 voxels then it is)
   bool IsEmpty();
 
+  /// Store the effective extent (extent of voxels above threshold) of the current image content.
+  /// The stored extent is discarded when the modified time of the image or its scalars changes.
+  /// Voxels written directly through the scalar pointer do not change the modified time,
+  /// so Modified() must be called on the image or its scalars after such writes,
+  /// otherwise an outdated extent is returned.
+  /// The stored extent may be set and get from multiple threads at the same time.
+  /// \sa vtkOrientedImageDataResample::CalculateEffectiveExtent
+  void SetCachedEffectiveExtent(const int effectiveExtent[6], double threshold);
+  /// Get the effective extent stored for the current image content.
+  /// \return False if no extent is stored for this threshold or the image has been modified since it was stored
+  bool GetCachedEffectiveExtent(int effectiveExtent[6], double threshold);
+
 protected:
   vtkOrientedImageData();
   ~vtkOrientedImageData();
@@ -93,6 +106,12 @@ protected:
   /// These are unit length direction cosines
   double Directions[3][3];
 
+  /// Effective extent computed for the image content at CachedEffectiveExtentTime
+  int CachedEffectiveExtent[6];
+  double CachedEffectiveExtentThreshold;
+  vtkMTimeType CachedEffectiveExtentTime;
+  vtkSimpleMutexLock* CachedEffectiveExtentLock;
+
 private:
   vtkOrientedImageData(const vtkOrientedImageData&);  // Not implemented.
   void operator=(const vtkOrientedImageData&);  // Not implemented.
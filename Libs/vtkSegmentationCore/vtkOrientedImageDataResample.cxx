@@ -42,6 +42,7 @@
 
 // STD includes
 #include <algorithm>
+#include <vector>
 
 vtkStandardNewMacro(vtkOrientedImageDataResample);
 
@@ -614,12 +615,17 @@ bool vtkOrientedImageDataResample::CalculateEffectiveExtent(vtkOrientedImageData
     return false;
     }
 
-  switch (image->GetScalarType())
+  // Effective extent is stored in the image, so it is only computed again if the image is modified
+  if (!image->GetCachedEffectiveExtent(effectiveExtent, threshold))
     {
-    vtkTemplateMacro(CalculateEffectiveExtentGeneric<VTK_TT>(image, effectiveExtent, threshold));
-  default:
-    vtkGenericWarningMacro("vtkOrientedImageDataResample::CalculateEffectiveExtent: Unknown ScalarType");
-    return false;
+    switch (image->GetScalarType())
+      {
+      vtkTemplateMacro(CalculateEffectiveExtentGeneric<VTK_TT>(image, effectiveExtent, threshold));
+    default:
+      vtkGenericWarningMacro("vtkOrientedImageDataResample::CalculateEffectiveExtent: Unknown ScalarType");
+      return false;
+      }
+    image->SetCachedEffectiveExtent(effectiveExtent, threshold);
     }
 
   // Return with failure if effective input extent is empty
@@ -631,6 +637,72 @@ bool vtkOrientedImageDataResample::CalculateEffectiveExtent(vtkOrientedImageData
   return true;
 }
 
+//----------------------------------------------------------------------------
+template <typename T> void CalculateLabelExtentsGeneric(vtkImageData* image, std::map<int, std::vector<int> >& labelExtents)
+{
+  int *wholeExt = image->GetExtent();
+
+  // Extent of the label of the previous voxel, neighboring voxels mostly have the same label
+  int currentLabel = 0;
+  int* currentLabelExtent = NULL;
+  for (int k = wholeExt[4]; k <= wholeExt[5]; k++)
+    {
+    for (int j = wholeExt[2]; j <= wholeExt[3]; j++)
+      {
+      T* imagePtr = static_cast<T*>(image->GetScalarPointer(wholeExt[0],j,k));
+      for (int i = wholeExt[0]; i <= wholeExt[1]; i++)
+        {
+        int label = static_cast<int>(*(imagePtr++));
+        if (label == 0)
+          {
+          continue;
+          }
+        if (label != currentLabel)
+          {
+          std::map<int, std::vector<int> >::iterator labelExtentIt = labelExtents.find(label);
+          if (labelExtentIt == labelExtents.end())
+            {
+            int emptyExtent[6] = { wholeExt[1]+1, wholeExt[0]-1, wholeExt[3]+1, wholeExt[2]-1, wholeExt[5]+1, wholeExt[4]-1 };
+            labelExtentIt = labelExtents.insert(std::make_pair(label, std::vector<int>(emptyExtent, emptyExtent+6))).first;
+            }
+          currentLabel = label;
+          currentLabelExtent = &(labelExtentIt->second[0]);
+          }
+        if (i < currentLabelExtent[0]) { currentLabelExtent[0] = i; }
+        if (i > currentLabelExtent[1]) { currentLabelExtent[1] = i; }
+        if (j < currentLabelExtent[2]) { currentLabelExtent[2] = j; }
+        if (j > currentLabelExtent[3]) { currentLabelExtent[3] = j; }
+        if (k < currentLabelExtent[4]) { currentLabelExtent[4] = k; }
+        if (k > currentLabelExtent[5]) { currentLabelExtent[5] = k; }
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkOrientedImageDataResample::CalculateLabelExtents(vtkImageData* image, std::map<int, std::vector<int> >& labelExtents)
+{
+  labelExtents.clear();
+  if (!image)
+    {
+    return false;
+    }
+  if (image->GetScalarPointer() == NULL)
+    {
+    // no image data is allocated, there are no labels
+    return true;
+    }
+
+  switch (image->GetScalarType())
+    {
+    vtkTemplateMacro(CalculateLabelExtentsGeneric<VTK_TT>(image, labelExtents));
+  default:
+    vtkGenericWarningMacro("vtkOrientedImageDataResample::CalculateLabelExtents: Unknown ScalarType");
+    return false;
+    }
+  return true;
+}
+
 //----------------------------------------------------------------------------
 bool vtkOrientedImageDataResample::DoGeometriesMatch(vtkOrientedImageData* image1, vtkOrientedImageData* image2)
 {
@@ -1014,6 +1086,59 @@ bool vtkOrientedImageDataResample::PadImageToContainImage(vtkOrientedImageData*
   return true;
 }
 
+//----------------------------------------------------------------------------
+/// Maximum and masking operations do not change the base image where the modifier image is background,
+/// therefore these operations can be limited to the effective extent of the modifier image.
+/// \param operationExtent Extent that the operation has to be performed in. If extent is specified then it is
+///   intersected with it.
+/// \param operationExtent Set to an empty extent if the modifier image has no voxels above the threshold.
+/// \return False if the operation cannot be limited to the effective extent of the modifier image
+static bool GetModifierEffectiveExtent(vtkOrientedImageData* baseImage, vtkOrientedImageData* modifierImage, int operation,
+  const int extent[6], double maskThreshold, int operationExtent[6])
+{
+  double threshold = 0.0;
+  if (operation == vtkOrientedImageDataResample::OPERATION_MAXIMUM)
+    {
+    // Background (0) is the minimum value only if neither image can contain negative values
+    if (baseImage->GetScalarTypeMin() < 0 || modifierImage->GetScalarTypeMin() < 0)
+      {
+      return false;
+      }
+    }
+  else if (operation == vtkOrientedImageDataResample::OPERATION_MASKING)
+    {
+    // Only voxels above the mask threshold modify the base image
+    if (maskThreshold < 0)
+      {
+      return false;
+      }
+    threshold = maskThreshold;
+    }
+  else
+    {
+    return false;
+    }
+  if (!vtkOrientedImageDataResample::CalculateEffectiveExtent(modifierImage, operationExtent, threshold))
+    {
+    // Modifier image is empty, or its voxels cannot be read (then the extent is not set)
+    for (int i = 0; i < 3; ++i)
+      {
+      operationExtent[i * 2] = 0;
+      operationExtent[i * 2 + 1] = -1;
+      }
+    return true;
+    }
+  if (extent)
+    {
+    for (int i = 0; i < 3; ++i)
+      {
+      operationExtent[i * 2] = std::max(operationExtent[i * 2], extent[i * 2]);
+      operationExtent[i * 2 + 1] = std::min(operationExtent[i * 2 + 1], extent[i * 2 + 1]);
+      }
+    }
+  return true;
+}
+
 //----------------------------------------------------------------------------
 bool vtkOrientedImageDataResample::MergeImage(
     vtkOrientedImageData* inputImage,
@@ -1039,6 +1164,21 @@ bool vtkOrientedImageDataResample::MergeImage(
     vtkGenericWarningMacro("vtkOrientedImageDataResample::MergeImage failed: geometry mismatch between inputImage and imageToAppend");
     return false;
     }
+  // Only grow the output image to contain the non-background region of the appended image
+  int effectiveExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  if (GetModifierEffectiveExtent(inputImage, imageToAppend, operation, extent, maskThreshold, effectiveExtent))
+    {
+    if (effectiveExtent[0] > effectiveExtent[1] || effectiveExtent[2] > effectiveExtent[3] || effectiveExtent[4] > effectiveExtent[5])
+      {
+      // Appended image is empty, output is the same as the input
+      if (outputImage != inputImage)
+        {
+        outputImage->DeepCopy(inputImage);
+        }
+      return true;
+      }
+    extent = effectiveExtent;
+    }
   if (!vtkOrientedImageDataResample::PadImageToContainImage(inputImage, imageToAppend, outputImage, extent))
     {
     vtkGenericWarningMacro("vtkOrientedImageDataResample::MergeImage: Failed to pad segment labelmap");
@@ -1084,6 +1224,16 @@ bool vtkOrientedImageDataResample::ModifyImage(
     vtkGenericWarningMacro("vtkOrientedImageDataResample::ModifyImage failed: geometry mismatch between inputImage and modifierImage");
     return false;
     }
+  int effectiveExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  if (GetModifierEffectiveExtent(inputImage, modifierImage, operation, extent, maskThreshold, effectiveExtent))
+    {
+    if (effectiveExtent[0] > effectiveExtent[1] || effectiveExtent[2] > effectiveExtent[3] || effectiveExtent[4] > effectiveExtent[5])
+      {
+      // Modifier image is empty, nothing to do
+      return true;
+      }
+    extent = effectiveExtent;
+    }
   switch (inputImage->GetScalarType())
     {
     vtkTemplateMacro(MergeImageGeneric<VTK_TT>(
@@ -1100,6 +1250,205 @@ bool vtkOrientedImageDataResample::ModifyImage(
   return true;
 }
 
+//----------------------------------------------------------------------------
+template <typename T> void ExtractLabelGeneric(vtkImageData* inputImage, T labelValue, vtkImageData* outputImage, const int* knownLabelExtent)
+{
+  int* wholeExt = inputImage->GetExtent();
+
+  // Find the extent of the label
+  int labelExtent[6] = { wholeExt[1]+1, wholeExt[0]-1, wholeExt[3]+1, wholeExt[2]-1, wholeExt[5]+1, wholeExt[4]-1 };
+  if (knownLabelExtent)
+    {
+    // Label extent is already known, only make sure that it is within the image
+    for (int i = 0; i < 3; i++)
+      {
+      labelExtent[i*2] = std::max(knownLabelExtent[i*2], wholeExt[i*2]);
+      labelExtent[i*2+1] = std::min(knownLabelExtent[i*2+1], wholeExt[i*2+1]);
+      }
+    }
+  for (int k = wholeExt[4]; k <= wholeExt[5] && !knownLabelExtent; k++)
+    {
+    for (int j = wholeExt[2]; j <= wholeExt[3]; j++)
+      {
+      T* inputPtr = static_cast<T*>(inputImage->GetScalarPointer(wholeExt[0],j,k));
+      for (int i = wholeExt[0]; i <= wholeExt[1]; i++)
+        {
+        if (*(inputPtr++) == labelValue)
+          {
+          if (i < labelExtent[0]) { labelExtent[0] = i; }
+          if (i > labelExtent[1]) { labelExtent[1] = i; }
+          if (j < labelExtent[2]) { labelExtent[2] = j; }
+          if (j > labelExtent[3]) { labelExtent[3] = j; }
+          if (k < labelExtent[4]) { labelExtent[4] = k; }
+          if (k > labelExtent[5]) { labelExtent[5] = k; }
+          }
+        }
+      }
+    }
+  if (labelExtent[0] > labelExtent[1] || labelExtent[2] > labelExtent[3] || labelExtent[4] > labelExtent[5])
+    {
+    // label is not present in the image
+    return;
+    }
+
+  // Copy the label within its extent
+  outputImage->SetExtent(labelExtent);
+  outputImage->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  for (int k = labelExtent[4]; k <= labelExtent[5]; k++)
+    {
+    for (int j = labelExtent[2]; j <= labelExtent[3]; j++)
+      {
+      T* inputPtr = static_cast<T*>(inputImage->GetScalarPointer(labelExtent[0],j,k));
+      unsigned char* outputPtr = static_cast<unsigned char*>(outputImage->GetScalarPointer(labelExtent[0],j,k));
+      for (int i = labelExtent[0]; i <= labelExtent[1]; i++)
+        {
+        *(outputPtr++) = (*(inputPtr++) == labelValue ? 1 : 0);
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkOrientedImageDataResample::ExtractLabel(vtkOrientedImageData* inputImage, int labelValue, vtkOrientedImageData* outputImage, const int labelExtent[6]/*=0*/)
+{
+  if (!inputImage || !outputImage || inputImage == outputImage)
+    {
+    return false;
+    }
+
+  vtkSmartPointer<vtkMatrix4x4> inputImageToWorldMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  inputImage->GetImageToWorldMatrix(inputImageToWorldMatrix);
+
+  outputImage->Initialize();
+  outputImage->SetExtent(0, -1, 0, -1, 0, -1);
+  outputImage->SetImageToWorldMatrix(inputImageToWorldMatrix);
+  if (inputImage->GetScalarPointer() == NULL)
+    {
+    // no image data is allocated, return with empty image
+    return true;
+    }
+
+  switch (inputImage->GetScalarType())
+    {
+    vtkTemplateMacro(ExtractLabelGeneric<VTK_TT>(inputImage, static_cast<VTK_TT>(labelValue), outputImage, labelExtent));
+  default:
+    vtkGenericWarningMacro("vtkOrientedImageDataResample::ExtractLabel: Unknown ScalarType");
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+template <class BaseImageScalarType, class LabelImageScalarType>
+void PaintLabelsGeneric2(vtkImageData* baseImage, vtkImageData* labelImage, const std::map<int, int>& labelToPaintValue,
+  const int* extent)
+{
+  // Update extent is the intersection of base and label image extents (and the requested extent)
+  int updateExt[6] = { 0, -1, 0, -1, 0, -1 };
+  baseImage->GetExtent(updateExt);
+  int* labelExt = labelImage->GetExtent();
+  for (int idx = 0; idx < 3; ++idx)
+    {
+    if (labelExt[idx * 2] > updateExt[idx * 2])
+      {
+      updateExt[idx * 2] = labelExt[idx * 2];
+      }
+    if (labelExt[idx * 2 + 1] < updateExt[idx * 2 + 1])
+      {
+      updateExt[idx * 2 + 1] = labelExt[idx * 2 + 1];
+      }
+    if (extent && extent[idx * 2] > updateExt[idx * 2])
+      {
+      updateExt[idx * 2] = extent[idx * 2];
+      }
+    if (extent && extent[idx * 2 + 1] < updateExt[idx * 2 + 1])
+      {
+      updateExt[idx * 2 + 1] = extent[idx * 2 + 1];
+      }
+    }
+  if (updateExt[0] > updateExt[1] || updateExt[2] > updateExt[3] || updateExt[4] > updateExt[5])
+    {
+    // base and label images do not overlap
+    return;
+    }
+
+  // Lookup table indexed by label value, so that each voxel is painted without a map lookup
+  const int minimumLabel = labelToPaintValue.begin()->first;
+  const int maximumLabel = labelToPaintValue.rbegin()->first;
+  std::vector<BaseImageScalarType> paintValues(maximumLabel - minimumLabel + 1, 0);
+  std::vector<bool> paintLabels(maximumLabel - minimumLabel + 1, false);
+  for (std::map<int, int>::const_iterator labelIt = labelToPaintValue.begin(); labelIt != labelToPaintValue.end(); ++labelIt)
+    {
+    paintValues[labelIt->first - minimumLabel] = static_cast<BaseImageScalarType>(labelIt->second);
+    paintLabels[labelIt->first - minimumLabel] = true;
+    }
+
+  bool baseImageModified = false;
+  for (int k = updateExt[4]; k <= updateExt[5]; k++)
+    {
+    for (int j = updateExt[2]; j <= updateExt[3]; j++)
+      {
+      BaseImageScalarType* basePtr = static_cast<BaseImageScalarType*>(baseImage->GetScalarPointer(updateExt[0], j, k));
+      LabelImageScalarType* labelPtr = static_cast<LabelImageScalarType*>(labelImage->GetScalarPointer(updateExt[0], j, k));
+      for (int i = updateExt[0]; i <= updateExt[1]; i++, basePtr++, labelPtr++)
+        {
+        int label = static_cast<int>(*labelPtr);
+        if (label < minimumLabel || label > maximumLabel || !paintLabels[label - minimumLabel])
+          {
+          continue;
+          }
+        *basePtr = paintValues[label - minimumLabel];
+        baseImageModified = true;
+        }
+      }
+    }
+  if (baseImageModified)
+    {
+    baseImage->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+template <class BaseImageScalarType>
+void PaintLabelsGeneric(vtkImageData* baseImage, vtkImageData* labelImage, const std::map<int, int>& labelToPaintValue,
+  const int* extent)
+{
+  switch (labelImage->GetScalarType())
+    {
+    vtkTemplateMacro((PaintLabelsGeneric2<BaseImageScalarType, VTK_TT>(baseImage, labelImage, labelToPaintValue, extent)));
+  default:
+    vtkGenericWarningMacro("vtkOrientedImageDataResample::PaintLabels: Unknown ScalarType");
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkOrientedImageDataResample::PaintLabels(vtkOrientedImageData* baseImage, vtkOrientedImageData* labelImage,
+  const std::map<int, int>& labelToPaintValue, const int extent[6]/*=0*/)
+{
+  if (!baseImage || !labelImage)
+    {
+    return false;
+    }
+  if (labelToPaintValue.empty() || baseImage->GetScalarPointer() == NULL || labelImage->GetScalarPointer() == NULL)
+    {
+    // nothing to paint
+    return true;
+    }
+  if (!vtkOrientedImageDataResample::DoGeometriesMatch(baseImage, labelImage))
+    {
+    vtkGenericWarningMacro("vtkOrientedImageDataResample::PaintLabels failed: geometry mismatch between baseImage and labelImage");
+    return false;
+    }
+  switch (baseImage->GetScalarType())
+    {
+    vtkTemplateMacro(PaintLabelsGeneric<VTK_TT>(baseImage, labelImage, labelToPaintValue, extent));
+  default:
+    vtkGenericWarningMacro("vtkOrientedImageDataResample::PaintLabels failed: unknown ScalarType");
+    return false;
+    }
+  return true;
+}
+
 //----------------------------------------------------------------------------
 bool vtkOrientedImageDataResample::CopyImage(vtkOrientedImageData* imageToCopy, vtkOrientedImageData* outputImage, const int extent[6]/*=0*/)
 {
@@ -26,6 +26,10 @@
 
 #include "vtkObject.h"
 
+// STD includes
+#include <map>
+#include <vector>
+
 class vtkImageData;
 class vtkMatrix4x4;
 class vtkOrientedImageData;
@@ -78,6 +82,8 @@ public:
   static void TransformOrientedImage(vtkOrientedImageData* image, vtkAbstractTransform* transform, bool geometryOnly=false, bool alwaysResample=false, bool linearInterpolation=false, double backgroundColor[4]=NULL);
 
   /// Combines the inputImage and imageToAppend into a new image by max/min operation. The extent will be the union of the two images.
+  /// For maximum and masking operations only the effective extent of imageToAppend is merged. This saves time
+  /// for mostly empty images, but the images themselves are still stored with all their voxels.
   /// Extent can be specified to restrict imageToAppend's extent to a smaller region.
   /// inputImage and imageToAppend must have the same geometry, but they may have different extents.
   static bool MergeImage(vtkOrientedImageData* inputImage, vtkOrientedImageData* imageToAppend, vtkOrientedImageData* outputImage, int operation,
@@ -90,6 +96,21 @@ public:
   static bool ModifyImage(vtkOrientedImageData* inputImage, vtkOrientedImageData* modifierImage, int operation,
     const int extent[6] = 0, double maskThreshold = 0, double fillValue = 1);
 
+  /// Extract the voxels of a shared labelmap that are equal to labelValue into a binary labelmap.
+  /// The output is an unsigned char image containing 1 inside the label and 0 elsewhere, and its extent
+  /// is cropped to the region where the label is found (empty extent if the label is not present).
+  /// \param labelExtent Extent of the label in the input image (e.g., computed by CalculateLabelExtents).
+  ///   If specified then the input image is not searched for the label, only this extent is copied.
+  static bool ExtractLabel(vtkOrientedImageData* inputImage, int labelValue, vtkOrientedImageData* outputImage, const int labelExtent[6]=0);
+
+  /// Paint baseImage in a single pass over labelImage: voxels where labelImage is equal to a key of
+  /// labelToPaintValue are set to the mapped value. Other voxels are left unchanged.
+  /// baseImage and labelImage must have the same geometry, but they may have different extents.
+  /// baseImage and labelImage may be the same image (e.g., for clearing a label).
+  /// Extent can be specified to restrict painting to a smaller region.
+  static bool PaintLabels(vtkOrientedImageData* baseImage, vtkOrientedImageData* labelImage, const std::map<int, int>& labelToPaintValue,
+    const int extent[6]=0);
+
   /// Copy image with clipping to the specified extent
   static bool CopyImage(vtkOrientedImageData* imageToCopy, vtkOrientedImageData* outputImage, const int extent[6]=0);
 
@@ -102,8 +123,15 @@ public:
 
 public:
   /// Calculate effective extent of an image: the IJK extent where non-zero voxels are located
+  /// The result is stored in the image and reused until the image is modified.
+  /// Call Modified() on the image after writing its voxels directly to get an up-to-date extent.
+  /// \sa vtkOrientedImageData::GetCachedEffectiveExtent
   static bool CalculateEffectiveExtent(vtkOrientedImageData* image, int effectiveExtent[6], double threshold = 0.0);
 
+  /// Calculate the extent of each label of a labelmap in a single pass over the image.
+  /// labelExtents maps each label value found in the image to its IJK extent (6 values). Voxels of value 0 are ignored.
+  static bool CalculateLabelExtents(vtkImageData* image, std::map<int, std::vector<int> >& labelExtents);
+
   /// Determine if geometries of two oriented image data objects match.
   /// Origin, spacing and direction are considered, extent is not.
   static bool DoGeometriesMatch(vtkOrientedImageData* image1, vtkOrientedImageData* image2);
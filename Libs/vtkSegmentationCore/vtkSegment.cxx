@@ -38,6 +38,7 @@
 
 // STD includes
 #include <algorithm>
+#include <cstring>
 #include <set>
 #include <sstream>
 
@@ -60,6 +61,8 @@ vtkSegment::vtkSegment()
   this->NameAutoGenerated = true;
   this->ColorAutoGenerated = true;
 
+  this->LabelValue = 1;
+
   // Set default terminology Tissue/Tissue from the default Slicer terminology dictionary
   this->SetTag( vtkSegment::GetTerminologyEntryTagName(),
     "Segmentation category and type - 3D Slicer General Anatomy list~SRT^T-D0050^Tissue~SRT^T-D0050^Tissue~^^~Anatomic codes - DICOM master list~^^~^^");
@@ -87,6 +90,8 @@ void vtkSegment::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "NameAutoGenerated: " << (this->NameAutoGenerated ? "true" : "false") << "\n";
   os << indent << "ColorAutoGenerated: " << (this->ColorAutoGenerated ? "true" : "false") << "\n";
 
+  os << indent << "LabelValue: " << this->LabelValue << "\n";
+
   RepresentationMap::iterator reprIt;
   os << indent << "Representations:\n";
   for (reprIt=this->Representations.begin(); reprIt!=this->Representations.end(); ++reprIt)
@@ -123,9 +128,29 @@ void vtkSegment::PrintSelf(ostream& os, vtkIndent indent)
 }
 
 //----------------------------------------------------------------------------
-void vtkSegment::ReadXMLAttributes(const char** vtkNotUsed(atts))
+void vtkSegment::ReadXMLAttributes(const char** atts)
 {
-  // Note: Segment information is read by the storage node
+  // Note: Segment information is read by the storage node, except the label value,
+  // which identifies the voxels of the segment in a shared labelmap
+  if (!atts)
+    {
+    return;
+    }
+  const char* attName = NULL;
+  const char* attValue = NULL;
+  while (*atts != NULL)
+    {
+    attName = *(atts++);
+    attValue = *(atts++);
+    if (!strcmp(attName, "LabelValue"))
+      {
+      std::stringstream ss;
+      ss << attValue;
+      int labelValue = 1;
+      ss >> labelValue;
+      this->SetLabelValue(labelValue);
+      }
+    }
 }
 
 //---------------------------------------------------------------------------
@@ -139,6 +164,8 @@ void vtkSegment::WriteXML(ostream& of, int vtkNotUsed(nIndent))
   of << "NameAutoGenerated=\"" << (this->NameAutoGenerated ? "true" : "false") << "\"";
   of << "ColorAutoGenerated=\"" << (this->ColorAutoGenerated ? "true" : "false") << "\"";
 
+  of << "LabelValue=\"" << this->LabelValue << "\"";
+
   RepresentationMap::iterator reprIt;
   of << "Representations=\"";
   for (reprIt=this->Representations.begin(); reprIt!=this->Representations.end(); ++reprIt)
@@ -157,6 +184,13 @@ void vtkSegment::WriteXML(ostream& of, int vtkNotUsed(nIndent))
 
 //----------------------------------------------------------------------------
 void vtkSegment::DeepCopy(vtkSegment* source)
+{
+  std::map<vtkDataObject*, vtkSmartPointer<vtkDataObject> > copiedRepresentations;
+  this->DeepCopy(source, copiedRepresentations);
+}
+
+//----------------------------------------------------------------------------
+void vtkSegment::DeepCopy(vtkSegment* source, std::map<vtkDataObject*, vtkSmartPointer<vtkDataObject> >& copiedRepresentations)
 {
   if (!source)
     {
@@ -171,6 +205,14 @@ void vtkSegment::DeepCopy(vtkSegment* source)
   RepresentationMap::iterator reprIt;
   for (reprIt=source->Representations.begin(); reprIt!=source->Representations.end(); ++reprIt)
     {
+    std::map<vtkDataObject*, vtkSmartPointer<vtkDataObject> >::iterator copiedIt = copiedRepresentations.find(reprIt->second);
+    if (copiedIt != copiedRepresentations.end())
+      {
+      // this representation has already been copied for another segment
+      this->AddRepresentation(reprIt->first, copiedIt->second);
+      representationNamesToKeep.insert(reprIt->first);
+      continue;
+      }
     vtkDataObject* representationCopy =
       vtkSegmentationConverterFactory::GetInstance()->ConstructRepresentationObjectByClass( reprIt->second->GetClassName() );
     if (!representationCopy)
@@ -180,6 +222,7 @@ void vtkSegment::DeepCopy(vtkSegment* source)
       }
     representationCopy->DeepCopy(reprIt->second);
     this->AddRepresentation(reprIt->first, representationCopy);
+    copiedRepresentations[reprIt->second] = representationCopy;
     representationCopy->Delete(); // this representation is now owned by the segment
     representationNamesToKeep.insert(reprIt->first);
     }
@@ -212,6 +255,7 @@ void vtkSegment::DeepCopyMetadata(vtkSegment* source)
   // Copy properties
   this->SetName(source->Name);
   this->SetColor(source->Color);
+  this->SetLabelValue(source->LabelValue);
   this->Tags = source->Tags;
 }
 
@@ -64,6 +64,16 @@ public:
   /// Deep copy one segment into another
   virtual void DeepCopy(vtkSegment* source);
 
+#ifndef __VTK_WRAP__
+//BTX
+  /// Deep copy one segment into another, keeping representations shared between the copied segments.
+  /// Source representations that are already in copiedRepresentations are not copied again but their
+  /// existing copy is used. New copies are added to copiedRepresentations. This allows copying segments
+  /// that share a labelmap without duplicating the labelmap for each segment.
+  virtual void DeepCopy(vtkSegment* source, std::map<vtkDataObject*, vtkSmartPointer<vtkDataObject> >& copiedRepresentations);
+//ETX
+#endif // __VTK_WRAP__
+
   /// Deep copy metadata (i.e., all data but representations) one segment into another
   virtual void DeepCopyMetadata(vtkSegment* source);
 
@@ -124,6 +134,9 @@ public:
   vtkSetMacro(ColorAutoGenerated, bool);
   vtkBooleanMacro(ColorAutoGenerated, bool);
 
+  vtkGetMacro(LabelValue, int);
+  vtkSetMacro(LabelValue, int);
+
 protected:
   vtkSegment();
   ~vtkSegment();
@@ -149,6 +162,11 @@ protected:
   bool NameAutoGenerated;
   /// Flag indicating whether color was automatically generated. False after user manually overrides. True by default
   bool ColorAutoGenerated;
+
+  /// Value of the voxels that belong to this segment in its binary labelmap representation.
+  /// It is 1 by default and differs only if the labelmap is shared with other segments
+  /// (see \sa vtkSegmentation::CollapseBinaryLabelmaps).
+  int LabelValue;
 };
 
 #endif // __vtkSegment_h
@@ -35,6 +35,9 @@
 #include <vtkMath.h>
 #include <vtkVersion.h>
 #include <vtkCallbackCommand.h>
+#include <vtkConditionVariable.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
 #include <vtkStringArray.h>
 #include <vtkAbstractTransform.h>
 #include <vtkMatrix4x4.h>
@@ -46,6 +49,7 @@
 #include <sstream>
 #include <algorithm>
 #include <functional>
+#include <set>
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSegmentation);
@@ -61,6 +65,206 @@ public:
     }
 };
 
+//----------------------------------------------------------------------------
+template <class LayerScalarType, class SegmentScalarType>
+void DoesSegmentOverlapLayerGeneric2(vtkImageData* layer, vtkImageData* segmentLabelmap, const int extent[6], bool& overlap)
+{
+  overlap = false;
+  for (int k = extent[4]; k <= extent[5]; k++)
+    {
+    for (int j = extent[2]; j <= extent[3]; j++)
+      {
+      LayerScalarType* layerPtr = static_cast<LayerScalarType*>(layer->GetScalarPointer(extent[0], j, k));
+      SegmentScalarType* segmentPtr = static_cast<SegmentScalarType*>(segmentLabelmap->GetScalarPointer(extent[0], j, k));
+      for (int i = extent[0]; i <= extent[1]; i++, layerPtr++, segmentPtr++)
+        {
+        if (*segmentPtr > 0 && *layerPtr != 0)
+          {
+          overlap = true;
+          return;
+          }
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+template <class LayerScalarType>
+void DoesSegmentOverlapLayerGeneric(vtkImageData* layer, vtkImageData* segmentLabelmap, const int extent[6], bool& overlap)
+{
+  switch (segmentLabelmap->GetScalarType())
+    {
+    vtkTemplateMacro((DoesSegmentOverlapLayerGeneric2<LayerScalarType, VTK_TT>(layer, segmentLabelmap, extent, overlap)));
+  default:
+    vtkGenericWarningMacro("vtkSegmentation::CollapseBinaryLabelmaps: Unknown ScalarType");
+    overlap = true;
+    }
+}
+
+//----------------------------------------------------------------------------
+/// Determine if there are non-zero voxels in layer where segmentLabelmap is non-zero, within extent.
+/// Images must have the same geometry and extent must be within the extents of both images.
+bool DoesSegmentOverlapLayer(vtkImageData* layer, vtkImageData* segmentLabelmap, const int extent[6])
+{
+  bool overlap = true;
+  switch (layer->GetScalarType())
+    {
+    vtkTemplateMacro(DoesSegmentOverlapLayerGeneric<VTK_TT>(layer, segmentLabelmap, extent, overlap));
+  default:
+    vtkGenericWarningMacro("vtkSegmentation::CollapseBinaryLabelmaps: Unknown ScalarType");
+    }
+  return overlap;
+}
+
+//----------------------------------------------------------------------------
+/// Segment conversion that can be run on a worker thread. All inputs are collected on the
+/// calling thread, the worker only accesses the job, the conversion rules, and the source representations.
+struct SegmentConversionJob
+{
+  SegmentConversionJob()
+    : SharedBinaryLabelmap(NULL)
+    , LabelValue(1)
+    , EstimatedMemorySize(0)
+    , Success(false)
+    {
+    }
+
+  /// Representations of the segment along the conversion path (name -> object).
+  /// Created or updated representations replace the original ones during conversion.
+  std::map<std::string, vtkSmartPointer<vtkDataObject> > Representations;
+  /// Binary labelmap that contains other segments as well. Voxels of this segment are extracted before conversion.
+  vtkOrientedImageData* SharedBinaryLabelmap;
+  int LabelValue;
+  /// Extent of the segment in the shared labelmap, if known (6 values). Spares searching the whole labelmap for the label.
+  std::vector<int> LabelExtent;
+  /// Representations that were created or updated during conversion, in conversion order
+  std::vector<std::string> ConvertedRepresentationNames;
+  /// Estimated memory need of the conversion in kiB
+  unsigned long EstimatedMemorySize;
+  bool Success;
+};
+
+//----------------------------------------------------------------------------
+/// Convert a segment along the path. Equivalent of vtkSegmentation::ConvertSegmentUsingPath
+/// that does not modify the segment.
+bool RunSegmentConversionJob(SegmentConversionJob& job, vtkSegmentationConverter::ConversionPathType& path, bool overwriteExisting)
+{
+  for (vtkSegmentationConverter::ConversionPathType::iterator pathIt = path.begin(); pathIt != path.end(); ++pathIt)
+    {
+    vtkSegmentationConverterRule* currentConversionRule = (*pathIt);
+    vtkDataObject* sourceRepresentation = job.Representations[currentConversionRule->GetSourceRepresentationName()];
+    if (!sourceRepresentation)
+      {
+      return false;
+      }
+    // Shared labelmap contains other segments as well, so convert only the voxels of this segment
+    vtkSmartPointer<vtkOrientedImageData> segmentBinaryLabelmap;
+    if (sourceRepresentation == job.SharedBinaryLabelmap)
+      {
+      segmentBinaryLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+      if (!vtkOrientedImageDataResample::ExtractLabel(job.SharedBinaryLabelmap, job.LabelValue, segmentBinaryLabelmap,
+        job.LabelExtent.empty() ? NULL : &job.LabelExtent[0]))
+        {
+        return false;
+        }
+      sourceRepresentation = segmentBinaryLabelmap;
+      }
+
+    vtkSmartPointer<vtkDataObject> targetRepresentation = job.Representations[currentConversionRule->GetTargetRepresentationName()];
+    if (targetRepresentation.GetPointer() && !overwriteExisting)
+      {
+      continue;
+      }
+    if (!targetRepresentation.GetPointer())
+      {
+      targetRepresentation = vtkSmartPointer<vtkDataObject>::Take(
+        currentConversionRule->ConstructRepresentationObjectByRepresentation(currentConversionRule->GetTargetRepresentationName()) );
+      }
+
+    currentConversionRule->Convert(sourceRepresentation, targetRepresentation);
+
+    job.Representations[currentConversionRule->GetTargetRepresentationName()] = targetRepresentation;
+    job.ConvertedRepresentationNames.push_back(currentConversionRule->GetTargetRepresentationName());
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+/// State shared between the threads of a concurrent conversion.
+/// Thread 0 only reports progress, the other threads convert the segments.
+struct ConcurrentConversionState
+{
+  vtkSegmentation* Segmentation;
+  vtkSegmentationConverter::ConversionPathType Path;
+  bool OverwriteExisting;
+  std::vector<SegmentConversionJob> Jobs;
+  unsigned long MaximumMemorySize;
+
+  vtkSimpleMutexLock Lock;
+  vtkNew<vtkConditionVariable> JobCompleted;
+  size_t NextJobIndex;
+  int NumberOfRunningJobs;
+  int NumberOfCompletedJobs;
+  unsigned long RunningJobsMemorySize;
+};
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE ConcurrentConversionThreadFunction(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  ConcurrentConversionState* state = static_cast<ConcurrentConversionState*>(info->UserData);
+  const int numberOfJobs = static_cast<int>(state->Jobs.size());
+
+  if (info->ThreadID == 0)
+    {
+    // Progress is reported on the calling thread, observers may not be thread-safe
+    int numberOfReportedJobs = 0;
+    state->Lock.Lock();
+    while (numberOfReportedJobs < numberOfJobs)
+      {
+      if (state->NumberOfCompletedJobs == numberOfReportedJobs)
+        {
+        state->JobCompleted->Wait(state->Lock);
+        continue;
+        }
+      numberOfReportedJobs = state->NumberOfCompletedJobs;
+      state->Lock.Unlock();
+      double progress = static_cast<double>(numberOfReportedJobs) / numberOfJobs;
+      state->Segmentation->InvokeEvent(vtkCommand::ProgressEvent, &progress);
+      state->Lock.Lock();
+      }
+    state->Lock.Unlock();
+    return VTK_THREAD_RETURN_VALUE;
+    }
+
+  state->Lock.Lock();
+  while (state->NextJobIndex < state->Jobs.size())
+    {
+    SegmentConversionJob& job = state->Jobs[state->NextJobIndex];
+    if (state->MaximumMemorySize > 0 && state->NumberOfRunningJobs > 0
+      && state->RunningJobsMemorySize + job.EstimatedMemorySize > state->MaximumMemorySize)
+      {
+      // Wait until running conversions release memory
+      state->JobCompleted->Wait(state->Lock);
+      continue;
+      }
+    ++state->NextJobIndex;
+    ++state->NumberOfRunningJobs;
+    state->RunningJobsMemorySize += job.EstimatedMemorySize;
+    state->Lock.Unlock();
+
+    job.Success = RunSegmentConversionJob(job, state->Path, state->OverwriteExisting);
+
+    state->Lock.Lock();
+    --state->NumberOfRunningJobs;
+    ++state->NumberOfCompletedJobs;
+    state->RunningJobsMemorySize -= job.EstimatedMemorySize;
+    state->JobCompleted->Broadcast();
+    }
+  state->Lock.Unlock();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
 //----------------------------------------------------------------------------
 vtkSegmentation::vtkSegmentation()
 {
@@ -77,6 +281,11 @@ vtkSegmentation::vtkSegmentation()
 
   this->MasterRepresentationModifiedEnabled = true;
 
+  this->LayerSegmentCountsValid = false;
+
+  this->NumberOfConversionThreads = 1;
+  this->MaximumConversionMemorySize = 0;
+
   this->SegmentIdAutogeneratorIndex = 0;
 }
 
@@ -144,11 +353,12 @@ void vtkSegmentation::DeepCopy(vtkSegmentation* aSegmentation)
   // Copy conversion parameters
   this->Converter->DeepCopy(aSegmentation->Converter);
 
-  // Deep copy segments list
+  // Deep copy segments list (shared labelmaps are copied only once)
+  std::map<vtkDataObject*, vtkSmartPointer<vtkDataObject> > copiedRepresentations;
   for (std::deque< std::string >::iterator segmentIdIt = aSegmentation->SegmentIds.begin(); segmentIdIt != aSegmentation->SegmentIds.end(); ++segmentIdIt)
     {
     vtkSmartPointer<vtkSegment> segment = vtkSmartPointer<vtkSegment>::New();
-    segment->DeepCopy(aSegmentation->Segments[*segmentIdIt]);
+    segment->DeepCopy(aSegmentation->Segments[*segmentIdIt], copiedRepresentations);
     this->AddSegment(segment);
     }
 }
@@ -170,6 +380,8 @@ void vtkSegmentation::PrintSelf(ostream& os, vtkIndent indent)
 
   os << indent << "MasterRepresentationName:  " << this->MasterRepresentationName << "\n";
   os << indent << "Number of segments:  " << this->Segments.size() << "\n";
+  os << indent << "NumberOfConversionThreads:  " << this->NumberOfConversionThreads << "\n";
+  os << indent << "MaximumConversionMemorySize:  " << this->MaximumConversionMemorySize << "\n";
 
   for (std::deque< std::string >::iterator segmentIdIt = this->SegmentIds.begin();
     segmentIdIt != this->SegmentIds.end(); ++segmentIdIt)
@@ -216,6 +428,15 @@ void vtkSegmentation::SetMasterRepresentationName(const std::string& representat
     return;
     }
 
+  // Shared labelmaps are only supported as master representation
+  if (this->MasterRepresentationName == vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName())
+    {
+    for (std::deque< std::string >::iterator segmentIdIt = this->SegmentIds.begin(); segmentIdIt != this->SegmentIds.end(); ++segmentIdIt)
+      {
+      this->SeparateSegmentLabelmap(*segmentIdIt);
+      }
+    }
+
   // Remove observation of old master representation in all segments
   bool wasMasterRepresentationModifiedEnabled = this->SetMasterRepresentationModifiedEnabled(false);
 
@@ -439,6 +660,7 @@ bool vtkSegmentation::AddSegment(vtkSegment* segment, std::string segmentId/*=""
     key = this->GenerateUniqueSegmentID(key);
     }
   this->Segments[key] = segment;
+  this->LayerSegmentCountsValid = false;
   if (insertBeforeSegmentId.empty())
     {
     this->SegmentIds.push_back(key);
@@ -514,6 +736,12 @@ void vtkSegmentation::RemoveSegment(SegmentMap::iterator segmentIt)
 
   std::string segmentId(segmentIt->first);
 
+  // The removed segment must not keep referring to a labelmap that other segments still use
+  if (this->IsSharedBinaryLabelmap(segmentIt->second))
+    {
+    this->SeparateSegmentLabelmap(segmentId);
+    }
+
   // Remove observation of segment modified event
   segmentIt->second.GetPointer()->RemoveObservers(vtkCommand::ModifiedEvent, this->SegmentCallbackCommand);
   // Remove observation of master representation of removed segment
@@ -526,6 +754,7 @@ void vtkSegmentation::RemoveSegment(SegmentMap::iterator segmentIt)
   // Remove segment
   this->SegmentIds.erase(std::remove(this->SegmentIds.begin(), this->SegmentIds.end(), segmentId), this->SegmentIds.end());
   this->Segments.erase(segmentIt);
+  this->LayerSegmentCountsValid = false;
   if (this->Segments.empty())
     {
     this->SegmentIdAutogeneratorIndex = 0;
@@ -549,6 +778,7 @@ void vtkSegmentation::RemoveAllSegments()
     this->RemoveSegment(*segmentIt);
     }
   this->Segments.clear();
+  this->LayerSegmentCountsValid = false;
 
   this->SegmentIdAutogeneratorIndex = 0;
 }
@@ -566,6 +796,9 @@ void vtkSegmentation::OnSegmentModified(vtkObject* caller,
     return;
     }
 
+  // Representations of the segment may have been added, removed or replaced
+  self->LayerSegmentCountsValid = false;
+
   // Invoke segment modified event, but do not invoke general modified event
   std::string segmentId = self->GetSegmentIdBySegment(callerSegment);
   if (segmentId.empty())
@@ -840,6 +1073,7 @@ void vtkSegmentation::ApplyLinearTransform(vtkAbstractTransform* transform)
 
   // Apply linear transform for each segment:
   // Harden transform on master representation if poly data, apply directions if oriented image data
+  std::set<vtkDataObject*> transformedRepresentations;
   for (SegmentMap::iterator it = this->Segments.begin(); it != this->Segments.end(); ++it)
     {
     vtkDataObject* currentMasterRepresentation = it->second->GetRepresentation(this->MasterRepresentationName);
@@ -848,6 +1082,11 @@ void vtkSegmentation::ApplyLinearTransform(vtkAbstractTransform* transform)
       vtkErrorMacro("ApplyLinearTransform: Cannot get master representation (" << this->MasterRepresentationName << ") from segment!");
       return;
       }
+    if (!transformedRepresentations.insert(currentMasterRepresentation).second)
+      {
+      // shared labelmap has already been transformed
+      continue;
+      }
 
     vtkPolyData* currentMasterRepresentationPolyData = vtkPolyData::SafeDownCast(currentMasterRepresentation);
     vtkOrientedImageData* currentMasterRepresentationOrientedImageData = vtkOrientedImageData::SafeDownCast(currentMasterRepresentation);
@@ -887,6 +1126,7 @@ void vtkSegmentation::ApplyNonLinearTransform(vtkAbstractTransform* transform)
   this->Converter->ApplyTransformOnReferenceImageGeometry(transform);
 
   // Harden transform on master representation (both image data and poly data) for each segment individually
+  std::set<vtkDataObject*> transformedRepresentations;
   for (SegmentMap::iterator it = this->Segments.begin(); it != this->Segments.end(); ++it)
     {
     vtkDataObject* currentMasterRepresentation = it->second->GetRepresentation(this->MasterRepresentationName);
@@ -895,6 +1135,11 @@ void vtkSegmentation::ApplyNonLinearTransform(vtkAbstractTransform* transform)
       vtkErrorMacro("ApplyNonLinearTransform: Cannot get master representation (" << this->MasterRepresentationName << ") from segment!");
       return;
       }
+    if (!transformedRepresentations.insert(currentMasterRepresentation).second)
+      {
+      // shared labelmap has already been transformed
+      continue;
+      }
 
     vtkPolyData* currentMasterRepresentationPolyData = vtkPolyData::SafeDownCast(currentMasterRepresentation);
     vtkOrientedImageData* currentMasterRepresentationOrientedImageData = vtkOrientedImageData::SafeDownCast(currentMasterRepresentation);
@@ -941,6 +1186,19 @@ bool vtkSegmentation::ConvertSegmentUsingPath(vtkSegment* segment, vtkSegmentati
       vtkErrorMacro("ConvertSegmentUsingPath: Source representation does not exist!");
       return false;
       }
+    // Shared labelmap contains other segments as well, so convert only the voxels of this segment
+    vtkSmartPointer<vtkOrientedImageData> segmentBinaryLabelmap;
+    if (currentConversionRule->GetSourceRepresentationName() == vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()
+      && (segment->GetLabelValue() != 1 || this->IsSharedBinaryLabelmap(segment)))
+      {
+      segmentBinaryLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+      if (!this->GetSegmentBinaryLabelmap(segment, segmentBinaryLabelmap))
+        {
+        vtkErrorMacro("ConvertSegmentUsingPath: Failed to extract segment from shared labelmap!");
+        return false;
+        }
+      sourceRepresentation = segmentBinaryLabelmap;
+      }
 
     // Get target representation
     vtkSmartPointer<vtkDataObject> targetRepresentation = segment->GetRepresentation(
@@ -968,6 +1226,128 @@ bool vtkSegmentation::ConvertSegmentUsingPath(vtkSegment* segment, vtkSegmentati
   return true;
 }
 
+//---------------------------------------------------------------------------
+bool vtkSegmentation::ConvertSegmentsUsingPath(std::vector<vtkSegment*>& segments, vtkSegmentationConverter::ConversionPathType path, bool overwriteExisting/*=false*/)
+{
+  int numberOfThreads = this->NumberOfConversionThreads;
+  if (numberOfThreads <= 0)
+    {
+    numberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+    }
+  bool threadSafePath = true;
+  for (vtkSegmentationConverter::ConversionPathType::iterator pathIt = path.begin(); pathIt != path.end(); ++pathIt)
+    {
+    if (!(*pathIt) || !(*pathIt)->IsThreadSafe())
+      {
+      threadSafePath = false;
+      break;
+      }
+    }
+
+  if (numberOfThreads < 2 || segments.size() < 2 || !threadSafePath)
+    {
+    int numberOfConvertedSegments = 0;
+    for (std::vector<vtkSegment*>::iterator segmentIt = segments.begin(); segmentIt != segments.end(); ++segmentIt)
+      {
+      if (!this->ConvertSegmentUsingPath(*segmentIt, path, overwriteExisting))
+        {
+        return false;
+        }
+      double progress = static_cast<double>(++numberOfConvertedSegments) / segments.size();
+      this->InvokeEvent(vtkCommand::ProgressEvent, &progress);
+      }
+    return true;
+    }
+
+  // Collect everything the conversion needs, so that worker threads do not access the segments
+  ConcurrentConversionState state;
+  state.Segmentation = this;
+  state.Path = path;
+  state.OverwriteExisting = overwriteExisting;
+  state.MaximumMemorySize = this->MaximumConversionMemorySize;
+  state.NextJobIndex = 0;
+  state.NumberOfRunningJobs = 0;
+  state.NumberOfCompletedJobs = 0;
+  state.RunningJobsMemorySize = 0;
+  state.Jobs.resize(segments.size());
+  std::string binaryLabelmapName = vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName();
+  // Segments of a shared labelmap are extracted before conversion. Extents of all the labels
+  // of a shared labelmap are found in one pass, instead of searching the labelmap for each segment.
+  bool binaryLabelmapIsSource = false;
+  for (vtkSegmentationConverter::ConversionPathType::iterator pathIt = path.begin(); pathIt != path.end(); ++pathIt)
+    {
+    if ((*pathIt)->GetSourceRepresentationName() == binaryLabelmapName)
+      {
+      binaryLabelmapIsSource = true;
+      }
+    }
+  std::map<vtkOrientedImageData*, std::map<int, std::vector<int> > > sharedLabelmapLabelExtents;
+  for (size_t segmentIndex = 0; segmentIndex < segments.size(); ++segmentIndex)
+    {
+    vtkSegment* segment = segments[segmentIndex];
+    SegmentConversionJob& job = state.Jobs[segmentIndex];
+    for (vtkSegmentationConverter::ConversionPathType::iterator pathIt = path.begin(); pathIt != path.end(); ++pathIt)
+      {
+      job.Representations[(*pathIt)->GetSourceRepresentationName()] = segment->GetRepresentation((*pathIt)->GetSourceRepresentationName());
+      job.Representations[(*pathIt)->GetTargetRepresentationName()] = segment->GetRepresentation((*pathIt)->GetTargetRepresentationName());
+      }
+    vtkDataObject* sourceRepresentation = job.Representations[path.front()->GetSourceRepresentationName()];
+    if (!sourceRepresentation)
+      {
+      vtkErrorMacro("ConvertSegmentsUsingPath: Source representation does not exist!");
+      return false;
+      }
+    if (segment->GetLabelValue() != 1 || this->IsSharedBinaryLabelmap(segment))
+      {
+      job.SharedBinaryLabelmap = vtkOrientedImageData::SafeDownCast(segment->GetRepresentation(binaryLabelmapName));
+      job.LabelValue = segment->GetLabelValue();
+      if (binaryLabelmapIsSource && job.SharedBinaryLabelmap)
+        {
+        if (sharedLabelmapLabelExtents.find(job.SharedBinaryLabelmap) == sharedLabelmapLabelExtents.end())
+          {
+          vtkOrientedImageDataResample::CalculateLabelExtents(job.SharedBinaryLabelmap, sharedLabelmapLabelExtents[job.SharedBinaryLabelmap]);
+          }
+        std::map<int, std::vector<int> >& labelExtents = sharedLabelmapLabelExtents[job.SharedBinaryLabelmap];
+        std::map<int, std::vector<int> >::iterator labelExtentIt = labelExtents.find(job.LabelValue);
+        if (labelExtentIt != labelExtents.end())
+          {
+          job.LabelExtent = labelExtentIt->second;
+          }
+        else
+          {
+          // label is not present in the labelmap
+          int emptyExtent[6] = { 0, -1, 0, -1, 0, -1 };
+          job.LabelExtent = std::vector<int>(emptyExtent, emptyExtent+6);
+          }
+        }
+      }
+    // Filters along the conversion typically keep a few copies of the data in memory
+    job.EstimatedMemorySize = 4 * sourceRepresentation->GetActualMemorySize();
+    }
+
+  // Thread 0 reports progress, the others convert
+  vtkNew<vtkMultiThreader> threader;
+  threader->SetNumberOfThreads(std::min(numberOfThreads, static_cast<int>(segments.size())) + 1);
+  threader->SetSingleMethod(ConcurrentConversionThreadFunction, &state);
+  threader->SingleMethodExecute();
+
+  // Add converted representations to the segments in the calling thread, as it invokes events
+  for (size_t segmentIndex = 0; segmentIndex < segments.size(); ++segmentIndex)
+    {
+    SegmentConversionJob& job = state.Jobs[segmentIndex];
+    if (!job.Success)
+      {
+      vtkErrorMacro("ConvertSegmentsUsingPath: Failed to convert segment");
+      return false;
+      }
+    for (std::vector<std::string>::iterator nameIt = job.ConvertedRepresentationNames.begin(); nameIt != job.ConvertedRepresentationNames.end(); ++nameIt)
+      {
+      segments[segmentIndex]->AddRepresentation(*nameIt, job.Representations[*nameIt]);
+      }
+    }
+  return true;
+}
+
 //---------------------------------------------------------------------------
 bool vtkSegmentation::CreateRepresentation(const std::string& targetRepresentationName, bool alwaysConvert/*=false*/)
 {
@@ -1030,14 +1410,22 @@ bool vtkSegmentation::CreateRepresentation(const std::string& targetRepresentati
     }
 
   // Perform conversion on all segments (no overwrites)
+  std::vector<vtkSegment*> segments;
+  std::vector<vtkDataObject*> representationsBefore;
   for (SegmentMap::iterator segmentIt = this->Segments.begin(); segmentIt != this->Segments.end(); ++segmentIt)
     {
-    vtkDataObject* representationBefore = segmentIt->second->GetRepresentation(targetRepresentationName);
-    if (!this->ConvertSegmentUsingPath(segmentIt->second, cheapestPath, alwaysConvert))
-      {
-      vtkErrorMacro("CreateRepresentation: Conversion failed");
-      return false;
-      }
+    segments.push_back(segmentIt->second);
+    representationsBefore.push_back(segmentIt->second->GetRepresentation(targetRepresentationName));
+    }
+  if (!this->ConvertSegmentsUsingPath(segments, cheapestPath, alwaysConvert))
+    {
+    vtkErrorMacro("CreateRepresentation: Conversion failed");
+    return false;
+    }
+  std::vector<vtkDataObject*>::iterator representationBeforeIt = representationsBefore.begin();
+  for (SegmentMap::iterator segmentIt = this->Segments.begin(); segmentIt != this->Segments.end(); ++segmentIt, ++representationBeforeIt)
+    {
+    vtkDataObject* representationBefore = (*representationBeforeIt);
     vtkDataObject* representationAfter = segmentIt->second->GetRepresentation(targetRepresentationName);
     if (representationBefore != representationAfter
       || (representationBefore != NULL && representationAfter != NULL && representationBefore->GetMTime() != representationAfter->GetMTime()) )
@@ -1070,13 +1458,18 @@ bool vtkSegmentation::CreateRepresentation(vtkSegmentationConverter::ConversionP
   this->Converter->SetConversionParameters(parameters);
 
   // Perform conversion on all segments (do overwrites)
+  std::vector<vtkSegment*> segments;
+  for (SegmentMap::iterator segmentIt = this->Segments.begin(); segmentIt != this->Segments.end(); ++segmentIt)
+    {
+    segments.push_back(segmentIt->second);
+    }
+  if (!this->ConvertSegmentsUsingPath(segments, path, true))
+    {
+    vtkErrorMacro("CreateRepresentation: Conversion failed");
+    return false;
+    }
   for (SegmentMap::iterator segmentIt = this->Segments.begin(); segmentIt != this->Segments.end(); ++segmentIt)
     {
-    if (!this->ConvertSegmentUsingPath(segmentIt->second, path, true))
-      {
-      vtkErrorMacro("CreateRepresentation: Conversion failed");
-      return false;
-      }
     const char* segmentId = segmentIt->first.c_str();
     this->InvokeEvent(vtkSegmentation::RepresentationModified, (void*)segmentId);
     }
@@ -1313,7 +1706,21 @@ bool vtkSegmentation::CopySegmentFromSegmentation(vtkSegmentation* fromSegmentat
   if (!removeFromSource)
     {
     vtkSmartPointer<vtkSegment> segmentCopy = vtkSmartPointer<vtkSegment>::New();
-    segmentCopy->DeepCopy(segment);
+    std::map<vtkDataObject*, vtkSmartPointer<vtkDataObject> > copiedRepresentations;
+    vtkDataObject* binaryLabelmap = segment->GetRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+    if (binaryLabelmap && (segment->GetLabelValue() != 1 || fromSegmentation->IsSharedBinaryLabelmap(segment)))
+      {
+      // Only copy the voxels of this segment from the shared labelmap
+      vtkSmartPointer<vtkOrientedImageData> segmentBinaryLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+      if (!fromSegmentation->GetSegmentBinaryLabelmap(segment, segmentBinaryLabelmap))
+        {
+        vtkErrorMacro("CopySegmentFromSegmentation: Failed to extract segment '" << segmentId << "' from shared labelmap");
+        return false;
+        }
+      copiedRepresentations[binaryLabelmap] = segmentBinaryLabelmap;
+      }
+    segmentCopy->DeepCopy(segment, copiedRepresentations);
+    segmentCopy->SetLabelValue(1);
     if (!this->AddSegment(segmentCopy, targetSegmentId))
       {
       vtkErrorMacro("CopySegmentFromSegmentation: Failed to add segment '" << targetSegmentId << "' to segmentation");
@@ -1323,6 +1730,8 @@ bool vtkSegmentation::CopySegmentFromSegmentation(vtkSegmentation* fromSegmentat
   // If move, then just add segment to target and remove from source (ownership is transferred)
   else
     {
+    // Ownership of a shared labelmap cannot be transferred
+    fromSegmentation->SeparateSegmentLabelmap(segmentId);
     if (!this->AddSegment(segment, targetSegmentId))
       {
       vtkErrorMacro("CopySegmentFromSegmentation: Failed to add segment '" << targetSegmentId << "' to segmentation");
@@ -1334,6 +1743,314 @@ bool vtkSegmentation::CopySegmentFromSegmentation(vtkSegmentation* fromSegmentat
   return true;
 }
 
+//-----------------------------------------------------------------------------
+bool vtkSegmentation::CollapseBinaryLabelmaps(bool forceToSingleLayer/*=false*/)
+{
+  if (this->MasterRepresentationName != vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName())
+    {
+    vtkErrorMacro("CollapseBinaryLabelmaps: Master representation must be binary labelmap");
+    return false;
+    }
+
+  // Layers are allocated in the common geometry of all segments
+  std::string commonGeometryString = this->DetermineCommonLabelmapGeometry(EXTENT_UNION_OF_EFFECTIVE_SEGMENTS);
+  if (commonGeometryString.empty())
+    {
+    // No segments or only empty segments, there is nothing to pack
+    return true;
+    }
+  vtkSmartPointer<vtkOrientedImageData> commonGeometryImage = vtkSmartPointer<vtkOrientedImageData>::New();
+  vtkSegmentationConverter::DeserializeImageGeometry(commonGeometryString, commonGeometryImage, false);
+  vtkSmartPointer<vtkMatrix4x4> commonGeometryImageToWorldMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  commonGeometryImage->GetImageToWorldMatrix(commonGeometryImageToWorldMatrix);
+  int commonGeometryExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  commonGeometryImage->GetExtent(commonGeometryExtent);
+
+  // Label values must fit into the scalar type of the layers
+  int layerScalarType = VTK_UNSIGNED_CHAR;
+  int maximumLabelValue = VTK_UNSIGNED_CHAR_MAX;
+  if (forceToSingleLayer && static_cast<int>(this->SegmentIds.size()) > VTK_UNSIGNED_CHAR_MAX)
+    {
+    layerScalarType = VTK_SHORT;
+    maximumLabelValue = VTK_SHORT_MAX;
+    }
+
+  std::vector<vtkSmartPointer<vtkOrientedImageData> > layers;
+  std::vector<int> layerLabelCounts;
+  std::vector<int> segmentLayerIndices;
+  std::vector<int> segmentLabelValues;
+  for (std::deque< std::string >::iterator segmentIdIt = this->SegmentIds.begin(); segmentIdIt != this->SegmentIds.end(); ++segmentIdIt)
+    {
+    vtkSmartPointer<vtkOrientedImageData> segmentLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+    if (!this->GetSegmentBinaryLabelmap(*segmentIdIt, segmentLabelmap))
+      {
+      vtkErrorMacro("CollapseBinaryLabelmaps: Failed to get binary labelmap of segment " << *segmentIdIt);
+      return false;
+      }
+
+    // Effective extent of the segment in the common geometry
+    int segmentExtent[6] = { 0, -1, 0, -1, 0, -1 };
+    bool segmentEmpty = !vtkOrientedImageDataResample::CalculateEffectiveExtent(segmentLabelmap, segmentExtent);
+    if (!segmentEmpty && !vtkOrientedImageDataResample::DoGeometriesMatch(commonGeometryImage, segmentLabelmap))
+      {
+      vtkSmartPointer<vtkOrientedImageData> resampledSegmentLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+      if (!vtkOrientedImageDataResample::ResampleOrientedImageToReferenceGeometry(segmentLabelmap, commonGeometryImageToWorldMatrix, resampledSegmentLabelmap))
+        {
+        vtkErrorMacro("CollapseBinaryLabelmaps: Failed to resample segment " << *segmentIdIt << " to common geometry");
+        return false;
+        }
+      segmentLabelmap = resampledSegmentLabelmap;
+      segmentEmpty = !vtkOrientedImageDataResample::CalculateEffectiveExtent(segmentLabelmap, segmentExtent);
+      }
+    for (int i = 0; i < 3 && !segmentEmpty; ++i)
+      {
+      segmentExtent[2*i] = std::max(segmentExtent[2*i], commonGeometryExtent[2*i]);
+      segmentExtent[2*i+1] = std::min(segmentExtent[2*i+1], commonGeometryExtent[2*i+1]);
+      segmentEmpty = (segmentExtent[2*i] > segmentExtent[2*i+1]);
+      }
+
+    // Find the first layer that the segment does not overlap with
+    int layerIndex = -1;
+    for (int i = 0; i < static_cast<int>(layers.size()); ++i)
+      {
+      if (layerLabelCounts[i] >= maximumLabelValue)
+        {
+        continue;
+        }
+      if (forceToSingleLayer || segmentEmpty || !DoesSegmentOverlapLayer(layers[i], segmentLabelmap, segmentExtent))
+        {
+        layerIndex = i;
+        break;
+        }
+      }
+    if (layerIndex < 0)
+      {
+      vtkSmartPointer<vtkOrientedImageData> layer = vtkSmartPointer<vtkOrientedImageData>::New();
+      layer->SetExtent(commonGeometryExtent);
+      layer->SetImageToWorldMatrix(commonGeometryImageToWorldMatrix);
+      layer->AllocateScalars(layerScalarType, 1);
+      vtkOrientedImageDataResample::FillImage(layer, 0);
+      layers.push_back(layer);
+      layerLabelCounts.push_back(0);
+      layerIndex = static_cast<int>(layers.size()) - 1;
+      }
+
+    int labelValue = ++layerLabelCounts[layerIndex];
+    if (!segmentEmpty)
+      {
+      vtkOrientedImageDataResample::ModifyImage(layers[layerIndex], segmentLabelmap,
+        vtkOrientedImageDataResample::OPERATION_MASKING, segmentExtent, 0, labelValue);
+      }
+    segmentLayerIndices.push_back(layerIndex);
+    segmentLabelValues.push_back(labelValue);
+    }
+
+  // Replace the binary labelmap of the segments by the layers
+  bool wasMasterRepresentationModifiedEnabled = this->SetMasterRepresentationModifiedEnabled(false);
+  for (unsigned int segmentIndex = 0; segmentIndex < this->SegmentIds.size(); ++segmentIndex)
+    {
+    vtkSegment* segment = this->Segments[this->SegmentIds[segmentIndex]];
+    segment->SetLabelValue(segmentLabelValues[segmentIndex]);
+    segment->AddRepresentation(this->MasterRepresentationName, layers[segmentLayerIndices[segmentIndex]]);
+    }
+  this->SetMasterRepresentationModifiedEnabled(wasMasterRepresentationModifiedEnabled);
+
+  this->Modified();
+  this->InvokeEvent(vtkSegmentation::MasterRepresentationModified, this);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSegmentation::SeparateSegmentLabelmap(std::string segmentId)
+{
+  vtkSegment* segment = this->GetSegment(segmentId);
+  if (!segment)
+    {
+    vtkErrorMacro("SeparateSegmentLabelmap: Failed to find segment with ID " << segmentId);
+    return false;
+    }
+  vtkOrientedImageData* labelmap = vtkOrientedImageData::SafeDownCast(
+    segment->GetRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
+  bool shared = this->IsSharedBinaryLabelmap(segment);
+  if (!labelmap || (!shared && segment->GetLabelValue() == 1))
+    {
+    // The segment already has its own binary labelmap
+    return true;
+    }
+
+  vtkSmartPointer<vtkOrientedImageData> separatedLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+  if (!vtkOrientedImageDataResample::ExtractLabel(labelmap, segment->GetLabelValue(), separatedLabelmap))
+    {
+    vtkErrorMacro("SeparateSegmentLabelmap: Failed to extract segment " << segmentId << " from shared labelmap");
+    return false;
+    }
+
+  // Content of the segments is not changed, so master representation modified events are not needed
+  bool wasMasterRepresentationModifiedEnabled = this->SetMasterRepresentationModifiedEnabled(false);
+  if (shared)
+    {
+    std::map<int, int> labelToPaintValue;
+    labelToPaintValue[segment->GetLabelValue()] = 0;
+    vtkOrientedImageDataResample::PaintLabels(labelmap, labelmap, labelToPaintValue);
+    }
+  segment->SetLabelValue(1);
+  segment->AddRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName(), separatedLabelmap);
+  this->SetMasterRepresentationModifiedEnabled(wasMasterRepresentationModifiedEnabled);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSegmentation::IsSharedBinaryLabelmap(std::string segmentId)
+{
+  return this->IsSharedBinaryLabelmap(this->GetSegment(segmentId));
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSegmentation::IsSharedBinaryLabelmap(vtkSegment* segment)
+{
+  if (!segment)
+    {
+    return false;
+    }
+  vtkDataObject* labelmap = segment->GetRepresentation(
+    vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+  if (!labelmap)
+    {
+    return false;
+    }
+  return this->GetNumberOfSegmentsInLayer(labelmap) > 1;
+}
+
+//-----------------------------------------------------------------------------
+int vtkSegmentation::GetNumberOfSegmentsInLayer(vtkDataObject* layerDataObject)
+{
+  if (!this->LayerSegmentCountsValid)
+    {
+    this->LayerSegmentCounts.clear();
+    std::string binaryLabelmapName = vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName();
+    for (SegmentMap::iterator segmentIt = this->Segments.begin(); segmentIt != this->Segments.end(); ++segmentIt)
+      {
+      vtkDataObject* labelmap = segmentIt->second->GetRepresentation(binaryLabelmapName);
+      if (labelmap)
+        {
+        ++this->LayerSegmentCounts[labelmap];
+        }
+      }
+    this->LayerSegmentCountsValid = true;
+    }
+  std::map<vtkDataObject*, int>::iterator countIt = this->LayerSegmentCounts.find(layerDataObject);
+  return (countIt != this->LayerSegmentCounts.end() ? countIt->second : 0);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSegmentation::GetSegmentBinaryLabelmap(std::string segmentId, vtkOrientedImageData* binaryLabelmap)
+{
+  vtkSegment* segment = this->GetSegment(segmentId);
+  if (!segment)
+    {
+    vtkErrorMacro("GetSegmentBinaryLabelmap: Failed to find segment with ID " << segmentId);
+    return false;
+    }
+  return this->GetSegmentBinaryLabelmap(segment, binaryLabelmap);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkSegmentation::GetSegmentBinaryLabelmap(vtkSegment* segment, vtkOrientedImageData* binaryLabelmap)
+{
+  if (!segment || !binaryLabelmap)
+    {
+    vtkErrorMacro("GetSegmentBinaryLabelmap: Invalid inputs");
+    return false;
+    }
+  vtkOrientedImageData* labelmap = vtkOrientedImageData::SafeDownCast(
+    segment->GetRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
+  if (!labelmap)
+    {
+    vtkErrorMacro("GetSegmentBinaryLabelmap: Segment does not contain binary labelmap representation");
+    return false;
+    }
+  if (segment->GetLabelValue() == 1 && !this->IsSharedBinaryLabelmap(segment))
+    {
+    binaryLabelmap->ShallowCopy(labelmap);
+    return true;
+    }
+  return vtkOrientedImageDataResample::ExtractLabel(labelmap, segment->GetLabelValue(), binaryLabelmap);
+}
+
+//-----------------------------------------------------------------------------
+void vtkSegmentation::GetLayerDataObjects(std::vector<vtkDataObject*>& layerDataObjects)
+{
+  layerDataObjects.clear();
+  std::set<vtkDataObject*> foundLayerDataObjects;
+  for (std::deque< std::string >::iterator segmentIdIt = this->SegmentIds.begin(); segmentIdIt != this->SegmentIds.end(); ++segmentIdIt)
+    {
+    vtkDataObject* labelmap = this->Segments[*segmentIdIt]->GetRepresentation(
+      vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+    if (labelmap && foundLayerDataObjects.insert(labelmap).second)
+      {
+      layerDataObjects.push_back(labelmap);
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+int vtkSegmentation::GetNumberOfLayers()
+{
+  std::vector<vtkDataObject*> layerDataObjects;
+  this->GetLayerDataObjects(layerDataObjects);
+  return static_cast<int>(layerDataObjects.size());
+}
+
+//-----------------------------------------------------------------------------
+int vtkSegmentation::GetLayerIndex(std::string segmentId)
+{
+  vtkSegment* segment = this->GetSegment(segmentId);
+  if (!segment)
+    {
+    return -1;
+    }
+  vtkDataObject* labelmap = segment->GetRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+  std::vector<vtkDataObject*> layerDataObjects;
+  this->GetLayerDataObjects(layerDataObjects);
+  std::vector<vtkDataObject*>::iterator layerIt = std::find(layerDataObjects.begin(), layerDataObjects.end(), labelmap);
+  if (!labelmap || layerIt == layerDataObjects.end())
+    {
+    return -1;
+    }
+  return static_cast<int>(layerIt - layerDataObjects.begin());
+}
+
+//-----------------------------------------------------------------------------
+vtkDataObject* vtkSegmentation::GetLayerDataObject(int layer)
+{
+  std::vector<vtkDataObject*> layerDataObjects;
+  this->GetLayerDataObjects(layerDataObjects);
+  if (layer < 0 || layer >= static_cast<int>(layerDataObjects.size()))
+    {
+    return NULL;
+    }
+  return layerDataObjects[layer];
+}
+
+//-----------------------------------------------------------------------------
+void vtkSegmentation::GetSegmentIDsForLayer(int layer, std::vector<std::string>& segmentIds)
+{
+  segmentIds.clear();
+  vtkDataObject* layerDataObject = this->GetLayerDataObject(layer);
+  if (!layerDataObject)
+    {
+    return;
+    }
+  for (std::deque< std::string >::iterator segmentIdIt = this->SegmentIds.begin(); segmentIdIt != this->SegmentIds.end(); ++segmentIdIt)
+    {
+    if (this->Segments[*segmentIdIt]->GetRepresentation(
+      vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()) == layerDataObject)
+      {
+      segmentIds.push_back(*segmentIdIt);
+      }
+    }
+}
+
 //-----------------------------------------------------------------------------
 std::string vtkSegmentation::DetermineCommonLabelmapGeometry(int extentComputationMode, vtkStringArray* segmentIds)
 {
@@ -1555,7 +2272,7 @@ bool vtkSegmentation::SetImageGeometryFromCommonLabelmapGeometry(vtkOrientedImag
 }
 
 //----------------------------------------------------------------------------
-bool vtkSegmentation::ConvertSingleSegment(std::string segmentId, std::string targetRepresentationName)
+bool vtkSegmentation::ConvertSingleSegment(std::string segmentId, std::string targetRepresentationName, const int* modifiedExtent/*=NULL*/)
 {
   vtkSegment* segment = this->GetSegment(segmentId);
   if (!segment)
@@ -1574,6 +2291,20 @@ bool vtkSegmentation::ConvertSingleSegment(std::string segmentId, std::string ta
     return false;
     }
 
+  // Update only the modified region if the target is directly converted from the master representation
+  vtkDataObject* targetRepresentation = segment->GetRepresentation(targetRepresentationName);
+  if (modifiedExtent && cheapestPath.size() == 1 && targetRepresentation
+    && segment->GetLabelValue() == 1 && !this->IsSharedBinaryLabelmap(segment))
+    {
+    vtkSegmentationConverterRule* rule = cheapestPath.front();
+    if (!rule->ConvertModifiedExtent(segment->GetRepresentation(this->MasterRepresentationName), targetRepresentation, modifiedExtent))
+      {
+      vtkErrorMacro("ConvertSingleSegment: Conversion failed!");
+      return false;
+      }
+    return true;
+    }
+
   // Perform conversion (overwrite if exists)
   if (!this->ConvertSegmentUsingPath(segment, cheapestPath, true))
     {
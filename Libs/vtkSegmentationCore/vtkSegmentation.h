@@ -69,6 +69,10 @@ class vtkStringArray;
 ///       * All conversions use it as source (up-to-date representations along conversion path are used if available)
 ///       * When changed all other representations are invalidated (and is re-converted later from master)
 ///       * It is the representation that is saved to disk
+///   * Shared labelmaps
+///     * Binary labelmap master representations of non-overlapping segments can be packed into one image (layer),
+///       each segment having its own label value (\sa CollapseBinaryLabelmaps)
+///     * Segments stored in a shared labelmap are separated before they are edited (\sa SeparateSegmentLabelmap)
 ///
 ///  Schematic illustration of the segmentation container:
 ///
@@ -302,6 +306,45 @@ public:
   /// Invalidate (remove) non-master representations in all the segments if this segmentation node
   void InvalidateNonMasterRepresentations();
 
+// Shared labelmap related methods
+
+  /// Pack the binary labelmap master representation of all segments into as few shared labelmaps (layers)
+  /// as possible. Segments that do not overlap are stored in the same layer, each with a different label value
+  /// (\sa vtkSegment::GetLabelValue), so memory usage scales with the number of voxels instead of
+  /// the number of segments. Layers are allocated in the common labelmap geometry of the segmentation.
+  /// \param forceToSingleLayer If true then all segments are stored in one layer. Where segments overlap,
+  ///   the voxel is assigned to the segment that is later in the segment list.
+  /// \return Success flag
+  bool CollapseBinaryLabelmaps(bool forceToSingleLayer=false);
+
+  /// Give a segment its own binary labelmap (with label value 1) if it is stored in a shared labelmap.
+  /// Voxels of the segment are removed from the shared labelmap.
+  /// Must be called before modifying the binary labelmap of a segment in-place.
+  /// \return Success flag
+  bool SeparateSegmentLabelmap(std::string segmentId);
+
+  /// Determine if the binary labelmap representation of a segment is shared with other segments
+  bool IsSharedBinaryLabelmap(std::string segmentId);
+
+  /// Get binary labelmap of a segment, containing 1 inside the segment and 0 elsewhere.
+  /// If the labelmap of the segment is shared then voxels of the segment are extracted,
+  /// otherwise the output is a shallow copy of the binary labelmap representation.
+  /// \return Success flag
+  bool GetSegmentBinaryLabelmap(std::string segmentId, vtkOrientedImageData* binaryLabelmap);
+
+  /// Get number of distinct binary labelmap data objects. A segment that is not stored in a shared labelmap
+  /// is a layer in itself.
+  int GetNumberOfLayers();
+
+  /// Get index of the layer that stores the binary labelmap of a segment. Returns -1 if not found.
+  int GetLayerIndex(std::string segmentId);
+
+  /// Get binary labelmap data object of a layer
+  vtkDataObject* GetLayerDataObject(int layer);
+
+  /// Get IDs of segments that are stored in a layer
+  void GetSegmentIDsForLayer(int layer, std::vector<std::string>& segmentIds);
+
 // Conversion related methods
 
   /// Create a representation in all segments, using the conversion path with the
@@ -314,6 +357,8 @@ public:
   /// \param targetRepresentationName Name of the representation to create
   /// \param alwaysConvert If true, then conversion takes place even if target representation exists. False by default.
   /// \return true on success
+  /// vtkCommand::ProgressEvent is invoked after each converted segment with the fraction of converted segments (double*)
+  /// as call data. Segments are converted concurrently if enabled (\sa SetNumberOfConversionThreads).
   bool CreateRepresentation(const std::string& targetRepresentationName, bool alwaysConvert=false);
 
   /// Generate or update a representation in all segments, using the specified conversion
@@ -369,6 +414,21 @@ public:
 
 // Get/set methods
 
+  /// Number of threads used for converting segments in \sa CreateRepresentation.
+  /// 1 (default) means segments are converted one by one, 0 means that the number of threads
+  /// is the default of vtkMultiThreader (number of processors).
+  /// Segments are only converted concurrently if all rules of the conversion path are thread-safe
+  /// (\sa vtkSegmentationConverterRule::IsThreadSafe).
+  vtkSetMacro(NumberOfConversionThreads, int);
+  vtkGetMacro(NumberOfConversionThreads, int);
+
+  /// Maximum amount of memory (in kiB) that concurrent segment conversions may use.
+  /// Memory need of a segment conversion is estimated from the size of its source representation.
+  /// Conversion of a segment is postponed until running conversions release enough memory,
+  /// but at least one segment is always converted. 0 (default) means no limit.
+  vtkSetMacro(MaximumConversionMemorySize, unsigned long);
+  vtkGetMacro(MaximumConversionMemorySize, unsigned long);
+
   /// Get master representation name
   vtkGetMacro(MasterRepresentationName, std::string);
   /// Set master representation name.
@@ -385,13 +445,35 @@ protected:
   /// \return Success flag
   bool ConvertSegmentUsingPath(vtkSegment* segment, vtkSegmentationConverter::ConversionPathType path, bool overwriteExisting=false);
 
+  /// Convert segments along a specified path. Segments are converted concurrently if
+  /// enabled and supported by the rules, and vtkCommand::ProgressEvent is invoked after each segment.
+  /// Representations are added to the segments on the calling thread.
+  /// \sa ConvertSegmentUsingPath
+  bool ConvertSegmentsUsingPath(std::vector<vtkSegment*>& segments, vtkSegmentationConverter::ConversionPathType path, bool overwriteExisting=false);
+
   /// Converts a single segment to a representation.
-  bool ConvertSingleSegment(std::string segmentId, std::string targetRepresentationName);
+  /// \param modifiedExtent If specified then the master representation is only modified within this extent
+  ///   since the last conversion, and the target representation is updated only in the affected region if the
+  ///   conversion rule supports it (\sa vtkSegmentationConverterRule::ConvertModifiedExtent)
+  bool ConvertSingleSegment(std::string segmentId, std::string targetRepresentationName, const int* modifiedExtent=NULL);
 
   /// Remove segment by iterator. The two \sa RemoveSegment methods call this function after
   /// finding the iterator based on their different input arguments.
+  /// If the labelmap of the segment is shared then the removed segment gets its own labelmap.
   void RemoveSegment(SegmentMap::iterator segmentIt);
 
+  /// Determine if the binary labelmap representation of a segment is shared with other segments in this segmentation
+  bool IsSharedBinaryLabelmap(vtkSegment* segment);
+
+  /// Get binary labelmap of a segment, extracting the voxels of the segment if its labelmap is shared
+  bool GetSegmentBinaryLabelmap(vtkSegment* segment, vtkOrientedImageData* binaryLabelmap);
+
+  /// Get distinct binary labelmap data objects of the segments, in segment order
+  void GetLayerDataObjects(std::vector<vtkDataObject*>& layerDataObjects);
+
+  /// Get number of segments that store their binary labelmap in the given data object
+  int GetNumberOfSegmentsInLayer(vtkDataObject* layerDataObject);
+
   /// Temporarily enable/disable master representation modified event.
   /// \return Old value of MasterRepresentationModifiedEnabled.
   /// In general, the old value should be restored after modified is temporarily disabled to ensure proper
@@ -431,9 +513,21 @@ protected:
   /// Command handling master representation modified events
   vtkCallbackCommand* MasterRepresentationCallbackCommand;
 
+  /// Number of segments that store their binary labelmap in each data object.
+  /// Computed on demand and invalidated when a segment is added, removed or modified,
+  /// so that \sa IsSharedBinaryLabelmap does not need to visit all segments.
+  std::map<vtkDataObject*, int> LayerSegmentCounts;
+  bool LayerSegmentCountsValid;
+
   /// Modified events of  master representations are observed
   bool MasterRepresentationModifiedEnabled;
 
+  /// Number of threads used for converting segments. \sa SetNumberOfConversionThreads
+  int NumberOfConversionThreads;
+
+  /// Memory limit of concurrent segment conversions in kiB. \sa SetMaximumConversionMemorySize
+  unsigned long MaximumConversionMemorySize;
+
   /// This number is incremented and used for generating the next
   /// segment ID.
   int SegmentIdAutogeneratorIndex;
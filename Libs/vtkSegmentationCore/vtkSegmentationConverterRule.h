@@ -83,6 +83,15 @@ public:
   /// Update the target representation based on the source representation
   virtual bool Convert(vtkDataObject* sourceRepresentation, vtkDataObject* targetRepresentation) = 0;
 
+  /// Update the target representation after the source representation has been modified only within an extent
+  /// (IJK extent of the source for image data representations). Rules that can update only the affected part of
+  /// the target representation should override this method. The default implementation performs full conversion.
+  virtual bool ConvertModifiedExtent(vtkDataObject* sourceRepresentation, vtkDataObject* targetRepresentation, const int modifiedExtent[6])
+    {
+    (void)(modifiedExtent); // unused
+    return this->Convert(sourceRepresentation, targetRepresentation);
+    };
+
   /// Get the cost of the conversion.
   /// \return Expected duration of the conversion in milliseconds. If the arguments are omitted, then a rough average can be
   ///   given just to indicate the relative computational cost of the algorithm. If the objects are given, then a more educated
@@ -94,6 +103,11 @@ public:
     return 100;
     };
 
+  /// Determine if \sa Convert can be called from multiple threads at the same time (with different
+  /// source and target representations). Rules that store conversion state in member variables must
+  /// return false, which is the default.
+  virtual bool IsThreadSafe() { return false; };
+
   /// Human-readable name of the converter rule
   virtual const char* GetName() = 0;
 
@@ -22,11 +22,102 @@
 #include "vtkSegmentationHistory.h"
 #include "vtkSegmentationConverterFactory.h"
 #include "vtkSegmentation.h"
+#include "vtkOrientedImageData.h"
+#include "vtkOrientedImageDataResample.h"
 
 // VTK includes
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkCallbackCommand.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPointData.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkZLibDataCompressor.h>
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+/// Get the extent where voxels of the image differ from the reference image.
+/// Voxels outside of the reference image extent are compared to 0.
+void GetLabelmapModifiedExtent(vtkOrientedImageData* image, vtkOrientedImageData* referenceImage, int modifiedExtent[6])
+{
+  int* extent = image->GetExtent();
+  int* referenceExtent = referenceImage->GetExtent();
+  for (int i = 0; i < 3; ++i)
+    {
+    modifiedExtent[i * 2] = extent[i * 2 + 1] + 1;
+    modifiedExtent[i * 2 + 1] = extent[i * 2] - 1;
+    }
+  const int voxelSize = image->GetScalarSize() * image->GetNumberOfScalarComponents();
+  const int rowLength = extent[1] - extent[0] + 1;
+  std::vector<char> zeroVoxel(voxelSize, 0);
+
+  // Part of the rows that is inside the reference image
+  const int referenceRowStart = std::max(extent[0], referenceExtent[0]);
+  const int referenceRowEnd = std::min(extent[1], referenceExtent[1]);
+
+  for (int k = extent[4]; k <= extent[5]; ++k)
+    {
+    for (int j = extent[2]; j <= extent[3]; ++j)
+      {
+      const char* row = static_cast<const char*>(image->GetScalarPointer(extent[0], j, k));
+      const char* referenceRow = NULL;
+      if (referenceRowStart <= referenceRowEnd
+        && j >= referenceExtent[2] && j <= referenceExtent[3] && k >= referenceExtent[4] && k <= referenceExtent[5])
+        {
+        referenceRow = static_cast<const char*>(referenceImage->GetScalarPointer(referenceRowStart, j, k));
+        if (referenceRowStart == extent[0] && referenceRowEnd == extent[1]
+          && memcmp(row, referenceRow, rowLength * voxelSize) == 0)
+          {
+          // most rows are not modified
+          continue;
+          }
+        }
+      for (int i = extent[0]; i <= extent[1]; ++i)
+        {
+        const char* referenceVoxel = &(zeroVoxel[0]);
+        if (referenceRow && i >= referenceRowStart && i <= referenceRowEnd)
+          {
+          referenceVoxel = referenceRow + (i - referenceRowStart) * voxelSize;
+          }
+        if (memcmp(row + (i - extent[0]) * voxelSize, referenceVoxel, voxelSize) == 0)
+          {
+          continue;
+          }
+        if (i < modifiedExtent[0]) { modifiedExtent[0] = i; }
+        if (i > modifiedExtent[1]) { modifiedExtent[1] = i; }
+        if (j < modifiedExtent[2]) { modifiedExtent[2] = j; }
+        if (j > modifiedExtent[3]) { modifiedExtent[3] = j; }
+        if (k < modifiedExtent[4]) { modifiedExtent[4] = k; }
+        if (k > modifiedExtent[5]) { modifiedExtent[5] = k; }
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+/// Copy voxels within the extent from source to target image.
+/// Images must have the same scalar type and must contain the extent.
+void CopyLabelmapRegion(vtkImageData* sourceImage, vtkImageData* targetImage, const int extent[6])
+{
+  const size_t rowSize = static_cast<size_t>(extent[1] - extent[0] + 1)
+    * sourceImage->GetScalarSize() * sourceImage->GetNumberOfScalarComponents();
+  for (int k = extent[4]; k <= extent[5]; ++k)
+    {
+    for (int j = extent[2]; j <= extent[3]; ++j)
+      {
+      memcpy(targetImage->GetScalarPointer(extent[0], j, k), sourceImage->GetScalarPointer(extent[0], j, k), rowSize);
+      }
+    }
+}
+
+} // end of anonymous namespace
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSegmentationHistory);
@@ -37,6 +128,7 @@ vtkSegmentationHistory::vtkSegmentationHistory()
   this->Segmentation = NULL;
 
   this->MaximumNumberOfStates = 5;
+  this->MaximumMemorySizeInBytes = 0;
 
   this->LastRestoredState = 0;
   this->RestoreStateInProgress = false;
@@ -95,6 +187,9 @@ void vtkSegmentationHistory::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "Modified Time: " << this->GetMTime() << "\n";
 
   os << indent << "Number of saved states:  " << this->SegmentationStates.size() << "\n";
+  os << indent << "Maximum number of states:  " << this->MaximumNumberOfStates << "\n";
+  os << indent << "Number of compressed labelmaps:  " << this->LabelmapDeltas.size() << "\n";
+  os << indent << "Maximum memory size:  " << this->MaximumMemorySizeInBytes << " bytes\n";
 }
 
 //---------------------------------------------------------------------------
@@ -115,10 +210,12 @@ bool vtkSegmentationHistory::SaveState()
   this->RemoveAllNextStates();
 
   SegmentationState newSegmentationState;
+  newSegmentationState.SaveTime.Modified();
 
   std::vector<std::string> segmentIDs;
   this->Segmentation->GetSegmentIDs(segmentIDs);
   newSegmentationState.SegmentIds = segmentIDs;
+  std::map<vtkDataObject*, vtkSmartPointer<vtkDataObject> > copiedRepresentations;
   for (std::vector<std::string>::iterator segmentIDIt = segmentIDs.begin(); segmentIDIt != segmentIDs.end(); ++segmentIDIt)
     {
     vtkSegment* segment = this->Segmentation->GetSegment(*segmentIDIt);
@@ -130,8 +227,10 @@ bool vtkSegmentationHistory::SaveState()
     // Previous saved state of the segment
     // (if the new state has exactly the same representation then only a shallow copy will be made)
     vtkSegment* baselineSegment = NULL;
+    vtkMTimeType baselineTime = 0;
     if (this->SegmentationStates.size() > 0)
       {
+      baselineTime = this->SegmentationStates.back().SaveTime.GetMTime();
       SegmentsMap::iterator baselineSegmentIt = this->SegmentationStates.back().Segments.find(*segmentIDIt);
       if (baselineSegmentIt != this->SegmentationStates.back().Segments.end())
         {
@@ -139,10 +238,15 @@ bool vtkSegmentationHistory::SaveState()
         }
       }
     vtkSmartPointer<vtkSegment> segmentClone = vtkSmartPointer<vtkSegment>::New();
-    CopySegment(segmentClone, segment, baselineSegment);
+    CopySegment(segmentClone, segment, baselineSegment, baselineTime, copiedRepresentations);
     newSegmentationState.Segments[*segmentIDIt] = segmentClone;
     }
   this->SegmentationStates.push_back(newSegmentationState);
+  if (this->SegmentationStates.size() > 1)
+    {
+    // Previous state is no longer the most recent one, only store its difference from this state
+    this->CompressState(this->SegmentationStates.size() - 2);
+    }
 
   // Set the current state as last restored state
   this->LastRestoredState = this->SegmentationStates.size();
@@ -153,7 +257,8 @@ bool vtkSegmentationHistory::SaveState()
 }
 
 //---------------------------------------------------------------------------
-void vtkSegmentationHistory::CopySegment(vtkSegment* destination, vtkSegment* source, vtkSegment* baseline)
+void vtkSegmentationHistory::CopySegment(vtkSegment* destination, vtkSegment* source, vtkSegment* baseline, vtkMTimeType baselineTime,
+  std::map<vtkDataObject*, vtkSmartPointer<vtkDataObject> >& copiedRepresentations)
 {
   destination->RemoveAllRepresentations();
   destination->DeepCopyMetadata(source);
@@ -165,17 +270,27 @@ void vtkSegmentationHistory::CopySegment(vtkSegment* destination, vtkSegment* so
     representationNameIt != representationNames.end(); ++representationNameIt)
     {
     vtkDataObject* sourceRepresentation = source->GetRepresentation(*representationNameIt);
+    std::map<vtkDataObject*, vtkSmartPointer<vtkDataObject> >::iterator copiedIt = copiedRepresentations.find(sourceRepresentation);
+    if (copiedIt != copiedRepresentations.end())
+      {
+      // representation is shared with a segment that has already been copied
+      destination->AddRepresentation(*representationNameIt, copiedIt->second);
+      continue;
+      }
     vtkDataObject* baselineRepresentation = NULL;
     if (baseline)
       {
       baselineRepresentation = baseline->GetRepresentation(*representationNameIt);
       }
-    // Shallow-copy from baseline if it's up-to-date, otherwise deep-copy from source
+    // Shallow-copy from baseline if it's up-to-date, otherwise deep-copy from source.
+    // Save time of the baseline is used instead of the MTime of the baseline representation,
+    // because the representation is modified when it is decompressed.
     if (baselineRepresentation != NULL
-      && baselineRepresentation->GetMTime() > sourceRepresentation->GetMTime())
+      && baselineTime > sourceRepresentation->GetMTime())
       {
       // we already have an up-to-date copy in the baseline, so reuse that
       destination->AddRepresentation(*representationNameIt, baselineRepresentation);
+      copiedRepresentations[sourceRepresentation] = baselineRepresentation;
       }
     else
       {
@@ -188,6 +303,7 @@ void vtkSegmentationHistory::CopySegment(vtkSegment* destination, vtkSegment* so
         }
       representationCopy->DeepCopy(sourceRepresentation);
       destination->AddRepresentation(*representationNameIt, representationCopy);
+      copiedRepresentations[sourceRepresentation] = representationCopy;
       representationCopy->Delete(); // this representation is now owned by the segment
       }
     }
@@ -248,6 +364,34 @@ bool vtkSegmentationHistory::RestoreState(unsigned int stateIndex)
   SegmentationState restoredState = this->SegmentationStates[stateIndex];
 
   std::set<std::string> segmentIDsToKeep;
+  std::map<vtkDataObject*, vtkSmartPointer<vtkDataObject> > restoredRepresentations;
+
+  // Compressed labelmaps are reconstructed into new images that the segments can use directly
+  for (SegmentsMap::iterator restoredSegmentsIt = restoredState.Segments.begin();
+    restoredSegmentsIt != restoredState.Segments.end(); ++restoredSegmentsIt)
+    {
+    std::vector<std::string> representationNames;
+    restoredSegmentsIt->second->GetContainedRepresentationNames(representationNames);
+    for (std::vector<std::string>::iterator representationNameIt = representationNames.begin();
+      representationNameIt != representationNames.end(); ++representationNameIt)
+      {
+      vtkOrientedImageData* image = vtkOrientedImageData::SafeDownCast(
+        restoredSegmentsIt->second->GetRepresentation(*representationNameIt));
+      if (!image || this->LabelmapDeltas.find(image) == this->LabelmapDeltas.end()
+        || restoredRepresentations.find(image) != restoredRepresentations.end())
+        {
+        continue;
+        }
+      vtkSmartPointer<vtkOrientedImageData> restoredImage = vtkSmartPointer<vtkOrientedImageData>::New();
+      if (!this->GetStateImage(image, restoredImage))
+        {
+        vtkErrorMacro("RestoreState: Failed to decompress binary labelmap of segment " << restoredSegmentsIt->first);
+        continue;
+        }
+      restoredRepresentations[image] = restoredImage;
+      }
+    }
+
   for (SegmentsMap::iterator restoredSegmentsIt = restoredState.Segments.begin();
     restoredSegmentsIt != restoredState.Segments.end(); ++restoredSegmentsIt)
     {
@@ -255,13 +399,13 @@ bool vtkSegmentationHistory::RestoreState(unsigned int stateIndex)
     vtkSegment* segment = this->Segmentation->GetSegment(restoredSegmentsIt->first);
     if (segment != NULL)
       {
-      segment->DeepCopy(restoredSegmentsIt->second);
+      segment->DeepCopy(restoredSegmentsIt->second, restoredRepresentations);
       segment->Modified();
       }
     else
       {
       vtkSmartPointer<vtkSegment> newSegment = vtkSmartPointer<vtkSegment>::New();
-      newSegment->DeepCopy(restoredSegmentsIt->second);
+      newSegment->DeepCopy(restoredSegmentsIt->second, restoredRepresentations);
       this->Segmentation->AddSegment(newSegment);
       }
     }
@@ -311,6 +455,11 @@ bool vtkSegmentationHistory::IsRestoreNextStateAvailable()
 void vtkSegmentationHistory::RemoveAllNextStates()
 {
   bool modified = false;
+  if (this->SegmentationStates.size() > this->LastRestoredState + 1)
+    {
+    // Differences of the last restored state are computed from states that are about to be removed
+    this->DecompressState(this->LastRestoredState);
+    }
   while ((this->SegmentationStates.size() > this->LastRestoredState + 1) && (!this->SegmentationStates.empty()))
     {
     this->SegmentationStates.pop_back();
@@ -318,6 +467,7 @@ void vtkSegmentationHistory::RemoveAllNextStates()
     }
   if (modified)
     {
+    this->RemoveUnusedLabelmapDeltas();
     this->Modified();
     }
 }
@@ -332,6 +482,19 @@ void vtkSegmentationHistory::RemoveAllObsoleteStates()
     this->LastRestoredState--;
     modified = true;
    }
+  if (modified)
+    {
+    this->RemoveUnusedLabelmapDeltas();
+    }
+  // Differences are computed from newer states, therefore removing the oldest state only releases its own data
+  while (this->MaximumMemorySizeInBytes > 0 && this->SegmentationStates.size() > 1 && this->LastRestoredState > 0
+    && this->GetMemorySizeInBytes() > this->MaximumMemorySizeInBytes)
+    {
+    this->SegmentationStates.pop_front();
+    this->LastRestoredState--;
+    this->RemoveUnusedLabelmapDeltas();
+    modified = true;
+    }
   if (modified)
     {
     this->Modified();
@@ -350,6 +513,294 @@ void vtkSegmentationHistory::SetMaximumNumberOfStates(unsigned int maximumNumber
   this->Modified();
 }
 
+//---------------------------------------------------------------------------
+void vtkSegmentationHistory::SetMaximumMemorySizeInBytes(vtkTypeUInt64 maximumMemorySizeInBytes)
+{
+  if (maximumMemorySizeInBytes == this->MaximumMemorySizeInBytes)
+    {
+    return;
+    }
+  this->MaximumMemorySizeInBytes = maximumMemorySizeInBytes;
+  this->RemoveAllObsoleteStates();
+  this->Modified();
+}
+
+//---------------------------------------------------------------------------
+vtkTypeUInt64 vtkSegmentationHistory::GetMemorySizeInBytes()
+{
+  // Representations may be shared between states and segments, count each only once
+  std::set<vtkDataObject*> representations;
+  for (std::deque<SegmentationState>::iterator stateIt = this->SegmentationStates.begin();
+    stateIt != this->SegmentationStates.end(); ++stateIt)
+    {
+    for (SegmentsMap::iterator segmentIt = stateIt->Segments.begin(); segmentIt != stateIt->Segments.end(); ++segmentIt)
+      {
+      std::vector<std::string> representationNames;
+      segmentIt->second->GetContainedRepresentationNames(representationNames);
+      for (std::vector<std::string>::iterator representationNameIt = representationNames.begin();
+        representationNameIt != representationNames.end(); ++representationNameIt)
+        {
+        representations.insert(segmentIt->second->GetRepresentation(*representationNameIt));
+        }
+      }
+    }
+  vtkTypeUInt64 memorySizeInBytes = 0;
+  for (std::set<vtkDataObject*>::iterator representationIt = representations.begin();
+    representationIt != representations.end(); ++representationIt)
+    {
+    if (*representationIt)
+      {
+      // data objects only report their size in kiB
+      memorySizeInBytes += static_cast<vtkTypeUInt64>((*representationIt)->GetActualMemorySize()) * 1024;
+      }
+    }
+  for (LabelmapDeltaMap::iterator deltaIt = this->LabelmapDeltas.begin(); deltaIt != this->LabelmapDeltas.end(); ++deltaIt)
+    {
+    if (deltaIt->second.CompressedScalars)
+      {
+      // compressed scalars are squeezed, their size is the exact number of allocated bytes
+      memorySizeInBytes += static_cast<vtkTypeUInt64>(deltaIt->second.CompressedScalars->GetSize());
+      }
+    }
+  return memorySizeInBytes;
+}
+
+//---------------------------------------------------------------------------
+void vtkSegmentationHistory::CompressState(unsigned int stateIndex)
+{
+  if (stateIndex + 1 >= this->SegmentationStates.size())
+    {
+    // The most recent state is always stored fully
+    return;
+    }
+  SegmentationState& state = this->SegmentationStates[stateIndex];
+  SegmentationState& nextState = this->SegmentationStates[stateIndex + 1];
+
+  // Representations that are shared with the next state are not changed
+  std::set<vtkDataObject*> nextStateRepresentations;
+  for (SegmentsMap::iterator segmentIt = nextState.Segments.begin(); segmentIt != nextState.Segments.end(); ++segmentIt)
+    {
+    std::vector<std::string> representationNames;
+    segmentIt->second->GetContainedRepresentationNames(representationNames);
+    for (std::vector<std::string>::iterator representationNameIt = representationNames.begin();
+      representationNameIt != representationNames.end(); ++representationNameIt)
+      {
+      nextStateRepresentations.insert(segmentIt->second->GetRepresentation(*representationNameIt));
+      }
+    }
+
+  vtkNew<vtkZLibDataCompressor> compressor;
+  compressor->SetCompressionLevel(1); // corresponds to Z_BEST_SPEED
+  for (SegmentsMap::iterator segmentIt = state.Segments.begin(); segmentIt != state.Segments.end(); ++segmentIt)
+    {
+    SegmentsMap::iterator nextSegmentIt = nextState.Segments.find(segmentIt->first);
+    if (nextSegmentIt == nextState.Segments.end())
+      {
+      // segment is removed in the next state, there is nothing to compute the difference from
+      continue;
+      }
+    std::vector<std::string> representationNames;
+    segmentIt->second->GetContainedRepresentationNames(representationNames);
+    for (std::vector<std::string>::iterator representationNameIt = representationNames.begin();
+      representationNameIt != representationNames.end(); ++representationNameIt)
+      {
+      vtkOrientedImageData* image = vtkOrientedImageData::SafeDownCast(segmentIt->second->GetRepresentation(*representationNameIt));
+      vtkOrientedImageData* nextImage = vtkOrientedImageData::SafeDownCast(nextSegmentIt->second->GetRepresentation(*representationNameIt));
+      if (!image || !nextImage || image->IsEmpty() || image->GetScalarPointer() == NULL || nextImage->GetScalarPointer() == NULL
+        || nextStateRepresentations.find(image) != nextStateRepresentations.end()
+        || this->LabelmapDeltas.find(image) != this->LabelmapDeltas.end())
+        {
+        continue;
+        }
+      if (image->GetScalarType() != nextImage->GetScalarType()
+        || image->GetNumberOfScalarComponents() != nextImage->GetNumberOfScalarComponents()
+        || !vtkOrientedImageDataResample::DoGeometriesMatch(image, nextImage))
+        {
+        // difference cannot be computed, keep full copy
+        continue;
+        }
+
+      LabelmapDelta delta;
+      delta.Image = image;
+      delta.NextImage = nextImage;
+      delta.ScalarType = image->GetScalarType();
+      delta.NumberOfScalarComponents = image->GetNumberOfScalarComponents();
+      GetLabelmapModifiedExtent(image, nextImage, delta.ModifiedExtent);
+      if (delta.ModifiedExtent[0] <= delta.ModifiedExtent[1]
+        && delta.ModifiedExtent[2] <= delta.ModifiedExtent[3]
+        && delta.ModifiedExtent[4] <= delta.ModifiedExtent[5])
+        {
+        vtkNew<vtkImageData> modifiedRegion;
+        modifiedRegion->SetExtent(delta.ModifiedExtent);
+        modifiedRegion->AllocateScalars(delta.ScalarType, delta.NumberOfScalarComponents);
+        CopyLabelmapRegion(image, modifiedRegion.GetPointer(), delta.ModifiedExtent);
+        size_t modifiedRegionSize = static_cast<size_t>(modifiedRegion->GetNumberOfPoints())
+          * modifiedRegion->GetScalarSize() * delta.NumberOfScalarComponents;
+        vtkUnsignedCharArray* compressedScalars = compressor->Compress(
+          static_cast<unsigned char*>(modifiedRegion->GetScalarPointer()), modifiedRegionSize);
+        if (!compressedScalars)
+          {
+          // failed to compress, keep full copy
+          continue;
+          }
+        // The compressor allocates a buffer of uncompressed size, release the unused part
+        compressedScalars->Squeeze();
+        delta.CompressedScalars = vtkSmartPointer<vtkUnsignedCharArray>::Take(compressedScalars);
+        }
+
+      // Release full copy of the voxels, extent and geometry is kept in the image
+      image->GetPointData()->Initialize();
+      this->LabelmapDeltas[image] = delta;
+      }
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSegmentationHistory::DecompressState(unsigned int stateIndex)
+{
+  if (stateIndex >= this->SegmentationStates.size())
+    {
+    return;
+    }
+  SegmentationState& state = this->SegmentationStates[stateIndex];
+  for (SegmentsMap::iterator segmentIt = state.Segments.begin(); segmentIt != state.Segments.end(); ++segmentIt)
+    {
+    std::vector<std::string> representationNames;
+    segmentIt->second->GetContainedRepresentationNames(representationNames);
+    for (std::vector<std::string>::iterator representationNameIt = representationNames.begin();
+      representationNameIt != representationNames.end(); ++representationNameIt)
+      {
+      vtkOrientedImageData* image = vtkOrientedImageData::SafeDownCast(segmentIt->second->GetRepresentation(*representationNameIt));
+      if (!image || this->LabelmapDeltas.find(image) == this->LabelmapDeltas.end())
+        {
+        continue;
+        }
+      vtkNew<vtkOrientedImageData> decompressedImage;
+      if (!this->GetStateImage(image, decompressedImage.GetPointer()))
+        {
+        vtkErrorMacro("DecompressState: Failed to decompress binary labelmap of segment " << segmentIt->first);
+        continue;
+        }
+      image->DeepCopy(decompressedImage.GetPointer());
+      this->LabelmapDeltas.erase(image);
+      }
+    }
+}
+
+//---------------------------------------------------------------------------
+bool vtkSegmentationHistory::GetStateImage(vtkOrientedImageData* image, vtkOrientedImageData* outputImage)
+{
+  if (!image || !outputImage)
+    {
+    return false;
+    }
+
+  // Collect differences from the requested labelmap up to the first fully stored labelmap
+  std::vector<LabelmapDelta*> deltas;
+  vtkOrientedImageData* fullImage = image;
+  for (LabelmapDeltaMap::iterator deltaIt = this->LabelmapDeltas.find(fullImage);
+    deltaIt != this->LabelmapDeltas.end(); deltaIt = this->LabelmapDeltas.find(fullImage))
+    {
+    deltas.push_back(&(deltaIt->second));
+    fullImage = deltaIt->second.NextImage;
+    if (!fullImage)
+      {
+      vtkErrorMacro("GetStateImage: Invalid binary labelmap difference");
+      return false;
+      }
+    }
+  outputImage->DeepCopy(fullImage);
+
+  // Apply differences backwards from the most recent state. Only a single labelmap is kept in memory,
+  // another one is only needed temporarily if the extent is changed between states.
+  vtkNew<vtkZLibDataCompressor> compressor;
+  for (std::vector<LabelmapDelta*>::reverse_iterator deltaIt = deltas.rbegin(); deltaIt != deltas.rend(); ++deltaIt)
+    {
+    LabelmapDelta& delta = *(*deltaIt);
+    int* extent = delta.Image->GetExtent();
+    int* nextExtent = outputImage->GetExtent();
+    if (extent[0] != nextExtent[0] || extent[1] != nextExtent[1] || extent[2] != nextExtent[2]
+      || extent[3] != nextExtent[3] || extent[4] != nextExtent[4] || extent[5] != nextExtent[5])
+      {
+      // Scalar type is the same in all states, differences are only computed between matching labelmaps
+      vtkNew<vtkOrientedImageData> resizedImage;
+      resizedImage->SetExtent(extent);
+      resizedImage->AllocateScalars(delta.ScalarType, delta.NumberOfScalarComponents);
+      vtkOrientedImageDataResample::FillImage(resizedImage.GetPointer(), 0.0);
+
+      // Unmodified voxels are the same as in the next labelmap
+      int commonExtent[6] = { 0, -1, 0, -1, 0, -1 };
+      for (int i = 0; i < 3; ++i)
+        {
+        commonExtent[i * 2] = std::max(extent[i * 2], nextExtent[i * 2]);
+        commonExtent[i * 2 + 1] = std::min(extent[i * 2 + 1], nextExtent[i * 2 + 1]);
+        }
+      if (commonExtent[0] <= commonExtent[1] && commonExtent[2] <= commonExtent[3] && commonExtent[4] <= commonExtent[5])
+        {
+        CopyLabelmapRegion(outputImage, resizedImage.GetPointer(), commonExtent);
+        }
+      // Release the previous labelmap, outputImage references the resized voxels from now on
+      outputImage->GetPointData()->Initialize();
+      outputImage->SetExtent(extent);
+      outputImage->GetPointData()->ShallowCopy(resizedImage->GetPointData());
+      }
+
+    // Modified voxels are stored in the difference
+    if (delta.CompressedScalars)
+      {
+      vtkNew<vtkImageData> modifiedRegion;
+      modifiedRegion->SetExtent(delta.ModifiedExtent);
+      modifiedRegion->AllocateScalars(delta.ScalarType, delta.NumberOfScalarComponents);
+      size_t modifiedRegionSize = static_cast<size_t>(modifiedRegion->GetNumberOfPoints())
+        * modifiedRegion->GetScalarSize() * delta.NumberOfScalarComponents;
+      if (compressor->Uncompress(delta.CompressedScalars->GetPointer(0), delta.CompressedScalars->GetNumberOfTuples(),
+        static_cast<unsigned char*>(modifiedRegion->GetScalarPointer()), modifiedRegionSize) != modifiedRegionSize)
+        {
+        vtkErrorMacro("GetStateImage: Failed to uncompress binary labelmap");
+        return false;
+        }
+      CopyLabelmapRegion(modifiedRegion.GetPointer(), outputImage, delta.ModifiedExtent);
+      }
+    }
+
+  vtkNew<vtkMatrix4x4> imageToWorldMatrix;
+  image->GetImageToWorldMatrix(imageToWorldMatrix.GetPointer());
+  outputImage->SetImageToWorldMatrix(imageToWorldMatrix.GetPointer());
+  return true;
+}
+
+//---------------------------------------------------------------------------
+void vtkSegmentationHistory::RemoveUnusedLabelmapDeltas()
+{
+  std::set<vtkDataObject*> usedRepresentations;
+  for (std::deque<SegmentationState>::iterator stateIt = this->SegmentationStates.begin();
+    stateIt != this->SegmentationStates.end(); ++stateIt)
+    {
+    for (SegmentsMap::iterator segmentIt = stateIt->Segments.begin(); segmentIt != stateIt->Segments.end(); ++segmentIt)
+      {
+      std::vector<std::string> representationNames;
+      segmentIt->second->GetContainedRepresentationNames(representationNames);
+      for (std::vector<std::string>::iterator representationNameIt = representationNames.begin();
+        representationNameIt != representationNames.end(); ++representationNameIt)
+        {
+        usedRepresentations.insert(segmentIt->second->GetRepresentation(*representationNameIt));
+        }
+      }
+    }
+  for (LabelmapDeltaMap::iterator deltaIt = this->LabelmapDeltas.begin(); deltaIt != this->LabelmapDeltas.end();
+    /*upon deletion the increment is done already, so don't increment here*/)
+    {
+    if (usedRepresentations.find(deltaIt->first) == usedRepresentations.end())
+      {
+      LabelmapDeltaMap::iterator deltaItToRemove = deltaIt;
+      ++deltaIt;
+      this->LabelmapDeltas.erase(deltaItToRemove);
+      continue;
+      }
+    ++deltaIt;
+    }
+}
+
 //---------------------------------------------------------------------------
 void vtkSegmentationHistory::OnSegmentationModified(vtkObject* vtkNotUsed(caller),
   unsigned long vtkNotUsed(eid),
@@ -379,6 +830,7 @@ void vtkSegmentationHistory::OnSegmentationModified(vtkObject* vtkNotUsed(caller
 void vtkSegmentationHistory::RemoveAllStates()
 {
   this->SegmentationStates.clear();
+  this->LabelmapDeltas.clear();
   this->LastRestoredState = 0;
   this->Modified();
 }
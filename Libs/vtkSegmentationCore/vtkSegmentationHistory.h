@@ -24,6 +24,7 @@
 // VTK includes
 #include <vtkObject.h>
 #include <vtkSmartPointer.h>
+#include <vtkTimeStamp.h>
 
 // STD includes
 #include <deque>
@@ -33,10 +34,17 @@
 #include "vtkSegmentationCoreConfigure.h"
 
 class vtkCallbackCommand;
+class vtkDataObject;
+class vtkOrientedImageData;
 class vtkSegment;
 class vtkSegmentation;
+class vtkUnsignedCharArray;
 
 /// \ingroup SegmentationCore
+/// \brief Stores states of a segmentation for undo/redo.
+///   The most recent state contains full copy of the master representations. In older states,
+///   binary labelmaps are only stored as compressed difference from the next state,
+///   so the memory need of a state is proportional to the region that has been changed.
 class vtkSegmentationCore_EXPORT vtkSegmentationHistory : public vtkObject
 {
 public:
@@ -82,6 +90,17 @@ public:
   /// Get the limit of how many states may be stored.
   vtkGetMacro(MaximumNumberOfStates, unsigned int);
 
+  /// Limits how much memory (in bytes) stored states may use.
+  /// If the stored states use more memory then the oldest states are removed.
+  /// The most recent state is always kept. 0 (default) means no limit.
+  void SetMaximumMemorySizeInBytes(vtkTypeUInt64 maximumMemorySizeInBytes);
+
+  /// Get the limit of how much memory (in bytes) stored states may use.
+  vtkGetMacro(MaximumMemorySizeInBytes, vtkTypeUInt64);
+
+  /// Get the memory (in bytes) used by all the stored states.
+  vtkTypeUInt64 GetMemorySizeInBytes();
+
 protected:
   /// Callback function called when the segmentation has been modified.
   /// It clears all states that are more recent than the last restored state.
@@ -96,6 +115,21 @@ protected:
   /// Restores a state defined by stateIndex.
   bool RestoreState(unsigned int stateIndex);
 
+  /// Replace binary labelmaps of the state that are not used in the next state by their
+  /// difference from the next state
+  void CompressState(unsigned int stateIndex);
+
+  /// Restore full content of all compressed binary labelmaps of the state.
+  /// Required before states that the differences are computed from are removed.
+  void DecompressState(unsigned int stateIndex);
+
+  /// Get full content of a binary labelmap stored in a state.
+  /// Differences are applied one after the other into outputImage, starting from the fully stored labelmap.
+  bool GetStateImage(vtkOrientedImageData* image, vtkOrientedImageData* outputImage);
+
+  /// Remove stored differences of binary labelmaps that are no longer used in any state
+  void RemoveUnusedLabelmapDeltas();
+
 protected:
   vtkSegmentationHistory();
   ~vtkSegmentationHistory();
@@ -103,7 +137,10 @@ protected:
 
   /// Deep copies source segment to destination segment. If the same representation is found in baseline
   /// with up-to-date timestamp then the representation is reused from baseline.
-  void CopySegment(vtkSegment* destination, vtkSegment* source, vtkSegment* baseline);
+  /// Representations that are already in copiedRepresentations (e.g., shared labelmaps) are not copied again.
+  /// \param baselineTime Time when baseline was saved
+  void CopySegment(vtkSegment* destination, vtkSegment* source, vtkSegment* baseline, vtkMTimeType baselineTime,
+    std::map<vtkDataObject*, vtkSmartPointer<vtkDataObject> >& copiedRepresentations);
 
 protected:  /// Container type for segments. Maps segment IDs to segment objects
   typedef std::map<std::string, vtkSmartPointer<vtkSegment> > SegmentsMap;
@@ -112,12 +149,33 @@ protected:  /// Container type for segments. Maps segment IDs to segment objects
     {
     SegmentsMap Segments;
     std::vector<std::string> SegmentIds; // order of segments
+    vtkTimeStamp SaveTime;
     };
 
+  /// Binary labelmap of a state, stored as difference from a labelmap of the next state
+  struct LabelmapDelta
+    {
+    /// Compressed labelmap. Its scalars are released, only its geometry and extent are kept.
+    vtkSmartPointer<vtkOrientedImageData> Image;
+    /// Labelmap that the difference is computed from
+    vtkSmartPointer<vtkOrientedImageData> NextImage;
+    int ScalarType;
+    int NumberOfScalarComponents;
+    /// Extent of the voxels that differ from NextImage (voxels outside NextImage are compared to 0)
+    int ModifiedExtent[6];
+    /// Compressed voxels of ModifiedExtent
+    vtkSmartPointer<vtkUnsignedCharArray> CompressedScalars;
+    };
+  typedef std::map<vtkOrientedImageData*, LabelmapDelta> LabelmapDeltaMap;
+
   vtkSegmentation* Segmentation;
   vtkCallbackCommand* SegmentationModifiedCallbackCommand;
   std::deque<SegmentationState> SegmentationStates;
   unsigned int MaximumNumberOfStates;
+  vtkTypeUInt64 MaximumMemorySizeInBytes;
+
+  /// Compressed binary labelmaps of all states
+  LabelmapDeltaMap LabelmapDeltas;
 
   // Index of the state in SegmentationStates that was restored last.
   // If index == size of states then it means that the segmentation has changed
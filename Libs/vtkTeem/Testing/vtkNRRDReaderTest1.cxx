@@ -0,0 +1,123 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// vtkTeem includes
+#include <vtkNRRDReader.h>
+#include <vtkNRRDWriter.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+
+// STD includes
+#include <cstring>
+#include <string>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+bool TestMemoryMappedRead(const std::string& fileName, vtkImageData* image, bool compressed)
+{
+  vtkNew<vtkNRRDWriter> writer;
+  writer->SetFileName(fileName.c_str());
+  writer->SetInputData(image);
+  writer->SetUseCompression(compressed ? 1 : 0);
+  writer->Write();
+  if (writer->GetWriteError())
+    {
+    std::cerr << __LINE__ << ": Failed to write " << fileName << std::endl;
+    return false;
+    }
+  vtkIdType numberOfBytes = image->GetNumberOfPoints() * sizeof(short);
+
+  vtkNew<vtkNRRDReader> reader;
+  reader->SetFileName(fileName.c_str());
+  reader->SetUseMemoryMapping(true);
+  reader->Update();
+  vtkImageData* readImage = reader->GetOutput();
+  if (reader->GetReadStatus() != 0 || readImage->GetNumberOfPoints() != image->GetNumberOfPoints())
+    {
+    std::cerr << __LINE__ << ": Failed to read " << fileName << std::endl;
+    return false;
+    }
+#ifndef _WIN32
+  // Only uncompressed files are mapped
+  if (reader->GetDataMemoryMapped() == compressed)
+    {
+    std::cerr << __LINE__ << ": Unexpected memory mapping of " << fileName
+              << ": " << reader->GetDataMemoryMapped() << std::endl;
+    return false;
+    }
+#endif
+  if (memcmp(readImage->GetScalarPointer(), image->GetScalarPointer(), numberOfBytes) != 0)
+    {
+    std::cerr << __LINE__ << ": Read voxels differ from written voxels in " << fileName << std::endl;
+    return false;
+    }
+
+  // Modifying the read voxels does not change the file
+  *static_cast<short*>(readImage->GetScalarPointer(1, 2, 3)) = -1;
+  vtkNew<vtkNRRDReader> reader2;
+  reader2->SetFileName(fileName.c_str());
+  reader2->Update();
+  if (memcmp(reader2->GetOutput()->GetScalarPointer(), image->GetScalarPointer(), numberOfBytes) != 0)
+    {
+    std::cerr << __LINE__ << ": File was modified by changing the mapped voxels " << fileName << std::endl;
+    return false;
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkNRRDReaderTest1(int argc, char* argv[])
+{
+  if (argc < 2)
+    {
+    std::cerr << "Usage: " << argv[0] << " /path/to/temp" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::string tempDir = argv[1];
+
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(30, 20, 10);
+  image->AllocateScalars(VTK_SHORT, 1);
+  short* voxels = static_cast<short*>(image->GetScalarPointer());
+  for (vtkIdType i = 0; i < image->GetNumberOfPoints(); ++i)
+    {
+    voxels[i] = static_cast<short>(i);
+    }
+
+  // Attached header
+  if (!TestMemoryMappedRead(tempDir + "/vtkNRRDReaderTest1.nrrd", image.GetPointer(), false))
+    {
+    return EXIT_FAILURE;
+    }
+  // Detached header
+  if (!TestMemoryMappedRead(tempDir + "/vtkNRRDReaderTest1.nhdr", image.GetPointer(), false))
+    {
+    return EXIT_FAILURE;
+    }
+  // Compressed files are read into memory
+  if (!TestMemoryMappedRead(tempDir + "/vtkNRRDReaderTest1Compressed.nrrd", image.GetPointer(), true))
+    {
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
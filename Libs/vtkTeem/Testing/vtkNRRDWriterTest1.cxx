@@ -0,0 +1,140 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// vtkTeem includes
+#include <vtkNRRDReader.h>
+#include <vtkNRRDWriter.h>
+
+// VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkCommand.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+
+// STD includes
+#include <cstring>
+#include <fstream>
+#include <string>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+void CountErrors(vtkObject* vtkNotUsed(caller), unsigned long vtkNotUsed(eid), void* clientData, void* vtkNotUsed(callData))
+{
+  ++(*static_cast<int*>(clientData));
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int vtkNRRDWriterTest1(int argc, char* argv[])
+{
+  if (argc < 2)
+    {
+    std::cerr << "Usage: " << argv[0] << " /path/to/temp" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::string fileName = std::string(argv[1]) + "/vtkNRRDWriterTest1.nrrd";
+
+  // Image is larger than one compressed block, so the data is written
+  // as multiple gzip members
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(256, 256, 48);
+  image->AllocateScalars(VTK_SHORT, 1);
+  short* voxels = static_cast<short*>(image->GetScalarPointer());
+  vtkIdType numberOfVoxels = image->GetNumberOfPoints();
+  for (vtkIdType i = 0; i < numberOfVoxels; ++i)
+    {
+    voxels[i] = static_cast<short>((i * 7) % 1000);
+    }
+
+  vtkNew<vtkNRRDWriter> writer;
+  writer->SetFileName(fileName.c_str());
+  writer->SetInputData(image.GetPointer());
+  writer->SetUseCompression(1);
+  writer->Write();
+  if (writer->GetWriteError())
+    {
+    std::cerr << __LINE__ << ": Failed to write " << fileName << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Written file is a standard gzip encoded NRRD file
+  std::ifstream file(fileName.c_str());
+  std::string line;
+  bool gzipEncoding = false;
+  while (std::getline(file, line) && !line.empty())
+    {
+    gzipEncoding |= (line == "encoding: gzip");
+    }
+  file.close();
+  if (!gzipEncoding)
+    {
+    std::cerr << __LINE__ << ": Written file is not gzip encoded" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtkNew<vtkNRRDReader> reader;
+  reader->SetFileName(fileName.c_str());
+  reader->Update();
+  vtkImageData* readImage = reader->GetOutput();
+  if (reader->GetReadStatus() != 0
+    || readImage->GetNumberOfPoints() != numberOfVoxels
+    || readImage->GetScalarType() != VTK_SHORT)
+    {
+    std::cerr << __LINE__ << ": Failed to read " << fileName << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (memcmp(readImage->GetScalarPointer(), voxels, numberOfVoxels * sizeof(short)) != 0)
+    {
+    std::cerr << __LINE__ << ": Read voxels differ from written voxels" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Reading again decodes into a new output buffer
+  reader->Modified();
+  reader->Update();
+  if (memcmp(reader->GetOutput()->GetScalarPointer(), voxels, numberOfVoxels * sizeof(short)) != 0)
+    {
+    std::cerr << __LINE__ << ": Read voxels differ from written voxels after re-reading" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // File that is replaced by a smaller image after its header was read
+  // is not decoded into the output buffer allocated for the original size
+  int numberOfErrors = 0;
+  vtkNew<vtkCallbackCommand> errorCallback;
+  errorCallback->SetCallback(CountErrors);
+  errorCallback->SetClientData(&numberOfErrors);
+  reader->AddObserver(vtkCommand::ErrorEvent, errorCallback.GetPointer());
+  reader->Modified();
+  reader->UpdateInformation();
+  vtkNew<vtkImageData> smallImage;
+  smallImage->SetDimensions(16, 16, 4);
+  smallImage->AllocateScalars(VTK_SHORT, 1);
+  smallImage->GetPointData()->GetScalars()->FillComponent(0, 1);
+  writer->SetInputData(smallImage.GetPointer());
+  writer->Write();
+  reader->Update();
+  if (numberOfErrors == 0)
+    {
+    std::cerr << __LINE__ << ": Reading a file that was modified after its header was read did not fail" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -30,11 +30,13 @@
 
 // VTK includes
 #include "vtkBitArray.h"
+#include <vtkCallbackCommand.h>
 #include "vtkCharArray.h"
 #include "vtkDoubleArray.h"
 #include "vtkFloatArray.h"
 #include "vtkImageData.h"
 #include <vtkInformation.h>
+#include <vtkInformationStringKey.h>
 #include <vtkInformationVector.h>
 #include "vtkIntArray.h"
 #include "vtkLongArray.h"
@@ -52,7 +54,42 @@
 // Teem includes
 #include "teem/ten.h"
 
+// STD includes
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+#ifndef _WIN32
+//----------------------------------------------------------------------------
+struct MemoryMappedRegion
+{
+  void* Address;
+  size_t Length;
+};
+
+//----------------------------------------------------------------------------
+/// Unmap the file region when the data array that uses it is deleted
+void UnmapMemoryMappedRegion(vtkObject* vtkNotUsed(caller), unsigned long vtkNotUsed(eid),
+                             void* clientData, void* vtkNotUsed(callData))
+{
+  MemoryMappedRegion* region = static_cast<MemoryMappedRegion*>(clientData);
+  munmap(region->Address, region->Length);
+  delete region;
+}
+#endif
+
+} // end of anonymous namespace
+
 vtkStandardNewMacro(vtkNRRDReader);
+vtkInformationKeyMacro(vtkNRRDReader, MEMORY_MAPPED_FILE_NAME, String);
 
 //----------------------------------------------------------------------------
 vtkNRRDReader::vtkNRRDReader()
@@ -62,6 +99,8 @@ vtkNRRDReader::vtkNRRDReader()
   this->MeasurementFrameMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
   this->nrrd = nrrdNew();
   this->UseNativeOrigin = true;
+  this->UseMemoryMapping = false;
+  this->DataMemoryMapped = false;
   this->ReadStatus = 0;
   this->PointDataType = -1;
   this->DataType = -1;
@@ -899,6 +938,14 @@ void vtkNRRDReader::ExecuteDataWithInformation(vtkDataObject *output, vtkInforma
         vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT()), 6);
     }
 
+  this->DataMemoryMapped = false;
+  if (this->UseMemoryMapping && this->GetFileName() != NULL
+    && this->ExecuteDataMemoryMapped(output, outInfo))
+    {
+    this->DataMemoryMapped = true;
+    return;
+    }
+
   vtkImageData *imageData = this->AllocateOutputData(output, outInfo);
 
   if (this->GetFileName() == NULL)
@@ -907,10 +954,92 @@ void vtkNRRDReader::ExecuteDataWithInformation(vtkDataObject *output, vtkInforma
     return;
     }
 
+  void *ptr = NULL;
+  vtkDataArray *outputArray = NULL;
+  switch(this->PointDataType)
+    {
+    case vtkDataSetAttributes::SCALARS:
+      outputArray = imageData->GetPointData()->GetScalars();
+      break;
+    case vtkDataSetAttributes::VECTORS:
+      outputArray = imageData->GetPointData()->GetVectors();
+      break;
+    case vtkDataSetAttributes::NORMALS:
+      outputArray = imageData->GetPointData()->GetNormals();
+      break;
+    case vtkDataSetAttributes::TENSORS:
+      outputArray = imageData->GetPointData()->GetTensors();
+      break;
+    }
+  if (outputArray)
+    {
+    outputArray->SetName("NRRDImage");
+    //get pointer
+    ptr = outputArray->GetVoidPointer(0);
+    }
+
+  // If the voxels are stored in the file in the same layout as in the output
+  // (no axis permutation or tensor expansion is needed) then let teem decode
+  // the data directly into the output buffer: teem reuses the existing data
+  // buffer of the nrrd if its size matches the size of the data in the file.
+  // this->nrrd still contains the header read in ExecuteInformation.
+  bool decodeIntoOutput = false;
+  if (ptr && this->nrrd->dim > 0)
+    {
+    unsigned int headerRangeAxisIdx[NRRD_DIM_MAX] = { 0 };
+    unsigned int headerRangeAxisNum = nrrdRangeAxesGet(this->nrrd, headerRangeAxisIdx);
+    decodeIntoOutput = (headerRangeAxisNum == 0 || (headerRangeAxisNum == 1 && headerRangeAxisIdx[0] == 0))
+      && nrrdKind3DMaskedSymMatrix != this->nrrd->axis[0].kind
+      && nrrdKind3DSymMatrix != this->nrrd->axis[0].kind
+      && static_cast<vtkIdType>(nrrdElementSize(this->nrrd)*nrrdElementNumber(this->nrrd))
+         == static_cast<vtkIdType>(outputArray->GetDataTypeSize()) * outputArray->GetNumberOfValues();
+    }
+  if (decodeIntoOutput)
+    {
+    // teem frees the existing buffer if the data in the file has a different
+    // size. The file may have been replaced since ExecuteInformation read its
+    // header, so check its header again before teem is given the output buffer.
+    Nrrd *header = nrrdNew();
+    NrrdIoState *nio = nrrdIoStateNew();
+    nrrdIoStateSet(nio, nrrdIoStateSkipData, 1);
+    bool headerMatches = false;
+    if (nrrdLoad(header, this->GetFileName(), nio) == 0)
+      {
+      unsigned int rangeAxisIdx[NRRD_DIM_MAX] = { 0 };
+      unsigned int rangeAxisNum = nrrdRangeAxesGet(header, rangeAxisIdx);
+      headerMatches = header->type == this->nrrd->type
+        && header->dim == this->nrrd->dim
+        && (rangeAxisNum == 0 || (rangeAxisNum == 1 && rangeAxisIdx[0] == 0))
+        && nrrdKind3DMaskedSymMatrix != header->axis[0].kind
+        && nrrdKind3DSymMatrix != header->axis[0].kind
+        && static_cast<vtkIdType>(nrrdElementSize(header)*nrrdElementNumber(header))
+           == static_cast<vtkIdType>(outputArray->GetDataTypeSize()) * outputArray->GetNumberOfValues();
+      }
+    else
+      {
+      char *err = biffGetDone(NRRD);
+      free(err);
+      }
+    nrrdNuke(header);
+    nrrdIoStateNix(nio);
+    if (!headerMatches)
+      {
+      vtkErrorMacro("Read: " << this->GetFileName()
+        << " was modified after its header was read, the data does not fit into the output image");
+      return;
+      }
+    this->nrrd->data = ptr;
+    }
+
   // Read in the this->nrrd.  Yes, this means that the header is being read
   // twice: once by ExecuteInformation, and once here
   if ( nrrdLoad(this->nrrd, this->GetFileName(), NULL) != 0 )
     {
+    if (decodeIntoOutput && this->nrrd->data == ptr)
+      {
+      // the output buffer is owned by VTK
+      this->nrrd->data = NULL;
+      }
     char *err =  biffGetDone(NRRD); // would be nice to free(err)
     vtkErrorMacro("Read: Error reading " << this->GetFileName() << ":\n" << err);
     return;
@@ -922,28 +1051,6 @@ void vtkNRRDReader::ExecuteDataWithInformation(vtkDataObject *output, vtkInforma
     return;
     }
 
-  void *ptr = NULL;
-  switch(this->PointDataType)
-    {
-    case vtkDataSetAttributes::SCALARS:
-      imageData->GetPointData()->GetScalars()->SetName("NRRDImage");
-      //get pointer
-      ptr = imageData->GetPointData()->GetScalars()->GetVoidPointer(0);
-      break;
-    case vtkDataSetAttributes::VECTORS:
-      imageData->GetPointData()->GetVectors()->SetName("NRRDImage");
-      //get pointer
-      ptr = imageData->GetPointData()->GetVectors()->GetVoidPointer(0);
-      break;
-    case vtkDataSetAttributes::NORMALS:
-      imageData->GetPointData()->GetNormals()->SetName("NRRDImage");
-      ptr = imageData->GetPointData()->GetNormals()->GetVoidPointer(0);
-      break;
-    case vtkDataSetAttributes::TENSORS:
-      imageData->GetPointData()->GetTensors()->SetName("NRRDImage");
-      ptr = imageData->GetPointData()->GetTensors()->GetVoidPointer(0);
-      break;
-    }
   this->ComputeDataIncrements();
 
   unsigned int rangeAxisIdx[NRRD_DIM_MAX] = { 0 };
@@ -1083,17 +1190,209 @@ void vtkNRRDReader::ExecuteDataWithInformation(vtkDataObject *output, vtkInforma
     // be called here if it existed.
     }
 
-  if (ptr)
+  if (ptr && ptr != this->nrrd->data)
     {
+    if (static_cast<vtkIdType>(nrrdElementSize(this->nrrd)*nrrdElementNumber(this->nrrd))
+      > static_cast<vtkIdType>(outputArray->GetDataTypeSize()) * outputArray->GetNumberOfValues())
+      {
+      vtkErrorMacro("Read: " << this->GetFileName()
+        << " was modified after its header was read, the data does not fit into the output image");
+      return;
+      }
     memcpy(ptr, this->nrrd->data, nrrdElementSize(this->nrrd)*nrrdElementNumber(this->nrrd));
     }
+  if (this->nrrd->data == ptr)
+    {
+    // the data was decoded directly into the output buffer, which is owned by VTK
+    this->nrrd->data = NULL;
+    }
 
   // release the memory while keeping the struct
   nrrdEmpty(this->nrrd);
 }
 
+//----------------------------------------------------------------------------
+bool vtkNRRDReader::CanMemoryMapData()
+{
+  std::string dataFileName;
+  vtkTypeInt64 dataOffset = 0;
+  vtkTypeInt64 dataSize = 0;
+  return this->GetMemoryMappableData(dataFileName, dataOffset, dataSize);
+}
+
+//----------------------------------------------------------------------------
+bool vtkNRRDReader::GetMemoryMappableData(std::string& dataFileName, vtkTypeInt64& dataOffset, vtkTypeInt64& dataSize)
+{
+#ifdef _WIN32
+  (void)dataFileName;
+  (void)dataOffset;
+  (void)dataSize;
+  return false;
+#else
+  if (this->GetFileName() == NULL)
+    {
+    return false;
+    }
+  this->ExecuteInformation();
+  if (this->ReadStatus != 0
+    || this->PointDataType != vtkDataSetAttributes::SCALARS
+    || this->DataType == VTK_BIT)
+    {
+    return false;
+    }
+
+  // Read the header again to get the location and encoding of the data
+  Nrrd *header = nrrdNew();
+  NrrdIoState *nio = nrrdIoStateNew();
+  nrrdIoStateSet(nio, nrrdIoStateSkipData, 1);
+  if (nrrdLoad(header, this->GetFileName(), nio) != 0)
+    {
+    char *err = biffGetDone(NRRD);
+    free(err);
+    nrrdNuke(header);
+    nrrdIoStateNix(nio);
+    return false;
+    }
+
+#ifdef VTK_WORDS_BIGENDIAN
+  int nativeEndian = airEndianBig;
+#else
+  int nativeEndian = airEndianLittle;
+#endif
+  unsigned int rangeAxisIdx[NRRD_DIM_MAX] = { 0 };
+  unsigned int rangeAxisNum = nrrdRangeAxesGet(header, rangeAxisIdx);
+  size_t elementSize = nrrdElementSize(header);
+  dataSize = static_cast<vtkTypeInt64>(elementSize * nrrdElementNumber(header));
+  int* extent = this->GetDataExtent();
+  vtkTypeInt64 numberOfValues = vtkTypeInt64(extent[1] - extent[0] + 1)*
+    vtkTypeInt64(extent[3] - extent[2] + 1)*
+    vtkTypeInt64(extent[5] - extent[4] + 1) * this->GetNumberOfComponents();
+
+  // Only a single uncompressed data file in native byte order, with
+  // voxel components stored next to each other, can be mapped
+  bool canMap = (nio->encoding == nrrdEncodingRaw)
+    && (elementSize == 1 || nio->endian == nativeEndian)
+    && (rangeAxisNum == 0 || (rangeAxisNum == 1 && rangeAxisIdx[0] == 0))
+    && nio->dataFNFormat == NULL && nio->dataFNArr->len <= 1
+    && dataSize > 0
+    && dataSize == numberOfValues * vtkDataArray::GetDataTypeSize(this->DataType);
+
+  // Find the data file and the position of the data in it
+  dataFileName = this->GetFileName();
+  dataOffset = 0;
+  if (canMap)
+    {
+    std::ifstream dataFile;
+    std::string line;
+    if (nio->dataFNArr->len == 1)
+      {
+      // detached header, data file path is relative to the header
+      dataFileName = vtksys::SystemTools::CollapseFullPath(nio->dataFN[0],
+        vtksys::SystemTools::GetFilenamePath(this->GetFileName()).c_str());
+      dataFile.open(dataFileName.c_str(), std::ios::in | std::ios::binary);
+      }
+    else
+      {
+      // data is attached, it starts after the empty line that ends the header
+      dataFile.open(dataFileName.c_str(), std::ios::in | std::ios::binary);
+      while (std::getline(dataFile, line) && !line.empty() && line != "\r")
+        {
+        }
+      }
+    for (int i = 0; i < nio->lineSkip && dataFile.good(); ++i)
+      {
+      std::getline(dataFile, line);
+      }
+    canMap = dataFile.good();
+    dataOffset = canMap ? static_cast<vtkTypeInt64>(dataFile.tellg()) : 0;
+    }
+  int byteSkip = nio->byteSkip;
+  nrrdNuke(header);
+  nrrdIoStateNix(nio);
+
+  struct stat fileStat;
+  if (!canMap || stat(dataFileName.c_str(), &fileStat) != 0)
+    {
+    return false;
+    }
+  vtkTypeInt64 fileSize = static_cast<vtkTypeInt64>(fileStat.st_size);
+  if (byteSkip == -1)
+    {
+    // data is at the end of the file
+    dataOffset = fileSize - dataSize;
+    }
+  else
+    {
+    dataOffset += byteSkip;
+    }
+  return (dataOffset >= 0 && dataOffset + dataSize <= fileSize);
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool vtkNRRDReader::ExecuteDataMemoryMapped(vtkDataObject *output, vtkInformation* outInfo)
+{
+#ifdef _WIN32
+  (void)output;
+  (void)outInfo;
+  return false;
+#else
+  vtkImageData *imageData = vtkImageData::SafeDownCast(output);
+  std::string dataFileName;
+  vtkTypeInt64 dataOffset = 0;
+  vtkTypeInt64 dataSize = 0;
+  if (!imageData || !this->GetMemoryMappableData(dataFileName, dataOffset, dataSize))
+    {
+    return false;
+    }
+
+  int fd = open(dataFileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    {
+    return false;
+    }
+  // Private mapping: pages are loaded from the file when they are accessed
+  // and they are copied on write
+  vtkTypeInt64 pageSize = static_cast<vtkTypeInt64>(sysconf(_SC_PAGESIZE));
+  vtkTypeInt64 mappedOffset = dataOffset - dataOffset % pageSize;
+  size_t mappedLength = static_cast<size_t>(dataSize + dataOffset - mappedOffset);
+  void* mappedAddress = mmap(NULL, mappedLength, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, static_cast<off_t>(mappedOffset));
+  // the mapping remains valid after the file is closed
+  close(fd);
+  if (mappedAddress == MAP_FAILED)
+    {
+    vtkWarningMacro("ExecuteDataMemoryMapped: Failed to map " << dataFileName << ", reading data into memory");
+    return false;
+    }
+
+  vtkSmartPointer<vtkDataArray> scalars;
+  scalars.TakeReference(vtkDataArray::CreateDataArray(this->DataType));
+  scalars->SetName("NRRDImage");
+  scalars->SetNumberOfComponents(this->GetNumberOfComponents());
+  // save=1: the array must not free the mapped memory
+  scalars->SetVoidArray(static_cast<char*>(mappedAddress) + (dataOffset - mappedOffset),
+    static_cast<vtkIdType>(dataSize / vtkDataArray::GetDataTypeSize(this->DataType)), 1);
+  MemoryMappedRegion* region = new MemoryMappedRegion;
+  region->Address = mappedAddress;
+  region->Length = mappedLength;
+  vtkNew<vtkCallbackCommand> unmapCallback;
+  unmapCallback->SetCallback(UnmapMemoryMappedRegion);
+  unmapCallback->SetClientData(region);
+  scalars->AddObserver(vtkCommand::DeleteEvent, unmapCallback.GetPointer());
+  scalars->GetInformation()->Set(vtkNRRDReader::MEMORY_MAPPED_FILE_NAME(),
+    vtksys::SystemTools::CollapseFullPath(dataFileName).c_str());
+
+  imageData->SetExtent(this->GetDataExtent());
+  imageData->GetPointData()->SetScalars(scalars);
+  vtkDataObject::SetPointDataActiveScalarInfo(outInfo, this->DataType, this->GetNumberOfComponents());
+  return true;
+#endif
+}
+
 //----------------------------------------------------------------------------
 void vtkNRRDReader::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os,indent);
+  os << indent << "UseMemoryMapping: " << this->UseMemoryMapping << "\n";
+  os << indent << "DataMemoryMapped: " << this->DataMemoryMapped << "\n";
 }
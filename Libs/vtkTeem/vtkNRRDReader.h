@@ -46,6 +46,8 @@
 
 #include "teem/nrrd.h"
 
+class vtkInformationStringKey;
+
 /// \brief Reads Nearly Raw Raster Data files.
 ///
 /// Reads Nearly Raw Raster Data files using the nrrdio library as used in ITK
@@ -142,6 +144,34 @@ public:
     UseNativeOrigin = false;
   }
 
+  ///
+  /// If enabled, voxels of uncompressed (raw encoded) files are not read into
+  /// memory but the file is mapped into memory instead. Only the parts of the
+  /// file that are accessed are loaded, which makes opening very large volumes
+  /// fast. The mapping is private: modifications of the output voxels
+  /// are not written back to the file.
+  /// Files that cannot be mapped (compressed, different byte order, tensor data,
+  /// etc.) are read as usual. Disabled by default.
+  vtkSetMacro(UseMemoryMapping, bool);
+  vtkGetMacro(UseMemoryMapping, bool);
+  vtkBooleanMacro(UseMemoryMapping, bool);
+
+  ///
+  /// Returns true if the voxels of the file can be mapped into memory.
+  /// Reads the file header.
+  bool CanMemoryMapData();
+
+  ///
+  /// Returns true if the voxels of the last read image are mapped from the file.
+  vtkGetMacro(DataMemoryMapped, bool);
+
+  ///
+  /// Key set in the information of the scalar array of the output when the
+  /// voxels are mapped from a file. The value is the full path of the file.
+  /// The file must not be overwritten in place while an array maps it,
+  /// the array has to be replaced by a copy first.
+  static vtkInformationStringKey* MEMORY_MAPPED_FILE_NAME();
+
   int NrrdToVTKScalarType( const int nrrdPixelType ) const
   {
   switch( nrrdPixelType )
@@ -251,6 +281,8 @@ protected:
   int DataType;
   int NumberOfComponents;
   bool UseNativeOrigin;
+  bool UseMemoryMapping;
+  bool DataMemoryMapped;
 
   std::map <std::string, std::string> HeaderKeyValue;
   std::string HeaderKeys; // buffer for returning key list
@@ -261,6 +293,13 @@ protected:
   virtual void ExecuteInformation() VTK_OVERRIDE;
   virtual void ExecuteDataWithInformation(vtkDataObject *output, vtkInformation* outInfo) VTK_OVERRIDE;
 
+  /// Map the voxels of the file into the output image.
+  /// Returns false if the file cannot be mapped.
+  bool ExecuteDataMemoryMapped(vtkDataObject *output, vtkInformation* outInfo);
+
+  /// Get the file name, position and size of the voxel data if it can be mapped into memory
+  bool GetMemoryMappableData(std::string& dataFileName, vtkTypeInt64& dataOffset, vtkTypeInt64& dataSize);
+
   int tenSpaceDirectionReduce(Nrrd *nout, const Nrrd *nin, double SD[9]);
 
 private:
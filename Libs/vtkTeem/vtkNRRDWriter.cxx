@@ -7,11 +7,138 @@
 #include "vtkPointData.h"
 #include "vtkObjectFactory.h"
 #include "vtkInformation.h"
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
 #include <vtkVersion.h>
+#include <vtk_zlib.h>
+
+// STD includes
+#include <algorithm>
+#include <vector>
 
 class AttributeMapType: public std::map<std::string, std::string> {};
 class AxisInfoMapType : public std::map<unsigned int, std::string> {};
 
+namespace
+{
+
+/// Size of the independently compressed blocks of the data.
+/// Each block is written as a complete gzip member. Readers that support
+/// gzip (teem, ITK, zlib, gunzip) decompress concatenated members as one stream,
+/// therefore the written files remain standard "encoding: gzip" NRRD files.
+const size_t GzipBlockSize = 4 * 1024 * 1024;
+
+//----------------------------------------------------------------------------
+struct GzipBlockCompressor
+{
+  const unsigned char* Data;
+  size_t DataSize;
+  int Level;
+  int Strategy;
+  /// Index of the first block of the current batch
+  size_t FirstBlock;
+  std::vector< std::vector<unsigned char> > CompressedBlocks;
+  std::vector<bool> BlockErrors;
+
+  bool CompressBlock(size_t blockIndex, std::vector<unsigned char>& compressedBlock)
+    {
+    size_t blockStart = blockIndex * GzipBlockSize;
+    size_t blockSize = std::min(GzipBlockSize, this->DataSize - blockStart);
+
+    z_stream strm;
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    // 15 + 16: maximum window size with gzip header and trailer
+    if (deflateInit2(&strm, this->Level, Z_DEFLATED, 15 + 16, 8, this->Strategy) != Z_OK)
+      {
+      return false;
+      }
+    // deflateBound does not include the gzip header and trailer in older zlib versions
+    compressedBlock.resize(deflateBound(&strm, static_cast<uLong>(blockSize)) + 32);
+    strm.next_in = const_cast<Bytef*>(this->Data + blockStart);
+    strm.avail_in = static_cast<uInt>(blockSize);
+    strm.next_out = &compressedBlock[0];
+    strm.avail_out = static_cast<uInt>(compressedBlock.size());
+    int result = deflate(&strm, Z_FINISH);
+    compressedBlock.resize(compressedBlock.size() - strm.avail_out);
+    deflateEnd(&strm);
+    return (result == Z_STREAM_END);
+    }
+};
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE GzipBlockCompressorThreaderCallback(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  GzipBlockCompressor* compressor = static_cast<GzipBlockCompressor*>(info->UserData);
+  for (size_t i = info->ThreadID; i < compressor->CompressedBlocks.size(); i += info->NumberOfThreads)
+    {
+    compressor->BlockErrors[i] = !compressor->CompressBlock(
+      compressor->FirstBlock + i, compressor->CompressedBlocks[i]);
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+/// Replacement of the write function of teem's gzip encoding.
+/// Blocks of the data are compressed concurrently, in batches of one block
+/// per thread to limit the memory needed for the compressed blocks.
+int GzipParallelWrite(FILE* file, const void* data, size_t elementNum,
+                      const Nrrd* nrrd, NrrdIoState* nio)
+{
+  GzipBlockCompressor compressor;
+  compressor.Data = static_cast<const unsigned char*>(data);
+  compressor.DataSize = elementNum * nrrdElementSize(nrrd);
+  compressor.Level = (nio->zlibLevel >= 0 && nio->zlibLevel <= 9) ? nio->zlibLevel : Z_DEFAULT_COMPRESSION;
+  switch (nio->zlibStrategy)
+    {
+    case nrrdZlibStrategyHuffman: compressor.Strategy = Z_HUFFMAN_ONLY; break;
+    case nrrdZlibStrategyFiltered: compressor.Strategy = Z_FILTERED; break;
+    default: compressor.Strategy = Z_DEFAULT_STRATEGY; break;
+    }
+
+  size_t numberOfBlocks = std::max<size_t>(1, (compressor.DataSize + GzipBlockSize - 1) / GzipBlockSize);
+  int numberOfThreads = std::max(1, vtkMultiThreader::GetGlobalDefaultNumberOfThreads());
+
+  vtkNew<vtkMultiThreader> threader;
+  for (compressor.FirstBlock = 0; compressor.FirstBlock < numberOfBlocks;
+    compressor.FirstBlock += compressor.CompressedBlocks.size())
+    {
+    size_t batchSize = std::min(static_cast<size_t>(numberOfThreads), numberOfBlocks - compressor.FirstBlock);
+    compressor.CompressedBlocks.assign(batchSize, std::vector<unsigned char>());
+    compressor.BlockErrors.assign(batchSize, false);
+    if (batchSize > 1)
+      {
+      threader->SetNumberOfThreads(static_cast<int>(batchSize));
+      threader->SetSingleMethod(GzipBlockCompressorThreaderCallback, &compressor);
+      threader->SingleMethodExecute();
+      }
+    else
+      {
+      compressor.BlockErrors[0] = !compressor.CompressBlock(compressor.FirstBlock, compressor.CompressedBlocks[0]);
+      }
+
+    for (size_t i = 0; i < batchSize; ++i)
+      {
+      std::vector<unsigned char>& compressedBlock = compressor.CompressedBlocks[i];
+      if (compressor.BlockErrors[i])
+        {
+        biffAddf(NRRD, "GzipParallelWrite: error compressing block %u", static_cast<unsigned int>(compressor.FirstBlock + i));
+        return 1;
+        }
+      if (fwrite(&compressedBlock[0], 1, compressedBlock.size(), file) != compressedBlock.size())
+        {
+        biffAddf(NRRD, "GzipParallelWrite: error writing compressed block %u", static_cast<unsigned int>(compressor.FirstBlock + i));
+        return 1;
+        }
+      }
+    }
+  return 0;
+}
+
+} // end of anonymous namespace
+
 vtkStandardNewMacro(vtkNRRDWriter);
 
 //----------------------------------------------------------------------------
@@ -349,11 +476,16 @@ void vtkNRRDWriter::WriteData()
 
   NrrdIoState *nio = nrrdIoStateNew();
 
+  // gzip encoding that compresses the data using multiple threads,
+  // it must be kept until nrrdSave returns.
+  NrrdEncoding parallelGzipEncoding = *nrrdEncodingGzip;
+  parallelGzipEncoding.write = GzipParallelWrite;
+
   // set encoding for data: compressed (raw), (uncompressed) raw, or ascii
   if ( this->GetUseCompression() && nrrdEncodingGzip->available() )
     {
     // this is necessarily gzip-compressed *raw* data
-    nio->encoding = nrrdEncodingGzip;
+    nio->encoding = &parallelGzipEncoding;
     }
   else
     {
@@ -26,6 +26,9 @@ Version:   $Revision$
 #include "vtkMRMLModelStorageNode.h"
 #include "vtkMRMLScene.h"
 
+// vtkSegmentationCore includes
+#include "vtkOrientedImageDataResample.h"
+
 // vtkITK includes
 #include "vtkITKArchetypeImageSeriesScalarReader.h"
 
@@ -42,6 +45,10 @@ Version:   $Revision$
 #include <vtkImageToStructuredPoints.h>
 #include <vtkInformation.h>
 #include <vtkLookupTable.h>
+#include <vtkMarchingCubes.h>
+#include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
 #include <vtkNew.h>
 #include <vtkPointData.h>
 #include <vtkPolyDataNormals.h>
@@ -61,6 +68,387 @@ Version:   $Revision$
 // VTKsys includes
 #include <vtksys/SystemTools.hxx>
 
+// STD includes
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Add a model node for the label, with its storage, display and hierarchy nodes
+void AddModelToScene(vtkMRMLScene* modelScene, vtkMRMLNode* rnd, vtkMRMLModelHierarchyNode* topColorHierarchyNode,
+                     vtkMRMLColorTableNode* colorNode, int i, const std::string& labelName, const std::string& fileName,
+                     bool debug)
+{
+  if (modelScene == NULL)
+    {
+    return;
+    }
+  if (debug)
+    {
+    std::cout << "Adding model " << labelName << " to the output scene, with filename " << fileName.c_str()
+              << endl;
+    }
+  // each model needs a mrml node, a storage node and a display node
+  vtkNew<vtkMRMLModelNode> mnode;
+  mnode->SetScene(modelScene);
+  mnode->SetName(labelName.c_str());
+
+  vtkNew<vtkMRMLModelStorageNode> snode;
+  snode->SetFileName(fileName.c_str());
+  if (modelScene->AddNode(snode.GetPointer()) == NULL)
+    {
+    std::cerr << "ERROR: unable to add the storage node to the model scene" << endl;
+    }
+  vtkNew<vtkMRMLModelDisplayNode> dnode;
+  dnode->SetColor(0.5, 0.5, 0.5);
+  double *rgba;
+  if (colorNode != NULL)
+    {
+    rgba = colorNode->GetLookupTable()->GetTableValue(i);
+    if (rgba != NULL)
+      {
+      if (debug)
+        {
+        std::cout << "Got colour: " << rgba[0] << " " << rgba[1] << " " << rgba[2] << " " << rgba[3] << endl;
+        }
+      dnode->SetColor(rgba[0], rgba[1], rgba[2]);
+      }
+    else
+      {
+      std::cerr << "Couldn't get look up table value for " << i << ", display node colour is not set (grey)"
+                << endl;
+      }
+    }
+
+  dnode->SetVisibility(1);
+  modelScene->AddNode(dnode.GetPointer());
+  if (debug)
+    {
+    std::cout << "Added display node: id = " << (dnode->GetID() == NULL ? "(null)" : dnode->GetID()) << endl;
+    std::cout << "Setting model's storage node: id = "
+              << (snode->GetID() == NULL ? "(null)" : snode->GetID()) << endl;
+    }
+  mnode->SetAndObserveStorageNodeID(snode->GetID());
+  mnode->SetAndObserveDisplayNodeID(dnode->GetID());
+  modelScene->AddNode(mnode.GetPointer());
+
+  // put it in the hierarchy, either the flat one by default or
+  // try to find the matching color hierarchy node to make this an
+  // associated node
+  std::string colorName;
+  if (colorNode != NULL)
+    {
+    colorName = std::string(colorNode->GetColorNameAsFileName(i));
+    }
+  else
+    {
+    // might be in a testing case where the hierarchy nodes are
+    // numbered (made from the generic colors)
+    std::stringstream ss;
+    ss << i;
+    colorName = ss.str();
+    if (debug)
+      {
+      std::cout << "No color node, guessing at color name being same as label number " << colorName.c_str() << std::endl;
+      }
+    }
+  vtkMRMLNode *mrmlNode = NULL;
+  if (colorName.compare("") != 0)
+    {
+    mrmlNode = modelScene->GetFirstNodeByName(colorName.c_str());
+    }
+  // if there's no color hierarchy, or no color name or the mrml node
+  // named for the color isn't a model hierarchy node, use a flat hierarchy
+  if (topColorHierarchyNode == NULL ||
+      colorName.compare("") == 0 ||
+      mrmlNode == NULL ||
+      strcmp(mrmlNode->GetClassName(),"vtkMRMLModelHierarchyNode") != 0)
+    {
+    vtkNew<vtkMRMLModelHierarchyNode> mhnd;
+    mhnd->SetHideFromEditors(1);
+    modelScene->AddNode(mhnd.GetPointer());
+    mhnd->SetParentNodeID(rnd->GetID());
+    mhnd->SetModelNodeID(mnode->GetID());
+    }
+  else
+    {
+    // use the template color hierarchy
+    vtkMRMLModelHierarchyNode *colorHierarchyNode = vtkMRMLModelHierarchyNode::SafeDownCast(mrmlNode);
+    if (colorHierarchyNode)
+      {
+      colorHierarchyNode->SetAssociatedNodeID(mnode->GetID());
+      // and hide it so that it doesn't clutter up the tree
+      colorHierarchyNode->SetHideFromEditors(1);
+      if (debug)
+        {
+        std::cout << "Found a color hierarchy node with name " << colorHierarchyNode->GetName() << ", set it's associated node to this model id: " << mnode->GetID() << std::endl;
+        }
+      }
+    }
+  if (debug)
+    {
+    std::cout << "...done adding model to output scene" << endl;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Surface of a label that is extracted on a worker thread
+struct LabelSurfaceJob
+{
+  int Label;
+  std::string LabelName;
+  std::string FileName;
+  // Region of the image that contains the label, with a one voxel border
+  int Extent[6];
+  bool HasPolygons;
+  bool Written;
+};
+
+//----------------------------------------------------------------------------
+// State shared between the threads that extract label surfaces.
+// Threads only read the input image and each surface is made by its own filters.
+struct LabelSurfaceExtraction
+{
+  vtkImageData* Image;
+  double IJKToRAS[16];
+  bool Reverse;
+  bool SincSmoothing;
+  int Smooth;
+  float Decimate;
+  bool PointNormals;
+  bool SplitNormals;
+
+  std::vector<LabelSurfaceJob> Jobs;
+  ::size_t NextJobIndex;
+  ::size_t NumberOfCompletedJobs;
+  bool Aborted;
+
+  // progress reporting, same as vtkPluginFilterWatcher
+  ModuleProcessInformation* ProcessInformation;
+  float ProgressStart;
+  float ProgressPerJob;
+  bool Quiet;
+
+  vtkSimpleMutexLock Lock;
+};
+
+//----------------------------------------------------------------------------
+// Same output as vtkImageThreshold with ThresholdBetween(label, label), ReplaceIn/Out,
+// InValue 200 and OutValue 0, but only within the extent of the label image
+template <typename T>
+void ThresholdLabelGeneric(vtkImageData* image, int label, vtkImageData* labelImage)
+{
+  T labelValue = static_cast<T>(label);
+  T inValue = static_cast<T>(std::min(200.0, image->GetScalarTypeMax()));
+  int* extent = labelImage->GetExtent();
+  for (int k = extent[4]; k <= extent[5]; k++)
+    {
+    for (int j = extent[2]; j <= extent[3]; j++)
+      {
+      T* inPtr = static_cast<T*>(image->GetScalarPointer(extent[0], j, k));
+      T* outPtr = static_cast<T*>(labelImage->GetScalarPointer(extent[0], j, k));
+      for (int i = extent[0]; i <= extent[1]; i++)
+        {
+        *(outPtr++) = (*(inPtr++) == labelValue ? inValue : 0);
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Filters of a large label can run for a long time, so abort requests
+// are checked between the filters and not only between the labels
+bool IsLabelSurfaceExtractionAborted(LabelSurfaceExtraction* state)
+{
+  state->Lock.Lock();
+  if (state->ProcessInformation && state->ProcessInformation->Abort)
+    {
+    state->Aborted = true;
+    }
+  bool aborted = state->Aborted;
+  state->Lock.Unlock();
+  return aborted;
+}
+
+//----------------------------------------------------------------------------
+// Make the model of a label and write it to file, with the same filters
+// and settings as the labels that are processed one by one
+void ExtractLabelSurface(LabelSurfaceExtraction* state, LabelSurfaceJob& job)
+{
+  job.HasPolygons = false;
+  job.Written = false;
+  if (job.Extent[0] > job.Extent[1] || job.Extent[2] > job.Extent[3] || job.Extent[4] > job.Extent[5])
+    {
+    // label is not present in the image
+    return;
+    }
+
+  vtkNew<vtkImageData> labelImage;
+  labelImage->SetOrigin(state->Image->GetOrigin());
+  labelImage->SetSpacing(state->Image->GetSpacing());
+  labelImage->SetExtent(job.Extent);
+  labelImage->AllocateScalars(state->Image->GetScalarType(), 1);
+  switch (state->Image->GetScalarType())
+    {
+    vtkTemplateMacro(ThresholdLabelGeneric<VTK_TT>(state->Image, job.Label, labelImage.GetPointer()));
+  default:
+    return;
+    }
+  if (IsLabelSurfaceExtractionAborted(state))
+    {
+    return;
+    }
+
+  vtkNew<vtkMarchingCubes> mcubes;
+  mcubes->SetInputData(labelImage.GetPointer());
+  mcubes->SetValue(0, 100.5);
+  mcubes->ComputeScalarsOff();
+  mcubes->ComputeGradientsOff();
+  mcubes->ComputeNormalsOff();
+  mcubes->Update();
+  if (mcubes->GetOutput()->GetNumberOfPolys() == 0)
+    {
+    return;
+    }
+  job.HasPolygons = true;
+  if (IsLabelSurfaceExtractionAborted(state))
+    {
+    return;
+    }
+
+  vtkNew<vtkDecimatePro> decimator;
+  decimator->SetInputConnection(mcubes->GetOutputPort());
+  decimator->SetFeatureAngle(60);
+  decimator->SplittingOff();
+  decimator->PreserveTopologyOn();
+  decimator->SetMaximumError(1);
+  decimator->SetTargetReduction(state->Decimate);
+  decimator->Update();
+  if (IsLabelSurfaceExtractionAborted(state))
+    {
+    return;
+    }
+
+  vtkAlgorithmOutput* surfacePort = decimator->GetOutputPort();
+  vtkNew<vtkReverseSense> reverser;
+  if (state->Reverse)
+    {
+    reverser->SetInputConnection(surfacePort);
+    reverser->ReverseNormalsOn();
+    surfacePort = reverser->GetOutputPort();
+    }
+
+  vtkSmartPointer<vtkPolyDataAlgorithm> smoother;
+  if (state->SincSmoothing)
+    {
+    vtkSmartPointer<vtkWindowedSincPolyDataFilter> smootherSinc = vtkSmartPointer<vtkWindowedSincPolyDataFilter>::New();
+    smootherSinc->SetPassBand(0.1);
+    smootherSinc->SetNumberOfIterations(state->Smooth);
+    smootherSinc->FeatureEdgeSmoothingOff();
+    smootherSinc->BoundarySmoothingOff();
+    smoother = smootherSinc.GetPointer();
+    }
+  else
+    {
+    vtkSmartPointer<vtkSmoothPolyDataFilter> smootherPoly = vtkSmartPointer<vtkSmoothPolyDataFilter>::New();
+    smootherPoly->SetRelaxationFactor(0.33);
+    smootherPoly->SetFeatureAngle(60);
+    smootherPoly->SetConvergence(0);
+    smootherPoly->SetNumberOfIterations(state->Smooth);
+    smootherPoly->FeatureEdgeSmoothingOff();
+    smootherPoly->BoundarySmoothingOff();
+    smoother = smootherPoly.GetPointer();
+    }
+  smoother->SetInputConnection(surfacePort);
+  smoother->Update();
+  if (IsLabelSurfaceExtractionAborted(state))
+    {
+    return;
+    }
+
+  // each thread has its own transform, transforms are not thread safe
+  vtkNew<vtkTransform> transformIJKtoRAS;
+  transformIJKtoRAS->SetMatrix(state->IJKToRAS);
+  vtkNew<vtkTransformPolyDataFilter> transformer;
+  transformer->SetInputConnection(smoother->GetOutputPort());
+  transformer->SetTransform(transformIJKtoRAS.GetPointer());
+
+  vtkNew<vtkPolyDataNormals> normals;
+  normals->SetComputePointNormals(state->PointNormals);
+  normals->SetInputConnection(transformer->GetOutputPort());
+  normals->SetFeatureAngle(60);
+  normals->SetSplitting(state->SplitNormals);
+  normals->Update();
+  if (IsLabelSurfaceExtractionAborted(state))
+    {
+    return;
+    }
+
+  vtkNew<vtkStripper> stripper;
+  stripper->SetInputConnection(normals->GetOutputPort());
+
+  vtkNew<vtkPolyDataWriter> writer;
+  writer->SetInputConnection(stripper->GetOutputPort());
+  writer->SetFileType(2);
+  writer->SetFileName(job.FileName.c_str());
+  job.Written = (writer->Write() != 0);
+}
+
+//----------------------------------------------------------------------------
+// Report progress after a label is done. Called with the lock held.
+void ReportLabelSurfaceProgress(LabelSurfaceExtraction* state, const LabelSurfaceJob& job)
+{
+  float progress = state->ProgressStart + state->ProgressPerJob * state->NumberOfCompletedJobs;
+  ModuleProcessInformation* info = state->ProcessInformation;
+  if (info)
+    {
+    std::string comment = "Make model " + job.LabelName;
+    info->Progress = progress;
+    info->StageProgress = static_cast<float>(state->NumberOfCompletedJobs) / state->Jobs.size();
+    strncpy(info->ProgressMessage, comment.c_str(), 1023);
+    if (info->Abort)
+      {
+      state->Aborted = true;
+      }
+    if (info->ProgressCallbackFunction && info->ProgressCallbackClientData)
+      {
+      (*(info->ProgressCallbackFunction))(info->ProgressCallbackClientData);
+      }
+    }
+  else if (!state->Quiet)
+    {
+    std::cout << "<filter-progress>" << progress << "</filter-progress>" << std::endl;
+    std::cout << std::flush;
+    }
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE LabelSurfaceThreadFunction(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  LabelSurfaceExtraction* state = static_cast<LabelSurfaceExtraction*>(info->UserData);
+
+  state->Lock.Lock();
+  while (state->NextJobIndex < state->Jobs.size() && !state->Aborted)
+    {
+    LabelSurfaceJob& job = state->Jobs[state->NextJobIndex++];
+    state->Lock.Unlock();
+
+    ExtractLabelSurface(state, job);
+
+    state->Lock.Lock();
+    ++state->NumberOfCompletedJobs;
+    ReportLabelSurfaceProgress(state, job);
+    }
+  state->Lock.Unlock();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+} // end of anonymous namespace
+
 int main(int argc, char * argv[])
 {
   PARSE_ARGS;
@@ -869,6 +1257,31 @@ int main(int argc, char * argv[])
       loopLabels.push_back(Labels[i]);
       }
     }
+
+  // Without joint smoothing the labels are independent: the extents of all the labels
+  // are found in one pass over the image, then the labels are named in the loop below
+  // and their models are made in parallel threads, each one only within its extent.
+  bool makeModelsInParallel = (JointSmoothing == 0 && !SaveIntermediateModels);
+  LabelSurfaceExtraction surfaceExtraction;
+  std::map<int, std::vector<int> > labelExtents;
+  if (makeModelsInParallel)
+    {
+    if (Pad)
+      {
+      padder->Update();
+      surfaceExtraction.Image = padder->GetOutput();
+      }
+    else
+      {
+      surfaceExtraction.Image = image;
+      }
+    vtkOrientedImageDataResample::CalculateLabelExtents(surfaceExtraction.Image, labelExtents);
+    if (debug)
+      {
+      std::cout << "Found " << labelExtents.size() << " labels in the image" << endl;
+      }
+    }
+
   for(::size_t l = 0; l < loopLabels.size(); l++)
     {
     // get the label out of the vector
@@ -979,6 +1392,16 @@ int main(int argc, char * argv[])
       */
       }
 
+    if (makeModelsInParallel)
+      {
+      // the model is made after all the labels are named
+      LabelSurfaceJob job;
+      job.Label = i;
+      job.LabelName = labelName;
+      surfaceExtraction.Jobs.push_back(job);
+      continue;
+      }
+
     // threshold
     if (JointSmoothing == 0)
       {
@@ -1607,117 +2030,98 @@ int main(int argc, char * argv[])
         }
       writer->SetInputData(NULL);
       writer = NULL;
-      if (modelScene.GetPointer() != NULL)
+      AddModelToScene(modelScene.GetPointer(), rnd, topColorHierarchyNode, colorNode, i, labelName, fileName, debug);
+      } // end of skipping an empty label
+    }   // end of loop over labels
+
+  if (makeModelsInParallel && !surfaceExtraction.Jobs.empty())
+    {
+    int* wholeExtent = surfaceExtraction.Image->GetExtent();
+    for (std::vector<LabelSurfaceJob>::iterator jobIt = surfaceExtraction.Jobs.begin(); jobIt != surfaceExtraction.Jobs.end(); ++jobIt)
+      {
+      std::map<int, std::vector<int> >::iterator labelExtentIt = labelExtents.find(jobIt->Label);
+      if (labelExtentIt == labelExtents.end())
         {
-        if (debug)
-          {
-          std::cout << "Adding model " << labelName << " to the output scene, with filename " << fileName.c_str()
-                    << endl;
-          }
-        // each model needs a mrml node, a storage node and a display node
-        vtkNew<vtkMRMLModelNode> mnode;
-        mnode->SetScene(modelScene.GetPointer());
-        mnode->SetName(labelName.c_str());
-
-        vtkNew<vtkMRMLModelStorageNode> snode;
-        snode->SetFileName(fileName.c_str());
-        if (modelScene->AddNode(snode.GetPointer()) == NULL)
-          {
-          std::cerr << "ERROR: unable to add the storage node to the model scene" << endl;
-          }
-        vtkNew<vtkMRMLModelDisplayNode> dnode;
-        dnode->SetColor(0.5, 0.5, 0.5);
-        double *rgba;
-        if (colorNode != NULL)
+        // label is not present in the image
+        int emptyExtent[6] = { 0, -1, 0, -1, 0, -1 };
+        std::copy(emptyExtent, emptyExtent + 6, jobIt->Extent);
+        }
+      else
+        {
+        // the surface goes through the voxels around the label, so grow its extent by one voxel
+        for (int axis = 0; axis < 3; axis++)
           {
-          rgba = colorNode->GetLookupTable()->GetTableValue(i);
-          if (rgba != NULL)
-            {
-            if (debug)
-              {
-              std::cout << "Got colour: " << rgba[0] << " " << rgba[1] << " " << rgba[2] << " " << rgba[3] << endl;
-              }
-            dnode->SetColor(rgba[0], rgba[1], rgba[2]);
-            }
-          else
-            {
-            std::cerr << "Couldn't get look up table value for " << i << ", display node colour is not set (grey)"
-                      << endl;
-            }
+          jobIt->Extent[axis*2] = std::max(labelExtentIt->second[axis*2] - 1, wholeExtent[axis*2]);
+          jobIt->Extent[axis*2+1] = std::min(labelExtentIt->second[axis*2+1] + 1, wholeExtent[axis*2+1]);
           }
+        }
+      if (rootDir != "")
+        {
+        jobIt->FileName = rootDir + std::string("/") + jobIt->LabelName + std::string(".vtk");
+        }
+      else
+        {
+        std::cout << "WARNING: output directory is an empty string..." << endl;
+        jobIt->FileName = jobIt->LabelName + std::string(".vtk");
+        }
+      }
 
-        dnode->SetVisibility(1);
-        modelScene->AddNode(dnode.GetPointer());
-        if (debug)
-          {
-          std::cout << "Added display node: id = " << (dnode->GetID() == NULL ? "(null)" : dnode->GetID()) << endl;
-          std::cout << "Setting model's storage node: id = "
-                    << (snode->GetID() == NULL ? "(null)" : snode->GetID()) << endl;
-          }
-        mnode->SetAndObserveStorageNodeID(snode->GetID());
-        mnode->SetAndObserveDisplayNodeID(dnode->GetID());
-        modelScene->AddNode(mnode.GetPointer());
-
-        // put it in the hierarchy, either the flat one by default or
-        // try to find the matching color hierarchy node to make this an
-        // associated node
-        std::string colorName;
-        if (colorNode != NULL)
-          {
-          colorName = std::string(colorNode->GetColorNameAsFileName(i));
-          }
-        else
-          {
-          // might be in a testing case where the hierarchy nodes are
-          // numbered (made from the generic colors)
-          std::stringstream ss;
-          ss << i;
-          colorName = ss.str();
-          if (debug)
-            {
-            std::cout << "No color node, guessing at color name being same as label number " << colorName.c_str() << std::endl;
-            }
-          }
-        vtkMRMLNode *mrmlNode = NULL;
-        if (colorName.compare("") != 0)
-          {
-          mrmlNode = modelScene->GetFirstNodeByName(colorName.c_str());
-          }
-        // if there's no color hierarchy, or no color name or the mrml node
-        // named for the color isn't a model hierarchy node, use a flat hierarchy
-        if (topColorHierarchyNode == NULL ||
-            colorName.compare("") == 0 ||
-            mrmlNode == NULL ||
-            strcmp(mrmlNode->GetClassName(),"vtkMRMLModelHierarchyNode") != 0)
-          {
-          vtkNew<vtkMRMLModelHierarchyNode> mhnd;
-          mhnd->SetHideFromEditors(1);
-          modelScene->AddNode(mhnd.GetPointer());
-          mhnd->SetParentNodeID(rnd->GetID());
-          mhnd->SetModelNodeID(mnode->GetID());
-          }
-        else
-          {
-          // use the template color hierarchy
-          vtkMRMLModelHierarchyNode *colorHierarchyNode = vtkMRMLModelHierarchyNode::SafeDownCast(mrmlNode);
-          if (colorHierarchyNode)
-            {
-            colorHierarchyNode->SetAssociatedNodeID(mnode->GetID());
-            // and hide it so that it doesn't clutter up the tree
-            colorHierarchyNode->SetHideFromEditors(1);
-            if (debug)
-              {
-              std::cout << "Found a color hierarchy node with name " << colorHierarchyNode->GetName() << ", set it's associated node to this model id: " << mnode->GetID() << std::endl;
-              }
-            }
-          }
-        if (debug)
-          {
-          std::cout << "...done adding model to output scene" << endl;
-          }
+    if (strcmp(FilterType.c_str(), "Sinc") == 0 && Smooth == 1)
+      {
+      std::cerr << "Warning: Smoothing iterations of 1 not allowed for Sinc filter, using 2" << endl;
+      Smooth = 2;
+      }
+    vtkMatrix4x4::DeepCopy(surfaceExtraction.IJKToRAS, transformIJKtoRAS->GetMatrix());
+    surfaceExtraction.Reverse = ((transformIJKtoRAS->GetMatrix())->Determinant() < 0);
+    surfaceExtraction.SincSmoothing = (strcmp(FilterType.c_str(), "Sinc") == 0);
+    surfaceExtraction.Smooth = Smooth;
+    surfaceExtraction.Decimate = Decimate;
+    surfaceExtraction.PointNormals = PointNormals;
+    surfaceExtraction.SplitNormals = SplitNormals;
+    surfaceExtraction.NextJobIndex = 0;
+    surfaceExtraction.NumberOfCompletedJobs = 0;
+    surfaceExtraction.Aborted = false;
+    surfaceExtraction.ProcessInformation = CLPProcessInformation;
+    surfaceExtraction.ProgressStart = currentFilterOffset / numFilterSteps;
+    surfaceExtraction.ProgressPerJob = numRepeatedFilterSteps / numFilterSteps;
+    surfaceExtraction.Quiet = debug;
+
+    int numberOfThreads = std::min(vtkMultiThreader::GetGlobalDefaultNumberOfThreads(),
+                                   static_cast<int>(surfaceExtraction.Jobs.size()));
+    if (debug)
+      {
+      std::cout << "Making " << surfaceExtraction.Jobs.size() << " models in " << numberOfThreads << " threads" << endl;
+      }
+    vtkNew<vtkMultiThreader> threader;
+    threader->SetNumberOfThreads(numberOfThreads);
+    threader->SetSingleMethod(LabelSurfaceThreadFunction, &surfaceExtraction);
+    threader->SingleMethodExecute();
+    currentFilterOffset += numRepeatedFilterSteps * surfaceExtraction.Jobs.size();
+    if (surfaceExtraction.Aborted)
+      {
+      std::cerr << "Making models was aborted" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    // add the models to the scene in label order
+    for (std::vector<LabelSurfaceJob>::iterator jobIt = surfaceExtraction.Jobs.begin(); jobIt != surfaceExtraction.Jobs.end(); ++jobIt)
+      {
+      if (!jobIt->HasPolygons)
+        {
+        std::cout << "Cannot create a model from label " << jobIt->Label
+                  << "\nNo polygons can be created,\nthere may be no voxels with this label in the volume." << endl;
+        std::cout << "...continuing" << endl;
+        continue;
         }
-      } // end of skipping an empty label
-    }   // end of loop over labels
+      if (!jobIt->Written)
+        {
+        std::cerr << "ERROR: Failed to write model file " << jobIt->FileName.c_str() << std::endl;
+        }
+      AddModelToScene(modelScene.GetPointer(), rnd, topColorHierarchyNode, colorNode, jobIt->Label,
+                      jobIt->LabelName, jobIt->FileName, debug);
+      }
+    }
+
   if (debug)
     {
     std::cout << "End of looping over labels" << endl;
@@ -0,0 +1,179 @@
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataReader.h>
+
+// VTKsys includes
+#include <vtksys/Directory.hxx>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef WIN32
+#define MODULE_IMPORT __declspec(dllimport)
+#else
+#define MODULE_IMPORT
+#endif
+
+extern "C" MODULE_IMPORT int ModuleEntryPoint(int, char * []);
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Make the models of all labels of the input volume into the output directory.
+// Saving intermediate models makes the models one label at a time.
+int RunModelMaker(const std::string& inputVolume, const std::string& outputDirectory, bool saveIntermediateModels)
+{
+  vtksys::SystemTools::RemoveADirectory(outputDirectory.c_str());
+  vtksys::SystemTools::MakeDirectory(outputDirectory.c_str());
+  std::vector<std::string> arguments;
+  arguments.push_back("ModelMaker");
+  arguments.push_back("--generateAll");
+  if (saveIntermediateModels)
+    {
+    arguments.push_back("--saveIntermediateModels");
+    }
+  arguments.push_back("--modelSceneFile");
+  arguments.push_back(outputDirectory + "/ModelMakerParallelTest.mrml");
+  arguments.push_back(inputVolume);
+  std::vector<char*> argv;
+  for (std::vector<std::string>::iterator it = arguments.begin(); it != arguments.end(); ++it)
+    {
+    argv.push_back(const_cast<char*>(it->c_str()));
+    }
+  return ModuleEntryPoint(static_cast<int>(argv.size()), &argv[0]);
+}
+
+//----------------------------------------------------------------------------
+bool IsIntermediateModel(const std::string& fileName)
+{
+  const char* suffixes[3] = { "-MarchingCubes.vtk", "-Decimated.vtk", "-Smoothed.vtk" };
+  for (int i = 0; i < 3; ++i)
+    {
+    std::string suffix = suffixes[i];
+    if (fileName.size() > suffix.size()
+      && fileName.compare(fileName.size() - suffix.size(), suffix.size(), suffix) == 0)
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+bool IsSameModel(const std::string& fileName1, const std::string& fileName2)
+{
+  vtkNew<vtkPolyDataReader> reader1;
+  reader1->SetFileName(fileName1.c_str());
+  reader1->Update();
+  vtkNew<vtkPolyDataReader> reader2;
+  reader2->SetFileName(fileName2.c_str());
+  reader2->Update();
+  vtkPolyData* model1 = reader1->GetOutput();
+  vtkPolyData* model2 = reader2->GetOutput();
+  if (model1->GetNumberOfPoints() == 0
+    || model1->GetNumberOfPoints() != model2->GetNumberOfPoints()
+    || model1->GetNumberOfCells() != model2->GetNumberOfCells()
+    || model1->GetStrips()->GetNumberOfConnectivityEntries() != model2->GetStrips()->GetNumberOfConnectivityEntries())
+    {
+    std::cerr << "Models " << fileName1 << " and " << fileName2 << " have different sizes: "
+      << model1->GetNumberOfPoints() << " and " << model2->GetNumberOfPoints() << " points, "
+      << model1->GetNumberOfCells() << " and " << model2->GetNumberOfCells() << " cells" << std::endl;
+    return false;
+    }
+  for (vtkIdType pointId = 0; pointId < model1->GetNumberOfPoints(); ++pointId)
+    {
+    double point1[3] = { 0.0, 0.0, 0.0 };
+    double point2[3] = { 0.0, 0.0, 0.0 };
+    model1->GetPoint(pointId, point1);
+    model2->GetPoint(pointId, point2);
+    for (int i = 0; i < 3; ++i)
+      {
+      if (fabs(point1[i] - point2[i]) > 1e-6)
+        {
+        std::cerr << "Models " << fileName1 << " and " << fileName2 << " differ at point " << pointId << std::endl;
+        return false;
+        }
+      }
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+// Models made in parallel threads are the same as the models made one label at a time
+int ModelMakerParallelTest(int argc, char * argv[])
+{
+  if (argc < 3)
+    {
+    std::cerr << "Usage: ModelMakerParallelTest InputVolume TemporaryDirectory" << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::string inputVolume = argv[1];
+  std::string parallelDirectory = std::string(argv[2]) + "/ModelMakerParallelTest-Parallel";
+  std::string perLabelDirectory = std::string(argv[2]) + "/ModelMakerParallelTest-PerLabel";
+  if (RunModelMaker(inputVolume, parallelDirectory, false) != EXIT_SUCCESS
+    || RunModelMaker(inputVolume, perLabelDirectory, true) != EXIT_SUCCESS)
+    {
+    std::cerr << "Failed to make models of " << inputVolume << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  vtksys::Directory parallelModels;
+  parallelModels.Load(parallelDirectory.c_str());
+  int numberOfModels = 0;
+  for (unsigned long i = 0; i < parallelModels.GetNumberOfFiles(); ++i)
+    {
+    std::string fileName = parallelModels.GetFile(i);
+    if (vtksys::SystemTools::GetFilenameLastExtension(fileName) != ".vtk")
+      {
+      continue;
+      }
+    if (IsIntermediateModel(fileName))
+      {
+      std::cerr << "Intermediate model " << fileName << " is saved by the parallel run" << std::endl;
+      return EXIT_FAILURE;
+      }
+    std::string perLabelFileName = perLabelDirectory + "/" + fileName;
+    if (!vtksys::SystemTools::FileExists(perLabelFileName.c_str(), true))
+      {
+      std::cerr << "Model " << fileName << " is only made by the parallel run" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if (!IsSameModel(parallelDirectory + "/" + fileName, perLabelFileName))
+      {
+      return EXIT_FAILURE;
+      }
+    ++numberOfModels;
+    }
+
+  // all the final models of the per-label run are made by the parallel run
+  vtksys::Directory perLabelModels;
+  perLabelModels.Load(perLabelDirectory.c_str());
+  int numberOfPerLabelModels = 0;
+  for (unsigned long i = 0; i < perLabelModels.GetNumberOfFiles(); ++i)
+    {
+    std::string fileName = perLabelModels.GetFile(i);
+    if (vtksys::SystemTools::GetFilenameLastExtension(fileName) == ".vtk" && !IsIntermediateModel(fileName))
+      {
+      ++numberOfPerLabelModels;
+      }
+    }
+  if (numberOfModels == 0 || numberOfModels != numberOfPerLabelModels)
+    {
+    std::cerr << "Parallel run made " << numberOfModels << " models, per-label run made "
+      << numberOfPerLabelModels << " models" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "Compared " << numberOfModels << " models" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -29,7 +29,7 @@ class AbstractScriptedSegmentEditorAutoCompleteEffect(AbstractScriptedSegmentEdi
     # Stores merged labelmap image geometry (voxel data is not allocated)
     self.mergedLabelmapGeometryImage = None
     self.selectedSegmentIds = None
-    self.selectedSegmentModifiedTimes = {} # map from segment ID to ModifiedTime
+    self.selectedSegmentModifiedTimes = {} # map from segment ID to (labelmap ModifiedTime, segment voxels checksum)
     self.clippedMasterImageData = None
 
     # Observation for auto-update
@@ -128,12 +128,9 @@ class AbstractScriptedSegmentEditorAutoCompleteEffect(AbstractScriptedSegmentEdi
         logging.debug("Segmentation cancelled because an input segment was deleted")
         self.onCancel()
         return
-      segmentLabelmap = segment.GetRepresentation(vtkSegmentationCore.vtkSegmentationConverter.GetSegmentationBinaryLabelmapRepresentationName())
-      if self.selectedSegmentModifiedTimes.has_key(segmentID) \
-        and segmentLabelmap.GetMTime() == self.selectedSegmentModifiedTimes[segmentID]:
+      if not self.isSegmentModified(segmentation, segmentID):
         # this segment has not changed since last update
         continue
-      self.selectedSegmentModifiedTimes[segmentID] = segmentLabelmap.GetMTime()
       updateNeeded = True
       # continue so that all segment modified times are updated
 
@@ -145,6 +142,35 @@ class AbstractScriptedSegmentEditorAutoCompleteEffect(AbstractScriptedSegmentEdi
     # therefore don't update directly, just set up/reset a timer that will perform the update when it elapses.
     self.delayedAutoUpdateTimer.start()
 
+  def isSegmentModified(self, segmentation, segmentID):
+    """Check if the voxels of the segment have changed since the last check.
+    A shared labelmap is modified when any of its segments is edited, therefore
+    in that case the voxels of the segment are compared, too.
+    """
+    import vtkSegmentationCorePython as vtkSegmentationCore
+    segmentLabelmap = segmentation.GetSegment(segmentID).GetRepresentation(
+      vtkSegmentationCore.vtkSegmentationConverter.GetSegmentationBinaryLabelmapRepresentationName())
+    modifiedTime = segmentLabelmap.GetMTime() if segmentLabelmap else 0
+    previousState = self.selectedSegmentModifiedTimes.get(segmentID)
+    if previousState and previousState[0] == modifiedTime:
+      return False
+    checksum = None
+    if segmentLabelmap and segmentation.IsSharedBinaryLabelmap(segmentID):
+      segmentBinaryLabelmap = vtkSegmentationCore.vtkOrientedImageData()
+      segmentation.GetSegmentBinaryLabelmap(segmentID, segmentBinaryLabelmap)
+      checksum = self.getLabelmapChecksum(segmentBinaryLabelmap)
+    self.selectedSegmentModifiedTimes[segmentID] = (modifiedTime, checksum)
+    return not previousState or checksum is None or checksum != previousState[1]
+
+  def getLabelmapChecksum(self, labelmap):
+    import hashlib
+    from vtk.util import numpy_support
+    checksum = hashlib.md5(str(labelmap.GetExtent()))
+    scalars = labelmap.GetPointData().GetScalars()
+    if scalars:
+      checksum.update(numpy_support.vtk_to_numpy(scalars).tobytes())
+    return checksum.hexdigest()
+
   def observeSegmentation(self, observationEnabled):
     import vtkSegmentationCorePython as vtkSegmentationCore
     segmentation = self.scriptedEffect.parameterSetNode().GetSegmentationNode().GetSegmentation()
@@ -255,8 +281,8 @@ class AbstractScriptedSegmentEditorAutoCompleteEffect(AbstractScriptedSegmentEdi
     previewNode.GetSegmentation().GetSegmentIDs(segmentIDs)
     for index in xrange(segmentIDs.GetNumberOfValues()):
       segmentID = segmentIDs.GetValue(index)
-      previewSegment = previewNode.GetSegmentation().GetSegment(segmentID)
-      previewSegmentLabelmap = previewSegment.GetRepresentation(vtkSegmentationCore.vtkSegmentationConverter.GetSegmentationBinaryLabelmapRepresentationName())
+      previewSegmentLabelmap = vtkSegmentationCore.vtkOrientedImageData()
+      previewNode.GetSegmentation().GetSegmentBinaryLabelmap(segmentID, previewSegmentLabelmap)
       slicer.vtkSlicerSegmentationsModuleLogic.SetBinaryLabelmapToSegment(previewSegmentLabelmap, segmentationNode, segmentID)
       previewNode.GetSegmentation().RemoveSegment(segmentID) # delete now to limit memory usage
 
@@ -296,6 +322,10 @@ class AbstractScriptedSegmentEditorAutoCompleteEffect(AbstractScriptedSegmentEdi
       if self.selectedSegmentIds.GetNumberOfValues() < self.minimumNumberOfSegments:
         logging.error("Auto-complete operation skipped: at least {0} visible segments are required".format(self.minimumNumberOfSegments))
         return
+      # Input segments get their own labelmap, so that the modified time of their labelmap
+      # does not change when other segments of a shared labelmap are edited
+      for index in xrange(self.selectedSegmentIds.GetNumberOfValues()):
+        segmentationNode.GetSegmentation().SeparateSegmentLabelmap(self.selectedSegmentIds.GetValue(index))
       if not self.mergedLabelmapGeometryImage:
         self.mergedLabelmapGeometryImage = vtkSegmentationCore.vtkOrientedImageData()
       commonGeometryString = segmentationNode.GetSegmentation().DetermineCommonLabelmapGeometry(
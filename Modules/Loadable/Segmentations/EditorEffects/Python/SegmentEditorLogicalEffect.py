@@ -198,8 +198,9 @@ class SegmentEditorLogicalEffect(AbstractScriptedSegmentEditorEffect):
       if not modifierSegmentID:
         logging.error("Operation {0} requires a selected modifier segment".format(operation))
         return
-      modifierSegment = segmentation.GetSegment(modifierSegmentID)
-      modifierSegmentLabelmap = modifierSegment.GetRepresentation(vtkSegmentationCore.vtkSegmentationConverter.GetSegmentationBinaryLabelmapRepresentationName())
+      # Only the voxels of the modifier segment, even if its labelmap is shared with other segments
+      modifierSegmentLabelmap = vtkSegmentationCore.vtkOrientedImageData()
+      segmentation.GetSegmentBinaryLabelmap(modifierSegmentID, modifierSegmentLabelmap)
 
       if operation == LOGICAL_COPY:
         if bypassMasking:
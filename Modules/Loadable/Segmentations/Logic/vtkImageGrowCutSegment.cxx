@@ -1,19 +1,19 @@
 #include "vtkImageGrowCutSegment.h"
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 
 #include <vtkInformation.h>
 #include <vtkInformationVector.h>
 #include <vtkLoggingMacros.h>
+#include <vtkMultiThreader.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkSmartPointer.h>
 #include <vtkStreamingDemandDrivenPipeline.h>
 #include <vtkTimerLog.h>
 
-#include "FibHeap.h"
-
 vtkStandardNewMacro(vtkImageGrowCutSegment);
 
 //----------------------------------------------------------------------------
@@ -22,58 +22,213 @@ const int DistancePixelTypeID = VTK_FLOAT;
 const DistancePixelType DIST_INF = std::numeric_limits<DistancePixelType>::max();
 const DistancePixelType DIST_EPSILON = 1e-3;
 
+namespace
+{
 //----------------------------------------------------------------------------
-class HeapNode : public FibHeapNode
+// Voxel waiting for propagating its label to its neighbors.
+// Entries are stored in a flat binary heap (std::push_heap/std::pop_heap).
+// The same voxel may be inserted multiple times, entries that have a larger
+// distance than the current distance of the voxel are ignored.
+struct HeapEntry
 {
-public:
-  HeapNode()
-  : FibHeapNode()
-  , m_Key(0)
-  , m_Index(-1)
+  DistancePixelType Distance;
+  long Index;
+
+  // std heap functions keep the largest element on top, therefore
+  // the comparison is reversed to get the voxel with the smallest distance first.
+  // Voxels at the same distance are processed in the order of their index, so that
+  // the result does not depend on the order of insertion.
+  bool operator<(const HeapEntry& other) const
   {
+    if (this->Distance != other.Distance)
+      {
+      return this->Distance > other.Distance;
+      }
+    return this->Index > other.Index;
   }
+};
 
-  virtual void operator =(FibHeapNode& RHS)
-  {
-    FHN_Assign(RHS);
-    m_Key = ((HeapNode&)RHS).m_Key;
-  }
+//----------------------------------------------------------------------------
+// Label propagated to a voxel that is processed by another thread
+template<typename LabelPixelType>
+struct RegionMessage
+{
+  long Index;
+  DistancePixelType Distance;
+  LabelPixelType Label;
+};
 
-  virtual int operator ==(FibHeapNode& RHS)
-  {
-    if (FHN_Cmp(RHS))
+//----------------------------------------------------------------------------
+// The volume is split into slabs of slices, each processed by a different thread.
+// Labels that are propagated across slab boundaries are passed to the thread
+// of the neighbor slab as messages, which are processed in the next round.
+// Rounds are repeated until there are no more messages.
+template<typename IntensityPixelType, typename LabelPixelType>
+struct GrowCutJob
+{
+  IntensityPixelType* IntensityVolumePtr;
+  LabelPixelType* SeedLabelVolumePtr;
+  LabelPixelType* ResultLabelVolumePtr;
+  DistancePixelType* DistanceVolumePtr;
+  unsigned char* UpdatedVolumePtr;
+  const unsigned char* NumberOfNeighborsPtr;
+  const long* NeighborIndexOffsetsPtr;
+  bool FullComputation;
+  int Round;
+  int NumberOfRegions;
+  // Index of the first voxel of each slab (and the number of voxels at the end)
+  std::vector<long> RegionStartIndices;
+  // Messages sent in this round and received from the previous round,
+  // indexed by sourceRegion * NumberOfRegions + targetRegion.
+  std::vector< std::vector< RegionMessage<LabelPixelType> > > SentMessages;
+  std::vector< std::vector< RegionMessage<LabelPixelType> > > ReceivedMessages;
+};
+
+//----------------------------------------------------------------------------
+// Set the distance and label of a voxel if the new distance is shorter.
+// If the distance is the same then the smaller label wins, so that the result
+// does not depend on which region reaches the voxel first.
+// Voxels that have not been updated in the current run keep the result of the previous
+// run, which is replaced by the new label if the new distance is not longer (so that
+// changed seeds take over their previous region).
+template<typename IntensityPixelType, typename LabelPixelType>
+inline void UpdateVoxel(GrowCutJob<IntensityPixelType, LabelPixelType>* job,
+  long index, DistancePixelType distance, LabelPixelType label, std::vector<HeapEntry>& heap)
+{
+  if (job->UpdatedVolumePtr[index])
+    {
+    if (distance > job->DistanceVolumePtr[index]
+      || (distance == job->DistanceVolumePtr[index] && label >= job->ResultLabelVolumePtr[index]))
       {
-      return 0;
+      return;
       }
-    return m_Key == ((HeapNode&)RHS).m_Key ? 1 : 0;
-  }
+    }
+  else
+    {
+    if (distance > job->DistanceVolumePtr[index]
+      || (distance == job->DistanceVolumePtr[index] && label == job->ResultLabelVolumePtr[index]))
+      {
+      return;
+      }
+    job->UpdatedVolumePtr[index] = 1;
+    }
+  job->DistanceVolumePtr[index] = distance;
+  job->ResultLabelVolumePtr[index] = label;
+  HeapEntry entry;
+  entry.Distance = distance;
+  entry.Index = index;
+  heap.push_back(entry);
+  std::push_heap(heap.begin(), heap.end());
+}
 
-  virtual int operator <(FibHeapNode& RHS)
-  {
-    int x = FHN_Cmp(RHS);
-    if (x != 0)
+//----------------------------------------------------------------------------
+template<typename IntensityPixelType, typename LabelPixelType>
+VTK_THREAD_RETURN_TYPE GrowCutThreaderCallback(void *arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  GrowCutJob<IntensityPixelType, LabelPixelType>* job =
+    static_cast< GrowCutJob<IntensityPixelType, LabelPixelType>* >(info->UserData);
+  int region = info->ThreadID;
+  if (region >= job->NumberOfRegions)
+    {
+    return VTK_THREAD_RETURN_VALUE;
+    }
+  const long regionStartIndex = job->RegionStartIndices[region];
+  const long regionEndIndex = job->RegionStartIndices[region + 1];
+  LabelPixelType* seedLabelVolumePtr = job->SeedLabelVolumePtr;
+  LabelPixelType* resultLabelVolumePtr = job->ResultLabelVolumePtr;
+  DistancePixelType* distanceVolumePtr = job->DistanceVolumePtr;
+  IntensityPixelType* imSrc = job->IntensityVolumePtr;
+
+  std::vector<HeapEntry> heap;
+  if (job->Round == 0)
+    {
+    // Start growing from the seeds
+    for (long index = regionStartIndex; index < regionEndIndex; index++)
+      {
+      LabelPixelType seedValue = seedLabelVolumePtr[index];
+      job->UpdatedVolumePtr[index] = 0;
+      if (job->FullComputation)
+        {
+        resultLabelVolumePtr[index] = seedValue;
+        distanceVolumePtr[index] = (seedValue == 0 ? DIST_INF : DIST_EPSILON);
+        }
+      else if (seedValue == 0
+        || (resultLabelVolumePtr[index] == seedValue && distanceVolumePtr[index] <= DIST_EPSILON))
+        {
+        // Only grow from new/changed seeds, the rest of the previous result is kept
+        continue;
+        }
+      if (seedValue != 0)
+        {
+        job->UpdatedVolumePtr[index] = 1;
+        resultLabelVolumePtr[index] = seedValue;
+        distanceVolumePtr[index] = DIST_EPSILON;
+        HeapEntry entry;
+        entry.Distance = DIST_EPSILON;
+        entry.Index = index;
+        heap.push_back(entry);
+        }
+      }
+    std::make_heap(heap.begin(), heap.end());
+    }
+  else
+    {
+    // Continue growing from labels that were propagated from neighbor regions
+    for (int sourceRegion = 0; sourceRegion < job->NumberOfRegions; sourceRegion++)
       {
-      return x < 0 ? 1 : 0;
+      const std::vector< RegionMessage<LabelPixelType> >& messages =
+        job->ReceivedMessages[sourceRegion * job->NumberOfRegions + region];
+      for (typename std::vector< RegionMessage<LabelPixelType> >::const_iterator messageIt = messages.begin();
+        messageIt != messages.end(); ++messageIt)
+        {
+        UpdateVoxel(job, messageIt->Index, messageIt->Distance, messageIt->Label, heap);
+        }
       }
-    return m_Key < ((HeapNode&)RHS).m_Key ? 1 : 0;
-  }
+    }
 
-  virtual void operator =(DistancePixelType newKeyVal)
-  {
-    HeapNode tmp;
-    tmp.m_Key = m_Key = newKeyVal;
-    FHN_Assign(tmp);
-  }
+  // Dijkstra
+  while (!heap.empty())
+    {
+    std::pop_heap(heap.begin(), heap.end());
+    HeapEntry current = heap.back();
+    heap.pop_back();
+    long index = current.Index;
+    DistancePixelType currentDistance = current.Distance;
+    if (currentDistance > distanceVolumePtr[index])
+      {
+      // voxel has been reached since on a shorter path
+      continue;
+      }
+    LabelPixelType currentLabel = resultLabelVolumePtr[index];
 
-  inline DistancePixelType GetKeyValue() { return m_Key; }
-  inline void SetKeyValue(DistancePixelType keyValue) { m_Key = keyValue; }
-  inline long int GetIndexValue() { return m_Index; }
-  inline void SetIndexValue(long int indexValue) { m_Index = indexValue; }
+    // Update neighbors
+    DistancePixelType pixCenter = imSrc[index];
+    unsigned char nbSize = job->NumberOfNeighborsPtr[index];
+    for (unsigned char i = 0; i < nbSize; i++)
+      {
+      long indexNgbh = index + job->NeighborIndexOffsetsPtr[i];
+      DistancePixelType neighborNewDistance = fabs(pixCenter - imSrc[indexNgbh]) + currentDistance;
+      if (indexNgbh >= regionStartIndex && indexNgbh < regionEndIndex)
+        {
+        UpdateVoxel(job, indexNgbh, neighborNewDistance, currentLabel, heap);
+        }
+      else
+        {
+        // Neighbors are at most one slice away, therefore they are in the previous or next region
+        int targetRegion = (indexNgbh < regionStartIndex ? region - 1 : region + 1);
+        RegionMessage<LabelPixelType> message;
+        message.Index = indexNgbh;
+        message.Distance = neighborNewDistance;
+        message.Label = currentLabel;
+        job->SentMessages[region * job->NumberOfRegions + targetRegion].push_back(message);
+        }
+      }
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
 
-protected:
-  DistancePixelType m_Key;
-  long m_Index;
-};
+} // end of anonymous namespace
 
 //----------------------------------------------------------------------------
 class vtkImageGrowCutSegment::vtkInternal
@@ -97,31 +252,30 @@ public:
   bool ExecuteGrowCut2(vtkImageData *intensityVolume, vtkImageData *seedLabelVolume);
 
   vtkSmartPointer<vtkImageData> m_DistanceVolume;
-  vtkSmartPointer<vtkImageData> m_DistanceVolumePre;
   vtkSmartPointer<vtkImageData> m_ResultLabelVolume;
-  vtkSmartPointer<vtkImageData> m_ResultLabelVolumePre;
 
   long m_DimX;
   long m_DimY;
   long m_DimZ;
   std::vector<long> m_NeighborIndexOffsets;
   std::vector<unsigned char> m_NumberOfNeighbors;
+  // Nonzero for voxels whose label has been updated in the current run
+  std::vector<unsigned char> m_UpdatedVoxels;
 
-  FibHeap *m_Heap;
-  HeapNode *m_HeapNodes;
+  int m_NumberOfThreads;
   bool m_bSegInitialized;
+  // Reused by all rounds and runs
+  vtkSmartPointer<vtkMultiThreader> m_Threader;
 };
 
 //-----------------------------------------------------------------------------
 vtkImageGrowCutSegment::vtkInternal::vtkInternal()
 {
-  m_Heap = NULL;
-  m_HeapNodes = NULL;
+  m_NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
   m_bSegInitialized = false;
   m_DistanceVolume = vtkSmartPointer<vtkImageData>::New();
-  m_DistanceVolumePre = vtkSmartPointer<vtkImageData>::New();
   m_ResultLabelVolume = vtkSmartPointer<vtkImageData>::New();
-  m_ResultLabelVolumePre = vtkSmartPointer<vtkImageData>::New();
+  m_Threader = vtkSmartPointer<vtkMultiThreader>::New();
 };
 
 //-----------------------------------------------------------------------------
@@ -133,21 +287,11 @@ vtkImageGrowCutSegment::vtkInternal::~vtkInternal()
 //-----------------------------------------------------------------------------
 void vtkImageGrowCutSegment::vtkInternal::Reset()
 {
-  if (m_Heap != NULL)
-    {
-    delete m_Heap;
-    m_Heap = NULL;
-    }
-  if (m_HeapNodes != NULL)
-    {
-    delete[]m_HeapNodes;
-    m_HeapNodes = NULL;
-    }
   m_bSegInitialized = false;
   m_DistanceVolume->Initialize();
-  m_DistanceVolumePre->Initialize();
   m_ResultLabelVolume->Initialize();
-  m_ResultLabelVolumePre->Initialize();
+  std::vector<unsigned char>().swap(m_NumberOfNeighbors);
+  std::vector<unsigned char>().swap(m_UpdatedVoxels);
 }
 
 //-----------------------------------------------------------------------------
@@ -156,123 +300,70 @@ bool vtkImageGrowCutSegment::vtkInternal::InitializationAHP(
     vtkImageData *vtkNotUsed(intensityVolume),
     vtkImageData *seedLabelVolume)
 {
-  m_Heap = new FibHeap;
+  if (m_bSegInitialized)
+    {
+    // Already initialized, the previous result is updated
+    return true;
+    }
+
   long dimXYZ = m_DimX * m_DimY * m_DimZ;
-  if ((m_HeapNodes = new HeapNode[dimXYZ + 1]) == NULL)
+  m_ResultLabelVolume->SetOrigin(seedLabelVolume->GetOrigin());
+  m_ResultLabelVolume->SetSpacing(seedLabelVolume->GetSpacing());
+  m_ResultLabelVolume->SetExtent(seedLabelVolume->GetExtent());
+  m_ResultLabelVolume->AllocateScalars(seedLabelVolume->GetScalarType(), 1);
+  m_DistanceVolume->SetOrigin(seedLabelVolume->GetOrigin());
+  m_DistanceVolume->SetSpacing(seedLabelVolume->GetSpacing());
+  m_DistanceVolume->SetExtent(seedLabelVolume->GetExtent());
+  m_DistanceVolume->AllocateScalars(DistancePixelTypeID, 1);
+  if (!m_ResultLabelVolume->GetScalarPointer() || !m_DistanceVolume->GetScalarPointer())
     {
     vtkGenericWarningMacro("Memory allocation failed. Dimensions: " << m_DimX << "x" << m_DimY << "x" << m_DimZ);
     return false;
     }
-  LabelPixelType* seedLabelVolumePtr = static_cast<LabelPixelType*>(seedLabelVolume->GetScalarPointer());
-
-  if (!m_bSegInitialized)
+  m_UpdatedVoxels.resize(dimXYZ);
+
+  // Compute index offset
+  m_NeighborIndexOffsets.clear();
+  // Neighbors are traversed in the order of m_NeighborIndexOffsets,
+  // therefore one would expect that the offsets should
+  // be as continuous as possible (e.g., x coordinate
+  // should change most quickly), but that resulted in
+  // about 5-6% longer computation time. Therefore,
+  // we put indices in order x1y1z1, x1y1z2, x1y1z3, etc.
+  for (int ix = -1; ix <= 1; ix++)
     {
-    m_ResultLabelVolume->SetOrigin(seedLabelVolume->GetOrigin());
-    m_ResultLabelVolume->SetSpacing(seedLabelVolume->GetSpacing());
-    m_ResultLabelVolume->SetExtent(seedLabelVolume->GetExtent());
-    m_ResultLabelVolume->AllocateScalars(seedLabelVolume->GetScalarType(), 1);
-    m_DistanceVolume->SetOrigin(seedLabelVolume->GetOrigin());
-    m_DistanceVolume->SetSpacing(seedLabelVolume->GetSpacing());
-    m_DistanceVolume->SetExtent(seedLabelVolume->GetExtent());
-    m_DistanceVolume->AllocateScalars(DistancePixelTypeID, 1);
-    m_ResultLabelVolumePre->SetExtent(0, -1, 0, -1, 0, -1);
-    m_ResultLabelVolumePre->AllocateScalars(seedLabelVolume->GetScalarType(), 1);
-    m_DistanceVolumePre->SetExtent(0, -1, 0, -1, 0, -1);
-    m_DistanceVolumePre->AllocateScalars(DistancePixelTypeID, 1);
-    LabelPixelType* resultLabelVolumePtr = static_cast<LabelPixelType*>(m_ResultLabelVolume->GetScalarPointer());
-    DistancePixelType* distanceVolumePtr = static_cast<DistancePixelType*>(m_DistanceVolume->GetScalarPointer());
-
-    // Compute index offset
-    m_NeighborIndexOffsets.clear();
-    // Neighbors are traversed in the order of m_NeighborIndexOffsets,
-    // therefore one would expect that the offsets should
-    // be as continuous as possible (e.g., x coordinate
-    // should change most quickly), but that resulted in
-    // about 5-6% longer computation time. Therefore,
-    // we put indices in order x1y1z1, x1y1z2, x1y1z3, etc.
-    for (int ix = -1; ix <= 1; ix++)
-      {
-      for (int iy = -1; iy <= 1; iy++)
-        {
-        for (int iz = -1; iz <= 1; iz++)
-          {
-          if (ix == 0 && iy == 0 && iz == 0)
-            {
-            continue;
-            }
-          m_NeighborIndexOffsets.push_back(long(ix) + m_DimX*(long(iy) + m_DimY*long(iz)));
-          }
-        }
-      }
-
-    // Determine neighborhood size for computation at each voxel.
-    // The neighborhood size is everwhere the same (size of m_NeighborIndexOffsets)
-    // except at the edges of the volume, where the neighborhood size is 0.
-    m_NumberOfNeighbors.resize(dimXYZ);
-    const unsigned char numberOfNeighbors = m_NeighborIndexOffsets.size();
-    unsigned char* nbSizePtr = &(m_NumberOfNeighbors[0]);
-    for (int z = 0; z < m_DimZ; z++)
+    for (int iy = -1; iy <= 1; iy++)
       {
-      bool zEdge = (z == 0 || z == m_DimZ - 1);
-      for (int y = 0; y < m_DimY; y++)
+      for (int iz = -1; iz <= 1; iz++)
         {
-        bool yEdge = (y == 0 || y == m_DimY - 1);
-        *(nbSizePtr++) = 0; // x == 0 (there is always padding, so we don'neighborNewDistance need to check if m_DimX>0)
-        unsigned char nbSize = (zEdge || yEdge) ? 0 : numberOfNeighbors;
-        for (int x = m_DimX-2; x > 0; x--)
+        if (ix == 0 && iy == 0 && iz == 0)
           {
-          *(nbSizePtr++) = nbSize;
+          continue;
           }
-        *(nbSizePtr++) = 0; // x == m_DimX-1 (there is always padding, so we don'neighborNewDistance need to check if m_DimX>1)
+        m_NeighborIndexOffsets.push_back(long(ix) + m_DimX*(long(iy) + m_DimY*long(iz)));
         }
       }
-
-    for (long index = 0; index < dimXYZ; index++)
-      {
-      LabelPixelType seedValue = seedLabelVolumePtr[index];
-      resultLabelVolumePtr[index] = seedValue;
-      if (seedValue == 0)
-        {
-        m_HeapNodes[index] = DIST_INF;
-        distanceVolumePtr[index] = DIST_INF;
-        }
-      else
-        {
-        m_HeapNodes[index] = DIST_EPSILON;
-        distanceVolumePtr[index] = DIST_EPSILON;
-        }
-      m_Heap->Insert(&m_HeapNodes[index]);
-      m_HeapNodes[index].SetIndexValue(index);
-      }
     }
-  else
-    {
-    // Already initialized
-    LabelPixelType* resultLabelVolumePtr = static_cast<LabelPixelType*>(m_ResultLabelVolume->GetScalarPointer());
-    DistancePixelType* distanceVolumePtr = static_cast<DistancePixelType*>(m_DistanceVolume->GetScalarPointer());
 
-    for (long index = 0; index < dimXYZ; index++)
+  // Determine neighborhood size for computation at each voxel.
+  // The neighborhood size is everwhere the same (size of m_NeighborIndexOffsets)
+  // except at the edges of the volume, where the neighborhood size is 0.
+  m_NumberOfNeighbors.resize(dimXYZ);
+  const unsigned char numberOfNeighbors = m_NeighborIndexOffsets.size();
+  unsigned char* nbSizePtr = &(m_NumberOfNeighbors[0]);
+  for (int z = 0; z < m_DimZ; z++)
+    {
+    bool zEdge = (z == 0 || z == m_DimZ - 1);
+    for (int y = 0; y < m_DimY; y++)
       {
-      if (seedLabelVolumePtr[index] != 0)
-        {
-        // Only grow from new/changed seeds
-        if (resultLabelVolumePtr[index] != seedLabelVolumePtr[index])
-          {
-          m_HeapNodes[index] = DIST_EPSILON;
-          distanceVolumePtr[index] = DIST_EPSILON;
-          resultLabelVolumePtr[index] = seedLabelVolumePtr[index];
-          m_Heap->Insert(&m_HeapNodes[index]);
-          m_HeapNodes[index].SetIndexValue(index);
-          }
-        }
-      else
+      bool yEdge = (y == 0 || y == m_DimY - 1);
+      *(nbSizePtr++) = 0; // x == 0 (there is always padding, so we don'neighborNewDistance need to check if m_DimX>0)
+      unsigned char nbSize = (zEdge || yEdge) ? 0 : numberOfNeighbors;
+      for (int x = m_DimX-2; x > 0; x--)
         {
-        m_HeapNodes[index] = DIST_INF;
-        distanceVolumePtr[index] = DIST_INF;
-        resultLabelVolumePtr[index] = 0;
-        m_Heap->Insert(&m_HeapNodes[index]);
-        m_HeapNodes[index].SetIndexValue(index);
+        *(nbSizePtr++) = nbSize;
         }
+      *(nbSizePtr++) = 0; // x == m_DimX-1 (there is always padding, so we don'neighborNewDistance need to check if m_DimX>1)
       }
     }
   return true;
@@ -282,133 +373,58 @@ bool vtkImageGrowCutSegment::vtkInternal::InitializationAHP(
 template<typename IntensityPixelType, typename LabelPixelType>
 void vtkImageGrowCutSegment::vtkInternal::DijkstraBasedClassificationAHP(
     vtkImageData *intensityVolume,
-    vtkImageData *vtkNotUsed(seedLabelVolume))
+    vtkImageData *seedLabelVolume)
 {
-  LabelPixelType* resultLabelVolumePtr = static_cast<LabelPixelType*>(m_ResultLabelVolume->GetScalarPointer());
-  IntensityPixelType* imSrc = static_cast<IntensityPixelType*>(intensityVolume->GetScalarPointer());
-
-  // Insert 0 then extract it, which will balance heap
-  HeapNode hnZero;
-  m_Heap->Insert(&hnZero);
-  m_Heap->ExtractMin();
-
-  if (!m_bSegInitialized)
+  GrowCutJob<IntensityPixelType, LabelPixelType> job;
+  job.IntensityVolumePtr = static_cast<IntensityPixelType*>(intensityVolume->GetScalarPointer());
+  job.SeedLabelVolumePtr = static_cast<LabelPixelType*>(seedLabelVolume->GetScalarPointer());
+  job.ResultLabelVolumePtr = static_cast<LabelPixelType*>(m_ResultLabelVolume->GetScalarPointer());
+  job.DistanceVolumePtr = static_cast<DistancePixelType*>(m_DistanceVolume->GetScalarPointer());
+  job.UpdatedVolumePtr = &(m_UpdatedVoxels[0]);
+  job.NumberOfNeighborsPtr = &(m_NumberOfNeighbors[0]);
+  job.NeighborIndexOffsetsPtr = &(m_NeighborIndexOffsets[0]);
+  // Full computation (to be used in initializing the segmenter for the current image)
+  // or adaptive update that only propagates the new/changed seeds
+  job.FullComputation = !m_bSegInitialized;
+
+  // Split the volume to slabs. Slabs that are too thin would just
+  // pass most of the voxels to their neighbors.
+  const long minimumNumberOfSlicesPerRegion = 16;
+  long numberOfRegions = std::min(static_cast<long>(std::max(m_NumberOfThreads, 1)),
+    std::max(m_DimZ / minimumNumberOfSlicesPerRegion, 1L));
+  job.NumberOfRegions = static_cast<int>(numberOfRegions);
+  long sliceSize = m_DimX * m_DimY;
+  for (long region = 0; region <= numberOfRegions; region++)
     {
-    // Full computation
-    DistancePixelType* distanceVolumePtr = static_cast<DistancePixelType*>(m_DistanceVolume->GetScalarPointer());
-    LabelPixelType* resultLabelVolumePtr = static_cast<LabelPixelType*>(m_ResultLabelVolume->GetScalarPointer());
+    job.RegionStartIndices.push_back(sliceSize * (m_DimZ * region / numberOfRegions));
+    }
+  job.SentMessages.resize(numberOfRegions * numberOfRegions);
+  job.ReceivedMessages.resize(numberOfRegions * numberOfRegions);
 
-    // Normal Dijkstra (to be used in initializing the segmenter for the current image)
-    HeapNode hnTmp;
-    while (!m_Heap->IsEmpty())
+  m_Threader->SetNumberOfThreads(job.NumberOfRegions);
+  m_Threader->SetSingleMethod(GrowCutThreaderCallback<IntensityPixelType, LabelPixelType>, &job);
+  for (job.Round = 0; ; job.Round++)
+    {
+    for (size_t i = 0; i < job.SentMessages.size(); i++)
       {
-      HeapNode* hnMin = (HeapNode *)m_Heap->ExtractMin();
-      long index = hnMin->GetIndexValue();
-      DistancePixelType currentDistance = hnMin->GetKeyValue();
-      LabelPixelType currentLabel = resultLabelVolumePtr[index];
-      distanceVolumePtr[index] = currentDistance;
-
-      // Update neighbors
-      DistancePixelType pixCenter = imSrc[index];
-      unsigned char nbSize = m_NumberOfNeighbors[index];
-      for (unsigned char i = 0; i < nbSize; i++)
-        {
-        long indexNgbh = index + m_NeighborIndexOffsets[i];
-        DistancePixelType neighborCurrentDistance = distanceVolumePtr[indexNgbh];
-        DistancePixelType neighborNewDistance = fabs(pixCenter - imSrc[indexNgbh]) + currentDistance;
-        if (neighborCurrentDistance > neighborNewDistance)
-          {
-          distanceVolumePtr[indexNgbh] = neighborNewDistance;
-          resultLabelVolumePtr[indexNgbh] = currentLabel;
-
-          hnTmp = m_HeapNodes[indexNgbh];
-          hnTmp.SetKeyValue(neighborNewDistance);
-          m_Heap->DecreaseKey(&m_HeapNodes[indexNgbh], hnTmp);
-          }
-        }
+      job.SentMessages[i].clear();
       }
-    }
-  else
-    {
-    // Quick update
-
-    LabelPixelType* resultLabelVolumePrePtr = static_cast<LabelPixelType*>(m_ResultLabelVolumePre->GetScalarPointer());
-
-    // Adaptive Dijkstra
-    HeapNode hnTmp;
-    long dimXYZ = m_DimX * m_DimY * m_DimZ;
-    while (!m_Heap->IsEmpty())
+    m_Threader->SingleMethodExecute();
+    size_t numberOfMessages = 0;
+    for (size_t i = 0; i < job.SentMessages.size(); i++)
       {
-      DistancePixelType* distanceVolumePrePtr = static_cast<DistancePixelType*>(m_DistanceVolumePre->GetScalarPointer());
-      DistancePixelType* distanceVolumePtr = static_cast<DistancePixelType*>(m_DistanceVolume->GetScalarPointer());
-
-      HeapNode* hnMin = (HeapNode *)m_Heap->ExtractMin();
-      DistancePixelType currentDistance = hnMin->GetKeyValue();
-
-      // Stop of minimum value is infinite
-      if (currentDistance == DIST_INF)
-        {
-        for (long index = 0; index < dimXYZ; index++)
-          {
-          if (resultLabelVolumePtr[index] == 0)
-            {
-            resultLabelVolumePtr[index] = resultLabelVolumePrePtr[index];
-            distanceVolumePtr[index] = distanceVolumePrePtr[index];
-            }
-          }
-        break;
-        }
-
-      // Stop propagation when the new distance is larger than the previous one
-      long index = hnMin->GetIndexValue();
-      if (currentDistance > distanceVolumePrePtr[index])
-        {
-        distanceVolumePtr[index] = distanceVolumePrePtr[index];
-        resultLabelVolumePtr[index] = resultLabelVolumePrePtr[index];
-        continue;
-        }
-
-      LabelPixelType currentLabel = resultLabelVolumePtr[index];
-      distanceVolumePtr[index] = currentDistance;
-
-      // Update neighbors
-      DistancePixelType pixCenter = imSrc[index];
-      unsigned char nbSize = m_NumberOfNeighbors[index];
-      for (unsigned char i = 0; i < nbSize; i++)
-        {
-        long indexNgbh = index + m_NeighborIndexOffsets[i];
-        DistancePixelType neighborCurrentDistance = distanceVolumePtr[indexNgbh];
-        DistancePixelType neighborNewDistance = fabs(pixCenter - imSrc[indexNgbh]) + currentDistance;
-        if (neighborCurrentDistance > neighborNewDistance)
-          {
-          distanceVolumePtr[indexNgbh] = neighborNewDistance;
-          resultLabelVolumePtr[indexNgbh] = currentLabel;
-
-          hnTmp = m_HeapNodes[indexNgbh];
-          hnTmp.SetKeyValue(neighborNewDistance);
-          m_Heap->DecreaseKey(&m_HeapNodes[indexNgbh], hnTmp);
-          }
-        }
+      numberOfMessages += job.SentMessages[i].size();
+      }
+    if (numberOfMessages == 0)
+      {
+      break;
       }
+    job.ReceivedMessages.swap(job.SentMessages);
     }
 
-  // Update previous labels and distance information
-  m_ResultLabelVolumePre->DeepCopy(m_ResultLabelVolume);
-  m_DistanceVolumePre->DeepCopy(m_DistanceVolume);
+  m_ResultLabelVolume->Modified();
+  m_DistanceVolume->Modified();
   m_bSegInitialized = true;
-
-  // Release memory
-  if (m_Heap != NULL)
-    {
-    delete m_Heap;
-    m_Heap = NULL;
-    }
-  //m_HeapNodes.clear();
-  if (m_HeapNodes != NULL)
-    {
-    delete[] m_HeapNodes;
-    m_HeapNodes = NULL;
-    }
 }
 
 //-----------------------------------------------------------------------------
@@ -558,6 +574,24 @@ void vtkImageGrowCutSegment::Reset()
   this->Internal->Reset();
 }
 
+//-----------------------------------------------------------------------------
+void vtkImageGrowCutSegment::SetNumberOfThreads(int numberOfThreads)
+{
+  numberOfThreads = std::max(1, std::min(numberOfThreads, VTK_MAX_THREADS));
+  if (this->Internal->m_NumberOfThreads == numberOfThreads)
+    {
+    return;
+    }
+  this->Internal->m_NumberOfThreads = numberOfThreads;
+  this->Modified();
+}
+
+//-----------------------------------------------------------------------------
+int vtkImageGrowCutSegment::GetNumberOfThreads()
+{
+  return this->Internal->m_NumberOfThreads;
+}
+
 //-----------------------------------------------------------------------------
 void vtkImageGrowCutSegment::PrintSelf(ostream &os, vtkIndent indent)
 {
@@ -23,6 +23,12 @@ public:
   // This method has to be called if intensity volume changes or if seeds are deleted after initial computation.
   void Reset();
 
+  // Set the maximum number of threads that grow the regions.
+  // By default the global default number of threads of vtkMultiThreader is used.
+  // The value is clamped between 1 and VTK_MAX_THREADS.
+  void SetNumberOfThreads(int numberOfThreads);
+  int GetNumberOfThreads();
+
 protected:
   vtkImageGrowCutSegment();
   virtual ~vtkImageGrowCutSegment();
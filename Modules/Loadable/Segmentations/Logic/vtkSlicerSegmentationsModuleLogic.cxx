@@ -733,9 +733,14 @@ bool vtkSlicerSegmentationsModuleLogic::ExportSegmentToRepresentationNode(vtkSeg
       return false;
       }
 
-    // Export binary labelmap representation into labelmap volume node
-    vtkOrientedImageData* orientedImageData = vtkOrientedImageData::SafeDownCast(
-      segment->GetRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()) );
+    // Export binary labelmap representation into labelmap volume node.
+    // Only the voxels of this segment are exported if its labelmap is shared with other segments.
+    vtkSmartPointer<vtkOrientedImageData> orientedImageData = vtkSmartPointer<vtkOrientedImageData>::New();
+    if (!segmentationNode->GetSegmentation()->GetSegmentBinaryLabelmap(segmentId, orientedImageData))
+      {
+      vtkErrorWithObjectMacro(representationNode, "ExportSegmentToRepresentationNode: Failed to get binary labelmap of segment " << segmentId);
+      return false;
+      }
     bool success = vtkSlicerSegmentationsModuleLogic::CreateLabelmapVolumeFromOrientedImageData(orientedImageData, labelmapNode);
     if (!success)
       {
@@ -1609,7 +1614,28 @@ bool vtkSlicerSegmentationsModuleLogic::GetSegmentRepresentation(vtkMRMLSegmenta
       vtkErrorWithObjectMacro(segmentationNode, "vtkSlicerSegmentationsModuleLogic::GetSegmentRepresentation: Unable to get '" << representationName << "' representation from segment with ID " << segmentID << " in segmentation " << segmentationNode->GetName());
       return false;
       }
-    segmentRepresentation->DeepCopy(representationObject);
+    vtkOrientedImageData* segmentRepresentationOrientedImageData = vtkOrientedImageData::SafeDownCast(segmentRepresentation);
+    if (segmentRepresentationOrientedImageData
+      && representationName == vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName())
+      {
+      // Only extract the voxels of the segment if the labelmap is shared with other segments
+      if (!segmentationNode->GetSegmentation()->GetSegmentBinaryLabelmap(segmentID, segmentRepresentationOrientedImageData))
+        {
+        vtkErrorWithObjectMacro(segmentationNode, "vtkSlicerSegmentationsModuleLogic::GetSegmentRepresentation: Unable to get binary labelmap of segment with ID " << segmentID << " in segmentation " << segmentationNode->GetName());
+        return false;
+        }
+      vtkOrientedImageData* representationImageData = vtkOrientedImageData::SafeDownCast(representationObject);
+      if (representationImageData && segmentRepresentationOrientedImageData->GetPointData()->GetScalars()
+        == representationImageData->GetPointData()->GetScalars())
+        {
+        // Labelmap is not shared, it was shallow copied
+        segmentRepresentationOrientedImageData->DeepCopy(representationImageData);
+        }
+      }
+    else
+      {
+      segmentRepresentation->DeepCopy(representationObject);
+      }
     }
   else // Need to convert
     {
@@ -1703,6 +1729,12 @@ bool vtkSlicerSegmentationsModuleLogic::SetBinaryLabelmapToSegment(vtkOrientedIm
     vtkGenericWarningMacro("vtkSlicerSegmentationsModuleLogic::SetBinaryLabelmapToSegment: Invalid selected segment");
     return false;
     }
+  // The segment labelmap is modified, so it must not be shared with other segments
+  if (!segmentationNode->GetSegmentation()->SeparateSegmentLabelmap(segmentID))
+    {
+    vtkErrorWithObjectMacro(segmentationNode, "vtkSlicerSegmentationsModuleLogic::SetBinaryLabelmapToSegment: Failed to separate segment from shared labelmap");
+    return false;
+    }
   vtkOrientedImageData* segmentLabelmap = vtkOrientedImageData::SafeDownCast(
     selectedSegment->GetRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()) );
   if (!segmentLabelmap)
@@ -1793,7 +1825,14 @@ bool vtkSlicerSegmentationsModuleLogic::SetBinaryLabelmapToSegment(vtkOrientedIm
     padder->Update();
     segmentLabelmap->DeepCopy(padder->GetOutput());
     }
-  // 4. Re-convert all other representations
+  // 4. Re-convert all other representations.
+  //    When merging, the segment is only changed within the modifier labelmap (or the specified extent),
+  //    so representations that support it are only updated in that region.
+  const int* modifiedExtent = NULL;
+  if (mergeMode != MODE_REPLACE)
+    {
+    modifiedExtent = (extent ? extent : labelmap->GetExtent());
+    }
   std::vector<std::string> representationNames;
   selectedSegment->GetContainedRepresentationNames(representationNames);
   bool conversionHappened = false;
@@ -1804,7 +1843,7 @@ bool vtkSlicerSegmentationsModuleLogic::SetBinaryLabelmapToSegment(vtkOrientedIm
     if (targetRepresentationName.compare(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()))
       {
       conversionHappened |= segmentationNode->GetSegmentation()->ConvertSingleSegment(
-        segmentID, targetRepresentationName );
+        segmentID, targetRepresentationName, modifiedExtent );
       }
     }
 
@@ -261,6 +261,85 @@ public:
   typedef std::map < vtkMRMLSegmentationDisplayNode*, PipelineMapType > PipelinesCacheType;
   PipelinesCacheType DisplayPipelines;
 
+  /// Pipeline that shows all binary labelmap segments of a display node at once.
+  /// The segments are painted into a label index image (voxel value is the
+  /// index of the segment in the SegmentIDs list + 1), which is resliced once and
+  /// colored by lookup tables, so the cost of a slice change does not depend on
+  /// the number of segments.
+  struct CombinedLabelmapPipeline
+    {
+    CombinedLabelmapPipeline()
+      {
+      this->NodeToWorldTransform = vtkSmartPointer<vtkGeneralTransform>::New();
+      this->WorldToNodeTransform = vtkSmartPointer<vtkGeneralTransform>::New();
+
+      this->OutlineActor = vtkSmartPointer<vtkActor2D>::New();
+      this->FillActor = vtkSmartPointer<vtkActor2D>::New();
+      this->Reslice = vtkSmartPointer<vtkImageReslice>::New();
+      this->SliceToImageTransform = vtkSmartPointer<vtkGeneralTransform>::New();
+      this->LabelOutline = vtkSmartPointer<vtkImageLabelOutline>::New();
+      this->LookupTableOutline = vtkSmartPointer<vtkLookupTable>::New();
+      this->LookupTableFill = vtkSmartPointer<vtkLookupTable>::New();
+
+      this->Reslice->SetBackgroundColor(0.0, 0.0, 0.0, 0.0);
+      this->Reslice->AutoCropOutputOff();
+      this->Reslice->SetOptimization(1);
+      this->Reslice->SetOutputOrigin(0.0, 0.0, 0.0);
+      this->Reslice->SetOutputSpacing(1.0, 1.0, 1.0);
+      this->Reslice->SetOutputDimensionality(3);
+      this->Reslice->SetInterpolationModeToNearestNeighbor();
+
+      this->SliceToImageTransform->PostMultiply();
+
+      this->LabelOutline->SetInputConnection(this->Reslice->GetOutputPort());
+      vtkSmartPointer<vtkImageMapToRGBA> outlineColorMapper = vtkSmartPointer<vtkImageMapToRGBA>::New();
+      outlineColorMapper->SetInputConnection(this->LabelOutline->GetOutputPort());
+      outlineColorMapper->SetOutputFormatToRGBA();
+      outlineColorMapper->SetLookupTable(this->LookupTableOutline);
+      vtkSmartPointer<vtkImageMapper> imageOutlineMapper = vtkSmartPointer<vtkImageMapper>::New();
+      imageOutlineMapper->SetInputConnection(outlineColorMapper->GetOutputPort());
+      imageOutlineMapper->SetColorWindow(255);
+      imageOutlineMapper->SetColorLevel(127.5);
+      this->OutlineActor->SetMapper(imageOutlineMapper);
+      this->OutlineActor->SetVisibility(0);
+
+      vtkSmartPointer<vtkImageMapToRGBA> fillColorMapper = vtkSmartPointer<vtkImageMapToRGBA>::New();
+      fillColorMapper->SetInputConnection(this->Reslice->GetOutputPort());
+      fillColorMapper->SetOutputFormatToRGBA();
+      fillColorMapper->SetLookupTable(this->LookupTableFill);
+      vtkSmartPointer<vtkImageMapper> imageFillMapper = vtkSmartPointer<vtkImageMapper>::New();
+      imageFillMapper->SetInputConnection(fillColorMapper->GetOutputPort());
+      imageFillMapper->SetColorWindow(255);
+      imageFillMapper->SetColorLevel(127.5);
+      this->FillActor->SetMapper(imageFillMapper);
+      this->FillActor->SetVisibility(0);
+      }
+
+    /// Transforms of the segmentation node, shared by all segments
+    vtkSmartPointer<vtkGeneralTransform> NodeToWorldTransform;
+    vtkSmartPointer<vtkGeneralTransform> WorldToNodeTransform;
+
+    /// Label index image and the segments it was created from: labelmap, label value
+    /// and labelmap extent of each segment when it was painted
+    vtkSmartPointer<vtkOrientedImageData> CombinedLabelmap;
+    std::vector<std::string> SegmentIDs;
+    std::vector<vtkOrientedImageData*> SegmentLabelmaps;
+    std::vector<int> SegmentLabelValues;
+    std::vector<int> SegmentLabelmapExtents;
+    vtkTimeStamp CombinedLabelmapTime;
+
+    vtkSmartPointer<vtkActor2D> OutlineActor;
+    vtkSmartPointer<vtkActor2D> FillActor;
+    vtkSmartPointer<vtkImageReslice> Reslice;
+    vtkSmartPointer<vtkGeneralTransform> SliceToImageTransform;
+    vtkSmartPointer<vtkImageLabelOutline> LabelOutline;
+    vtkSmartPointer<vtkLookupTable> LookupTableOutline;
+    vtkSmartPointer<vtkLookupTable> LookupTableFill;
+    };
+
+  typedef std::map < vtkMRMLSegmentationDisplayNode*, CombinedLabelmapPipeline* > CombinedLabelmapPipelinesType;
+  CombinedLabelmapPipelinesType CombinedLabelmapPipelines;
+
   typedef std::map < vtkMRMLSegmentationNode*, std::set< vtkMRMLSegmentationDisplayNode* > > SegmentationToDisplayCacheType;
   SegmentationToDisplayCacheType SegmentationToDisplayNodes;
 
@@ -284,6 +363,7 @@ public:
   void UpdateAllDisplayNodesForSegment(vtkMRMLSegmentationNode* segmentationNode);
   void UpdateSegmentPipelines(vtkMRMLSegmentationDisplayNode*, PipelineMapType&);
   void UpdateDisplayNodePipeline(vtkMRMLSegmentationDisplayNode*, PipelineMapType);
+  bool UpdateCombinedLabelmapPipeline(vtkMRMLSegmentationDisplayNode*, vtkSegmentation*, const std::string& representationName, bool displayNodeVisible);
   void RemoveDisplayNode(vtkMRMLSegmentationDisplayNode* displayNode);
 
   // Observations
@@ -296,7 +376,8 @@ public:
   bool UseDisplayNode(vtkMRMLSegmentationDisplayNode* displayNode);
   bool UseDisplayableNode(vtkMRMLSegmentationNode* node);
   void ClearDisplayableNodes();
-  bool IsSegmentVisibleInCurrentSlice(vtkMRMLSegmentationDisplayNode* displayNode, Pipeline* pipeline, const std::string &segmentID);
+  void GetSegmentationToSliceTransform(vtkGeneralTransform* nodeToWorldTransform, vtkGeneralTransform* segmentationToSliceTransform);
+  bool IsSegmentVisibleInCurrentSlice(vtkMRMLSegmentationDisplayNode* displayNode, vtkAbstractTransform* segmentationToSliceTransform, const std::string &segmentID);
 
 private:
   vtkSmartPointer<vtkMatrix4x4> SliceXYToRAS;
@@ -486,6 +567,11 @@ void vtkMRMLSegmentationsDisplayableManager2D::vtkInternal::UpdateDisplayableTra
         currentPipeline->SliceIntersectionUpdatedTime = 0; // Trigger slice intersection recomputation
         this->GetNodeTransformToWorld(mNode, currentPipeline->NodeToWorldTransform, currentPipeline->WorldToNodeTransform);
         }
+      CombinedLabelmapPipelinesType::iterator combinedIt = this->CombinedLabelmapPipelines.find(*dnodesIter);
+      if (combinedIt != this->CombinedLabelmapPipelines.end())
+        {
+        this->GetNodeTransformToWorld(mNode, combinedIt->second->NodeToWorldTransform, combinedIt->second->WorldToNodeTransform);
+        }
       this->UpdateDisplayNodePipeline(pipelinesIter->first, pipelinesIter->second);
       }
     }
@@ -510,6 +596,15 @@ void vtkMRMLSegmentationsDisplayableManager2D::vtkInternal::RemoveDisplayNode(vt
     delete pipeline;
     }
   this->DisplayPipelines.erase(pipelinesIter);
+
+  CombinedLabelmapPipelinesType::iterator combinedIt = this->CombinedLabelmapPipelines.find(displayNode);
+  if (combinedIt != this->CombinedLabelmapPipelines.end())
+    {
+    this->External->GetRenderer()->RemoveActor(combinedIt->second->OutlineActor);
+    this->External->GetRenderer()->RemoveActor(combinedIt->second->FillActor);
+    delete combinedIt->second;
+    this->CombinedLabelmapPipelines.erase(combinedIt);
+    }
 }
 
 //---------------------------------------------------------------------------
@@ -548,6 +643,11 @@ void vtkMRMLSegmentationsDisplayableManager2D::vtkInternal::AddDisplayNode(vtkMR
 
   this->DisplayPipelines.insert( std::make_pair(displayNode, pipelineVector) );
 
+  CombinedLabelmapPipeline* combinedPipeline = new CombinedLabelmapPipeline();
+  this->External->GetRenderer()->AddActor(combinedPipeline->FillActor);
+  this->External->GetRenderer()->AddActor(combinedPipeline->OutlineActor);
+  this->CombinedLabelmapPipelines[displayNode] = combinedPipeline;
+
   // Update cached matrices. Calls UpdateDisplayNodePipeline
   this->UpdateDisplayableTransforms(mNode);
 }
@@ -681,6 +781,7 @@ void vtkMRMLSegmentationsDisplayableManager2D::vtkInternal::UpdateDisplayNodePip
       pipelineIt->second->ImageOutlineActor->SetVisibility(false);
       pipelineIt->second->ImageFillActor->SetVisibility(false);
       }
+    this->UpdateCombinedLabelmapPipeline(displayNode, NULL, shownRepresenatationName, false);
     return;
     }
 
@@ -702,6 +803,14 @@ void vtkMRMLSegmentationsDisplayableManager2D::vtkInternal::UpdateDisplayNodePip
     return;
     }
 
+  // Binary labelmaps are shown by the combined pipeline when possible
+  bool labelmapsCombined = this->UpdateCombinedLabelmapPipeline(
+    displayNode, segmentation, shownRepresenatationName, displayNodeVisible);
+
+  // The segmentation to slice transform is the same for all the segments,
+  // it is computed when a segment needs it first
+  vtkSmartPointer<vtkGeneralTransform> segmentationToSliceTransform;
+
   // For all pipelines (pipeline per segment)
   for (PipelineMapType::iterator pipelineIt=pipelines.begin(); pipelineIt!=pipelines.end(); ++pipelineIt)
     {
@@ -731,7 +840,8 @@ void vtkMRMLSegmentationsDisplayableManager2D::vtkInternal::UpdateDisplayNodePip
       }
 
     if ( (!segmentOutlineVisible && !segmentFillVisible)
-      || ((!polyData || polyData->GetNumberOfPoints() == 0) && !imageData) )
+      || ((!polyData || polyData->GetNumberOfPoints() == 0) && !imageData)
+      || (imageData && labelmapsCombined) )
       {
       pipeline->PolyDataOutlineActor->SetVisibility(false);
       pipeline->PolyDataFillActor->SetVisibility(false);
@@ -740,7 +850,12 @@ void vtkMRMLSegmentationsDisplayableManager2D::vtkInternal::UpdateDisplayNodePip
       continue;
       }
 
-    bool visibleInCurrentSlice = this->IsSegmentVisibleInCurrentSlice(displayNode, pipeline, pipelineIt->first);
+    if (!segmentationToSliceTransform)
+      {
+      segmentationToSliceTransform = vtkSmartPointer<vtkGeneralTransform>::New();
+      this->GetSegmentationToSliceTransform(pipeline->NodeToWorldTransform, segmentationToSliceTransform);
+      }
+    bool visibleInCurrentSlice = this->IsSegmentVisibleInCurrentSlice(displayNode, segmentationToSliceTransform, pipelineIt->first);
     if (!visibleInCurrentSlice)
       {
       pipeline->PolyDataOutlineActor->SetVisibility(false);
@@ -967,6 +1082,220 @@ void vtkMRMLSegmentationsDisplayableManager2D::vtkInternal::UpdateDisplayNodePip
     }
 }
 
+//---------------------------------------------------------------------------
+bool vtkMRMLSegmentationsDisplayableManager2D::vtkInternal::UpdateCombinedLabelmapPipeline(
+  vtkMRMLSegmentationDisplayNode* displayNode, vtkSegmentation* segmentation, const std::string& representationName, bool displayNodeVisible)
+{
+  CombinedLabelmapPipelinesType::iterator combinedIt = this->CombinedLabelmapPipelines.find(displayNode);
+  if (combinedIt == this->CombinedLabelmapPipelines.end())
+    {
+    return false;
+    }
+  CombinedLabelmapPipeline* pipeline = combinedIt->second;
+  pipeline->FillActor->SetVisibility(false);
+  pipeline->OutlineActor->SetVisibility(false);
+  if (!segmentation || !displayNodeVisible
+    || representationName != vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName())
+    {
+    return false;
+    }
+
+  // Collect the labelmaps of the visible segments. Labelmaps can only be combined
+  // if all of them are binary (not fractional) and have the same geometry.
+  std::vector<std::string> segmentIDs;
+  std::vector<vtkOrientedImageData*> segmentLabelmaps;
+  std::vector<std::string> allSegmentIDs;
+  segmentation->GetSegmentIDs(allSegmentIDs);
+  for (std::vector<std::string>::iterator segmentIdIt = allSegmentIDs.begin(); segmentIdIt != allSegmentIDs.end(); ++segmentIdIt)
+    {
+    vtkMRMLSegmentationDisplayNode::SegmentDisplayProperties properties;
+    displayNode->GetSegmentDisplayProperties(*segmentIdIt, properties);
+    if ( !properties.Visible
+      || ( !(properties.Visible2DOutline && displayNode->GetVisibility2DOutline())
+        && !(properties.Visible2DFill && displayNode->GetVisibility2DFill()) ) )
+      {
+      continue;
+      }
+    vtkOrientedImageData* imageData = vtkOrientedImageData::SafeDownCast(
+      segmentation->GetSegmentRepresentation(*segmentIdIt, representationName));
+    if (!imageData)
+      {
+      return false;
+      }
+    int* imageExtent = imageData->GetExtent();
+    if (imageExtent[0]>imageExtent[1] || imageExtent[2]>imageExtent[3] || imageExtent[4]>imageExtent[5])
+      {
+      // empty image
+      continue;
+      }
+    vtkFieldData* fieldData = imageData->GetFieldData();
+    if ( fieldData->GetAbstractArray(vtkSegmentationConverter::GetScalarRangeFieldName())
+      || fieldData->GetAbstractArray(vtkSegmentationConverter::GetThresholdValueFieldName())
+      || fieldData->GetAbstractArray(vtkSegmentationConverter::GetInterpolationTypeFieldName()) )
+      {
+      return false;
+      }
+    if (!segmentLabelmaps.empty() && !vtkOrientedImageDataResample::DoGeometriesMatch(segmentLabelmaps[0], imageData))
+      {
+      return false;
+      }
+    segmentIDs.push_back(*segmentIdIt);
+    segmentLabelmaps.push_back(imageData);
+    }
+  if (segmentLabelmaps.size() > VTK_UNSIGNED_SHORT_MAX)
+    {
+    return false;
+    }
+  if (segmentLabelmaps.empty())
+    {
+    // Nothing to show, but all segments are binary labelmaps
+    pipeline->CombinedLabelmap = NULL;
+    pipeline->SegmentIDs.clear();
+    pipeline->SegmentLabelmaps.clear();
+    pipeline->SegmentLabelValues.clear();
+    pipeline->SegmentLabelmapExtents.clear();
+    return true;
+    }
+  std::vector<int> segmentLabelValues;
+  for (std::vector<std::string>::iterator segmentIdIt = segmentIDs.begin(); segmentIdIt != segmentIDs.end(); ++segmentIdIt)
+    {
+    segmentLabelValues.push_back(segmentation->GetSegment(*segmentIdIt)->GetLabelValue());
+    }
+
+  // Paint the segments into the label index image if any of them has changed.
+  // If only the content or the label value of some segments has changed, only the region
+  // of these segments (before and after the change) is painted again.
+  bool combinedLabelmapValid = (pipeline->CombinedLabelmap.GetPointer() != NULL
+    && pipeline->SegmentIDs == segmentIDs && pipeline->SegmentLabelmaps == segmentLabelmaps);
+  std::vector<vtkOrientedImageData*> changedLabelmaps;
+  for (size_t segmentIndex = 0; combinedLabelmapValid && segmentIndex < segmentLabelmaps.size(); ++segmentIndex)
+    {
+    vtkOrientedImageData* labelmap = segmentLabelmaps[segmentIndex];
+    if (labelmap->GetMTime() > pipeline->CombinedLabelmapTime.GetMTime()
+      || segmentLabelValues[segmentIndex] != pipeline->SegmentLabelValues[segmentIndex])
+      {
+      // segments of shared labelmaps are updated together
+      if (std::find(changedLabelmaps.begin(), changedLabelmaps.end(), labelmap) == changedLabelmaps.end())
+        {
+        changedLabelmaps.push_back(labelmap);
+        }
+      }
+    }
+  bool combinedLabelmapModified = false;
+  for (std::vector<vtkOrientedImageData*>::iterator labelmapIt = changedLabelmaps.begin();
+    combinedLabelmapValid && labelmapIt != changedLabelmaps.end(); ++labelmapIt)
+    {
+    size_t segmentIndex = std::find(segmentLabelmaps.begin(), segmentLabelmaps.end(), *labelmapIt) - segmentLabelmaps.begin();
+    const int* oldExtent = &pipeline->SegmentLabelmapExtents[segmentIndex * 6];
+    int* newExtent = (*labelmapIt)->GetExtent();
+    int updateExtent[6] = { 0, -1, 0, -1, 0, -1 };
+    for (int i = 0; i < 3; ++i)
+      {
+      updateExtent[i * 2] = std::min(oldExtent[i * 2], newExtent[i * 2]);
+      updateExtent[i * 2 + 1] = std::max(oldExtent[i * 2 + 1], newExtent[i * 2 + 1]);
+      }
+    combinedLabelmapValid = vtkMRMLSegmentationsDisplayableManager2D::UpdateSegmentIndexImage(
+      segmentation, segmentIDs, pipeline->CombinedLabelmap, updateExtent);
+    combinedLabelmapModified = true;
+    }
+  if (!combinedLabelmapValid)
+    {
+    vtkSmartPointer<vtkOrientedImageData> combinedLabelmap = vtkSmartPointer<vtkOrientedImageData>::New();
+    if (!vtkMRMLSegmentationsDisplayableManager2D::PaintSegmentIndexImage(segmentation, segmentIDs, combinedLabelmap))
+      {
+      return false;
+      }
+    pipeline->CombinedLabelmap = combinedLabelmap;
+
+    // Reslice a copy of the label index image with default origin and spacing
+    vtkSmartPointer<vtkImageData> identityImageData = vtkSmartPointer<vtkImageData>::New();
+    identityImageData->ShallowCopy(combinedLabelmap);
+    identityImageData->SetOrigin(0.0, 0.0, 0.0);
+    identityImageData->SetSpacing(1.0, 1.0, 1.0);
+    pipeline->Reslice->SetInputData(identityImageData);
+    combinedLabelmapModified = true;
+    }
+  else if (combinedLabelmapModified)
+    {
+    // the resliced copy shares the scalars of the label index image
+    pipeline->Reslice->GetInputDataObject(0, 0)->Modified();
+    }
+  if (combinedLabelmapModified)
+    {
+    pipeline->SegmentIDs = segmentIDs;
+    pipeline->SegmentLabelmaps = segmentLabelmaps;
+    pipeline->SegmentLabelValues = segmentLabelValues;
+    pipeline->SegmentLabelmapExtents.clear();
+    for (std::vector<vtkOrientedImageData*>::iterator labelmapIt = segmentLabelmaps.begin();
+      labelmapIt != segmentLabelmaps.end(); ++labelmapIt)
+      {
+      int* extent = (*labelmapIt)->GetExtent();
+      pipeline->SegmentLabelmapExtents.insert(pipeline->SegmentLabelmapExtents.end(), extent, extent + 6);
+      }
+    pipeline->CombinedLabelmapTime.Modified();
+    }
+
+  // Set segment colors. Value 0 is the background, value i is the segment at index i-1.
+  int numberOfValues = static_cast<int>(segmentIDs.size()) + 1;
+  pipeline->LookupTableFill->SetNumberOfTableValues(numberOfValues);
+  pipeline->LookupTableFill->SetTableRange(0, numberOfValues - 1);
+  pipeline->LookupTableFill->SetTableValue(0, 0.0, 0.0, 0.0, 0.0);
+  pipeline->LookupTableOutline->SetNumberOfTableValues(numberOfValues);
+  pipeline->LookupTableOutline->SetTableRange(0, numberOfValues - 1);
+  pipeline->LookupTableOutline->SetTableValue(0, 0.0, 0.0, 0.0, 0.0);
+  bool fillVisible = false;
+  bool outlineVisible = false;
+  for (size_t segmentIndex = 0; segmentIndex < segmentIDs.size(); ++segmentIndex)
+    {
+    vtkMRMLSegmentationDisplayNode::SegmentDisplayProperties properties;
+    displayNode->GetSegmentDisplayProperties(segmentIDs[segmentIndex], properties);
+    bool segmentOutlineVisible = properties.Visible2DOutline && displayNode->GetVisibility2DOutline();
+    bool segmentFillVisible = properties.Visible2DFill && displayNode->GetVisibility2DFill();
+    outlineVisible = outlineVisible || segmentOutlineVisible;
+    fillVisible = fillVisible || segmentFillVisible;
+
+    double color[3] = {vtkSegment::SEGMENT_COLOR_INVALID[0], vtkSegment::SEGMENT_COLOR_INVALID[1], vtkSegment::SEGMENT_COLOR_INVALID[2]};
+    displayNode->GetSegmentColor(segmentIDs[segmentIndex], color);
+    pipeline->LookupTableFill->SetTableValue(segmentIndex + 1, color[0], color[1], color[2],
+      segmentFillVisible ? properties.Opacity2DFill * displayNode->GetOpacity2DFill() * displayNode->GetOpacity() : 0.0);
+    pipeline->LookupTableOutline->SetTableValue(segmentIndex + 1, color[0], color[1], color[2],
+      segmentOutlineVisible ? properties.Opacity2DOutline * displayNode->GetOpacity2DOutline() * displayNode->GetOpacity() : 0.0);
+    }
+  pipeline->LookupTableFill->Modified();
+  pipeline->LookupTableOutline->Modified();
+
+  // Calculate slice to label index image IJK transform
+  pipeline->SliceToImageTransform->Identity();
+  pipeline->SliceToImageTransform->Concatenate(this->SliceXYToRAS);
+  pipeline->SliceToImageTransform->Concatenate(pipeline->WorldToNodeTransform);
+  vtkSmartPointer<vtkMatrix4x4> worldToImageMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  pipeline->CombinedLabelmap->GetWorldToImageMatrix(worldToImageMatrix);
+  pipeline->SliceToImageTransform->Concatenate(worldToImageMatrix);
+
+  vtkSmartPointer<vtkTransform> linearSliceToImageTransform = vtkSmartPointer<vtkTransform>::New();
+  if (vtkMRMLTransformNode::IsGeneralTransformLinear(pipeline->SliceToImageTransform, linearSliceToImageTransform))
+    {
+    SnapToPermuteMatrix(linearSliceToImageTransform);
+    pipeline->Reslice->SetResliceTransform(linearSliceToImageTransform);
+    }
+  else
+    {
+    pipeline->Reslice->SetResliceTransform(pipeline->SliceToImageTransform);
+    }
+
+  int dimensions[3] = { 0, 0, 0 };
+  this->SliceNode->GetDimensions(dimensions);
+  int sliceOutputExtent[6] = { 0, dimensions[0] - 1, 0, dimensions[1] - 1, 0, dimensions[2] - 1 };
+  pipeline->Reslice->SetOutputExtent(sliceOutputExtent);
+  pipeline->LabelOutline->SetOutline(displayNode->GetSliceIntersectionThickness());
+
+  pipeline->OutlineActor->SetVisibility(outlineVisible);
+  pipeline->OutlineActor->SetPosition(0,0);
+  pipeline->FillActor->SetVisibility(fillVisible);
+  pipeline->FillActor->SetPosition(0,0);
+  return true;
+}
+
 //---------------------------------------------------------------------------
 void vtkMRMLSegmentationsDisplayableManager2D::vtkInternal::AddObservations(vtkMRMLSegmentationNode* node)
 {
@@ -1053,9 +1382,20 @@ bool vtkMRMLSegmentationsDisplayableManager2D::vtkInternal::UseDisplayableNode(v
   return use;
 }
 
+//---------------------------------------------------------------------------
+void vtkMRMLSegmentationsDisplayableManager2D::vtkInternal::GetSegmentationToSliceTransform(
+  vtkGeneralTransform* nodeToWorldTransform, vtkGeneralTransform* segmentationToSliceTransform)
+{
+  vtkNew<vtkMatrix4x4> rasToSliceXY;
+  vtkMatrix4x4::Invert(this->SliceXYToRAS, rasToSliceXY.GetPointer());
+  segmentationToSliceTransform->Identity();
+  segmentationToSliceTransform->Concatenate(rasToSliceXY.GetPointer());
+  segmentationToSliceTransform->Concatenate(nodeToWorldTransform);
+}
+
 //---------------------------------------------------------------------------
 bool vtkMRMLSegmentationsDisplayableManager2D::vtkInternal::IsSegmentVisibleInCurrentSlice(
-  vtkMRMLSegmentationDisplayNode* displayNode, Pipeline* pipeline, const std::string &segmentID)
+  vtkMRMLSegmentationDisplayNode* displayNode, vtkAbstractTransform* segmentationToSliceTransform, const std::string &segmentID)
 {
   vtkMRMLSegmentationNode* segmentationNode = vtkMRMLSegmentationNode::SafeDownCast(
     displayNode->GetDisplayableNode() );
@@ -1077,12 +1417,6 @@ bool vtkMRMLSegmentationsDisplayableManager2D::vtkInternal::IsSegmentVisibleInCu
     }
   segment->GetBounds(segmentBounds_Segment);
 
-  vtkSmartPointer<vtkGeneralTransform> segmentationToSliceTransform = vtkSmartPointer<vtkGeneralTransform>::New();
-  vtkNew<vtkMatrix4x4> rasToSliceXY;
-  vtkMatrix4x4::Invert(this->SliceXYToRAS, rasToSliceXY.GetPointer());
-  segmentationToSliceTransform->Concatenate(rasToSliceXY.GetPointer());
-  segmentationToSliceTransform->Concatenate(pipeline->NodeToWorldTransform);
-
   double segmentBounds_Slice[6] = { 0 };
   vtkOrientedImageDataResample::TransformBounds(segmentBounds_Segment, segmentationToSliceTransform, segmentBounds_Slice);
 
@@ -1349,6 +1683,7 @@ std::string vtkMRMLSegmentationsDisplayableManager2D::GetDataProbeInfoStringForP
     // For all pipelines (pipeline per segment)
     std::set<std::string> segmentIDsAtPosition;
     std::map<std::string, double> valueForSegment;
+    vtkSmartPointer<vtkGeneralTransform> segmentationToSliceTransform;
 
     for (vtkInternal::PipelineMapType::iterator pipelineIt=displayNodeIt->second.begin(); pipelineIt!=displayNodeIt->second.end(); ++pipelineIt)
       {
@@ -1365,7 +1700,12 @@ std::string vtkMRMLSegmentationsDisplayableManager2D::GetDataProbeInfoStringForP
         }
 
       // Skip if segment is not visible in the current slice
-      if (!this->Internal->IsSegmentVisibleInCurrentSlice(displayNode, pipeline, pipelineIt->first))
+      if (!segmentationToSliceTransform)
+        {
+        segmentationToSliceTransform = vtkSmartPointer<vtkGeneralTransform>::New();
+        this->Internal->GetSegmentationToSliceTransform(pipeline->NodeToWorldTransform, segmentationToSliceTransform);
+        }
+      if (!this->Internal->IsSegmentVisibleInCurrentSlice(displayNode, segmentationToSliceTransform, pipelineIt->first))
         {
         continue;
         }
@@ -1408,7 +1748,15 @@ std::string vtkMRMLSegmentationsDisplayableManager2D::GetDataProbeInfoStringForP
         {
           minimumValue = scalarRange->GetValue(0);
         }
-        if (voxelValue > minimumValue)
+        bool voxelInSegment = (voxelValue > minimumValue);
+        vtkSegment* segment = segmentation->GetSegment(pipelineIt->first);
+        if (segment && shownRepresenatationName == vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()
+          && (segment->GetLabelValue() != 1 || segmentation->IsSharedBinaryLabelmap(pipelineIt->first)))
+          {
+          // other segments are stored in the same labelmap with different label values
+          voxelInSegment = (voxelValue == segment->GetLabelValue());
+          }
+        if (voxelInSegment)
           {
           segmentIDsAtPosition.insert(pipelineIt->first);
 
@@ -1528,3 +1876,170 @@ std::string vtkMRMLSegmentationsDisplayableManager2D::GetDataProbeInfoStringForP
     }
   return "S " + segmentsAtPositionInfoStr;
 }
+
+//---------------------------------------------------------------------------
+namespace
+{
+
+/// Labelmaps of the segments painted into a label index image
+struct SegmentIndexLayers
+{
+  /// Labelmaps in the order they are painted
+  std::vector<vtkOrientedImageData*> Layers;
+  /// Label value of the segments of each labelmap mapped to their index value
+  std::map<vtkOrientedImageData*, std::map<int, int> > LayerLabelToIndex;
+  /// Labelmaps of which only the labels of the segments are painted
+  std::set<vtkOrientedImageData*> SharedLayers;
+  /// Union of the extents of the labelmaps
+  int Extent[6];
+};
+
+//---------------------------------------------------------------------------
+bool GetSegmentIndexLayers(vtkSegmentation* segmentation, const std::vector<std::string>& segmentIDs,
+  SegmentIndexLayers& segmentIndexLayers)
+{
+  std::vector<vtkOrientedImageData*> segmentLabelmaps;
+  for (std::vector<std::string>::const_iterator segmentIdIt = segmentIDs.begin(); segmentIdIt != segmentIDs.end(); ++segmentIdIt)
+    {
+    vtkOrientedImageData* labelmap = vtkOrientedImageData::SafeDownCast(segmentation->GetSegmentRepresentation(
+      *segmentIdIt, vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
+    if (!labelmap || (!segmentLabelmaps.empty() && !vtkOrientedImageDataResample::DoGeometriesMatch(segmentLabelmaps[0], labelmap)))
+      {
+      vtkGenericWarningMacro("vtkMRMLSegmentationsDisplayableManager2D::PaintSegmentIndexImage: Segment "
+        << *segmentIdIt << " has no binary labelmap with the common geometry");
+      return false;
+      }
+    segmentLabelmaps.push_back(labelmap);
+    }
+  if (segmentLabelmaps.empty() || segmentLabelmaps.size() > VTK_UNSIGNED_SHORT_MAX)
+    {
+    return false;
+    }
+
+  // Labelmaps shared by multiple segments are painted by label value,
+  // others contain only one segment so all non-zero voxels are painted.
+  int* combinedExtent = segmentIndexLayers.Extent;
+  for (int i = 0; i < 3; ++i)
+    {
+    combinedExtent[i * 2] = VTK_INT_MAX;
+    combinedExtent[i * 2 + 1] = VTK_INT_MIN;
+    }
+  for (size_t segmentIndex = 0; segmentIndex < segmentIDs.size(); ++segmentIndex)
+    {
+    vtkOrientedImageData* labelmap = segmentLabelmaps[segmentIndex];
+    if (segmentIndexLayers.LayerLabelToIndex.find(labelmap) == segmentIndexLayers.LayerLabelToIndex.end())
+      {
+      segmentIndexLayers.Layers.push_back(labelmap);
+      int* labelmapExtent = labelmap->GetExtent();
+      for (int i = 0; i < 3; ++i)
+        {
+        combinedExtent[i * 2] = std::min(combinedExtent[i * 2], labelmapExtent[i * 2]);
+        combinedExtent[i * 2 + 1] = std::max(combinedExtent[i * 2 + 1], labelmapExtent[i * 2 + 1]);
+        }
+      }
+    vtkSegment* segment = segmentation->GetSegment(segmentIDs[segmentIndex]);
+    segmentIndexLayers.LayerLabelToIndex[labelmap][segment->GetLabelValue()] = static_cast<int>(segmentIndex + 1);
+    if (segment->GetLabelValue() != 1 || segmentation->IsSharedBinaryLabelmap(segmentIDs[segmentIndex]))
+      {
+      // other segments of the labelmap may be hidden, so only the labels of these segments are painted
+      segmentIndexLayers.SharedLayers.insert(labelmap);
+      }
+    }
+  return true;
+}
+
+//---------------------------------------------------------------------------
+void PaintSegmentIndexLayers(SegmentIndexLayers& segmentIndexLayers, vtkOrientedImageData* segmentIndexImage,
+  const int* extent)
+{
+  for (std::vector<vtkOrientedImageData*>::iterator layerIt = segmentIndexLayers.Layers.begin();
+    layerIt != segmentIndexLayers.Layers.end(); ++layerIt)
+    {
+    std::map<int, int>& labelToIndex = segmentIndexLayers.LayerLabelToIndex[*layerIt];
+    if (segmentIndexLayers.SharedLayers.find(*layerIt) == segmentIndexLayers.SharedLayers.end())
+      {
+      vtkOrientedImageDataResample::ModifyImage(segmentIndexImage, *layerIt,
+        vtkOrientedImageDataResample::OPERATION_MASKING, extent, 0, labelToIndex.begin()->second);
+      }
+    else
+      {
+      vtkOrientedImageDataResample::PaintLabels(segmentIndexImage, *layerIt, labelToIndex, extent);
+      }
+    }
+}
+
+}
+
+//---------------------------------------------------------------------------
+bool vtkMRMLSegmentationsDisplayableManager2D::PaintSegmentIndexImage(vtkSegmentation* segmentation,
+  const std::vector<std::string>& segmentIDs, vtkOrientedImageData* segmentIndexImage)
+{
+  if (!segmentation || !segmentIndexImage)
+    {
+    vtkGenericWarningMacro("vtkMRMLSegmentationsDisplayableManager2D::PaintSegmentIndexImage: Invalid input");
+    return false;
+    }
+  SegmentIndexLayers segmentIndexLayers;
+  if (!GetSegmentIndexLayers(segmentation, segmentIDs, segmentIndexLayers))
+    {
+    return false;
+    }
+
+  segmentIndexImage->CopyDirections(segmentIndexLayers.Layers[0]);
+  segmentIndexImage->SetOrigin(segmentIndexLayers.Layers[0]->GetOrigin());
+  segmentIndexImage->SetSpacing(segmentIndexLayers.Layers[0]->GetSpacing());
+  segmentIndexImage->SetExtent(segmentIndexLayers.Extent);
+  segmentIndexImage->AllocateScalars(segmentIDs.size() < VTK_UNSIGNED_CHAR_MAX ? VTK_UNSIGNED_CHAR : VTK_UNSIGNED_SHORT, 1);
+  vtkOrientedImageDataResample::FillImage(segmentIndexImage, 0);
+  PaintSegmentIndexLayers(segmentIndexLayers, segmentIndexImage, NULL);
+
+  return true;
+}
+
+//---------------------------------------------------------------------------
+bool vtkMRMLSegmentationsDisplayableManager2D::UpdateSegmentIndexImage(vtkSegmentation* segmentation,
+  const std::vector<std::string>& segmentIDs, vtkOrientedImageData* segmentIndexImage, const int updateExtent[6])
+{
+  if (!segmentation || !segmentIndexImage || !updateExtent || !segmentIndexImage->GetPointData()->GetScalars())
+    {
+    vtkGenericWarningMacro("vtkMRMLSegmentationsDisplayableManager2D::UpdateSegmentIndexImage: Invalid input");
+    return false;
+    }
+  SegmentIndexLayers segmentIndexLayers;
+  if (!GetSegmentIndexLayers(segmentation, segmentIDs, segmentIndexLayers))
+    {
+    return false;
+    }
+  // The index image cannot be updated in place if the labelmaps have moved or grown
+  if (!vtkOrientedImageDataResample::DoGeometriesMatch(segmentIndexImage, segmentIndexLayers.Layers[0])
+    || (segmentIDs.size() < VTK_UNSIGNED_CHAR_MAX) != (segmentIndexImage->GetScalarType() == VTK_UNSIGNED_CHAR))
+    {
+    return false;
+    }
+  int* imageExtent = segmentIndexImage->GetExtent();
+  int clippedUpdateExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  for (int i = 0; i < 3; ++i)
+    {
+    if (segmentIndexLayers.Extent[i * 2] < imageExtent[i * 2]
+      || segmentIndexLayers.Extent[i * 2 + 1] > imageExtent[i * 2 + 1])
+      {
+      return false;
+      }
+    clippedUpdateExtent[i * 2] = std::max(updateExtent[i * 2], imageExtent[i * 2]);
+    clippedUpdateExtent[i * 2 + 1] = std::min(updateExtent[i * 2 + 1], imageExtent[i * 2 + 1]);
+    }
+  if (clippedUpdateExtent[0] > clippedUpdateExtent[1]
+    || clippedUpdateExtent[2] > clippedUpdateExtent[3]
+    || clippedUpdateExtent[4] > clippedUpdateExtent[5])
+    {
+    return true;
+    }
+
+  // Clear the region and paint all the segments into it, so that the overlaps between
+  // segments are resolved as when the whole image is painted.
+  vtkOrientedImageDataResample::FillImage(segmentIndexImage, 0, clippedUpdateExtent);
+  PaintSegmentIndexLayers(segmentIndexLayers, segmentIndexImage, clippedUpdateExtent);
+  segmentIndexImage->Modified();
+
+  return true;
+}
@@ -26,10 +26,21 @@
 
 #include "vtkSlicerSegmentationsModuleMRMLDisplayableManagerExport.h"
 
+// STD includes
+#include <string>
+#include <vector>
+
+class vtkOrientedImageData;
+class vtkSegmentation;
+
 /// \brief Displayable manager for showing segmentations in slice (2D) views.
 ///
 /// Displays segmentations in slice viewers as labelmaps or contour lines
 ///
+/// Binary labelmap segments that have the same geometry are combined into one
+/// label index image, so that all segments are resliced and colored in one pass.
+/// Other segments are shown by a separate pipeline per segment.
+///
 class VTK_SLICER_SEGMENTATIONS_MODULE_MRMLDISPLAYABLEMANAGER_EXPORT vtkMRMLSegmentationsDisplayableManager2D
   : public vtkMRMLAbstractSliceViewDisplayableManager
 {
@@ -43,6 +54,21 @@ public:
   /// \return Invalid string by default, meaning no information to display.
   virtual std::string GetDataProbeInfoStringForPosition(double xyz[3]) VTK_OVERRIDE;
 
+  /// Paint the binary labelmaps of segments into one label index image: voxels of the segment
+  /// at index i in \a segmentIDs get the value i+1, other voxels are 0. Where segments overlap,
+  /// the later segment is painted. Segments of shared labelmaps that are not listed are not painted.
+  /// \return False if a segment has no binary labelmap or the labelmaps have different geometries
+  static bool PaintSegmentIndexImage(vtkSegmentation* segmentation, const std::vector<std::string>& segmentIDs,
+    vtkOrientedImageData* segmentIndexImage);
+
+  /// Paint again the region \a updateExtent of a label index image created by PaintSegmentIndexImage()
+  /// with the same segments, after the labelmaps or label values of some segments have changed in that
+  /// region. The result is the same as painting the whole image again.
+  /// \return False if the image cannot be updated in place (e.g., a labelmap has grown outside of the
+  ///   image extent or its geometry has changed), then the whole image must be painted again.
+  static bool UpdateSegmentIndexImage(vtkSegmentation* segmentation, const std::vector<std::string>& segmentIDs,
+    vtkOrientedImageData* segmentIndexImage, const int updateExtent[6]);
+
 protected:
   virtual void UnobserveMRMLScene() VTK_OVERRIDE;
   virtual void OnMRMLSceneNodeAdded(vtkMRMLNode* node) VTK_OVERRIDE;
@@ -0,0 +1,219 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Segmentations includes
+#include "vtkImageGrowCutSegment.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+
+// STD includes
+#include <algorithm>
+
+namespace
+{
+void CreateIntensityVolume(vtkImageData* intensityVolume);
+void PaintSeed(vtkImageData* seedLabelVolume, int x, int y, int z, unsigned char label);
+void GrowFromSeeds(vtkImageData* intensityVolume, vtkImageData* seedLabelVolume, int numberOfThreads,
+  vtkImageData* resultLabelVolume);
+int GetNumberOfDifferentVoxels(vtkImageData* image1, vtkImageData* image2);
+int GetNumberOfVoxelsWithLabel(vtkImageData* image, unsigned char label);
+}
+
+//----------------------------------------------------------------------------
+int vtkImageGrowCutSegmentTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  // The volume is thick enough to be split into multiple slabs
+  vtkNew<vtkImageData> intensityVolume;
+  CreateIntensityVolume(intensityVolume.GetPointer());
+  vtkNew<vtkImageData> seedLabelVolume;
+  seedLabelVolume->SetExtent(intensityVolume->GetExtent());
+  seedLabelVolume->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  seedLabelVolume->GetPointData()->GetScalars()->FillComponent(0, 0);
+  PaintSeed(seedLabelVolume.GetPointer(), 5, 5, 5, 1);
+  PaintSeed(seedLabelVolume.GetPointer(), 18, 18, 74, 2);
+
+  //////////////////////////////////////////////////////////////////////////
+  // Growing in parallel slabs gives the same result as growing in a single region
+
+  vtkNew<vtkImageData> singleThreadResult;
+  GrowFromSeeds(intensityVolume.GetPointer(), seedLabelVolume.GetPointer(), 1, singleThreadResult.GetPointer());
+  vtkNew<vtkImageData> multiThreadResult;
+  GrowFromSeeds(intensityVolume.GetPointer(), seedLabelVolume.GetPointer(), 4, multiThreadResult.GetPointer());
+  if (GetNumberOfVoxelsWithLabel(singleThreadResult.GetPointer(), 1) == 0
+    || GetNumberOfVoxelsWithLabel(singleThreadResult.GetPointer(), 2) == 0
+    || GetNumberOfVoxelsWithLabel(singleThreadResult.GetPointer(), 0) != 0)
+    {
+    std::cerr << __LINE__ << ": Regions are not grown from all seeds!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  int numberOfDifferentVoxels = GetNumberOfDifferentVoxels(singleThreadResult.GetPointer(), multiThreadResult.GetPointer());
+  if (numberOfDifferentVoxels != 0)
+    {
+    std::cerr << __LINE__ << ": Multi-threaded result differs from single-threaded result in "
+      << numberOfDifferentVoxels << " voxels!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Updating after seeds are added or changed gives the same result as full recomputation
+
+  vtkNew<vtkImageGrowCutSegment> growCutFilter;
+  growCutFilter->SetNumberOfThreads(4);
+  growCutFilter->SetIntensityVolume(intensityVolume.GetPointer());
+  growCutFilter->SetSeedLabelVolume(seedLabelVolume.GetPointer());
+  growCutFilter->Update();
+
+  PaintSeed(seedLabelVolume.GetPointer(), 12, 12, 40, 3);
+  PaintSeed(seedLabelVolume.GetPointer(), 18, 18, 74, 4);
+  seedLabelVolume->Modified();
+  growCutFilter->Update();
+  vtkNew<vtkImageData> updatedResult;
+  updatedResult->DeepCopy(growCutFilter->GetOutput());
+
+  vtkNew<vtkImageData> recomputedResult;
+  GrowFromSeeds(intensityVolume.GetPointer(), seedLabelVolume.GetPointer(), 4, recomputedResult.GetPointer());
+  if (GetNumberOfVoxelsWithLabel(updatedResult.GetPointer(), 3) == 0
+    || GetNumberOfVoxelsWithLabel(updatedResult.GetPointer(), 4) == 0
+    || GetNumberOfVoxelsWithLabel(updatedResult.GetPointer(), 2) != 0)
+    {
+    std::cerr << __LINE__ << ": Regions are not grown from the added and changed seeds!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  numberOfDifferentVoxels = GetNumberOfDifferentVoxels(updatedResult.GetPointer(), recomputedResult.GetPointer());
+  if (numberOfDifferentVoxels != 0)
+    {
+    std::cerr << __LINE__ << ": Updated result differs from recomputed result in "
+      << numberOfDifferentVoxels << " voxels!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Seeds that reach voxels at the same distance give the same result with any number of threads
+
+  vtkNew<vtkImageData> uniformIntensityVolume;
+  uniformIntensityVolume->SetExtent(intensityVolume->GetExtent());
+  uniformIntensityVolume->AllocateScalars(VTK_FLOAT, 1);
+  uniformIntensityVolume->GetPointData()->GetScalars()->FillComponent(0, 100.0);
+  vtkNew<vtkImageData> uniformSingleThreadResult;
+  GrowFromSeeds(uniformIntensityVolume.GetPointer(), seedLabelVolume.GetPointer(), 1, uniformSingleThreadResult.GetPointer());
+  vtkNew<vtkImageData> uniformMultiThreadResult;
+  GrowFromSeeds(uniformIntensityVolume.GetPointer(), seedLabelVolume.GetPointer(), 4, uniformMultiThreadResult.GetPointer());
+  numberOfDifferentVoxels = GetNumberOfDifferentVoxels(uniformSingleThreadResult.GetPointer(), uniformMultiThreadResult.GetPointer());
+  if (numberOfDifferentVoxels != 0)
+    {
+    std::cerr << __LINE__ << ": Multi-threaded result differs from single-threaded result in "
+      << numberOfDifferentVoxels << " voxels of a uniform volume!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Number of threads is limited
+  growCutFilter->SetNumberOfThreads(VTK_MAX_THREADS + 10);
+  if (growCutFilter->GetNumberOfThreads() != VTK_MAX_THREADS)
+    {
+    std::cerr << __LINE__ << ": Number of threads is not limited!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << "GrowCut test passed." << std::endl;
+  return EXIT_SUCCESS;
+}
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+void CreateIntensityVolume(vtkImageData* intensityVolume)
+{
+  intensityVolume->SetExtent(0, 23, 0, 23, 0, 79);
+  intensityVolume->AllocateScalars(VTK_FLOAT, 1);
+  float* voxelPtr = static_cast<float*>(intensityVolume->GetScalarPointer());
+  vtkIdType numberOfVoxels = intensityVolume->GetNumberOfPoints();
+  // Pseudo-random non-integer intensities, so that path lengths from different seeds are not equal
+  unsigned int randomValue = 12345;
+  for (vtkIdType i = 0; i < numberOfVoxels; i++)
+    {
+    randomValue = randomValue * 1103515245 + 12345;
+    voxelPtr[i] = static_cast<float>((randomValue >> 8) % 1000000) / 1000.0f;
+    }
+}
+
+//----------------------------------------------------------------------------
+void PaintSeed(vtkImageData* seedLabelVolume, int x, int y, int z, unsigned char label)
+{
+  for (int k = z; k <= z + 1; k++)
+    {
+    for (int j = y; j <= y + 1; j++)
+      {
+      for (int i = x; i <= x + 1; i++)
+        {
+        *static_cast<unsigned char*>(seedLabelVolume->GetScalarPointer(i, j, k)) = label;
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void GrowFromSeeds(vtkImageData* intensityVolume, vtkImageData* seedLabelVolume, int numberOfThreads,
+  vtkImageData* resultLabelVolume)
+{
+  vtkNew<vtkImageGrowCutSegment> growCutFilter;
+  growCutFilter->SetNumberOfThreads(numberOfThreads);
+  growCutFilter->SetIntensityVolume(intensityVolume);
+  growCutFilter->SetSeedLabelVolume(seedLabelVolume);
+  growCutFilter->Update();
+  resultLabelVolume->DeepCopy(growCutFilter->GetOutput());
+}
+
+//----------------------------------------------------------------------------
+int GetNumberOfDifferentVoxels(vtkImageData* image1, vtkImageData* image2)
+{
+  if (image1->GetNumberOfPoints() != image2->GetNumberOfPoints())
+    {
+    return static_cast<int>(std::max(image1->GetNumberOfPoints(), image2->GetNumberOfPoints()));
+    }
+  unsigned char* voxel1Ptr = static_cast<unsigned char*>(image1->GetScalarPointer());
+  unsigned char* voxel2Ptr = static_cast<unsigned char*>(image2->GetScalarPointer());
+  int numberOfDifferentVoxels = 0;
+  for (vtkIdType i = 0; i < image1->GetNumberOfPoints(); i++)
+    {
+    if (voxel1Ptr[i] != voxel2Ptr[i])
+      {
+      numberOfDifferentVoxels++;
+      }
+    }
+  return numberOfDifferentVoxels;
+}
+
+//----------------------------------------------------------------------------
+int GetNumberOfVoxelsWithLabel(vtkImageData* image, unsigned char label)
+{
+  unsigned char* voxelPtr = static_cast<unsigned char*>(image->GetScalarPointer());
+  int numberOfVoxels = 0;
+  for (vtkIdType i = 0; i < image->GetNumberOfPoints(); i++)
+    {
+    if (voxelPtr[i] == label)
+      {
+      numberOfVoxels++;
+      }
+    }
+  return numberOfVoxels;
+}
+
+}
@@ -0,0 +1,221 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Segmentations includes
+#include "vtkMRMLSegmentationsDisplayableManager2D.h"
+
+// SegmentationCore includes
+#include "vtkOrientedImageData.h"
+#include "vtkSegment.h"
+#include "vtkSegmentation.h"
+#include "vtkSegmentationConverter.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+
+// STD includes
+#include <string>
+#include <vector>
+
+namespace
+{
+void AddCubeSegment(vtkSegmentation* segmentation, const std::string& segmentId, int start, int end);
+void PaintCube(vtkOrientedImageData* labelmap, int start, int end);
+int GetNumberOfVoxelsWithValue(vtkOrientedImageData* image, int value);
+int GetNumberOfDifferentVoxels(vtkOrientedImageData* image1, vtkOrientedImageData* image2);
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLSegmentationsDisplayableManager2DTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkNew<vtkSegmentation> segmentation;
+  segmentation->SetMasterRepresentationName(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName());
+  AddCubeSegment(segmentation.GetPointer(), "A", 5, 14);
+  AddCubeSegment(segmentation.GetPointer(), "B", 20, 29);
+
+  //////////////////////////////////////////////////////////////////////////
+  // Separate labelmaps
+
+  std::vector<std::string> segmentIDs;
+  segmentIDs.push_back("A");
+  segmentIDs.push_back("B");
+  vtkNew<vtkOrientedImageData> segmentIndexImage;
+  if (!vtkMRMLSegmentationsDisplayableManager2D::PaintSegmentIndexImage(
+      segmentation.GetPointer(), segmentIDs, segmentIndexImage.GetPointer())
+    || GetNumberOfVoxelsWithValue(segmentIndexImage.GetPointer(), 1) != 1000
+    || GetNumberOfVoxelsWithValue(segmentIndexImage.GetPointer(), 2) != 1000)
+    {
+    std::cerr << __LINE__ << ": Failed to paint segments of separate labelmaps!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Updating the region of a modified segment gives the same result as painting
+  // all segments again, including where segments overlap
+
+  vtkOrientedImageData* labelmapA = vtkOrientedImageData::SafeDownCast(segmentation->GetSegmentRepresentation(
+    "A", vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
+  PaintCube(labelmapA, 5, 24);
+  labelmapA->Modified();
+  int updateExtent[6] = { 5, 24, 5, 24, 5, 24 };
+  vtkNew<vtkOrientedImageData> repaintedSegmentIndexImage;
+  if (!vtkMRMLSegmentationsDisplayableManager2D::UpdateSegmentIndexImage(
+      segmentation.GetPointer(), segmentIDs, segmentIndexImage.GetPointer(), updateExtent)
+    || !vtkMRMLSegmentationsDisplayableManager2D::PaintSegmentIndexImage(
+      segmentation.GetPointer(), segmentIDs, repaintedSegmentIndexImage.GetPointer()))
+    {
+    std::cerr << __LINE__ << ": Failed to update the region of a modified segment!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (GetNumberOfVoxelsWithValue(segmentIndexImage.GetPointer(), 2) != 1000
+    || GetNumberOfDifferentVoxels(segmentIndexImage.GetPointer(), repaintedSegmentIndexImage.GetPointer()) != 0)
+    {
+    std::cerr << __LINE__ << ": Updated label index image differs from the repainted image!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  // restore the original segment
+  labelmapA->GetPointData()->GetScalars()->FillComponent(0, 0);
+  PaintCube(labelmapA, 5, 14);
+  labelmapA->Modified();
+
+  //////////////////////////////////////////////////////////////////////////
+  // Shared labelmap, all segments visible
+
+  if (!segmentation->CollapseBinaryLabelmaps(true) || segmentation->GetNumberOfLayers() != 1
+    || !segmentation->IsSharedBinaryLabelmap("A") || !segmentation->IsSharedBinaryLabelmap("B"))
+    {
+    std::cerr << __LINE__ << ": Failed to collapse binary labelmaps into a single layer!" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!vtkMRMLSegmentationsDisplayableManager2D::PaintSegmentIndexImage(
+      segmentation.GetPointer(), segmentIDs, segmentIndexImage.GetPointer())
+    || GetNumberOfVoxelsWithValue(segmentIndexImage.GetPointer(), 1) != 1000
+    || GetNumberOfVoxelsWithValue(segmentIndexImage.GetPointer(), 2) != 1000)
+    {
+    std::cerr << __LINE__ << ": Failed to paint segments of a shared labelmap!" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //////////////////////////////////////////////////////////////////////////
+  // Shared labelmap, one segment hidden: only the visible segment may be painted,
+  // whichever label value it has in the shared labelmap
+
+  for (std::vector<std::string>::iterator segmentIdIt = segmentIDs.begin(); segmentIdIt != segmentIDs.end(); ++segmentIdIt)
+    {
+    std::vector<std::string> visibleSegmentIDs;
+    visibleSegmentIDs.push_back(*segmentIdIt);
+    if (!vtkMRMLSegmentationsDisplayableManager2D::PaintSegmentIndexImage(
+        segmentation.GetPointer(), visibleSegmentIDs, segmentIndexImage.GetPointer()))
+      {
+      std::cerr << __LINE__ << ": Failed to paint segment " << *segmentIdIt << " of a shared labelmap!" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if (GetNumberOfVoxelsWithValue(segmentIndexImage.GetPointer(), 1) != 1000
+      || segmentIndexImage->GetNumberOfPoints() - GetNumberOfVoxelsWithValue(segmentIndexImage.GetPointer(), 0) != 1000)
+      {
+      std::cerr << __LINE__ << ": Hidden segment painted with visible segment " << *segmentIdIt
+        << " (label value " << segmentation->GetSegment(*segmentIdIt)->GetLabelValue() << ")!" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  std::cout << "Segmentations displayable manager 2D test passed." << std::endl;
+  return EXIT_SUCCESS;
+}
+
+namespace
+{
+//----------------------------------------------------------------------------
+void AddCubeSegment(vtkSegmentation* segmentation, const std::string& segmentId, int start, int end)
+{
+  vtkNew<vtkOrientedImageData> labelmap;
+  labelmap->SetExtent(0, 39, 0, 39, 0, 39);
+  labelmap->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  labelmap->GetPointData()->GetScalars()->FillComponent(0, 0);
+  PaintCube(labelmap.GetPointer(), start, end);
+
+  vtkNew<vtkSegment> segment;
+  segment->SetName(segmentId.c_str());
+  segment->AddRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName(), labelmap.GetPointer());
+  segmentation->AddSegment(segment.GetPointer(), segmentId);
+}
+
+//----------------------------------------------------------------------------
+void PaintCube(vtkOrientedImageData* labelmap, int start, int end)
+{
+  for (int k = start; k <= end; ++k)
+    {
+    for (int j = start; j <= end; ++j)
+      {
+      for (int i = start; i <= end; ++i)
+        {
+        *static_cast<unsigned char*>(labelmap->GetScalarPointer(i, j, k)) = 1;
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+int GetNumberOfDifferentVoxels(vtkOrientedImageData* image1, vtkOrientedImageData* image2)
+{
+  int* extent = image1->GetExtent();
+  int* extent2 = image2->GetExtent();
+  for (int i = 0; i < 6; ++i)
+    {
+    if (extent[i] != extent2[i])
+      {
+      return static_cast<int>(image1->GetNumberOfPoints());
+      }
+    }
+  int numberOfVoxels = 0;
+  for (int k = extent[4]; k <= extent[5]; ++k)
+    {
+    for (int j = extent[2]; j <= extent[3]; ++j)
+      {
+      for (int i = extent[0]; i <= extent[1]; ++i)
+        {
+        if (image1->GetScalarComponentAsDouble(i, j, k, 0) != image2->GetScalarComponentAsDouble(i, j, k, 0))
+          {
+          ++numberOfVoxels;
+          }
+        }
+      }
+    }
+  return numberOfVoxels;
+}
+
+//----------------------------------------------------------------------------
+int GetNumberOfVoxelsWithValue(vtkOrientedImageData* image, int value)
+{
+  int* extent = image->GetExtent();
+  int numberOfVoxels = 0;
+  for (int k = extent[4]; k <= extent[5]; ++k)
+    {
+    for (int j = extent[2]; j <= extent[3]; ++j)
+      {
+      for (int i = extent[0]; i <= extent[1]; ++i)
+        {
+        if (static_cast<int>(image->GetScalarComponentAsDouble(i, j, k, 0)) == value)
+          {
+          ++numberOfVoxels;
+          }
+        }
+      }
+    }
+  return numberOfVoxels;
+}
+}
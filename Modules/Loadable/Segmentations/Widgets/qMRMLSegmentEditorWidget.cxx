@@ -618,9 +618,10 @@ bool qMRMLSegmentEditorWidgetPrivate::updateSelectedSegmentLabelmap()
     qWarning() << Q_FUNC_INFO << " failed: Segment " << selectedSegmentID << " not found in segmentation";
     return false;
     }
-  vtkOrientedImageData* segmentLabelmap = vtkOrientedImageData::SafeDownCast(
-    selectedSegment->GetRepresentation(vtkSegmentationConverter::GetSegmentationBinaryLabelmapRepresentationName()));
-  if (!segmentLabelmap)
+  // Only the voxels of the selected segment, even if its labelmap is shared with other segments
+  vtkNew<vtkOrientedImageData> segmentLabelmapData;
+  vtkOrientedImageData* segmentLabelmap = segmentLabelmapData.GetPointer();
+  if (!segmentationNode->GetSegmentation()->GetSegmentBinaryLabelmap(selectedSegmentID, segmentLabelmap))
     {
     qCritical() << Q_FUNC_INFO << ": Failed to get binary labelmap representation in segmentation " << segmentationNode->GetName();
     return false;
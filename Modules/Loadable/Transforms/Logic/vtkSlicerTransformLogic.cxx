@@ -77,6 +77,29 @@ or http://www.slicer.org/copyright/copyright.txt for details.
 #include "itkTranslationTransform.h"
 #include "itkTransformFactory.h"
 
+namespace
+{
+//----------------------------------------------------------------------------
+// Get positions of a slice of voxels of an image, in RAS coordinate system
+void GetVoxelSlicePositions(vtkMatrix4x4* ijkToRAS, int extent[6], int k, vtkPoints* points_RAS)
+{
+  points_RAS->SetDataTypeToDouble();
+  points_RAS->SetNumberOfPoints((extent[1] - extent[0] + 1) * (extent[3] - extent[2] + 1));
+  double point_RAS[4] = { 0, 0, 0, 1 };
+  double point_IJK[4] = { 0, 0, static_cast<double>(k), 1 };
+  vtkIdType pointIndex = 0;
+  for (point_IJK[1] = extent[2]; point_IJK[1] <= extent[3]; point_IJK[1]++)
+    {
+    for (point_IJK[0] = extent[0]; point_IJK[0] <= extent[1]; point_IJK[0]++)
+      {
+      ijkToRAS->MultiplyPoint(point_IJK, point_RAS);
+      points_RAS->SetPoint(pointIndex++, point_RAS);
+      }
+    }
+}
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSlicerTransformLogic);
 
 //----------------------------------------------------------------------------
@@ -210,21 +233,11 @@ void vtkSlicerTransformLogic::GetTransformedPointSamples(vtkPointSet* outputPoin
   vtkMRMLTransformNode* inputTransformNode, vtkMatrix4x4* gridToRAS, int* gridSize,
   bool transformToWorld /* = true */)
 {
-  vtkNew<vtkGeneralTransform> inputTransform;
-  if (transformToWorld)
-  {
-    inputTransformNode->GetTransformToWorld(inputTransform.GetPointer());
-  }
-  else
-  {
-    inputTransformNode->GetTransformFromWorld(inputTransform.GetPointer());
-  }
   // Generate sample point set on a grid
   vtkNew<vtkPoints> samplePositions_RAS;
   int numOfSamples = gridSize[0] * gridSize[1] * gridSize[2];
   samplePositions_RAS->SetNumberOfPoints(numOfSamples);
   double point_RAS[4] = { 0, 0, 0, 1 };
-  double transformedPoint_RAS[4] = { 0, 0, 0, 1 };
   double point_Grid[4] = { 0, 0, 0, 1 };
   int sampleIndex = 0;
   for (point_Grid[2] = 0; point_Grid[2]<gridSize[2]; point_Grid[2]++)
@@ -234,7 +247,6 @@ void vtkSlicerTransformLogic::GetTransformedPointSamples(vtkPointSet* outputPoin
       for (point_Grid[0] = 0; point_Grid[0]<gridSize[0]; point_Grid[0]++)
         {
         gridToRAS->MultiplyPoint(point_Grid, point_RAS);
-        inputTransform->TransformPoint(point_RAS, transformedPoint_RAS);
         samplePositions_RAS->SetPoint(sampleIndex, point_RAS[0], point_RAS[1], point_RAS[2]);
         sampleIndex++;
         }
@@ -272,13 +284,16 @@ void vtkSlicerTransformLogic::GetTransformedPointSamples(vtkPointSet* outputPoin
     inputTransformNode->GetTransformFromWorld(inputTransform.GetPointer());
     }
 
-  double transformedPoint_RAS[4] = { 0, 0, 0, 1 };
+  vtkNew<vtkPoints> transformedPositions_RAS;
+  vtkMRMLTransformNode::TransformPointsByComponents(inputTransform.GetPointer(), samplePositions_RAS, transformedPositions_RAS.GetPointer());
+
+  double point_RAS[3] = { 0, 0, 0 };
+  double transformedPoint_RAS[3] = { 0, 0, 0 };
   double pointDislocationVector_RAS[4] = { 0, 0, 0, 1 };
   for (int sampleIndex = 0; sampleIndex < numOfSamples; sampleIndex++)
     {
-    double* point_RAS = samplePositions_RAS->GetPoint(sampleIndex);
-
-    inputTransform->TransformPoint(point_RAS, transformedPoint_RAS);
+    samplePositions_RAS->GetPoint(sampleIndex, point_RAS);
+    transformedPositions_RAS->GetPoint(sampleIndex, transformedPoint_RAS);
 
     pointDislocationVector_RAS[0] = transformedPoint_RAS[0] - point_RAS[0];
     pointDislocationVector_RAS[1] = transformedPoint_RAS[1] - point_RAS[1];
@@ -409,33 +424,34 @@ bool vtkSlicerTransformLogic::GetTransformedPointSamplesAsMagnitudeImage(vtkImag
   // if the direction matrix is not identity.
   magnitudeImage->AllocateScalars(VTK_FLOAT, 1);
 
-  double point_RAS[4] = { 0, 0, 0, 1 };
-  double transformedPoint_RAS[4] = { 0, 0, 0, 1 };
+  double point_RAS[3] = { 0, 0, 0 };
+  double transformedPoint_RAS[3] = { 0, 0, 0 };
   double pointDislocationVector_RAS[4] = { 0, 0, 0, 1 };
-  double point_IJK[4] = { 0, 0, 0, 1 };
   float* voxelPtr = static_cast<float*>(magnitudeImage->GetScalarPointer());
   int* extent = magnitudeImage->GetExtent();
-  for (point_IJK[2] = extent[4]; point_IJK[2] <= extent[5]; point_IJK[2]++)
-  {
-    for (point_IJK[1] = extent[2]; point_IJK[1] <= extent[3]; point_IJK[1]++)
+  // Points are transformed one slice at a time
+  vtkNew<vtkPoints> slicePoints_RAS;
+  vtkNew<vtkPoints> transformedSlicePoints_RAS;
+  for (int k = extent[4]; k <= extent[5]; k++)
+  {
+    GetVoxelSlicePositions(ijkToRAS, extent, k, slicePoints_RAS.GetPointer());
+    vtkMRMLTransformNode::TransformPointsByComponents(inputTransform.GetPointer(), slicePoints_RAS.GetPointer(), transformedSlicePoints_RAS.GetPointer());
+    vtkIdType numberOfSlicePoints = slicePoints_RAS->GetNumberOfPoints();
+    for (vtkIdType pointIndex = 0; pointIndex < numberOfSlicePoints; pointIndex++)
     {
-      for (point_IJK[0] = extent[0]; point_IJK[0] <= extent[1]; point_IJK[0]++)
-      {
-        ijkToRAS->MultiplyPoint(point_IJK, point_RAS);
-
-        inputTransform->TransformPoint(point_RAS, transformedPoint_RAS);
+      slicePoints_RAS->GetPoint(pointIndex, point_RAS);
+      transformedSlicePoints_RAS->GetPoint(pointIndex, transformedPoint_RAS);
 
-        pointDislocationVector_RAS[0] = transformedPoint_RAS[0] - point_RAS[0];
-        pointDislocationVector_RAS[1] = transformedPoint_RAS[1] - point_RAS[1];
-        pointDislocationVector_RAS[2] = transformedPoint_RAS[2] - point_RAS[2];
+      pointDislocationVector_RAS[0] = transformedPoint_RAS[0] - point_RAS[0];
+      pointDislocationVector_RAS[1] = transformedPoint_RAS[1] - point_RAS[1];
+      pointDislocationVector_RAS[2] = transformedPoint_RAS[2] - point_RAS[2];
 
-        float mag = sqrt(
-          pointDislocationVector_RAS[0] * pointDislocationVector_RAS[0] +
-          pointDislocationVector_RAS[1] * pointDislocationVector_RAS[1] +
-          pointDislocationVector_RAS[2] * pointDislocationVector_RAS[2]);
+      float mag = sqrt(
+        pointDislocationVector_RAS[0] * pointDislocationVector_RAS[0] +
+        pointDislocationVector_RAS[1] * pointDislocationVector_RAS[1] +
+        pointDislocationVector_RAS[2] * pointDislocationVector_RAS[2]);
 
-        *(voxelPtr++) = mag;
-      }
+      *(voxelPtr++) = mag;
     }
   }
 
@@ -703,26 +719,27 @@ bool vtkSlicerTransformLogic::GetTransformedPointSamplesAsVectorImage(vtkImageDa
   // if the direction matrix is not identity.
   vectorImage->AllocateScalars(VTK_FLOAT, 3);
 
-  double point_RAS[4] = { 0, 0, 0, 1 };
-  double transformedPoint_RAS[4] = { 0, 0, 0, 1 };
-  double point_IJK[4] = { 0, 0, 0, 1 };
+  double point_RAS[3] = { 0, 0, 0 };
+  double transformedPoint_RAS[3] = { 0, 0, 0 };
   float* voxelPtr = static_cast<float*>(vectorImage->GetScalarPointer());
   int* extent = vectorImage->GetExtent();
-  for (point_IJK[2] = extent[4]; point_IJK[2] <= extent[5]; point_IJK[2]++)
-  {
-    for (point_IJK[1] = extent[2]; point_IJK[1] <= extent[3]; point_IJK[1]++)
+  // Points are transformed one slice at a time
+  vtkNew<vtkPoints> slicePoints_RAS;
+  vtkNew<vtkPoints> transformedSlicePoints_RAS;
+  for (int k = extent[4]; k <= extent[5]; k++)
+  {
+    GetVoxelSlicePositions(ijkToRAS, extent, k, slicePoints_RAS.GetPointer());
+    vtkMRMLTransformNode::TransformPointsByComponents(inputTransform.GetPointer(), slicePoints_RAS.GetPointer(), transformedSlicePoints_RAS.GetPointer());
+    vtkIdType numberOfSlicePoints = slicePoints_RAS->GetNumberOfPoints();
+    for (vtkIdType pointIndex = 0; pointIndex < numberOfSlicePoints; pointIndex++)
     {
-      for (point_IJK[0] = extent[0]; point_IJK[0] <= extent[1]; point_IJK[0]++)
-      {
-        ijkToRAS->MultiplyPoint(point_IJK, point_RAS);
+      slicePoints_RAS->GetPoint(pointIndex, point_RAS);
+      transformedSlicePoints_RAS->GetPoint(pointIndex, transformedPoint_RAS);
 
-        inputTransform->TransformPoint(point_RAS, transformedPoint_RAS);
-
-        // store the pointDislocationVector_RAS components in the image
-        *(voxelPtr++) = static_cast<float>(transformedPoint_RAS[0] - point_RAS[0]);
-        *(voxelPtr++) = static_cast<float>(transformedPoint_RAS[1] - point_RAS[1]);
-        *(voxelPtr++) = static_cast<float>(transformedPoint_RAS[2] - point_RAS[2]);
-      }
+      // store the pointDislocationVector_RAS components in the image
+      *(voxelPtr++) = static_cast<float>(transformedPoint_RAS[0] - point_RAS[0]);
+      *(voxelPtr++) = static_cast<float>(transformedPoint_RAS[1] - point_RAS[1]);
+      *(voxelPtr++) = static_cast<float>(transformedPoint_RAS[2] - point_RAS[2]);
     }
   }
 
@@ -38,6 +38,11 @@ This work is partially supported by PAR-07-249: R01CA131718 NA-MIC Virtual Colon
 
     parent.icon = qt.QIcon("%s/ToolbarEditorToolbox.png" % EditorLib.ICON_DIR)
 
+    # Undo states that do not fit into the memory budget are moved into the temporary directory,
+    # unless a spill directory has already been set
+    if not slicer.vtkImageStash.GetSpillDirectory():
+      slicer.vtkImageStash.SetSpillDirectory(slicer.app.temporaryPath)
+
 
 #
 # qSlicerPythonModuleExampleWidget
@@ -396,9 +396,15 @@ class UndoRedo(object):
       EditUtil().markVolumeNodeAsModified(self.volumeNode)
 
 
-  def __init__(self,undoSize=100):
+  def __init__(self,undoSize=100,undoBudget=1024*1024*1024):
+    """undoSize is the maximum number of checkpoints in a list and
+    undoBudget is the maximum number of bytes of stashed data in a list.
+    Stashed data that does not fit into the memory budget of the stashes
+    is moved into the spill directory of vtkImageStash, if it is set.
+    """
     self.enabled = True
     self.undoSize = undoSize
+    self.undoBudget = undoBudget
     self.undoList = []
     self.redoList = []
     self.stateChangedCallback = self.defaultStateChangedCallback
@@ -423,13 +429,22 @@ class UndoRedo(object):
     the passed list (could be undo or redo list)
     """
     if not self.enabled or not volumeNode or not volumeNode.GetImageData():
-      return
+      return( checkPointList )
     checkPointList.append( self.checkPoint(volumeNode) )
     self.stateChangedCallback()
     if len(checkPointList) >= self.undoSize:
-      return( checkPointList[1:] )
-    else:
-      return( checkPointList )
+      checkPointList = checkPointList[1:]
+    # remove the oldest checkpoints while the stashed data is over budget,
+    # checkpoints that are still being stashed are not counted
+    stashedSize = 0
+    for checkPoint in checkPointList:
+      if not checkPoint.stash.GetStashing():
+        stashedSize += checkPoint.stash.GetStashedSize()
+    while stashedSize > self.undoBudget and len(checkPointList) > 1:
+      if not checkPointList[0].stash.GetStashing():
+        stashedSize -= checkPointList[0].stash.GetStashedSize()
+      checkPointList = checkPointList[1:]
+    return( checkPointList )
 
   def saveState(self):
     """Called by effects as they modify the label volume node
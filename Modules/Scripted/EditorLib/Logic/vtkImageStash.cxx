@@ -14,11 +14,128 @@
 =========================================================================*/
 #include "vtkImageStash.h"
 
+#include "vtkMutexLock.h"
 #include "vtkPointData.h"
 #include "vtkObjectFactory.h"
 
+// STD includes
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <list>
+#include <sstream>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
 vtkStandardNewMacro(vtkImageStash);
 
+namespace
+{
+
+//----------------------------------------------------------------------------
+/// Stashed scalars of all the stashes
+struct vtkImageStashMemoryPool
+{
+  vtkImageStashMemoryPool()
+    {
+    this->MemoryBudget = 512 * 1024 * 1024;
+    this->TotalMemory = 0;
+    this->NextSpillFileIndex = 0;
+    }
+  vtkSimpleMutexLock Lock;
+  /// Stashes that have their scalars in memory, the oldest first
+  std::list<vtkImageStash*> Stashes;
+  vtkIdType MemoryBudget;
+  vtkIdType TotalMemory;
+  std::string SpillDirectory;
+  int NextSpillFileIndex;
+};
+
+// The pool is never deleted, so that stashes that are still alive
+// when static objects are destroyed at exit can safely remove themselves
+vtkImageStashMemoryPool& MemoryPool = *new vtkImageStashMemoryPool;
+
+//----------------------------------------------------------------------------
+/// Chunks processed by the compression and decompression threads
+struct vtkImageStashChunksJob
+{
+  vtkZLibDataCompressor* Compressor;
+  int CompressionLevel;
+  unsigned char* Scalars;
+  vtkIdType ScalarSize;
+  vtkIdType ChunkSize;
+  int NumberOfChunks;
+  /// Output of the compression
+  std::vector<vtkUnsignedCharArray*> CompressedChunks;
+  /// Input of the decompression
+  unsigned char* StashedScalars;
+  const vtkIdType* ChunkOffsets;
+  std::vector<int> ChunkSucceeded;
+};
+
+//----------------------------------------------------------------------------
+void vtkImageStash_GetChunkRange(vtkImageStashChunksJob* job, int chunk, vtkIdType& offset, vtkIdType& size)
+{
+  offset = static_cast<vtkIdType>(chunk) * job->ChunkSize;
+  size = std::min(job->ChunkSize, job->ScalarSize - offset);
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkImageStash_CompressChunks(void* arg)
+{
+  ThreadInfoStruct *info = static_cast<ThreadInfoStruct*>(arg);
+  vtkImageStashChunksJob *job = static_cast<vtkImageStashChunksJob*>(info->UserData);
+  vtkZLibDataCompressor* compressor = job->Compressor->NewInstance();
+  compressor->SetCompressionLevel(job->CompressionLevel);
+  for (int chunk = info->ThreadID; chunk < job->NumberOfChunks; chunk += info->NumberOfThreads)
+    {
+    vtkIdType offset = 0;
+    vtkIdType size = 0;
+    vtkImageStash_GetChunkRange(job, chunk, offset, size);
+    // returns a new buffer that has to be deleted
+    job->CompressedChunks[chunk] = compressor->Compress(job->Scalars + offset, size);
+    }
+  compressor->Delete();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkImageStash_UncompressChunks(void* arg)
+{
+  ThreadInfoStruct *info = static_cast<ThreadInfoStruct*>(arg);
+  vtkImageStashChunksJob *job = static_cast<vtkImageStashChunksJob*>(info->UserData);
+  vtkZLibDataCompressor* compressor = job->Compressor->NewInstance();
+  for (int chunk = info->ThreadID; chunk < job->NumberOfChunks; chunk += info->NumberOfThreads)
+    {
+    vtkIdType offset = 0;
+    vtkIdType size = 0;
+    vtkImageStash_GetChunkRange(job, chunk, offset, size);
+    size_t uncompressedSize = compressor->Uncompress(
+      job->StashedScalars + job->ChunkOffsets[chunk],
+      job->ChunkOffsets[chunk + 1] - job->ChunkOffsets[chunk],
+      job->Scalars + offset, size);
+    job->ChunkSucceeded[chunk] = (uncompressedSize == static_cast<size_t>(size));
+    }
+  compressor->Delete();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+void vtkImageStash_ExecuteChunks(vtkImageStashChunksJob* job, vtkThreadFunctionType function)
+{
+  vtkMultiThreader* threader = vtkMultiThreader::New();
+  threader->SetNumberOfThreads(std::max(1, std::min(job->NumberOfChunks, threader->GetNumberOfThreads())));
+  threader->SetSingleMethod(function, job);
+  threader->SingleMethodExecute();
+  threader->Delete();
+}
+
+} // end of anonymous namespace
+
 //----------------------------------------------------------------------------
 vtkImageStash::vtkImageStash()
 {
@@ -30,6 +147,7 @@ vtkImageStash::vtkImageStash()
   this->Stashing = 0;
   this->StashingThreadID = 0;
   this->StashingSucceeded = 0;
+  this->ChunkSize = 1024 * 1024;
 }
 
 //----------------------------------------------------------------------------
@@ -40,6 +158,11 @@ vtkImageStash::~vtkImageStash()
     {
     this->MultiThreader->TerminateThread(this->StashingThreadID);
     }
+  this->RemoveFromMemoryPool();
+  if (!this->SpillFileName.empty())
+    {
+    remove(this->SpillFileName.c_str());
+    }
   if (this->StashImage)
     {
     this->StashImage->Delete();
@@ -98,21 +221,55 @@ void vtkImageStash::Stash()
     return;
     }
 
+  // forget the previous stash
+  this->RemoveFromMemoryPool();
+  if (!this->SpillFileName.empty())
+    {
+    remove(this->SpillFileName.c_str());
+    this->SpillFileName.clear();
+    }
+  this->ChunkOffsets.clear();
+
   this->SetNumberOfTuples(scalars->GetNumberOfTuples());
   vtkIdType numPrims = this->GetNumberOfTuples() * scalars->GetNumberOfComponents();
   vtkIdType size = vtkDataArray::GetDataTypeSize(scalars->GetDataType());
   vtkIdType scalarSize = size * numPrims;
 
-  unsigned char *p = static_cast<unsigned char *>(scalars->WriteVoidPointer(0, numPrims));
-  this->GetCompressor()->SetCompressionLevel(this->GetCompressionLevel());
-  vtkUnsignedCharArray* compressedBuffer=this->GetCompressor()->Compress(p, scalarSize); // returns a new buffer that has to be deleted
-  // The compressor allocates space that has the size of an uncompressed volume
+  // compress the chunks in parallel
+  vtkImageStashChunksJob job;
+  job.Compressor = this->GetCompressor();
+  job.CompressionLevel = this->GetCompressionLevel();
+  job.Scalars = static_cast<unsigned char *>(scalars->WriteVoidPointer(0, numPrims));
+  job.ScalarSize = scalarSize;
+  job.ChunkSize = this->ChunkSize;
+  job.NumberOfChunks = std::max(1, static_cast<int>((scalarSize + this->ChunkSize - 1) / this->ChunkSize));
+  job.CompressedChunks.resize(job.NumberOfChunks, NULL);
+  job.StashedScalars = NULL;
+  job.ChunkOffsets = NULL;
+  vtkImageStash_ExecuteChunks(&job, vtkImageStash_CompressChunks);
+
+  // The compressor allocates space that has the size of an uncompressed chunk
   // and even if it uses less memory the buffer size is not reduced.
-  // Call squeeze on the buffer to reclaim the unused memory space
+  // Copy the chunks into one buffer of the right size to reclaim the unused memory space
   // (typically reduces memory consumption from hundreds of megabytes to under a megabyte)
-  if (compressedBuffer)
+  std::vector<vtkIdType> chunkOffsets(1, 0);
+  bool compressed = true;
+  for (int chunk = 0; chunk < job.NumberOfChunks; ++chunk)
+    {
+    compressed = compressed && (job.CompressedChunks[chunk] != NULL);
+    chunkOffsets.push_back(chunkOffsets.back()
+      + (job.CompressedChunks[chunk] ? job.CompressedChunks[chunk]->GetNumberOfTuples() : 0));
+    }
+  if (compressed)
     {
-    compressedBuffer->Squeeze();
+    vtkUnsignedCharArray* compressedBuffer = vtkUnsignedCharArray::New();
+    compressedBuffer->SetNumberOfTuples(chunkOffsets.back());
+    for (int chunk = 0; chunk < job.NumberOfChunks; ++chunk)
+      {
+      memcpy(compressedBuffer->GetPointer(chunkOffsets[chunk]), job.CompressedChunks[chunk]->GetPointer(0),
+        chunkOffsets[chunk + 1] - chunkOffsets[chunk]);
+      }
+    this->ChunkOffsets = chunkOffsets;
     this->SetStashedScalars(compressedBuffer);
     compressedBuffer->Delete();
 
@@ -127,6 +284,18 @@ void vtkImageStash::Stash()
     this->SetStashedScalars(0);
     this->SetStashingSucceeded(0);
     }
+  for (int chunk = 0; chunk < job.NumberOfChunks; ++chunk)
+    {
+    if (job.CompressedChunks[chunk])
+      {
+      job.CompressedChunks[chunk]->Delete();
+      }
+    }
+
+  if (compressed)
+    {
+    this->AddToMemoryPool();
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -161,6 +330,15 @@ void vtkImageStash::Unstash()
     return;
     }
 
+  // the stash cannot be spilled once it is out of the pool,
+  // it is added back when the scalars are uncompressed
+  this->RemoveFromMemoryPool();
+  if (!this->ReadSpillFile())
+    {
+    vtkErrorMacro ("Cannot unstash - unable to read " << this->SpillFileName);
+    return;
+    }
+
   // we saved the original number of tuples before squeezing
   //   - the number of components and the datatype are unchanged from before
   //     so we know the right size for the output buffer
@@ -172,11 +350,192 @@ void vtkImageStash::Unstash()
   // so we can uncompress directly into the buffer
   scalars->SetNumberOfTuples(this->GetNumberOfTuples());
   vtkIdType stashedSize = this->StashedScalars->GetNumberOfTuples();
-  unsigned char *scalar_p =
-      static_cast<unsigned char *>(scalars->WriteVoidPointer(0, numPrims));
-  unsigned char *stash_p =
-      static_cast<unsigned char *>(this->StashedScalars->WriteVoidPointer(0, stashedSize));
-  this->GetCompressor()->Uncompress(stash_p, stashedSize, scalar_p, scalarSize);
+
+  // stashed scalars that were set directly are one chunk
+  std::vector<vtkIdType> chunkOffsets = this->ChunkOffsets;
+  vtkIdType chunkSize = this->ChunkSize;
+  if (chunkOffsets.empty())
+    {
+    chunkOffsets.push_back(0);
+    chunkOffsets.push_back(stashedSize);
+    chunkSize = std::max(scalarSize, static_cast<vtkIdType>(1));
+    }
+
+  vtkImageStashChunksJob job;
+  job.Compressor = this->GetCompressor();
+  job.CompressionLevel = this->GetCompressionLevel();
+  job.Scalars = static_cast<unsigned char *>(scalars->WriteVoidPointer(0, numPrims));
+  job.ScalarSize = scalarSize;
+  job.ChunkSize = chunkSize;
+  job.NumberOfChunks = static_cast<int>(chunkOffsets.size()) - 1;
+  job.StashedScalars = static_cast<unsigned char *>(this->StashedScalars->WriteVoidPointer(0, stashedSize));
+  job.ChunkOffsets = &chunkOffsets[0];
+  job.ChunkSucceeded.resize(job.NumberOfChunks, 0);
+  vtkImageStash_ExecuteChunks(&job, vtkImageStash_UncompressChunks);
+
+  if (std::find(job.ChunkSucceeded.begin(), job.ChunkSucceeded.end(), 0) != job.ChunkSucceeded.end())
+    {
+    vtkErrorMacro ("Unstash: failed to uncompress the stashed scalars");
+    }
+
+  // the stashed scalars are kept in memory, so that the stash can be unstashed again
+  this->AddToMemoryPool();
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkImageStash::GetStashedSize()
+{
+  if (!this->ChunkOffsets.empty())
+    {
+    return this->ChunkOffsets.back();
+    }
+  return this->StashedScalars ? this->StashedScalars->GetNumberOfTuples() : 0;
+}
+
+//----------------------------------------------------------------------------
+int vtkImageStash::GetSpilled()
+{
+  MemoryPool.Lock.Lock();
+  int spilled = this->SpillFileName.empty() ? 0 : 1;
+  MemoryPool.Lock.Unlock();
+  return spilled;
+}
+
+//----------------------------------------------------------------------------
+void vtkImageStash::SetMemoryBudget(vtkIdType budget)
+{
+  MemoryPool.Lock.Lock();
+  MemoryPool.MemoryBudget = budget;
+  MemoryPool.Lock.Unlock();
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkImageStash::GetMemoryBudget()
+{
+  MemoryPool.Lock.Lock();
+  vtkIdType budget = MemoryPool.MemoryBudget;
+  MemoryPool.Lock.Unlock();
+  return budget;
+}
+
+//----------------------------------------------------------------------------
+void vtkImageStash::SetSpillDirectory(const char* directory)
+{
+  MemoryPool.Lock.Lock();
+  MemoryPool.SpillDirectory = (directory ? directory : "");
+  MemoryPool.Lock.Unlock();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkImageStash::GetSpillDirectory()
+{
+  MemoryPool.Lock.Lock();
+  std::string directory = MemoryPool.SpillDirectory;
+  MemoryPool.Lock.Unlock();
+  return directory;
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkImageStash::GetTotalStashedMemory()
+{
+  MemoryPool.Lock.Lock();
+  vtkIdType totalMemory = MemoryPool.TotalMemory;
+  MemoryPool.Lock.Unlock();
+  return totalMemory;
+}
+
+//----------------------------------------------------------------------------
+void vtkImageStash::AddToMemoryPool()
+{
+  MemoryPool.Lock.Lock();
+  MemoryPool.Stashes.push_back(this);
+  MemoryPool.TotalMemory += this->GetStashedSize();
+  // move the oldest stashes out of memory
+  while (MemoryPool.TotalMemory > MemoryPool.MemoryBudget
+    && !MemoryPool.SpillDirectory.empty() && MemoryPool.Stashes.front() != this)
+    {
+    vtkImageStash* oldestStash = MemoryPool.Stashes.front();
+    // the process ID keeps the files of processes that share the spill directory apart
+    std::ostringstream fileName;
+    fileName << MemoryPool.SpillDirectory << "/vtkImageStash-";
+#ifdef _WIN32
+    fileName << _getpid();
+#else
+    fileName << getpid();
+#endif
+    fileName << "-" << time(NULL) << "-" << MemoryPool.NextSpillFileIndex++ << ".bin";
+    if (!oldestStash->SpillToFile(fileName.str()))
+      {
+      vtkErrorMacro("Stash: unable to write " << fileName.str());
+      break;
+      }
+    MemoryPool.Stashes.pop_front();
+    MemoryPool.TotalMemory -= oldestStash->GetStashedSize();
+    }
+  MemoryPool.Lock.Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkImageStash::RemoveFromMemoryPool()
+{
+  MemoryPool.Lock.Lock();
+  std::list<vtkImageStash*>::iterator it =
+    std::find(MemoryPool.Stashes.begin(), MemoryPool.Stashes.end(), this);
+  if (it != MemoryPool.Stashes.end())
+    {
+    MemoryPool.Stashes.erase(it);
+    MemoryPool.TotalMemory -= this->GetStashedSize();
+    }
+  MemoryPool.Lock.Unlock();
+}
+
+//----------------------------------------------------------------------------
+bool vtkImageStash::SpillToFile(const std::string& fileName)
+{
+  FILE* file = fopen(fileName.c_str(), "wb");
+  if (!file)
+    {
+    return false;
+    }
+  size_t stashedSize = static_cast<size_t>(this->GetStashedSize());
+  size_t written = fwrite(this->StashedScalars->GetPointer(0), 1, stashedSize, file);
+  fclose(file);
+  if (written != stashedSize)
+    {
+    remove(fileName.c_str());
+    return false;
+    }
+  this->SpillFileName = fileName;
+  // release the memory
+  this->StashedScalars->Initialize();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkImageStash::ReadSpillFile()
+{
+  if (this->SpillFileName.empty())
+    {
+    return true;
+    }
+  FILE* file = fopen(this->SpillFileName.c_str(), "rb");
+  if (!file)
+    {
+    return false;
+    }
+  size_t stashedSize = static_cast<size_t>(this->GetStashedSize());
+  this->StashedScalars->SetNumberOfTuples(this->GetStashedSize());
+  size_t read = fread(this->StashedScalars->GetPointer(0), 1, stashedSize, file);
+  fclose(file);
+  if (read != stashedSize)
+    {
+    // the scalars stay in the spill file
+    this->StashedScalars->Initialize();
+    return false;
+    }
+  remove(this->SpillFileName.c_str());
+  this->SpillFileName.clear();
+  return true;
 }
 
 //----------------------------------------------------------------------------
@@ -189,7 +548,9 @@ void vtkImageStash::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "Stashed Scalars: " << this->GetStashedScalars() << "\n";
   if ( this->GetStashedScalars()) this->GetStashedScalars()->PrintSelf(os,indent.GetNextIndent());
   os << indent << "CompressionLevel: " << this->GetCompressionLevel() << "\n";
+  os << indent << "ChunkSize: " << this->GetChunkSize() << "\n";
+  os << indent << "NumberOfChunks: " << (this->ChunkOffsets.empty() ? 0 : this->ChunkOffsets.size() - 1) << "\n";
+  os << indent << "SpillFileName: " << this->SpillFileName << "\n";
   os << indent << "Compressor: \n";
   this->GetCompressor()->PrintSelf(os,indent.GetNextIndent());
 }
-
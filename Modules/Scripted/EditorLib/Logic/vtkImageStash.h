@@ -14,6 +14,12 @@
 =========================================================================*/
 ///  vtkImageStash -
 ///  Store an image data in a compressed form to save memory
+///
+///  The scalars are split into chunks of ChunkSize bytes that are compressed
+///  and decompressed independently, in parallel.
+///  All stashes share a memory pool: when the stashed scalars use more than
+///  the memory budget, the scalars of the oldest stashes are moved into
+///  files in the spill directory, and read back when they are unstashed.
 
 #ifndef __vtkImageStash_h
 #define __vtkImageStash_h
@@ -26,6 +32,10 @@
 #include <vtkUnsignedCharArray.h>
 #include <vtkZLibDataCompressor.h>
 
+// STD includes
+#include <string>
+#include <vector>
+
 class VTK_SLICER_EDITORLIB_MODULE_LOGIC_EXPORT vtkImageStash : public vtkObject
 {
 public:
@@ -45,7 +55,8 @@ public:
 
   ///
   /// The stashed scalars:
-  /// this is the zlib compressed image scalar data
+  /// this is the zlib compressed image scalar data,
+  /// the compressed chunks are stored one after the other
   vtkSetObjectMacro(StashedScalars, vtkUnsignedCharArray);
   vtkGetObjectMacro(StashedScalars, vtkUnsignedCharArray);
 
@@ -77,10 +88,42 @@ public:
   vtkGetMacro(CompressionLevel, int);
 
   // Description:
-  // Get/Set the compressor if needed
+  // Get/Set the compressor if needed.
+  // Each thread uses a new instance of the same class.
   vtkSetObjectMacro(Compressor, vtkZLibDataCompressor);
   vtkGetObjectMacro(Compressor, vtkZLibDataCompressor);
 
+  // Description:
+  // Get/Set the size of the independently compressed chunks of the scalars,
+  // in bytes. Default is 1MB.
+  vtkSetClampMacro(ChunkSize, vtkIdType, 1024, VTK_ID_MAX);
+  vtkGetMacro(ChunkSize, vtkIdType);
+
+  // Description:
+  // Number of bytes of the stashed scalars, in memory or in the spill file
+  vtkIdType GetStashedSize();
+
+  // Description:
+  // 1 if the stashed scalars have been moved into a file by the memory pool
+  int GetSpilled();
+
+  // Description:
+  // Get/Set the number of bytes that the stashed scalars of all the stashes
+  // may use in memory. Default is 512MB.
+  static void SetMemoryBudget(vtkIdType budget);
+  static vtkIdType GetMemoryBudget();
+
+  // Description:
+  // Get/Set the directory where stashed scalars are moved when the memory
+  // budget is exceeded. If empty (default) then the stashes are kept in memory.
+  static void SetSpillDirectory(const char* directory);
+  static std::string GetSpillDirectory();
+
+  // Description:
+  // Number of bytes that the stashed scalars of all the stashes use in memory.
+  // Scalars that are unstashed are kept in the stash and still counted.
+  static vtkIdType GetTotalStashedMemory();
+
   // Description:
   // Check if compression thread is finished
   vtkSetMacro(Stashing, int);
@@ -103,6 +146,22 @@ protected:
   int CompressionLevel;
   int Stashing;
   int StashingSucceeded;
+  vtkIdType ChunkSize;
+
+  /// Offset of each compressed chunk in StashedScalars,
+  /// followed by the size of StashedScalars
+  std::vector<vtkIdType> ChunkOffsets;
+  /// File that contains StashedScalars if the stash was spilled
+  std::string SpillFileName;
+
+  /// Add the stash to the memory pool and spill the oldest stashes
+  /// if the memory budget is exceeded
+  void AddToMemoryPool();
+  void RemoveFromMemoryPool();
+  /// Move StashedScalars into a file. The memory pool must be locked.
+  bool SpillToFile(const std::string& fileName);
+  /// Read StashedScalars back from the spill file and remove the file
+  bool ReadSpillFile();
 
 private:
   int StashingThreadID;
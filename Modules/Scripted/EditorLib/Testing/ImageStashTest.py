@@ -0,0 +1,104 @@
+
+import os
+import shutil
+import unittest
+import numpy
+import vtk
+from vtk.util import numpy_support
+import slicer
+
+class ImageStashTesting(unittest.TestCase):
+  def setUp(self):
+    self.memoryBudget = slicer.vtkImageStash.GetMemoryBudget()
+    self.spillDirectory = slicer.vtkImageStash.GetSpillDirectory()
+
+  def tearDown(self):
+    slicer.vtkImageStash.SetMemoryBudget(self.memoryBudget)
+    slicer.vtkImageStash.SetSpillDirectory(self.spillDirectory)
+
+  def runTest(self):
+    self.test_ImageStashChunks()
+    self.test_ImageStashSpill()
+
+  def createImage(self, offset):
+    """Create an image whose scalars compress well but are not uniform"""
+    image = vtk.vtkImageData()
+    image.SetDimensions(64, 64, 64)
+    image.AllocateScalars(vtk.VTK_SHORT, 1)
+    voxels = numpy_support.vtk_to_numpy(image.GetPointData().GetScalars())
+    voxels[:] = (numpy.arange(voxels.size) // 64 + offset) % 1000
+    return image, voxels.copy()
+
+  def getVoxels(self, image):
+    return numpy_support.vtk_to_numpy(image.GetPointData().GetScalars())
+
+  def test_ImageStashChunks(self):
+    """
+    Stash and unstash an image whose scalars are split into many chunks.
+    """
+    image, expectedVoxels = self.createImage(0)
+    stash = slicer.vtkImageStash()
+    stash.SetStashImage(image)
+    # 512kB of scalars in 128 chunks
+    stash.SetChunkSize(4096)
+    stash.Stash()
+    self.assertEqual(stash.GetStashingSucceeded(), 1)
+    self.assertEqual(image.GetPointData().GetScalars().GetNumberOfTuples(), 0)
+    self.assertTrue(0 < stash.GetStashedSize() < expectedVoxels.nbytes)
+
+    stash.Unstash()
+    self.assertTrue(numpy.array_equal(self.getVoxels(image), expectedVoxels))
+
+  def test_ImageStashSpill(self):
+    """
+    Stash images over the memory budget, so that older stashes are moved
+    into files, and check that they are read back when unstashed.
+    """
+    spillDirectory = os.path.join(slicer.app.temporaryPath, 'ImageStashTest')
+    if os.path.exists(spillDirectory):
+      shutil.rmtree(spillDirectory)
+    os.makedirs(spillDirectory)
+    slicer.vtkImageStash.SetSpillDirectory(spillDirectory)
+    slicer.vtkImageStash.SetMemoryBudget(1)
+    # memory used by stashes of other tests
+    initialStashedMemory = slicer.vtkImageStash.GetTotalStashedMemory()
+
+    image1, expectedVoxels1 = self.createImage(0)
+    stash1 = slicer.vtkImageStash()
+    stash1.SetStashImage(image1)
+    stash1.SetChunkSize(4096)
+    stash1.Stash()
+    self.assertEqual(stash1.GetSpilled(), 0)
+
+    # The most recent stash stays in memory, older ones are spilled
+    image2, expectedVoxels2 = self.createImage(500)
+    stash2 = slicer.vtkImageStash()
+    stash2.SetStashImage(image2)
+    stash2.SetChunkSize(4096)
+    stash2.Stash()
+    self.assertEqual(stash1.GetSpilled(), 1)
+    self.assertEqual(stash2.GetSpilled(), 0)
+    spillFiles = os.listdir(spillDirectory)
+    self.assertTrue(len(spillFiles) > 0)
+
+    # Spilled scalars are read back and the spill file is removed
+    stash1.Unstash()
+    self.assertEqual(stash1.GetSpilled(), 0)
+    self.assertTrue(numpy.array_equal(self.getVoxels(image1), expectedVoxels1))
+    for spillFile in spillFiles:
+      self.assertTrue(spillFile.startswith('vtkImageStash-%d-' % os.getpid()))
+      self.assertFalse(os.path.exists(os.path.join(spillDirectory, spillFile)))
+
+    # Unstashed scalars are still counted in the memory pool,
+    # so the other stash is spilled to stay within the budget
+    self.assertEqual(slicer.vtkImageStash.GetTotalStashedMemory(), initialStashedMemory + stash1.GetStashedSize())
+    self.assertEqual(stash2.GetSpilled(), 1)
+
+    stash2.Unstash()
+    self.assertTrue(numpy.array_equal(self.getVoxels(image2), expectedVoxels2))
+    self.assertEqual(stash2.GetSpilled(), 0)
+
+    # Deleted stashes are removed from the memory pool
+    del stash1
+    del stash2
+    self.assertEqual(slicer.vtkImageStash.GetTotalStashedMemory(), initialStashedMemory)